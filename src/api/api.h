@@ -9,6 +9,12 @@ struct lua_State;
 struct luaL_Reg;
 struct Color;
 
+#ifdef _WIN32
+#define LOVR_EXPORT __declspec(dllexport)
+#else
+#define LOVR_EXPORT __attribute__((visibility("default")))
+#endif
+
 // Enums
 typedef struct {
   uint8_t length;
@@ -25,9 +31,12 @@ extern StringEntry lovrAudioType[];
 extern StringEntry lovrBlendAlphaMode[];
 extern StringEntry lovrBlendMode[];
 extern StringEntry lovrBlockType[];
+extern StringEntry lovrBroadphase[];
 extern StringEntry lovrBufferUsage[];
+extern StringEntry lovrCastType[];
 extern StringEntry lovrChannelLayout[];
 extern StringEntry lovrCompareMode[];
+extern StringEntry lovrContactState[];
 extern StringEntry lovrCoordinateSpace[];
 extern StringEntry lovrDevice[];
 extern StringEntry lovrDeviceAxis[];
@@ -37,21 +46,28 @@ extern StringEntry lovrDrawStyle[];
 extern StringEntry lovrEffect[];
 extern StringEntry lovrEventType[];
 extern StringEntry lovrFilterMode[];
+extern StringEntry lovrFoveationLevel[];
 extern StringEntry lovrHeadsetDriver[];
 extern StringEntry lovrHeadsetOrigin[];
 extern StringEntry lovrHorizontalAlign[];
+extern StringEntry lovrImageEncoding[];
 extern StringEntry lovrJointType[];
 extern StringEntry lovrKeyboardKey[];
+extern StringEntry lovrLayerType[];
 extern StringEntry lovrMaterialColor[];
 extern StringEntry lovrMaterialScalar[];
 extern StringEntry lovrMaterialTexture[];
 extern StringEntry lovrPermission[];
+extern StringEntry lovrPoseFormat[];
+extern StringEntry lovrPostEffect[];
+extern StringEntry lovrRandomDistribution[];
 extern StringEntry lovrSampleFormat[];
 extern StringEntry lovrShaderType[];
 extern StringEntry lovrShapeType[];
 extern StringEntry lovrStencilAction[];
 extern StringEntry lovrTextureFormat[];
 extern StringEntry lovrTextureType[];
+extern StringEntry lovrThreadPriority[];
 extern StringEntry lovrTimeUnit[];
 extern StringEntry lovrUniformAccess[];
 extern StringEntry lovrVerticalAlign[];
@@ -80,10 +96,18 @@ typedef struct {
 #define LUA_RIDX_MAINTHREAD 1
 #endif
 
+// Type hashes are hash64 of the type name, unrolled so they fold into a constant at each call
+// site instead of hashing the name on every type check.  Names longer than 24 characters fall back
+// to hashing at runtime.
+#define LUAX_HASH_STEP(h, s, i) (((h) ^ (i < sizeof(s) - 1 ? (uint8_t) s[i < sizeof(s) ? i : 0] : 0)) * (i < sizeof(s) - 1 ? 0x100000001b3ull : 1))
+#define LUAX_HASH_STEP4(h, s, i) LUAX_HASH_STEP(LUAX_HASH_STEP(LUAX_HASH_STEP(LUAX_HASH_STEP(h, s, i), s, i + 1), s, i + 2), s, i + 3)
+#define LUAX_HASH(s) LUAX_HASH_STEP4(LUAX_HASH_STEP4(LUAX_HASH_STEP4(LUAX_HASH_STEP4(LUAX_HASH_STEP4(LUAX_HASH_STEP4(0xcbf29ce484222325ull, s, 0), s, 4), s, 8), s, 12), s, 16), s, 20)
+#define luax_typehash(T) (sizeof(#T) <= 25 ? LUAX_HASH(#T) : hash64(#T, sizeof(#T) - 1))
+
 #define luax_registertype(L, T) _luax_registertype(L, #T, lovr ## T, lovr ## T ## Destroy)
-#define luax_totype(L, i, T) (T*) _luax_totype(L, i, hash64(#T, sizeof(#T) - 1))
-#define luax_checktype(L, i, T) (T*) _luax_checktype(L, i, hash64(#T, sizeof(#T) - 1), #T)
-#define luax_pushtype(L, T, o) _luax_pushtype(L, #T, hash64(#T, sizeof(#T) - 1), o)
+#define luax_totype(L, i, T) (T*) _luax_totype(L, i, luax_typehash(T))
+#define luax_checktype(L, i, T) (T*) _luax_checktype(L, i, luax_typehash(T), #T)
+#define luax_pushtype(L, T, o) _luax_pushtype(L, #T, luax_typehash(T), o)
 #define luax_checkenum(L, i, T, x) _luax_checkenum(L, i, lovr ## T, x, #T)
 #define luax_pushenum(L, T, x) lua_pushlstring(L, (lovr ## T)[x].string, (lovr ## T)[x].length)
 #define luax_checkfloat(L, i) (float) luaL_checknumber(L, i)
@@ -107,6 +131,9 @@ void luax_traceback(struct lua_State* L, struct lua_State* T, const char* messag
 int luax_getstack(struct lua_State* L);
 void luax_pushconf(struct lua_State* L);
 int luax_setconf(struct lua_State* L);
+#ifdef LOVR_USE_LUAJIT
+int luax_installffi(struct lua_State* L);
+#endif
 void luax_setmainthread(struct lua_State* L);
 void luax_atexit(struct lua_State* L, void (*destructor)(void));
 void luax_readcolor(struct lua_State* L, int index, struct Color* color);
@@ -117,6 +144,7 @@ int luax_readmesh(struct lua_State* L, int index, float** vertices, uint32_t* ve
 #ifndef LOVR_DISABLE_DATA
 struct Blob;
 struct Blob* luax_readblob(struct lua_State* L, int index, const char* debug);
+struct Blob* luax_mapblob(struct lua_State* L, int index, const char* debug);
 #endif
 
 #ifndef LOVR_DISABLE_EVENT
@@ -131,11 +159,15 @@ void* luax_readfile(const char* filename, size_t* bytesRead);
 
 #ifndef LOVR_DISABLE_GRAPHICS
 struct Attachment;
+struct Model;
 struct Texture;
 struct Uniform;
 int luax_checkuniform(struct lua_State* L, int index, const struct Uniform* uniform, void* dest, const char* debug);
 int luax_optmipmap(struct lua_State* L, int index, struct Texture* texture);
 void luax_readattachments(struct lua_State* L, int index, struct Attachment* attachments, int* count);
+uint32_t luax_getmeshvertexcount(struct lua_State* L, int index, uint32_t components);
+void luax_readmeshvertices(struct lua_State* L, int index, void* data, const uint8_t* types, uint32_t components, uint32_t count);
+uint32_t luax_checkanimation(struct lua_State* L, int index, struct Model* model);
 #endif
 
 #ifndef LOVR_DISABLE_MATH
@@ -143,6 +175,7 @@ void luax_readattachments(struct lua_State* L, int index, struct Attachment* att
 float* luax_tovector(struct lua_State* L, int index, VectorType* type);
 float* luax_checkvector(struct lua_State* L, int index, VectorType type, const char* expected);
 float* luax_newtempvector(struct lua_State* L, VectorType type);
+void luax_drainvectors(void);
 int luax_readvec3(struct lua_State* L, int index, float* v, const char* expected);
 int luax_readscale(struct lua_State* L, int index, float* v, int components, const char* expected);
 int luax_readquat(struct lua_State* L, int index, float* q, const char* expected);
@@ -150,11 +183,21 @@ int luax_readmat4(struct lua_State* L, int index, float* m, int scaleComponents)
 uint64_t luax_checkrandomseed(struct lua_State* L, int index);
 #endif
 
+#ifndef LOVR_DISABLE_THREAD
+#include "core/os.h"
+void luax_readscheduling(struct lua_State* L, const char* key, uint64_t* affinity, os_thread_priority* priority);
+void luax_startpool(struct lua_State* L);
+#endif
+
 #ifndef LOVR_DISABLE_PHYSICS
 struct Joint;
 struct Shape;
+struct CollisionMesh;
 void luax_pushjoint(struct lua_State* L, struct Joint* joint);
 void luax_pushshape(struct lua_State* L, struct Shape* shape);
 struct Joint* luax_checkjoint(struct lua_State* L, int index);
 struct Shape* luax_checkshape(struct lua_State* L, int index);
+struct Shape* luax_newterrainshape(struct lua_State* L, int index);
+struct CollisionMesh* luax_newcollisionmesh(struct lua_State* L, int index);
+int luax_readpoints(struct lua_State* L, int index, float** vertices, uint32_t* vertexCount, uint32_t** indices, uint32_t* indexCount, bool* shouldFree);
 #endif
@@ -83,11 +83,67 @@ static int l_lovrAudioSetDevice(lua_State *L) {
   size_t size = id ? luax_len(L, 2) : 0;
   Sound* sink = lua_isnoneornil(L, 3) ? NULL : luax_checktype(L, 3, Sound);
   AudioShareMode shareMode = luax_checkenum(L, 4, AudioShareMode, "shared");
-  bool success = lovrAudioSetDevice(type, id, size, sink, shareMode);
+  uint32_t periodSize = 0;
+  uint32_t periodCount = 0;
+  if (lua_istable(L, 5)) {
+    lua_getfield(L, 5, "period");
+    periodSize = luaL_optinteger(L, -1, 0);
+    lua_getfield(L, 5, "periods");
+    periodCount = luaL_optinteger(L, -1, 0);
+    lua_pop(L, 2);
+  }
+  bool success = lovrAudioSetDevice(type, id, size, sink, shareMode, periodSize, periodCount);
   lua_pushboolean(L, success);
   return 1;
 }
 
+static int l_lovrAudioGetLatency(lua_State* L) {
+  lua_pushnumber(L, lovrAudioGetLatency());
+  return 1;
+}
+
+static int l_lovrAudioGetStats(lua_State* L) {
+  if (lua_gettop(L) > 0) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    lua_settop(L, 1);
+  } else {
+    lua_createtable(L, 0, 12);
+  }
+
+  AudioStats stats;
+  lovrAudioGetStats(&stats);
+  lua_pushinteger(L, stats.callbacks);
+  lua_setfield(L, 1, "callbacks");
+  lua_pushinteger(L, stats.underruns);
+  lua_setfield(L, 1, "underruns");
+  lua_pushinteger(L, stats.starved);
+  lua_setfield(L, 1, "starved");
+  lua_pushinteger(L, stats.voices);
+  lua_setfield(L, 1, "voices");
+  lua_pushinteger(L, stats.virtualVoices);
+  lua_setfield(L, 1, "virtualvoices");
+  lua_pushnumber(L, stats.period);
+  lua_setfield(L, 1, "period");
+  lua_pushnumber(L, stats.mixTimeMin);
+  lua_setfield(L, 1, "mintime");
+  lua_pushnumber(L, stats.mixTimeAverage);
+  lua_setfield(L, 1, "mixtime");
+  lua_pushnumber(L, stats.mixTimeMax);
+  lua_setfield(L, 1, "maxtime");
+  lua_pushnumber(L, stats.spatializerTime);
+  lua_setfield(L, 1, "spatializertime");
+  lua_pushnumber(L, stats.decodeTime);
+  lua_setfield(L, 1, "decodetime");
+  lua_pushnumber(L, stats.streamTime);
+  lua_setfield(L, 1, "streamtime");
+  return 1;
+}
+
+static int l_lovrAudioResetStats(lua_State* L) {
+  lovrAudioResetStats();
+  return 0;
+}
+
 static int l_lovrAudioStart(lua_State* L) {
   AudioType type = luax_checkenum(L, 1, AudioType, "playback");
   bool started = lovrAudioStart(type);
@@ -197,11 +253,54 @@ static int l_lovrAudioSetGeometry(lua_State* L) {
   return 1;
 }
 
+static int l_lovrAudioAddGeometry(lua_State* L) {
+  float* vertices;
+  uint32_t* indices;
+  uint32_t vertexCount, indexCount;
+  bool shouldFree;
+  int index = luax_readmesh(L, 1, &vertices, &vertexCount, &indices, &indexCount, &shouldFree);
+  AudioMaterial material = luax_checkenum(L, index, AudioMaterial, "generic");
+  uint32_t id = lovrAudioAddGeometry(vertices, indices, vertexCount, indexCount, material);
+  if (shouldFree) {
+    free(vertices);
+    free(indices);
+  }
+  if (id == 0) {
+    lua_pushnil(L);
+  } else {
+    lua_pushinteger(L, id);
+  }
+  return 1;
+}
+
+static int l_lovrAudioRemoveGeometry(lua_State* L) {
+  uint32_t id = luaL_checkinteger(L, 1);
+  lovrAudioRemoveGeometry(id);
+  return 0;
+}
+
+static int l_lovrAudioIsGeometryReady(lua_State* L) {
+  lua_pushboolean(L, lovrAudioIsGeometryReady());
+  return 1;
+}
+
 static int l_lovrAudioGetSpatializer(lua_State *L) {
   lua_pushstring(L, lovrAudioGetSpatializer());
   return 1;
 }
 
+static int l_lovrAudioGetSpatializerVoices(lua_State* L) {
+  lua_pushinteger(L, lovrAudioGetSpatializerVoices());
+  return 1;
+}
+
+static int l_lovrAudioSetSpatializerVoices(lua_State* L) {
+  lua_Integer voices = luaL_checkinteger(L, 1);
+  lovrAssert(voices >= 0, "Spatializer voice count can not be negative");
+  lovrAudioSetSpatializerVoices((uint32_t) voices);
+  return 0;
+}
+
 static int l_lovrAudioGetAbsorption(lua_State* L) {
   float absorption[3];
   lovrAudioGetAbsorption(absorption);
@@ -224,6 +323,7 @@ static int l_lovrAudioNewSource(lua_State* L) {
   Sound* sound = luax_totype(L, 1, Sound);
 
   bool decode = false;
+  bool resample = false;
   uint32_t effects = EFFECT_ALL;
   if (lua_gettop(L) >= 2) {
     luaL_checktype(L, 2, LUA_TTABLE);
@@ -232,6 +332,10 @@ static int l_lovrAudioNewSource(lua_State* L) {
     decode = lua_toboolean(L, -1);
     lua_pop(L, 1);
 
+    lua_getfield(L, 2, "resample");
+    resample = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
     lua_getfield(L, 2, "effects");
     switch (lua_type(L, -1)) {
       case LUA_TNIL: effects = EFFECT_ALL; break;
@@ -260,8 +364,8 @@ static int l_lovrAudioNewSource(lua_State* L) {
   }
 
   if (!sound) {
-    Blob* blob = luax_readblob(L, 1, "Source");
-    sound = lovrSoundCreateFromFile(blob, decode);
+    Blob* blob = luax_mapblob(L, 1, "Source");
+    sound = lovrSoundCreateFromFile(blob, decode, resample ? SAMPLE_RATE : 0);
     lovrRelease(blob, lovrBlobDestroy);
   } else {
     lovrRetain(sound);
@@ -274,9 +378,20 @@ static int l_lovrAudioNewSource(lua_State* L) {
   return 1;
 }
 
+static int l_lovrAudioNewBus(lua_State* L) {
+  Bus* parent = lua_isnoneornil(L, 1) ? NULL : luax_checktype(L, 1, Bus);
+  Bus* bus = lovrBusCreate(parent);
+  luax_pushtype(L, Bus, bus);
+  lovrRelease(bus, lovrBusDestroy);
+  return 1;
+}
+
 static const luaL_Reg lovrAudio[] = {
   { "getDevices", l_lovrAudioGetDevices },
   { "setDevice", l_lovrAudioSetDevice },
+  { "getLatency", l_lovrAudioGetLatency },
+  { "getStats", l_lovrAudioGetStats },
+  { "resetStats", l_lovrAudioResetStats },
   { "start", l_lovrAudioStart },
   { "stop", l_lovrAudioStop },
   { "isStarted", l_lovrAudioIsStarted },
@@ -289,22 +404,32 @@ static const luaL_Reg lovrAudio[] = {
   { "getPose", l_lovrAudioGetPose },
   { "setPose", l_lovrAudioSetPose },
   { "setGeometry", l_lovrAudioSetGeometry },
+  { "addGeometry", l_lovrAudioAddGeometry },
+  { "removeGeometry", l_lovrAudioRemoveGeometry },
+  { "isGeometryReady", l_lovrAudioIsGeometryReady },
   { "getSpatializer", l_lovrAudioGetSpatializer },
+  { "getSpatializerVoices", l_lovrAudioGetSpatializerVoices },
+  { "setSpatializerVoices", l_lovrAudioSetSpatializerVoices },
   { "getAbsorption", l_lovrAudioGetAbsorption },
   { "setAbsorption", l_lovrAudioSetAbsorption },
   { "newSource", l_lovrAudioNewSource },
+  { "newBus", l_lovrAudioNewBus },
   { NULL, NULL }
 };
 
 extern const luaL_Reg lovrSource[];
+extern const luaL_Reg lovrBus[];
 
 int luaopen_lovr_audio(lua_State* L) {
   lua_newtable(L);
   luax_register(L, lovrAudio);
   luax_registertype(L, Source);
+  luax_registertype(L, Bus);
 
   bool start = true;
   const char *spatializer = NULL;
+  uint32_t voices = 0;
+  uint32_t threads = 0;
   luax_pushconf(L);
   lua_getfield(L, -1, "audio");
   if (lua_istable(L, -1)) {
@@ -312,16 +437,30 @@ int luaopen_lovr_audio(lua_State* L) {
     spatializer = lua_tostring(L, -1);
     lua_pop(L, 1);
 
+    lua_getfield(L, -1, "voices");
+    voices = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "threads");
+    threads = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+
     lua_getfield(L, -1, "start");
     start = lua_isnil(L, -1) || lua_toboolean(L, -1);
     lua_pop(L, 1);
   }
   lua_pop(L, 2);
 
-  if (lovrAudioInit(spatializer)) {
+  uint64_t affinity = 0;
+  os_thread_priority priority = OS_THREAD_PRIORITY_NORMAL;
+#ifndef LOVR_DISABLE_THREAD
+  luax_readscheduling(L, "audio", &affinity, &priority);
+#endif
+
+  if (lovrAudioInit(spatializer, voices, threads, affinity, priority)) {
     luax_atexit(L, lovrAudioDestroy);
     if (start) {
-      lovrAudioSetDevice(AUDIO_PLAYBACK, NULL, 0, NULL, AUDIO_SHARED);
+      lovrAudioSetDevice(AUDIO_PLAYBACK, NULL, 0, NULL, AUDIO_SHARED, 0, 0);
       lovrAudioStart(AUDIO_PLAYBACK);
     }
   }
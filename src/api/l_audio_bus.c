@@ -0,0 +1,50 @@
+#include "api.h"
+#include "audio/audio.h"
+#include "core/util.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrBusGetParent(lua_State* L) {
+  Bus* bus = luax_checktype(L, 1, Bus);
+  luax_pushtype(L, Bus, lovrBusGetParent(bus));
+  return 1;
+}
+
+static int l_lovrBusGetVolume(lua_State* L) {
+  Bus* bus = luax_checktype(L, 1, Bus);
+  VolumeUnit units = luax_checkenum(L, 2, VolumeUnit, "linear");
+  lua_pushnumber(L, lovrBusGetVolume(bus, units));
+  return 1;
+}
+
+static int l_lovrBusSetVolume(lua_State* L) {
+  Bus* bus = luax_checktype(L, 1, Bus);
+  float volume = luax_checkfloat(L, 2);
+  VolumeUnit units = luax_checkenum(L, 3, VolumeUnit, "linear");
+  lovrBusSetVolume(bus, volume, units);
+  return 0;
+}
+
+static int l_lovrBusIsEffectEnabled(lua_State* L) {
+  Bus* bus = luax_checktype(L, 1, Bus);
+  Effect effect = luax_checkenum(L, 2, Effect, NULL);
+  lua_pushboolean(L, lovrBusIsEffectEnabled(bus, effect));
+  return 1;
+}
+
+static int l_lovrBusSetEffectEnabled(lua_State* L) {
+  Bus* bus = luax_checktype(L, 1, Bus);
+  Effect effect = luax_checkenum(L, 2, Effect, NULL);
+  bool enabled = lua_isnoneornil(L, 3) ? true : lua_toboolean(L, 3);
+  lovrBusSetEffectEnabled(bus, effect, enabled);
+  return 0;
+}
+
+const luaL_Reg lovrBus[] = {
+  { "getParent", l_lovrBusGetParent },
+  { "getVolume", l_lovrBusGetVolume },
+  { "setVolume", l_lovrBusSetVolume },
+  { "isEffectEnabled", l_lovrBusIsEffectEnabled },
+  { "setEffectEnabled", l_lovrBusSetEffectEnabled },
+  { NULL, NULL }
+};
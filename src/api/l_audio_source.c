@@ -178,6 +178,32 @@ static int l_lovrSourceSetDirectivity(lua_State* L) {
   return 0;
 }
 
+static int l_lovrSourceGetBus(lua_State* L) {
+  Source* source = luax_checktype(L, 1, Source);
+  luax_pushtype(L, Bus, lovrSourceGetBus(source));
+  return 1;
+}
+
+static int l_lovrSourceSetBus(lua_State* L) {
+  Source* source = luax_checktype(L, 1, Source);
+  Bus* bus = lua_isnoneornil(L, 2) ? NULL : luax_checktype(L, 2, Bus);
+  lovrSourceSetBus(source, bus);
+  return 0;
+}
+
+static int l_lovrSourceGetPriority(lua_State* L) {
+  Source* source = luax_checktype(L, 1, Source);
+  lua_pushinteger(L, lovrSourceGetPriority(source));
+  return 1;
+}
+
+static int l_lovrSourceSetPriority(lua_State* L) {
+  Source* source = luax_checktype(L, 1, Source);
+  int32_t priority = luaL_checkinteger(L, 2);
+  lovrSourceSetPriority(source, priority);
+  return 0;
+}
+
 static int l_lovrSourceGetRadius(lua_State* L) {
   Source* source = luax_checktype(L, 1, Source);
   float radius = lovrSourceGetRadius(source);
@@ -228,6 +254,10 @@ const luaL_Reg lovrSource[] = {
   { "setOrientation", l_lovrSourceSetOrientation },
   { "getPose", l_lovrSourceGetPose },
   { "setPose", l_lovrSourceSetPose },
+  { "getBus", l_lovrSourceGetBus },
+  { "setBus", l_lovrSourceSetBus },
+  { "getPriority", l_lovrSourceGetPriority },
+  { "setPriority", l_lovrSourceSetPriority },
   { "getRadius", l_lovrSourceGetRadius },
   { "setRadius", l_lovrSourceSetRadius },
   { "getDirectivity", l_lovrSourceGetDirectivity },
@@ -3,11 +3,21 @@
 #include "data/modelData.h"
 #include "data/rasterizer.h"
 #include "data/sound.h"
+#include "data/soundBank.h"
 #include "data/image.h"
+#include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef LOVR_DISABLE_THREAD
+#include "event/event.h"
+#include "thread/channel.h"
+#include "thread/pool.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <math.h>
+#endif
 
 static int l_lovrDataNewBlob(lua_State* L) {
   size_t size;
@@ -39,9 +49,47 @@ static int l_lovrDataNewBlob(lua_State* L) {
   return 1;
 }
 
+// Temporary Blobs are emptied at the end of the frame, so per-frame scratch data doesn't need to go
+// through the system allocator
+static int l_lovrDataNewTemporaryBlob(lua_State* L) {
+  size_t size;
+  const void* data = NULL;
+  int type = lua_type(L, 1);
+  if (type == LUA_TNUMBER) {
+    int isize = lua_tonumber(L, 1);
+    lovrAssert(isize > 0, "Blob size must be positive");
+    size = (size_t) isize;
+  } else if (type == LUA_TSTRING) {
+    data = luaL_checklstring(L, 1, &size);
+  } else {
+    Blob* blob = luax_checktype(L, 1, Blob);
+    data = blob->data;
+    size = blob->size;
+  }
+  const char* name = luaL_optstring(L, 2, "");
+  Blob* blob = lovrBlobCreateTemporary(data, size, name);
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  return 1;
+}
+
 static int l_lovrDataNewModelData(lua_State* L) {
-  Blob* blob = luax_readblob(L, 1, "Model");
-  ModelData* modelData = lovrModelDataCreate(blob, luax_readfile);
+  Blob* blob = luax_mapblob(L, 1, "Model");
+  bool optimize = false;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "optimize");
+    optimize = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+#ifndef LOVR_DISABLE_THREAD
+    lua_getfield(L, 2, "threaded");
+    if (lua_toboolean(L, -1)) {
+      luax_startpool(L);
+    }
+    lua_pop(L, 1);
+#endif
+  }
+  ModelData* modelData = lovrModelDataCreate(blob, luax_readfile, optimize);
   luax_pushtype(L, ModelData, modelData);
   lovrRelease(blob, lovrBlobDestroy);
   lovrRelease(modelData, lovrModelDataDestroy);
@@ -55,7 +103,7 @@ static int l_lovrDataNewRasterizer(lua_State* L) {
   if (lua_type(L, 1) == LUA_TNUMBER || lua_isnoneornil(L, 1)) {
     size = luax_optfloat(L, 1, 32.f);
   } else {
-    blob = luax_readblob(L, 1, "Font");
+    blob = luax_mapblob(L, 1, "Font");
     size = luax_optfloat(L, 2, 32.f);
   }
 
@@ -86,15 +134,78 @@ static int l_lovrDataNewSound(lua_State* L) {
     return luax_typeerror(L, 1, "number, string, or Blob");
   }
 
-  Blob* blob = luax_readblob(L, 1, "Sound");
+  Blob* blob = luax_mapblob(L, 1, "Sound");
   bool decode = lua_toboolean(L, 2);
-  Sound* sound = lovrSoundCreateFromFile(blob, decode);
+  uint32_t sampleRate = luaL_optinteger(L, 3, 0);
+  Sound* sound = lovrSoundCreateFromFile(blob, decode, sampleRate);
   luax_pushtype(L, Sound, sound);
   lovrRelease(blob, lovrBlobDestroy);
   lovrRelease(sound, lovrSoundDestroy);
   return 1;
 }
 
+// Returns a new reference to the Sound at index, which can also be a filename or Blob to load
+static Sound* luax_checkbanksound(lua_State* L, int index) {
+  Sound* sound = luax_totype(L, index, Sound);
+  if (sound) {
+    lovrRetain(sound);
+    return sound;
+  }
+
+  Blob* blob = luax_mapblob(L, index, "Sound");
+  sound = lovrSoundCreateFromFile(blob, false, 0);
+  lovrRelease(blob, lovrBlobDestroy);
+  return sound;
+}
+
+static int l_lovrDataNewSoundBank(lua_State* L) {
+  if (!lua_istable(L, 1)) {
+    Blob* blob = luax_mapblob(L, 1, "SoundBank");
+    SoundBank* bank = lovrSoundBankCreate(blob);
+    luax_pushtype(L, SoundBank, bank);
+    lovrRelease(blob, lovrBlobDestroy);
+    lovrRelease(bank, lovrSoundBankDestroy);
+    return 1;
+  }
+
+  // Table of names to Sounds, or to { sound, loopStart, loopEnd }
+  arr_t(SoundBankEntry) entries;
+  arr_init(&entries, realloc);
+
+  lua_pushnil(L);
+  while (lua_next(L, 1) != 0) {
+    lovrAssert(lua_type(L, -2) == LUA_TSTRING, "SoundBank names must be strings");
+    SoundBankEntry entry = { .name = lua_tostring(L, -2) };
+    if (lua_istable(L, -1)) {
+      lua_rawgeti(L, -1, 1);
+      entry.sound = luax_checkbanksound(L, -1);
+      lua_pop(L, 1);
+      lua_rawgeti(L, -1, 2);
+      lua_rawgeti(L, -2, 3);
+      entry.loopStart = luaL_optinteger(L, -2, 0);
+      entry.loopEnd = luaL_optinteger(L, -1, lovrSoundGetFrameCount(entry.sound));
+      lua_pop(L, 2);
+    } else {
+      entry.sound = luax_checkbanksound(L, -1);
+      entry.loopEnd = lovrSoundGetFrameCount(entry.sound);
+    }
+    arr_push(&entries, entry);
+    lua_pop(L, 1);
+  }
+
+  Blob* blob = lovrSoundBankEncode(entries.data, (uint32_t) entries.length);
+  for (size_t i = 0; i < entries.length; i++) {
+    lovrRelease(entries.data[i].sound, lovrSoundDestroy);
+  }
+  arr_free(&entries);
+
+  SoundBank* bank = lovrSoundBankCreate(blob);
+  luax_pushtype(L, SoundBank, bank);
+  lovrRelease(blob, lovrBlobDestroy);
+  lovrRelease(bank, lovrSoundBankDestroy);
+  return 1;
+}
+
 static int l_lovrDataNewImage(lua_State* L) {
   Image* image = NULL;
   if (lua_type(L, 1) == LUA_TNUMBER) {
@@ -108,7 +219,7 @@ static int l_lovrDataNewImage(lua_State* L) {
     if (source) {
       image = lovrImageCreate(source->width, source->height, source->blob, 0x0, source->format);
     } else {
-      Blob* blob = luax_readblob(L, 1, "Texture");
+      Blob* blob = luax_mapblob(L, 1, "Texture");
       bool flip = lua_isnoneornil(L, 2) ? true : lua_toboolean(L, 2);
       image = lovrImageCreateFromBlob(blob, flip);
       lovrRelease(blob, lovrBlobDestroy);
@@ -120,12 +231,186 @@ static int l_lovrDataNewImage(lua_State* L) {
   return 1;
 }
 
+#ifndef LOVR_DISABLE_THREAD
+typedef struct {
+  char* path;
+  Blob* blob;
+  bool flip;
+  Channel* channel;
+  jmp_buf catch;
+  char error[256];
+} ImageJob;
+
+static void onImageJobError(void* userdata, const char* format, va_list args) {
+  ImageJob* job = userdata;
+  vsnprintf(job->error, sizeof(job->error), format, args);
+  longjmp(job->catch, 1);
+}
+
+// Runs on a pool worker: reads and decodes the image, then pushes the Image (or an error string)
+static void decodeImage(void* arg) {
+  ImageJob* job = arg;
+  Variant result = { .type = TYPE_NIL };
+
+  lovrSetErrorCallback(onImageJobError, job);
+  if (!setjmp(job->catch)) {
+    if (!job->blob) {
+      size_t size;
+      void* data = luax_readfile(job->path, &size);
+      lovrAssert(data, "Could not read image from '%s'", job->path);
+      job->blob = lovrBlobCreate(data, size, job->path);
+    }
+
+    Image* image = lovrImageCreateFromBlob(job->blob, job->flip);
+    result.type = TYPE_OBJECT;
+    result.value.object.pointer = image;
+    result.value.object.type = "Image";
+    result.value.object.destructor = lovrImageDestroy;
+  } else {
+    result.type = TYPE_STRING;
+    result.value.string = malloc(strlen(job->error) + 1);
+    if (result.value.string) {
+      strcpy(result.value.string, job->error);
+    } else {
+      result.type = TYPE_NIL;
+    }
+  }
+  lovrSetErrorCallback(NULL, NULL);
+
+  uint64_t id;
+  lovrChannelPush(job->channel, &result, NAN, &id);
+  lovrRelease(job->channel, lovrChannelDestroy);
+  lovrRelease(job->blob, lovrBlobDestroy);
+  free(job->path);
+  free(job);
+}
+
+static int l_lovrDataNewImageAsync(lua_State* L) {
+  ImageJob* job = calloc(1, sizeof(ImageJob));
+  lovrAssert(job, "Out of memory");
+
+  // The Channel's initial reference belongs to the job, Lua holds its own
+
+  if (lua_type(L, 1) == LUA_TUSERDATA) {
+    job->blob = luax_checktype(L, 1, Blob);
+    lovrRetain(job->blob);
+  } else {
+    size_t length;
+    const char* path = luaL_checklstring(L, 1, &length);
+    job->path = malloc(length + 1);
+    lovrAssert(job->path, "Out of memory");
+    memcpy(job->path, path, length + 1);
+  }
+
+  job->flip = lua_isnoneornil(L, 2) ? true : lua_toboolean(L, 2);
+  job->channel = lovrChannelCreate(0);
+
+  luax_startpool(L);
+
+  luax_pushtype(L, Channel, job->channel);
+  lovrThreadPoolSubmit(decodeImage, job);
+  return 1;
+}
+
+typedef struct {
+  char* path;
+  Blob* blob;
+  bool optimize;
+  Channel* channel;
+  jmp_buf catch;
+  char error[256];
+} ModelJob;
+
+static void onModelJobError(void* userdata, const char* format, va_list args) {
+  ModelJob* job = userdata;
+  vsnprintf(job->error, sizeof(job->error), format, args);
+  longjmp(job->catch, 1);
+}
+
+// Runs on a pool worker: reads and parses the model (its images decode on the pool too), then
+// pushes the ModelData (or an error string)
+static void loadModel(void* arg) {
+  ModelJob* job = arg;
+  Variant result = { .type = TYPE_NIL };
+
+  lovrSetErrorCallback(onModelJobError, job);
+  if (!setjmp(job->catch)) {
+    if (!job->blob) {
+      size_t size;
+      void* data = luax_readfile(job->path, &size);
+      lovrAssert(data, "Could not read model from '%s'", job->path);
+      job->blob = lovrBlobCreate(data, size, job->path);
+    }
+
+    ModelData* modelData = lovrModelDataCreate(job->blob, luax_readfile, job->optimize);
+    result.type = TYPE_OBJECT;
+    result.value.object.pointer = modelData;
+    result.value.object.type = "ModelData";
+    result.value.object.destructor = lovrModelDataDestroy;
+  } else {
+    result.type = TYPE_STRING;
+    result.value.string = malloc(strlen(job->error) + 1);
+    if (result.value.string) {
+      strcpy(result.value.string, job->error);
+    } else {
+      result.type = TYPE_NIL;
+    }
+  }
+  lovrSetErrorCallback(NULL, NULL);
+
+  uint64_t id;
+  lovrChannelPush(job->channel, &result, NAN, &id);
+  lovrRelease(job->channel, lovrChannelDestroy);
+  lovrRelease(job->blob, lovrBlobDestroy);
+  free(job->path);
+  free(job);
+}
+
+static int l_lovrDataNewModelDataAsync(lua_State* L) {
+  ModelJob* job = calloc(1, sizeof(ModelJob));
+  lovrAssert(job, "Out of memory");
+
+  if (lua_type(L, 1) == LUA_TUSERDATA) {
+    job->blob = luax_checktype(L, 1, Blob);
+    lovrRetain(job->blob);
+  } else {
+    size_t length;
+    const char* path = luaL_checklstring(L, 1, &length);
+    job->path = malloc(length + 1);
+    lovrAssert(job->path, "Out of memory");
+    memcpy(job->path, path, length + 1);
+  }
+
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "optimize");
+    job->optimize = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  job->channel = lovrChannelCreate(0);
+
+  luax_startpool(L);
+
+  luax_pushtype(L, Channel, job->channel);
+  lovrThreadPoolSubmit(loadModel, job);
+  return 1;
+}
+#endif
+
 static const luaL_Reg lovrData[] = {
   { "newBlob", l_lovrDataNewBlob },
   { "newImage", l_lovrDataNewImage },
+#ifndef LOVR_DISABLE_THREAD
+  { "newImageAsync", l_lovrDataNewImageAsync },
+#endif
   { "newModelData", l_lovrDataNewModelData },
+#ifndef LOVR_DISABLE_THREAD
+  { "newModelDataAsync", l_lovrDataNewModelDataAsync },
+#endif
   { "newRasterizer", l_lovrDataNewRasterizer },
   { "newSound", l_lovrDataNewSound },
+  { "newSoundBank", l_lovrDataNewSoundBank },
+  { "newTemporaryBlob", l_lovrDataNewTemporaryBlob },
   { NULL, NULL }
 };
 
@@ -134,6 +419,7 @@ extern const luaL_Reg lovrImage[];
 extern const luaL_Reg lovrModelData[];
 extern const luaL_Reg lovrRasterizer[];
 extern const luaL_Reg lovrSound[];
+extern const luaL_Reg lovrSoundBank[];
 
 int luaopen_lovr_data(lua_State* L) {
   lua_newtable(L);
@@ -143,5 +429,6 @@ int luaopen_lovr_data(lua_State* L) {
   luax_registertype(L, ModelData);
   luax_registertype(L, Rasterizer);
   luax_registertype(L, Sound);
+  luax_registertype(L, SoundBank);
   return 1;
 }
@@ -3,6 +3,147 @@
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdatomic.h>
+#include <string.h>
+
+// Blobs can be sent to other threads without copying, so typed reads and writes let threads share
+// arrays directly.  Offsets are in bytes.  Plain reads and writes aren't synchronized, the atomic
+// methods work on aligned 32 bit integers.
+typedef enum {
+  TYPE_I8,
+  TYPE_U8,
+  TYPE_I16,
+  TYPE_U16,
+  TYPE_I32,
+  TYPE_U32,
+  TYPE_F32,
+  TYPE_F64
+} ElementType;
+
+static const size_t elementSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+static void checkrange(lua_State* L, Blob* blob, lua_Integer offset, lua_Integer count, size_t size) {
+  lovrAssert(offset >= 0, "Blob offset can not be negative");
+  lovrAssert(count > 0, "Count must be positive");
+  lovrAssert((size_t) offset + count * size <= blob->size, "Tried to access %d bytes at offset %d, but the Blob only has %d bytes", (int) (count * size), (int) offset, (int) blob->size);
+}
+
+static void checkwritable(Blob* blob) {
+  Blob* root = blob;
+  while (root->parent) root = root->parent;
+  lovrAssert(!root->mapped, "Blob is mapped from a file and can not be modified");
+}
+
+static int getElements(lua_State* L, ElementType type) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  lua_Integer offset = luaL_checkinteger(L, 2);
+  lua_Integer count = luaL_optinteger(L, 3, 1);
+  size_t size = elementSizes[type];
+  checkrange(L, blob, offset, count, size);
+  luaL_checkstack(L, (int) count, "Too many values to return, try a smaller count");
+  const char* data = (const char*) blob->data + offset;
+  for (lua_Integer i = 0; i < count; i++, data += size) {
+    union { int8_t i8; uint8_t u8; int16_t i16; uint16_t u16; int32_t i32; uint32_t u32; float f32; double f64; } value;
+    memcpy(&value, data, size);
+    switch (type) {
+      case TYPE_I8: lua_pushinteger(L, value.i8); break;
+      case TYPE_U8: lua_pushinteger(L, value.u8); break;
+      case TYPE_I16: lua_pushinteger(L, value.i16); break;
+      case TYPE_U16: lua_pushinteger(L, value.u16); break;
+      case TYPE_I32: lua_pushinteger(L, value.i32); break;
+      case TYPE_U32: lua_pushnumber(L, value.u32); break;
+      case TYPE_F32: lua_pushnumber(L, value.f32); break;
+      case TYPE_F64: lua_pushnumber(L, value.f64); break;
+    }
+  }
+  return (int) count;
+}
+
+// Values are either varargs or a table
+static int setElements(lua_State* L, ElementType type) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  lua_Integer offset = luaL_checkinteger(L, 2);
+  bool table = lua_istable(L, 3);
+  lua_Integer count = table ? luax_len(L, 3) : lua_gettop(L) - 2;
+  size_t size = elementSizes[type];
+  checkwritable(blob);
+  checkrange(L, blob, offset, count, size);
+  char* data = (char*) blob->data + offset;
+  for (lua_Integer i = 0; i < count; i++, data += size) {
+    if (table) {
+      lua_rawgeti(L, 3, (int) i + 1);
+    }
+    int index = table ? -1 : 3 + (int) i;
+    lua_Number x = luaL_checknumber(L, index);
+    union { int8_t i8; uint8_t u8; int16_t i16; uint16_t u16; int32_t i32; uint32_t u32; float f32; double f64; } value;
+    switch (type) {
+      case TYPE_I8: value.i8 = (int8_t) x; break;
+      case TYPE_U8: value.u8 = (uint8_t) x; break;
+      case TYPE_I16: value.i16 = (int16_t) x; break;
+      case TYPE_U16: value.u16 = (uint16_t) x; break;
+      case TYPE_I32: value.i32 = (int32_t) x; break;
+      case TYPE_U32: value.u32 = (uint32_t) x; break;
+      case TYPE_F32: value.f32 = (float) x; break;
+      case TYPE_F64: value.f64 = x; break;
+    }
+    memcpy(data, &value, size);
+    if (table) {
+      lua_pop(L, 1);
+    }
+  }
+  return 0;
+}
+
+#define ELEMENT_ACCESSORS(T) \
+  static int l_lovrBlobGet##T(lua_State* L) { return getElements(L, TYPE_##T); } \
+  static int l_lovrBlobSet##T(lua_State* L) { return setElements(L, TYPE_##T); }
+
+ELEMENT_ACCESSORS(I8)
+ELEMENT_ACCESSORS(U8)
+ELEMENT_ACCESSORS(I16)
+ELEMENT_ACCESSORS(U16)
+ELEMENT_ACCESSORS(I32)
+ELEMENT_ACCESSORS(U32)
+ELEMENT_ACCESSORS(F32)
+ELEMENT_ACCESSORS(F64)
+
+static atomic_uint* checkatomic(lua_State* L, Blob* blob) {
+  lua_Integer offset = luaL_checkinteger(L, 2);
+  checkwritable(blob);
+  checkrange(L, blob, offset, 1, sizeof(uint32_t));
+  char* address = (char*) blob->data + offset;
+  lovrAssert(((uintptr_t) address & 3) == 0, "Atomic operations need 4 byte alignment");
+  return (atomic_uint*) address;
+}
+
+// Returns the previous value
+static int l_lovrBlobAtomicAdd(lua_State* L) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  atomic_uint* p = checkatomic(L, blob);
+  int32_t x = (int32_t) luaL_checkinteger(L, 3);
+  lua_pushinteger(L, (int32_t) atomic_fetch_add(p, (uint32_t) x));
+  return 1;
+}
+
+static int l_lovrBlobAtomicExchange(lua_State* L) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  atomic_uint* p = checkatomic(L, blob);
+  int32_t x = (int32_t) luaL_checkinteger(L, 3);
+  lua_pushinteger(L, (int32_t) atomic_exchange(p, (uint32_t) x));
+  return 1;
+}
+
+// Returns whether it was swapped, and the value before
+static int l_lovrBlobAtomicCompareExchange(lua_State* L) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  atomic_uint* p = checkatomic(L, blob);
+  uint32_t expected = (uint32_t) (int32_t) luaL_checkinteger(L, 3);
+  uint32_t desired = (uint32_t) (int32_t) luaL_checkinteger(L, 4);
+  bool swapped = atomic_compare_exchange_strong(p, &expected, desired);
+  lua_pushboolean(L, swapped);
+  lua_pushinteger(L, (int32_t) expected);
+  return 2;
+}
 
 static int l_lovrBlobGetName(lua_State* L) {
   Blob* blob = luax_checktype(L, 1, Blob);
@@ -28,10 +169,44 @@ static int l_lovrBlobGetString(lua_State* L) {
   return 1;
 }
 
+// Views share the memory of a range of the Blob without copying it and keep the Blob alive, so
+// they can be passed anywhere a Blob goes.  The size defaults to the rest of the Blob.
+static int l_lovrBlobView(lua_State* L) {
+  Blob* blob = luax_checktype(L, 1, Blob);
+  lua_Integer offset = luaL_optinteger(L, 2, 0);
+  lovrAssert(offset >= 0 && (size_t) offset <= blob->size, "Blob view offset %d is out of range (the Blob has %d bytes)", (int) offset, (int) blob->size);
+  lua_Integer size = luaL_optinteger(L, 3, blob->size - offset);
+  lovrAssert(size >= 0 && (size_t) (offset + size) <= blob->size, "Blob view of %d bytes at offset %d doesn't fit in the Blob (it has %d bytes)", (int) size, (int) offset, (int) blob->size);
+  Blob* view = lovrBlobCreateView(blob, offset, size, blob->name);
+  luax_pushtype(L, Blob, view);
+  lovrRelease(view, lovrBlobDestroy);
+  return 1;
+}
+
 const luaL_Reg lovrBlob[] = {
   { "getName", l_lovrBlobGetName },
   { "getPointer", l_lovrBlobGetPointer },
   { "getSize", l_lovrBlobGetSize },
   { "getString", l_lovrBlobGetString },
+  { "view", l_lovrBlobView },
+  { "getI8", l_lovrBlobGetI8 },
+  { "setI8", l_lovrBlobSetI8 },
+  { "getU8", l_lovrBlobGetU8 },
+  { "setU8", l_lovrBlobSetU8 },
+  { "getI16", l_lovrBlobGetI16 },
+  { "setI16", l_lovrBlobSetI16 },
+  { "getU16", l_lovrBlobGetU16 },
+  { "setU16", l_lovrBlobSetU16 },
+  { "getI32", l_lovrBlobGetI32 },
+  { "setI32", l_lovrBlobSetI32 },
+  { "getU32", l_lovrBlobGetU32 },
+  { "setU32", l_lovrBlobSetU32 },
+  { "getF32", l_lovrBlobGetF32 },
+  { "setF32", l_lovrBlobSetF32 },
+  { "getF64", l_lovrBlobGetF64 },
+  { "setF64", l_lovrBlobSetF64 },
+  { "atomicAdd", l_lovrBlobAtomicAdd },
+  { "atomicExchange", l_lovrBlobAtomicExchange },
+  { "atomicCompareExchange", l_lovrBlobAtomicCompareExchange },
   { NULL, NULL }
 };
@@ -4,9 +4,17 @@
 #include <lua.h>
 #include <lauxlib.h>
 
+StringEntry lovrImageEncoding[] = {
+  [ENCODING_PNG] = ENTRY("png"),
+  [ENCODING_QOI] = ENTRY("qoi"),
+  { 0 }
+};
+
 static int l_lovrImageEncode(lua_State* L) {
   Image* image = luax_checktype(L, 1, Image);
-  Blob* blob = lovrImageEncode(image);
+  ImageEncoding encoding = luax_checkenum(L, 2, ImageEncoding, "png");
+  uint32_t level = luaL_optinteger(L, 3, 1);
+  Blob* blob = lovrImageEncode(image, encoding, level);
   luax_pushtype(L, Blob, blob);
   return 1;
 }
@@ -49,6 +57,33 @@ static int l_lovrImagePaste(lua_State* L) {
   return 0;
 }
 
+static int l_lovrImageConvert(lua_State* L) {
+  Image* image = luax_checktype(L, 1, Image);
+  TextureFormat format = luax_checkenum(L, 2, TextureFormat, NULL);
+  Image* converted = lovrImageConvert(image, format);
+  luax_pushtype(L, Image, converted);
+  lovrRelease(converted, lovrImageDestroy);
+  return 1;
+}
+
+static int l_lovrImagePremultiply(lua_State* L) {
+  Image* image = luax_checktype(L, 1, Image);
+  lovrImagePremultiply(image);
+  return 0;
+}
+
+static int l_lovrImageGammaToLinear(lua_State* L) {
+  Image* image = luax_checktype(L, 1, Image);
+  lovrImageGammaToLinear(image);
+  return 0;
+}
+
+static int l_lovrImageLinearToGamma(lua_State* L) {
+  Image* image = luax_checktype(L, 1, Image);
+  lovrImageLinearToGamma(image);
+  return 0;
+}
+
 static int l_lovrImageGetPixel(lua_State* L) {
   Image* image = luax_checktype(L, 1, Image);
   int x = luaL_checkinteger(L, 2);
@@ -89,6 +124,10 @@ const luaL_Reg lovrImage[] = {
   { "getDimensions", l_lovrImageGetDimensions },
   { "getFormat", l_lovrImageGetFormat },
   { "paste", l_lovrImagePaste },
+  { "convert", l_lovrImageConvert },
+  { "premultiply", l_lovrImagePremultiply },
+  { "gammaToLinear", l_lovrImageGammaToLinear },
+  { "linearToGamma", l_lovrImageLinearToGamma },
   { "getPixel", l_lovrImageGetPixel },
   { "setPixel", l_lovrImageSetPixel },
   { "getBlob", l_lovrImageGetBlob },
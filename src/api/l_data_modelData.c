@@ -1,8 +1,18 @@
 #include "api.h"
 #include "data/modelData.h"
+#include "data/blob.h"
 #include <lua.h>
 #include <lauxlib.h>
 
+static int l_lovrModelDataEncode(lua_State* L) {
+  ModelData* model = luax_checktype(L, 1, ModelData);
+  Blob* blob = lovrModelDataEncode(model);
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  return 1;
+}
+
 const luaL_Reg lovrModelData[] = {
+  { "encode", l_lovrModelDataEncode },
   { NULL, NULL }
 };
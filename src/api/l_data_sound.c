@@ -234,6 +234,21 @@ static int l_lovrSoundSetFrames(lua_State* L) {
   return 1;
 }
 
+static int l_lovrSoundAcquireFrames(lua_State* L) {
+  Sound* sound = luax_checktype(L, 1, Sound);
+  uint32_t count = luaL_optinteger(L, 2, lovrSoundGetFrameCount(sound));
+  Blob* blob = lovrSoundAcquireFrames(sound, count);
+  luax_pushtype(L, Blob, blob);
+  lua_pushinteger(L, blob->size / lovrSoundGetStride(sound));
+  return 2;
+}
+
+static int l_lovrSoundReleaseFrames(lua_State* L) {
+  Sound* sound = luax_checktype(L, 1, Sound);
+  lovrSoundReleaseFrames(sound);
+  return 0;
+}
+
 const luaL_Reg lovrSound[] = {
   { "getBlob", l_lovrSoundGetBlob },
   { "getFormat", l_lovrSoundGetFormat },
@@ -247,5 +262,7 @@ const luaL_Reg lovrSound[] = {
   { "isStream", l_lovrSoundIsStream },
   { "getFrames", l_lovrSoundGetFrames },
   { "setFrames", l_lovrSoundSetFrames },
+  { "acquireFrames", l_lovrSoundAcquireFrames },
+  { "releaseFrames", l_lovrSoundReleaseFrames },
   { NULL, NULL }
 };
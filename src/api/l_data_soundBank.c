@@ -0,0 +1,75 @@
+#include "api.h"
+#include "data/soundBank.h"
+#include "data/sound.h"
+#include "data/blob.h"
+#include "core/util.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static uint32_t luax_checkbankindex(lua_State* L, int index, SoundBank* bank) {
+  if (lua_type(L, index) == LUA_TSTRING) {
+    size_t length;
+    const char* name = lua_tolstring(L, index, &length);
+    uint32_t i = lovrSoundBankFind(bank, name, length);
+    lovrAssert(i != BANK_NONE, "SoundBank has no Sound named '%s'", name);
+    return i;
+  } else {
+    return luaL_checkinteger(L, index) - 1;
+  }
+}
+
+static int l_lovrSoundBankGetBlob(lua_State* L) {
+  SoundBank* bank = luax_checktype(L, 1, SoundBank);
+  Blob* blob = lovrSoundBankGetBlob(bank);
+  luax_pushtype(L, Blob, blob);
+  return 1;
+}
+
+static int l_lovrSoundBankGetCount(lua_State* L) {
+  SoundBank* bank = luax_checktype(L, 1, SoundBank);
+  lua_pushinteger(L, lovrSoundBankGetCount(bank));
+  return 1;
+}
+
+static int l_lovrSoundBankGetName(lua_State* L) {
+  SoundBank* bank = luax_checktype(L, 1, SoundBank);
+  uint32_t index = luaL_checkinteger(L, 2) - 1;
+  lua_pushstring(L, lovrSoundBankGetName(bank, index));
+  return 1;
+}
+
+static int l_lovrSoundBankHasSound(lua_State* L) {
+  SoundBank* bank = luax_checktype(L, 1, SoundBank);
+  size_t length;
+  const char* name = luaL_checklstring(L, 2, &length);
+  lua_pushboolean(L, lovrSoundBankFind(bank, name, length) != BANK_NONE);
+  return 1;
+}
+
+static int l_lovrSoundBankGetSound(lua_State* L) {
+  SoundBank* bank = luax_checktype(L, 1, SoundBank);
+  uint32_t index = luax_checkbankindex(L, 2, bank);
+  Sound* sound = lovrSoundBankGetSound(bank, index);
+  luax_pushtype(L, Sound, sound);
+  return 1;
+}
+
+static int l_lovrSoundBankGetLoop(lua_State* L) {
+  SoundBank* bank = luax_checktype(L, 1, SoundBank);
+  uint32_t index = luax_checkbankindex(L, 2, bank);
+  uint32_t start, end;
+  lovrSoundBankGetLoop(bank, index, &start, &end);
+  lua_pushinteger(L, start);
+  lua_pushinteger(L, end);
+  return 2;
+}
+
+const luaL_Reg lovrSoundBank[] = {
+  { "getBlob", l_lovrSoundBankGetBlob },
+  { "getCount", l_lovrSoundBankGetCount },
+  { "getName", l_lovrSoundBankGetName },
+  { "hasSound", l_lovrSoundBankHasSound },
+  { "getSound", l_lovrSoundBankGetSound },
+  { "getLoop", l_lovrSoundBankGetLoop },
+  { NULL, NULL }
+};
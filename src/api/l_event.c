@@ -1,6 +1,7 @@
 #include "api.h"
 #include "event/event.h"
 #include "thread/thread.h"
+#include "filesystem/filesystem.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
@@ -19,11 +20,197 @@ StringEntry lovrEventType[] = {
   [EVENT_THREAD_ERROR] = ENTRY("threaderror"),
 #endif
   [EVENT_PERMISSION] = ENTRY("permission"),
+  [EVENT_FILECHANGED] = ENTRY("filechanged"),
   { 0 }
 };
 
 static LOVR_THREAD_LOCAL int pollRef;
 
+// Tables are serialized into a single allocation, measured first so it never has to grow, which
+// also means bad values are caught before any objects are retained.  Objects are stored by index
+// into an array after the data, so destroying the Variant doesn't have to parse anything.  Keys in
+// the sequence part of a table aren't written, only the values.
+enum {
+  TAG_FALSE,
+  TAG_TRUE,
+  TAG_NUMBER,
+  TAG_STRING,
+  TAG_OBJECT,
+  TAG_TABLE
+};
+
+#define MAX_TABLE_DEPTH 32
+
+typedef struct {
+  char* data; // NULL while measuring
+  size_t size;
+  Variant* objects;
+  uint32_t objectCount;
+} Encoder;
+
+static void checkobject(lua_State* L, int index, Variant* variant) {
+  variant->type = TYPE_OBJECT;
+  Proxy* proxy = lua_touserdata(L, index);
+  lua_getmetatable(L, index);
+
+  lua_pushliteral(L, "__info");
+  lua_rawget(L, -2);
+  TypeInfo* info = lua_touserdata(L, -1);
+  variant->value.object.type = info->name;
+  variant->value.object.destructor = info->destructor;
+  lua_pop(L, 1);
+
+  // Variants are how objects get to other threads
+  variant->value.object.pointer = proxy->object;
+  lovrShare(proxy->object);
+  lovrRetain(proxy->object);
+  lua_pop(L, 1);
+}
+
+static void encodeBytes(Encoder* encoder, const void* data, size_t size) {
+  if (encoder->data) {
+    memcpy(encoder->data + encoder->size, data, size);
+  }
+  encoder->size += size;
+}
+
+static void encodeTag(Encoder* encoder, uint8_t tag) {
+  encodeBytes(encoder, &tag, 1);
+}
+
+static bool isSequenceKey(lua_State* L, int index, uint32_t length) {
+  if (lua_type(L, index) != LUA_TNUMBER) {
+    return false;
+  }
+  lua_Number key = lua_tonumber(L, index);
+  return key >= 1 && key <= length && key == (uint32_t) key;
+}
+
+static void encode(lua_State* L, int index, Encoder* encoder, int depth) {
+  switch (lua_type(L, index)) {
+    case LUA_TBOOLEAN:
+      encodeTag(encoder, lua_toboolean(L, index) ? TAG_TRUE : TAG_FALSE);
+      break;
+
+    case LUA_TNUMBER: {
+      lua_Number number = lua_tonumber(L, index);
+      encodeTag(encoder, TAG_NUMBER);
+      encodeBytes(encoder, &number, sizeof(number));
+      break;
+    }
+
+    case LUA_TSTRING: {
+      size_t length;
+      const char* string = lua_tolstring(L, index, &length);
+      uint32_t length32 = (uint32_t) length;
+      encodeTag(encoder, TAG_STRING);
+      encodeBytes(encoder, &length32, sizeof(length32));
+      encodeBytes(encoder, string, length);
+      break;
+    }
+
+    case LUA_TUSERDATA: {
+      uint32_t object = encoder->objectCount++;
+      encodeTag(encoder, TAG_OBJECT);
+      encodeBytes(encoder, &object, sizeof(object));
+      if (encoder->data) {
+        checkobject(L, index, &encoder->objects[object]);
+      }
+      break;
+    }
+
+    case LUA_TTABLE: {
+      lovrAssert(depth < MAX_TABLE_DEPTH, "Table is nested too deeply to send (it might contain itself)");
+      luaL_checkstack(L, 3, "Table is nested too deeply to send");
+      uint32_t length = 0;
+      for (;;) {
+        lua_rawgeti(L, index, length + 1);
+        bool nil = lua_isnil(L, -1);
+        lua_pop(L, 1);
+        if (nil) break;
+        length++;
+      }
+
+      uint32_t count = 0;
+      encodeTag(encoder, TAG_TABLE);
+      encodeBytes(encoder, &length, sizeof(length));
+      size_t countOffset = encoder->size;
+      encodeBytes(encoder, &count, sizeof(count));
+
+      for (uint32_t i = 1; i <= length; i++) {
+        lua_rawgeti(L, index, i);
+        encode(L, lua_gettop(L), encoder, depth + 1);
+        lua_pop(L, 1);
+      }
+
+      lua_pushnil(L);
+      while (lua_next(L, index)) {
+        if (!isSequenceKey(L, -2, length)) {
+          int top = lua_gettop(L);
+          encode(L, top - 1, encoder, depth + 1);
+          encode(L, top, encoder, depth + 1);
+          count++;
+        }
+        lua_pop(L, 1);
+      }
+
+      if (encoder->data) {
+        memcpy(encoder->data + countOffset, &count, sizeof(count));
+      }
+      break;
+    }
+
+    default:
+      lovrThrow("Bad variant type in table: %s", luaL_typename(L, index));
+  }
+}
+
+static const char* decode(lua_State* L, const char* cursor, Variant* objects) {
+  uint8_t tag = *cursor++;
+  switch (tag) {
+    case TAG_FALSE: lua_pushboolean(L, false); return cursor;
+    case TAG_TRUE: lua_pushboolean(L, true); return cursor;
+    case TAG_NUMBER: {
+      lua_Number number;
+      memcpy(&number, cursor, sizeof(number));
+      lua_pushnumber(L, number);
+      return cursor + sizeof(number);
+    }
+    case TAG_STRING: {
+      uint32_t length;
+      memcpy(&length, cursor, sizeof(length));
+      cursor += sizeof(length);
+      lua_pushlstring(L, cursor, length);
+      return cursor + length;
+    }
+    case TAG_OBJECT: {
+      uint32_t object;
+      memcpy(&object, cursor, sizeof(object));
+      luax_pushvariant(L, &objects[object]);
+      return cursor + sizeof(object);
+    }
+    case TAG_TABLE: {
+      uint32_t length, count;
+      memcpy(&length, cursor, sizeof(length));
+      memcpy(&count, cursor + sizeof(length), sizeof(count));
+      cursor += sizeof(length) + sizeof(count);
+      luaL_checkstack(L, 3, "Table is nested too deeply");
+      lua_createtable(L, length, count);
+      for (uint32_t i = 1; i <= length; i++) {
+        cursor = decode(L, cursor, objects);
+        lua_rawseti(L, -2, i);
+      }
+      for (uint32_t i = 0; i < count; i++) {
+        cursor = decode(L, cursor, objects);
+        cursor = decode(L, cursor, objects);
+        lua_rawset(L, -3);
+      }
+      return cursor;
+    }
+    default: lovrThrow("Corrupt table in variant");
+  }
+}
+
 void luax_checkvariant(lua_State* L, int index, Variant* variant) {
   int type = lua_type(L, index);
   switch (type) {
@@ -42,31 +229,41 @@ void luax_checkvariant(lua_State* L, int index, Variant* variant) {
       variant->value.number = lua_tonumber(L, index);
       break;
 
-    case LUA_TSTRING:
-      variant->type = TYPE_STRING;
+    case LUA_TSTRING: {
       size_t length;
       const char* string = lua_tolstring(L, index, &length);
+      if (length < sizeof(variant->value.ministring.data)) {
+        variant->type = TYPE_MINISTRING;
+        variant->value.ministring.length = (uint8_t) length;
+        memcpy(variant->value.ministring.data, string, length);
+        break;
+      }
+      variant->type = TYPE_STRING;
       variant->value.string = malloc(length + 1);
       lovrAssert(variant->value.string, "Out of memory");
       memcpy(variant->value.string, string, length);
       variant->value.string[length] = '\0';
       break;
+    }
+
+    case LUA_TTABLE: {
+      index = index > 0 ? index : lua_gettop(L) + index + 1;
+      Encoder encoder = { 0 };
+      encode(L, index, &encoder, 0);
+      size_t objectOffset = ALIGN(encoder.size, 8);
+      char* data = malloc(objectOffset + encoder.objectCount * sizeof(Variant));
+      lovrAssert(data, "Out of memory");
+      encoder = (Encoder) { .data = data, .objects = (Variant*) (data + objectOffset) };
+      encode(L, index, &encoder, 0);
+      variant->type = TYPE_TABLE;
+      variant->value.table.data = data;
+      variant->value.table.size = (uint32_t) encoder.size;
+      variant->value.table.objectCount = encoder.objectCount;
+      break;
+    }
 
     case LUA_TUSERDATA:
-      variant->type = TYPE_OBJECT;
-      Proxy* proxy = lua_touserdata(L, index);
-      lua_getmetatable(L, index);
-
-      lua_pushliteral(L, "__info");
-      lua_rawget(L, -2);
-      TypeInfo* info = lua_touserdata(L, -1);
-      variant->value.object.type = info->name;
-      variant->value.object.destructor = info->destructor;
-      lua_pop(L, 1);
-
-      variant->value.object.pointer = proxy->object;
-      lovrRetain(proxy->object);
-      lua_pop(L, 1);
+      checkobject(L, index, variant);
       break;
 
     default:
@@ -81,18 +278,19 @@ int luax_pushvariant(lua_State* L, Variant* variant) {
     case TYPE_BOOLEAN: lua_pushboolean(L, variant->value.boolean); return 1;
     case TYPE_NUMBER: lua_pushnumber(L, variant->value.number); return 1;
     case TYPE_STRING: lua_pushstring(L, variant->value.string); return 1;
+    case TYPE_MINISTRING: lua_pushlstring(L, variant->value.ministring.data, variant->value.ministring.length); return 1;
+    case TYPE_TABLE: {
+      Variant* objects = (Variant*) (variant->value.table.data + ALIGN(variant->value.table.size, 8));
+      decode(L, variant->value.table.data, objects);
+      return 1;
+    }
     case TYPE_OBJECT: _luax_pushtype(L, variant->value.object.type, hash64(variant->value.object.type, strlen(variant->value.object.type)), variant->value.object.pointer); return 1;
     default: return 0;
   }
 }
 
-static int nextEvent(lua_State* L) {
-  Event event;
-
-  if (!lovrEventPoll(&event)) {
-    return 0;
-  }
-
+// Pushes the name and values of an event, taking ownership of its data
+static int pushEvent(lua_State* L, Event event) {
   if (event.type == EVENT_CUSTOM) {
     lua_pushstring(L, event.data.custom.name);
   } else {
@@ -142,6 +340,11 @@ static int nextEvent(lua_State* L) {
       lua_pushboolean(L, event.data.permission.granted);
       return 3;
 
+    case EVENT_FILECHANGED:
+      lua_pushstring(L, event.data.file.path);
+      free(event.data.file.path);
+      return 2;
+
     case EVENT_CUSTOM:
       for (uint32_t i = 0; i < event.data.custom.count; i++) {
         Variant* variant = &event.data.custom.data[i];
@@ -155,6 +358,57 @@ static int nextEvent(lua_State* L) {
   }
 }
 
+static int nextEvent(lua_State* L) {
+  Event event;
+
+  if (!lovrEventPoll(&event)) {
+    return 0;
+  }
+
+  return pushEvent(L, event);
+}
+
+// Fills a table with a table for each event, reusing the ones that are already there, so polling
+// every frame doesn't make garbage.  Stale events after the last one are left for reuse, but the
+// entry after the last event is cleared so ipairs still works.
+static int l_lovrEventPollBatch(lua_State* L) {
+  if (lua_istable(L, 1)) {
+    lua_settop(L, 1);
+  } else {
+    lua_settop(L, 0);
+    lua_createtable(L, lovrEventGetCount(), 0);
+  }
+
+  Event event;
+  int count = 0;
+  while (lovrEventPoll(&event)) {
+    lua_rawgeti(L, 1, ++count);
+    if (!lua_istable(L, -1)) {
+      lua_pop(L, 1);
+      lua_createtable(L, 5, 0);
+      lua_pushvalue(L, -1);
+      lua_rawseti(L, 1, count);
+    }
+
+    int entry = lua_gettop(L);
+    int previous = luax_len(L, entry);
+    int n = pushEvent(L, event);
+    for (int i = n; i >= 1; i--) {
+      lua_rawseti(L, entry, i);
+    }
+    for (int i = n + 1; i <= previous; i++) {
+      lua_pushnil(L);
+      lua_rawseti(L, entry, i);
+    }
+    lua_pop(L, 1);
+  }
+
+  lua_pushnil(L);
+  lua_rawseti(L, 1, count + 1);
+  lua_pushinteger(L, count);
+  return 2;
+}
+
 static int l_lovrEventClear(lua_State* L) {
   lovrEventClear();
   return 0;
@@ -165,8 +419,21 @@ static int l_lovrEventPoll(lua_State* L) {
   return 1;
 }
 
+#ifndef LOVR_DISABLE_FILESYSTEM
+static void pushFileEvent(void* context, const char* path) {
+  size_t length = strlen(path);
+  char* copy = malloc(length + 1);
+  if (!copy) return;
+  memcpy(copy, path, length + 1);
+  lovrEventPush((Event) { .type = EVENT_FILECHANGED, .data.file.path = copy });
+}
+#endif
+
 static int l_lovrEventPump(lua_State* L) {
   lovrEventPump();
+#ifndef LOVR_DISABLE_FILESYSTEM
+  lovrFilesystemPollChanges(pushFileEvent, NULL);
+#endif
   return 0;
 }
 
@@ -199,6 +466,7 @@ static int l_lovrEventRestart(lua_State* L) {
 static const luaL_Reg lovrEvent[] = {
   { "clear", l_lovrEventClear },
   { "poll", l_lovrEventPoll },
+  { "pollBatch", l_lovrEventPollBatch },
   { "pump", l_lovrEventPump },
   { "push", l_lovrEventPush },
   { "quit", l_lovrEventQuit },
@@ -0,0 +1,104 @@
+#include "api.h"
+#include "core/maf.h"
+#include "core/util.h"
+#include <lua.h>
+#include <lauxlib.h>
+#ifndef LOVR_DISABLE_GRAPHICS
+#include "graphics/graphics.h"
+#endif
+#ifndef LOVR_DISABLE_PHYSICS
+#include "physics/physics.h"
+#endif
+#include "resources/ffi.lua.h"
+
+// Plain C entry points for hot functions, called from ffi.lua through LuaJIT's FFI.  LuaJIT can
+// compile FFI calls into traces, unlike calls through the Lua C API.  Arguments are already
+// defaulted on the Lua side, objects are passed as the pointer inside their Proxy, and results are
+// written to a float array.
+
+#ifndef LOVR_DISABLE_GRAPHICS
+LOVR_EXPORT void lovr_ffi_graphics_push(void) {
+  lovrGraphicsPush();
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_pop(void) {
+  lovrGraphicsPop();
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_origin(void) {
+  lovrGraphicsOrigin();
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_translate(float x, float y, float z) {
+  float translation[4] = { x, y, z };
+  lovrGraphicsTranslate(translation);
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_rotate(float angle, float ax, float ay, float az) {
+  float rotation[4];
+  quat_fromAngleAxis(rotation, angle, ax, ay, az);
+  lovrGraphicsRotate(rotation);
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_scale(float x, float y, float z) {
+  float scale[4] = { x, y, z };
+  lovrGraphicsScale(scale);
+}
+
+// Same transform as luax_readmat4 builds from numbers
+static void getTransform(mat4 m, float x, float y, float z, float sx, float sy, float sz, float angle, float ax, float ay, float az) {
+  mat4_identity(m);
+  mat4_translate(m, x, y, z);
+  mat4_rotate(m, angle, ax, ay, az);
+  mat4_scale(m, sx, sy, sz);
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_box(int style, float x, float y, float z, float sx, float sy, float sz, float angle, float ax, float ay, float az) {
+  float transform[16];
+  getTransform(transform, x, y, z, sx, sy, sz, angle, ax, ay, az);
+  lovrGraphicsBox(style == STYLE_LINE ? STYLE_LINE : STYLE_FILL, NULL, transform);
+}
+
+LOVR_EXPORT void lovr_ffi_graphics_sphere(float x, float y, float z, float radius, float angle, float ax, float ay, float az, int segments) {
+  float transform[16];
+  getTransform(transform, x, y, z, radius, radius, radius, angle, ax, ay, az);
+  lovrGraphicsSphere(NULL, transform, segments);
+}
+#endif
+
+#ifndef LOVR_DISABLE_PHYSICS
+LOVR_EXPORT void lovr_ffi_collider_get_pose(Collider* collider, float* pose) {
+  float orientation[4];
+  lovrColliderGetPosition(collider, &pose[0], &pose[1], &pose[2]);
+  lovrColliderGetOrientation(collider, orientation);
+  quat_getAngleAxis(orientation, &pose[3], &pose[4], &pose[5], &pose[6]);
+}
+
+LOVR_EXPORT void lovr_ffi_collider_set_position(Collider* collider, float x, float y, float z) {
+  lovrColliderSetPosition(collider, x, y, z);
+}
+
+LOVR_EXPORT void lovr_ffi_collider_set_orientation(Collider* collider, float angle, float ax, float ay, float az) {
+  float orientation[4];
+  quat_fromAngleAxis(orientation, angle, ax, ay, az);
+  lovrColliderSetOrientation(collider, orientation);
+}
+
+LOVR_EXPORT void lovr_ffi_collider_get_linear_velocity(Collider* collider, float* velocity) {
+  lovrColliderGetLinearVelocity(collider, &velocity[0], &velocity[1], &velocity[2]);
+}
+
+LOVR_EXPORT void lovr_ffi_collider_set_linear_velocity(Collider* collider, float x, float y, float z) {
+  lovrColliderSetLinearVelocity(collider, x, y, z);
+}
+#endif
+
+// Replaces the functions of loaded modules with FFI versions, see ffi.lua
+int luax_installffi(lua_State* L) {
+  if (luaL_loadbuffer(L, (const char*) src_resources_ffi_lua, src_resources_ffi_lua_len, "@ffi.lua")) {
+    return lua_error(L);
+  }
+  lua_getglobal(L, "lovr");
+  lua_call(L, 1, 0);
+  return 0;
+}
@@ -9,6 +9,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef LOVR_DISABLE_THREAD
+#include "event/event.h"
+#include "thread/channel.h"
+#include "thread/pool.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <math.h>
+#endif
+
 void* luax_readfile(const char* filename, size_t* bytesRead) {
   return lovrFilesystemRead(filename, -1, bytesRead);
 }
@@ -32,6 +41,23 @@ Blob* luax_readblob(lua_State* L, int index, const char* debug) {
   }
 }
 
+// Like luax_readblob, but memory maps the file when possible (copy-on-write).
+Blob* luax_mapblob(lua_State* L, int index, const char* debug) {
+  if (lua_type(L, index) == LUA_TSTRING) {
+    const char* path = lua_tostring(L, index);
+
+    size_t size;
+    void* data = lovrFilesystemMap(path, &size);
+    if (data) {
+      Blob* blob = lovrBlobCreate(data, size, path);
+      blob->mapped = true;
+      return blob;
+    }
+  }
+
+  return luax_readblob(L, index, debug);
+}
+
 static void pushDirectoryItem(void* context, const char* path) {
   lua_State* L = context;
 
@@ -58,7 +84,86 @@ static void pushDirectoryItem(void* context, const char* path) {
   lua_pop(L, 1);
 }
 
+// Compiled chunks can be cached in the save directory, tagged with the size and modification time
+// of their source so edited files get compiled again.  Bytecode from a different Lua or LuaJIT
+// build fails to load and gets replaced.
+typedef struct {
+  char magic[8];
+  uint64_t size;
+  uint64_t modified;
+  uint32_t version;
+  uint32_t pointerSize;
+} BytecodeHeader;
+
+typedef arr_t(char) arr_char_t;
+
+static bool bytecodeCache;
+
+static BytecodeHeader getBytecodeHeader(const char* path) {
+  return (BytecodeHeader) {
+    .magic = "LOVRBC",
+    .size = lovrFilesystemGetSize(path),
+    .modified = lovrFilesystemGetLastModified(path),
+    .version = LUA_VERSION_NUM,
+    .pointerSize = sizeof(void*)
+  };
+}
+
+static bool loadBytecode(lua_State* L, const char* path, const char* cachePath, const char* debug) {
+  size_t size;
+  char* data = lovrFilesystemIsFile(cachePath) ? luax_readfile(cachePath, &size) : NULL;
+  if (!data) {
+    return false;
+  }
+
+  BytecodeHeader header = getBytecodeHeader(path);
+  bool valid = size > sizeof(header) && !memcmp(data, &header, sizeof(header));
+  if (valid && luaL_loadbuffer(L, data + sizeof(header), size - sizeof(header), debug)) {
+    lua_pop(L, 1);
+    valid = false;
+  }
+
+  free(data);
+  return valid;
+}
+
+static int writeBytecode(lua_State* L, const void* data, size_t size, void* userdata) {
+  arr_append((arr_char_t*) userdata, (const char*) data, size);
+  return 0;
+}
+
+// Dumps the function on the top of the stack, which is left there
+static void saveBytecode(lua_State* L, const char* path, const char* cachePath) {
+  arr_char_t buffer;
+  arr_init(&buffer, realloc);
+  BytecodeHeader header = getBytecodeHeader(path);
+  arr_append(&buffer, (const char*) &header, sizeof(header));
+
+#if LUA_VERSION_NUM >= 503
+  int status = lua_dump(L, writeBytecode, &buffer, 0);
+#else
+  int status = lua_dump(L, writeBytecode, &buffer);
+#endif
+
+  if (status == 0) {
+    char directory[LOVR_PATH_MAX];
+    strcpy(directory, cachePath);
+    char* slash = strrchr(directory, '/');
+    if (slash) *slash = '\0';
+    lovrFilesystemCreateDirectory(directory);
+    lovrFilesystemWrite(cachePath, buffer.data, buffer.length, false);
+  }
+
+  arr_free(&buffer);
+}
+
 static int luax_loadfile(lua_State* L, const char* path, const char* debug) {
+  char cachePath[LOVR_PATH_MAX];
+  bool cache = bytecodeCache && snprintf(cachePath, sizeof(cachePath), ".bytecode/%s", path) < (int) sizeof(cachePath);
+  if (cache && loadBytecode(L, path, cachePath, debug)) {
+    return 1;
+  }
+
   size_t size;
   void* buffer = luax_readfile(path, &size);
   if (!buffer) {
@@ -71,7 +176,9 @@ static int luax_loadfile(lua_State* L, const char* path, const char* debug) {
   switch (status) {
     case LUA_ERRMEM: return luaL_error(L, "Memory allocation error: %s", lua_tostring(L, -1));
     case LUA_ERRSYNTAX: return luaL_error(L, "Syntax error: %s", lua_tostring(L, -1));
-    default: return 1;
+    default:
+      if (cache) saveBytecode(L, path, cachePath);
+      return 1;
   }
 }
 
@@ -111,6 +218,21 @@ static int l_lovrFilesystemGetAppdataDirectory(lua_State* L) {
 }
 
 
+static int l_lovrFilesystemIsBytecodeCacheEnabled(lua_State* L) {
+  lua_pushboolean(L, bytecodeCache);
+  return 1;
+}
+
+static int l_lovrFilesystemSetBytecodeCacheEnabled(lua_State* L) {
+  bytecodeCache = lua_toboolean(L, 1);
+  return 0;
+}
+
+static int l_lovrFilesystemGetCacheLimit(lua_State* L) {
+  lua_pushinteger(L, lovrFilesystemGetCacheLimit());
+  return 1;
+}
+
 static int l_lovrFilesystemGetDirectoryItems(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   lua_settop(L, 1);
@@ -269,30 +391,76 @@ static int l_lovrFilesystemMount(lua_State* L) {
 static int l_lovrFilesystemNewBlob(lua_State* L) {
   size_t size;
   const char* path = luaL_checkstring(L, 1);
-  uint8_t* data = luax_readfile(path, &size);
-  lovrAssert(data, "Could not load file '%s'", path);
+  bool mapped = false;
+
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "mapped");
+    mapped = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  // Files that can't be mapped (compressed zip entries) are read instead
+  void* data = mapped ? lovrFilesystemMap(path, &size) : NULL;
+  if (!data) {
+    mapped = false;
+    data = luax_readfile(path, &size);
+    lovrAssert(data, "Could not load file '%s'", path);
+  }
+
   Blob* blob = lovrBlobCreate(data, size, path);
+  blob->mapped = mapped;
+
   luax_pushtype(L, Blob, blob);
   lovrRelease(blob, lovrBlobDestroy);
   return 1;
 }
 
+static int l_lovrFilesystemPreload(lua_State* L) {
+  bool table = lua_istable(L, 1);
+  uint32_t count = table ? luax_len(L, 1) : lua_gettop(L);
+  const char** paths = lua_newuserdata(L, count * sizeof(const char*));
+
+  // The strings stay alive while they're referenced by the table or the stack
+  for (uint32_t i = 0; i < count; i++) {
+    if (table) {
+      lua_rawgeti(L, 1, i + 1);
+      paths[i] = luaL_checkstring(L, -1);
+      lua_pop(L, 1);
+    } else {
+      paths[i] = luaL_checkstring(L, i + 1);
+    }
+  }
+
+#ifndef LOVR_DISABLE_THREAD
+  luax_startpool(L);
+#endif
+  lovrFilesystemPreload(paths, count);
+  return 0;
+}
+
 static int l_lovrFilesystemRead(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   lua_Integer luaSize = luaL_optinteger(L, 2, -1);
   size_t size = MAX(luaSize, -1);
   size_t bytesRead;
-  void* content = lovrFilesystemRead(path, size, &bytesRead);
+  temp_mark_t mark = temp_mark();
+  void* content = lovrFilesystemReadTemp(path, size, &bytesRead);
   if (!content) {
+    temp_rewind(mark);
     lua_pushnil(L);
     return 1;
   }
   lua_pushlstring(L, content, bytesRead);
+  temp_rewind(mark);
   lua_pushinteger(L, bytesRead);
-  free(content);
   return 2;
 }
 
+static int l_lovrFilesystemRefresh(lua_State* L) {
+  lovrFilesystemRefresh(luaL_optstring(L, 1, NULL));
+  return 0;
+}
+
 static int l_lovrFilesystemRemove(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   lua_pushboolean(L, lovrFilesystemRemove(path));
@@ -306,6 +474,13 @@ static int l_lovrFilesystemSetIdentity(lua_State* L) {
   return 0;
 }
 
+static int l_lovrFilesystemSetCacheLimit(lua_State* L) {
+  lua_Integer limit = luaL_checkinteger(L, 1);
+  lovrAssert(limit >= 0, "Cache limit can not be negative");
+  lovrFilesystemSetCacheLimit(limit);
+  return 0;
+}
+
 static int l_lovrFilesystemSetRequirePath(lua_State* L) {
   lovrFilesystemSetRequirePath(luaL_checkstring(L, 1));
   return 0;
@@ -317,6 +492,16 @@ static int l_lovrFilesystemUnmount(lua_State* L) {
   return 1;
 }
 
+static int l_lovrFilesystemUnwatch(lua_State* L) {
+  lovrFilesystemUnwatch();
+  return 0;
+}
+
+static int l_lovrFilesystemWatch(lua_State* L) {
+  lua_pushboolean(L, lovrFilesystemWatch());
+  return 1;
+}
+
 static int l_lovrFilesystemWrite(lua_State* L) {
   const char* path = luaL_checkstring(L, 1);
   size_t size;
@@ -334,10 +519,167 @@ static int l_lovrFilesystemWrite(lua_State* L) {
   return 1;
 }
 
+#ifndef LOVR_DISABLE_THREAD
+// Async IO runs on the thread pool and reports back on a Channel.  Writes go through a queue that
+// is drained by one job at a time, so they happen in the order they were requested.
+
+typedef struct IOJob {
+  struct IOJob* next;
+  char* path;
+  Blob* blob;
+  char* data;
+  size_t size;
+  bool append;
+  Channel* channel;
+} IOJob;
+
+static struct {
+  atomic_flag lock;
+  IOJob* head;
+  IOJob* tail;
+  bool draining;
+} io;
+
+static IOJob* newJob(lua_State* L) {
+  size_t length;
+  const char* path = luaL_checklstring(L, 1, &length);
+  IOJob* job = calloc(1, sizeof(IOJob));
+  lovrAssert(job, "Out of memory");
+  job->path = malloc(length + 1);
+  lovrAssert(job->path, "Out of memory");
+  memcpy(job->path, path, length + 1);
+  job->channel = lovrChannelCreate(0);
+  return job;
+}
+
+static void finishJob(IOJob* job, Variant* result) {
+  uint64_t id;
+  lovrChannelPush(job->channel, result, NAN, &id);
+  lovrRelease(job->channel, lovrChannelDestroy);
+  lovrRelease(job->blob, lovrBlobDestroy);
+  free(job->data);
+  free(job->path);
+  free(job);
+}
+
+static void readFile(void* arg) {
+  IOJob* job = arg;
+  Variant result;
+  size_t size;
+  size_t length = strlen(job->path);
+  char* data = luax_readfile(job->path, &size);
+  char* buffer = data ? realloc(data, size + length + 1) : NULL;
+
+  // The Blob's name is stored after its data, so it's freed along with it
+  if (buffer) {
+    memcpy(buffer + size, job->path, length + 1);
+    result.type = TYPE_OBJECT;
+    result.value.object.pointer = lovrBlobCreate(buffer, size, buffer + size);
+    result.value.object.type = "Blob";
+    result.value.object.destructor = lovrBlobDestroy;
+  } else {
+    free(data);
+    result.type = TYPE_STRING;
+    result.value.string = malloc(length + 32);
+    if (result.value.string) {
+      sprintf(result.value.string, "Could not read file '%s'", job->path);
+    } else {
+      result.type = TYPE_NIL;
+    }
+  }
+
+  finishJob(job, &result);
+}
+
+static void writeFiles(void* arg) {
+  for (;;) {
+    while (atomic_flag_test_and_set_explicit(&io.lock, memory_order_acquire));
+    IOJob* job = io.head;
+    if (job) {
+      io.head = job->next;
+      io.tail = io.head ? io.tail : NULL;
+    } else {
+      io.draining = false;
+    }
+    atomic_flag_clear_explicit(&io.lock, memory_order_release);
+
+    if (!job) {
+      return;
+    }
+
+    const char* data = job->blob ? job->blob->data : job->data;
+    size_t written = lovrFilesystemWrite(job->path, data, job->size, job->append);
+    Variant result = { .type = TYPE_NUMBER, .value.number = written };
+    finishJob(job, &result);
+  }
+}
+
+static int luax_writeasync(lua_State* L, bool append) {
+  Blob* blob = luax_totype(L, 2, Blob);
+  if (!blob && lua_type(L, 2) != LUA_TSTRING) {
+    return luax_typeerror(L, 2, "string or Blob");
+  }
+
+  IOJob* job = newJob(L);
+  job->append = append;
+
+  if (blob) {
+    job->blob = blob;
+    job->size = blob->size;
+    lovrRetain(blob);
+  } else {
+    const char* data = lua_tolstring(L, 2, &job->size);
+    job->data = malloc(job->size);
+    lovrAssert(job->data || job->size == 0, "Out of memory");
+    memcpy(job->data, data, job->size);
+  }
+
+  luax_startpool(L);
+  luax_pushtype(L, Channel, job->channel);
+
+  while (atomic_flag_test_and_set_explicit(&io.lock, memory_order_acquire));
+  if (io.tail) {
+    io.tail->next = job;
+  } else {
+    io.head = job;
+  }
+  io.tail = job;
+  bool submit = !io.draining;
+  io.draining = true;
+  atomic_flag_clear_explicit(&io.lock, memory_order_release);
+
+  if (submit) {
+    lovrThreadPoolSubmit(writeFiles, NULL);
+  }
+
+  return 1;
+}
+
+static int l_lovrFilesystemAppendAsync(lua_State* L) {
+  return luax_writeasync(L, true);
+}
+
+static int l_lovrFilesystemReadAsync(lua_State* L) {
+  IOJob* job = newJob(L);
+  luax_startpool(L);
+  luax_pushtype(L, Channel, job->channel);
+  lovrThreadPoolSubmit(readFile, job);
+  return 1;
+}
+
+static int l_lovrFilesystemWriteAsync(lua_State* L) {
+  return luax_writeasync(L, false);
+}
+#endif
+
 static const luaL_Reg lovrFilesystem[] = {
   { "append", l_lovrFilesystemAppend },
+#ifndef LOVR_DISABLE_THREAD
+  { "appendAsync", l_lovrFilesystemAppendAsync },
+#endif
   { "createDirectory", l_lovrFilesystemCreateDirectory },
   { "getAppdataDirectory", l_lovrFilesystemGetAppdataDirectory },
+  { "getCacheLimit", l_lovrFilesystemGetCacheLimit },
   { "getDirectoryItems", l_lovrFilesystemGetDirectoryItems },
   { "getExecutablePath", l_lovrFilesystemGetExecutablePath },
   { "getIdentity", l_lovrFilesystemGetIdentity },
@@ -350,17 +692,30 @@ static const luaL_Reg lovrFilesystem[] = {
   { "getUserDirectory", l_lovrFilesystemGetUserDirectory },
   { "getWorkingDirectory", l_lovrFilesystemGetWorkingDirectory },
   { "isDirectory", l_lovrFilesystemIsDirectory },
+  { "isBytecodeCacheEnabled", l_lovrFilesystemIsBytecodeCacheEnabled },
   { "isFile", l_lovrFilesystemIsFile },
   { "isFused", l_lovrFilesystemIsFused },
   { "load", l_lovrFilesystemLoad },
   { "mount", l_lovrFilesystemMount },
   { "newBlob", l_lovrFilesystemNewBlob },
+  { "preload", l_lovrFilesystemPreload },
   { "read", l_lovrFilesystemRead },
+#ifndef LOVR_DISABLE_THREAD
+  { "readAsync", l_lovrFilesystemReadAsync },
+#endif
+  { "refresh", l_lovrFilesystemRefresh },
   { "remove", l_lovrFilesystemRemove },
+  { "setBytecodeCacheEnabled", l_lovrFilesystemSetBytecodeCacheEnabled },
+  { "setCacheLimit", l_lovrFilesystemSetCacheLimit },
   { "setRequirePath", l_lovrFilesystemSetRequirePath },
   { "setIdentity", l_lovrFilesystemSetIdentity },
   { "unmount", l_lovrFilesystemUnmount },
+  { "unwatch", l_lovrFilesystemUnwatch },
+  { "watch", l_lovrFilesystemWatch },
   { "write", l_lovrFilesystemWrite },
+#ifndef LOVR_DISABLE_THREAD
+  { "writeAsync", l_lovrFilesystemWriteAsync },
+#endif
   { NULL, NULL }
 };
 
@@ -1,10 +1,14 @@
 #include "api.h"
 #include "graphics/graphics.h"
+#include "graphics/atlas.h"
 #include "graphics/buffer.h"
 #include "graphics/canvas.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
 #include "graphics/model.h"
+#include "graphics/particles.h"
+#include "graphics/postProcess.h"
+#include "graphics/virtualTexture.h"
 #include "graphics/shader.h"
 #include "data/blob.h"
 #include "data/modelData.h"
@@ -89,6 +93,11 @@ StringEntry lovrDefaultShader[] = {
   [SHADER_PANO] = ENTRY("pano"),
   [SHADER_FONT] = ENTRY("font"),
   [SHADER_FILL] = ENTRY("screenspace"),
+  [SHADER_LINE] = ENTRY("line"),
+  [SHADER_MASK] = ENTRY("mask"),
+  [SHADER_PARTICLE] = ENTRY("particle"),
+  [SHADER_VIRTUAL] = ENTRY("virtual"),
+  [SHADER_FEEDBACK] = ENTRY("feedback"),
   { 0 }
 };
 
@@ -146,6 +155,14 @@ StringEntry lovrMaterialTexture[] = {
   { 0 }
 };
 
+StringEntry lovrPostEffect[] = {
+  [POST_BLOOM] = ENTRY("bloom"),
+  [POST_TONEMAP] = ENTRY("tonemap"),
+  [POST_GRADE] = ENTRY("grade"),
+  [POST_VIGNETTE] = ENTRY("vignette"),
+  { 0 }
+};
+
 StringEntry lovrShaderType[] = {
   [SHADER_GRAPHICS] = ENTRY("graphics"),
   [SHADER_COMPUTE] = ENTRY("compute"),
@@ -306,16 +323,29 @@ static void stencilCallback(void* userdata) {
   lua_call(L, 0, 0);
 }
 
-// Must be released when done
-static Image* luax_checkimage(lua_State* L, int index, bool flip) {
+static void passCallback(void* userdata) {
+  lua_State* L = userdata;
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  lua_pushvalue(L, 2);
+  lua_call(L, 0, 0);
+}
+
+// Must be released when done.  If source isn't NULL, it's set to the Blob the Image was decoded
+// from, which also has to be released (it's NULL if an Image was passed in).
+static Image* luax_checkimage(lua_State* L, int index, bool flip, Blob** source) {
   Image* image = luax_totype(L, index, Image);
 
   if (image) {
     lovrRetain(image);
+    if (source) *source = NULL;
   } else {
-    Blob* blob = luax_readblob(L, index, "Texture");
+    Blob* blob = luax_mapblob(L, index, "Texture");
     image = lovrImageCreateFromBlob(blob, flip);
-    lovrRelease(blob, lovrBlobDestroy);
+    if (source) {
+      *source = blob;
+    } else {
+      lovrRelease(blob, lovrBlobDestroy);
+    }
   }
 
   return image;
@@ -324,7 +354,18 @@ static Image* luax_checkimage(lua_State* L, int index, bool flip) {
 // Base
 
 static int l_lovrGraphicsPresent(lua_State* L) {
-  lovrGraphicsPresent();
+  bool swap = lua_isnoneornil(L, 1) || lua_toboolean(L, 1);
+  lovrGraphicsPresent(swap);
+  return 0;
+}
+
+static int l_lovrGraphicsIsFramePacing(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsFramePacing());
+  return 1;
+}
+
+static int l_lovrGraphicsSetFramePacing(lua_State* L) {
+  lovrGraphicsSetFramePacing(lua_toboolean(L, 1));
   return 0;
 }
 
@@ -358,6 +399,10 @@ static int l_lovrGraphicsCreateWindow(lua_State* L) {
   flags.msaa = lua_tointeger(L, -1);
   lua_pop(L, 1);
 
+  lua_getfield(L, 1, "headless");
+  flags.headless = lua_toboolean(L, -1);
+  lua_pop(L, 1);
+
   lua_getfield(L, 1, "title");
   flags.title = luaL_optstring(L, -1, "LÖVR");
   lua_pop(L, 1);
@@ -365,7 +410,7 @@ static int l_lovrGraphicsCreateWindow(lua_State* L) {
   lua_getfield(L, 1, "icon");
   Image* image = NULL;
   if (!lua_isnil(L, -1)) {
-    image = luax_checkimage(L, -1, false);
+    image = luax_checkimage(L, -1, false, NULL);
     flags.icon.data = image->blob->data;
     flags.icon.width = image->width;
     flags.icon.height = image->height;
@@ -376,6 +421,10 @@ static int l_lovrGraphicsCreateWindow(lua_State* L) {
   flags.vsync = lua_tointeger(L, -1);
   lua_pop(L, 1);
 
+  lua_getfield(L, 1, "pacing");
+  flags.pacing = lua_toboolean(L, -1);
+  lua_pop(L, 1);
+
   lovrGraphicsCreateWindow(&flags);
   luax_atexit(L, lovrGraphicsDestroy); // The lua_State that creates the window shall be the one to destroy it
   lovrRelease(image, lovrImageDestroy);
@@ -499,6 +548,31 @@ static int l_lovrGraphicsSetProjection(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsPrecompileShaders(lua_State* L) {
+  lovrGraphicsPrecompileShaders();
+  return 0;
+}
+
+static int l_lovrGraphicsCapture(lua_State* L) {
+  Canvas* canvas = lua_isnoneornil(L, 1) ? NULL : luax_checktype(L, 1, Canvas);
+  lua_pushinteger(L, lovrGraphicsCapture(canvas));
+  return 1;
+}
+
+static int l_lovrGraphicsGetCapture(lua_State* L) {
+  bool wait = lua_toboolean(L, 1);
+  uint32_t id;
+  Image* image;
+  if (!lovrGraphicsGetCapture(wait, &id, &image)) {
+    lua_pushnil(L);
+    return 1;
+  }
+  lua_pushinteger(L, id);
+  luax_pushtype(L, Image, image);
+  lovrRelease(image, lovrImageDestroy);
+  return 2;
+}
+
 static int l_lovrGraphicsTick(lua_State* L) {
   const char* label = luaL_checkstring(L, 1);
   lovrGraphicsTick(label);
@@ -512,6 +586,56 @@ static int l_lovrGraphicsTock(lua_State* L) {
   return 1;
 }
 
+static int l_lovrGraphicsPushProfile(lua_State* L) {
+  const char* label = luaL_checkstring(L, 1);
+  lovrGraphicsPushProfile(label);
+  return 0;
+}
+
+static int l_lovrGraphicsPopProfile(lua_State* L) {
+  lovrGraphicsPopProfile();
+  return 0;
+}
+
+// Returns the scopes of a recent frame as a tree, with times in milliseconds
+static int l_lovrGraphicsGetProfile(lua_State* L) {
+  uint32_t count;
+  const GpuProfileScope* scopes = lovrGraphicsGetProfile(&count);
+  lua_newtable(L);
+  lua_createtable(L, count, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    const GpuProfileScope* scope = &scopes[i];
+    lua_createtable(L, 0, 6);
+    lua_pushstring(L, scope->label);
+    lua_setfield(L, -2, "label");
+    lua_pushnumber(L, scope->cpuTime * 1e3);
+    lua_setfield(L, -2, "cpu");
+    lua_pushnumber(L, scope->gpuTime * 1e3);
+    lua_setfield(L, -2, "gpu");
+    lua_pushinteger(L, scope->drawCalls);
+    lua_setfield(L, -2, "drawcalls");
+    lua_pushinteger(L, scope->shaderSwitches);
+    lua_setfield(L, -2, "shaderswitches");
+    lua_newtable(L);
+    lua_setfield(L, -2, "children");
+
+    if (scope->parent == ~0u) {
+      lua_pushvalue(L, -1);
+      lua_rawseti(L, -4, luax_len(L, -4) + 1);
+    } else {
+      lua_rawgeti(L, -2, scope->parent + 1);
+      lua_getfield(L, -1, "children");
+      lua_pushvalue(L, -3);
+      lua_rawseti(L, -2, luax_len(L, -2) + 1);
+      lua_pop(L, 2);
+    }
+
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_pop(L, 1);
+  return 1;
+}
+
 static int l_lovrGraphicsGetFeatures(lua_State* L) {
   const GpuFeatures* features = lovrGraphicsGetFeatures();
   lua_newtable(L);
@@ -521,6 +645,8 @@ static int l_lovrGraphicsGetFeatures(lua_State* L) {
   lua_setfield(L, -2, "compute");
   lua_pushboolean(L, features->dxt);
   lua_setfield(L, -2, "dxt");
+  lua_pushboolean(L, features->indirect);
+  lua_setfield(L, -2, "indirect");
   lua_pushboolean(L, features->instancedStereo);
   lua_setfield(L, -2, "instancedstereo");
   lua_pushboolean(L, features->multiview);
@@ -554,12 +680,37 @@ static int l_lovrGraphicsGetLimits(lua_State* L) {
   return 1;
 }
 
+static const char* flushReasons[] = {
+  [FLUSH_STREAM] = "stream",
+  [FLUSH_BATCH_LIMIT] = "batchlimit",
+  [FLUSH_CANVAS] = "canvas",
+  [FLUSH_SHADER] = "shader",
+  [FLUSH_MATERIAL] = "material",
+  [FLUSH_MESH] = "mesh",
+  [FLUSH_BUFFER] = "buffer",
+  [FLUSH_STENCIL] = "stencil",
+  [FLUSH_OTHER] = "other"
+};
+
+static const char* streamNames[] = {
+  [STREAM_VERTEX] = "vertex",
+  [STREAM_DRAWID] = "drawid",
+  [STREAM_GLYPH] = "glyph",
+  [STREAM_INDEX] = "index",
+  [STREAM_MODEL] = "model",
+  [STREAM_COLOR] = "color",
+  [STREAM_MATERIAL] = "material",
+  [STREAM_FRAME] = "frame",
+  [STREAM_POSE] = "pose",
+  [STREAM_LIGHT] = "light"
+};
+
 static int l_lovrGraphicsGetStats(lua_State* L) {
   if (lua_gettop(L) > 0) {
     luaL_checktype(L, 1, LUA_TTABLE);
     lua_settop(L, 1);
   } else {
-    lua_createtable(L, 0, 7);
+    lua_createtable(L, 0, 16);
   }
 
   lovrGraphicsFlush();
@@ -578,9 +729,54 @@ static int l_lovrGraphicsGetStats(lua_State* L) {
   lua_setfield(L, 1, "buffermemory");
   lua_pushinteger(L, stats->textureMemory);
   lua_setfield(L, 1, "texturememory");
+  lua_pushinteger(L, stats->textureEvictions);
+  lua_setfield(L, 1, "textureevictions");
+  lua_pushinteger(L, stats->textureRestores);
+  lua_setfield(L, 1, "texturerestores");
+  lua_pushinteger(L, stats->vertices);
+  lua_setfield(L, 1, "vertices");
+  lua_pushinteger(L, stats->triangles);
+  lua_setfield(L, 1, "triangles");
+  lua_pushinteger(L, stats->textureUploadBytes);
+  lua_setfield(L, 1, "textureuploads");
+  lua_pushinteger(L, stats->bufferUploadBytes);
+  lua_setfield(L, 1, "bufferuploads");
+  lua_pushinteger(L, stats->uniformUploadBytes);
+  lua_setfield(L, 1, "uniformuploads");
+
+  lua_createtable(L, 0, MAX_FLUSH_REASONS);
+  for (int i = 0; i < MAX_FLUSH_REASONS; i++) {
+    lua_pushinteger(L, stats->flushes[i]);
+    lua_setfield(L, -2, flushReasons[i]);
+  }
+  lua_setfield(L, 1, "flushes");
+
+  lua_createtable(L, 0, MAX_STREAMS);
+  for (int i = 0; i < MAX_STREAMS; i++) {
+    lua_pushinteger(L, stats->streamBytes[i]);
+    lua_setfield(L, -2, streamNames[i]);
+  }
+  lua_setfield(L, 1, "streams");
   return 1;
 }
 
+static int l_lovrGraphicsGetTextureBudget(lua_State* L) {
+  uint64_t budget = lovrGraphicsGetTextureBudget();
+  if (budget == 0) {
+    lua_pushnil(L);
+  } else {
+    lua_pushnumber(L, (double) budget);
+  }
+  return 1;
+}
+
+static int l_lovrGraphicsSetTextureBudget(lua_State* L) {
+  double budget = luaL_optnumber(L, 1, 0.);
+  lovrAssert(budget >= 0., "Texture budget can not be negative");
+  lovrGraphicsSetTextureBudget((uint64_t) budget);
+  return 0;
+}
+
 // State
 
 static int l_lovrGraphicsReset(lua_State* L) {
@@ -767,6 +963,26 @@ static int l_lovrGraphicsSetShader(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsIsSortingEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsSortingEnabled());
+  return 1;
+}
+
+static int l_lovrGraphicsSetSortingEnabled(lua_State* L) {
+  lovrGraphicsSetSortingEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
+static int l_lovrGraphicsIsDepthPrepassEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsDepthPrepassEnabled());
+  return 1;
+}
+
+static int l_lovrGraphicsSetDepthPrepassEnabled(lua_State* L) {
+  lovrGraphicsSetDepthPrepassEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
 static int l_lovrGraphicsGetStencilTest(lua_State* L) {
   CompareMode mode;
   int value;
@@ -853,6 +1069,28 @@ static int l_lovrGraphicsTransform(lua_State* L) {
   return 0;
 }
 
+// Lights
+
+static int l_lovrGraphicsAddLight(lua_State* L) {
+  float position[4];
+  Color color;
+  int index = luax_readvec3(L, 1, position, NULL);
+  float radius = luax_checkfloat(L, index++);
+  luax_readcolor(L, index, &color);
+  lovrGraphicsAddLight(position, radius, color);
+  return 0;
+}
+
+static int l_lovrGraphicsClearLights(lua_State* L) {
+  lovrGraphicsClearLights();
+  return 0;
+}
+
+static int l_lovrGraphicsGetLightCount(lua_State* L) {
+  lua_pushinteger(L, lovrGraphicsGetLightCount());
+  return 1;
+}
+
 // Rendering
 
 static int l_lovrGraphicsClear(lua_State* L) {
@@ -912,11 +1150,86 @@ static int l_lovrGraphicsDiscard(lua_State* L) {
   return 0;
 }
 
+static int l_lovrGraphicsPass(lua_State* L) {
+  Canvas* canvas = luax_checktype(L, 1, Canvas);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  Pass pass = { .clearColor = lovrGraphicsGetBackgroundColor(), .clearDepth = 1.f };
+
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "clear");
+    if (lua_istable(L, -1)) {
+      luax_readcolor(L, lua_gettop(L), &pass.clearColor);
+      pass.clear[0] = pass.clear[1] = pass.clear[2] = true;
+    } else {
+      pass.clear[0] = pass.clear[1] = pass.clear[2] = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, 3, "discard");
+    if (lua_istable(L, -1)) {
+      lua_getfield(L, -1, "color");
+      lua_getfield(L, -2, "depth");
+      lua_getfield(L, -3, "stencil");
+      pass.discard[0] = lua_toboolean(L, -3);
+      pass.discard[1] = lua_toboolean(L, -2);
+      pass.discard[2] = lua_toboolean(L, -1);
+      lua_pop(L, 3);
+    } else if (!lua_isnil(L, -1)) {
+      pass.discard[1] = pass.discard[2] = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+
+    lua_getfield(L, 3, "reads");
+    if (lua_istable(L, -1)) {
+      int count = luax_len(L, -1);
+      for (int i = 1; i <= count; i++) {
+        lua_rawgeti(L, -1, i);
+        Texture* textures[MAX_CANVAS_ATTACHMENTS + 1];
+        uint32_t textureCount = 0;
+        Canvas* source = luax_totype(L, -1, Canvas);
+        if (source) {
+          uint32_t attachmentCount;
+          const Attachment* attachments = lovrCanvasGetAttachments(source, &attachmentCount);
+          for (uint32_t j = 0; j < attachmentCount; j++) {
+            textures[textureCount++] = attachments[j].texture;
+          }
+          if (lovrCanvasGetDepthTexture(source)) {
+            textures[textureCount++] = lovrCanvasGetDepthTexture(source);
+          }
+        } else {
+          textures[textureCount++] = luax_checktype(L, -1, Texture);
+        }
+        lovrAssert(pass.readCount + textureCount <= MAX_PASS_READS, "A pass can read from at most %d Textures", MAX_PASS_READS);
+        memcpy(pass.reads + pass.readCount, textures, textureCount * sizeof(Texture*));
+        pass.readCount += textureCount;
+        lua_pop(L, 1);
+      }
+    }
+    lua_pop(L, 1);
+  }
+
+  lua_settop(L, 2);
+  lovrGraphicsPass(canvas, &pass, passCallback, L);
+  return 0;
+}
+
 static int l_lovrGraphicsFlush(lua_State* L) {
   lovrGraphicsFlush();
   return 0;
 }
 
+static int l_lovrGraphicsStartTrace(lua_State* L) {
+  lovrGraphicsStartTrace();
+  return 0;
+}
+
+static int l_lovrGraphicsStopTrace(lua_State* L) {
+  Blob* blob = lovrGraphicsStopTrace();
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  return 1;
+}
+
 static int l_lovrGraphicsPoints(lua_State* L) {
   float* vertices;
   uint32_t count = luax_getvertexcount(L, 1);
@@ -1041,6 +1354,15 @@ static int l_lovrGraphicsSkybox(lua_State* L) {
 }
 
 static int l_lovrGraphicsPrint(lua_State* L) {
+  Text* text = luax_totype(L, 1, Text);
+  if (text) {
+    float transform[16];
+    int index = luax_readmat4(L, 2, transform, 1);
+    VerticalAlign valign = luax_checkenum(L, index, VerticalAlign, "middle");
+    lovrGraphicsPrintText(text, transform, valign);
+    return 0;
+  }
+
   size_t length;
   const char* str = luaL_checklstring(L, 1, &length);
   float transform[16];
@@ -1080,6 +1402,47 @@ static int l_lovrGraphicsFill(lua_State* L) {
   return 0;
 }
 
+// The animations, times, and weights can be tables with a value for each Model, or a single value
+// that is used for all of them
+static int l_lovrGraphicsAnimateModels(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  uint32_t count = luax_len(L, 1);
+  Model** models = lua_newuserdata(L, count * sizeof(Model*));
+  AnimationLayer* layers = lua_newuserdata(L, count * sizeof(AnimationLayer));
+
+  for (uint32_t i = 0; i < count; i++) {
+    lua_rawgeti(L, 1, i + 1);
+    models[i] = luax_checktype(L, -1, Model);
+    lua_pop(L, 1);
+
+    for (int j = 2; j <= 4; j++) {
+      if (lua_istable(L, j)) {
+        lua_rawgeti(L, j, i + 1);
+      } else {
+        lua_pushvalue(L, j);
+      }
+    }
+
+    layers[i].animation = luax_checkanimation(L, -3, models[i]);
+    layers[i].time = luax_checkfloat(L, -2);
+    layers[i].weight = luax_optfloat(L, -1, 1.f);
+    lua_pop(L, 3);
+  }
+
+  lovrModelAnimateAll(models, layers, count);
+  lua_pop(L, 2);
+  return 0;
+}
+
+static int l_lovrGraphicsDrawIndirect(lua_State* L) {
+  Mesh* mesh = luax_checktype(L, 1, Mesh);
+  ShaderBlock* block = luax_checktype(L, 2, ShaderBlock);
+  size_t offset = luaL_optinteger(L, 3, 0);
+  uint32_t count = luaL_optinteger(L, 4, 1);
+  lovrGraphicsDrawIndirect(mesh, lovrShaderBlockGetBuffer(block), offset, count);
+  return 0;
+}
+
 static int l_lovrGraphicsCompute(lua_State* L) {
   Shader* shader = luax_checktype(L, 1, Shader);
   int x = luaL_optinteger(L, 2, 1);
@@ -1120,6 +1483,33 @@ static void luax_checkuniformtype(lua_State* L, int index, UniformType* baseType
   }
 }
 
+static int l_lovrGraphicsNewAtlas(lua_State* L) {
+  uint32_t width = luaL_checkinteger(L, 1);
+  uint32_t height = luaL_optinteger(L, 2, width);
+  uint32_t layers = 1;
+  uint32_t padding = 1;
+  bool srgb = true;
+
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "layers");
+    layers = luaL_optinteger(L, -1, layers);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 3, "padding");
+    padding = luaL_optinteger(L, -1, padding);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 3, "linear");
+    srgb = lua_isnil(L, -1) ? srgb : !lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  Atlas* atlas = lovrAtlasCreate(width, height, layers, padding, srgb);
+  luax_pushtype(L, Atlas, atlas);
+  lovrRelease(atlas, lovrAtlasDestroy);
+  return 1;
+}
+
 static int l_lovrGraphicsNewCanvas(lua_State* L) {
   Attachment attachments[MAX_CANVAS_ATTACHMENTS];
   int attachmentCount = 0;
@@ -1225,6 +1615,7 @@ static int l_lovrGraphicsNewFont(lua_State* L) {
   Rasterizer* rasterizer = luax_totype(L, 1, Rasterizer);
   uint32_t padding = 2;
   double spread = 4.;
+  int index;
 
   if (!rasterizer) {
     Blob* blob = NULL;
@@ -1234,11 +1625,13 @@ static int l_lovrGraphicsNewFont(lua_State* L) {
       size = luaL_optinteger(L, 1, 32);
       padding = luaL_optinteger(L, 2, padding);
       spread = luaL_optnumber(L, 3, spread);
+      index = 4;
     } else {
-      blob = luax_readblob(L, 1, "Font");
+      blob = luax_mapblob(L, 1, "Font");
       size = luaL_optinteger(L, 2, 32);
       padding = luaL_optinteger(L, 3, padding);
       spread = luaL_optnumber(L, 4, spread);
+      index = 5;
     }
 
     rasterizer = lovrRasterizerCreate(blob, size);
@@ -1246,9 +1639,11 @@ static int l_lovrGraphicsNewFont(lua_State* L) {
   } else {
     padding = luaL_optinteger(L, 2, padding);
     spread = luaL_optnumber(L, 3, spread);
+    index = 4;
   }
 
-  Font* font = lovrFontCreate(rasterizer, padding, spread);
+  TextureFormat format = luax_checkenum(L, index, TextureFormat, "rgba16f");
+  Font* font = lovrFontCreate(rasterizer, padding, spread, format);
   luax_pushtype(L, Font, font);
   lovrRelease(rasterizer, lovrRasterizerDestroy);
   lovrRelease(font, lovrFontDestroy);
@@ -1261,7 +1656,7 @@ static int l_lovrGraphicsNewMaterial(lua_State* L) {
   int index = 1;
 
   if (lua_type(L, index) == LUA_TSTRING) {
-    Blob* blob = luax_readblob(L, index++, "Texture");
+    Blob* blob = luax_mapblob(L, index++, "Texture");
     Image* image = lovrImageCreateFromBlob(blob, true);
     Texture* texture = lovrTextureCreate(TEXTURE_2D, &image, 1, true, true, 0);
     lovrMaterialSetTexture(material, TEXTURE_DIFFUSE, texture);
@@ -1356,9 +1751,19 @@ static int l_lovrGraphicsNewMesh(lua_State* L) {
     }
   }
 
+  uint8_t types[MAX_ATTRIBUTES * 8];
+  uint32_t components = 0;
+  for (int i = 0; i < attributeCount; i++) {
+    for (unsigned j = 0; j < attributes[i].components; j++) {
+      types[components++] = attributes[i].type;
+    }
+  }
+
   if (blob) {
     lovrAssert(blob->size / stride < UINT32_MAX, "Too many vertices in Blob");
     count = (uint32_t) (blob->size / stride);
+  } else if (dataIndex) {
+    count = luax_getmeshvertexcount(L, dataIndex, components);
   }
 
   DrawMode mode = luax_checkenum(L, drawModeIndex, DrawMode, "fan");
@@ -1391,30 +1796,7 @@ static int l_lovrGraphicsNewMesh(lua_State* L) {
     if (blob) {
       memcpy(data.raw, blob->data, count * stride);
     } else {
-      for (uint32_t i = 0; i < count; i++) {
-        lua_rawgeti(L, dataIndex, i + 1);
-        lovrAssert(lua_istable(L, -1), "Vertices should be specified as a table of tables");
-
-        int component = 0;
-        for (int j = 0; j < attributeCount; j++) {
-          MeshAttribute* attribute = &attributes[j];
-          for (unsigned k = 0; k < attribute->components; k++) {
-            lua_rawgeti(L, -1, ++component);
-            switch (attribute->type) {
-              case I8: *data.i8++ = luaL_optinteger(L, -1, 0); break;
-              case U8: *data.u8++ = luaL_optinteger(L, -1, 0); break;
-              case I16: *data.i16++ = luaL_optinteger(L, -1, 0); break;
-              case U16: *data.u16++ = luaL_optinteger(L, -1, 0); break;
-              case I32: *data.i32++ = luaL_optinteger(L, -1, 0); break;
-              case U32: *data.u32++ = luaL_optinteger(L, -1, 0); break;
-              case F32: *data.f32++ = luaL_optnumber(L, -1, 0.); break;
-            }
-            lua_pop(L, 1);
-          }
-        }
-
-        lua_pop(L, 1);
-      }
+      luax_readmeshvertices(L, dataIndex, data.raw, types, components, count);
     }
 
     lovrBufferFlush(vertexBuffer, 0, count * stride);
@@ -1431,21 +1813,98 @@ static int l_lovrGraphicsNewMesh(lua_State* L) {
 static int l_lovrGraphicsNewModel(lua_State* L) {
   ModelData* modelData = luax_totype(L, 1, ModelData);
 
+  bool streamTextures = false;
+  bool optimize = false;
+  bool quantize = false;
+  if (lua_istable(L, 2)) {
+    lua_getfield(L, 2, "streaming");
+    streamTextures = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "quantize");
+    quantize = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 2, "optimize");
+    optimize = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+#ifndef LOVR_DISABLE_THREAD
+    lua_getfield(L, 2, "threaded");
+    if (lua_toboolean(L, -1)) {
+      luax_startpool(L);
+    }
+    lua_pop(L, 1);
+#endif
+  }
+
   if (!modelData) {
-    Blob* blob = luax_readblob(L, 1, "Model");
-    modelData = lovrModelDataCreate(blob, luax_readfile);
+    Blob* blob = luax_mapblob(L, 1, "Model");
+    modelData = lovrModelDataCreate(blob, luax_readfile, optimize);
     lovrRelease(blob, lovrBlobDestroy);
   } else {
     lovrRetain(modelData);
   }
 
-  Model* model = lovrModelCreate(modelData);
+  Model* model = lovrModelCreate(modelData, streamTextures, quantize);
   luax_pushtype(L, Model, model);
   lovrRelease(modelData, lovrModelDataDestroy);
   lovrRelease(model, lovrModelDestroy);
   return 1;
 }
 
+static int l_lovrGraphicsNewParticleSystem(lua_State* L) {
+  uint32_t capacity = luaL_checkinteger(L, 1);
+  ParticleSystem* particles = lovrParticleSystemCreate(capacity);
+  luax_pushtype(L, ParticleSystem, particles);
+  lovrRelease(particles, lovrParticleSystemDestroy);
+  return 1;
+}
+
+static int l_lovrGraphicsNewDrawList(lua_State* L) {
+  DrawList* list = lovrDrawListCreate();
+  luax_pushtype(L, DrawList, list);
+  lovrRelease(list, lovrDrawListDestroy);
+  return 1;
+}
+
+static int l_lovrGraphicsNewPostProcess(lua_State* L) {
+  PostProcess* post = lovrPostProcessCreate();
+  luax_pushtype(L, PostProcess, post);
+  lovrRelease(post, lovrPostProcessDestroy);
+  return 1;
+}
+
+static int l_lovrGraphicsNewVirtualTexture(lua_State* L) {
+  uint32_t width = luaL_checkinteger(L, 1);
+  uint32_t height = luaL_checkinteger(L, 2);
+  const char* pattern = luaL_checkstring(L, 3);
+  VirtualTextureInfo info = { .tileSize = 128, .border = 4, .pages = 16, .feedbackScale = 8 };
+
+  if (lua_istable(L, 4)) {
+    lua_getfield(L, 4, "tileSize");
+    info.tileSize = lua_isnil(L, -1) ? info.tileSize : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 4, "border");
+    info.border = lua_isnil(L, -1) ? info.border : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 4, "pages");
+    info.pages = lua_isnil(L, -1) ? info.pages : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 4, "feedbackScale");
+    info.feedbackScale = lua_isnil(L, -1) ? info.feedbackScale : luaL_checkinteger(L, -1);
+    lua_pop(L, 1);
+  }
+
+  VirtualTexture* texture = lovrVirtualTextureCreate(width, height, pattern, &info);
+  luax_pushtype(L, VirtualTexture, texture);
+  lovrRelease(texture, lovrVirtualTextureDestroy);
+  return 1;
+}
+
 static const char* luax_readshadersource(lua_State* L, int index, int *outLength) {
   if (lua_isnoneornil(L, index)) {
     return NULL;
@@ -1541,6 +2000,7 @@ static int l_lovrGraphicsNewShader(lua_State* L) {
     const char* vertexSource = luax_readshadersource(L, 1, &vertexSourceLength);
     int fragmentSourceLength;
     const char* fragmentSource = luax_readshadersource(L, 2, &fragmentSourceLength);
+    bool async = false;
 
     if (lua_istable(L, 3)) {
       lua_getfield(L, 3, "flags");
@@ -1550,9 +2010,13 @@ static int l_lovrGraphicsNewShader(lua_State* L) {
       lua_getfield(L, 3, "stereo");
       multiview = lua_isnil(L, -1) ? multiview : lua_toboolean(L, -1);
       lua_pop(L, 1);
+
+      lua_getfield(L, 3, "async");
+      async = lua_toboolean(L, -1);
+      lua_pop(L, 1);
     }
 
-    shader = lovrShaderCreateGraphics(vertexSource, vertexSourceLength, fragmentSource, fragmentSourceLength, flags, flagCount, multiview);
+    shader = lovrShaderCreateGraphics(vertexSource, vertexSourceLength, fragmentSource, fragmentSourceLength, flags, flagCount, multiview, async);
   }
 
   luax_pushtype(L, Shader, shader);
@@ -1617,6 +2081,7 @@ static int l_lovrGraphicsNewShaderBlock(lua_State* L) {
 
   BufferUsage usage = USAGE_DYNAMIC;
   bool readable = false;
+  bool persistent = false;
 
   if (lua_istable(L, 3)) {
     lua_getfield(L, 3, "usage");
@@ -1626,11 +2091,17 @@ static int l_lovrGraphicsNewShaderBlock(lua_State* L) {
     lua_getfield(L, 3, "readable");
     readable = lua_toboolean(L, -1);
     lua_pop(L, 1);
+
+    lua_getfield(L, 3, "persistent");
+    persistent = lua_toboolean(L, -1);
+    lua_pop(L, 1);
   }
 
   lovrAssert(type == BLOCK_UNIFORM || lovrGraphicsGetFeatures()->compute, "Compute blocks are not supported on this system");
+  lovrAssert(!persistent || !readable, "Persistent ShaderBlocks can not be readable");
   size_t size = lovrShaderComputeUniformLayout(&uniforms);
-  Buffer* buffer = lovrBufferCreate(size, NULL, type == BLOCK_COMPUTE ? BUFFER_SHADER_STORAGE : BUFFER_UNIFORM, usage, readable);
+  BufferType bufferType = type == BLOCK_COMPUTE ? BUFFER_SHADER_STORAGE : BUFFER_UNIFORM;
+  Buffer* buffer = persistent ? lovrBufferCreatePersistent(size, bufferType) : lovrBufferCreate(size, NULL, bufferType, usage, readable);
   ShaderBlock* block = lovrShaderBlockCreate(type, buffer, &uniforms);
   luax_pushtype(L, ShaderBlock, block);
   arr_free(&uniforms);
@@ -1668,6 +2139,7 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
   bool srgb = !blank;
   bool mipmaps = true;
   TextureFormat format = FORMAT_RGBA;
+  TextureFormat compress = FORMAT_RGBA;
   int msaa = 0;
 
   if (hasFlags) {
@@ -1690,8 +2162,20 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
     lua_getfield(L, index, "msaa");
     msaa = lua_isnil(L, -1) ? msaa : luaL_checkinteger(L, -1);
     lua_pop(L, 1);
+
+    lua_getfield(L, index, "compress");
+    if (lua_type(L, -1) == LUA_TBOOLEAN) {
+      compress = lua_toboolean(L, -1) ? FORMAT_DXT5 : compress;
+    } else if (!lua_isnil(L, -1)) {
+      compress = luax_checkenum(L, -1, TextureFormat, NULL);
+    }
+    lua_pop(L, 1);
   }
 
+  bool compressing = compress != FORMAT_RGBA;
+  lovrAssert(!compressing || lovrGraphicsGetFeatures()->dxt, "DXT compression is not supported on this system");
+  lovrAssert(!compressing || !blank, "Only Textures created from Images can be compressed");
+  lovrAssert(!compressing || compress == FORMAT_DXT1 || compress == FORMAT_DXT5, "Textures can only be compressed to dxt1 or dxt5");
   Texture* texture = lovrTextureCreate(type, NULL, 0, srgb, mipmaps, msaa);
   lovrTextureSetFilter(texture, lovrGraphicsGetDefaultFilter());
 
@@ -1712,11 +2196,21 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
 
     for (int i = 0; i < depth; i++) {
       lua_rawgeti(L, 1, i + 1);
-      Image* image = luax_checkimage(L, -1, type != TEXTURE_CUBE);
+      Blob* source;
+      Image* image = luax_checkimage(L, -1, type != TEXTURE_CUBE, &source);
+      if (compressing && (image->format == FORMAT_RGB || image->format == FORMAT_RGBA)) {
+        Image* compressed = lovrImageCompress(image, compress, mipmaps);
+        lovrRelease(image, lovrImageDestroy);
+        image = compressed;
+      }
       if (i == 0) {
         lovrTextureAllocate(texture, image->width, image->height, depth, image->format);
       }
       lovrTextureReplacePixels(texture, image, 0, 0, i, 0);
+      if (source && !compressing && depth == 1) {
+        lovrTextureSetSource(texture, source, type != TEXTURE_CUBE);
+      }
+      lovrRelease(source, lovrBlobDestroy);
       lovrRelease(image, lovrImageDestroy);
       lua_pop(L, 1);
     }
@@ -1731,6 +2225,8 @@ static const luaL_Reg lovrGraphics[] = {
 
   // Base
   { "present", l_lovrGraphicsPresent },
+  { "isFramePacing", l_lovrGraphicsIsFramePacing },
+  { "setFramePacing", l_lovrGraphicsSetFramePacing },
   { "createWindow", l_lovrGraphicsCreateWindow },
   { "getWidth", l_lovrGraphicsGetWidth },
   { "getHeight", l_lovrGraphicsGetHeight },
@@ -1741,11 +2237,19 @@ static const luaL_Reg lovrGraphics[] = {
   { "setViewPose", l_lovrGraphicsSetViewPose },
   { "getProjection", l_lovrGraphicsGetProjection },
   { "setProjection", l_lovrGraphicsSetProjection },
+  { "precompileShaders", l_lovrGraphicsPrecompileShaders },
+  { "capture", l_lovrGraphicsCapture },
+  { "getCapture", l_lovrGraphicsGetCapture },
   { "tick", l_lovrGraphicsTick },
   { "tock", l_lovrGraphicsTock },
+  { "pushProfile", l_lovrGraphicsPushProfile },
+  { "popProfile", l_lovrGraphicsPopProfile },
+  { "getProfile", l_lovrGraphicsGetProfile },
   { "getFeatures", l_lovrGraphicsGetFeatures },
   { "getLimits", l_lovrGraphicsGetLimits },
   { "getStats", l_lovrGraphicsGetStats },
+  { "getTextureBudget", l_lovrGraphicsGetTextureBudget },
+  { "setTextureBudget", l_lovrGraphicsSetTextureBudget },
 
   // State
   { "reset", l_lovrGraphicsReset },
@@ -1775,6 +2279,10 @@ static const luaL_Reg lovrGraphics[] = {
   { "setPointSize", l_lovrGraphicsSetPointSize },
   { "getShader", l_lovrGraphicsGetShader },
   { "setShader", l_lovrGraphicsSetShader },
+  { "isSortingEnabled", l_lovrGraphicsIsSortingEnabled },
+  { "setSortingEnabled", l_lovrGraphicsSetSortingEnabled },
+  { "isDepthPrepassEnabled", l_lovrGraphicsIsDepthPrepassEnabled },
+  { "setDepthPrepassEnabled", l_lovrGraphicsSetDepthPrepassEnabled },
   { "getStencilTest", l_lovrGraphicsGetStencilTest },
   { "setStencilTest", l_lovrGraphicsSetStencilTest },
   { "getWinding", l_lovrGraphicsGetWinding },
@@ -1791,10 +2299,18 @@ static const luaL_Reg lovrGraphics[] = {
   { "scale", l_lovrGraphicsScale },
   { "transform", l_lovrGraphicsTransform },
 
+  // Lights
+  { "addLight", l_lovrGraphicsAddLight },
+  { "clearLights", l_lovrGraphicsClearLights },
+  { "getLightCount", l_lovrGraphicsGetLightCount },
+
   // Rendering
   { "clear", l_lovrGraphicsClear },
   { "discard", l_lovrGraphicsDiscard },
+  { "pass", l_lovrGraphicsPass },
   { "flush", l_lovrGraphicsFlush },
+  { "startTrace", l_lovrGraphicsStartTrace },
+  { "stopTrace", l_lovrGraphicsStopTrace },
   { "points", l_lovrGraphicsPoints },
   { "line", l_lovrGraphicsLine },
   { "plane", l_lovrGraphicsPlane },
@@ -1808,55 +2324,81 @@ static const luaL_Reg lovrGraphics[] = {
   { "print", l_lovrGraphicsPrint },
   { "stencil", l_lovrGraphicsStencil },
   { "fill", l_lovrGraphicsFill },
+  { "drawIndirect", l_lovrGraphicsDrawIndirect },
   { "compute", l_lovrGraphicsCompute },
+  { "animateModels", l_lovrGraphicsAnimateModels },
 
   // Types
+  { "newAtlas", l_lovrGraphicsNewAtlas },
   { "newCanvas", l_lovrGraphicsNewCanvas },
+  { "newDrawList", l_lovrGraphicsNewDrawList },
   { "newFont", l_lovrGraphicsNewFont },
   { "newMaterial", l_lovrGraphicsNewMaterial },
   { "newMesh", l_lovrGraphicsNewMesh },
   { "newModel", l_lovrGraphicsNewModel },
+  { "newParticleSystem", l_lovrGraphicsNewParticleSystem },
+  { "newPostProcess", l_lovrGraphicsNewPostProcess },
   { "newShader", l_lovrGraphicsNewShader },
   { "newComputeShader", l_lovrGraphicsNewComputeShader },
   { "newShaderBlock", l_lovrGraphicsNewShaderBlock },
   { "newTexture", l_lovrGraphicsNewTexture },
+  { "newVirtualTexture", l_lovrGraphicsNewVirtualTexture },
 
   { NULL, NULL }
 };
 
+extern const luaL_Reg lovrAtlas[];
 extern const luaL_Reg lovrCanvas[];
+extern const luaL_Reg lovrDrawList[];
 extern const luaL_Reg lovrFont[];
 extern const luaL_Reg lovrMaterial[];
 extern const luaL_Reg lovrMesh[];
 extern const luaL_Reg lovrModel[];
+extern const luaL_Reg lovrParticleSystem[];
+extern const luaL_Reg lovrPostProcess[];
+extern const luaL_Reg lovrReadback[];
 extern const luaL_Reg lovrShader[];
 extern const luaL_Reg lovrShaderBlock[];
+extern const luaL_Reg lovrText[];
 extern const luaL_Reg lovrTexture[];
+extern const luaL_Reg lovrVirtualTexture[];
 
 int luaopen_lovr_graphics(lua_State* L) {
   lua_newtable(L);
   luax_register(L, lovrGraphics);
+  luax_registertype(L, Atlas);
   luax_registertype(L, Canvas);
+  luax_registertype(L, DrawList);
   luax_registertype(L, Font);
   luax_registertype(L, Material);
   luax_registertype(L, Mesh);
   luax_registertype(L, Model);
+  luax_registertype(L, ParticleSystem);
+  luax_registertype(L, PostProcess);
+  luax_registertype(L, Readback);
   luax_registertype(L, Shader);
   luax_registertype(L, ShaderBlock);
+  luax_registertype(L, Text);
   luax_registertype(L, Texture);
+  luax_registertype(L, VirtualTexture);
 
   luax_pushconf(L);
 
   bool debug = false;
+  uint32_t batchLimit = 0;
   lua_getfield(L, -1, "graphics");
   if (lua_istable(L, -1)) {
     lua_getfield(L, -1, "debug");
     debug = lua_toboolean(L, -1);
     lua_pop(L, 1);
+
+    lua_getfield(L, -1, "batches");
+    batchLimit = luaL_optinteger(L, -1, 0);
+    lua_pop(L, 1);
   }
   lua_pop(L, 1);
 
-  lovrGraphicsInit(debug);
+  lovrGraphicsInit(debug, batchLimit);
 
   lua_pushcfunction(L, l_lovrGraphicsCreateWindow);
   lua_getfield(L, -2, "window");
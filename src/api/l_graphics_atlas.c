@@ -0,0 +1,57 @@
+#include "api.h"
+#include "graphics/atlas.h"
+#include "graphics/texture.h"
+#include "data/blob.h"
+#include "data/image.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrAtlasAdd(lua_State* L) {
+  Atlas* atlas = luax_checktype(L, 1, Atlas);
+  Image* image = luax_totype(L, 2, Image);
+
+  if (image) {
+    lovrRetain(image);
+  } else {
+    Blob* blob = luax_readblob(L, 2, "Texture");
+    image = lovrImageCreateFromBlob(blob, true);
+    lovrRelease(blob, lovrBlobDestroy);
+  }
+
+  float uv[4];
+  uint32_t layer;
+  bool added = lovrAtlasAdd(atlas, image, uv, &layer);
+  lovrRelease(image, lovrImageDestroy);
+
+  if (!added) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_pushnumber(L, uv[0]);
+  lua_pushnumber(L, uv[1]);
+  lua_pushnumber(L, uv[2]);
+  lua_pushnumber(L, uv[3]);
+  lua_pushinteger(L, layer + 1);
+  return 5;
+}
+
+static int l_lovrAtlasGetTexture(lua_State* L) {
+  Atlas* atlas = luax_checktype(L, 1, Atlas);
+  Texture* texture = lovrAtlasGetTexture(atlas);
+  luax_pushtype(L, Texture, texture);
+  return 1;
+}
+
+static int l_lovrAtlasGetLayerCount(lua_State* L) {
+  Atlas* atlas = luax_checktype(L, 1, Atlas);
+  lua_pushinteger(L, lovrAtlasGetLayerCount(atlas));
+  return 1;
+}
+
+const luaL_Reg lovrAtlas[] = {
+  { "add", l_lovrAtlasAdd },
+  { "getTexture", l_lovrAtlasGetTexture },
+  { "getLayerCount", l_lovrAtlasGetLayerCount },
+  { NULL, NULL }
+};
@@ -64,6 +64,18 @@ static int l_lovrCanvasNewImage(lua_State* L) {
   return 1;
 }
 
+static int l_lovrCanvasNewReadback(lua_State* L) {
+  Canvas* canvas = luax_checktype(L, 1, Canvas);
+  uint32_t index = luaL_optinteger(L, 2, 1) - 1;
+  uint32_t count;
+  lovrCanvasGetAttachments(canvas, &count);
+  lovrAssert(index < count, "Can not read back Texture #%d of Canvas (it only has %d textures)", index, count);
+  Readback* readback = lovrReadbackCreate(canvas, index);
+  luax_pushtype(L, Readback, readback);
+  lovrRelease(readback, lovrReadbackDestroy);
+  return 1;
+}
+
 static int l_lovrCanvasRenderTo(lua_State* L) {
   Canvas* canvas = luax_checktype(L, 1, Canvas);
   luaL_checktype(L, 2, LUA_TFUNCTION);
@@ -136,6 +148,7 @@ static int l_lovrCanvasIsStereo(lua_State* L) {
 
 const luaL_Reg lovrCanvas[] = {
   { "newImage", l_lovrCanvasNewImage },
+  { "newReadback", l_lovrCanvasNewReadback },
   { "renderTo", l_lovrCanvasRenderTo },
   { "getTexture", l_lovrCanvasGetTexture },
   { "setTexture", l_lovrCanvasSetTexture },
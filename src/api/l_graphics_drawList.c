@@ -0,0 +1,51 @@
+#include "api.h"
+#include "graphics/graphics.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+// Recording replaces the previous contents of the list.  Errors end the recording before they
+// propagate, so the graphics state isn't left recording.
+static int l_lovrDrawListRecord(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  int argumentCount = lua_gettop(L) - 2;
+  lovrGraphicsBeginDrawList(list);
+  int status = lua_pcall(L, argumentCount, 0, 0);
+  lovrGraphicsEndDrawList();
+  if (status != 0) {
+    return lua_error(L);
+  }
+  return 0;
+}
+
+static int l_lovrDrawListDraw(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  if (lua_gettop(L) > 1) {
+    float transform[16];
+    luax_readmat4(L, 2, transform, 1);
+    lovrGraphicsDrawList(list, transform);
+  } else {
+    lovrGraphicsDrawList(list, NULL);
+  }
+  return 0;
+}
+
+static int l_lovrDrawListGetBatchCount(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  lua_pushinteger(L, lovrDrawListGetBatchCount(list));
+  return 1;
+}
+
+static int l_lovrDrawListGetDrawCount(lua_State* L) {
+  DrawList* list = luax_checktype(L, 1, DrawList);
+  lua_pushinteger(L, lovrDrawListGetDrawCount(list));
+  return 1;
+}
+
+const luaL_Reg lovrDrawList[] = {
+  { "record", l_lovrDrawListRecord },
+  { "draw", l_lovrDrawListDraw },
+  { "getBatchCount", l_lovrDrawListGetBatchCount },
+  { "getDrawCount", l_lovrDrawListGetDrawCount },
+  { NULL, NULL }
+};
@@ -1,10 +1,67 @@
 #include "api.h"
 #include "graphics/font.h"
 #include "data/rasterizer.h"
+#include "data/blob.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
 
+static int l_lovrFontPreload(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  size_t length;
+  const char* string = luaL_checklstring(L, 2, &length);
+#ifndef LOVR_DISABLE_THREAD
+  if (lua_toboolean(L, 3)) {
+    luax_startpool(L);
+  }
+#endif
+  lovrFontPreload(font, string, length);
+  return 0;
+}
+
+static int l_lovrFontGetCache(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  Blob* blob = lovrFontGetCache(font);
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  return 1;
+}
+
+static int l_lovrFontLoadCache(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  Blob* blob;
+
+  // A missing cache file isn't an error, it just hasn't been written yet
+  if (lua_type(L, 2) == LUA_TSTRING) {
+    size_t size;
+    void* data = luax_readfile(lua_tostring(L, 2), &size);
+    if (!data) {
+      lua_pushboolean(L, false);
+      return 1;
+    }
+    blob = lovrBlobCreate(data, size, "Font cache");
+  } else {
+    blob = luax_readblob(L, 2, "Font cache");
+  }
+
+  bool loaded = lovrFontLoadCache(font, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  lua_pushboolean(L, loaded);
+  return 1;
+}
+
+static int l_lovrFontNewText(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  size_t length;
+  const char* string = luaL_checklstring(L, 2, &length);
+  float wrap = luax_optfloat(L, 3, 0.f);
+  HorizontalAlign halign = luax_checkenum(L, 4, HorizontalAlign, "center");
+  Text* text = lovrTextCreate(font, string, length, wrap, halign);
+  luax_pushtype(L, Text, text);
+  lovrRelease(text, lovrTextDestroy);
+  return 1;
+}
+
 static int l_lovrFontGetWidth(lua_State* L) {
   Font* font = luax_checktype(L, 1, Font);
   size_t length;
@@ -108,6 +165,10 @@ static int l_lovrFontHasGlyphs(lua_State* L) {
 }
 
 const luaL_Reg lovrFont[] = {
+  { "preload", l_lovrFontPreload },
+  { "getCache", l_lovrFontGetCache },
+  { "loadCache", l_lovrFontLoadCache },
+  { "newText", l_lovrFontNewText },
   { "getWidth", l_lovrFontGetWidth },
   { "getHeight", l_lovrFontGetHeight },
   { "getAscent", l_lovrFontGetAscent },
@@ -8,6 +8,80 @@
 #include <lauxlib.h>
 #include <limits.h>
 
+// Vertices in a table are either a list of vertex tables, or a flat list with all of the components
+uint32_t luax_getmeshvertexcount(lua_State* L, int index, uint32_t components) {
+  lua_rawgeti(L, index, 1);
+  bool flat = lua_type(L, -1) == LUA_TNUMBER;
+  lua_pop(L, 1);
+  uint32_t length = luax_len(L, index);
+  return flat ? length / MAX(components, 1) : length;
+}
+
+// Reads count components of a table starting at the first one, index has to be absolute
+static void readFloats(lua_State* L, int index, uint32_t first, uint32_t count, float* data) {
+  for (uint32_t i = first; i < first + count; i++) {
+    lua_rawgeti(L, index, i + 1);
+    *data++ = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+  }
+}
+
+static void readComponents(lua_State* L, int index, uint32_t first, uint32_t count, const uint8_t* types, AttributeData* data) {
+  for (uint32_t i = 0; i < count; i++) {
+    lua_rawgeti(L, index, first + i + 1);
+    switch (types[i]) {
+      case I8: *data->i8++ = lua_tointeger(L, -1); break;
+      case U8: *data->u8++ = lua_tointeger(L, -1); break;
+      case I16: *data->i16++ = lua_tointeger(L, -1); break;
+      case U16: *data->u16++ = lua_tointeger(L, -1); break;
+      case I32: *data->i32++ = lua_tointeger(L, -1); break;
+      case U32: *data->u32++ = lua_tointeger(L, -1); break;
+      case F32: *data->f32++ = lua_tonumber(L, -1); break;
+    }
+    lua_pop(L, 1);
+  }
+}
+
+// Packs vertices from a table (in either shape luax_getmeshvertexcount accepts) into tightly packed
+// components with the given types.  Missing components are zero.  The packer is picked once for the
+// whole table: formats made only of floats, which is most of them, skip the per component type
+// switch, and flat tables are read without fetching a table per vertex.
+void luax_readmeshvertices(lua_State* L, int index, void* data, const uint8_t* types, uint32_t components, uint32_t count) {
+  index = index > 0 ? index : lua_gettop(L) + index + 1;
+
+  bool floats = true;
+  for (uint32_t i = 0; i < components; i++) {
+    floats &= types[i] == F32;
+  }
+
+  lua_rawgeti(L, index, 1);
+  bool flat = lua_type(L, -1) == LUA_TNUMBER;
+  lua_pop(L, 1);
+
+  AttributeData cursor = { .raw = data };
+
+  if (flat && floats) {
+    readFloats(L, index, 0, count * components, cursor.f32);
+  } else if (flat) {
+    for (uint32_t i = 0; i < count; i++) {
+      readComponents(L, index, i * components, components, types, &cursor);
+    }
+  } else {
+    int vertex = lua_gettop(L) + 1;
+    for (uint32_t i = 0; i < count; i++) {
+      lua_rawgeti(L, index, i + 1);
+      lovrAssert(lua_istable(L, -1), "Vertices should be specified as a table of tables or a flat table of numbers");
+      if (floats) {
+        readFloats(L, vertex, 0, components, cursor.f32);
+        cursor.f32 += components;
+      } else {
+        readComponents(L, vertex, 0, components, types, &cursor);
+      }
+      lua_pop(L, 1);
+    }
+  }
+}
+
 static int l_lovrMeshAttachAttributes(lua_State* L) {
   Mesh* mesh = luax_checktype(L, 1, Mesh);
   Mesh* other = luax_checktype(L, 2, Mesh);
@@ -84,7 +158,7 @@ static int l_lovrMeshDraw(lua_State* L) {
   float transform[16];
   int index = luax_readmat4(L, 2, transform, 1);
   int instances = luaL_optinteger(L, index, 1);
-  lovrGraphicsDrawMesh(mesh, transform, instances, NULL);
+  lovrGraphicsDrawMesh(mesh, transform, instances, NULL, 0);
   return 0;
 }
 
@@ -280,6 +354,21 @@ static int l_lovrMeshSetVertexAttribute(lua_State* L) {
   return 0;
 }
 
+// Writes to a stream Mesh that start at its first vertex replace the whole vertex buffer, so it gets
+// orphaned instead of waiting for the GPU to finish drawing the old vertices.  Vertices after the
+// written range are undefined afterwards.  Pending draws of the Mesh are flushed so they still see
+// the old vertices.
+static void* mapVertices(Mesh* mesh, Buffer* buffer, uint32_t start, size_t stride) {
+  if (start == 0 && lovrBufferGetUsage(buffer) == USAGE_STREAM && !lovrBufferIsReadable(buffer)) {
+    lovrGraphicsFlushMesh(mesh);
+    lovrBufferUnmap(buffer);
+    lovrBufferDiscard(buffer);
+    return lovrBufferMap(buffer, 0, true);
+  }
+
+  return lovrBufferMap(buffer, start * stride, false);
+}
+
 static int l_lovrMeshSetVertices(lua_State* L) {
   Mesh* mesh = luax_checktype(L, 1, Mesh);
   Buffer* buffer = lovrMeshGetVertexBuffer(mesh);
@@ -300,47 +389,32 @@ static int l_lovrMeshSetVertices(lua_State* L) {
   if (blob) {
     count = MIN(count, (uint32_t) (blob->size / stride));
     lovrAssert(start + count <= capacity, "Overflow in Mesh:setVertices: Mesh can only hold %d vertices", capacity);
-    void* data = lovrBufferMap(buffer, start * stride, false);
+    void* data = mapVertices(mesh, buffer, start, stride);
     memcpy(data, blob->data, count * stride);
     lovrBufferFlush(buffer, start * stride, count * stride);
     return 0;
   }
 
   luaL_checktype(L, 2, LUA_TTABLE);
-  count = MIN(count, (uint32_t) luax_len(L, 2));
-  lovrAssert(start + count <= capacity, "Overflow in Mesh:setVertices: Mesh can only hold %d vertices", capacity);
-
-  AttributeData data = { .raw = lovrBufferMap(buffer, start * stride, false) };
-
-  for (uint32_t i = 0; i < count; i++) {
-    lua_rawgeti(L, 2, i + 1);
-    luaL_checktype(L, -1, LUA_TTABLE);
-    int component = 0;
-    for (uint32_t j = 0; j < attributeCount; j++) {
-      const MeshAttribute* attribute = lovrMeshGetAttribute(mesh, j);
-      if (attribute->buffer != buffer) {
-        break;
-      }
 
-      for (unsigned k = 0; k < attribute->components; k++) {
-        lua_rawgeti(L, -1, ++component);
-
-        switch (attribute->type) {
-          case I8: *data.i8++ = luaL_optinteger(L, -1, 0); break;
-          case U8: *data.u8++ = luaL_optinteger(L, -1, 0); break;
-          case I16: *data.i16++ = luaL_optinteger(L, -1, 0); break;
-          case U16: *data.u16++ = luaL_optinteger(L, -1, 0); break;
-          case I32: *data.i32++ = luaL_optinteger(L, -1, 0); break;
-          case U32: *data.u32++ = luaL_optinteger(L, -1, 0); break;
-          case F32: *data.f32++ = luaL_optnumber(L, -1, 0.); break;
-        }
+  uint8_t types[MAX_ATTRIBUTES * 8];
+  uint32_t components = 0;
+  for (uint32_t i = 0; i < attributeCount; i++) {
+    const MeshAttribute* attribute = lovrMeshGetAttribute(mesh, i);
+    if (attribute->buffer != buffer) {
+      break;
+    }
 
-        lua_pop(L, 1);
-      }
+    for (unsigned j = 0; j < attribute->components; j++) {
+      types[components++] = attribute->type;
     }
-    lua_pop(L, 1);
   }
 
+  count = MIN(count, luax_getmeshvertexcount(L, 2, components));
+  lovrAssert(start + count <= capacity, "Overflow in Mesh:setVertices: Mesh can only hold %d vertices", capacity);
+
+  void* data = mapVertices(mesh, buffer, start, stride);
+  luax_readmeshvertices(L, 2, data, types, components, count);
   lovrBufferFlush(buffer, start * stride, count * stride);
   return 0;
 }
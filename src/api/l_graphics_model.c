@@ -6,7 +6,7 @@
 #include <lua.h>
 #include <lauxlib.h>
 
-static uint32_t luax_checkanimation(lua_State* L, int index, Model* model) {
+uint32_t luax_checkanimation(lua_State* L, int index, Model* model) {
   switch (lua_type(L, index)) {
     case LUA_TSTRING: {
       size_t length;
@@ -39,6 +39,27 @@ static int l_lovrModelAnimate(lua_State* L) {
   return 0;
 }
 
+static int l_lovrModelBlendAnimations(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  int count = luax_len(L, 2);
+  lovrAssert(count <= MAX_ANIMATION_LAYERS, "Too many animation layers (max is %d)", MAX_ANIMATION_LAYERS);
+  AnimationLayer layers[MAX_ANIMATION_LAYERS];
+  for (int i = 0; i < count; i++) {
+    lua_rawgeti(L, 2, i + 1);
+    lovrAssert(lua_istable(L, -1), "Expected animation layers to be tables of { animation, time, weight }");
+    lua_rawgeti(L, -1, 1);
+    lua_rawgeti(L, -2, 2);
+    lua_rawgeti(L, -3, 3);
+    layers[i].animation = luax_checkanimation(L, -3, model);
+    layers[i].time = luax_checkfloat(L, -2);
+    layers[i].weight = luax_optfloat(L, -1, 1.f);
+    lua_pop(L, 4);
+  }
+  lovrModelBlendAnimations(model, layers, count);
+  return 0;
+}
+
 static int l_lovrModelPose(lua_State* L) {
   Model* model = luax_checktype(L, 1, Model);
 
@@ -131,6 +152,18 @@ static int l_lovrModelGetTriangles(lua_State* L) {
   return 2;
 }
 
+static int l_lovrModelBake(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lovrModelBake(model);
+  return 0;
+}
+
+static int l_lovrModelIsBaked(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushboolean(L, lovrModelIsBaked(model));
+  return 1;
+}
+
 static int l_lovrModelGetNodePose(lua_State* L) {
   Model* model = luax_checktype(L, 1, Model);
   uint32_t node;
@@ -223,13 +256,70 @@ static int l_lovrModelHasJoints(lua_State* L) {
   return 1;
 }
 
+static int l_lovrModelIsCullingEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushboolean(L, lovrModelIsCullingEnabled(model));
+  return 1;
+}
+
+static int l_lovrModelSetCullingEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lovrModelSetCullingEnabled(model, lua_toboolean(L, 2));
+  return 0;
+}
+
+static int l_lovrModelIsOcclusionCullingEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushboolean(L, lovrModelIsOcclusionCullingEnabled(model));
+  return 1;
+}
+
+static int l_lovrModelSetOcclusionCullingEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lovrModelSetOcclusionCullingEnabled(model, lua_toboolean(L, 2));
+  return 0;
+}
+
+static int l_lovrModelGetStreamProgress(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushnumber(L, lovrModelGetStreamProgress(model));
+  return 1;
+}
+
+static int l_lovrModelIsLodEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushboolean(L, lovrModelIsLodEnabled(model));
+  return 1;
+}
+
+static int l_lovrModelSetLodEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lovrModelSetLodEnabled(model, lua_toboolean(L, 2));
+  return 0;
+}
+
+static int l_lovrModelIsComputeSkinningEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lua_pushboolean(L, lovrModelIsComputeSkinningEnabled(model));
+  return 1;
+}
+
+static int l_lovrModelSetComputeSkinningEnabled(lua_State* L) {
+  Model* model = luax_checktype(L, 1, Model);
+  lovrModelSetComputeSkinningEnabled(model, lua_toboolean(L, 2));
+  return 0;
+}
+
 const luaL_Reg lovrModel[] = {
   { "draw", l_lovrModelDraw },
   { "animate", l_lovrModelAnimate },
+  { "blendAnimations", l_lovrModelBlendAnimations },
   { "pose", l_lovrModelPose },
   { "getMaterial", l_lovrModelGetMaterial },
   { "getAABB", l_lovrModelGetAABB },
   { "getTriangles", l_lovrModelGetTriangles },
+  { "bake", l_lovrModelBake },
+  { "isBaked", l_lovrModelIsBaked },
   { "getNodePose", l_lovrModelGetNodePose },
   { "getAnimationName", l_lovrModelGetAnimationName },
   { "getMaterialName", l_lovrModelGetMaterialName },
@@ -239,5 +329,14 @@ const luaL_Reg lovrModel[] = {
   { "getNodeCount", l_lovrModelGetNodeCount },
   { "getAnimationDuration", l_lovrModelGetAnimationDuration },
   { "hasJoints", l_lovrModelHasJoints },
+  { "isCullingEnabled", l_lovrModelIsCullingEnabled },
+  { "setCullingEnabled", l_lovrModelSetCullingEnabled },
+  { "isOcclusionCullingEnabled", l_lovrModelIsOcclusionCullingEnabled },
+  { "setOcclusionCullingEnabled", l_lovrModelSetOcclusionCullingEnabled },
+  { "getStreamProgress", l_lovrModelGetStreamProgress },
+  { "isLodEnabled", l_lovrModelIsLodEnabled },
+  { "setLodEnabled", l_lovrModelSetLodEnabled },
+  { "isComputeSkinningEnabled", l_lovrModelIsComputeSkinningEnabled },
+  { "setComputeSkinningEnabled", l_lovrModelSetComputeSkinningEnabled },
   { NULL, NULL }
 };
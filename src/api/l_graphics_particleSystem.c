@@ -0,0 +1,280 @@
+#include "api.h"
+#include "graphics/graphics.h"
+#include "graphics/material.h"
+#include "graphics/particles.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrParticleSystemGetCapacity(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  lua_pushinteger(L, lovrParticleSystemGetCapacity(particles));
+  return 1;
+}
+
+static int l_lovrParticleSystemEmit(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  lua_Integer count = luaL_checkinteger(L, 2);
+  lovrParticleSystemEmit(particles, count < 0 ? 0 : (uint32_t) MIN(count, MAX_PARTICLES));
+  return 0;
+}
+
+static int l_lovrParticleSystemUpdate(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  float dt = luax_checkfloat(L, 2);
+  lovrParticleSystemUpdate(particles, dt);
+  return 0;
+}
+
+static int l_lovrParticleSystemDraw(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  float transform[16];
+  luax_readmat4(L, 2, transform, 1);
+  lovrParticleSystemDraw(particles, transform);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetRate(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  lua_pushnumber(L, lovrParticleSystemGetSettings(particles)->rate);
+  return 1;
+}
+
+static int l_lovrParticleSystemSetRate(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  float rate = luax_checkfloat(L, 2);
+  lovrAssert(rate >= 0.f, "Particle rate can not be negative");
+  lovrParticleSystemGetSettings(particles)->rate = rate;
+  return 0;
+}
+
+static int l_lovrParticleSystemGetEmitter(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  lua_pushnumber(L, settings->position[0]);
+  lua_pushnumber(L, settings->position[1]);
+  lua_pushnumber(L, settings->position[2]);
+  lua_pushnumber(L, settings->radius);
+  return 4;
+}
+
+static int l_lovrParticleSystemSetEmitter(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  float position[4];
+  int index = luax_readvec3(L, 2, position, NULL);
+  settings->position[0] = position[0];
+  settings->position[1] = position[1];
+  settings->position[2] = position[2];
+  settings->radius = luax_optfloat(L, index, 0.f);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetDirection(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  lua_pushnumber(L, settings->direction[0]);
+  lua_pushnumber(L, settings->direction[1]);
+  lua_pushnumber(L, settings->direction[2]);
+  lua_pushnumber(L, settings->spread);
+  return 4;
+}
+
+static int l_lovrParticleSystemSetDirection(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  float direction[4];
+  int index = luax_readvec3(L, 2, direction, NULL);
+  lovrAssert(direction[0] != 0.f || direction[1] != 0.f || direction[2] != 0.f, "Particle direction can not be zero");
+  settings->direction[0] = direction[0];
+  settings->direction[1] = direction[1];
+  settings->direction[2] = direction[2];
+  settings->spread = luax_optfloat(L, index, settings->spread);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetSpeed(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  lua_pushnumber(L, settings->speed[0]);
+  lua_pushnumber(L, settings->speed[1]);
+  return 2;
+}
+
+static int l_lovrParticleSystemSetSpeed(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  settings->speed[0] = luax_checkfloat(L, 2);
+  settings->speed[1] = luax_optfloat(L, 3, settings->speed[0]);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetLifetime(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  lua_pushnumber(L, settings->lifetime[0]);
+  lua_pushnumber(L, settings->lifetime[1]);
+  return 2;
+}
+
+static int l_lovrParticleSystemSetLifetime(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  float min = luax_checkfloat(L, 2);
+  float max = luax_optfloat(L, 3, min);
+  lovrAssert(min >= 0.f && max >= 0.f, "Particle lifetime can not be negative");
+  settings->lifetime[0] = min;
+  settings->lifetime[1] = max;
+  return 0;
+}
+
+static int l_lovrParticleSystemGetSizes(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  lua_pushnumber(L, settings->size[0]);
+  lua_pushnumber(L, settings->size[1]);
+  return 2;
+}
+
+static int l_lovrParticleSystemSetSizes(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  settings->size[0] = luax_checkfloat(L, 2);
+  settings->size[1] = luax_optfloat(L, 3, settings->size[0]);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetColors(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  for (int i = 0; i < 2; i++) {
+    Color color = settings->colors[i];
+    lua_createtable(L, 4, 0);
+    lua_pushnumber(L, color.r);
+    lua_rawseti(L, -2, 1);
+    lua_pushnumber(L, color.g);
+    lua_rawseti(L, -2, 2);
+    lua_pushnumber(L, color.b);
+    lua_rawseti(L, -2, 3);
+    lua_pushnumber(L, color.a);
+    lua_rawseti(L, -2, 4);
+  }
+  return 2;
+}
+
+// Each color is a table or a hex number, since the start color's components can't be told apart
+// from the end color's if they're passed as numbers
+static Color readColor(lua_State* L, int index) {
+  Color color;
+  if (lua_istable(L, index)) {
+    luax_readcolor(L, index, &color);
+  } else {
+    uint32_t x = luaL_checkinteger(L, index);
+    color.r = ((x >> 16) & 0xff) / 255.f;
+    color.g = ((x >> 8) & 0xff) / 255.f;
+    color.b = ((x >> 0) & 0xff) / 255.f;
+    color.a = 1.f;
+  }
+  return color;
+}
+
+static int l_lovrParticleSystemSetColors(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  settings->colors[0] = readColor(L, 2);
+  settings->colors[1] = lua_isnoneornil(L, 3) ? settings->colors[0] : readColor(L, 3);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetAcceleration(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  lua_pushnumber(L, settings->acceleration[0]);
+  lua_pushnumber(L, settings->acceleration[1]);
+  lua_pushnumber(L, settings->acceleration[2]);
+  return 3;
+}
+
+static int l_lovrParticleSystemSetAcceleration(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  ParticleSettings* settings = lovrParticleSystemGetSettings(particles);
+  float acceleration[4];
+  luax_readvec3(L, 2, acceleration, NULL);
+  settings->acceleration[0] = acceleration[0];
+  settings->acceleration[1] = acceleration[1];
+  settings->acceleration[2] = acceleration[2];
+  return 0;
+}
+
+static int l_lovrParticleSystemGetDrag(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  lua_pushnumber(L, lovrParticleSystemGetSettings(particles)->drag);
+  return 1;
+}
+
+static int l_lovrParticleSystemSetDrag(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  float drag = luax_checkfloat(L, 2);
+  lovrAssert(drag >= 0.f, "Particle drag can not be negative");
+  lovrParticleSystemGetSettings(particles)->drag = drag;
+  return 0;
+}
+
+static int l_lovrParticleSystemIsSorted(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  lua_pushboolean(L, lovrParticleSystemGetSettings(particles)->sorted);
+  return 1;
+}
+
+static int l_lovrParticleSystemSetSorted(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  lovrParticleSystemGetSettings(particles)->sorted = lua_toboolean(L, 2);
+  return 0;
+}
+
+static int l_lovrParticleSystemGetMaterial(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  Material* material = lovrParticleSystemGetMaterial(particles);
+  luax_pushtype(L, Material, material);
+  return 1;
+}
+
+static int l_lovrParticleSystemSetMaterial(lua_State* L) {
+  ParticleSystem* particles = luax_checktype(L, 1, ParticleSystem);
+  if (lua_isnoneornil(L, 2)) {
+    lovrParticleSystemSetMaterial(particles, NULL);
+  } else {
+    Material* material = luax_checktype(L, 2, Material);
+    lovrParticleSystemSetMaterial(particles, material);
+  }
+  return 0;
+}
+
+const luaL_Reg lovrParticleSystem[] = {
+  { "getCapacity", l_lovrParticleSystemGetCapacity },
+  { "emit", l_lovrParticleSystemEmit },
+  { "update", l_lovrParticleSystemUpdate },
+  { "draw", l_lovrParticleSystemDraw },
+  { "getRate", l_lovrParticleSystemGetRate },
+  { "setRate", l_lovrParticleSystemSetRate },
+  { "getEmitter", l_lovrParticleSystemGetEmitter },
+  { "setEmitter", l_lovrParticleSystemSetEmitter },
+  { "getDirection", l_lovrParticleSystemGetDirection },
+  { "setDirection", l_lovrParticleSystemSetDirection },
+  { "getSpeed", l_lovrParticleSystemGetSpeed },
+  { "setSpeed", l_lovrParticleSystemSetSpeed },
+  { "getLifetime", l_lovrParticleSystemGetLifetime },
+  { "setLifetime", l_lovrParticleSystemSetLifetime },
+  { "getSizes", l_lovrParticleSystemGetSizes },
+  { "setSizes", l_lovrParticleSystemSetSizes },
+  { "getColors", l_lovrParticleSystemGetColors },
+  { "setColors", l_lovrParticleSystemSetColors },
+  { "getAcceleration", l_lovrParticleSystemGetAcceleration },
+  { "setAcceleration", l_lovrParticleSystemSetAcceleration },
+  { "getDrag", l_lovrParticleSystemGetDrag },
+  { "setDrag", l_lovrParticleSystemSetDrag },
+  { "isSorted", l_lovrParticleSystemIsSorted },
+  { "setSorted", l_lovrParticleSystemSetSorted },
+  { "getMaterial", l_lovrParticleSystemGetMaterial },
+  { "setMaterial", l_lovrParticleSystemSetMaterial },
+  { NULL, NULL }
+};
@@ -0,0 +1,84 @@
+#include "api.h"
+#include "graphics/canvas.h"
+#include "graphics/postProcess.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static float luax_optfield(lua_State* L, int index, const char* key, float fallback) {
+  lua_getfield(L, index, key);
+  float value = lua_isnil(L, -1) ? fallback : luax_checkfloat(L, -1);
+  lua_pop(L, 1);
+  return value;
+}
+
+static int l_lovrPostProcessApply(lua_State* L) {
+  PostProcess* post = luax_checktype(L, 1, PostProcess);
+  Canvas* source = luax_checktype(L, 2, Canvas);
+  Canvas* target = luax_totype(L, 3, Canvas);
+  lovrPostProcessApply(post, source, target);
+  return 0;
+}
+
+static int l_lovrPostProcessIsEffectEnabled(lua_State* L) {
+  PostProcess* post = luax_checktype(L, 1, PostProcess);
+  PostEffect effect = luax_checkenum(L, 2, PostEffect, NULL);
+  lua_pushboolean(L, lovrPostProcessIsEffectEnabled(post, effect));
+  return 1;
+}
+
+// Passing a table enables the effect and changes any of its settings that are in the table
+static int l_lovrPostProcessSetEffect(lua_State* L) {
+  PostProcess* post = luax_checktype(L, 1, PostProcess);
+  PostEffect effect = luax_checkenum(L, 2, PostEffect, NULL);
+
+  if (!lua_istable(L, 3)) {
+    lovrPostProcessSetEffectEnabled(post, effect, lua_toboolean(L, 3));
+    return 0;
+  }
+
+  PostSettings* settings = lovrPostProcessGetSettings(post);
+  switch (effect) {
+    case POST_BLOOM:
+      settings->bloom.threshold = luax_optfield(L, 3, "threshold", settings->bloom.threshold);
+      settings->bloom.knee = luax_optfield(L, 3, "knee", settings->bloom.knee);
+      settings->bloom.intensity = luax_optfield(L, 3, "intensity", settings->bloom.intensity);
+      lua_getfield(L, 3, "levels");
+      settings->bloom.levels = lua_isnil(L, -1) ? settings->bloom.levels : luaL_checkinteger(L, -1);
+      lovrAssert(settings->bloom.levels >= 1 && settings->bloom.levels <= MAX_BLOOM_LEVELS, "Bloom levels must be between 1 and %d", MAX_BLOOM_LEVELS);
+      lua_pop(L, 1);
+      break;
+    case POST_TONEMAP:
+      settings->tonemap.exposure = luax_optfield(L, 3, "exposure", settings->tonemap.exposure);
+      break;
+    case POST_GRADE:
+      settings->grade.contrast = luax_optfield(L, 3, "contrast", settings->grade.contrast);
+      settings->grade.saturation = luax_optfield(L, 3, "saturation", settings->grade.saturation);
+      settings->grade.brightness = luax_optfield(L, 3, "brightness", settings->grade.brightness);
+      lua_getfield(L, 3, "tint");
+      if (lua_istable(L, -1)) {
+        for (int i = 0; i < 3; i++) {
+          lua_rawgeti(L, -1, i + 1);
+          settings->grade.tint[i] = luax_optfloat(L, -1, 1.f);
+          lua_pop(L, 1);
+        }
+      }
+      lua_pop(L, 1);
+      break;
+    case POST_VIGNETTE:
+      settings->vignette.intensity = luax_optfield(L, 3, "intensity", settings->vignette.intensity);
+      settings->vignette.radius = luax_optfield(L, 3, "radius", settings->vignette.radius);
+      settings->vignette.softness = luax_optfield(L, 3, "softness", settings->vignette.softness);
+      break;
+    default: break;
+  }
+
+  lovrPostProcessSetEffectEnabled(post, effect, true);
+  return 0;
+}
+
+const luaL_Reg lovrPostProcess[] = {
+  { "apply", l_lovrPostProcessApply },
+  { "isEffectEnabled", l_lovrPostProcessIsEffectEnabled },
+  { "setEffect", l_lovrPostProcessSetEffect },
+  { NULL, NULL }
+};
@@ -0,0 +1,34 @@
+#include "api.h"
+#include "graphics/canvas.h"
+#include "data/blob.h"
+#include "data/image.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrReadbackIsReady(lua_State* L) {
+  Readback* readback = luax_checktype(L, 1, Readback);
+  lua_pushboolean(L, lovrReadbackIsReady(readback));
+  return 1;
+}
+
+static int l_lovrReadbackGetImage(lua_State* L) {
+  Readback* readback = luax_checktype(L, 1, Readback);
+  Image* image = lovrReadbackGetImage(readback);
+  lovrAssert(image, "Readbacks of ShaderBlocks don't have an Image, use getBlob instead");
+  luax_pushtype(L, Image, image);
+  return 1;
+}
+
+static int l_lovrReadbackGetBlob(lua_State* L) {
+  Readback* readback = luax_checktype(L, 1, Readback);
+  Blob* blob = lovrReadbackGetBlob(readback);
+  luax_pushtype(L, Blob, blob);
+  return 1;
+}
+
+const luaL_Reg lovrReadback[] = {
+  { "isReady", l_lovrReadbackIsReady },
+  { "getImage", l_lovrReadbackGetImage },
+  { "getBlob", l_lovrReadbackGetBlob },
+  { NULL, NULL }
+};
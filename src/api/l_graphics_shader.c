@@ -193,6 +193,12 @@ static int l_lovrShaderGetType(lua_State* L) {
   return 1;
 }
 
+static int l_lovrShaderIsReady(lua_State* L) {
+  Shader* shader = luax_checktype(L, 1, Shader);
+  lua_pushboolean(L, lovrShaderIsReady(shader));
+  return 1;
+}
+
 static int l_lovrShaderHasUniform(lua_State* L) {
   Shader* shader = luax_checktype(L, 1, Shader);
   const char* name = luaL_checkstring(L, 2);
@@ -207,10 +213,23 @@ static int l_lovrShaderHasBlock(lua_State* L) {
   return 1;
 }
 
-static int l_lovrShaderSend(lua_State* L) {
+static int l_lovrShaderGetUniformHandle(lua_State* L) {
   Shader* shader = luax_checktype(L, 1, Shader);
   const char* name = luaL_checkstring(L, 2);
-  const Uniform* uniform = lovrShaderGetUniform(shader, name);
+  int handle = lovrShaderGetUniformHandle(shader, name);
+  if (handle < 0) {
+    lua_pushnil(L);
+  } else {
+    lua_pushinteger(L, handle);
+  }
+  return 1;
+}
+
+// Uniforms can be sent by name or by a handle from Shader:getUniformHandle, which skips the lookup
+static int l_lovrShaderSend(lua_State* L) {
+  Shader* shader = luax_checktype(L, 1, Shader);
+  int handle = lua_type(L, 2) == LUA_TNUMBER ? (int) lua_tointeger(L, 2) : lovrShaderGetUniformHandle(shader, luaL_checkstring(L, 2));
+  const Uniform* uniform = lovrShaderGetUniformByHandle(shader, handle);
   if (!uniform) {
     lua_pushboolean(L, false);
     return 1;
@@ -221,14 +240,15 @@ static int l_lovrShaderSend(lua_State* L) {
     tempData.data = realloc(tempData.data, tempData.size);
   }
 
-  luax_checkuniform(L, 3, uniform, tempData.data, name);
+  luax_checkuniform(L, 3, uniform, tempData.data, uniform->name);
+  int count = uniform->count;
   switch (uniform->type) {
-    case UNIFORM_FLOAT: lovrShaderSetFloats(shader, uniform->name, tempData.data, 0, uniform->count * uniform->components); break;
-    case UNIFORM_INT: lovrShaderSetInts(shader, uniform->name, tempData.data, 0, uniform->count * uniform->components); break;
-    case UNIFORM_MATRIX: lovrShaderSetMatrices(shader, uniform->name, tempData.data, 0, uniform->count * uniform->components * uniform->components); break;
-    case UNIFORM_SAMPLER: lovrShaderSetTextures(shader, uniform->name, tempData.data, 0, uniform->count); break;
-    case UNIFORM_IMAGE: lovrShaderSetImages(shader, uniform->name, tempData.data, 0, uniform->count); break;
+    case UNIFORM_FLOAT:
+    case UNIFORM_INT: count *= uniform->components; break;
+    case UNIFORM_MATRIX: count *= uniform->components * uniform->components; break;
+    default: break;
   }
+  lovrShaderUpdateUniform(shader, handle, uniform->type, tempData.data, 0, count);
   lua_pushboolean(L, true);
   return 1;
 }
@@ -265,7 +285,9 @@ static int l_lovrShaderSendImage(lua_State* L) {
 
 const luaL_Reg lovrShader[] = {
   { "getType", l_lovrShaderGetType },
+  { "isReady", l_lovrShaderIsReady },
   { "hasUniform", l_lovrShaderHasUniform },
+  { "getUniformHandle", l_lovrShaderGetUniformHandle },
   { "hasBlock", l_lovrShaderHasBlock },
   { "send", l_lovrShaderSend },
   { "sendBlock", l_lovrShaderSendBlock },
@@ -1,5 +1,6 @@
 #include "api.h"
 #include "graphics/buffer.h"
+#include "graphics/canvas.h"
 #include "graphics/shader.h"
 #include "data/blob.h"
 #include <lua.h>
@@ -35,15 +36,14 @@ static int l_lovrShaderBlockSend(lua_State* L) {
     const char* name = luaL_checkstring(L, 2);
     const Uniform* uniform = lovrShaderBlockGetUniform(block, name);
     lovrAssert(uniform, "Unknown uniform for ShaderBlock '%s'", name);
-    Buffer* buffer = lovrShaderBlockGetBuffer(block);
-    uint8_t* data = lovrBufferMap(buffer, uniform->offset, false);
+    uint8_t* data = lovrShaderBlockMap(block, uniform->offset);
     luax_checkuniform(L, 3, uniform, data, name);
-    lovrBufferFlush(buffer, uniform->offset, uniform->size);
+    lovrShaderBlockFlush(block, uniform->offset, uniform->size);
     return 0;
   } else {
     Blob* blob = luax_checktype(L, 2, Blob);
     Buffer* buffer = lovrShaderBlockGetBuffer(block);
-    void* data = lovrBufferMap(buffer, 0, false);
+    void* data = lovrShaderBlockMap(block, 0);
     int offset = luaL_optinteger(L, 3, 0);
     lovrAssert(offset >= 0, "Negative offset");
     lovrAssert((size_t) offset < blob->size, "Offset %d larger than blob (size %d)", offset, (int) blob->size);
@@ -52,12 +52,29 @@ static int l_lovrShaderBlockSend(lua_State* L) {
     size_t bufferSize = lovrBufferGetSize(buffer);
     size_t copySize = MIN(bufferSize, (size_t) size);
     memcpy(data, ((uint8_t*) blob->data) + offset, copySize);
-    lovrBufferFlush(buffer, offset, copySize);
+    lovrShaderBlockFlush(block, 0, copySize);
     lua_pushinteger(L, copySize);
     return 1;
   }
 }
 
+// Copies a range of a Blob to an offset in the block, only flushing the bytes that were written
+static int l_lovrShaderBlockWrite(lua_State* L) {
+  ShaderBlock* block = luax_checktype(L, 1, ShaderBlock);
+  size_t offset = luaL_checkinteger(L, 2);
+  Blob* blob = luax_checktype(L, 3, Blob);
+  size_t blobOffset = luaL_optinteger(L, 4, 0);
+  lovrAssert(blobOffset <= blob->size, "Blob offset %d is past the end of the Blob (size %d)", (int) blobOffset, (int) blob->size);
+  size_t size = luaL_optinteger(L, 5, blob->size - blobOffset);
+  size_t bufferSize = lovrBufferGetSize(lovrShaderBlockGetBuffer(block));
+  lovrAssert(size <= blob->size - blobOffset, "Tried to write %d bytes from a Blob with only %d left", (int) size, (int) (blob->size - blobOffset));
+  lovrAssert(offset + size <= bufferSize, "Tried to write %d bytes at offset %d of a ShaderBlock with size %d", (int) size, (int) offset, (int) bufferSize);
+  void* data = lovrShaderBlockMap(block, offset);
+  memcpy(data, (uint8_t*) blob->data + blobOffset, size);
+  lovrShaderBlockFlush(block, offset, size);
+  return 0;
+}
+
 static int l_lovrShaderBlockRead(lua_State* L) {
   ShaderBlock* block = luax_checktype(L, 1, ShaderBlock);
   const char* name = luaL_checkstring(L, 2);
@@ -108,6 +125,18 @@ static int l_lovrShaderBlockRead(lua_State* L) {
   return 1;
 }
 
+// Unlike read, this doesn't wait for compute shaders that are writing to the block to finish
+static int l_lovrShaderBlockNewReadback(lua_State* L) {
+  ShaderBlock* block = luax_checktype(L, 1, ShaderBlock);
+  Buffer* buffer = lovrShaderBlockGetBuffer(block);
+  size_t offset = luaL_optinteger(L, 2, 0);
+  size_t size = luaL_optinteger(L, 3, lovrBufferGetSize(buffer) - MIN(offset, lovrBufferGetSize(buffer)));
+  Readback* readback = lovrReadbackCreateBuffer(buffer, offset, size);
+  luax_pushtype(L, Readback, readback);
+  lovrRelease(readback, lovrReadbackDestroy);
+  return 1;
+}
+
 static int l_lovrShaderBlockGetShaderCode(lua_State* L) {
   ShaderBlock* block = luax_checktype(L, 1, ShaderBlock);
   const char* blockName = luaL_checkstring(L, 2);
@@ -124,7 +153,9 @@ const luaL_Reg lovrShaderBlock[] = {
   { "getSize", l_lovrShaderBlockGetSize },
   { "getOffset", l_lovrShaderBlockGetOffset },
   { "read", l_lovrShaderBlockRead },
+  { "newReadback", l_lovrShaderBlockNewReadback },
   { "send", l_lovrShaderBlockSend },
+  { "write", l_lovrShaderBlockWrite },
   { "getShaderCode", l_lovrShaderBlockGetShaderCode },
   { NULL, NULL }
 };
@@ -0,0 +1,64 @@
+#include "api.h"
+#include "graphics/font.h"
+#include "core/util.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrTextGetFont(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  luax_pushtype(L, Font, lovrTextGetFont(text));
+  return 1;
+}
+
+static int l_lovrTextGetString(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  size_t length;
+  const char* string = lovrTextGetString(text, &length);
+  lua_pushlstring(L, string, length);
+  return 1;
+}
+
+static int l_lovrTextSetString(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  size_t length;
+  const char* string = luaL_checklstring(L, 2, &length);
+  lovrTextSetString(text, string, length);
+  return 0;
+}
+
+static int l_lovrTextGetWrap(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  lua_pushnumber(L, lovrTextGetWrap(text));
+  return 1;
+}
+
+static int l_lovrTextSetWrap(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  float wrap = luax_optfloat(L, 2, 0.f);
+  lovrTextSetWrap(text, wrap);
+  return 0;
+}
+
+static int l_lovrTextGetAlign(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  luax_pushenum(L, HorizontalAlign, lovrTextGetAlign(text));
+  return 1;
+}
+
+static int l_lovrTextSetAlign(lua_State* L) {
+  Text* text = luax_checktype(L, 1, Text);
+  HorizontalAlign halign = luax_checkenum(L, 2, HorizontalAlign, "center");
+  lovrTextSetAlign(text, halign);
+  return 0;
+}
+
+const luaL_Reg lovrText[] = {
+  { "getFont", l_lovrTextGetFont },
+  { "getString", l_lovrTextGetString },
+  { "setString", l_lovrTextSetString },
+  { "getWrap", l_lovrTextGetWrap },
+  { "setWrap", l_lovrTextSetWrap },
+  { "getAlign", l_lovrTextGetAlign },
+  { "setAlign", l_lovrTextSetAlign },
+  { NULL, NULL }
+};
@@ -0,0 +1,99 @@
+#include "api.h"
+#include "graphics/canvas.h"
+#include "graphics/shader.h"
+#include "graphics/texture.h"
+#include "graphics/virtualTexture.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrVirtualTextureRenderFeedback(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  int argumentCount = lua_gettop(L) - 2;
+  lovrVirtualTextureBeginFeedback(texture);
+  lua_call(L, argumentCount, 0);
+  lovrVirtualTextureEndFeedback(texture);
+  return 0;
+}
+
+static int l_lovrVirtualTextureUpdate(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  lovrVirtualTextureUpdate(texture);
+  return 0;
+}
+
+static int l_lovrVirtualTextureSend(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  Shader* shader = luax_checktype(L, 2, Shader);
+  lovrVirtualTextureBind(texture, shader);
+  return 0;
+}
+
+static int l_lovrVirtualTextureGetAtlas(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  luax_pushtype(L, Texture, lovrVirtualTextureGetAtlas(texture));
+  return 1;
+}
+
+static int l_lovrVirtualTextureGetPageTable(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  luax_pushtype(L, Texture, lovrVirtualTextureGetPageTable(texture));
+  return 1;
+}
+
+static int l_lovrVirtualTextureGetFeedbackCanvas(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  luax_pushtype(L, Canvas, lovrVirtualTextureGetFeedbackCanvas(texture));
+  return 1;
+}
+
+static int l_lovrVirtualTextureGetWidth(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  lua_pushinteger(L, lovrVirtualTextureGetWidth(texture));
+  return 1;
+}
+
+static int l_lovrVirtualTextureGetHeight(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  lua_pushinteger(L, lovrVirtualTextureGetHeight(texture));
+  return 1;
+}
+
+static int l_lovrVirtualTextureGetDimensions(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  lua_pushinteger(L, lovrVirtualTextureGetWidth(texture));
+  lua_pushinteger(L, lovrVirtualTextureGetHeight(texture));
+  return 2;
+}
+
+static int l_lovrVirtualTextureGetTileSize(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  const VirtualTextureInfo* info = lovrVirtualTextureGetInfo(texture);
+  lua_pushinteger(L, info->tileSize);
+  lua_pushinteger(L, info->border);
+  return 2;
+}
+
+static int l_lovrVirtualTextureGetStats(lua_State* L) {
+  VirtualTexture* texture = luax_checktype(L, 1, VirtualTexture);
+  uint32_t resident, pending;
+  lovrVirtualTextureGetStats(texture, &resident, &pending);
+  lua_pushinteger(L, resident);
+  lua_pushinteger(L, pending);
+  return 2;
+}
+
+const luaL_Reg lovrVirtualTexture[] = {
+  { "renderFeedback", l_lovrVirtualTextureRenderFeedback },
+  { "update", l_lovrVirtualTextureUpdate },
+  { "send", l_lovrVirtualTextureSend },
+  { "getAtlas", l_lovrVirtualTextureGetAtlas },
+  { "getPageTable", l_lovrVirtualTextureGetPageTable },
+  { "getFeedbackCanvas", l_lovrVirtualTextureGetFeedbackCanvas },
+  { "getWidth", l_lovrVirtualTextureGetWidth },
+  { "getHeight", l_lovrVirtualTextureGetHeight },
+  { "getDimensions", l_lovrVirtualTextureGetDimensions },
+  { "getTileSize", l_lovrVirtualTextureGetTileSize },
+  { "getStats", l_lovrVirtualTextureGetStats },
+  { NULL, NULL }
+};
@@ -26,6 +26,20 @@ StringEntry lovrHeadsetOrigin[] = {
   { 0 }
 };
 
+StringEntry lovrFoveationLevel[] = {
+  [FOVEATION_NONE] = ENTRY("none"),
+  [FOVEATION_LOW] = ENTRY("low"),
+  [FOVEATION_MEDIUM] = ENTRY("medium"),
+  [FOVEATION_HIGH] = ENTRY("high"),
+  { 0 }
+};
+
+StringEntry lovrLayerType[] = {
+  [LAYER_QUAD] = ENTRY("quad"),
+  [LAYER_CYLINDER] = ENTRY("cylinder"),
+  { 0 }
+};
+
 StringEntry lovrDevice[] = {
   [DEVICE_HEAD] = ENTRY("head"),
   [DEVICE_HAND_LEFT] = ENTRY("hand/left"),
@@ -104,13 +118,13 @@ static void renderHelper(void* userdata) {
 }
 
 static Device luax_optdevice(lua_State* L, int index) {
-  const char* str = luaL_optstring(L, 1, "head");
+  const char* str = luaL_optstring(L, index, "head");
   if (!strcmp(str, "left")) {
     return DEVICE_HAND_LEFT;
   } else if (!strcmp(str, "right")) {
     return DEVICE_HAND_RIGHT;
   }
-  return luax_checkenum(L, 1, Device, "head");
+  return luax_checkenum(L, index, Device, "head");
 }
 
 static int l_lovrHeadsetInit(lua_State* L) {
@@ -123,6 +137,7 @@ static int l_lovrHeadsetInit(lua_State* L) {
   float offset = 1.7f;
   int msaa = 4;
   bool overlay = false;
+  bool pipelined = false;
 
   if (lua_istable(L, -1)) {
 
@@ -160,10 +175,15 @@ static int l_lovrHeadsetInit(lua_State* L) {
     lua_getfield(L, -1, "overlay");
     overlay = lua_toboolean(L, -1);
     lua_pop(L, 1);
+
+    // Pipelined
+    lua_getfield(L, -1, "pipelined");
+    pipelined = lua_toboolean(L, -1);
+    lua_pop(L, 1);
   }
 
   luax_atexit(L, lovrHeadsetDestroy); // Always make sure the headset module gets cleaned up
-  lovrHeadsetInit(drivers, driverCount, supersample, offset, msaa, overlay);
+  lovrHeadsetInit(drivers, driverCount, supersample, offset, msaa, overlay, pipelined);
 
   lua_pop(L, 2);
   return 0;
@@ -310,6 +330,90 @@ static int l_lovrHeadsetSetClipDistance(lua_State* L) {
   return 0;
 }
 
+// Returns whether foveated rendering was changed, which it can't be on runtimes without support
+static int l_lovrHeadsetSetFoveation(lua_State* L) {
+  FoveationLevel level = lua_type(L, 1) == LUA_TBOOLEAN && !lua_toboolean(L, 1) ? FOVEATION_NONE : luax_checkenum(L, 1, FoveationLevel, "none");
+  bool dynamic = lua_toboolean(L, 2);
+  bool success = lovrHeadsetDisplayDriver->setFoveation ? lovrHeadsetDisplayDriver->setFoveation(level, dynamic) : false;
+  lua_pushboolean(L, success);
+  return 1;
+}
+
+// The scale is adjusted automatically to keep the GPU time of each frame below the display period
+static int l_lovrHeadsetSetDynamicResolution(lua_State* L) {
+  bool enable = lua_toboolean(L, 1);
+  float min = luax_optfloat(L, 2, .5f);
+  float max = luax_optfloat(L, 3, 1.f);
+  bool success = lovrHeadsetDisplayDriver->setDynamicResolution ? lovrHeadsetDisplayDriver->setDynamicResolution(enable, min, max) : false;
+  lua_pushboolean(L, success);
+  return 1;
+}
+
+static int l_lovrHeadsetGetResolutionScale(lua_State* L) {
+  float scale = lovrHeadsetDisplayDriver->getResolutionScale ? lovrHeadsetDisplayDriver->getResolutionScale() : 1.f;
+  lua_pushnumber(L, scale);
+  return 1;
+}
+
+// Returns whether SpaceWarp is supported.  When it's on, the runtime can render every other frame
+// from motion vectors, which the default shaders (and custom ones using color) write automatically.
+static int l_lovrHeadsetSetSpaceWarp(lua_State* L) {
+  bool enable = lua_toboolean(L, 1);
+  bool success = lovrHeadsetDisplayDriver->setSpaceWarp ? lovrHeadsetDisplayDriver->setSpaceWarp(enable) : false;
+  lua_pushboolean(L, success);
+  return 1;
+}
+
+static int l_lovrHeadsetSetDepthSubmission(lua_State* L) {
+  bool enable = lua_toboolean(L, 1);
+  bool success = lovrHeadsetDisplayDriver->setDepthSubmission ? lovrHeadsetDisplayDriver->setDepthSubmission(enable) : false;
+  lua_pushboolean(L, success);
+  return 1;
+}
+
+static int l_lovrHeadsetSetLateLatching(lua_State* L) {
+  bool enable = lua_toboolean(L, 1);
+  bool success = lovrHeadsetDisplayDriver->setLateLatching ? lovrHeadsetDisplayDriver->setLateLatching(enable) : false;
+  lua_pushboolean(L, success);
+  return 1;
+}
+
+// Unknown times are left out of the table
+static int l_lovrHeadsetGetFrameTiming(lua_State* L) {
+  FrameTiming timing;
+  if (!lovrHeadsetDisplayDriver->getFrameTiming || !lovrHeadsetDisplayDriver->getFrameTiming(&timing)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  if (lua_istable(L, 1)) {
+    lua_settop(L, 1);
+  } else {
+    lua_createtable(L, 0, 6);
+  }
+
+  struct { const char* name; double value; } times[] = {
+    { "frameWait", timing.frameWait },
+    { "swapchainWait", timing.swapchainWait },
+    { "gpuTime", timing.gpuTime },
+    { "compositorCpuTime", timing.compositorCpuTime },
+    { "compositorGpuTime", timing.compositorGpuTime }
+  };
+
+  for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+    if (times[i].value >= 0.) {
+      lua_pushnumber(L, times[i].value);
+    } else {
+      lua_pushnil(L);
+    }
+    lua_setfield(L, -2, times[i].name);
+  }
+
+  lua_pushinteger(L, timing.missedFrames);
+  lua_setfield(L, -2, "missedFrames");
+  return 1;
+}
+
 static int l_lovrHeadsetGetBoundsWidth(lua_State* L) {
   float width, depth;
   lovrHeadsetDisplayDriver->getBoundsDimensions(&width, &depth);
@@ -397,6 +501,60 @@ static int l_lovrHeadsetGetPose(lua_State* L) {
   return 7;
 }
 
+// Takes a list of devices and returns a list with a pose table for each, or false if the device
+// isn't tracked.  The tables of the optional output list are reused to avoid creating garbage.
+static int l_lovrHeadsetGetPoses(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  if (lua_istable(L, 2)) {
+    lua_settop(L, 2);
+  } else {
+    lua_settop(L, 1);
+    lua_newtable(L);
+  }
+
+  int count = luax_len(L, 1);
+  float position[4], orientation[4];
+  for (int i = 1; i <= count; i++) {
+    lua_rawgeti(L, 1, i);
+    Device device = luax_optdevice(L, -1);
+    lua_pop(L, 1);
+
+    bool tracked = false;
+    FOREACH_TRACKING_DRIVER(driver) {
+      if (driver->getPose(device, position, orientation)) {
+        tracked = true;
+        break;
+      }
+    }
+
+    if (!tracked) {
+      lua_pushboolean(L, false);
+      lua_rawseti(L, 2, i);
+      continue;
+    }
+
+    float pose[7];
+    memcpy(pose, position, 3 * sizeof(float));
+    quat_getAngleAxis(orientation, &pose[3], &pose[4], &pose[5], &pose[6]);
+
+    lua_rawgeti(L, 2, i);
+    if (!lua_istable(L, -1)) {
+      lua_pop(L, 1);
+      lua_createtable(L, 7, 0);
+      lua_pushvalue(L, -1);
+      lua_rawseti(L, 2, i);
+    }
+
+    for (int j = 0; j < 7; j++) {
+      lua_pushnumber(L, pose[j]);
+      lua_rawseti(L, -2, j + 1);
+    }
+    lua_pop(L, 1);
+  }
+
+  return 1;
+}
+
 static int l_lovrHeadsetGetPosition(lua_State* L) {
   Device device = luax_optdevice(L, 1);
   float position[4], orientation[4];
@@ -625,7 +783,7 @@ static int l_lovrHeadsetNewModel(lua_State* L) {
   }
 
   if (modelData) {
-    Model* model = lovrModelCreate(modelData);
+    Model* model = lovrModelCreate(modelData, false, false);
     luax_pushtype(L, Model, model);
     lovrRelease(modelData, lovrModelDataDestroy);
     lovrRelease(model, lovrModelDestroy);
@@ -701,6 +859,16 @@ static int l_lovrHeadsetGetMirrorTexture(lua_State* L) {
   return 1;
 }
 
+static int l_lovrHeadsetNewLayer(lua_State* L) {
+  LayerType type = luax_checkenum(L, 1, LayerType, NULL);
+  uint32_t width = luaL_checkinteger(L, 2);
+  uint32_t height = luaL_checkinteger(L, 3);
+  Layer* layer = lovrLayerCreate(type, width, height);
+  luax_pushtype(L, Layer, layer);
+  lovrRelease(layer, lovrLayerDestroy);
+  return 1;
+}
+
 static int l_lovrHeadsetGetHands(lua_State* L) {
   if (lua_istable(L, 1)) {
     lua_settop(L, 1);
@@ -739,12 +907,20 @@ static const luaL_Reg lovrHeadset[] = {
   { "getViewAngles", l_lovrHeadsetGetViewAngles },
   { "getClipDistance", l_lovrHeadsetGetClipDistance },
   { "setClipDistance", l_lovrHeadsetSetClipDistance },
+  { "setFoveation", l_lovrHeadsetSetFoveation },
+  { "setDynamicResolution", l_lovrHeadsetSetDynamicResolution },
+  { "getResolutionScale", l_lovrHeadsetGetResolutionScale },
+  { "setSpaceWarp", l_lovrHeadsetSetSpaceWarp },
+  { "setDepthSubmission", l_lovrHeadsetSetDepthSubmission },
+  { "setLateLatching", l_lovrHeadsetSetLateLatching },
+  { "getFrameTiming", l_lovrHeadsetGetFrameTiming },
   { "getBoundsWidth", l_lovrHeadsetGetBoundsWidth },
   { "getBoundsDepth", l_lovrHeadsetGetBoundsDepth },
   { "getBoundsDimensions", l_lovrHeadsetGetBoundsDimensions },
   { "getBoundsGeometry", l_lovrHeadsetGetBoundsGeometry },
   { "isTracked", l_lovrHeadsetIsTracked },
   { "getPose", l_lovrHeadsetGetPose },
+  { "getPoses", l_lovrHeadsetGetPoses },
   { "getPosition", l_lovrHeadsetGetPosition },
   { "getOrientation", l_lovrHeadsetGetOrientation },
   { "getVelocity", l_lovrHeadsetGetVelocity },
@@ -762,13 +938,17 @@ static const luaL_Reg lovrHeadset[] = {
   { "update", l_lovrHeadsetUpdate },
   { "getTime", l_lovrHeadsetGetTime },
   { "getMirrorTexture", l_lovrHeadsetGetMirrorTexture },
+  { "newLayer", l_lovrHeadsetNewLayer },
   { "getHands", l_lovrHeadsetGetHands },
   { NULL, NULL }
 };
 
+extern const luaL_Reg lovrLayer[];
+
 int luaopen_lovr_headset(lua_State* L) {
   lua_newtable(L);
   luax_register(L, lovrHeadset);
+  luax_registertype(L, Layer);
   headsetRenderData.ref = LUA_NOREF;
   return 1;
 }
@@ -0,0 +1,113 @@
+#include "api.h"
+#include "headset/headset.h"
+#include "graphics/graphics.h"
+#include "graphics/canvas.h"
+#include "core/maf.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+static int l_lovrLayerGetType(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  luax_pushenum(L, LayerType, layer->type);
+  return 1;
+}
+
+static int l_lovrLayerGetDimensions(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  lua_pushinteger(L, layer->width);
+  lua_pushinteger(L, layer->height);
+  return 2;
+}
+
+// Renders the next image of the layer, which the compositor keeps showing until it's rendered again
+static int l_lovrLayerRenderTo(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  luaL_checktype(L, 2, LUA_TFUNCTION);
+  int argumentCount = lua_gettop(L) - 2;
+  Canvas* old = lovrGraphicsGetCanvas();
+  lovrGraphicsSetCanvas(lovrLayerAcquire(layer));
+  lua_call(L, argumentCount, 0);
+  lovrGraphicsSetCanvas(old);
+  lovrLayerRelease(layer);
+  return 0;
+}
+
+static int l_lovrLayerGetPose(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  float position[4], orientation[4], angle, ax, ay, az;
+  lovrLayerGetPose(layer, position, orientation);
+  quat_getAngleAxis(orientation, &angle, &ax, &ay, &az);
+  lua_pushnumber(L, position[0]);
+  lua_pushnumber(L, position[1]);
+  lua_pushnumber(L, position[2]);
+  lua_pushnumber(L, angle);
+  lua_pushnumber(L, ax);
+  lua_pushnumber(L, ay);
+  lua_pushnumber(L, az);
+  return 7;
+}
+
+static int l_lovrLayerSetPose(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  float position[4], orientation[4];
+  int index = luax_readvec3(L, 2, position, NULL);
+  luax_readquat(L, index, orientation, NULL);
+  lovrLayerSetPose(layer, position, orientation);
+  return 0;
+}
+
+static int l_lovrLayerGetSize(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  float width, height;
+  lovrLayerGetSize(layer, &width, &height);
+  lua_pushnumber(L, width);
+  lua_pushnumber(L, height);
+  return 2;
+}
+
+static int l_lovrLayerSetSize(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  float width = luax_checkfloat(L, 2);
+  float height = luax_optfloat(L, 3, width * layer->height / layer->width);
+  lovrLayerSetSize(layer, width, height);
+  return 0;
+}
+
+static int l_lovrLayerGetRadius(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  lua_pushnumber(L, lovrLayerGetRadius(layer));
+  return 1;
+}
+
+static int l_lovrLayerSetRadius(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  lovrLayerSetRadius(layer, luax_checkfloat(L, 2));
+  return 0;
+}
+
+static int l_lovrLayerIsVisible(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  lua_pushboolean(L, lovrLayerIsVisible(layer));
+  return 1;
+}
+
+static int l_lovrLayerSetVisible(lua_State* L) {
+  Layer* layer = luax_checktype(L, 1, Layer);
+  lovrLayerSetVisible(layer, lua_toboolean(L, 2));
+  return 0;
+}
+
+const luaL_Reg lovrLayer[] = {
+  { "getType", l_lovrLayerGetType },
+  { "getDimensions", l_lovrLayerGetDimensions },
+  { "renderTo", l_lovrLayerRenderTo },
+  { "getPose", l_lovrLayerGetPose },
+  { "setPose", l_lovrLayerSetPose },
+  { "getSize", l_lovrLayerGetSize },
+  { "setSize", l_lovrLayerSetSize },
+  { "getRadius", l_lovrLayerGetRadius },
+  { "setRadius", l_lovrLayerSetRadius },
+  { "isVisible", l_lovrLayerIsVisible },
+  { "setVisible", l_lovrLayerSetVisible },
+  { NULL, NULL }
+};
@@ -1,7 +1,9 @@
 #include "api.h"
+#include "core/os.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
+#include <string.h>
 
 static int l_lovrGetVersion(lua_State* L) {
   lua_pushinteger(L, LOVR_VERSION_MAJOR);
@@ -10,13 +12,91 @@ static int l_lovrGetVersion(lua_State* L) {
   return 3;
 }
 
+// With a garbage budget, the automatic collector is stopped and the run loop spends up to that much
+// time per frame collecting after the frame is presented, so collection happens in the slack before
+// the next vsync or frame wait instead of in the middle of rendering.  If a cycle falls too far
+// behind (memory has doubled since the last one finished), the step keeps going until it's done.
+static struct {
+  double budget;
+  double time;
+  uint32_t steps;
+  uint32_t cycles;
+  size_t threshold;
+} gc;
+
+#define GC_STEP_SIZE 16
+
+static size_t getMemory(lua_State* L) {
+  return (size_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+static int l_lovrGetGarbageBudget(lua_State* L) {
+  lua_pushnumber(L, gc.budget);
+  return 1;
+}
+
+static int l_lovrSetGarbageBudget(lua_State* L) {
+  gc.budget = MAX(luaL_optnumber(L, 1, 0.), 0.);
+  gc.threshold = 2 * getMemory(L);
+  lua_gc(L, gc.budget > 0. ? LUA_GCSTOP : LUA_GCRESTART, 0);
+  return 0;
+}
+
+static int l_lovrCollectGarbage(lua_State* L) {
+  gc.time = 0.;
+  gc.steps = 0;
+
+  if (gc.budget <= 0.) {
+    lua_pushboolean(L, false);
+    return 1;
+  }
+
+  double start = os_get_time();
+  bool finished = false;
+  do {
+    gc.steps++;
+    if (lua_gc(L, LUA_GCSTEP, GC_STEP_SIZE)) {
+      gc.threshold = 2 * getMemory(L);
+      gc.cycles++;
+      finished = true;
+      break;
+    }
+    gc.time = os_get_time() - start;
+  } while (gc.time < gc.budget || getMemory(L) > gc.threshold);
+
+  gc.time = os_get_time() - start;
+  lua_pushboolean(L, finished);
+  return 1;
+}
+
+static int l_lovrGetGarbageStats(lua_State* L) {
+  lua_createtable(L, 0, 4);
+  lua_pushnumber(L, gc.time);
+  lua_setfield(L, -2, "time");
+  lua_pushinteger(L, gc.steps);
+  lua_setfield(L, -2, "steps");
+  lua_pushinteger(L, gc.cycles);
+  lua_setfield(L, -2, "cycles");
+  lua_pushnumber(L, (lua_Number) getMemory(L));
+  lua_setfield(L, -2, "memory");
+  return 1;
+}
+
 static const luaL_Reg lovr[] = {
   { "_setConf", luax_setconf },
+#ifdef LOVR_USE_LUAJIT
+  { "_installFFI", luax_installffi },
+#endif
   { "getVersion", l_lovrGetVersion },
+  { "getGarbageBudget", l_lovrGetGarbageBudget },
+  { "setGarbageBudget", l_lovrSetGarbageBudget },
+  { "collectGarbage", l_lovrCollectGarbage },
+  { "getGarbageStats", l_lovrGetGarbageStats },
   { NULL, NULL }
 };
 
 int luaopen_lovr(lua_State* L) {
+  memset(&gc, 0, sizeof(gc));
   lua_newtable(L);
   luax_register(L, lovr);
   return 1;
@@ -3,11 +3,14 @@
 #include "math/curve.h"
 #include "math/pool.h"
 #include "math/randomGenerator.h"
+#include "data/blob.h"
+#include "data/image.h"
 #include "core/maf.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
 #include <stdlib.h>
+#include <string.h>
 
 int l_lovrRandomGeneratorRandom(lua_State* L);
 int l_lovrRandomGeneratorRandomNormal(lua_State* L);
@@ -55,6 +58,14 @@ static const char* lovrVectorTypeNames[] = {
 
 static void luax_destroypool(void) {
   lovrRelease(pool, lovrPoolDestroy);
+  pool = NULL;
+}
+
+// Invalidates the temporary vectors of the current thread, if it has loaded lovr.math
+void luax_drainvectors(void) {
+  if (pool) {
+    lovrPoolDrain(pool);
+  }
 }
 
 float* luax_tovector(lua_State* L, int index, VectorType* type) {
@@ -63,8 +74,8 @@ float* luax_tovector(lua_State* L, int index, VectorType* type) {
   if (p) {
     if (lua_type(L, index) == LUA_TLIGHTUSERDATA) {
       Vector v = { .pointer = p };
-      if (v.handle.type > V_NONE && v.handle.type < MAX_VECTOR_TYPES) {
-        *type = v.handle.type;
+      if (VECTOR_TYPE(v) > V_NONE && VECTOR_TYPE(v) < MAX_VECTOR_TYPES) {
+        *type = VECTOR_TYPE(v);
         return lovrPoolResolve(pool, v);
       }
     } else {
@@ -222,6 +233,194 @@ static int l_lovrMathLinearToGamma(lua_State* L) {
   }
 }
 
+// Options are x, y, and z offsets (z switches to 3D noise), scale (the frequency of the first
+// octave), octaves, lacunarity, and gain
+static void luax_readnoiseinfo(lua_State* L, int index, NoiseInfo* info) {
+  *info = (NoiseInfo) { .scale = 1.f / 32.f, .lacunarity = 2.f, .gain = .5f, .octaves = 1 };
+  if (lua_isnoneornil(L, index)) {
+    return;
+  }
+
+  luaL_checktype(L, index, LUA_TTABLE);
+  lua_getfield(L, index, "x");
+  info->x = luax_optfloat(L, -1, 0.f);
+  lua_getfield(L, index, "y");
+  info->y = luax_optfloat(L, -1, 0.f);
+  lua_getfield(L, index, "z");
+  info->volume = !lua_isnil(L, -1);
+  info->z = luax_optfloat(L, -1, 0.f);
+  lua_getfield(L, index, "scale");
+  info->scale = luax_optfloat(L, -1, info->scale);
+  lua_getfield(L, index, "lacunarity");
+  info->lacunarity = luax_optfloat(L, -1, info->lacunarity);
+  lua_getfield(L, index, "gain");
+  info->gain = luax_optfloat(L, -1, info->gain);
+  lua_getfield(L, index, "octaves");
+  info->octaves = luaL_optinteger(L, -1, info->octaves);
+  lua_pop(L, 7);
+  lovrAssert(info->octaves > 0 && info->octaves <= 32, "Noise octave count must be between 1 and 32");
+}
+
+// Fills a Blob (width * height floats) or an Image with fractal noise.  Images are filled so noise
+// coordinates match getPixel coordinates, color formats get the noise in every channel.
+static int l_lovrMathFillNoise(lua_State* L) {
+  NoiseInfo info;
+  Image* image = luax_totype(L, 1, Image);
+
+  if (!image) {
+    Blob* blob = luax_checktype(L, 1, Blob);
+    uint32_t width = luaL_checkinteger(L, 2);
+    uint32_t height = luaL_checkinteger(L, 3);
+    luax_readnoiseinfo(L, 4, &info);
+    lovrAssert((uint64_t) width * height * sizeof(float) <= blob->size, "Blob is too small for a %dx%d grid of floats", width, height);
+    Blob* root = blob;
+    while (root->parent) root = root->parent;
+    lovrAssert(!root->mapped, "Blob is mapped from a file and can not be modified");
+#ifndef LOVR_DISABLE_THREAD
+    luax_startpool(L);
+#endif
+    lovrMathNoiseFill(blob->data, width, height, &info);
+    return 0;
+  }
+
+  luax_readnoiseinfo(L, 2, &info);
+  uint32_t width = image->width;
+  uint32_t height = image->height;
+  size_t pixelCount = (size_t) width * height;
+  lovrAssert(image->blob->data, "Image does not have any pixel data");
+
+  switch (image->format) {
+    case FORMAT_R32F: case FORMAT_RGBA32F: case FORMAT_RGB: case FORMAT_RGBA: break;
+    default: lovrThrow("Unsupported format for lovr.math.fillNoise");
+  }
+
+#ifndef LOVR_DISABLE_THREAD
+  luax_startpool(L);
+#endif
+
+  temp_mark_t mark = temp_mark();
+  float* values = temp_alloc(pixelCount * sizeof(float));
+  lovrMathNoiseFill(values, width, height, &info);
+
+  // Image rows are stored bottom to top
+  for (uint32_t y = 0; y < height; y++) {
+    float* src = values + (size_t) y * width;
+    size_t row = (size_t) (height - y - 1) * width;
+    uint8_t* u8 = (uint8_t*) image->blob->data;
+    float* f32 = (float*) image->blob->data;
+    switch (image->format) {
+      case FORMAT_R32F: memcpy(f32 + row, src, width * sizeof(float)); break;
+      case FORMAT_RGBA32F:
+        for (uint32_t x = 0; x < width; x++) {
+          float* p = f32 + (row + x) * 4;
+          p[0] = p[1] = p[2] = src[x];
+          p[3] = 1.f;
+        }
+        break;
+      case FORMAT_RGB:
+        for (uint32_t x = 0; x < width; x++) {
+          uint8_t* p = u8 + (row + x) * 3;
+          p[0] = p[1] = p[2] = (uint8_t) (src[x] * 255.f + .5f);
+        }
+        break;
+      case FORMAT_RGBA:
+        for (uint32_t x = 0; x < width; x++) {
+          uint8_t* p = u8 + (row + x) * 4;
+          p[0] = p[1] = p[2] = (uint8_t) (src[x] * 255.f + .5f);
+          p[3] = 255;
+        }
+        break;
+      default: break;
+    }
+  }
+
+  temp_rewind(mark);
+  return 0;
+}
+
+// Batch functions take a Blob of floats and, at the end of their arguments, an optional byte
+// offset, element count, and byte stride.  By default they use every packed element after the offset.
+static float* luax_checkarray(lua_State* L, int index, int rangeIndex, size_t size, bool write, uint32_t* count, size_t* stride) {
+  Blob* blob = luax_checktype(L, index, Blob);
+  lua_Integer offset = luaL_optinteger(L, rangeIndex, 0);
+  lua_Integer n = luaL_optinteger(L, rangeIndex + 2, (lua_Integer) size);
+  lovrAssert(offset >= 0, "Blob offset can not be negative");
+  lovrAssert(n >= (lua_Integer) size, "Stride can not be smaller than the element size (%d)", (int) size);
+  lovrAssert(offset % 4 == 0 && n % 4 == 0, "Offset and stride must be multiples of 4");
+  *stride = (size_t) n;
+
+  if (lua_isnoneornil(L, rangeIndex + 1)) {
+    n = (size_t) offset + size <= blob->size ? (blob->size - offset - size) / *stride + 1 : 0;
+  } else {
+    n = luaL_checkinteger(L, rangeIndex + 1);
+    lovrAssert(n >= 0, "Count can not be negative");
+    lovrAssert(n == 0 || (size_t) offset + (n - 1) * *stride + size <= blob->size, "Tried to access %d elements at offset %d, but the Blob only has %d bytes", (int) n, (int) offset, (int) blob->size);
+  }
+
+  lovrAssert(n <= UINT32_MAX, "Too many elements");
+  *count = (uint32_t) n;
+
+  if (write) {
+    Blob* root = blob;
+    while (root->parent) root = root->parent;
+    lovrAssert(!root->mapped, "Blob is mapped from a file and can not be modified");
+  }
+
+  return (float*) ((char*) blob->data + offset);
+}
+
+static int l_lovrMathTransformPoints(lua_State* L) {
+  uint32_t count;
+  size_t stride;
+  float* points = luax_checkarray(L, 1, 3, 3 * sizeof(float), true, &count, &stride);
+  float* transform = luax_checkvector(L, 2, V_MAT4, NULL);
+  lovrMathTransformPoints(transform, points, count, stride);
+  return 0;
+}
+
+static int l_lovrMathNormalizeVectors(lua_State* L) {
+  uint32_t count;
+  size_t stride;
+  float* vectors = luax_checkarray(L, 1, 2, 3 * sizeof(float), true, &count, &stride);
+  lovrMathNormalizeVectors(vectors, count, stride);
+  return 0;
+}
+
+// The target is a quat, or a Blob of quaternions using the same range
+static int l_lovrMathSlerpQuaternions(lua_State* L) {
+  uint32_t count;
+  size_t stride;
+  float* quaternions = luax_checkarray(L, 1, 4, 4 * sizeof(float), true, &count, &stride);
+  float t = luax_checkfloat(L, 3);
+  if (luax_totype(L, 2, Blob)) {
+    uint32_t targetCount;
+    size_t targetStride;
+    lua_settop(L, 6);
+    lua_pushinteger(L, count);
+    lua_replace(L, 5);
+    float* targets = luax_checkarray(L, 2, 4, 4 * sizeof(float), false, &targetCount, &targetStride);
+    lovrMathSlerpQuaternions(quaternions, targets, t, count, stride, targetStride);
+  } else {
+    float* target = luax_checkvector(L, 2, V_QUAT, "quat or Blob");
+    lovrMathSlerpQuaternions(quaternions, target, t, count, stride, 0);
+  }
+  return 0;
+}
+
+// Returns minx, maxx, miny, maxy, minz, maxz, like the other getAABB functions
+static int l_lovrMathGetBounds(lua_State* L) {
+  uint32_t count;
+  size_t stride;
+  float* points = luax_checkarray(L, 1, 2, 3 * sizeof(float), false, &count, &stride);
+  lovrAssert(count > 0, "Can not compute the bounds of zero points");
+  float bounds[6];
+  lovrMathGetBounds(points, count, stride, bounds);
+  for (int i = 0; i < 6; i++) {
+    lua_pushnumber(L, bounds[i]);
+  }
+  return 6;
+}
+
 static int l_lovrMathNewVec2(lua_State* L) {
   luax_newvector(L, V_VEC2, 2);
   lua_insert(L, 1);
@@ -291,12 +490,17 @@ static const luaL_Reg lovrMath[] = {
   { "newCurve", l_lovrMathNewCurve },
   { "newRandomGenerator", l_lovrMathNewRandomGenerator },
   { "noise", l_lovrMathNoise },
+  { "fillNoise", l_lovrMathFillNoise },
   { "random", l_lovrMathRandom },
   { "randomNormal", l_lovrMathRandomNormal },
   { "getRandomSeed", l_lovrMathGetRandomSeed },
   { "setRandomSeed", l_lovrMathSetRandomSeed },
   { "gammaToLinear", l_lovrMathGammaToLinear },
   { "linearToGamma", l_lovrMathLinearToGamma },
+  { "transformPoints", l_lovrMathTransformPoints },
+  { "normalizeVectors", l_lovrMathNormalizeVectors },
+  { "slerpQuaternions", l_lovrMathSlerpQuaternions },
+  { "getBounds", l_lovrMathGetBounds },
   { "newVec2", l_lovrMathNewVec2 },
   { "newVec3", l_lovrMathNewVec3 },
   { "newVec4", l_lovrMathNewVec4 },
@@ -26,26 +26,38 @@ static int l_lovrCurveGetTangent(lua_State* L) {
   return 3;
 }
 
+// Samples are evenly spaced along the curve instead of in t when the last argument is true
 static int l_lovrCurveRender(lua_State* L) {
   Curve* curve = luax_checktype(L, 1, Curve);
   int n = luaL_optinteger(L, 2, 32);
   float t1 = luax_optfloat(L, 3, 0.);
   float t2 = luax_optfloat(L, 4, 1.);
-  if (lovrCurveGetPointCount(curve) == 2) {
+  bool even = lua_toboolean(L, 5);
+  if (lovrCurveGetPointCount(curve) == 2 && !even) {
     n = 2;
   }
+  lovrAssert(n > 0, "Curve sample count must be positive");
+  temp_mark_t mark = temp_mark();
+  float* points = temp_alloc(n * 4 * sizeof(float));
+  lovrCurveRender(curve, t1, t2, points, n, even);
   lua_createtable(L, n * 3, 0);
-  float step = 1.f / (n - 1);
   for (int i = 0; i < n; i++) {
-    float point[4];
-    lovrCurveEvaluate(curve, t1 + (t2 - t1) * i * step, point);
-    lua_pushnumber(L, point[0]);
+    lua_pushnumber(L, points[4 * i + 0]);
     lua_rawseti(L, -2, 3 * i + 1);
-    lua_pushnumber(L, point[1]);
+    lua_pushnumber(L, points[4 * i + 1]);
     lua_rawseti(L, -2, 3 * i + 2);
-    lua_pushnumber(L, point[2]);
+    lua_pushnumber(L, points[4 * i + 2]);
     lua_rawseti(L, -2, 3 * i + 3);
   }
+  temp_rewind(mark);
+  return 1;
+}
+
+static int l_lovrCurveGetLength(lua_State* L) {
+  Curve* curve = luax_checktype(L, 1, Curve);
+  float t1 = luax_optfloat(L, 2, 0.);
+  float t2 = luax_optfloat(L, 3, 1.);
+  lua_pushnumber(L, lovrCurveGetLength(curve, t1, t2));
   return 1;
 }
 
@@ -109,6 +121,7 @@ const luaL_Reg lovrCurve[] = {
   { "getTangent", l_lovrCurveGetTangent },
   { "render", l_lovrCurveRender },
   { "slice", l_lovrCurveSlice },
+  { "getLength", l_lovrCurveGetLength },
   { "getPointCount", l_lovrCurveGetPointCount },
   { "getPoint", l_lovrCurveGetPoint },
   { "setPoint", l_lovrCurveSetPoint },
@@ -1,10 +1,17 @@
 #include "api.h"
 #include "math/randomGenerator.h"
+#include "data/blob.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
 #include <math.h>
 
+StringEntry lovrRandomDistribution[] = {
+  [DISTRIBUTION_UNIFORM] = ENTRY("uniform"),
+  [DISTRIBUTION_NORMAL] = ENTRY("normal"),
+  { 0 }
+};
+
 static double luax_checkrandomseedpart(lua_State* L, int index) {
   double x = luaL_checknumber(L, index);
 
@@ -87,6 +94,40 @@ int l_lovrRandomGeneratorRandomNormal(lua_State* L) {
   return 1;
 }
 
+// Fills a Blob with floats.  Uniform numbers are between a and b (0 and 1 by default), normal
+// numbers use a as the standard deviation and b as the mean, like randomNormal.
+static int l_lovrRandomGeneratorFill(lua_State* L) {
+  RandomGenerator* generator = luax_checktype(L, 1, RandomGenerator);
+  Blob* blob = luax_checktype(L, 2, Blob);
+  lua_Integer offset = luaL_optinteger(L, 7, 0);
+  lovrAssert(offset >= 0 && (size_t) offset <= blob->size, "Blob offset is out of range");
+  lovrAssert(offset % 4 == 0, "Blob offset must be a multiple of 4");
+  lua_Integer count = luaL_optinteger(L, 3, (blob->size - offset) / sizeof(float));
+  lovrAssert(count >= 0 && (size_t) offset + count * sizeof(float) <= blob->size, "Tried to write %d floats at offset %d, but the Blob only has %d bytes", (int) count, (int) offset, (int) blob->size);
+  lovrAssert(count <= UINT32_MAX, "Too many random numbers");
+  RandomDistribution distribution = luax_checkenum(L, 4, RandomDistribution, "uniform");
+  float a = luax_optfloat(L, 5, distribution == DISTRIBUTION_UNIFORM ? 0.f : 1.f);
+  float b = luax_optfloat(L, 6, distribution == DISTRIBUTION_UNIFORM ? 1.f : 0.f);
+  Blob* root = blob;
+  while (root->parent) root = root->parent;
+  lovrAssert(!root->mapped, "Blob is mapped from a file and can not be modified");
+#ifndef LOVR_DISABLE_THREAD
+  if (count >= 65536) {
+    luax_startpool(L);
+  }
+#endif
+  lovrRandomGeneratorFill(generator, (float*) ((char*) blob->data + offset), (uint32_t) count, distribution, a, b);
+  return 0;
+}
+
+static int l_lovrRandomGeneratorJump(lua_State* L) {
+  RandomGenerator* generator = luax_checktype(L, 1, RandomGenerator);
+  double steps = luaL_checknumber(L, 2);
+  lovrAssert(steps >= 0. && steps < 18446744073709551616., "Jump distance must be between 0 and 2^64");
+  lovrRandomGeneratorJump(generator, (uint64_t) steps);
+  return 0;
+}
+
 const luaL_Reg lovrRandomGenerator[] = {
   { "getSeed", l_lovrRandomGeneratorGetSeed },
   { "setSeed", l_lovrRandomGeneratorSetSeed },
@@ -94,5 +135,7 @@ const luaL_Reg lovrRandomGenerator[] = {
   { "setState", l_lovrRandomGeneratorSetState },
   { "random", l_lovrRandomGeneratorRandom },
   { "randomNormal", l_lovrRandomGeneratorRandomNormal },
+  { "fill", l_lovrRandomGeneratorFill },
+  { "jump", l_lovrRandomGeneratorJump },
   { NULL, NULL }
 };
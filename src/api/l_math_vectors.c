@@ -43,6 +43,18 @@ static const uint32_t* swizzles[5] = {
 
 // Helpers
 
+// Permanent vectors are full userdata laid out as a 32 bit VectorType followed by the components
+// (4 floats for vec3), and never move, so their component pointer can be used with LuaJIT's FFI.
+// Temporary vectors live in the Pool, which can move when it grows, so they don't have pointers.
+static int l_lovrVectorGetPointer(lua_State* L) {
+  VectorType type;
+  float* p = luax_tovector(L, 1, &type);
+  if (!p) return luax_typeerror(L, 1, "vector");
+  lovrAssert(lua_type(L, 1) == LUA_TUSERDATA, "Temporary vectors do not have stable pointers, use a permanent vector");
+  lua_pushlightuserdata(L, p);
+  return 1;
+}
+
 int luax_readvec3(lua_State* L, int index, vec3 v, const char* expected) {
   switch (lua_type(L, index)) {
     case LUA_TNIL:
@@ -296,6 +308,23 @@ static int l_lovrVec2Lerp(lua_State* L) {
   return 1;
 }
 
+// Adds u scaled by a number or another vec2 without creating an intermediate vector
+static int l_lovrVec2MulAdd(lua_State* L) {
+  float* v = luax_checkvector(L, 1, V_VEC2, NULL);
+  float* u = luax_checkvector(L, 2, V_VEC2, NULL);
+  if (lua_type(L, 3) == LUA_TNUMBER) {
+    float s = lua_tonumber(L, 3);
+    v[0] += u[0] * s;
+    v[1] += u[1] * s;
+  } else {
+    float* w = luax_checkvector(L, 3, V_VEC2, "vec2 or number");
+    v[0] += u[0] * w[0];
+    v[1] += u[1] * w[1];
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
 static int l_lovrVec2__add(lua_State* L) {
   float* out = luax_newtempvector(L, V_VEC2);
   if (lua_type(L, 1) == LUA_TNUMBER) {
@@ -497,6 +526,8 @@ const luaL_Reg lovrVec2[] = {
   { "distance", l_lovrVec2Distance },
   { "dot", l_lovrVec2Dot },
   { "lerp", l_lovrVec2Lerp },
+  { "mulAdd", l_lovrVec2MulAdd },
+  { "getPointer", l_lovrVectorGetPointer },
   { "__add", l_lovrVec2__add },
   { "__sub", l_lovrVec2__sub },
   { "__mul", l_lovrVec2__mul },
@@ -687,6 +718,41 @@ static int l_lovrVec3Lerp(lua_State* L) {
   return 1;
 }
 
+// Adds u scaled by a number or another vec3 without creating an intermediate vector
+static int l_lovrVec3MulAdd(lua_State* L) {
+  float* v = luax_checkvector(L, 1, V_VEC3, NULL);
+  float* u = luax_checkvector(L, 2, V_VEC3, NULL);
+  if (lua_type(L, 3) == LUA_TNUMBER) {
+    float s = lua_tonumber(L, 3);
+    v[0] += u[0] * s;
+    v[1] += u[1] * s;
+    v[2] += u[2] * s;
+  } else {
+    float* w = luax_checkvector(L, 3, V_VEC3, "vec3 or number");
+    v[0] += u[0] * w[0];
+    v[1] += u[1] * w[1];
+    v[2] += u[2] * w[2];
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int l_lovrVec3Rotate(lua_State* L) {
+  vec3 v = luax_checkvector(L, 1, V_VEC3, NULL);
+  quat q = luax_checkvector(L, 2, V_QUAT, NULL);
+  quat_rotate(q, v);
+  lua_settop(L, 1);
+  return 1;
+}
+
+static int l_lovrVec3Transform(lua_State* L) {
+  vec3 v = luax_checkvector(L, 1, V_VEC3, NULL);
+  mat4 m = luax_checkvector(L, 2, V_MAT4, NULL);
+  mat4_transform(m, v);
+  lua_settop(L, 1);
+  return 1;
+}
+
 static int l_lovrVec3__add(lua_State* L) {
   vec3 out = luax_newtempvector(L, V_VEC3);
   if (lua_type(L, 1) == LUA_TNUMBER) {
@@ -891,6 +957,10 @@ const luaL_Reg lovrVec3[] = {
   { "dot", l_lovrVec3Dot },
   { "cross", l_lovrVec3Cross },
   { "lerp", l_lovrVec3Lerp },
+  { "mulAdd", l_lovrVec3MulAdd },
+  { "rotate", l_lovrVec3Rotate },
+  { "transform", l_lovrVec3Transform },
+  { "getPointer", l_lovrVectorGetPointer },
   { "__add", l_lovrVec3__add },
   { "__sub", l_lovrVec3__sub },
   { "__mul", l_lovrVec3__mul },
@@ -1090,6 +1160,27 @@ static int l_lovrVec4Lerp(lua_State* L) {
   return 1;
 }
 
+// Adds u scaled by a number or another vec4 without creating an intermediate vector
+static int l_lovrVec4MulAdd(lua_State* L) {
+  float* v = luax_checkvector(L, 1, V_VEC4, NULL);
+  float* u = luax_checkvector(L, 2, V_VEC4, NULL);
+  if (lua_type(L, 3) == LUA_TNUMBER) {
+    float s = lua_tonumber(L, 3);
+    v[0] += u[0] * s;
+    v[1] += u[1] * s;
+    v[2] += u[2] * s;
+    v[3] += u[3] * s;
+  } else {
+    float* w = luax_checkvector(L, 3, V_VEC4, "vec4 or number");
+    v[0] += u[0] * w[0];
+    v[1] += u[1] * w[1];
+    v[2] += u[2] * w[2];
+    v[3] += u[3] * w[3];
+  }
+  lua_settop(L, 1);
+  return 1;
+}
+
 static int l_lovrVec4__add(lua_State* L) {
   float* out = luax_newtempvector(L, V_VEC4);
   if (lua_type(L, 1) == LUA_TNUMBER) {
@@ -1329,6 +1420,8 @@ const luaL_Reg lovrVec4[] = {
   { "distance", l_lovrVec4Distance },
   { "dot", l_lovrVec4Dot },
   { "lerp", l_lovrVec4Lerp },
+  { "mulAdd", l_lovrVec4MulAdd },
+  { "getPointer", l_lovrVectorGetPointer },
   { "__add", l_lovrVec4__add },
   { "__sub", l_lovrVec4__sub },
   { "__mul", l_lovrVec4__mul },
@@ -1548,6 +1641,7 @@ const luaL_Reg lovrQuat[] = {
   { "direction", l_lovrQuatDirection },
   { "conjugate", l_lovrQuatConjugate },
   { "slerp", l_lovrQuatSlerp },
+  { "getPointer", l_lovrVectorGetPointer },
   { "__mul", l_lovrQuat__mul },
   { "__len", l_lovrQuat__len },
   { "__tostring", l_lovrQuat__tostring },
@@ -1872,6 +1966,7 @@ const luaL_Reg lovrMat4[] = {
   { "fov", l_lovrMat4Fov },
   { "lookAt", l_lovrMat4LookAt },
   { "target", l_lovrMat4Target },
+  { "getPointer", l_lovrVectorGetPointer },
   { "__mul", l_lovrMat4__mul },
   { "__tostring", l_lovrMat4__tostring },
   { "__newindex", l_lovrMat4__newindex },
@@ -3,6 +3,13 @@
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdlib.h>
+
+StringEntry lovrPoseFormat[] = {
+  [POSE_MATRIX] = ENTRY("matrix"),
+  [POSE_VECTORS] = ENTRY("vectors"),
+  { 0 }
+};
 
 StringEntry lovrShapeType[] = {
   [SHAPE_SPHERE] = ENTRY("sphere"),
@@ -10,6 +17,29 @@ StringEntry lovrShapeType[] = {
   [SHAPE_CAPSULE] = ENTRY("capsule"),
   [SHAPE_CYLINDER] = ENTRY("cylinder"),
   [SHAPE_MESH] = ENTRY("mesh"),
+  [SHAPE_TERRAIN] = ENTRY("terrain"),
+  [SHAPE_CONVEX] = ENTRY("convex"),
+  { 0 }
+};
+
+StringEntry lovrBroadphase[] = {
+  [BROADPHASE_HASH] = ENTRY("hash"),
+  [BROADPHASE_SAP] = ENTRY("sap"),
+  [BROADPHASE_QUADTREE] = ENTRY("quadtree"),
+  { 0 }
+};
+
+StringEntry lovrCastType[] = {
+  [CAST_RAY] = ENTRY("ray"),
+  [CAST_SPHERE] = ENTRY("sphere"),
+  [CAST_BOX] = ENTRY("box"),
+  { 0 }
+};
+
+StringEntry lovrContactState[] = {
+  [CONTACT_BEGIN] = ENTRY("begin"),
+  [CONTACT_PERSIST] = ENTRY("persist"),
+  [CONTACT_END] = ENTRY("end"),
   { 0 }
 };
 
@@ -21,6 +51,21 @@ StringEntry lovrJointType[] = {
   { 0 }
 };
 
+// Reads a field of an options table that's either a vec3 or a table of 3 numbers
+static void luax_optfieldvec3(lua_State* L, int index, const char* key, float* v) {
+  lua_getfield(L, index, key);
+  if (lua_istable(L, -1)) {
+    for (int i = 0; i < 3; i++) {
+      lua_rawgeti(L, -1, i + 1);
+      v[i] = luax_checkfloat(L, -1);
+      lua_pop(L, 1);
+    }
+  } else if (!lua_isnil(L, -1)) {
+    luax_readvec3(L, -1, v, "vec3 or table");
+  }
+  lua_pop(L, 1);
+}
+
 static int l_lovrPhysicsNewWorld(lua_State* L) {
   float xg = luax_optfloat(L, 1, 0.f);
   float yg = luax_optfloat(L, 2, -9.81f);
@@ -42,7 +87,27 @@ static int l_lovrPhysicsNewWorld(lua_State* L) {
   } else {
     tagCount = 0;
   }
-  World* world = lovrWorldCreate(xg, yg, zg, allowSleep, tags, tagCount);
+
+  BroadphaseInfo broadphase = { .type = BROADPHASE_HASH, .extent = { 100.f, 100.f, 100.f }, .depth = 6 };
+  uint32_t threads = 0;
+  if (lua_istable(L, 6)) {
+    lua_getfield(L, 6, "broadphase");
+    broadphase.type = luax_checkenum(L, -1, Broadphase, "hash");
+    lua_pop(L, 1);
+
+    luax_optfieldvec3(L, 6, "center", broadphase.center);
+    luax_optfieldvec3(L, 6, "extent", broadphase.extent);
+
+    lua_getfield(L, 6, "depth");
+    broadphase.depth = luaL_optinteger(L, -1, broadphase.depth);
+    lua_pop(L, 1);
+
+    lua_getfield(L, 6, "threads");
+    threads = MAX(luaL_optinteger(L, -1, 0), 0);
+    lua_pop(L, 1);
+  }
+
+  World* world = lovrWorldCreate(xg, yg, zg, allowSleep, tags, tagCount, &broadphase, threads);
   luax_pushtype(L, World, world);
   lovrRelease(world, lovrWorldDestroy);
   return 1;
@@ -77,6 +142,30 @@ static int l_lovrPhysicsNewCapsuleShape(lua_State* L) {
   return 1;
 }
 
+static int l_lovrPhysicsNewConvexShape(lua_State* L) {
+  float* vertices;
+  uint32_t* indices;
+  uint32_t vertexCount, indexCount;
+  bool shouldFree;
+  luax_readpoints(L, 1, &vertices, &vertexCount, &indices, &indexCount, &shouldFree);
+  ConvexShape* convex = lovrConvexShapeCreate(vertices, vertexCount);
+  if (shouldFree) {
+    free(vertices);
+    free(indices);
+  }
+  lovrAssert(convex, "Could not compute convex hull: the points need to enclose a volume");
+  luax_pushtype(L, ConvexShape, convex);
+  lovrRelease(convex, lovrShapeDestroy);
+  return 1;
+}
+
+static int l_lovrPhysicsNewCollisionMesh(lua_State* L) {
+  CollisionMesh* mesh = luax_newcollisionmesh(L, 1);
+  luax_pushtype(L, CollisionMesh, mesh);
+  lovrRelease(mesh, lovrCollisionMeshDestroy);
+  return 1;
+}
+
 static int l_lovrPhysicsNewCylinderShape(lua_State* L) {
   float radius = luax_optfloat(L, 1, 1.f);
   float length = luax_optfloat(L, 2, 1.f);
@@ -111,6 +200,15 @@ static int l_lovrPhysicsNewHingeJoint(lua_State* L) {
   return 1;
 }
 
+static int l_lovrPhysicsNewMeshShape(lua_State* L) {
+  CollisionMesh* mesh = luax_newcollisionmesh(L, 1);
+  MeshShape* shape = lovrMeshShapeCreate(mesh);
+  luax_pushtype(L, MeshShape, shape);
+  lovrRelease(mesh, lovrCollisionMeshDestroy);
+  lovrRelease(shape, lovrShapeDestroy);
+  return 1;
+}
+
 static int l_lovrPhysicsNewSliderJoint(lua_State* L) {
   Collider* a = luax_checktype(L, 1, Collider);
   Collider* b = luax_checktype(L, 2, Collider);
@@ -130,16 +228,27 @@ static int l_lovrPhysicsNewSphereShape(lua_State* L) {
   return 1;
 }
 
+static int l_lovrPhysicsNewTerrainShape(lua_State* L) {
+  TerrainShape* terrain = luax_newterrainshape(L, 1);
+  luax_pushtype(L, TerrainShape, terrain);
+  lovrRelease(terrain, lovrShapeDestroy);
+  return 1;
+}
+
 static const luaL_Reg lovrPhysics[] = {
   { "newWorld", l_lovrPhysicsNewWorld },
   { "newBallJoint", l_lovrPhysicsNewBallJoint },
   { "newBoxShape", l_lovrPhysicsNewBoxShape },
   { "newCapsuleShape", l_lovrPhysicsNewCapsuleShape },
+  { "newCollisionMesh", l_lovrPhysicsNewCollisionMesh },
+  { "newConvexShape", l_lovrPhysicsNewConvexShape },
   { "newCylinderShape", l_lovrPhysicsNewCylinderShape },
   { "newDistanceJoint", l_lovrPhysicsNewDistanceJoint },
   { "newHingeJoint", l_lovrPhysicsNewHingeJoint },
+  { "newMeshShape", l_lovrPhysicsNewMeshShape },
   { "newSliderJoint", l_lovrPhysicsNewSliderJoint },
   { "newSphereShape", l_lovrPhysicsNewSphereShape },
+  { "newTerrainShape", l_lovrPhysicsNewTerrainShape },
   { NULL, NULL }
 };
 
@@ -154,6 +263,9 @@ extern const luaL_Reg lovrBoxShape[];
 extern const luaL_Reg lovrCapsuleShape[];
 extern const luaL_Reg lovrCylinderShape[];
 extern const luaL_Reg lovrMeshShape[];
+extern const luaL_Reg lovrTerrainShape[];
+extern const luaL_Reg lovrConvexShape[];
+extern const luaL_Reg lovrCollisionMesh[];
 
 int luaopen_lovr_physics(lua_State* L) {
   lua_newtable(L);
@@ -169,6 +281,9 @@ int luaopen_lovr_physics(lua_State* L) {
   luax_registertype(L, CapsuleShape);
   luax_registertype(L, CylinderShape);
   luax_registertype(L, MeshShape);
+  luax_registertype(L, TerrainShape);
+  luax_registertype(L, ConvexShape);
+  luax_registertype(L, CollisionMesh);
   if (lovrPhysicsInit()) {
     luax_atexit(L, lovrPhysicsDestroy);
   }
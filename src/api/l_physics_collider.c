@@ -246,6 +246,21 @@ static int l_lovrColliderGetPose(lua_State* L) {
   return 7;
 }
 
+static int l_lovrColliderGetInterpolatedPose(lua_State* L) {
+  Collider* collider = luax_checktype(L, 1, Collider);
+  float position[3], orientation[4], angle, ax, ay, az;
+  lovrColliderGetInterpolatedPose(collider, position, orientation);
+  quat_getAngleAxis(orientation, &angle, &ax, &ay, &az);
+  lua_pushnumber(L, position[0]);
+  lua_pushnumber(L, position[1]);
+  lua_pushnumber(L, position[2]);
+  lua_pushnumber(L, angle);
+  lua_pushnumber(L, ax);
+  lua_pushnumber(L, ay);
+  lua_pushnumber(L, az);
+  return 7;
+}
+
 static int l_lovrColliderSetPose(lua_State* L) {
   Collider* collider = luax_checktype(L, 1, Collider);
   float position[4], orientation[4];
@@ -517,6 +532,7 @@ const luaL_Reg lovrCollider[] = {
   { "setOrientation", l_lovrColliderSetOrientation },
   { "getPose", l_lovrColliderGetPose },
   { "setPose", l_lovrColliderSetPose },
+  { "getInterpolatedPose", l_lovrColliderGetInterpolatedPose },
   { "getLinearVelocity", l_lovrColliderGetLinearVelocity },
   { "setLinearVelocity", l_lovrColliderSetLinearVelocity },
   { "getAngularVelocity", l_lovrColliderGetAngularVelocity },
@@ -0,0 +1,61 @@
+#include "api.h"
+#include "physics/physics.h"
+#include "data/blob.h"
+#include "core/util.h"
+#include <lua.h>
+#include <lauxlib.h>
+
+// Reads a CollisionMesh (retaining it), an encoded CollisionMesh Blob, or anything luax_readmesh
+// takes.  The caller releases the result.
+CollisionMesh* luax_newcollisionmesh(lua_State* L, int index) {
+  CollisionMesh* mesh = luax_totype(L, index, CollisionMesh);
+  if (mesh) {
+    lovrRetain(mesh);
+    return mesh;
+  }
+
+  Blob* blob = luax_totype(L, index, Blob);
+  if (blob) {
+    return lovrCollisionMeshCreateFromData(blob->data, blob->size);
+  }
+
+  float* vertices;
+  uint32_t* indices;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  bool shouldFree;
+  luax_readmesh(L, index, &vertices, &vertexCount, &indices, &indexCount, &shouldFree);
+
+  // Triangles from Models belong to the Model, so they're copied.  Tables are read into new arrays,
+  // which the CollisionMesh takes over.
+  return lovrCollisionMeshCreate(vertices, vertexCount, indices, indexCount, !shouldFree);
+}
+
+static int l_lovrCollisionMeshGetVertexCount(lua_State* L) {
+  CollisionMesh* mesh = luax_checktype(L, 1, CollisionMesh);
+  lua_pushinteger(L, mesh->vertexCount);
+  return 1;
+}
+
+static int l_lovrCollisionMeshGetTriangleCount(lua_State* L) {
+  CollisionMesh* mesh = luax_checktype(L, 1, CollisionMesh);
+  lua_pushinteger(L, mesh->indexCount / 3);
+  return 1;
+}
+
+static int l_lovrCollisionMeshEncode(lua_State* L) {
+  CollisionMesh* mesh = luax_checktype(L, 1, CollisionMesh);
+  size_t size;
+  void* data = lovrCollisionMeshEncode(mesh, &size);
+  Blob* blob = lovrBlobCreate(data, size, "CollisionMesh");
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  return 1;
+}
+
+const luaL_Reg lovrCollisionMesh[] = {
+  { "getVertexCount", l_lovrCollisionMeshGetVertexCount },
+  { "getTriangleCount", l_lovrCollisionMeshGetTriangleCount },
+  { "encode", l_lovrCollisionMeshEncode },
+  { NULL, NULL }
+};
@@ -19,10 +19,10 @@ Joint* luax_checkjoint(lua_State* L, int index) {
 
   if (p) {
     const uint64_t hashes[] = {
-      hash64("BallJoint", strlen("BallJoint")),
-      hash64("DistanceJoint", strlen("DistanceJoint")),
-      hash64("HingeJoint", strlen("HingeJoint")),
-      hash64("SliderJoint", strlen("SliderJoint"))
+      luax_typehash(BallJoint),
+      luax_typehash(DistanceJoint),
+      luax_typehash(HingeJoint),
+      luax_typehash(SliderJoint)
     };
 
     for (size_t i = 0; i < sizeof(hashes) / sizeof(hashes[0]); i++) {
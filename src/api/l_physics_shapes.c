@@ -1,8 +1,11 @@
 #include "api.h"
 #include "physics/physics.h"
+#include "data/blob.h"
+#include "data/image.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdlib.h>
 
 void luax_pushshape(lua_State* L, Shape* shape) {
   switch (shape->type) {
@@ -11,6 +14,8 @@ void luax_pushshape(lua_State* L, Shape* shape) {
     case SHAPE_CAPSULE: luax_pushtype(L, CapsuleShape, shape); break;
     case SHAPE_CYLINDER: luax_pushtype(L, CylinderShape, shape); break;
     case SHAPE_MESH: luax_pushtype(L, MeshShape, shape); break;
+    case SHAPE_TERRAIN: luax_pushtype(L, TerrainShape, shape); break;
+    case SHAPE_CONVEX: luax_pushtype(L, ConvexShape, shape); break;
     default: lovrThrow("Unreachable");
   }
 }
@@ -20,11 +25,13 @@ Shape* luax_checkshape(lua_State* L, int index) {
 
   if (p) {
     const uint64_t hashes[] = {
-      hash64("SphereShape", strlen("SphereShape")),
-      hash64("BoxShape", strlen("BoxShape")),
-      hash64("CapsuleShape", strlen("CapsuleShape")),
-      hash64("CylinderShape", strlen("CylinderShape")),
-      hash64("MeshShape", strlen("MeshShape")),
+      luax_typehash(SphereShape),
+      luax_typehash(BoxShape),
+      luax_typehash(CapsuleShape),
+      luax_typehash(CylinderShape),
+      luax_typehash(MeshShape),
+      luax_typehash(TerrainShape),
+      luax_typehash(ConvexShape),
     };
 
     for (size_t i = 0; i < sizeof(hashes) / sizeof(hashes[0]); i++) {
@@ -306,7 +313,156 @@ const luaL_Reg lovrCylinderShape[] = {
   { NULL, NULL }
 };
 
+static int l_lovrMeshShapeGetCollisionMesh(lua_State* L) {
+  MeshShape* mesh = luax_checktype(L, 1, MeshShape);
+  CollisionMesh* collisionMesh = lovrMeshShapeGetCollisionMesh(mesh);
+  luax_pushtype(L, CollisionMesh, collisionMesh);
+  return 1;
+}
+
 const luaL_Reg lovrMeshShape[] = {
   lovrShape,
+  { "getCollisionMesh", l_lovrMeshShapeGetCollisionMesh },
+  { NULL, NULL }
+};
+
+// Reads source, width, depth, scale, offset, and the sample counts when the source is a Blob of
+// floats.  Images use their red channel, with rows in memory order (Images are stored bottom up).
+TerrainShape* luax_newterrainshape(lua_State* L, int index) {
+  TerrainInfo info = { 0 };
+  Image* image = luax_totype(L, index, Image);
+  if (image) {
+    lovrAssert(image->blob && image->blob->data, "Image does not have any pixel data");
+    switch (image->format) {
+      case FORMAT_RGB: info.format = HEIGHT_U8; info.stride = 3; break;
+      case FORMAT_RGBA: info.format = HEIGHT_U8; info.stride = 4; break;
+      case FORMAT_R16: info.format = HEIGHT_U16; info.stride = 2; break;
+      case FORMAT_R32F: info.format = HEIGHT_F32; info.stride = 4; break;
+      default: lovrThrow("Terrain Images must be rgb, rgba, r16, or r32f");
+    }
+    info.data = image->blob->data;
+    info.samplesX = image->width;
+    info.samplesZ = image->height;
+    info.source = image;
+    info.destructor = lovrImageDestroy;
+  } else {
+    Blob* blob = luax_checktype(L, index, Blob);
+    info.format = HEIGHT_F32;
+    info.stride = sizeof(float);
+    info.samplesX = luaL_checkinteger(L, index + 5);
+    info.samplesZ = luaL_checkinteger(L, index + 6);
+    lovrAssert((uint64_t) info.samplesX * info.samplesZ * sizeof(float) <= blob->size, "Blob is too small for %d x %d heights", info.samplesX, info.samplesZ);
+    info.data = blob->data;
+    info.source = blob;
+    info.destructor = lovrBlobDestroy;
+  }
+
+  info.width = luax_optfloat(L, index + 1, (float) info.samplesX);
+  info.depth = luax_optfloat(L, index + 2, (float) info.samplesZ);
+  info.scale = luax_optfloat(L, index + 3, 1.f);
+  info.offset = luax_optfloat(L, index + 4, 0.f);
+  return lovrTerrainShapeCreate(&info);
+}
+
+static int l_lovrTerrainShapeGetSampleCount(lua_State* L) {
+  TerrainShape* terrain = luax_checktype(L, 1, TerrainShape);
+  uint32_t x, z;
+  lovrTerrainShapeGetSampleCount(terrain, &x, &z);
+  lua_pushinteger(L, x);
+  lua_pushinteger(L, z);
+  return 2;
+}
+
+static int l_lovrTerrainShapeGetSize(lua_State* L) {
+  TerrainShape* terrain = luax_checktype(L, 1, TerrainShape);
+  float width, depth;
+  lovrTerrainShapeGetSize(terrain, &width, &depth);
+  lua_pushnumber(L, width);
+  lua_pushnumber(L, depth);
+  return 2;
+}
+
+static int l_lovrTerrainShapeGetHeight(lua_State* L) {
+  TerrainShape* terrain = luax_checktype(L, 1, TerrainShape);
+  uint32_t x = luaL_checkinteger(L, 2) - 1;
+  uint32_t z = luaL_checkinteger(L, 3) - 1;
+  lua_pushnumber(L, lovrTerrainShapeGetHeight(terrain, x, z));
+  return 1;
+}
+
+static int l_lovrTerrainShapeSetHeight(lua_State* L) {
+  TerrainShape* terrain = luax_checktype(L, 1, TerrainShape);
+  uint32_t x = luaL_checkinteger(L, 2) - 1;
+  uint32_t z = luaL_checkinteger(L, 3) - 1;
+  float height = luax_checkfloat(L, 4);
+  lovrTerrainShapeSetHeight(terrain, x, z, height);
+  return 0;
+}
+
+static int l_lovrTerrainShapeUpdate(lua_State* L) {
+  TerrainShape* terrain = luax_checktype(L, 1, TerrainShape);
+  lovrTerrainShapeUpdate(terrain);
+  return 0;
+}
+
+const luaL_Reg lovrTerrainShape[] = {
+  lovrShape,
+  { "getSampleCount", l_lovrTerrainShapeGetSampleCount },
+  { "getSize", l_lovrTerrainShapeGetSize },
+  { "getHeight", l_lovrTerrainShapeGetHeight },
+  { "setHeight", l_lovrTerrainShapeSetHeight },
+  { "update", l_lovrTerrainShapeUpdate },
+  { NULL, NULL }
+};
+
+// Reads a point cloud (a flat or nested table of vertices) or anything luax_readmesh takes.  Point
+// clouds don't have indices.
+int luax_readpoints(lua_State* L, int index, float** vertices, uint32_t* vertexCount, uint32_t** indices, uint32_t* indexCount, bool* shouldFree) {
+  if (!lua_istable(L, index) || lua_istable(L, index + 1)) {
+    return luax_readmesh(L, index, vertices, vertexCount, indices, indexCount, shouldFree);
+  }
+
+  lua_rawgeti(L, index, 1);
+  bool nested = lua_type(L, -1) == LUA_TTABLE;
+  lua_pop(L, 1);
+
+  *vertexCount = luax_len(L, index) / (nested ? 1 : 3);
+  *vertices = malloc(3 * *vertexCount * sizeof(float));
+  lovrAssert(*vertices, "Out of memory");
+  *indices = NULL;
+  *indexCount = 0;
+  *shouldFree = true;
+
+  for (uint32_t i = 0; i < *vertexCount; i++) {
+    if (nested) {
+      lua_rawgeti(L, index, i + 1);
+      for (int c = 0; c < 3; c++) {
+        lua_rawgeti(L, -1 - c, c + 1);
+      }
+      (*vertices)[3 * i + 0] = luax_checkfloat(L, -3);
+      (*vertices)[3 * i + 1] = luax_checkfloat(L, -2);
+      (*vertices)[3 * i + 2] = luax_checkfloat(L, -1);
+      lua_pop(L, 4);
+    } else {
+      for (int c = 0; c < 3; c++) {
+        lua_rawgeti(L, index, 3 * i + c + 1);
+        (*vertices)[3 * i + c] = luax_checkfloat(L, -1);
+        lua_pop(L, 1);
+      }
+    }
+  }
+
+  return index + 1;
+}
+
+static int l_lovrConvexShapeGetFaceCount(lua_State* L) {
+  ConvexShape* convex = luax_checktype(L, 1, ConvexShape);
+  lua_pushinteger(L, lovrConvexShapeGetFaceCount(convex));
+  return 1;
+}
+
+const luaL_Reg lovrConvexShape[] = {
+  lovrShape,
+  { "getFaceCount", l_lovrConvexShapeGetFaceCount },
   { NULL, NULL }
 };
@@ -1,9 +1,13 @@
 #include "api.h"
 #include "physics/physics.h"
+#include "physics/hull.h"
+#include "data/blob.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 static void collisionResolver(World* world, void* userdata) {
   lua_State* L = userdata;
@@ -40,6 +44,35 @@ static void raycastCallback(Shape* shape, float x, float y, float z, float nx, f
   lua_call(L, 7, 0);
 }
 
+// Results that are read in one call go into a flat array, reusing the table at the index if there is one
+static int luax_startarray(lua_State* L, int index, size_t capacity) {
+  if (lua_istable(L, index)) {
+    lua_settop(L, index);
+  } else {
+    lua_settop(L, index - 1);
+    lua_createtable(L, (int) capacity, 0);
+  }
+  return luax_len(L, index);
+}
+
+static void luax_endarray(lua_State* L, int index, int length, int previousLength) {
+  for (int i = length + 1; i <= previousLength; i++) {
+    lua_pushnil(L);
+    lua_rawseti(L, index, i);
+  }
+}
+
+static int pushShapePairs(lua_State* L, Shape** shapes, size_t count) {
+  int previous = luax_startarray(L, 2, 2 * count);
+  for (size_t i = 0; i < 2 * count; i++) {
+    luax_pushshape(L, shapes[i]);
+    lua_rawseti(L, 2, (int) i + 1);
+  }
+  luax_endarray(L, 2, (int) (2 * count), previous);
+  lua_pushinteger(L, (lua_Integer) count);
+  return 2;
+}
+
 static int l_lovrWorldNewCollider(lua_State* L) {
   World* world = luax_checktype(L, 1, World);
   float position[4];
@@ -114,35 +147,118 @@ static int l_lovrWorldNewSphereCollider(lua_State* L) {
 
 static int l_lovrWorldNewMeshCollider(lua_State* L) {
   World* world = luax_checktype(L, 1, World);
+  CollisionMesh* mesh = luax_newcollisionmesh(L, 2);
+  Collider* collider = lovrColliderCreate(world, 0, 0, 0);
+  MeshShape* shape = lovrMeshShapeCreate(mesh);
+  lovrRelease(mesh, lovrCollisionMeshDestroy);
+  lovrColliderAddShape(collider, shape);
+  lovrColliderInitInertia(collider, shape);
+  luax_pushtype(L, Collider, collider);
+  lovrRelease(collider, lovrColliderDestroy);
+  lovrRelease(shape, lovrShapeDestroy);
+  return 1;
+}
+
+// Terrain Colliders are kinematic, at the origin
+static int l_lovrWorldNewTerrainCollider(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  TerrainShape* shape = luax_newterrainshape(L, 2);
+  Collider* collider = lovrColliderCreate(world, 0, 0, 0);
+  lovrColliderSetKinematic(collider, true);
+  lovrColliderAddShape(collider, shape);
+  luax_pushtype(L, Collider, collider);
+  lovrRelease(collider, lovrColliderDestroy);
+  lovrRelease(shape, lovrShapeDestroy);
+  return 1;
+}
+
+// With decompose, each connected piece of the mesh gets its own hull, which works well for models
+// made out of several convex parts.  The mass of the pieces is added up.
+static int l_lovrWorldNewConvexCollider(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
 
   float* vertices;
   uint32_t* indices;
   uint32_t vertexCount;
   uint32_t indexCount;
   bool shouldFree;
-  luax_readmesh(L, 2, &vertices, &vertexCount, &indices, &indexCount, &shouldFree);
-
-  // If we do not own the mesh data, we must make a copy
-  // ode's trimesh collider needs to own the triangle info for the lifetime of the geom
-  // Note that if shouldFree is true, we don't free the data and let the physics module do it when
-  // the collider/shape is destroyed
-  if (!shouldFree) {
-    float* v = vertices;
-    uint32_t* i = indices;
-    vertices = malloc(3 * vertexCount * sizeof(float));
-    indices = malloc(indexCount * sizeof(uint32_t));
-    lovrAssert(vertices && indices, "Out of memory");
-    memcpy(vertices, v, 3 * vertexCount * sizeof(float));
-    memcpy(indices, i, indexCount * sizeof(uint32_t));
-  }
+  int index = luax_readpoints(L, 2, &vertices, &vertexCount, &indices, &indexCount, &shouldFree);
+  bool decompose = lua_toboolean(L, index);
+  lovrAssert(!decompose || indices, "Decomposing a convex collider requires a mesh with indices");
 
   Collider* collider = lovrColliderCreate(world, 0, 0, 0);
-  MeshShape* shape = lovrMeshShapeCreate(vertexCount, vertices, indexCount, indices);
-  lovrColliderAddShape(collider, shape);
-  lovrColliderInitInertia(collider, shape);
+
+  if (decompose) {
+    uint32_t* components = malloc(vertexCount * sizeof(uint32_t));
+    float* points = malloc(3 * vertexCount * sizeof(float));
+    lovrAssert(components && points, "Out of memory");
+    uint32_t componentCount = lovrHullSplitComponents(indices, indexCount, vertexCount, components);
+
+    float total = 0.f, center[3] = { 0.f }, inertia[6] = { 0.f };
+    uint32_t shapeCount = 0;
+    for (uint32_t c = 0; c < componentCount; c++) {
+      uint32_t pointCount = 0;
+      for (uint32_t i = 0; i < vertexCount; i++) {
+        if (components[i] == c) {
+          memcpy(points + 3 * pointCount++, vertices + 3 * i, 3 * sizeof(float));
+        }
+      }
+
+      // Flat pieces (decals, single quads) can't be hulls, but they don't matter for collision
+      ConvexShape* shape = lovrConvexShapeCreate(points, pointCount);
+      if (!shape) {
+        continue;
+      }
+
+      float cx, cy, cz, mass, I[6];
+      lovrShapeGetMass(shape, 1.f, &cx, &cy, &cz, &mass, I);
+      center[0] += cx * mass;
+      center[1] += cy * mass;
+      center[2] += cz * mass;
+      for (int i = 0; i < 6; i++) inertia[i] += I[i];
+      total += mass;
+
+      lovrColliderAddShape(collider, shape);
+      lovrRelease(shape, lovrShapeDestroy);
+      shapeCount++;
+    }
+
+    free(components);
+    free(points);
+    if (shouldFree) {
+      free(vertices);
+      free(indices);
+    }
+
+    if (shapeCount == 0) {
+      lovrColliderDestroyData(collider);
+      lovrRelease(collider, lovrColliderDestroy);
+      lovrThrow("Could not compute convex hull: no part of the mesh encloses a volume");
+    }
+
+    if (total > 0.f) {
+      lovrColliderSetMassData(collider, center[0] / total, center[1] / total, center[2] / total, total, inertia);
+    }
+  } else {
+    ConvexShape* shape = lovrConvexShapeCreate(vertices, vertexCount);
+    if (shouldFree) {
+      free(vertices);
+      free(indices);
+    }
+
+    if (!shape) {
+      lovrColliderDestroyData(collider);
+      lovrRelease(collider, lovrColliderDestroy);
+      lovrThrow("Could not compute convex hull: the points need to enclose a volume");
+    }
+
+    lovrColliderAddShape(collider, shape);
+    lovrColliderInitInertia(collider, shape);
+    lovrRelease(shape, lovrShapeDestroy);
+  }
+
   luax_pushtype(L, Collider, collider);
   lovrRelease(collider, lovrColliderDestroy);
-  lovrRelease(shape, lovrShapeDestroy);
   return 1;
 }
 
@@ -155,13 +271,11 @@ static int l_lovrWorldGetColliders(lua_State* L) {
     lua_newtable(L);
   }
 
-  Collider* collider = lovrWorldGetFirstCollider(world);
-  int index = 1;
-
-  while (collider) {
-    luax_pushtype(L, Collider, collider);
-    lua_rawseti(L, -2, index++);
-    collider = collider->next;
+  size_t count;
+  Collider** colliders = lovrWorldGetColliders(world, &count);
+  for (size_t i = 0; i < count; i++) {
+    luax_pushtype(L, Collider, colliders[i]);
+    lua_rawseti(L, -2, (int) i + 1);
   }
 
   return 1;
@@ -182,6 +296,194 @@ static int l_lovrWorldUpdate(lua_State* L) {
   return 0;
 }
 
+static int l_lovrWorldGetStepSize(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  float stepSize;
+  uint32_t maxSteps;
+  lovrWorldGetStepSize(world, &stepSize, &maxSteps);
+  lua_pushnumber(L, stepSize);
+  lua_pushinteger(L, maxSteps);
+  return 2;
+}
+
+static int l_lovrWorldSetStepSize(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  float stepSize = luax_optfloat(L, 2, 0.f);
+  uint32_t maxSteps = luaL_optinteger(L, 3, 8);
+  lovrWorldSetStepSize(world, stepSize, maxSteps);
+  return 0;
+}
+
+static int l_lovrWorldGetInterpolation(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  lua_pushnumber(L, lovrWorldGetInterpolation(world));
+  return 1;
+}
+
+// Flat array of collider, x, y, z, angle, ax, ay, az for every Collider, between its last two steps
+static int l_lovrWorldGetInterpolatedPoses(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  int previous = luax_startarray(L, 2, 0);
+  int n = 0;
+  size_t count;
+  Collider** colliders = lovrWorldGetColliders(world, &count);
+  for (size_t c = 0; c < count; c++) {
+    Collider* collider = colliders[c];
+    float position[3], orientation[4], angle, ax, ay, az;
+    lovrColliderGetInterpolatedPose(collider, position, orientation);
+    quat_getAngleAxis(orientation, &angle, &ax, &ay, &az);
+    luax_pushtype(L, Collider, collider);
+    lua_rawseti(L, 2, ++n);
+    float values[7] = { position[0], position[1], position[2], angle, ax, ay, az };
+    for (int i = 0; i < 7; i++) {
+      lua_pushnumber(L, values[i]);
+      lua_rawseti(L, 2, ++n);
+    }
+  }
+  luax_endarray(L, 2, n, previous);
+  return 1;
+}
+
+// Writes poses of every Collider into a Blob, in getColliders order, so they can be sent to a
+// ShaderBlock for instancing
+static int l_lovrWorldGetPoses(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  Blob* blob = luax_checktype(L, 2, Blob);
+  size_t offset = luaL_optinteger(L, 3, 0);
+  PoseFormat format = luax_checkenum(L, 4, PoseFormat, "matrix");
+  size_t stride = (format == POSE_MATRIX ? 16 : 8) * sizeof(float);
+  lovrAssert(offset % sizeof(float) == 0, "Offset must be a multiple of 4");
+  lovrAssert(offset <= blob->size, "Offset %d is past the end of the Blob (size %d)", (int) offset, (int) blob->size);
+  uint32_t capacity = (uint32_t) ((blob->size - offset) / stride);
+  uint32_t count = lovrWorldGetPoses(world, format, (float*) ((char*) blob->data + offset), capacity);
+  lovrAssert(count <= capacity, "Blob is too small for %d poses", count);
+  lua_pushinteger(L, count);
+  return 1;
+}
+
+// Moves a list of kinematic Colliders to new poses over the next update.  Poses are a Blob laid
+// out like getPoses writes it, or a table of { x, y, z, angle, ax, ay, az } tables, which is what
+// lovr.headset.getSkeleton returns.  Colliders can be missing (false) to skip a pose.
+static int l_lovrWorldSetPoses(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  if (lua_istable(L, 3)) {
+    int count = luax_len(L, 3);
+    for (int i = 0; i < count; i++) {
+      lua_rawgeti(L, 2, i + 1);
+      Collider* collider = luax_totype(L, -1, Collider);
+      lua_pop(L, 1);
+      if (!collider) continue;
+      lovrAssert(collider->world == world, "Collider belongs to a different World");
+      lua_rawgeti(L, 3, i + 1);
+      lovrAssert(lua_istable(L, -1), "Expected pose %d to be a table", i + 1);
+      float pose[7];
+      for (int j = 0; j < 7; j++) {
+        lua_rawgeti(L, -1 - j, j + 1);
+        pose[j] = luax_optfloat(L, -1, 0.f);
+      }
+      lua_pop(L, 8);
+      float orientation[4];
+      quat_fromAngleAxis(orientation, pose[3], pose[4], pose[5], pose[6]);
+      lovrColliderSetTarget(collider, pose, orientation);
+    }
+    return 0;
+  }
+
+  Blob* blob = luax_checktype(L, 3, Blob);
+  size_t offset = luaL_optinteger(L, 4, 0);
+  PoseFormat format = luax_checkenum(L, 5, PoseFormat, "matrix");
+  size_t stride = (format == POSE_MATRIX ? 16 : 8) * sizeof(float);
+  lovrAssert(offset % sizeof(float) == 0, "Offset must be a multiple of 4");
+  lovrAssert(offset <= blob->size, "Offset %d is past the end of the Blob (size %d)", (int) offset, (int) blob->size);
+  uint32_t count = luax_len(L, 2);
+  lovrAssert(count <= (blob->size - offset) / stride, "Blob is too small for %d poses", count);
+  Collider** colliders = malloc(count * sizeof(Collider*));
+  lovrAssert(colliders || count == 0, "Out of memory");
+  for (uint32_t i = 0; i < count; i++) {
+    lua_rawgeti(L, 2, i + 1);
+    colliders[i] = luax_totype(L, -1, Collider);
+    lua_pop(L, 1);
+  }
+  lovrWorldSetPoses(world, colliders, count, format, (float*) ((char*) blob->data + offset));
+  free(colliders);
+  return 0;
+}
+
+// Writes a line list of every Shape, Joint, and contact into a Blob, as vertices with a position and
+// a color (7 floats).  It goes straight into Mesh:setVertices with a format like
+// { { 'lovrPosition', 'float', 3 }, { 'lovrVertexColor', 'float', 4 } }.  Without a Blob, one of
+// the right size is created.  Returns the Blob and the vertex count.
+static int l_lovrWorldGetDebugGeometry(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  Blob* blob = luax_totype(L, 2, Blob);
+  size_t stride = 7 * sizeof(float);
+
+  if (blob) {
+    size_t offset = luaL_optinteger(L, 3, 0);
+    lovrAssert(offset % sizeof(float) == 0, "Offset must be a multiple of 4");
+    lovrAssert(offset <= blob->size, "Offset %d is past the end of the Blob (size %d)", (int) offset, (int) blob->size);
+    uint32_t capacity = (uint32_t) ((blob->size - offset) / stride);
+    uint32_t count = lovrWorldGetDebugGeometry(world, (float*) ((char*) blob->data + offset), capacity);
+    lovrAssert(count <= capacity, "Blob is too small for %d debug vertices", count);
+    lua_settop(L, 2);
+    lua_pushinteger(L, count);
+    return 2;
+  }
+
+  uint32_t count = lovrWorldGetDebugGeometry(world, NULL, 0);
+  void* data = malloc(MAX(count, 1) * stride);
+  lovrAssert(data, "Out of memory");
+  lovrWorldGetDebugGeometry(world, data, count);
+  blob = lovrBlobCreate(data, count * stride, "World debug geometry");
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  lua_pushinteger(L, count);
+  return 2;
+}
+
+static int l_lovrWorldGetSnapshotSize(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  lua_pushinteger(L, lovrWorldSaveSnapshot(world, NULL, 0));
+  return 1;
+}
+
+// Writes into an existing Blob when given one, so rollback buffers can be allocated up front
+static int l_lovrWorldSaveSnapshot(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  Blob* blob = luax_totype(L, 2, Blob);
+
+  if (blob) {
+    size_t offset = luaL_optinteger(L, 3, 0);
+    lovrAssert(offset <= blob->size, "Offset %d is past the end of the Blob (size %d)", (int) offset, (int) blob->size);
+    size_t size = lovrWorldSaveSnapshot(world, (char*) blob->data + offset, blob->size - offset);
+    lovrAssert(size <= blob->size - offset, "Blob is too small for the snapshot (it needs %d bytes)", (int) size);
+    lua_settop(L, 2);
+    lua_pushinteger(L, size);
+    return 2;
+  }
+
+  size_t size = lovrWorldSaveSnapshot(world, NULL, 0);
+  void* data = malloc(size);
+  lovrAssert(data, "Out of memory");
+  lovrWorldSaveSnapshot(world, data, size);
+  blob = lovrBlobCreate(data, size, "World snapshot");
+  luax_pushtype(L, Blob, blob);
+  lovrRelease(blob, lovrBlobDestroy);
+  lua_pushinteger(L, size);
+  return 2;
+}
+
+static int l_lovrWorldLoadSnapshot(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  Blob* blob = luax_checktype(L, 2, Blob);
+  size_t offset = luaL_optinteger(L, 3, 0);
+  lovrAssert(offset <= blob->size, "Offset %d is past the end of the Blob (size %d)", (int) offset, (int) blob->size);
+  lovrWorldLoadSnapshot(world, (char*) blob->data + offset, blob->size - offset);
+  return 0;
+}
+
 static int l_lovrWorldComputeOverlaps(lua_State* L) {
   World* world = luax_checktype(L, 1, World);
   lovrWorldComputeOverlaps(world);
@@ -195,6 +497,55 @@ static int l_lovrWorldOverlaps(lua_State* L) {
   return 1;
 }
 
+static int l_lovrWorldGetOverlaps(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  size_t count;
+  Shape** shapes = lovrWorldGetOverlaps(world, &count);
+  return pushShapePairs(L, shapes, count);
+}
+
+// Flat array of shapeA, shapeB, state, x, y, z, nx, ny, nz, depth, impulse for each contact event
+// of the last update.  Pairs that stopped touching get an "end" event with their last contact.
+static int l_lovrWorldGetContacts(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  size_t count;
+  Contact* contacts = lovrWorldGetContacts(world, &count);
+  int previous = luax_startarray(L, 2, 11 * count);
+  int n = 0;
+  for (size_t i = 0; i < count; i++) {
+    Contact* contact = &contacts[i];
+    luax_pushshape(L, contact->a);
+    lua_rawseti(L, 2, ++n);
+    luax_pushshape(L, contact->b);
+    lua_rawseti(L, 2, ++n);
+    luax_pushenum(L, ContactState, contact->state);
+    lua_rawseti(L, 2, ++n);
+    for (int c = 0; c < 3; c++) {
+      lua_pushnumber(L, contact->position[c]);
+      lua_rawseti(L, 2, ++n);
+    }
+    for (int c = 0; c < 3; c++) {
+      lua_pushnumber(L, contact->normal[c]);
+      lua_rawseti(L, 2, ++n);
+    }
+    lua_pushnumber(L, contact->depth);
+    lua_rawseti(L, 2, ++n);
+    lua_pushnumber(L, contact->impulse);
+    lua_rawseti(L, 2, ++n);
+  }
+  luax_endarray(L, 2, n, previous);
+  lua_pushinteger(L, (lua_Integer) count);
+  return 2;
+}
+
+// Flat array of sensor, other pairs that touched during the last update
+static int l_lovrWorldGetTriggers(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  size_t count;
+  Shape** shapes = lovrWorldGetTriggers(world, &count);
+  return pushShapePairs(L, shapes, count);
+}
+
 static int l_lovrWorldCollide(lua_State* L) {
   World* world = luax_checktype(L, 1, World);
   Shape* a = luax_checkshape(L, 2);
@@ -312,6 +663,96 @@ static int l_lovrWorldRaycast(lua_State* L) {
   return 0;
 }
 
+// Casts a flat array of start and end points.  Results are a flat array of shape (or false), x, y,
+// z, nx, ny, nz, distance for each cast, followed by the number of hits.
+static int l_lovrWorldCast(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  int length = luax_len(L, 2);
+  lovrAssert(length % 6 == 0, "Casts must be a flat table with 6 numbers (start and end) per cast");
+  uint32_t count = length / 6;
+
+  const char* tags[MAX_TAGS];
+  CastInfo info = { .type = CAST_RAY, .size = { .5f, .5f, .5f }, .tags = tags };
+  if (lua_istable(L, 3)) {
+    lua_getfield(L, 3, "type");
+    info.type = luax_checkenum(L, -1, CastType, "ray");
+    lua_pop(L, 1);
+
+    if (info.type == CAST_SPHERE) {
+      lua_getfield(L, 3, "radius");
+      info.size[0] = luax_optfloat(L, -1, .5f);
+      lua_pop(L, 1);
+    } else if (info.type == CAST_BOX) {
+      lua_getfield(L, 3, "size");
+      if (lua_istable(L, -1)) {
+        for (int i = 0; i < 3; i++) {
+          lua_rawgeti(L, -1, i + 1);
+          info.size[i] = luax_checkfloat(L, -1);
+          lua_pop(L, 1);
+        }
+      } else {
+        info.size[0] = info.size[1] = info.size[2] = luax_optfloat(L, -1, 1.f);
+      }
+      lua_pop(L, 1);
+    }
+
+    lua_getfield(L, 3, "tags");
+    if (lua_istable(L, -1)) {
+      int tagCount = luax_len(L, -1);
+      lovrAssert(tagCount <= MAX_TAGS, "Too many tags");
+      for (int i = 0; i < tagCount; i++) {
+        lua_rawgeti(L, -1, i + 1);
+        lovrAssert(lua_type(L, -1) == LUA_TSTRING, "Cast tags must be a table of strings");
+        tags[i] = lua_tostring(L, -1);
+        lua_pop(L, 1);
+      }
+      info.tagCount = tagCount;
+    }
+    lua_pop(L, 1); // The strings stay alive in the options table
+
+    lua_getfield(L, 3, "any");
+    info.any = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  int previous = luax_startarray(L, 4, 8 * count);
+  float* casts = lua_newuserdata(L, count * (6 * sizeof(float) + sizeof(CastHit)));
+  CastHit* hits = (CastHit*) (casts + 6 * count);
+  for (int i = 0; i < length; i++) {
+    lua_rawgeti(L, 2, i + 1);
+    casts[i] = luax_checkfloat(L, -1);
+    lua_pop(L, 1);
+  }
+
+  uint32_t hitCount = lovrWorldCast(world, &info, casts, count, hits);
+
+  int n = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    CastHit* hit = &hits[i];
+    if (hit->shape) {
+      luax_pushshape(L, hit->shape);
+    } else {
+      lua_pushboolean(L, false);
+    }
+    lua_rawseti(L, 4, ++n);
+    for (int c = 0; c < 3; c++) {
+      lua_pushnumber(L, hit->shape ? hit->position[c] : 0.);
+      lua_rawseti(L, 4, ++n);
+    }
+    for (int c = 0; c < 3; c++) {
+      lua_pushnumber(L, hit->shape ? hit->normal[c] : 0.);
+      lua_rawseti(L, 4, ++n);
+    }
+    lua_pushnumber(L, hit->distance);
+    lua_rawseti(L, 4, ++n);
+  }
+  luax_endarray(L, 4, n, previous);
+  lua_pushvalue(L, 4);
+  lua_pushinteger(L, hitCount);
+  return 2;
+}
+
 static int l_lovrWorldDisableCollisionBetween(lua_State* L) {
   World* world = luax_checktype(L, 1, World);
   const char* tag1 = luaL_checkstring(L, 2);
@@ -328,6 +769,27 @@ static int l_lovrWorldEnableCollisionBetween(lua_State* L) {
   return 0;
 }
 
+static int l_lovrWorldGetContactProperties(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  const char* tag1 = luaL_checkstring(L, 2);
+  const char* tag2 = luaL_checkstring(L, 3);
+  float friction, restitution;
+  lovrAssert(lovrWorldGetContactProperties(world, tag1, tag2, &friction, &restitution), "Unknown tag");
+  if (friction < 0.f) lua_pushnil(L); else lua_pushnumber(L, friction);
+  if (restitution < 0.f) lua_pushnil(L); else lua_pushnumber(L, restitution);
+  return 2;
+}
+
+static int l_lovrWorldSetContactProperties(lua_State* L) {
+  World* world = luax_checktype(L, 1, World);
+  const char* tag1 = luaL_checkstring(L, 2);
+  const char* tag2 = luaL_checkstring(L, 3);
+  float friction = luax_optfloat(L, 4, -1.f);
+  float restitution = luax_optfloat(L, 5, -1.f);
+  lovrAssert(lovrWorldSetContactProperties(world, tag1, tag2, friction, restitution), "Unknown tag");
+  return 0;
+}
+
 static int l_lovrWorldIsCollisionEnabledBetween(lua_State* L) {
   World* world = luax_checktype(L, 1, World);
   const char* tag1 = luaL_checkstring(L, 2);
@@ -343,12 +805,27 @@ const luaL_Reg lovrWorld[] = {
   { "newCylinderCollider", l_lovrWorldNewCylinderCollider },
   { "newSphereCollider", l_lovrWorldNewSphereCollider },
   { "newMeshCollider", l_lovrWorldNewMeshCollider },
+  { "newTerrainCollider", l_lovrWorldNewTerrainCollider },
+  { "newConvexCollider", l_lovrWorldNewConvexCollider },
   { "getColliders", l_lovrWorldGetColliders },
   { "destroy", l_lovrWorldDestroy },
   { "update", l_lovrWorldUpdate },
+  { "getStepSize", l_lovrWorldGetStepSize },
+  { "setStepSize", l_lovrWorldSetStepSize },
+  { "getInterpolation", l_lovrWorldGetInterpolation },
+  { "getInterpolatedPoses", l_lovrWorldGetInterpolatedPoses },
+  { "getPoses", l_lovrWorldGetPoses },
+  { "setPoses", l_lovrWorldSetPoses },
+  { "getDebugGeometry", l_lovrWorldGetDebugGeometry },
+  { "getSnapshotSize", l_lovrWorldGetSnapshotSize },
+  { "saveSnapshot", l_lovrWorldSaveSnapshot },
+  { "loadSnapshot", l_lovrWorldLoadSnapshot },
   { "computeOverlaps", l_lovrWorldComputeOverlaps },
   { "overlaps", l_lovrWorldOverlaps },
   { "collide", l_lovrWorldCollide },
+  { "getOverlaps", l_lovrWorldGetOverlaps },
+  { "getContacts", l_lovrWorldGetContacts },
+  { "getTriggers", l_lovrWorldGetTriggers },
   { "getGravity", l_lovrWorldGetGravity },
   { "setGravity", l_lovrWorldSetGravity },
   { "getTightness", l_lovrWorldGetTightness },
@@ -362,8 +839,11 @@ const luaL_Reg lovrWorld[] = {
   { "isSleepingAllowed", l_lovrWorldIsSleepingAllowed },
   { "setSleepingAllowed", l_lovrWorldSetSleepingAllowed },
   { "raycast", l_lovrWorldRaycast },
+  { "cast", l_lovrWorldCast },
   { "disableCollisionBetween", l_lovrWorldDisableCollisionBetween },
   { "enableCollisionBetween", l_lovrWorldEnableCollisionBetween },
   { "isCollisionEnabledBetween", l_lovrWorldIsCollisionEnabledBetween },
+  { "getContactProperties", l_lovrWorldGetContactProperties },
+  { "setContactProperties", l_lovrWorldSetContactProperties },
   { NULL, NULL }
 };
@@ -1,8 +1,19 @@
 #include "api.h"
 #include "system/system.h"
 #include "core/os.h"
+#include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
+#include <string.h>
+#ifndef LOVR_DISABLE_AUDIO
+#include "audio/audio.h"
+#endif
+#ifndef LOVR_DISABLE_GRAPHICS
+#include "graphics/graphics.h"
+#endif
+#ifndef LOVR_DISABLE_PHYSICS
+#include "physics/physics.h"
+#endif
 
 StringEntry lovrKeyboardKey[] = {
   [KEY_A] = ENTRY("a"),
@@ -114,10 +125,98 @@ static int l_lovrSystemRequestPermission(lua_State* L) {
   return 0;
 }
 
+// Modules are only sampled once they've been loaded, so telemetry never loads a lazy module
+static bool isLoaded(lua_State* L, const char* module) {
+  lua_getfield(L, LUA_REGISTRYINDEX, "_LOADED");
+  lua_getfield(L, -1, module);
+  bool loaded = !lua_isnil(L, -1);
+  lua_pop(L, 2);
+  return loaded;
+}
+
+static int l_lovrSystemStartTelemetry(lua_State* L) {
+  const char* path = luaL_checkstring(L, 1);
+  float rate = luax_optfloat(L, 2, 10.f);
+  uint32_t capacity = luaL_optinteger(L, 3, 600);
+  lovrAssert(lovrSystemStartTelemetry(path, rate, capacity), "Could not open telemetry file '%s'", path);
+  return 0;
+}
+
+static int l_lovrSystemStopTelemetry(lua_State* L) {
+  lovrSystemStopTelemetry();
+  return 0;
+}
+
+static int l_lovrSystemIsTelemetryActive(lua_State* L) {
+  lua_pushboolean(L, lovrSystemIsTelemetryActive());
+  return 1;
+}
+
+static int l_lovrSystemUpdateTelemetry(lua_State* L) {
+  if (!lovrSystemUpdateTelemetry()) {
+    return 0;
+  }
+
+  TelemetryRecord record;
+  memset(&record, 0, sizeof(record));
+  record.luaMemory = (uint64_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+
+#ifndef LOVR_DISABLE_GRAPHICS
+  if (isLoaded(L, "lovr.graphics")) {
+    const GpuStats* stats = lovrGraphicsGetStats();
+    record.sources |= TELEMETRY_GRAPHICS;
+    record.bufferMemory = stats->bufferMemory;
+    record.textureMemory = stats->textureMemory;
+    record.triangles = stats->triangles;
+    record.uploadBytes = stats->textureUploadBytes + stats->bufferUploadBytes + stats->uniformUploadBytes;
+    record.drawCalls = stats->drawCalls;
+    record.shaderSwitches = stats->shaderSwitches;
+    record.renderPasses = stats->renderPasses;
+    for (uint32_t i = 0; i < MAX_FLUSH_REASONS; i++) {
+      record.flushes += stats->flushes[i];
+    }
+    record.bufferCount = stats->bufferCount;
+    record.textureCount = stats->textureCount;
+  }
+#endif
+
+#ifndef LOVR_DISABLE_AUDIO
+  if (isLoaded(L, "lovr.audio")) {
+    AudioStats stats;
+    lovrAudioGetStats(&stats);
+    record.sources |= TELEMETRY_AUDIO;
+    record.audioCallbacks = stats.callbacks;
+    record.audioUnderruns = stats.underruns;
+    record.audioVoices = stats.voices;
+    record.audioVirtualVoices = stats.virtualVoices;
+    record.mixTimeAverage = (float) stats.mixTimeAverage;
+    record.mixTimeMax = (float) stats.mixTimeMax;
+  }
+#endif
+
+#ifndef LOVR_DISABLE_PHYSICS
+  if (isLoaded(L, "lovr.physics")) {
+    PhysicsStats stats;
+    lovrPhysicsGetStats(&stats);
+    record.sources |= TELEMETRY_PHYSICS;
+    record.physicsUpdates = stats.updates;
+    record.physicsSteps = stats.steps;
+    record.physicsTime = stats.updateTime;
+  }
+#endif
+
+  lovrSystemWriteTelemetry(&record);
+  return 0;
+}
+
 static const luaL_Reg lovrSystem[] = {
   { "getOS", l_lovrSystemGetOS },
   { "getCoreCount", l_lovrSystemGetCoreCount },
   { "requestPermission", l_lovrSystemRequestPermission },
+  { "startTelemetry", l_lovrSystemStartTelemetry },
+  { "stopTelemetry", l_lovrSystemStopTelemetry },
+  { "isTelemetryActive", l_lovrSystemIsTelemetryActive },
+  { "updateTelemetry", l_lovrSystemUpdateTelemetry },
   { NULL, NULL }
 };
 
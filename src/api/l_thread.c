@@ -2,12 +2,58 @@
 #include "event/event.h"
 #include "thread/thread.h"
 #include "thread/channel.h"
+#include "thread/pool.h"
+#include "core/os.h"
 #include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+
+StringEntry lovrThreadPriority[] = {
+  [OS_THREAD_PRIORITY_LOW] = ENTRY("low"),
+  [OS_THREAD_PRIORITY_NORMAL] = ENTRY("normal"),
+  [OS_THREAD_PRIORITY_HIGH] = ENTRY("high"),
+  { 0 }
+};
+
+// Reads the affinity and priority fields of the conf table with the given key, if there is one
+void luax_readscheduling(lua_State* L, const char* key, uint64_t* affinity, os_thread_priority* priority) {
+  *affinity = 0;
+  *priority = OS_THREAD_PRIORITY_NORMAL;
+  luax_pushconf(L);
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, key);
+    if (lua_istable(L, -1)) {
+      lua_getfield(L, -1, "affinity");
+      *affinity = (uint64_t) luaL_optnumber(L, -1, 0.);
+      lua_pop(L, 1);
+
+      lua_getfield(L, -1, "priority");
+      *priority = luax_checkenum(L, -1, ThreadPriority, "normal");
+      lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+  }
+  lua_pop(L, 1);
+}
+
+// Starts the shared worker pool (if it isn't running yet), stopping it when L closes
+void luax_startpool(lua_State* L) {
+  if (lovrThreadPoolGetWorkerCount() > 0) {
+    return;
+  }
+
+  uint64_t affinity;
+  os_thread_priority priority;
+  luax_readscheduling(L, "thread", &affinity, &priority);
+  uint32_t cores = os_get_core_count();
+  if (lovrThreadPoolInit(cores > 1 ? cores - 1 : 1, affinity, priority)) {
+    luax_atexit(L, lovrThreadPoolDestroy);
+  }
+}
 
 static int threadRunner(void* data) {
   Thread* thread = (Thread*) data;
@@ -63,24 +109,135 @@ static int threadRunner(void* data) {
   return 1;
 }
 
-static int l_lovrThreadNewThread(lua_State* L) {
-  Blob* blob = luax_totype(L, 1, Blob);
-  if (!blob) {
+// Task workers keep their Lua state around, so the standard libraries and lovr modules are only
+// set up once per worker.  Chunks are compiled the first time a worker sees them, and are cached in
+// the registry by the hash of their code.
+static void* initTaskState(void) {
+  lua_State* L = luaL_newstate();
+  luaL_openlibs(L);
+  luax_preload(L);
+  lua_newtable(L);
+  lua_setfield(L, LUA_REGISTRYINDEX, "_lovrtasks");
+  return L;
+}
+
+static void destroyTaskState(void* context) {
+  lua_close((lua_State*) context);
+}
+
+// Converting the results can fail (e.g. when a function is returned), so it's done in a pcall
+static int collectTaskResults(lua_State* L) {
+  Task* task = lua_touserdata(L, lua_upvalueindex(1));
+  uint32_t count = MIN(lua_gettop(L), MAX_THREAD_ARGUMENTS);
+  for (uint32_t i = 0; i < count; i++) {
+    luax_checkvariant(L, i + 1, &task->results[i]);
+    task->resultCount++;
+  }
+  return 0;
+}
+
+static void runTask(void* context, Task* task) {
+  lua_State* L = context;
+  lovrSetErrorCallback((errorFn*) luax_vthrow, L);
+  int top = lua_gettop(L);
+
+  lua_pushcfunction(L, luax_getstack);
+  int errhandler = lua_gettop(L);
+
+  lua_pushlightuserdata(L, task);
+  lua_pushcclosure(L, collectTaskResults, 1);
+
+  lua_getfield(L, LUA_REGISTRYINDEX, "_lovrtasks");
+  int cache = lua_gettop(L);
+  lua_pushlstring(L, (const char*) &task->hash, sizeof(task->hash));
+  lua_rawget(L, cache);
+
+  bool failed = false;
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    failed = luaL_loadbuffer(L, task->body->data, task->body->size, "task");
+    if (!failed) {
+      lua_pushlstring(L, (const char*) &task->hash, sizeof(task->hash));
+      lua_pushvalue(L, -2);
+      lua_rawset(L, cache);
+    }
+  }
+
+  if (!failed) {
+    for (uint32_t i = 0; i < task->argumentCount; i++) {
+      luax_pushvariant(L, &task->arguments[i]);
+    }
+
+    failed = lua_pcall(L, task->argumentCount, LUA_MULTRET, errhandler);
+
+    if (!failed) {
+      int resultCount = lua_gettop(L) - cache;
+      lua_pushvalue(L, errhandler + 1);
+      lua_insert(L, cache + 1);
+      failed = lua_pcall(L, resultCount, 0, errhandler);
+    }
+  }
+
+  if (failed) {
     size_t length;
-    const char* str = luaL_checklstring(L, 1, &length);
-    if (memchr(str, '\n', MIN(1024, length))) {
-      void* data = malloc(length + 1);
-      lovrAssert(data, "Out of memory");
-      memcpy(data, str, length + 1);
-      blob = lovrBlobCreate(data, length, "thread code");
-    } else {
-      void* code = luax_readfile(str, &length);
-      lovrAssert(code, "Could not read thread code from file '%s'", str);
-      blob = lovrBlobCreate(code, length, str);
+    const char* error = lua_tolstring(L, -1, &length);
+    if (error) {
+      task->error = malloc(length + 1);
+      if (task->error) {
+        memcpy(task->error, error, length + 1);
+      }
     }
-  } else {
+  }
+
+  lua_settop(L, top);
+
+  // Each task is its own "frame" for temporary vectors
+#ifndef LOVR_DISABLE_MATH
+  luax_drainvectors();
+#endif
+}
+
+// Code is a Blob, a string of code, a filename, or (for Tasks) a function without upvalues, which
+// gets dumped to bytecode since functions can't be shared between Lua states
+static Blob* luax_readcode(lua_State* L, int index, const char* debug) {
+  Blob* blob = luax_totype(L, index, Blob);
+  if (blob) {
     lovrRetain(blob);
+    return blob;
+  }
+
+  size_t length;
+  if (lua_isfunction(L, index)) {
+    lua_getglobal(L, "string");
+    lua_getfield(L, -1, "dump");
+    lua_pushvalue(L, index);
+    lua_call(L, 1, 1);
+    const char* bytecode = lua_tolstring(L, -1, &length);
+    void* data = malloc(length);
+    lovrAssert(data, "Out of memory");
+    memcpy(data, bytecode, length);
+    lua_pop(L, 2);
+    return lovrBlobCreate(data, length, debug);
   }
+
+  const char* str = luaL_checklstring(L, index, &length);
+  if (memchr(str, '\n', MIN(1024, length))) {
+    void* data = malloc(length + 1);
+    lovrAssert(data, "Out of memory");
+    memcpy(data, str, length + 1);
+    return lovrBlobCreate(data, length, debug);
+  } else {
+    void* code = luax_readfile(str, &length);
+    lovrAssert(code, "Could not read %s from file '%s'", debug, str);
+    return lovrBlobCreate(code, length, str);
+  }
+}
+
+static int l_lovrThreadNewThread(lua_State* L) {
+  if (lua_isfunction(L, 1)) {
+    return luaL_argerror(L, 1, "Thread code can't be a function");
+  }
+  Blob* blob = luax_readcode(L, 1, "thread code");
   Thread* thread = lovrThreadCreate(threadRunner, blob);
   luax_pushtype(L, Thread, thread);
   lovrRelease(thread, lovrThreadDestroy);
@@ -88,6 +245,31 @@ static int l_lovrThreadNewThread(lua_State* L) {
   return 1;
 }
 
+static int l_lovrThreadSubmit(lua_State* L) {
+  Blob* blob = luax_readcode(L, 1, "task code");
+  Variant arguments[MAX_THREAD_ARGUMENTS];
+  uint32_t argumentCount = MIN(MAX_THREAD_ARGUMENTS, lua_gettop(L) - 1);
+  for (uint32_t i = 0; i < argumentCount; i++) {
+    luax_checkvariant(L, 2 + i, &arguments[i]);
+  }
+
+  if (lovrThreadGetTaskWorkerCount() == 0) {
+    uint64_t affinity;
+    os_thread_priority priority;
+    luax_readscheduling(L, "thread", &affinity, &priority);
+    TaskRunner runner = { initTaskState, runTask, destroyTaskState };
+    uint32_t cores = os_get_core_count();
+    lovrThreadStartWorkers(&runner, cores > 1 ? cores - 1 : 1, affinity, priority);
+  }
+
+  Task* task = lovrTaskCreate(blob, arguments, argumentCount);
+  lovrTaskSubmit(task);
+  luax_pushtype(L, Task, task);
+  lovrRelease(task, lovrTaskDestroy);
+  lovrRelease(blob, lovrBlobDestroy);
+  return 1;
+}
+
 static int l_lovrThreadGetChannel(lua_State* L) {
   const char* name = luaL_checkstring(L, 1);
   Channel* channel = lovrThreadGetChannel(name);
@@ -96,20 +278,67 @@ static int l_lovrThreadGetChannel(lua_State* L) {
   return 1;
 }
 
+#define MAX_SELECT_CHANNELS 64
+
+// Waits for a message on any of the Channels, waiting forever when there's no timeout.  Returns the
+// Channel and the message, or nil if the timeout ran out.
+static int l_lovrThreadSelect(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  Channel* channels[MAX_SELECT_CHANNELS];
+  int count = luax_len(L, 1);
+  lovrAssert(count <= MAX_SELECT_CHANNELS, "Too many Channels to select from (max is %d)", MAX_SELECT_CHANNELS);
+  for (int i = 0; i < count; i++) {
+    lua_rawgeti(L, 1, i + 1);
+    channels[i] = luax_checktype(L, -1, Channel);
+    lua_pop(L, 1);
+  }
+
+  double timeout;
+  switch (lua_type(L, 2)) {
+    case LUA_TNONE: case LUA_TNIL: timeout = INFINITY; break;
+    case LUA_TBOOLEAN: timeout = lua_toboolean(L, 2) ? INFINITY : NAN; break;
+    default: timeout = luaL_checknumber(L, 2); break;
+  }
+
+  Variant variant;
+  uint32_t index;
+  if (lovrChannelSelect(channels, count, &variant, timeout, &index)) {
+    lua_rawgeti(L, 1, index + 1);
+    luax_pushvariant(L, &variant);
+    lovrVariantDestroy(&variant);
+    return 2;
+  }
+
+  lua_pushnil(L);
+  return 1;
+}
+
+// Starts the pool, so this is also how many jobs native parallel work gets split across
+static int l_lovrThreadGetWorkerCount(lua_State* L) {
+  luax_startpool(L);
+  lua_pushinteger(L, lovrThreadPoolGetWorkerCount());
+  return 1;
+}
+
 static const luaL_Reg lovrThreadModule[] = {
   { "newThread", l_lovrThreadNewThread },
+  { "submit", l_lovrThreadSubmit },
   { "getChannel", l_lovrThreadGetChannel },
+  { "select", l_lovrThreadSelect },
+  { "getWorkerCount", l_lovrThreadGetWorkerCount },
   { NULL, NULL }
 };
 
 extern const luaL_Reg lovrThread[];
 extern const luaL_Reg lovrChannel[];
+extern const luaL_Reg lovrTask[];
 
 int luaopen_lovr_thread(lua_State* L) {
   lua_newtable(L);
   luax_register(L, lovrThreadModule);
   luax_registertype(L, Thread);
   luax_registertype(L, Channel);
+  luax_registertype(L, Task);
   if (lovrThreadModuleInit()) {
     luax_atexit(L, lovrThreadModuleDestroy);
   }
@@ -29,6 +29,9 @@ static int l_lovrChannelPush(lua_State* L) {
   luax_checktimeout(L, 3, &timeout);
   uint64_t id;
   bool read = lovrChannelPush(channel, &variant, timeout, &id);
+  if (id == 0) {
+    lovrVariantDestroy(&variant);
+  }
   lua_pushnumber(L, id);
   lua_pushboolean(L, read);
   return 2;
@@ -80,6 +83,25 @@ static int l_lovrChannelHasRead(lua_State* L) {
   return 1;
 }
 
+static int l_lovrChannelGetCapacity(lua_State* L) {
+  Channel* channel = luax_checktype(L, 1, Channel);
+  uint32_t capacity = lovrChannelGetCapacity(channel);
+  if (capacity == 0) {
+    lua_pushnil(L);
+  } else {
+    lua_pushinteger(L, capacity);
+  }
+  return 1;
+}
+
+static int l_lovrChannelSetCapacity(lua_State* L) {
+  Channel* channel = luax_checktype(L, 1, Channel);
+  lua_Integer capacity = luaL_optinteger(L, 2, 0);
+  lovrAssert(lua_isnoneornil(L, 2) || (capacity > 0 && capacity < UINT32_MAX), "Channel capacity must be positive, or nil for unbounded");
+  lovrChannelSetCapacity(channel, (uint32_t) capacity);
+  return 0;
+}
+
 const luaL_Reg lovrChannel[] = {
   { "push", l_lovrChannelPush },
   { "pop", l_lovrChannelPop },
@@ -87,5 +109,7 @@ const luaL_Reg lovrChannel[] = {
   { "clear", l_lovrChannelClear },
   { "getCount", l_lovrChannelGetCount },
   { "hasRead", l_lovrChannelHasRead },
+  { "getCapacity", l_lovrChannelGetCapacity },
+  { "setCapacity", l_lovrChannelSetCapacity },
   { NULL, NULL }
 };
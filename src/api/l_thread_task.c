@@ -0,0 +1,49 @@
+#include "api.h"
+#include "thread/thread.h"
+#include "core/util.h"
+#include <lua.h>
+#include <lauxlib.h>
+#include <math.h>
+
+static int l_lovrTaskWait(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  double timeout = luaL_optnumber(L, 2, INFINITY);
+  lua_pushboolean(L, lovrTaskWait(task, timeout));
+  return 1;
+}
+
+static int l_lovrTaskIsDone(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  lua_pushboolean(L, lovrTaskIsDone(task));
+  return 1;
+}
+
+static int l_lovrTaskGetResults(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  if (!lovrTaskIsDone(task) || task->error) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < task->resultCount; i++) {
+    luax_pushvariant(L, &task->results[i]);
+  }
+  return task->resultCount;
+}
+
+static int l_lovrTaskGetError(lua_State* L) {
+  Task* task = luax_checktype(L, 1, Task);
+  const char* error = lovrTaskGetError(task);
+  if (error) {
+    lua_pushstring(L, error);
+  } else {
+    lua_pushnil(L);
+  }
+  return 1;
+}
+
+const luaL_Reg lovrTask[] = {
+  { "wait", l_lovrTaskWait },
+  { "isDone", l_lovrTaskIsDone },
+  { "getResults", l_lovrTaskGetResults },
+  { "getError", l_lovrTaskGetError },
+  { NULL, NULL }
+};
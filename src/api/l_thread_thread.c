@@ -38,10 +38,41 @@ static int l_lovrThreadIsRunning(lua_State* L) {
   return 1;
 }
 
+static int l_lovrThreadGetAffinity(lua_State* L) {
+  Thread* thread = luax_checktype(L, 1, Thread);
+  lua_pushnumber(L, (lua_Number) lovrThreadGetAffinity(thread));
+  return 1;
+}
+
+// Masks past 2^53 can't be represented exactly in a Lua number, but that's plenty of cores
+static int l_lovrThreadSetAffinity(lua_State* L) {
+  Thread* thread = luax_checktype(L, 1, Thread);
+  uint64_t mask = (uint64_t) luaL_optnumber(L, 2, 0.);
+  lovrThreadSetAffinity(thread, mask);
+  return 0;
+}
+
+static int l_lovrThreadGetPriority(lua_State* L) {
+  Thread* thread = luax_checktype(L, 1, Thread);
+  luax_pushenum(L, ThreadPriority, lovrThreadGetPriority(thread));
+  return 1;
+}
+
+static int l_lovrThreadSetPriority(lua_State* L) {
+  Thread* thread = luax_checktype(L, 1, Thread);
+  os_thread_priority priority = luax_checkenum(L, 2, ThreadPriority, NULL);
+  lovrThreadSetPriority(thread, priority);
+  return 0;
+}
+
 const luaL_Reg lovrThread[] = {
   { "start", l_lovrThreadStart },
   { "wait", l_lovrThreadWait },
   { "getError", l_lovrThreadGetError },
   { "isRunning", l_lovrThreadIsRunning },
+  { "getAffinity", l_lovrThreadGetAffinity },
+  { "setAffinity", l_lovrThreadSetAffinity },
+  { "getPriority", l_lovrThreadGetPriority },
+  { "setPriority", l_lovrThreadSetPriority },
   { NULL, NULL }
 };
@@ -1,7 +1,11 @@
 #include "api.h"
 #include "timer/timer.h"
+#include "core/profile.h"
+#include "core/util.h"
 #include <lua.h>
 #include <lauxlib.h>
+#include <stdlib.h>
+#include <string.h>
 
 static int l_lovrTimerGetDelta(lua_State* L) {
   lua_pushnumber(L, lovrTimerGetDelta());
@@ -34,6 +38,59 @@ static int l_lovrTimerSleep(lua_State* L) {
   return 0;
 }
 
+static int l_lovrTimerIsProfiling(lua_State* L) {
+  lua_pushboolean(L, lovrProfileIsEnabled());
+  return 1;
+}
+
+static int l_lovrTimerSetProfiling(lua_State* L) {
+  lovrProfileSetEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
+// The profiler keeps pointers to zone names, so each name is copied once and then kept around in
+// the registry.  Names are expected to be a small set of constant strings.
+static int l_lovrTimerBeginZone(lua_State* L) {
+  size_t length;
+  const char* name = luaL_checklstring(L, 1, &length);
+  lua_getfield(L, LUA_REGISTRYINDEX, "_lovrzones");
+  if (lua_isnil(L, -1)) {
+    lua_pop(L, 1);
+    lua_newtable(L);
+    lua_pushvalue(L, -1);
+    lua_setfield(L, LUA_REGISTRYINDEX, "_lovrzones");
+  }
+  lua_pushvalue(L, 1);
+  lua_rawget(L, -2);
+  const char* copy = lua_touserdata(L, -1);
+  if (!copy) {
+    char* string = malloc(length + 1);
+    lovrAssert(string, "Out of memory");
+    memcpy(string, name, length + 1);
+    lua_pushvalue(L, 1);
+    lua_pushlightuserdata(L, string);
+    lua_rawset(L, -4);
+    copy = string;
+  }
+  lua_pop(L, 2);
+  lovrProfileBegin(copy);
+  return 0;
+}
+
+static int l_lovrTimerEndZone(lua_State* L) {
+  lovrProfileEnd();
+  return 0;
+}
+
+// Returns the recorded zones as a JSON string in Chrome's trace event format
+static int l_lovrTimerExportProfile(lua_State* L) {
+  size_t length;
+  char* json = lovrProfileExport(&length);
+  lua_pushlstring(L, json, length);
+  free(json);
+  return 1;
+}
+
 static const luaL_Reg lovrTimer[] = {
   { "getDelta", l_lovrTimerGetDelta },
   { "getAverageDelta", l_lovrTimerGetAverageDelta },
@@ -41,6 +98,11 @@ static const luaL_Reg lovrTimer[] = {
   { "getTime", l_lovrTimerGetTime },
   { "step", l_lovrTimerStep },
   { "sleep", l_lovrTimerSleep },
+  { "isProfiling", l_lovrTimerIsProfiling },
+  { "setProfiling", l_lovrTimerSetProfiling },
+  { "beginZone", l_lovrTimerBeginZone },
+  { "endZone", l_lovrTimerEndZone },
+  { "exportProfile", l_lovrTimerExportProfile },
   { NULL, NULL }
 };
 
@@ -3,6 +3,7 @@
 #include "fs.h"
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <stdlib.h>
 
 #define FS_PATH_MAX 1024
 
@@ -53,6 +54,12 @@ bool fs_write(fs_handle file, const void* buffer, size_t* bytes) {
   return success;
 }
 
+bool fs_seek(fs_handle file, uint64_t offset) {
+  LARGE_INTEGER position;
+  position.QuadPart = (LONGLONG) offset;
+  return SetFilePointerEx(file.handle, position, NULL, FILE_BEGIN);
+}
+
 void* fs_map(const char* path, size_t* size) {
   WCHAR wpath[FS_PATH_MAX];
   if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, FS_PATH_MAX)) {
@@ -81,21 +88,65 @@ void* fs_map(const char* path, size_t* size) {
     *size = lo;
   }
 
-  HANDLE mapping = CreateFileMappingA(file.handle, NULL, PAGE_READONLY, hi, lo, NULL);
+  HANDLE mapping = CreateFileMappingA(file.handle, NULL, PAGE_WRITECOPY, hi, lo, NULL);
   if (mapping == NULL) {
     CloseHandle(file.handle);
     return NULL;
   }
 
-  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, *size);
+  void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, *size);
 
   CloseHandle(mapping);
   CloseHandle(file.handle);
   return data;
 }
 
+void* fs_map_range(const char* path, uint64_t offset, size_t size) {
+  WCHAR wpath[FS_PATH_MAX];
+  if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, FS_PATH_MAX)) {
+    return NULL;
+  }
+
+  fs_handle file;
+  file.handle = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file.handle == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file.handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  if (mapping == NULL) {
+    CloseHandle(file.handle);
+    return NULL;
+  }
+
+  // Views have to start on an allocation granularity boundary
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  uint64_t start = offset - (offset % info.dwAllocationGranularity);
+  size_t padding = (size_t) (offset - start);
+  char* data = MapViewOfFile(mapping, FILE_MAP_COPY, (DWORD) (start >> 32), (DWORD) start, size + padding);
+
+  CloseHandle(mapping);
+  CloseHandle(file.handle);
+  return data ? data + padding : NULL;
+}
+
 bool fs_unmap(void* data, size_t size) {
-  return UnmapViewOfFile(data);
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  uintptr_t p = (uintptr_t) data;
+  return UnmapViewOfFile((void*) (p - (p % info.dwAllocationGranularity)));
+}
+
+bool fs_evict(void* data, size_t size) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  uintptr_t pageSize = info.dwPageSize;
+  uintptr_t start = ((uintptr_t) data + pageSize - 1) & ~(pageSize - 1);
+  uintptr_t end = ((uintptr_t) data + size) & ~(pageSize - 1);
+  if (end <= start) return true;
+  // Unlocking pages that aren't locked removes them from the working set, which is the point here
+  return VirtualUnlock((void*) start, end - start) || GetLastError() == ERROR_NOT_LOCKED;
 }
 
 bool fs_stat(const char* path, FileInfo* info) {
@@ -165,6 +216,80 @@ bool fs_list(const char* path, fs_list_cb* callback, void* context) {
   return true;
 }
 
+// Watching uses one recursive ReadDirectoryChangesW request that is polled without blocking
+struct fs_watcher {
+  HANDLE handle;
+  OVERLAPPED overlapped;
+  DWORD buffer[4096];
+};
+
+static bool fs_watch_request(fs_watcher* watcher) {
+  DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+  return ReadDirectoryChangesW(watcher->handle, watcher->buffer, sizeof(watcher->buffer), TRUE, filter, NULL, &watcher->overlapped, NULL);
+}
+
+fs_watcher* fs_watch(const char* path) {
+  WCHAR wpath[FS_PATH_MAX];
+  if (!MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, FS_PATH_MAX)) {
+    return NULL;
+  }
+
+  fs_watcher* watcher = calloc(1, sizeof(fs_watcher));
+  if (!watcher) return NULL;
+
+  DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+  DWORD flags = FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED;
+  watcher->handle = CreateFileW(wpath, FILE_LIST_DIRECTORY, share, NULL, OPEN_EXISTING, flags, NULL);
+  if (watcher->handle == INVALID_HANDLE_VALUE) {
+    free(watcher);
+    return NULL;
+  }
+
+  watcher->overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+  if (!watcher->overlapped.hEvent || !fs_watch_request(watcher)) {
+    if (watcher->overlapped.hEvent) CloseHandle(watcher->overlapped.hEvent);
+    CloseHandle(watcher->handle);
+    free(watcher);
+    return NULL;
+  }
+
+  return watcher;
+}
+
+void fs_watch_poll(fs_watcher* watcher, fs_list_cb* callback, void* context) {
+  DWORD bytes;
+  while (GetOverlappedResult(watcher->handle, &watcher->overlapped, &bytes, FALSE)) {
+    char* cursor = (char*) watcher->buffer;
+    while (bytes > 0) {
+      FILE_NOTIFY_INFORMATION* info = (FILE_NOTIFY_INFORMATION*) cursor;
+      char path[FS_PATH_MAX];
+      int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, info->FileNameLength / sizeof(WCHAR), path, FS_PATH_MAX - 1, NULL, NULL);
+      if (length > 0) {
+        path[length] = '\0';
+        for (int i = 0; i < length; i++) {
+          if (path[i] == '\\') path[i] = '/';
+        }
+        callback(context, path);
+      }
+
+      if (info->NextEntryOffset == 0) break;
+      cursor += info->NextEntryOffset;
+    }
+
+    ResetEvent(watcher->overlapped.hEvent);
+    if (!fs_watch_request(watcher)) {
+      break;
+    }
+  }
+}
+
+void fs_unwatch(fs_watcher* watcher) {
+  CancelIo(watcher->handle);
+  CloseHandle(watcher->overlapped.hEvent);
+  CloseHandle(watcher->handle);
+  free(watcher);
+}
+
 #else // !_WIN32
 
 #include "fs.h"
@@ -174,6 +299,12 @@ bool fs_list(const char* path, fs_list_cb* callback, void* context) {
 #include <dirent.h>
 #include <limits.h>
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 bool fs_open(const char* path, OpenMode mode, fs_handle* file) {
   int flags;
@@ -213,6 +344,10 @@ bool fs_write(fs_handle file, const void* buffer, size_t* bytes) {
   }
 }
 
+bool fs_seek(fs_handle file, uint64_t offset) {
+  return lseek(file.fd, (off_t) offset, SEEK_SET) != (off_t) -1;
+}
+
 void* fs_map(const char* path, size_t* size) {
   FileInfo info;
   fs_handle file;
@@ -220,13 +355,46 @@ void* fs_map(const char* path, size_t* size) {
     return NULL;
   }
   *size = info.size;
-  void* data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+  void* data = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file.fd, 0);
   fs_close(file);
-  return data;
+  return data == MAP_FAILED ? NULL : data;
+}
+
+void* fs_map_range(const char* path, uint64_t offset, size_t size) {
+  fs_handle file;
+  if (!fs_open(path, OPEN_READ, &file)) {
+    return NULL;
+  }
+
+  // Mappings have to start on a page boundary
+  uint64_t pageSize = sysconf(_SC_PAGESIZE);
+  uint64_t start = offset - (offset % pageSize);
+  size_t padding = (size_t) (offset - start);
+  char* data = mmap(NULL, size + padding, PROT_READ | PROT_WRITE, MAP_PRIVATE, file.fd, start);
+  fs_close(file);
+  return data == MAP_FAILED ? NULL : data + padding;
 }
 
 bool fs_unmap(void* data, size_t size) {
-  return munmap(data, size) == 0;
+  uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t p = (uintptr_t) data;
+  size_t padding = p % pageSize;
+  return munmap((void*) (p - padding), size + padding) == 0;
+}
+
+bool fs_evict(void* data, size_t size) {
+  uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t) data + pageSize - 1) & ~(pageSize - 1);
+  uintptr_t end = ((uintptr_t) data + size) & ~(pageSize - 1);
+  if (end <= start) return true;
+#if defined(MADV_PAGEOUT)
+  return madvise((void*) start, end - start, MADV_PAGEOUT) == 0;
+#elif defined(__APPLE__)
+  // Unlike on Linux, MADV_DONTNEED is only advisory on Apple platforms and never discards contents
+  return madvise((void*) start, end - start, MADV_DONTNEED) == 0;
+#else
+  return false;
+#endif
 }
 
 bool fs_stat(const char* path, FileInfo* info) {
@@ -267,4 +435,149 @@ bool fs_list(const char* path, fs_list_cb* callback, void* context) {
   return true;
 }
 
+#ifdef __linux__
+
+// inotify isn't recursive, so every directory in the tree gets its own watch
+struct fs_watcher {
+  int fd;
+  size_t count;
+  size_t capacity;
+  struct { int wd; char* path; }* dirs;
+  char root[PATH_MAX];
+};
+
+#define FS_WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+static void fs_watch_add(fs_watcher* watcher, const char* path) {
+  char full[PATH_MAX];
+  int length = snprintf(full, sizeof(full), "%s%s%s", watcher->root, *path ? "/" : "", path);
+  if (length < 0 || length >= (int) sizeof(full)) return;
+
+  int wd = inotify_add_watch(watcher->fd, full, FS_WATCH_EVENTS | IN_ONLYDIR);
+  if (wd < 0) return;
+
+  if (watcher->count == watcher->capacity) {
+    size_t capacity = watcher->capacity ? watcher->capacity * 2 : 16;
+    void* dirs = realloc(watcher->dirs, capacity * sizeof(*watcher->dirs));
+    if (!dirs) return;
+    watcher->dirs = dirs;
+    watcher->capacity = capacity;
+  }
+
+  char* copy = malloc(strlen(path) + 1);
+  if (!copy) return;
+  strcpy(copy, path);
+  watcher->dirs[watcher->count].wd = wd;
+  watcher->dirs[watcher->count].path = copy;
+  watcher->count++;
+
+  DIR* dir = opendir(full);
+  if (!dir) return;
+
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+
+    char child[PATH_MAX];
+    length = snprintf(child, sizeof(child), "%s%s%s", path, *path ? "/" : "", entry->d_name);
+    if (length < 0 || length >= (int) sizeof(child)) continue;
+
+    FileInfo info;
+    char childFull[PATH_MAX];
+    if (snprintf(childFull, sizeof(childFull), "%s/%s", watcher->root, child) < (int) sizeof(childFull) && fs_stat(childFull, &info) && info.type == FILE_DIRECTORY) {
+      fs_watch_add(watcher, child);
+    }
+  }
+
+  closedir(dir);
+}
+
+fs_watcher* fs_watch(const char* path) {
+  fs_watcher* watcher = calloc(1, sizeof(fs_watcher));
+  if (!watcher || strlen(path) >= sizeof(watcher->root)) {
+    free(watcher);
+    return NULL;
+  }
+
+  watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watcher->fd < 0) {
+    free(watcher);
+    return NULL;
+  }
+
+  strcpy(watcher->root, path);
+  fs_watch_add(watcher, "");
+  return watcher;
+}
+
+void fs_watch_poll(fs_watcher* watcher, fs_list_cb* callback, void* context) {
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  for (;;) {
+    ssize_t size = read(watcher->fd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      return;
+    }
+
+    for (char* cursor = buffer; cursor < buffer + size;) {
+      struct inotify_event* event = (struct inotify_event*) cursor;
+      cursor += sizeof(struct inotify_event) + event->len;
+
+      const char* parent = NULL;
+      for (size_t i = 0; i < watcher->count; i++) {
+        if (watcher->dirs[i].wd == event->wd) {
+          parent = watcher->dirs[i].path;
+          break;
+        }
+      }
+
+      if (!parent || event->len == 0) {
+        continue;
+      }
+
+      char path[PATH_MAX];
+      int length = snprintf(path, sizeof(path), "%s%s%s", parent, *parent ? "/" : "", event->name);
+      if (length < 0 || length >= (int) sizeof(path)) {
+        continue;
+      }
+
+      // New directories need watches of their own, files report once they're closed
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          fs_watch_add(watcher, path);
+        }
+      } else if (event->mask & IN_CREATE) {
+        continue;
+      }
+
+      callback(context, path);
+    }
+  }
+}
+
+void fs_unwatch(fs_watcher* watcher) {
+  for (size_t i = 0; i < watcher->count; i++) {
+    free(watcher->dirs[i].path);
+  }
+  free(watcher->dirs);
+  close(watcher->fd);
+  free(watcher);
+}
+
+#else
+
+fs_watcher* fs_watch(const char* path) {
+  return NULL;
+}
+
+void fs_watch_poll(fs_watcher* watcher, fs_list_cb* callback, void* context) {
+  //
+}
+
+void fs_unwatch(fs_watcher* watcher) {
+  //
+}
+
+#endif
+
 #endif
@@ -28,9 +28,22 @@ bool fs_open(const char* path, OpenMode mode, fs_handle* file);
 bool fs_close(fs_handle file);
 bool fs_read(fs_handle file, void* buffer, size_t* bytes);
 bool fs_write(fs_handle file, const void* buffer, size_t* bytes);
+bool fs_seek(fs_handle file, uint64_t offset);
+// Mappings are copy-on-write, writing to them never modifies the file
 void* fs_map(const char* path, size_t* size);
+void* fs_map_range(const char* path, uint64_t offset, size_t size);
 bool fs_unmap(void* data, size_t size);
+// Hints that a range of a mapping won't be touched for a while, so its pages can leave memory.  The
+// contents don't change, they're paged back in from the file (or swap) when they're used again.
+bool fs_evict(void* data, size_t size);
 bool fs_stat(const char* path, FileInfo* info);
 bool fs_remove(const char* path);
 bool fs_mkdir(const char* path);
 bool fs_list(const char* path, fs_list_cb* callback, void* context);
+
+// Watches a directory tree for changes, reporting changed paths relative to the root on each poll.
+// Returns NULL where watching isn't supported (currently Windows, Linux, and Android are).
+typedef struct fs_watcher fs_watcher;
+fs_watcher* fs_watch(const char* path);
+void fs_watch_poll(fs_watcher* watcher, fs_list_cb* callback, void* context);
+void fs_unwatch(fs_watcher* watcher);
@@ -14,6 +14,45 @@ typedef float* vec3;
 typedef float* quat;
 typedef float* mat4;
 
+// SIMD
+// The mat4 and quat kernels use SSE or NEON when the compiler targets them, and scalar code
+// otherwise (or when MAF_SCALAR is defined).  Vectors and matrices don't have to be aligned.  NEON
+// needs __builtin_shufflevector for shuffles, which clang and newer versions of GCC have.  On the
+// web, Emscripten compiles the SSE path to WebAssembly SIMD when building with -msimd128 -msse.
+
+#if !defined(MAF_SCALAR) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define MAF_SIMD
+typedef __m128 maf_v4;
+#define maf_load(p) _mm_loadu_ps(p)
+#define maf_store(p, v) _mm_storeu_ps(p, v)
+#define maf_splat(x) _mm_set1_ps(x)
+#define maf_set(x, y, z, w) _mm_setr_ps(x, y, z, w)
+#define maf_add(a, b) _mm_add_ps(a, b)
+#define maf_sub(a, b) _mm_sub_ps(a, b)
+#define maf_mul(a, b) _mm_mul_ps(a, b)
+#define maf_madd(a, b, c) _mm_add_ps(a, _mm_mul_ps(b, c))
+#define maf_first(v) _mm_cvtss_f32(v)
+#define maf_shuffle(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#elif !defined(MAF_SCALAR) && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 12))
+#include <arm_neon.h>
+#define MAF_SIMD
+typedef float32x4_t maf_v4;
+#define maf_load(p) vld1q_f32(p)
+#define maf_store(p, v) vst1q_f32(p, v)
+#define maf_splat(x) vdupq_n_f32(x)
+#define maf_set(x, y, z, w) ((float32x4_t) { x, y, z, w })
+#define maf_add(a, b) vaddq_f32(a, b)
+#define maf_sub(a, b) vsubq_f32(a, b)
+#define maf_mul(a, b) vmulq_f32(a, b)
+#define maf_madd(a, b, c) vmlaq_f32(a, b, c)
+#define maf_first(v) vgetq_lane_f32(v, 0)
+#define maf_shuffle(a, b, x, y, z, w) __builtin_shufflevector(a, b, x, y, (z) + 4, (w) + 4)
+#endif
+
+// Lanes x and y come from a, z and w from b
+#define maf_swizzle(v, x, y, z, w) maf_shuffle(v, v, x, y, z, w)
+
 // vec3
 
 MAF vec3 vec3_set(vec3 v, float x, float y, float z) {
@@ -166,12 +205,24 @@ MAF quat quat_identity(quat q) {
 }
 
 MAF quat quat_mul(quat out, quat q, quat r) {
+#ifdef MAF_SIMD
+  maf_v4 a = maf_load(q);
+  maf_v4 b = maf_load(r);
+  maf_v4 sign = maf_set(1.f, 1.f, 1.f, -1.f);
+  maf_v4 result = maf_mul(maf_swizzle(a, 3, 3, 3, 3), b);
+  result = maf_madd(result, maf_mul(maf_swizzle(a, 0, 1, 2, 0), maf_swizzle(b, 3, 3, 3, 0)), sign);
+  result = maf_madd(result, maf_mul(maf_swizzle(a, 1, 2, 0, 1), maf_swizzle(b, 2, 0, 1, 1)), sign);
+  result = maf_sub(result, maf_mul(maf_swizzle(a, 2, 0, 1, 2), maf_swizzle(b, 1, 2, 0, 2)));
+  maf_store(out, result);
+  return out;
+#else
   return quat_set(out,
     q[0] * r[3] + q[3] * r[0] + q[1] * r[2] - q[2] * r[1],
     q[1] * r[3] + q[3] * r[1] + q[2] * r[0] - q[0] * r[2],
     q[2] * r[3] + q[3] * r[2] + q[0] * r[1] - q[1] * r[0],
     q[3] * r[3] - q[0] * r[0] - q[1] * r[1] - q[2] * r[2]
   );
+#endif
 }
 
 MAF float quat_length(quat q) {
@@ -230,10 +281,14 @@ MAF quat quat_slerp(quat q, quat r, float t) {
   float a = sinf((1.f - t) * halfTheta) / sinHalfTheta;
   float b = sinf(t * halfTheta) / sinHalfTheta;
 
+#ifdef MAF_SIMD
+  maf_store(q, maf_madd(maf_mul(maf_load(q), maf_splat(a)), maf_load(r), maf_splat(b)));
+#else
   q[0] = q[0] * a + r[0] * b;
   q[1] = q[1] * a + r[1] * b;
   q[2] = q[2] * a + r[2] * b;
   q[3] = q[3] * a + r[3] * b;
+#endif
 
   return q;
 }
@@ -401,7 +456,65 @@ MAF mat4 mat4_transpose(mat4 m) {
   return m;
 }
 
+// The SIMD version inverts the matrix as 2x2 blocks, see
+// https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+// Columns are treated as rows, which works out since the inverse of the transpose is the transpose
+// of the inverse.
+#ifdef MAF_SIMD
+#define maf_mat2mul(a, b) maf_add(maf_mul(a, maf_swizzle(b, 0, 3, 0, 3)), maf_mul(maf_swizzle(a, 1, 0, 3, 2), maf_swizzle(b, 2, 1, 2, 1)))
+#define maf_mat2adjmul(a, b) maf_sub(maf_mul(maf_swizzle(a, 3, 3, 0, 0), b), maf_mul(maf_swizzle(a, 1, 1, 2, 2), maf_swizzle(b, 2, 3, 0, 1)))
+#define maf_mat2muladj(a, b) maf_sub(maf_mul(a, maf_swizzle(b, 3, 0, 3, 0)), maf_mul(maf_swizzle(a, 1, 0, 3, 2), maf_swizzle(b, 2, 1, 2, 1)))
+#endif
+
 MAF mat4 mat4_invert(mat4 m) {
+#ifdef MAF_SIMD
+  maf_v4 c0 = maf_load(m + 0);
+  maf_v4 c1 = maf_load(m + 4);
+  maf_v4 c2 = maf_load(m + 8);
+  maf_v4 c3 = maf_load(m + 12);
+
+  maf_v4 A = maf_shuffle(c0, c1, 0, 1, 0, 1);
+  maf_v4 B = maf_shuffle(c0, c1, 2, 3, 2, 3);
+  maf_v4 C = maf_shuffle(c2, c3, 0, 1, 0, 1);
+  maf_v4 D = maf_shuffle(c2, c3, 2, 3, 2, 3);
+
+  maf_v4 dets = maf_sub(
+    maf_mul(maf_shuffle(c0, c2, 0, 2, 0, 2), maf_shuffle(c1, c3, 1, 3, 1, 3)),
+    maf_mul(maf_shuffle(c0, c2, 1, 3, 1, 3), maf_shuffle(c1, c3, 0, 2, 0, 2))
+  );
+
+  maf_v4 detA = maf_swizzle(dets, 0, 0, 0, 0);
+  maf_v4 detB = maf_swizzle(dets, 1, 1, 1, 1);
+  maf_v4 detC = maf_swizzle(dets, 2, 2, 2, 2);
+  maf_v4 detD = maf_swizzle(dets, 3, 3, 3, 3);
+
+  maf_v4 DC = maf_mat2adjmul(D, C);
+  maf_v4 AB = maf_mat2adjmul(A, B);
+  maf_v4 X = maf_sub(maf_mul(detD, A), maf_mat2mul(B, DC));
+  maf_v4 W = maf_sub(maf_mul(detA, D), maf_mat2mul(C, AB));
+  maf_v4 Y = maf_sub(maf_mul(detB, C), maf_mat2muladj(D, AB));
+  maf_v4 Z = maf_sub(maf_mul(detC, B), maf_mat2muladj(A, DC));
+
+  maf_v4 trace = maf_mul(AB, maf_swizzle(DC, 0, 2, 1, 3));
+  trace = maf_add(trace, maf_swizzle(trace, 2, 3, 0, 1));
+  trace = maf_add(trace, maf_swizzle(trace, 1, 0, 3, 2));
+  float d = maf_first(dets) * maf_first(detD) + maf_first(detB) * maf_first(detC) - maf_first(trace);
+
+  if (!d) { return m; }
+  float invDet = 1.f / d;
+  maf_v4 scale = maf_set(invDet, -invDet, -invDet, invDet);
+
+  X = maf_mul(X, scale);
+  Y = maf_mul(Y, scale);
+  Z = maf_mul(Z, scale);
+  W = maf_mul(W, scale);
+
+  maf_store(m + 0, maf_shuffle(X, Y, 3, 1, 3, 1));
+  maf_store(m + 4, maf_shuffle(X, Y, 2, 0, 2, 0));
+  maf_store(m + 8, maf_shuffle(Z, W, 3, 1, 3, 1));
+  maf_store(m + 12, maf_shuffle(Z, W, 2, 0, 2, 0));
+  return m;
+#else
   float a00 = m[0], a01 = m[1], a02 = m[2], a03 = m[3],
         a10 = m[4], a11 = m[5], a12 = m[6], a13 = m[7],
         a20 = m[8], a21 = m[9], a22 = m[10], a23 = m[11],
@@ -444,10 +557,25 @@ MAF mat4 mat4_invert(mat4 m) {
   m[15] = (a20 * b03 - a21 * b01 + a22 * b00) * invDet;
 
   return m;
+#endif
 }
 
 // Calculate matrix equivalent to "apply n, then m"
 MAF mat4 mat4_mul(mat4 m, mat4 n) {
+#ifdef MAF_SIMD
+  maf_v4 c0 = maf_load(m + 0);
+  maf_v4 c1 = maf_load(m + 4);
+  maf_v4 c2 = maf_load(m + 8);
+  maf_v4 c3 = maf_load(m + 12);
+  for (int i = 0; i < 16; i += 4) {
+    maf_v4 column = maf_mul(c0, maf_splat(n[i + 0]));
+    column = maf_madd(column, c1, maf_splat(n[i + 1]));
+    column = maf_madd(column, c2, maf_splat(n[i + 2]));
+    column = maf_madd(column, c3, maf_splat(n[i + 3]));
+    maf_store(m + i, column);
+  }
+  return m;
+#else
   float m00 = m[0], m01 = m[1], m02 = m[2], m03 = m[3],
         m10 = m[4], m11 = m[5], m12 = m[6], m13 = m[7],
         m20 = m[8], m21 = m[9], m22 = m[10], m23 = m[11],
@@ -475,9 +603,23 @@ MAF mat4 mat4_mul(mat4 m, mat4 n) {
   m[14] = n30 * m02 + n31 * m12 + n32 * m22 + n33 * m32;
   m[15] = n30 * m03 + n31 * m13 + n32 * m23 + n33 * m33;
   return m;
+#endif
+}
+
+#ifdef MAF_SIMD
+// Multiplies the upper 3 columns by a vector, the callers decide what to do with the last one
+MAF maf_v4 maf_transform3(mat4 m, float* v) {
+  maf_v4 result = maf_mul(maf_load(m + 0), maf_splat(v[0]));
+  result = maf_madd(result, maf_load(m + 4), maf_splat(v[1]));
+  return maf_madd(result, maf_load(m + 8), maf_splat(v[2]));
 }
+#endif
 
 MAF float* mat4_mulVec4(mat4 m, float* v) {
+#ifdef MAF_SIMD
+  maf_store(v, maf_madd(maf_transform3(m, v), maf_load(m + 12), maf_splat(v[3])));
+  return v;
+#else
   float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + v[3] * m[12];
   float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + v[3] * m[13];
   float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + v[3] * m[14];
@@ -487,6 +629,7 @@ MAF float* mat4_mulVec4(mat4 m, float* v) {
   v[2] = z;
   v[3] = w;
   return v;
+#endif
 }
 
 MAF mat4 mat4_translate(mat4 m, float x, float y, float z) {
@@ -497,9 +640,30 @@ MAF mat4 mat4_translate(mat4 m, float x, float y, float z) {
   return m;
 }
 
+// Rotations leave the translation column alone, so only the upper 3x3 gets multiplied
 MAF mat4 mat4_rotateQuat(mat4 m, quat q) {
   float n[16];
-  return mat4_mul(m, mat4_fromQuat(n, q));
+  mat4_fromQuat(n, q);
+#ifdef MAF_SIMD
+  maf_v4 c0 = maf_load(m + 0);
+  maf_v4 c1 = maf_load(m + 4);
+  maf_v4 c2 = maf_load(m + 8);
+  for (int i = 0; i < 12; i += 4) {
+    maf_v4 column = maf_mul(c0, maf_splat(n[i + 0]));
+    column = maf_madd(column, c1, maf_splat(n[i + 1]));
+    column = maf_madd(column, c2, maf_splat(n[i + 2]));
+    maf_store(m + i, column);
+  }
+#else
+  float c[12];
+  for (int i = 0; i < 12; i++) c[i] = m[i];
+  for (int i = 0; i < 12; i += 4) {
+    for (int j = 0; j < 4; j++) {
+      m[i + j] = c[j] * n[i + 0] + c[4 + j] * n[i + 1] + c[8 + j] * n[i + 2];
+    }
+  }
+#endif
+  return m;
 }
 
 MAF mat4 mat4_rotate(mat4 m, float angle, float x, float y, float z) {
@@ -686,6 +850,14 @@ MAF mat4 mat4_target(mat4 m, vec3 from, vec3 to, vec3 up) {
 // Apply matrix to a vec3
 // Difference from mat4_mulVec4: w normalize is performed, w in vec3 is ignored
 MAF void mat4_transform(mat4 m, vec3 v) {
+#ifdef MAF_SIMD
+  float r[4];
+  maf_store(r, maf_add(maf_transform3(m, v), maf_load(m + 12)));
+  v[0] = r[0] / r[3];
+  v[1] = r[1] / r[3];
+  v[2] = r[2] / r[3];
+  v[3] = r[3] / r[3];
+#else
   float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8] + m[12];
   float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9] + m[13];
   float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10] + m[14];
@@ -694,9 +866,13 @@ MAF void mat4_transform(mat4 m, vec3 v) {
   v[1] = y / w;
   v[2] = z / w;
   v[3] = w / w;
+#endif
 }
 
 MAF void mat4_transformDirection(mat4 m, vec3 v) {
+#ifdef MAF_SIMD
+  maf_store(v, maf_transform3(m, v));
+#else
   float x = v[0] * m[0] + v[1] * m[4] + v[2] * m[8];
   float y = v[0] * m[1] + v[1] * m[5] + v[2] * m[9];
   float z = v[0] * m[2] + v[1] * m[6] + v[2] * m[10];
@@ -705,4 +881,5 @@ MAF void mat4_transformDirection(mat4 m, vec3 v) {
   v[1] = y;
   v[2] = z;
   v[3] = w;
+#endif
 }
@@ -3,6 +3,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+// Robin hood hashing: an insert takes the slot of any entry that is closer to its home slot than
+// the new entry is, and keeps going with the displaced entry instead.  This evens out probe lengths
+// at high load and lets lookups stop as soon as they pass an entry closer to home than the key would
+// be.  Removal shifts the following entries back by one, so there are no tombstones.
+
 static uint32_t prevpo2(uint32_t x) {
   x |= x >> 1;
   x |= x >> 2;
@@ -12,89 +17,128 @@ static uint32_t prevpo2(uint32_t x) {
   return x - (x >> 1);
 }
 
-static void map_rehash(map_t* map) {
+static void map_insert(map_t* map, uint64_t hash, uint64_t value) {
+  uint64_t mask = map->size - 1;
+  uint64_t h = hash & mask;
+
+  for (uint64_t distance = 0;; distance++, h = (h + 1) & mask) {
+    uint64_t x = map->hashes[h];
+
+    if (x == MAP_NIL) {
+      map->hashes[h] = hash;
+      map->values[h] = value;
+      map->used++;
+      return;
+    }
+
+    uint64_t d = (h - x) & mask;
+    if (d < distance) {
+      map->hashes[h] = hash;
+      hash = x;
+      x = map->values[h];
+      map->values[h] = value;
+      value = x;
+      distance = d;
+    }
+  }
+}
+
+static void map_rehash(map_t* map, uint32_t size) {
   map_t old = *map;
-  map->size <<= 1;
+  map->size = size;
+  map->used = 0;
   map->hashes = malloc(2 * map->size * sizeof(uint64_t));
   map->values = map->hashes + map->size;
   lovrAssert(map->size && map->hashes, "Out of memory");
   memset(map->hashes, 0xff, 2 * map->size * sizeof(uint64_t));
 
   if (old.hashes) {
-    uint64_t mask = map->size - 1;
     for (uint32_t i = 0; i < old.size; i++) {
       if (old.hashes[i] != MAP_NIL) {
-        uint64_t index = old.hashes[i] & mask;
-        while (map->hashes[index] != MAP_NIL) {
-          index = (index + 1) & mask;
-        }
-        map->hashes[index] = old.hashes[i];
-        map->values[index] = old.values[i];
+        map_insert(map, old.hashes[i], old.values[i]);
       }
     }
     free(old.hashes);
   }
 }
 
+// Returns the slot holding the key, or MAP_NIL if it isn't in the map
 static inline uint64_t map_find(map_t* map, uint64_t hash) {
   uint64_t mask = map->size - 1;
   uint64_t h = hash & mask;
 
-  while (map->hashes[h] != hash && map->hashes[h] != MAP_NIL) {
-    h = (h + 1) & mask;
+  for (uint64_t distance = 0;; distance++, h = (h + 1) & mask) {
+    uint64_t x = map->hashes[h];
+    if (x == hash) {
+      return h;
+    } else if (x == MAP_NIL || ((h - x) & mask) < distance) {
+      return MAP_NIL;
+    }
   }
-
-  return h;
 }
 
 void map_init(map_t* map, uint32_t n) {
-  map->size = prevpo2(n) + !n;
+  map->size = 0;
   map->used = 0;
   map->hashes = NULL;
-  map_rehash(map);
+  map_rehash(map, 2 * (prevpo2(n) + !n));
 }
 
 void map_free(map_t* map) {
   free(map->hashes);
 }
 
+// Grows the map so it can hold n keys without rehashing
+void map_reserve(map_t* map, uint32_t n) {
+  uint32_t size = map->size;
+  while (n >= (size >> 1) + (size >> 2)) {
+    size <<= 1;
+  }
+
+  if (size > map->size) {
+    map_rehash(map, size);
+  }
+}
+
 uint64_t map_get(map_t* map, uint64_t hash) {
-  return map->values[map_find(map, hash)];
+  uint64_t h = map_find(map, hash);
+  return h == MAP_NIL ? MAP_NIL : map->values[h];
 }
 
 void map_set(map_t* map, uint64_t hash, uint64_t value) {
+  uint64_t h = map_find(map, hash);
+
+  if (h != MAP_NIL) {
+    map->values[h] = value;
+    return;
+  }
+
   if (map->used >= (map->size >> 1) + (map->size >> 2)) {
-    map_rehash(map);
+    map_rehash(map, map->size << 1);
   }
 
-  uint64_t h = map_find(map, hash);
-  map->used += map->hashes[h] == MAP_NIL;
-  map->hashes[h] = hash;
-  map->values[h] = value;
+  map_insert(map, hash, value);
 }
 
 void map_remove(map_t* map, uint64_t hash) {
   uint64_t h = map_find(map, hash);
 
-  if (map->hashes[h] == MAP_NIL) {
+  if (h == MAP_NIL) {
     return;
   }
 
   uint64_t mask = map->size - 1;
-  uint64_t i = h;
-
-  do {
-    i = (i + 1) & mask;
-    uint64_t x = map->hashes[i] & mask;
-    // Removing a key from an open-addressed hash table is complicated
-    if ((i > h && (x <= h || x > i)) || (i < h && (x <= h && x > i))) {
-      map->hashes[h] = map->hashes[i];
-      map->values[h] = map->values[i];
-      h = i;
-    }
-  } while (map->hashes[i] != MAP_NIL);
 
-  map->hashes[i] = MAP_NIL;
-  map->values[i] = MAP_NIL;
+  for (;;) {
+    uint64_t next = (h + 1) & mask;
+    uint64_t x = map->hashes[next];
+    if (x == MAP_NIL || ((next - x) & mask) == 0) break;
+    map->hashes[h] = x;
+    map->values[h] = map->values[next];
+    h = next;
+  }
+
+  map->hashes[h] = MAP_NIL;
+  map->values[h] = MAP_NIL;
   map->used--;
 }
@@ -10,6 +10,7 @@ typedef struct {
   bool fullscreen;
   bool resizable;
   bool debug;
+  bool headless; // Creates a context without a window, only supported with EGL on Linux
   int vsync;
   int msaa;
   const char* title;
@@ -128,6 +129,12 @@ typedef enum {
   OS_PERMISSION_AUDIO_CAPTURE
 } os_permission;
 
+typedef enum {
+  OS_THREAD_PRIORITY_LOW,
+  OS_THREAD_PRIORITY_NORMAL,
+  OS_THREAD_PRIORITY_HIGH
+} os_thread_priority;
+
 typedef void fn_gl_proc(void);
 typedef void fn_quit(void);
 typedef void fn_focus(bool focused);
@@ -145,6 +152,10 @@ double os_get_time(void);
 void os_sleep(double seconds);
 void os_request_permission(os_permission permission);
 
+// These change the calling thread.  An affinity of zero means any core.
+bool os_thread_set_affinity(uint64_t mask);
+bool os_thread_set_priority(os_thread_priority priority);
+
 void os_poll_events(void);
 void os_on_quit(fn_quit* callback);
 void os_on_focus(fn_focus* callback);
@@ -1,8 +1,12 @@
+#define _GNU_SOURCE
 #include "os.h"
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <pthread.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -190,6 +194,28 @@ uint32_t os_get_core_count() {
   return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+bool os_thread_set_affinity(uint64_t mask) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  uint32_t cores = os_get_core_count();
+  for (uint32_t i = 0; i < cores && i < 64; i++) {
+    if (mask == 0 || (mask & (1ull << i))) {
+      CPU_SET(i, &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// On Linux, niceness is per thread.  Raising the priority needs permission, so it can fail.
+bool os_thread_set_priority(os_thread_priority priority) {
+  static const int niceness[] = {
+    [OS_THREAD_PRIORITY_LOW] = 10,
+    [OS_THREAD_PRIORITY_NORMAL] = 0,
+    [OS_THREAD_PRIORITY_HIGH] = -10
+  };
+  return setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), niceness[priority]) == 0;
+}
+
 // To make regular printing work, a thread makes a pipe and redirects stdout and stderr to the write
 // end of the pipe.  The read end of the pipe is forwarded to __android_log_write.
 static struct {
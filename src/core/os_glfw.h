@@ -15,6 +15,8 @@
 #  ifdef LOVR_LINUX_EGL
 #    define EGL_NO_X11
 #    include <EGL/egl.h>
+#    include <EGL/eglext.h>
+#    include <string.h>
 #    define GLFW_EXPOSE_NATIVE_EGL
 #  endif
 #  ifdef LOVR_LINUX_X11
@@ -31,6 +33,14 @@ static struct {
   fn_resize* onWindowResize;
   fn_key* onKeyboardEvent;
   fn_text* onTextEvent;
+  bool headless;
+  int width;
+  int height;
+#ifdef LOVR_LINUX_EGL
+  EGLDisplay display;
+  EGLContext context;
+  EGLConfig config;
+#endif
 } glfwState;
 
 static void onError(int code, const char* description) {
@@ -190,6 +200,84 @@ static int convertKey(os_key key) {
   }
 }
 
+#ifdef LOVR_LINUX_EGL
+// Headless contexts don't have a window or a display server, rendering goes to Canvases.  This uses
+// Mesa's surfaceless platform when it's available (it works without a GPU too), falling back to the
+// default display, and needs EGL_KHR_surfaceless_context to make the context current.
+static bool openHeadless(const os_window_config* config) {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+  EGLDisplay display = EGL_NO_DISPLAY;
+
+  if (eglGetPlatformDisplayEXT) {
+    display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    return false;
+  }
+
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context") || !eglBindAPI(EGL_OPENGL_API)) {
+    eglTerminate(display);
+    return false;
+  }
+
+  // The surface type is a mask, zero matches configs without any kind of surface
+  const EGLint configAttributes[] = {
+    EGL_SURFACE_TYPE, 0,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_NONE
+  };
+
+  EGLConfig eglConfig;
+  EGLint configCount;
+  if (!eglChooseConfig(display, configAttributes, &eglConfig, 1, &configCount) || configCount == 0) {
+    eglTerminate(display);
+    return false;
+  }
+
+  const EGLint contextAttributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION, 3,
+    EGL_CONTEXT_MINOR_VERSION, 3,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_CONTEXT_OPENGL_DEBUG, config->debug ? EGL_TRUE : EGL_FALSE,
+    EGL_NONE
+  };
+
+  EGLContext context = eglCreateContext(display, eglConfig, EGL_NO_CONTEXT, contextAttributes);
+  if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    eglTerminate(display);
+    return false;
+  }
+
+  glfwState.headless = true;
+  glfwState.display = display;
+  glfwState.context = context;
+  glfwState.config = eglConfig;
+  glfwState.width = config->width ? config->width : 1080;
+  glfwState.height = config->height ? config->height : 600;
+  return true;
+}
+
+static void closeHeadless(void) {
+  if (glfwState.headless) {
+    eglMakeCurrent(glfwState.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(glfwState.display, glfwState.context);
+    eglTerminate(glfwState.display);
+    glfwState.headless = false;
+  }
+}
+#endif
+
 void os_poll_events() {
   if (glfwState.window) {
     glfwPollEvents();
@@ -197,10 +285,18 @@ void os_poll_events() {
 }
 
 bool os_window_open(const os_window_config* config) {
-  if (glfwState.window) {
+  if (glfwState.window || glfwState.headless) {
     return true;
   }
 
+  if (config->headless) {
+#ifdef LOVR_LINUX_EGL
+    return openHeadless(config);
+#else
+    return false;
+#endif
+  }
+
   glfwSetErrorCallback(onError);
 #ifdef __APPLE__
   glfwInitHint(GLFW_COCOA_CHDIR_RESOURCES, GLFW_FALSE);
@@ -262,12 +358,15 @@ bool os_window_open(const os_window_config* config) {
 }
 
 bool os_window_is_open() {
-  return glfwState.window;
+  return glfwState.window || glfwState.headless;
 }
 
 void os_window_get_size(int* width, int* height) {
   if (glfwState.window) {
     glfwGetWindowSize(glfwState.window, width, height);
+  } else if (glfwState.headless) {
+    *width = glfwState.width;
+    *height = glfwState.height;
   } else {
     if (*width) *width = 0;
     if (*height) *height = 0;
@@ -277,6 +376,9 @@ void os_window_get_size(int* width, int* height) {
 void os_window_get_fbsize(int* width, int* height) {
   if (glfwState.window) {
     glfwGetFramebufferSize(glfwState.window, width, height);
+  } else if (glfwState.headless) {
+    *width = glfwState.width;
+    *height = glfwState.height;
   } else {
     if (*width) *width = 0;
     if (*height) *height = 0;
@@ -284,6 +386,10 @@ void os_window_get_fbsize(int* width, int* height) {
 }
 
 void os_window_set_vsync(int interval) {
+  if (glfwState.headless) {
+    return;
+  }
+
 #if EMSCRIPTEN
   glfwSwapInterval(1);
 #else
@@ -292,10 +398,17 @@ void os_window_set_vsync(int interval) {
 }
 
 void os_window_swap() {
-  glfwSwapBuffers(glfwState.window);
+  if (glfwState.window) {
+    glfwSwapBuffers(glfwState.window);
+  }
 }
 
 fn_gl_proc* os_get_gl_proc_address(const char* function) {
+#ifdef LOVR_LINUX_EGL
+  if (glfwState.headless) {
+    return (fn_gl_proc*) eglGetProcAddress(function);
+  }
+#endif
   return (fn_gl_proc*) glfwGetProcAddress(function);
 }
 
@@ -354,18 +467,22 @@ HGLRC os_get_context() {
 
 #ifdef LOVR_LINUX_EGL
 PFNEGLGETPROCADDRESSPROC os_get_egl_proc_addr() {
-  return (PFNEGLGETPROCADDRESSPROC) glfwGetProcAddress;
+  return glfwState.headless ? eglGetProcAddress : (PFNEGLGETPROCADDRESSPROC) glfwGetProcAddress;
 }
 
 EGLDisplay os_get_egl_display() {
-  return glfwGetEGLDisplay();
+  return glfwState.headless ? glfwState.display : glfwGetEGLDisplay();
 }
 
 EGLContext os_get_egl_context() {
-  return glfwGetEGLContext(glfwState.window);
+  return glfwState.headless ? glfwState.context : glfwGetEGLContext(glfwState.window);
 }
 
 EGLConfig os_get_egl_config() {
+  if (glfwState.headless) {
+    return glfwState.config;
+  }
+
   EGLDisplay dpy = os_get_egl_display();
   EGLContext ctx = os_get_egl_context();
   EGLint cfg_id = -1;
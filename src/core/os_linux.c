@@ -1,7 +1,11 @@
+#define _GNU_SOURCE
 #include "os.h"
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <pwd.h>
@@ -15,6 +19,9 @@ bool os_init() {
 }
 
 void os_destroy() {
+#ifdef LOVR_LINUX_EGL
+  closeHeadless();
+#endif
   glfwTerminate();
 }
 
@@ -26,6 +33,28 @@ uint32_t os_get_core_count() {
   return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+bool os_thread_set_affinity(uint64_t mask) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  uint32_t cores = os_get_core_count();
+  for (uint32_t i = 0; i < cores && i < 64; i++) {
+    if (mask == 0 || (mask & (1ull << i))) {
+      CPU_SET(i, &set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// On Linux, niceness is per thread.  Raising the priority needs permission, so it can fail.
+bool os_thread_set_priority(os_thread_priority priority) {
+  static const int niceness[] = {
+    [OS_THREAD_PRIORITY_LOW] = 10,
+    [OS_THREAD_PRIORITY_NORMAL] = 0,
+    [OS_THREAD_PRIORITY_HIGH] = -10
+  };
+  return setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), niceness[priority]) == 0;
+}
+
 void os_open_console() {
   //
 }
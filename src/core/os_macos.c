@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <pwd.h>
+#include <pthread.h>
 
 #include "os_glfw.h"
 
@@ -36,6 +37,21 @@ uint32_t os_get_core_count() {
   return count;
 }
 
+// macOS doesn't let threads pick cores, it only takes affinity tags as hints
+bool os_thread_set_affinity(uint64_t mask) {
+  return mask == 0;
+}
+
+// Quality of service classes decide both the priority and which cores a thread tends to run on
+bool os_thread_set_priority(os_thread_priority priority) {
+  static const qos_class_t classes[] = {
+    [OS_THREAD_PRIORITY_LOW] = QOS_CLASS_UTILITY,
+    [OS_THREAD_PRIORITY_NORMAL] = QOS_CLASS_DEFAULT,
+    [OS_THREAD_PRIORITY_HIGH] = QOS_CLASS_USER_INTERACTIVE
+  };
+  return pthread_set_qos_class_self_np(classes[priority], 0) == 0;
+}
+
 void os_open_console() {
   //
 }
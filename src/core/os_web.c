@@ -214,6 +214,14 @@ uint32_t os_get_core_count() {
   return 1;
 }
 
+bool os_thread_set_affinity(uint64_t mask) {
+  return mask == 0;
+}
+
+bool os_thread_set_priority(os_thread_priority priority) {
+  return priority == OS_THREAD_PRIORITY_NORMAL;
+}
+
 void os_open_console() {
   //
 }
@@ -70,6 +70,26 @@ uint32_t os_get_core_count() {
   return info.dwNumberOfProcessors;
 }
 
+bool os_thread_set_affinity(uint64_t mask) {
+  if (mask == 0) {
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+      return false;
+    }
+    mask = processMask;
+  }
+  return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) mask) != 0;
+}
+
+bool os_thread_set_priority(os_thread_priority priority) {
+  static const int priorities[] = {
+    [OS_THREAD_PRIORITY_LOW] = THREAD_PRIORITY_BELOW_NORMAL,
+    [OS_THREAD_PRIORITY_NORMAL] = THREAD_PRIORITY_NORMAL,
+    [OS_THREAD_PRIORITY_HIGH] = THREAD_PRIORITY_HIGHEST
+  };
+  return SetThreadPriority(GetCurrentThread(), priorities[priority]);
+}
+
 void os_open_console() {
   if (!AttachConsole(ATTACH_PARENT_PROCESS)) {
     if (GetLastError() != ERROR_ACCESS_DENIED) {
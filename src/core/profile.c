@@ -0,0 +1,175 @@
+#include "profile.h"
+#include "os.h"
+#include "util.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+typedef struct {
+  const char* name;
+  double start;
+  double end;
+  bool mark;
+} ProfileZone;
+
+// Only the owning thread writes to a ring.  Readers copy zones out and then check the head again,
+// dropping the zones that could have been overwritten in the meantime.  Rings are never freed since
+// their threads may still be holding on to them, and they're small compared to a thread's stack.
+typedef struct ProfileRing {
+  struct ProfileRing* next;
+  uint32_t thread;
+  atomic_ullong head;
+  ProfileZone zones[PROFILE_RING_SIZE];
+} ProfileRing;
+
+static struct {
+  atomic_bool enabled;
+  atomic_uintptr_t rings;
+  atomic_uint threadCount;
+} state;
+
+static LOVR_THREAD_LOCAL ProfileRing* ring;
+static LOVR_THREAD_LOCAL uint32_t depth;
+static LOVR_THREAD_LOCAL struct {
+  const char* name;
+  double start;
+} stack[PROFILE_MAX_DEPTH];
+
+static ProfileRing* getRing(void) {
+  if (!ring) {
+    ring = calloc(1, sizeof(ProfileRing));
+    if (!ring) return NULL;
+    ring->thread = atomic_fetch_add(&state.threadCount, 1);
+    uintptr_t next = atomic_load(&state.rings);
+    do {
+      ring->next = (ProfileRing*) next;
+    } while (!atomic_compare_exchange_weak(&state.rings, &next, (uintptr_t) ring));
+  }
+  return ring;
+}
+
+static void record(const char* name, double start, double end, bool mark) {
+  ProfileRing* r = getRing();
+  if (!r) return;
+  uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+  ProfileZone* zone = &r->zones[head & (PROFILE_RING_SIZE - 1)];
+  zone->name = name;
+  zone->start = start;
+  zone->end = end;
+  zone->mark = mark;
+  atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+void lovrProfileSetEnabled(bool enable) {
+  atomic_store(&state.enabled, enable);
+}
+
+bool lovrProfileIsEnabled() {
+  return atomic_load_explicit(&state.enabled, memory_order_relaxed);
+}
+
+// The depth is tracked even when profiling is disabled, so zones stay balanced when it gets toggled
+// in the middle of one
+void lovrProfileBegin(const char* name) {
+  uint32_t level = depth++;
+  if (level < PROFILE_MAX_DEPTH) {
+    bool enabled = atomic_load_explicit(&state.enabled, memory_order_relaxed);
+    stack[level].name = name;
+    stack[level].start = enabled ? os_get_time() : -1.;
+  }
+}
+
+void lovrProfileEnd() {
+  if (depth == 0) return;
+  uint32_t level = --depth;
+  if (level < PROFILE_MAX_DEPTH && stack[level].start >= 0. && atomic_load_explicit(&state.enabled, memory_order_relaxed)) {
+    record(stack[level].name, stack[level].start, os_get_time(), false);
+  }
+}
+
+// Marks are instants instead of zones, used for frame boundaries
+void lovrProfileMark(const char* name) {
+  if (atomic_load_explicit(&state.enabled, memory_order_relaxed)) {
+    double time = os_get_time();
+    record(name, time, time, true);
+  }
+}
+
+// Export
+
+typedef arr_t(char) Buffer;
+
+static void append(Buffer* buffer, const char* format, ...) {
+  char string[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(string, sizeof(string), format, args);
+  va_end(args);
+  if (length > 0) {
+    size_t n = MIN((size_t) length, sizeof(string) - 1);
+    arr_append(buffer, string, n);
+  }
+}
+
+static void appendName(Buffer* buffer, const char* name) {
+  arr_push(buffer, '"');
+  for (const char* c = name; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      arr_push(buffer, '\\');
+      arr_push(buffer, *c);
+    } else if ((unsigned char) *c < 0x20) {
+      append(buffer, "\\u%04x", *c);
+    } else {
+      arr_push(buffer, *c);
+    }
+  }
+  arr_push(buffer, '"');
+}
+
+// Writes the recorded zones of every thread as Chrome's trace event format (JSON), which can be
+// opened in chrome://tracing, Perfetto, or Tracy's importer.  The returned string has to be freed.
+char* lovrProfileExport(size_t* length) {
+  Buffer buffer;
+  arr_init(&buffer, realloc);
+  append(&buffer, "{\"traceEvents\":[");
+
+  ProfileZone* zones = malloc(PROFILE_RING_SIZE * sizeof(ProfileZone));
+  lovrAssert(zones, "Out of memory");
+
+  bool first = true;
+  for (ProfileRing* r = (ProfileRing*) atomic_load(&state.rings); r; r = r->next) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t start = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+
+    for (uint64_t i = start; i < head; i++) {
+      zones[i - start] = r->zones[i & (PROFILE_RING_SIZE - 1)];
+    }
+
+    // The slot being written when the copy finished is the oldest one that can't be trusted
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t newHead = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t valid = newHead >= PROFILE_RING_SIZE ? newHead - PROFILE_RING_SIZE + 1 : 0;
+
+    for (uint64_t i = MAX(start, valid); i < head; i++) {
+      ProfileZone* zone = &zones[i - start];
+      append(&buffer, first ? "{\"name\":" : ",{\"name\":");
+      appendName(&buffer, zone->name);
+      if (zone->mark) {
+        append(&buffer, ",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f", zone->start * 1e6);
+      } else {
+        append(&buffer, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", zone->start * 1e6, (zone->end - zone->start) * 1e6);
+      }
+      append(&buffer, ",\"pid\":1,\"tid\":%u}", r->thread);
+      first = false;
+    }
+  }
+
+  free(zones);
+  append(&buffer, "]}");
+  arr_push(&buffer, '\0');
+  *length = buffer.length - 1;
+  return buffer.data;
+}
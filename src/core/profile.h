@@ -0,0 +1,19 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+#pragma once
+
+// CPU profiler.  Zones are recorded into a ring buffer owned by the thread that recorded them, so
+// recording never takes a lock.  Only the last PROFILE_RING_SIZE zones of each thread are kept.
+// Zone names aren't copied and have to stay valid for as long as the profiler is in use.  An error
+// thrown inside of a zone leaves it open, which nests everything after it one level deeper.
+
+#define PROFILE_RING_SIZE 8192
+#define PROFILE_MAX_DEPTH 32
+
+void lovrProfileSetEnabled(bool enable);
+bool lovrProfileIsEnabled(void);
+void lovrProfileBegin(const char* name);
+void lovrProfileEnd(void);
+void lovrProfileMark(const char* name);
+char* lovrProfileExport(size_t* length);
@@ -1,5 +1,7 @@
 #include "util.h"
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdatomic.h>
 
@@ -47,16 +49,193 @@ void lovrLog(int level, const char* tag, const char* format, ...) {
 #error "Lock-free integer atomics are not supported on this platform, but are required for refcounting"
 #endif
 
+// The flag is read with a relaxed load, which is a plain load, so local objects never pay for an
+// atomic instruction.  Only their owning thread writes the count, so a plain store is enough too.
 void lovrRetain(void* object) {
   if (object) {
-    atomic_fetch_add((atomic_uint*) object, 1);
+    atomic_uint* ref = object;
+    uint32_t count = atomic_load_explicit(ref, memory_order_relaxed);
+    if (count & LOVR_REF_LOCAL) {
+      atomic_store_explicit(ref, count + 1, memory_order_relaxed);
+    } else {
+      atomic_fetch_add(ref, 1);
+    }
   }
 }
 
 void lovrRelease(void* object, void (*destructor)(void*)) {
-  if (object && atomic_fetch_sub((atomic_uint*) object, 1) == 1) {
-    destructor(object);
+  if (object) {
+    atomic_uint* ref = object;
+    uint32_t count = atomic_load_explicit(ref, memory_order_relaxed);
+    if (count & LOVR_REF_LOCAL) {
+      if (count == (LOVR_REF_LOCAL | 1)) {
+        destructor(object);
+      } else {
+        atomic_store_explicit(ref, count - 1, memory_order_relaxed);
+      }
+    } else if (atomic_fetch_sub(ref, 1) == 1) {
+      destructor(object);
+    }
+  }
+}
+
+void lovrShare(void* object) {
+  if (object) {
+    atomic_fetch_and((atomic_uint*) object, ~LOVR_REF_LOCAL);
+  }
+}
+
+// Temporary memory
+// Chunks are kept in a list.  When an allocation doesn't fit in the current chunk it moves on to the
+// next one, or inserts a chunk twice as big.  Rewinding moves back to an earlier chunk and leaves the
+// later ones as spares.  On reset, a list of several chunks is replaced with one chunk as big as all
+// of them together, so a thread settles on a single chunk that fits a whole frame.
+#define TEMP_ALIGN 16
+#define TEMP_HEADER ALIGN(sizeof(size_t), TEMP_ALIGN)
+#define TEMP_CHUNK_HEADER ALIGN(sizeof(TempChunk), TEMP_ALIGN)
+#define TEMP_MIN_CHUNK (64 << 10)
+#define TEMP_MAX_RETAINED (16 << 20)
+
+typedef struct TempChunk {
+  struct TempChunk* next;
+  size_t size;
+  size_t used;
+} TempChunk;
+
+typedef struct {
+  void (*callback)(void*);
+  void* userdata;
+} TempDefer;
+
+static LOVR_THREAD_LOCAL struct {
+  TempChunk* head;
+  TempChunk* current;
+  arr_t(TempDefer) deferred;
+} temp;
+
+static TempChunk* temp_chunk(size_t size) {
+  TempChunk* chunk = malloc(TEMP_CHUNK_HEADER + size);
+  lovrAssert(chunk, "Out of memory");
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+void* temp_alloc(size_t size) {
+  size_t need = TEMP_HEADER + ALIGN(size, TEMP_ALIGN);
+  TempChunk* chunk = temp.current;
+
+  if (!chunk || chunk->used + need > chunk->size) {
+    TempChunk* spare = chunk ? chunk->next : temp.head;
+    if (spare && spare->size >= need) {
+      chunk = spare;
+      chunk->used = 0;
+    } else {
+      size_t size = chunk ? chunk->size * 2 : TEMP_MIN_CHUNK;
+      TempChunk* fresh = temp_chunk(MAX(need, size));
+      fresh->next = spare;
+      if (chunk) {
+        chunk->next = fresh;
+      } else {
+        temp.head = fresh;
+      }
+      chunk = fresh;
+    }
+    temp.current = chunk;
+  }
+
+  char* block = (char*) chunk + TEMP_CHUNK_HEADER + chunk->used;
+  *(size_t*) block = size;
+  chunk->used += need;
+  return block + TEMP_HEADER;
+}
+
+// The most recent allocation can grow and shrink in place, anything else gets copied
+void* temp_realloc(void* data, size_t size) {
+  if (!data) {
+    return size > 0 ? temp_alloc(size) : NULL;
+  }
+
+  size_t* header = (size_t*) ((char*) data - TEMP_HEADER);
+  size_t old = ALIGN(*header, TEMP_ALIGN);
+  TempChunk* chunk = temp.current;
+  char* top = chunk ? (char*) chunk + TEMP_CHUNK_HEADER + chunk->used : NULL;
+  bool last = (char*) data + old == top;
+
+  if (size == 0) {
+    if (last) chunk->used -= TEMP_HEADER + old;
+    return NULL;
+  }
+
+  if (last && chunk->used - old + ALIGN(size, TEMP_ALIGN) <= chunk->size) {
+    chunk->used = chunk->used - old + ALIGN(size, TEMP_ALIGN);
+    *header = size;
+    return data;
+  }
+
+  void* copy = temp_alloc(size);
+  memcpy(copy, data, MIN(*header, size));
+  return copy;
+}
+
+temp_mark_t temp_mark() {
+  return (temp_mark_t) { temp.current, temp.current ? temp.current->used : 0 };
+}
+
+void temp_rewind(temp_mark_t mark) {
+  temp.current = mark.chunk;
+  if (temp.current) {
+    temp.current->used = mark.used;
+  }
+}
+
+void temp_defer(void (*callback)(void*), void* userdata) {
+  if (!temp.deferred.alloc) {
+    arr_init(&temp.deferred, realloc);
+  }
+  arr_push(&temp.deferred, ((TempDefer) { callback, userdata }));
+}
+
+static void temp_flush(void) {
+  for (size_t i = 0; i < temp.deferred.length; i++) {
+    temp.deferred.data[i].callback(temp.deferred.data[i].userdata);
+  }
+  arr_clear(&temp.deferred);
+}
+
+void temp_reset() {
+  temp_flush();
+
+  if (!temp.head) {
+    return;
+  }
+
+  if (temp.head->next || temp.head->size > TEMP_MAX_RETAINED) {
+    size_t total = 0;
+    for (TempChunk* chunk = temp.head; chunk;) {
+      TempChunk* next = chunk->next;
+      total += chunk->size;
+      free(chunk);
+      chunk = next;
+    }
+    temp.head = temp_chunk(MIN(total, TEMP_MAX_RETAINED));
+  }
+
+  temp.head->used = 0;
+  temp.current = temp.head;
+}
+
+// Threads call this before they exit
+void temp_free() {
+  temp_flush();
+  arr_free(&temp.deferred);
+  for (TempChunk* chunk = temp.head; chunk;) {
+    TempChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
   }
+  memset(&temp, 0, sizeof(temp));
 }
 
 // UTF-8
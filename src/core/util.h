@@ -56,8 +56,14 @@ static inline uint64_t hash64(const void* data, size_t length) {
 }
 
 // Refcounting
+// Objects created with a refcount of LOVR_REF_LOCAL | 1 belong to the thread that made them, and
+// their count changes without atomic read-modify-writes.  lovrShare turns an object into a regular
+// atomically counted one, and has to be called before another thread can get a reference to it.
+// Objects that a local object references are not shared along with it.
+#define LOVR_REF_LOCAL 0x80000000u
 void lovrRetain(void* ref);
 void lovrRelease(void* ref, void (*destructor)(void*));
+void lovrShare(void* ref);
 
 // Dynamic Array
 typedef void* arr_allocator(void* data, size_t size);
@@ -80,6 +86,21 @@ static inline void _arr_reserve(void** data, size_t n, size_t* capacity, size_t
   lovrAssert(*data, "Out of memory");
 }
 
+// Temporary memory
+// Each thread has a linear arena for allocations that don't outlive the frame.  Allocations are
+// never freed individually: temp_reset releases everything (lovr.timer.step does this on the thread
+// that calls it), and temp_rewind releases everything allocated since a mark.  temp_realloc can be
+// used as an arr_allocator.  Callbacks passed to temp_defer run at the next reset, before the memory
+// is reused, and are how things that point into the arena find out that it's gone.
+typedef struct { void* chunk; size_t used; } temp_mark_t;
+void* temp_alloc(size_t size);
+void* temp_realloc(void* data, size_t size);
+temp_mark_t temp_mark(void);
+void temp_rewind(temp_mark_t mark);
+void temp_defer(void (*callback)(void*), void* userdata);
+void temp_reset(void);
+void temp_free(void);
+
 // UTF-8
 size_t utf8_decode(const char *s, const char *e, unsigned *pch);
 void utf8_encode(uint32_t codepoint, char str[4]);
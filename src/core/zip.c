@@ -1,6 +1,11 @@
 #include "zip.h"
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef LOVR_USE_ZSTD
+#include <zstd.h>
+#endif
+
 static uint16_t readu16(const uint8_t* p) { uint16_t x; memcpy(&x, p, sizeof(x)); return x; }
 static uint32_t readu32(const uint8_t* p) { uint32_t x; memcpy(&x, p, sizeof(x)); return x; }
 
@@ -63,7 +68,7 @@ bool zip_next(zip_state* zip, zip_file* file) {
   return zip->cursor < zip->size;
 }
 
-void* zip_load(zip_state* zip, size_t offset, bool* compressed) {
+void* zip_load(zip_state* zip, size_t offset, uint16_t* method) {
   if (zip->size < 30 || offset > zip->size - 30) {
     return NULL;
   }
@@ -74,11 +79,509 @@ void* zip_load(zip_state* zip, size_t offset, bool* compressed) {
   }
 
   uint16_t compression = readu16(p + 8);
-  if (compression != 0 && compression != 8) {
-    return false;
+  switch (compression) {
+    case ZIP_STORE:
+    case ZIP_DEFLATE:
+    case ZIP_LZ4:
+#ifdef LOVR_USE_ZSTD
+    case ZIP_ZSTD:
+#endif
+      break;
+    default:
+      return NULL;
   }
 
-  *compressed = (compression == 8);
+  *method = compression;
   uint32_t skip = readu16(p + 26) + readu16(p + 28);
   return p + 30 + skip;
 }
+
+// Inflate
+//
+// Raw deflate decoder.  Bits are kept in a 64 bit buffer that gets refilled a word at a time, so a
+// whole literal or length/distance pair decodes with a single refill.  Codes short enough to fit in
+// a lookup table are decoded with one table read, longer (rare) codes are decoded canonically.
+
+#define FAST_BITS 11
+#define FAST_MASK ((1 << FAST_BITS) - 1)
+
+typedef struct {
+  const uint8_t* src;
+  const uint8_t* end;
+  uint64_t bits;
+  int count;
+} zip_bits;
+
+typedef struct {
+  uint16_t fast[1 << FAST_BITS]; // (symbol << 4) | length, or 0 if the code is longer than FAST_BITS
+  uint16_t counts[16];
+  uint16_t symbols[288];
+} zip_huffman;
+
+static const uint16_t lengthBase[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t lengthExtra[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distanceBase[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049,
+  3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t distanceExtra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Leaves at least 56 bits in the buffer, unless the input runs out (the missing bits read as zero
+// and the count goes negative when they're consumed, which gets caught as an error)
+static void refill(zip_bits* s) {
+  if (s->end - s->src >= 8) {
+    uint64_t word;
+    memcpy(&word, s->src, sizeof(word));
+    s->bits |= word << s->count;
+    s->src += (63 - s->count) >> 3;
+    s->count |= 56;
+  } else {
+    while (s->count <= 56 && s->src < s->end) {
+      s->bits |= (uint64_t) *s->src++ << s->count;
+      s->count += 8;
+    }
+  }
+}
+
+static uint32_t getbits(zip_bits* s, int n) {
+  uint32_t value = s->bits & ((1ull << n) - 1);
+  s->bits >>= n;
+  s->count -= n;
+  return value;
+}
+
+static bool huffman_build(zip_huffman* h, const uint8_t* lengths, uint32_t count) {
+  uint16_t offsets[16];
+  uint16_t codes[16];
+
+  memset(h->counts, 0, sizeof(h->counts));
+  for (uint32_t i = 0; i < count; i++) {
+    h->counts[lengths[i]]++;
+  }
+  h->counts[0] = 0;
+
+  int left = 1;
+  uint16_t code = 0;
+  offsets[1] = 0;
+  for (uint32_t i = 1; i < 16; i++) {
+    left = (left << 1) - h->counts[i];
+    if (left < 0) {
+      return false; // Oversubscribed
+    }
+
+    codes[i] = code;
+    code = (code + h->counts[i]) << 1;
+    if (i < 15) offsets[i + 1] = offsets[i] + h->counts[i];
+  }
+
+  memset(h->fast, 0, sizeof(h->fast));
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t length = lengths[i];
+    if (length == 0) continue;
+    h->symbols[offsets[length]++] = i;
+
+    uint32_t c = codes[length]++;
+    if (length <= FAST_BITS) {
+      uint32_t reversed = 0;
+      for (uint32_t j = 0; j < length; j++) {
+        reversed |= ((c >> j) & 1) << (length - 1 - j);
+      }
+
+      for (uint32_t j = reversed; j < (1 << FAST_BITS); j += (1 << length)) {
+        h->fast[j] = (i << 4) | length;
+      }
+    }
+  }
+
+  return true;
+}
+
+static inline int huffman_decode(zip_bits* s, const zip_huffman* h) {
+  uint16_t entry = h->fast[s->bits & FAST_MASK];
+  if (entry) {
+    s->bits >>= entry & 15;
+    s->count -= entry & 15;
+    return entry >> 4;
+  }
+
+  int code = 0;
+  int first = 0;
+  int index = 0;
+  for (int length = 1; length < 16; length++) {
+    code |= (s->bits >> (length - 1)) & 1;
+    int count = h->counts[length];
+    if (code - count < first) {
+      s->bits >>= length;
+      s->count -= length;
+      return h->symbols[index + (code - first)];
+    }
+    index += count;
+    first = (first + count) << 1;
+    code <<= 1;
+  }
+
+  return -1;
+}
+
+static bool inflate_codes(zip_bits* s, uint8_t* dst, size_t size, size_t* position, const zip_huffman* literals, const zip_huffman* distances) {
+  size_t p = *position;
+
+  for (;;) {
+    refill(s);
+
+    int symbol = huffman_decode(s, literals);
+
+    // A refill has room for 3 literals, so runs of literals decode without refilling every time
+    if (symbol < 256) {
+      if (symbol < 0 || p >= size) return false;
+      dst[p++] = symbol;
+
+      symbol = huffman_decode(s, literals);
+      if (symbol < 256) {
+        if (symbol < 0 || p >= size) return false;
+        dst[p++] = symbol;
+
+        symbol = huffman_decode(s, literals);
+        if (symbol < 256) {
+          if (symbol < 0 || p >= size) return false;
+          dst[p++] = symbol;
+          if (s->count < 0) return false;
+          continue;
+        }
+      }
+
+      // Length/distance pairs need a full buffer
+      refill(s);
+    }
+
+    if (symbol == 256) {
+      *position = p;
+      return s->count >= 0;
+    }
+
+    symbol -= 257;
+    if (symbol >= 29) return false;
+    size_t length = lengthBase[symbol] + getbits(s, lengthExtra[symbol]);
+
+    symbol = huffman_decode(s, distances);
+    if (symbol < 0 || symbol >= 30) return false;
+    size_t distance = distanceBase[symbol] + getbits(s, distanceExtra[symbol]);
+
+    if (s->count < 0 || distance > p || length > size - p) {
+      return false;
+    }
+
+    uint8_t* out = dst + p;
+    const uint8_t* in = out - distance;
+    p += length;
+
+    if (distance >= 8 && size - p >= 8) {
+      // Copies 8 bytes at a time, possibly writing past the end of the match (but not the buffer)
+      do {
+        memcpy(out, in, 8);
+        out += 8;
+        in += 8;
+      } while (out < dst + p);
+    } else if (distance == 1) {
+      memset(out, *in, length);
+    } else {
+      while (length--) *out++ = *in++;
+    }
+  }
+}
+
+static bool inflate_dynamic(zip_bits* s, zip_huffman* literals, zip_huffman* distances) {
+  static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+  uint8_t lengths[288 + 32];
+
+  refill(s);
+  uint32_t literalCount = getbits(s, 5) + 257;
+  uint32_t distanceCount = getbits(s, 5) + 1;
+  uint32_t codeCount = getbits(s, 4) + 4;
+
+  if (literalCount > 286 || distanceCount > 30) {
+    return false;
+  }
+
+  memset(lengths, 0, 19);
+  for (uint32_t i = 0; i < codeCount; i++) {
+    refill(s);
+    lengths[order[i]] = getbits(s, 3);
+  }
+
+  if (s->count < 0 || !huffman_build(literals, lengths, 19)) {
+    return false;
+  }
+
+  uint32_t total = literalCount + distanceCount;
+  for (uint32_t i = 0; i < total;) {
+    refill(s);
+    int symbol = huffman_decode(s, literals);
+
+    if (symbol < 0) {
+      return false;
+    } else if (symbol < 16) {
+      lengths[i++] = symbol;
+    } else {
+      uint8_t value = 0;
+      uint32_t repeat;
+      if (symbol == 16) {
+        if (i == 0) return false;
+        value = lengths[i - 1];
+        repeat = 3 + getbits(s, 2);
+      } else if (symbol == 17) {
+        repeat = 3 + getbits(s, 3);
+      } else {
+        repeat = 11 + getbits(s, 7);
+      }
+
+      if (repeat > total - i) return false;
+      memset(lengths + i, value, repeat);
+      i += repeat;
+    }
+
+    if (s->count < 0) return false;
+  }
+
+  if (lengths[256] == 0) {
+    return false;
+  }
+
+  return huffman_build(literals, lengths, literalCount) && huffman_build(distances, lengths + literalCount, distanceCount);
+}
+
+bool zip_inflate(void* dst, size_t dstSize, const void* src, size_t srcSize) {
+  zip_bits s = { .src = src, .end = (const uint8_t*) src + srcSize };
+  zip_huffman literals, distances;
+  size_t position = 0;
+  bool last;
+
+  do {
+    refill(&s);
+    last = getbits(&s, 1);
+    uint32_t type = getbits(&s, 2);
+
+    if (s.count < 0) {
+      return false;
+    }
+
+    if (type == 0) {
+      // Stored blocks start on a byte boundary, so return the buffered bytes to the input
+      getbits(&s, s.count & 7);
+      s.src -= s.count >> 3;
+      s.bits = 0;
+      s.count = 0;
+
+      if (s.end - s.src < 4) return false;
+      uint16_t length = readu16(s.src);
+      uint16_t check = readu16(s.src + 2);
+      s.src += 4;
+
+      if (length != (uint16_t) ~check || length > (size_t) (s.end - s.src) || length > dstSize - position) {
+        return false;
+      }
+
+      memcpy((uint8_t*) dst + position, s.src, length);
+      position += length;
+      s.src += length;
+    } else if (type == 1) {
+      uint8_t lengths[288 + 32];
+      memset(lengths, 8, 144);
+      memset(lengths + 144, 9, 112);
+      memset(lengths + 256, 7, 24);
+      memset(lengths + 280, 8, 8);
+      memset(lengths + 288, 5, 32);
+      huffman_build(&literals, lengths, 288);
+      huffman_build(&distances, lengths + 288, 32);
+      if (!inflate_codes(&s, dst, dstSize, &position, &literals, &distances)) {
+        return false;
+      }
+    } else if (type == 2) {
+      if (!inflate_dynamic(&s, &literals, &distances)) {
+        return false;
+      }
+
+      if (!inflate_codes(&s, dst, dstSize, &position, &literals, &distances)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  } while (!last);
+
+  return position == dstSize;
+}
+
+// LZ4
+//
+// Entries hold a single raw LZ4 block (no frame), the sizes come from the zip headers.
+
+bool zip_lz4_decode(void* dst, size_t dstSize, const void* src, size_t srcSize) {
+  const uint8_t* in = src;
+  const uint8_t* end = in + srcSize;
+  uint8_t* out = dst;
+  uint8_t* limit = out + dstSize;
+
+  while (in < end) {
+    uint8_t token = *in++;
+
+    size_t length = token >> 4;
+    if (length == 15) {
+      uint8_t byte;
+      do {
+        if (in >= end) return false;
+        byte = *in++;
+        length += byte;
+      } while (byte == 255);
+    }
+
+    if (length > (size_t) (end - in) || length > (size_t) (limit - out)) {
+      return false;
+    }
+
+    memcpy(out, in, length);
+    out += length;
+    in += length;
+
+    // The last sequence only has literals
+    if (in == end) {
+      break;
+    }
+
+    if (end - in < 2) return false;
+    size_t distance = readu16(in);
+    in += 2;
+
+    length = (token & 15) + 4;
+    if ((token & 15) == 15) {
+      uint8_t byte;
+      do {
+        if (in >= end) return false;
+        byte = *in++;
+        length += byte;
+      } while (byte == 255);
+    }
+
+    if (distance == 0 || distance > (size_t) (out - (uint8_t*) dst) || length > (size_t) (limit - out)) {
+      return false;
+    }
+
+    const uint8_t* match = out - distance;
+    if (distance >= 8 && limit - (out + length) >= 8) {
+      uint8_t* copyEnd = out + length;
+      do {
+        memcpy(out, match, 8);
+        out += 8;
+        match += 8;
+      } while (out < copyEnd);
+      out = copyEnd;
+    } else {
+      while (length--) *out++ = *match++;
+    }
+  }
+
+  return out == limit;
+}
+
+size_t zip_lz4_bound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+// Greedy compressor with a hash table of 4 byte sequences, used for offline packing.  Returns 0 if
+// it runs out of memory.  dst needs to hold zip_lz4_bound(size) bytes.
+size_t zip_lz4_encode(void* dst, const void* src, size_t size) {
+  enum { HASH_BITS = 16, MIN_MATCH = 4, LAST_LITERALS = 5, MATCH_LIMIT = 12 };
+  const uint8_t* in = src;
+  const uint8_t* anchor = in;
+  const uint8_t* p = in;
+  uint8_t* out = dst;
+
+  uint32_t* table = malloc((1 << HASH_BITS) * sizeof(uint32_t));
+  if (!table) return 0;
+  memset(table, 0xff, (1 << HASH_BITS) * sizeof(uint32_t));
+
+  if (size >= MATCH_LIMIT) {
+    const uint8_t* matchLimit = in + size - MATCH_LIMIT;
+    const uint8_t* end = in + size - LAST_LITERALS;
+
+    while (p < matchLimit) {
+      uint32_t sequence = readu32(p);
+      uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+      uint32_t candidate = table[hash];
+      table[hash] = (uint32_t) (p - in);
+
+      if (candidate == ~0u || p - (in + candidate) > 65535 || readu32(in + candidate) != sequence) {
+        p++;
+        continue;
+      }
+
+      const uint8_t* match = in + candidate;
+      const uint8_t* q = p + MIN_MATCH;
+      const uint8_t* m = match + MIN_MATCH;
+      while (q < end && *q == *m) q++, m++;
+
+      size_t literals = p - anchor;
+      size_t length = q - p - MIN_MATCH;
+      uint8_t* token = out++;
+      *token = (uint8_t) ((literals >= 15 ? 15 : literals) << 4);
+      if (literals >= 15) {
+        size_t n = literals - 15;
+        for (; n >= 255; n -= 255) *out++ = 255;
+        *out++ = (uint8_t) n;
+      }
+      memcpy(out, anchor, literals);
+      out += literals;
+
+      uint16_t distance = (uint16_t) (p - match);
+      memcpy(out, &distance, sizeof(distance));
+      out += 2;
+
+      *token |= (uint8_t) (length >= 15 ? 15 : length);
+      if (length >= 15) {
+        size_t n = length - 15;
+        for (; n >= 255; n -= 255) *out++ = 255;
+        *out++ = (uint8_t) n;
+      }
+
+      p = anchor = q;
+    }
+  }
+
+  free(table);
+
+  size_t literals = in + size - anchor;
+  *out++ = (uint8_t) ((literals >= 15 ? 15 : literals) << 4);
+  if (literals >= 15) {
+    size_t n = literals - 15;
+    for (; n >= 255; n -= 255) *out++ = 255;
+    *out++ = (uint8_t) n;
+  }
+  memcpy(out, anchor, literals);
+  out += literals;
+
+  return out - (uint8_t*) dst;
+}
+
+bool zip_decompress(uint16_t method, void* dst, size_t dstSize, const void* src, size_t srcSize) {
+  switch (method) {
+    case ZIP_STORE:
+      if (srcSize != dstSize) return false;
+      memcpy(dst, src, dstSize);
+      return true;
+    case ZIP_DEFLATE: return zip_inflate(dst, dstSize, src, srcSize);
+    case ZIP_LZ4: return zip_lz4_decode(dst, dstSize, src, srcSize);
+#ifdef LOVR_USE_ZSTD
+    case ZIP_ZSTD: return ZSTD_decompress(dst, dstSize, src, srcSize) == dstSize;
+#endif
+    default: return false;
+  }
+}
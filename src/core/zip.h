@@ -6,13 +6,21 @@
 //  - Little endian only
 //  - Zip64 is not supported
 //  - Self-extracting archives are supported
-//  - Supports store and deflate compression
+//  - Supports store, deflate, and LZ4 compression (zstd when built with LOVR_USE_ZSTD)
 //  - No comment allowed at the end of archive (file comments are okay)
 //  - No multi-disk archives
 //  - No encryption
 
 #pragma once
 
+// LZ4 doesn't have a method number in the zip spec, this one is only written by lovr-pack
+typedef enum {
+  ZIP_STORE = 0,
+  ZIP_DEFLATE = 8,
+  ZIP_ZSTD = 93,
+  ZIP_LZ4 = 0x4c34
+} zip_method;
+
 typedef struct {
   uint8_t* data;
   size_t size;
@@ -33,4 +41,9 @@ typedef struct {
 
 bool zip_open(zip_state* zip);
 bool zip_next(zip_state* zip, zip_file* info);
-void* zip_load(zip_state* zip, size_t offset, bool* compressed);
+void* zip_load(zip_state* zip, size_t offset, uint16_t* method);
+bool zip_decompress(uint16_t method, void* dst, size_t dstSize, const void* src, size_t srcSize);
+bool zip_inflate(void* dst, size_t dstSize, const void* src, size_t srcSize);
+bool zip_lz4_decode(void* dst, size_t dstSize, const void* src, size_t srcSize);
+size_t zip_lz4_bound(size_t size);
+size_t zip_lz4_encode(void* dst, const void* src, size_t size);
@@ -92,20 +92,20 @@ typedef uintmax_t atomic_uintmax_t;
 
 // 7.17.7
 
-#define atomic_store(p, x) __atomic_store(p, x, __ATOMIC_SEQ_CST)
-#define atomic_store_explicit __atomic_store
+#define atomic_store(p, x) __atomic_store_n(p, x, __ATOMIC_SEQ_CST)
+#define atomic_store_explicit __atomic_store_n
 
-#define atomic_load(p, x) __atomic_load(p, x, __ATOMIC_SEQ_CST)
-#define atomic_load_explicit __atomic_load
+#define atomic_load(p) __atomic_load_n(p, __ATOMIC_SEQ_CST)
+#define atomic_load_explicit __atomic_load_n
 
-#define atomic_exchange(p, x) __atomic_exchange(p, x, __ATOMIC_SEQ_CST)
-#define atomic_exchange_explicit __atomic_exchange
+#define atomic_exchange(p, x) __atomic_exchange_n(p, x, __ATOMIC_SEQ_CST)
+#define atomic_exchange_explicit __atomic_exchange_n
 
-#define atomic_compare_exchange_strong(p, x, y) __atomic_compare_exchange(p, x, y, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
-#define atomic_compare_exchange_strong_explicit(p, x, y, o1, o2) __atomic_compare_exchange(p, x, y, false, o1, o2)
+#define atomic_compare_exchange_strong(p, x, y) __atomic_compare_exchange_n(p, x, y, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define atomic_compare_exchange_strong_explicit(p, x, y, o1, o2) __atomic_compare_exchange_n(p, x, y, false, o1, o2)
 
-#define atomic_compare_exchange_weak(p, x, y) __atomic_compare_exchange(p, x, y, true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
-#define atomic_compare_exchange_weak_explicit(p, x, y, o1, o2) __atomic_compare_exchange(p, x, y, true, o1, o2)
+#define atomic_compare_exchange_weak(p, x, y) __atomic_compare_exchange_n(p, x, y, true, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+#define atomic_compare_exchange_weak_explicit(p, x, y, o1, o2) __atomic_compare_exchange_n(p, x, y, true, o1, o2)
 
 #define atomic_fetch_add(p, x) __atomic_fetch_add(p, x, __ATOMIC_SEQ_CST)
 #define atomic_fetch_add_explicit __atomic_fetch_add
@@ -147,6 +147,49 @@ typedef unsigned int atomic_uint;
 
 #define atomic_fetch_add(p, x) _InterlockedExchangeAdd(p, x)
 #define atomic_fetch_sub(p, x) _InterlockedExchangeAdd(p, -(x))
+#define atomic_fetch_add_explicit(p, x, o) _InterlockedExchangeAdd((volatile long*) (p), (long) (x))
+#define atomic_fetch_sub_explicit(p, x, o) _InterlockedExchangeAdd((volatile long*) (p), -(long) (x))
+#define atomic_fetch_and(p, x) ((unsigned int) _InterlockedAnd((volatile long*) (p), (long) (x)))
+#define atomic_fetch_and_explicit(p, x, o) atomic_fetch_and(p, x)
+
+// Interlocked functions are full barriers, so the memory orders are ignored
+
+typedef enum memory_order {
+  memory_order_relaxed,
+  memory_order_consume,
+  memory_order_acquire,
+  memory_order_release,
+  memory_order_acq_rel,
+  memory_order_seq_cst
+} memory_order;
+
+// Aligned 32 bit loads and stores are already atomic, so relaxed ones are plain volatile accesses
+#define atomic_load(p) ((unsigned int) _InterlockedOr((volatile long*) (p), 0))
+#define atomic_load_explicit(p, o) ((o) == memory_order_relaxed ? *(volatile unsigned int*) (p) : atomic_load(p))
+#define atomic_store(p, x) _InterlockedExchange((volatile long*) (p), (long) (x))
+#define atomic_store_explicit(p, x, o) ((o) == memory_order_relaxed ? (void) (*(volatile unsigned int*) (p) = (x)) : (void) atomic_store(p, x))
+#define atomic_init(p, x) atomic_store(p, x)
+#define atomic_exchange(p, x) ((unsigned int) _InterlockedExchange((volatile long*) (p), (long) (x)))
+#define atomic_exchange_explicit(p, x, o) atomic_exchange(p, x)
+
+static __inline int atomic_compare_exchange_long(volatile long* p, long* expected, long desired) {
+  long previous = _InterlockedCompareExchange(p, desired, *expected);
+  if (previous == *expected) return 1;
+  *expected = previous;
+  return 0;
+}
+
+#define atomic_compare_exchange_strong(p, x, y) atomic_compare_exchange_long((volatile long*) (p), (long*) (x), (long) (y))
+#define atomic_compare_exchange_strong_explicit(p, x, y, o1, o2) atomic_compare_exchange_strong(p, x, y)
+#define atomic_compare_exchange_weak(p, x, y) atomic_compare_exchange_strong(p, x, y)
+#define atomic_compare_exchange_weak_explicit(p, x, y, o1, o2) atomic_compare_exchange_strong(p, x, y)
+
+#define ATOMIC_FLAG_INIT { 0 }
+typedef struct atomic_flag { volatile long value; } atomic_flag;
+#define atomic_flag_test_and_set(p) (_InterlockedExchange(&(p)->value, 1) != 0)
+#define atomic_flag_test_and_set_explicit(p, o) atomic_flag_test_and_set(p)
+#define atomic_flag_clear(p) _InterlockedExchange(&(p)->value, 0)
+#define atomic_flag_clear_explicit(p, o) atomic_flag_clear(p)
 
 #define ATOMIC_INT_LOCK_FREE 2
 
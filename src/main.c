@@ -3,6 +3,9 @@
 #include "event/event.h"
 #include "core/os.h"
 #include "core/util.h"
+#ifndef LOVR_DISABLE_GRAPHICS
+#include "graphics/graphics.h"
+#endif
 #include <lua.h>
 #include <lauxlib.h>
 #include <lualib.h>
@@ -25,6 +28,15 @@ static void emscriptenLoop(void*);
 
 static Variant cookie;
 
+#ifndef LOVR_DISABLE_GRAPHICS
+static void onReplayError(void* userdata, const char* format, va_list args) {
+  fprintf(stderr, "Error: ");
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  exit(EXIT_FAILURE);
+}
+#endif
+
 int main(int argc, char** argv) {
   if (argc > 1 && (!strcmp(argv[1], "--version") || !strcmp(argv[1], "-v"))) {
     os_open_console();
@@ -37,6 +49,17 @@ int main(int argc, char** argv) {
   int status;
   bool restart;
 
+#ifndef LOVR_DISABLE_GRAPHICS
+  // lovr --replay trace.bin [loops] plays back a trace from lovr.graphics.stopTrace, without Lua
+  if (argc > 2 && !strcmp(argv[1], "--replay")) {
+    os_open_console();
+    lovrSetErrorCallback(onReplayError, NULL);
+    status = lovrGraphicsReplay(argv[2], argc > 3 ? (uint32_t) strtoul(argv[3], NULL, 10) : 1);
+    os_destroy();
+    return status;
+  }
+#endif
+
   do {
     lua_State* L = luaL_newstate();
     luax_setmainthread(L);
@@ -97,6 +120,7 @@ int main(int argc, char** argv) {
       memset(&cookie.value, 0, sizeof(cookie.value));
     }
     lua_close(L);
+    temp_free();
   } while (restart);
 
   os_destroy();
@@ -112,6 +136,7 @@ void lovrDestroy(void* arg) {
     lua_State* L = context->L;
     emscripten_cancel_main_loop();
     lua_close(L);
+    temp_free();
     os_destroy();
   }
 }
@@ -130,6 +155,7 @@ static void emscriptenLoop(void* arg) {
     }
 
     lua_close(context->L);
+    temp_free();
     emscripten_cancel_main_loop();
 
     if (restart) {
@@ -1,9 +1,16 @@
 #include "audio/audio.h"
 #include "audio/spatializer.h"
+#include "audio/mix.h"
 #include "data/sound.h"
 #include "core/maf.h"
+#include "core/os.h"
+#include "core/profile.h"
 #include "core/util.h"
 #include "lib/miniaudio/miniaudio.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#endif
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
@@ -14,46 +21,264 @@
 #define CTZL __builtin_ctzl
 #endif
 
-#define FOREACH_SOURCE(s) for (uint64_t m = state.sourceMask; s = m ? state.sources[CTZL(m)] : NULL, m; m ^= (m & -m))
+#define FOREACH_VOICE(s) for (uint64_t m = state.voiceMask; s = m ? state.voices[CTZL(m)] : NULL, m; m ^= (m & -m))
 #define OUTPUT_FORMAT SAMPLE_F32
 #define OUTPUT_CHANNELS 2
+#define COMMAND_QUEUE_SIZE 256
+#define DECODE_AHEAD 4 // Compressed Sounds are decoded 1/4 of a second ahead
+#define VOICES_PER_JOB MAX_SPATIALIZER_BATCH
+#define MAX_MIX_THREADS 8
+
+// The audio thread never takes a lock.  Changes made on other threads are sent to it through a
+// single-producer single-consumer command queue, which it drains at the start of each callback.
+// Source parameters are double buffered: params[0] belongs to the game thread and params[1] is the
+// copy the mixer (and the spatializer) reads.  The game thread also owns the allocation of mixer
+// slots, so it can tell whether a Source will fit without asking the audio thread.
+//
+// There can be many more playing Sources than voices.  Each buffer, the voices go to the playing
+// Sources with the highest priority, then the loudest ones.  The rest are virtual: their playback
+// position keeps advancing, but they aren't decoded, spatialized, or mixed.
+//
+// Compressed Sounds are decoded on a separate thread, where each Source has its own decoder and a
+// ring buffer of decoded frames that the mixer reads from.  When the mixer needs the ring to start
+// somewhere else (seeks, rewinds), it bumps the Source's seek request and stops reading the ring
+// until the decoder thread has refilled it from the new offset and acknowledged the request.
+//
+// Full spatializers (HRTFs) are expensive, so only the most important voices get them, up to the
+// spatializer voice limit.  The rest are panned and attenuated by the simple spatializer.  Voices
+// crossfade between the two over a few buffers when they move across the limit.
+//
+// Voices are mixed into Buses, which mix into their parent Bus (or the output) with their own
+// volume and effects.  Each buffer, the voices are split into jobs of up to VOICES_PER_JOB voices
+// from the same Bus.  Jobs don't share any state, so when there are mixing threads they run in
+// parallel, with the audio thread taking jobs too.  Then the audio thread sums the jobs into their
+// Buses and the Buses into each other, deepest first.  The only lock the audio thread touches is
+// the one it uses to wake sleeping mixing threads, which they only hold while going to sleep.
+//
+// Stats are kept by the thread doing the work and published with relaxed atomic stores, so reading
+// them never blocks the audio thread.  Resets are requests that each thread serves on its own.
+
+typedef struct {
+  float volume;
+  float position[4];
+  float orientation[4];
+  float radius;
+  float dipoleWeight;
+  float dipolePower;
+  uint32_t bus; // Index, 0 is the output
+  int32_t priority;
+  uint8_t effects;
+  bool looping;
+  bool playing;
+} SourceParams;
 
 struct Source {
   uint32_t ref;
-  uint32_t index;
+  uint32_t index; // Voice, owned by the audio thread (~0u when virtual)
+  uint32_t entry; // Position in the audio thread's list of Sources
+  uint32_t slot; // Mixer slot, owned by the game thread
   Sound* sound;
+  Bus* bus;
   ma_data_converter* converter;
   intptr_t spatializerMemo;
   uint32_t offset;
+  atomic_uint cursor; // Copy of offset for lovrSourceTell
+  uint32_t generation; // Incremented on every play
+  atomic_uint finished; // Generation that last reached the end of its Sound
+  uint32_t playback; // Generation being mixed
+  float gain; // Volume the mixer is at, ramps to the volume parameter over each buffer
+  SourceParams params[2];
+  Sound* decoder; // Private copy of the Sound, used by the decoder thread
+  ma_pcm_rb* ring; // Decoded frames, NULL when the mixer reads the Sound directly
+  uint32_t decodeOffset; // Decoder thread
+  uint32_t seekServed; // Decoder thread
+  uint32_t seekSent; // Audio thread
+  atomic_uint seekRequest;
+  atomic_uint seekTarget;
+  atomic_uint seekDone;
+  bool stale; // Skipped while virtual, so the ring is behind
+  bool detailed; // Audio thread, whether the voice should get the full spatializer
+  float detail; // Audio thread, crossfade from panning (0) to the full spatializer (1)
+};
+
+struct Bus {
+  uint32_t ref;
+  uint32_t index;
+  Bus* parent;
   float volume;
-  float position[4];
-  float orientation[4];
-  float radius;
-  float dipoleWeight;
-  float dipolePower;
   uint8_t effects;
-  bool playing;
-  bool looping;
 };
 
+// The audio thread's copy of a Bus
+typedef struct {
+  uint32_t parent;
+  uint32_t depth;
+  float volume;
+  float gain; // Ramps to volume over each buffer, like Source gain
+  float level; // Product of the volumes up to the output, for scoring voices
+  uint8_t effects;
+  uint8_t mask; // Effects enabled on this Bus and all of its ancestors
+  bool used;
+  bool active; // Something was mixed into it this buffer
+} MixBus;
+
+typedef struct {
+  uint32_t bus;
+  uint32_t count;
+  Source* voices[VOICES_PER_JOB];
+  float output[BUFFER_SIZE * 2];
+} MixJob;
+
+typedef enum {
+  COMMAND_PLAY,
+  COMMAND_REMOVE,
+  COMMAND_SEEK,
+  COMMAND_PARAMS,
+  COMMAND_LISTENER,
+  COMMAND_ABSORPTION,
+  COMMAND_BUS
+} CommandType;
+
+typedef struct {
+  CommandType type;
+  Source* source;
+  uint32_t generation;
+  union {
+    SourceParams params;
+    uint32_t offset;
+    float pose[8];
+    float absorption[3];
+    struct {
+      uint32_t index;
+      uint32_t parent;
+      float volume;
+      uint8_t effects;
+      bool reset;
+    } bus;
+  };
+} Command;
+
+// A piece of the acoustic geometry that can be added and removed on its own
+typedef struct {
+  uint32_t id;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  AudioMaterial material;
+  float* vertices;
+  uint32_t* indices;
+} GeometryChunk;
+
 static struct {
   bool initialized;
-  ma_mutex lock;
   ma_context context;
   ma_device devices[2];
   Sound* sinks[2];
+  AudioCaptureCallback* captureCallback;
+  void* captureUserdata;
   Source* sources[MAX_SOURCES];
-  uint64_t sourceMask;
+  uint32_t sourceCount;
+  Source* voices[MAX_VOICES];
+  uint64_t voiceMask;
+  uint32_t voiceLimit;
+  atomic_uint detailLimit; // Voices that get the full spatializer
+  bool panning; // The full spatializer isn't the simple one, so panning is a cheaper fallback
+  float scores[MAX_SOURCES];
+  float ranks[MAX_SOURCES];
+  float listener[4];
+  Source* owners[MAX_SOURCES];
+  uint64_t slots[MAX_SOURCES / 64];
+  uint32_t endings;
+  atomic_uint finished;
   float position[4];
   float orientation[4];
   Spatializer* spatializer;
   uint32_t leftoverOffset;
   uint32_t leftoverFrames;
   float leftovers[BUFFER_SIZE * 2];
-  float absorption[3];
+  uint32_t blockSize; // Frames mixed at a time, at most BUFFER_SIZE
+  float absorption[2][3];
   ma_data_converter playbackConverter;
+  bool playbackResample; // The playback sink is at a different rate and needs the converter
+  atomic_flag commandLock;
+  atomic_flag geometryLock;
+  arr_t(GeometryChunk) geometry;
+  uint32_t geometryId;
+  uint32_t geometryVersion; // Bumped whenever the chunks change
+  uint32_t geometryBuilt; // The last version that was built (or failed to build)
+  atomic_uint head;
+  atomic_uint tail;
+  Command commands[COMMAND_QUEUE_SIZE];
+  atomic_flag busLock;
+  uint64_t busMask; // Game thread (but Buses can be destroyed anywhere, so it's behind busLock)
+  MixBus buses[MAX_BUSES];
+  uint32_t busOrder[MAX_BUSES]; // Deepest first
+  uint32_t busCount;
+  bool busesChanged;
+  float busBuffers[MAX_BUSES][BUFFER_SIZE * 2];
+  MixJob jobs[MAX_VOICES];
+  uint32_t jobCount;
+  bool spatialize;
+  atomic_flag spatializerLock;
+  uint64_t affinity;
+  os_thread_priority priority;
+#ifndef LOVR_DISABLE_THREAD
+  thrd_t mixThreads[MAX_MIX_THREADS];
+  uint32_t mixThreadCount;
+  mtx_t mixLock;
+  cnd_t mixCond;
+  atomic_uint mixBatch;
+  atomic_uint mixWork; // Job count in the high 16 bits, next unclaimed job in the low 16 bits
+  atomic_uint mixDone;
+  atomic_uint mixSleepers;
+  atomic_uint mixQuit;
+  thrd_t decodeThread;
+  mtx_t decodeLock;
+  atomic_uint decodeQuit;
+  arr_t(Source*) decoding;
+  arr_t(Source*) pending;
+  thrd_t geometryThread;
+  mtx_t geometryMutex;
+  cnd_t geometryCond;
+  bool geometryThreadStarted;
+  bool geometryQuit;
+#endif
+  struct {
+    atomic_uint callbacks;
+    atomic_uint underruns;
+    atomic_uint starved;
+    atomic_uint voices;
+    atomic_uint virtualVoices;
+    atomic_uint period; // Frames
+    atomic_uint mixMin; // Nanoseconds
+    atomic_uint mixMax;
+    atomic_uint mixTotal; // Microseconds
+    atomic_uint spatializerTotal;
+    atomic_uint decodeTotal;
+    atomic_uint streamTotal;
+    atomic_uint spatializerTime; // Nanoseconds in the current callback, added by any mixing thread
+    atomic_uint decodeTime;
+    atomic_uint reset; // Incremented to request a reset
+    uint32_t resetServed; // Audio thread
+    double mix; // Audio thread totals, in seconds
+    double spatializer;
+    double decode;
+    uint32_t streamResetServed; // Decoder thread
+    double stream;
+  } stats;
 } state;
 
+// Selects which copy of the double buffered parameters the current thread sees
+static LOVR_THREAD_LOCAL bool mixing;
+static LOVR_THREAD_LOCAL bool scheduled;
+
+// The device thread belongs to miniaudio, which already gives it a high priority, so only the
+// affinity is changed there (the first time it calls back).  Threads lovr owns get both.
+static void applyScheduling(bool priority) {
+  if (state.affinity != 0) os_thread_set_affinity(state.affinity);
+  if (priority && state.priority != OS_THREAD_PRIORITY_NORMAL) os_thread_set_priority(state.priority);
+  scheduled = true;
+}
+
 static const ma_format miniaudioFormats[] = {
   [SAMPLE_I16] = ma_format_s16,
   [SAMPLE_F32] = ma_format_f32
@@ -67,14 +292,819 @@ static float linearToDb(float linear) {
   return 20.f * log10f(linear);
 }
 
+// Decoding
+
+// Audio thread: asks for the ring to restart at the current offset
+static void seekRing(Source* source) {
+  atomic_store_explicit(&source->seekTarget, source->offset, memory_order_relaxed);
+  atomic_store_explicit(&source->seekRequest, ++source->seekSent, memory_order_release);
+  source->stale = false;
+}
+
+// Audio thread: reads frames for the mixer.  Sets starved when decoded frames aren't ready yet,
+// which (unlike returning 0 frames otherwise) doesn't mean the Sound is over.
+static uint32_t readSource(Source* source, uint32_t count, void* data, bool* starved) {
+  if (!source->ring) {
+    return lovrSoundRead(source->sound, source->offset, count, data);
+  }
+
+  uint32_t frames = lovrSoundGetFrameCount(source->sound);
+  if (source->offset >= frames) {
+    return 0;
+  }
+
+  if (atomic_load_explicit(&source->seekDone, memory_order_acquire) != source->seekSent) {
+    *starved = true;
+    return 0;
+  }
+
+  count = MIN(count, frames - source->offset);
+  size_t stride = lovrSoundGetStride(source->sound);
+  uint32_t total = 0;
+  while (total < count) {
+    void* p;
+    uint32_t n = count - total;
+    ma_pcm_rb_acquire_read(source->ring, &n, &p);
+    if (n == 0) break;
+    memcpy((char*) data + total * stride, p, n * stride);
+    ma_pcm_rb_commit_read(source->ring, n, p);
+    total += n;
+  }
+
+  *starved = total == 0;
+  return total;
+}
+
+#ifndef LOVR_DISABLE_THREAD
+// Decoder thread: tops up a Source's ring.  The ring keeps going past the end of the Sound from the
+// beginning, since the mixer wraps around there when looping (and resets the ring otherwise).
+static void decodeAhead(Source* source) {
+  uint32_t request = atomic_load_explicit(&source->seekRequest, memory_order_acquire);
+  if (request != source->seekServed) {
+    ma_pcm_rb_reset(source->ring); // The mixer doesn't touch the ring while a seek is pending
+    source->decodeOffset = atomic_load_explicit(&source->seekTarget, memory_order_relaxed);
+    source->seekServed = request;
+  }
+
+  uint32_t frames = lovrSoundGetFrameCount(source->decoder);
+  size_t stride = lovrSoundGetStride(source->decoder);
+  while (frames > 0) {
+    void* p;
+    uint32_t n = ma_pcm_rb_available_write(source->ring);
+    if (n == 0) break;
+    ma_pcm_rb_acquire_write(source->ring, &n, &p);
+    n = MIN(n, frames - source->decodeOffset);
+    uint32_t decoded = lovrSoundRead(source->decoder, source->decodeOffset, n, p);
+    memset((char*) p + decoded * stride, 0, (n - decoded) * stride); // Keep the ring aligned if the decoder comes up short
+    ma_pcm_rb_commit_write(source->ring, n, p);
+    source->decodeOffset += n;
+    if (source->decodeOffset >= frames) {
+      source->decodeOffset = 0;
+    }
+  }
+
+  atomic_store_explicit(&source->seekDone, source->seekServed, memory_order_release);
+}
+
+static int decodeLoop(void* arg) {
+  applyScheduling(true);
+  while (!atomic_load(&state.decodeQuit)) {
+    mtx_lock(&state.decodeLock);
+    for (size_t i = 0; i < state.pending.length; i++) {
+      arr_push(&state.decoding, state.pending.data[i]);
+    }
+    arr_clear(&state.pending);
+    mtx_unlock(&state.decodeLock);
+
+    double start = os_get_time();
+    for (size_t i = 0; i < state.decoding.length; i++) {
+      Source* source = state.decoding.data[i];
+
+      // If this is the last reference, nothing can play the Source anymore
+      if (atomic_load((atomic_uint*) &source->ref) == 1) {
+        state.decoding.data[i--] = state.decoding.data[--state.decoding.length];
+        lovrRelease(source, lovrSourceDestroy);
+        continue;
+      }
+
+      decodeAhead(source);
+    }
+
+    uint32_t reset = atomic_load_explicit(&state.stats.reset, memory_order_relaxed);
+    if (reset != state.stats.streamResetServed) {
+      state.stats.streamResetServed = reset;
+      state.stats.stream = 0.;
+    }
+    state.stats.stream += os_get_time() - start;
+    atomic_store_explicit(&state.stats.streamTotal, (uint32_t) (state.stats.stream * 1e6), memory_order_relaxed);
+
+    thrd_sleep(&(struct timespec) { .tv_nsec = 5000000 }, NULL);
+  }
+
+  return 0;
+}
+
+// Game thread: gives a compressed Source its own decoder and ring, before it's first played
+static void startDecoding(Source* source) {
+  uint32_t frames = lovrSoundGetSampleRate(source->sound) / DECODE_AHEAD;
+  source->decoder = lovrSoundCreateDecoder(source->sound);
+  source->ring = malloc(sizeof(ma_pcm_rb));
+  lovrAssert(source->ring, "Out of memory");
+  ma_format format = miniaudioFormats[lovrSoundGetFormat(source->sound)];
+  uint32_t channels = lovrSoundGetChannelCount(source->sound);
+  ma_result status = ma_pcm_rb_init(format, channels, frames, NULL, NULL, source->ring);
+  lovrAssert(status == MA_SUCCESS, "Failed to create decode buffer: %s (%d)", ma_result_description(status), status);
+  lovrRetain(source);
+  mtx_lock(&state.decodeLock);
+  arr_push(&state.pending, source);
+  mtx_unlock(&state.decodeLock);
+}
+#endif
+
+// Voices
+
+static void voice(Source* source) {
+  uint32_t index = state.voiceMask ? CTZL(~state.voiceMask) : 0;
+  state.voiceMask |= (1ull << index);
+  state.voices[index] = source;
+  source->index = index;
+  source->gain = source->offset == 0 ? source->params[1].volume : 0.f; // Fade in when resumed midway
+  source->detail = source->detailed ? 1.f : 0.f; // New voices don't need to crossfade
+  state.spatializer->sourceCreate(source);
+  if (state.panning) simpleSpatializer.sourceCreate(source);
+  if (source->stale) {
+    seekRing(source);
+  }
+}
+
+static void unvoice(Source* source) {
+  state.spatializer->sourceDestroy(source);
+  if (state.panning) simpleSpatializer.sourceDestroy(source);
+  state.voices[source->index] = NULL;
+  state.voiceMask &= ~(1ull << source->index);
+  source->index = ~0u;
+}
+
+static float score(Source* source) {
+  SourceParams* params = &source->params[1];
+  float audibility = params->volume * state.buses[params->bus].level;
+
+  if (lovrSourceIsEffectEnabled(source, EFFECT_ATTENUATION)) {
+    audibility /= MAX(vec3_distance(params->position, state.listener), 1.f);
+  }
+
+  if (audibility <= 0.f) {
+    return -INFINITY;
+  }
+
+  // Sources that already have a voice get an edge, so voices don't flap between similar Sources
+  if (source->index != ~0u) {
+    audibility *= 1.1f;
+  }
+
+  // Priority always wins, audibility (scaled below 1) breaks ties
+  return (float) params->priority + MIN(audibility, 1.f) * .99f;
+}
+
+// Returns the kth smallest value, reordering the array (quickselect)
+static float nth(float* values, int32_t count, int32_t k) {
+  int32_t lo = 0;
+  int32_t hi = count - 1;
+  while (lo < hi) {
+    float pivot = values[lo + (hi - lo) / 2];
+    int32_t i = lo;
+    int32_t j = hi;
+    while (i <= j) {
+      while (values[i] < pivot) i++;
+      while (values[j] > pivot) j--;
+      if (i <= j) {
+        float tmp = values[i];
+        values[i++] = values[j];
+        values[j--] = tmp;
+      }
+    }
+    if (k <= j) hi = j;
+    else if (k >= i) lo = i;
+    else break;
+  }
+  return values[k];
+}
+
+// Returns the score that the best limit of the ranks have to beat, reordering the ranks.  ties is
+// how many of the ranks equal to the cutoff make it too.
+static float cutoff(float* ranks, uint32_t count, uint32_t limit, uint32_t* ties) {
+  *ties = limit;
+  if (count <= limit) return -INFINITY;
+  float threshold = nth(ranks, count, count - limit);
+  for (uint32_t i = 0; i < count; i++) {
+    if (ranks[i] > threshold) (*ties)--;
+  }
+  return threshold;
+}
+
+// Gives the voices to the most important playing Sources, taking them away from the others, and
+// picks which of the voices get the full spatializer
+static void assign(void) {
+  uint32_t audible = 0;
+  for (uint32_t i = 0; i < state.sourceCount; i++) {
+    Source* source = state.sources[i];
+    float s = source->params[1].playing ? score(source) : -INFINITY;
+    state.scores[i] = s;
+    if (s > -INFINITY) state.ranks[audible++] = s;
+  }
+
+  uint32_t ties;
+  float threshold = cutoff(state.ranks, audible, state.voiceLimit, &ties);
+
+  // Free voices first so the winners are guaranteed to find one
+  uint32_t wanted = 0;
+  for (uint32_t i = 0; i < state.sourceCount; i++) {
+    Source* source = state.sources[i];
+    float s = state.scores[i];
+    bool win = s > threshold;
+    if (!win && s == threshold && s > -INFINITY && ties > 0) {
+      win = true;
+      ties--;
+    }
+    if (win) {
+      // Voices that already have the full spatializer get a small edge, like voices do above
+      state.ranks[wanted++] = state.scores[i] = s + (source->index != ~0u && source->detailed ? .005f : 0.f);
+    } else {
+      state.scores[i] = -INFINITY;
+      if (source->index != ~0u) unvoice(source);
+    }
+  }
+
+  uint32_t limit = state.panning ? atomic_load_explicit(&state.detailLimit, memory_order_relaxed) : MAX_VOICES;
+  threshold = cutoff(state.ranks, wanted, limit, &ties);
+
+  for (uint32_t i = 0; i < state.sourceCount; i++) {
+    Source* source = state.sources[i];
+    float s = state.scores[i];
+    if (s == -INFINITY) continue;
+    source->detailed = s > threshold;
+    if (!source->detailed && s == threshold && ties > 0) {
+      source->detailed = true;
+      ties--;
+    }
+    if (source->index == ~0u) {
+      voice(source);
+    }
+  }
+}
+
+static void finish(Source* source) {
+  source->offset = 0;
+  if (source->ring) seekRing(source);
+  source->params[1].playing = false;
+  atomic_store_explicit(&source->finished, source->playback, memory_order_release);
+  atomic_fetch_add_explicit(&state.finished, 1, memory_order_release);
+}
+
+// Advances a virtual Source without decoding it
+static void skip(Source* source, uint32_t frames) {
+  uint32_t count = frames;
+  if (source->converter) {
+    count = (uint32_t) ma_data_converter_get_required_input_frame_count(source->converter, frames);
+  }
+
+  // Streams are consumed by reading, so their frames are read and thrown away to avoid a backlog
+  if (lovrSoundIsStream(source->sound)) {
+    float scratch[BUFFER_SIZE * 2];
+    uint32_t capacity = sizeof(scratch) / (lovrSoundGetChannelCount(source->sound) * sizeof(float));
+    uint32_t total = 0;
+    while (total < count) {
+      uint32_t n = lovrSoundRead(source->sound, 0, MIN(count - total, capacity), scratch);
+      if (n == 0) break;
+      total += n;
+    }
+    if (total == 0) finish(source);
+    return;
+  }
+
+  uint32_t length = lovrSoundGetFrameCount(source->sound);
+  source->offset += count;
+  source->stale = source->ring != NULL;
+  if (source->offset >= length) {
+    if (source->params[1].looping && length > 0) {
+      source->offset %= length;
+    } else {
+      finish(source);
+    }
+  }
+
+  atomic_store_explicit(&source->cursor, source->offset, memory_order_relaxed);
+}
+
+// Command queue
+
+static void lock(void) {
+  while (atomic_flag_test_and_set_explicit(&state.commandLock, memory_order_acquire));
+}
+
+static void unlock(void) {
+  atomic_flag_clear_explicit(&state.commandLock, memory_order_release);
+}
+
+// Consumer side, called by the audio thread (or by the game thread when the device isn't running)
+static void drain(void) {
+  uint32_t tail = atomic_load_explicit(&state.tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&state.head, memory_order_acquire);
+
+  while (tail != head) {
+    Command* command = &state.commands[tail & (COMMAND_QUEUE_SIZE - 1)];
+    Source* source = command->source;
+
+    switch (command->type) {
+      case COMMAND_PLAY:
+        if (source->entry == ~0u) {
+          source->entry = state.sourceCount;
+          state.sources[state.sourceCount++] = source;
+          if (source->ring) seekRing(source);
+        }
+        source->params[1] = command->params;
+        source->playback = command->generation;
+        break;
+      case COMMAND_REMOVE:
+        if (source->index != ~0u) unvoice(source);
+        state.sources[source->entry] = state.sources[--state.sourceCount];
+        state.sources[source->entry]->entry = source->entry;
+        source->entry = ~0u;
+        lovrRelease(source, lovrSourceDestroy);
+        break;
+      case COMMAND_SEEK:
+        source->offset = command->offset;
+        if (source->ring) seekRing(source);
+        break;
+      case COMMAND_PARAMS:
+        source->params[1] = command->params;
+        break;
+      case COMMAND_LISTENER:
+        memcpy(state.listener, command->pose, sizeof(state.listener));
+        state.spatializer->setListenerPose(command->pose, command->pose + 4);
+        if (state.panning) simpleSpatializer.setListenerPose(command->pose, command->pose + 4);
+        break;
+      case COMMAND_ABSORPTION:
+        memcpy(state.absorption[1], command->absorption, 3 * sizeof(float));
+        break;
+      case COMMAND_BUS: {
+        MixBus* bus = &state.buses[command->bus.index];
+        bus->parent = command->bus.parent;
+        bus->volume = command->bus.volume;
+        bus->effects = command->bus.effects;
+        bus->used = true;
+        if (command->bus.reset) bus->gain = bus->volume;
+        state.busesChanged = true;
+        break;
+      }
+    }
+
+    lovrRelease(source, lovrSourceDestroy);
+    tail++;
+  }
+
+  atomic_store_explicit(&state.tail, tail, memory_order_release);
+}
+
+// Producer side, must hold the command lock.  If the queue is full, this waits for the audio thread
+// to catch up (the audio thread never waits for the game thread).  Commands keep their Source alive.
+static Command* push(CommandType type, Source* source) {
+  uint32_t head = atomic_load_explicit(&state.head, memory_order_relaxed);
+  while (head - atomic_load_explicit(&state.tail, memory_order_acquire) >= COMMAND_QUEUE_SIZE) {
+    if (!ma_device_is_started(&state.devices[AUDIO_PLAYBACK])) {
+      drain();
+    }
+  }
+  Command* command = &state.commands[head & (COMMAND_QUEUE_SIZE - 1)];
+  command->type = type;
+  command->source = source;
+  lovrRetain(source);
+  return command;
+}
+
+static void submit(void) {
+  atomic_fetch_add_explicit(&state.head, 1, memory_order_release);
+}
+
+static void release(uint32_t slot) {
+  state.slots[slot / 64] &= ~(1ull << (slot % 64));
+  state.owners[slot]->slot = ~0u;
+  push(COMMAND_REMOVE, state.owners[slot]);
+  submit();
+  state.owners[slot] = NULL;
+}
+
+// Gives back the slots of Sources that reached the end of their Sound (and weren't played again)
+static void reclaim(void) {
+  uint32_t endings = atomic_load_explicit(&state.finished, memory_order_acquire);
+  if (endings == state.endings) return;
+  state.endings = endings;
+  for (uint32_t i = 0; i < MAX_SOURCES / 64; i++) {
+    for (uint64_t m = state.slots[i]; m; m ^= (m & -m)) {
+      uint32_t slot = 64 * i + CTZL(m);
+      Source* source = state.owners[slot];
+      if (atomic_load_explicit(&source->finished, memory_order_acquire) == source->generation) {
+        release(slot);
+      }
+    }
+  }
+}
+
+static void sendParams(Source* source) {
+  if (source->slot != ~0u) {
+    lock();
+    push(COMMAND_PARAMS, source)->params = source->params[0];
+    submit();
+    unlock();
+  }
+}
+
+// Mixing
+
+// Reads the next buffer of a voice into buf, mono if it uses the spatializer and stereo otherwise.
+// Can run on any mixing thread, it only touches the Source.
+static void decode(Source* source, float* buf) {
+  float raw[BUFFER_SIZE * 2];
+  SourceParams* params = &source->params[1];
+
+  // Read and convert raw frames until there's a block of converted frames
+  // - No converter: just read frames into buf (it has enough space for BUFFER_SIZE frames).
+  // - Different format or channels: read frames into raw and convert them inline into buf.  This
+  //   doesn't keep any state, so it's done with the Sound conversion kernels instead of a converter.
+  // - Converter: keep reading as many frames as possible/needed into raw and convert into buf.
+  // - If EOF is reached, rewind and continue for looping sources, otherwise pad end with zero.
+  float* cursor = buf; // Edge of processed frames
+  uint32_t channelsOut = lovrSourceUsesSpatializer(source) ? 1 : 2; // If spatializer isn't converting to stereo, converter must do it
+  uint32_t channelsIn = lovrSoundGetChannelCount(source->sound);
+  SampleFormat format = lovrSoundGetFormat(source->sound);
+  bool convert = !source->converter && (format != SAMPLE_F32 || channelsIn != channelsOut);
+  uint32_t framesRemaining = state.blockSize;
+  uint32_t framesProcessed = 0;
+  while (framesRemaining > 0) {
+    uint32_t framesRead;
+    bool starved = false;
+
+    if (source->converter) {
+      uint32_t capacity = sizeof(raw) / (channelsIn * sizeof(float));
+      uint32_t chunk = MIN(ma_data_converter_get_required_input_frame_count(source->converter, framesRemaining), capacity);
+      framesRead = readSource(source, chunk, raw, &starved);
+    } else if (convert) {
+      uint32_t capacity = sizeof(raw) / (channelsIn * sizeof(float));
+      framesRead = readSource(source, MIN(framesRemaining, capacity), raw, &starved);
+    } else {
+      framesRead = readSource(source, framesRemaining, cursor, &starved);
+    }
+
+    if (starved) { // The decoder thread is behind, this Source will play a little late
+      atomic_fetch_add_explicit(&state.stats.starved, 1, memory_order_relaxed);
+      memset(cursor, 0, framesRemaining * channelsOut * sizeof(float));
+      break;
+    } else if (framesRead == 0) {
+      if (params->looping) {
+        source->offset = 0;
+        continue;
+      } else {
+        finish(source);
+        memset(cursor, 0, framesRemaining * channelsOut * sizeof(float));
+        break;
+      }
+    } else {
+      source->offset += framesRead;
+    }
+
+    if (source->converter) {
+      ma_uint64 framesIn = framesRead;
+      ma_uint64 framesOut = framesRemaining;
+      ma_data_converter_process_pcm_frames(source->converter, raw, &framesIn, cursor, &framesOut);
+      cursor += framesOut * channelsOut;
+      framesProcessed += framesOut;
+      framesRemaining -= framesOut;
+    } else {
+      if (convert) lovrSoundConvert(raw, format, channelsIn, cursor, SAMPLE_F32, channelsOut, framesRead);
+      cursor += framesRead * channelsOut;
+      framesProcessed += framesRead;
+      framesRemaining -= framesRead;
+    }
+  }
+
+  atomic_store_explicit(&source->cursor, source->offset, memory_order_relaxed);
+}
+
+static void spatializeVoices(Spatializer* spatializer, Source** sources, const float** inputs, float* outputs, uint32_t count) {
+  bool serial = !spatializer->parallel;
+  if (serial) while (atomic_flag_test_and_set_explicit(&state.spatializerLock, memory_order_acquire));
+  double start = os_get_time();
+
+  if (spatializer->applyBatch) {
+    SourcePoses poses;
+    for (uint32_t i = 0; i < count; i++) {
+      SourceParams* params = &sources[i]->params[1];
+      for (uint32_t c = 0; c < 3; c++) poses.position[c][i] = params->position[c];
+      for (uint32_t c = 0; c < 4; c++) poses.orientation[c][i] = params->orientation[c];
+    }
+    spatializer->applyBatch(sources, inputs, outputs, &poses, count, state.blockSize);
+  } else {
+    for (uint32_t i = 0; i < count; i++) {
+      spatializer->apply(sources[i], inputs[i], outputs + i * state.blockSize * 2, state.blockSize, state.blockSize);
+    }
+  }
+
+  uint32_t time = (uint32_t) ((os_get_time() - start) * 1e9);
+  if (serial) atomic_flag_clear_explicit(&state.spatializerLock, memory_order_release);
+  atomic_fetch_add_explicit(&state.stats.spatializerTime, time, memory_order_relaxed);
+}
+
+// Blends panned voices into fully spatialized ones as they cross the spatializer voice limit
+static void crossfade(Source* source, float* output, const float* panned, uint32_t frames) {
+  float from = source->detail;
+  float step = frames / (SAMPLE_RATE * .05f);
+  float to = source->detailed ? MIN(from + step, 1.f) : MAX(from - step, 0.f);
+  for (uint32_t i = 0; i < frames; i++) {
+    float t = from + (to - from) * (i + 1) / frames;
+    output[2 * i + 0] = panned[2 * i + 0] + (output[2 * i + 0] - panned[2 * i + 0]) * t;
+    output[2 * i + 1] = panned[2 * i + 1] + (output[2 * i + 1] - panned[2 * i + 1]) * t;
+  }
+  source->detail = to;
+}
+
+// Decodes the voices of a job, spatializes the ones that need it as a batch, and mixes them.  Voices
+// that are crossfading go through both spatializers.
+static void runJob(MixJob* job) {
+  float inputs[VOICES_PER_JOB][BUFFER_SIZE * 2];
+  float outputs[VOICES_PER_JOB * BUFFER_SIZE * 2]; // Packed, one block after another
+  float pannedOutputs[VOICES_PER_JOB * BUFFER_SIZE * 2];
+  uint32_t frames = state.blockSize;
+  float* mixed[VOICES_PER_JOB];
+  float* panned[VOICES_PER_JOB];
+  Source* batch[VOICES_PER_JOB];
+  const float* batchInputs[VOICES_PER_JOB];
+  uint32_t batchCount = 0;
+  Source* pannedBatch[VOICES_PER_JOB];
+  const float* pannedInputs[VOICES_PER_JOB];
+  uint32_t pannedCount = 0;
+  double start = os_get_time();
+
+  for (uint32_t i = 0; i < job->count; i++) {
+    Source* source = job->voices[i];
+    decode(source, inputs[i]);
+    panned[i] = NULL;
+    if (!lovrSourceUsesSpatializer(source)) {
+      mixed[i] = inputs[i];
+    } else if (state.spatialize) {
+      bool full = !state.panning || source->detailed || source->detail > 0.f;
+      bool pan = state.panning && (!source->detailed || source->detail < 1.f);
+      if (pan) {
+        pannedBatch[pannedCount] = source;
+        pannedInputs[pannedCount] = inputs[i];
+        mixed[i] = pannedOutputs + pannedCount++ * frames * 2;
+      }
+      if (full) {
+        batch[batchCount] = source;
+        batchInputs[batchCount] = inputs[i];
+        if (pan) panned[i] = mixed[i];
+        mixed[i] = outputs + batchCount++ * frames * 2;
+      }
+    } else {
+      mixed[i] = outputs + i * frames * 2;
+      mix_interleave(mixed[i], inputs[i], frames);
+    }
+  }
+
+  uint32_t decodeTime = (uint32_t) ((os_get_time() - start) * 1e9);
+  atomic_fetch_add_explicit(&state.stats.decodeTime, decodeTime, memory_order_relaxed);
+
+  if (batchCount > 0) {
+    spatializeVoices(state.spatializer, batch, batchInputs, outputs, batchCount);
+  }
+
+  if (pannedCount > 0) {
+    spatializeVoices(&simpleSpatializer, pannedBatch, pannedInputs, pannedOutputs, pannedCount);
+  }
+
+  memset(job->output, 0, frames * 2 * sizeof(float));
+  for (uint32_t i = 0; i < job->count; i++) {
+    Source* source = job->voices[i];
+    if (panned[i]) crossfade(source, mixed[i], panned[i], frames);
+    mix_ramp(job->output, mixed[i], frames, source->gain, source->params[1].volume);
+    source->gain = source->params[1].volume;
+  }
+}
+
+#ifndef LOVR_DISABLE_THREAD
+// Claims jobs from the current batch until they've all been claimed
+static void work(void) {
+  uint32_t word = atomic_load(&state.mixWork);
+  while ((word & 0xffff) < (word >> 16)) {
+    if (atomic_compare_exchange_weak(&state.mixWork, &word, word + 1)) {
+      runJob(&state.jobs[word & 0xffff]);
+      atomic_fetch_add_explicit(&state.mixDone, 1, memory_order_release);
+      word = atomic_load(&state.mixWork);
+    }
+  }
+}
+
+// Mixing threads spin for a bit after each batch, since the next one is coming soon, then sleep
+static int mixLoop(void* arg) {
+  applyScheduling(true);
+  uint32_t batch = 0;
+  mixing = true;
+  while (!atomic_load(&state.mixQuit)) {
+    uint32_t spins = 0;
+    while (atomic_load(&state.mixBatch) == batch && !atomic_load(&state.mixQuit)) {
+      if (++spins < 64) {
+        thrd_yield();
+        continue;
+      }
+
+      mtx_lock(&state.mixLock);
+      atomic_fetch_add(&state.mixSleepers, 1);
+      while (atomic_load(&state.mixBatch) == batch && !atomic_load(&state.mixQuit)) {
+        cnd_wait(&state.mixCond, &state.mixLock);
+      }
+      atomic_fetch_sub(&state.mixSleepers, 1);
+      mtx_unlock(&state.mixLock);
+    }
+
+    batch = atomic_load(&state.mixBatch);
+    work();
+  }
+  return 0;
+}
+
+static void wake(void) {
+  mtx_lock(&state.mixLock);
+  cnd_broadcast(&state.mixCond);
+  mtx_unlock(&state.mixLock);
+}
+#endif
+
+// Splits the voices into jobs, each one mixing voices from a single Bus
+static void schedule(void) {
+  uint32_t open[MAX_BUSES]; // The job each Bus is currently filling
+  memset(open, 0xff, sizeof(open));
+  state.jobCount = 0;
+
+  Source* source;
+  FOREACH_VOICE(source) {
+    uint32_t bus = source->params[1].bus;
+    MixJob* job = open[bus] == ~0u ? NULL : &state.jobs[open[bus]];
+    if (!job || job->count == VOICES_PER_JOB) {
+      open[bus] = state.jobCount;
+      job = &state.jobs[state.jobCount++];
+      job->bus = bus;
+      job->count = 0;
+    }
+    job->voices[job->count++] = source;
+  }
+}
+
+static void runJobs(void) {
+#ifndef LOVR_DISABLE_THREAD
+  if (state.mixThreadCount > 0 && state.jobCount > 1) {
+    atomic_store(&state.mixDone, 0);
+    atomic_store(&state.mixWork, state.jobCount << 16);
+    atomic_fetch_add(&state.mixBatch, 1);
+    if (atomic_load(&state.mixSleepers) > 0) {
+      wake();
+    }
+    work();
+    while (atomic_load_explicit(&state.mixDone, memory_order_acquire) < state.jobCount);
+    return;
+  }
+#endif
+
+  for (uint32_t i = 0; i < state.jobCount; i++) {
+    runJob(&state.jobs[i]);
+  }
+}
+
+// Recomputes the order, inherited effects, and levels of the Buses after one of them changes
+static void updateBuses(void) {
+  state.busCount = 0;
+  for (uint32_t i = 1; i < MAX_BUSES; i++) {
+    MixBus* bus = &state.buses[i];
+    if (!bus->used) continue;
+
+    bus->depth = 0;
+    bus->mask = bus->effects;
+    bus->level = bus->volume;
+    for (uint32_t p = bus->parent; p != 0 && bus->depth < MAX_BUSES; p = state.buses[p].parent) {
+      bus->mask &= state.buses[p].effects;
+      bus->level *= state.buses[p].volume;
+      bus->depth++;
+    }
+
+    uint32_t j = state.busCount++;
+    while (j > 0 && state.buses[state.busOrder[j - 1]].depth < bus->depth) {
+      state.busOrder[j] = state.busOrder[j - 1];
+      j--;
+    }
+    state.busOrder[j] = i;
+  }
+  state.busesChanged = false;
+}
+
+// Sums the jobs into their Buses, and the Buses into their parents, ending up in dst
+static void mixBuses(float* dst) {
+  uint32_t frames = state.blockSize;
+  for (uint32_t i = 0; i < state.busCount; i++) {
+    state.buses[state.busOrder[i]].active = false;
+  }
+
+  for (uint32_t i = 0; i < state.jobCount; i++) {
+    MixJob* job = &state.jobs[i];
+    MixBus* bus = &state.buses[job->bus];
+    if (job->bus == 0) {
+      mix_ramp(dst, job->output, frames, 1.f, 1.f);
+    } else if (bus->active) {
+      mix_ramp(state.busBuffers[job->bus], job->output, frames, 1.f, 1.f);
+    } else {
+      memcpy(state.busBuffers[job->bus], job->output, frames * 2 * sizeof(float));
+      bus->active = true;
+    }
+  }
+
+  for (uint32_t i = 0; i < state.busCount; i++) {
+    uint32_t index = state.busOrder[i];
+    MixBus* bus = &state.buses[index];
+    if (bus->active) {
+      MixBus* parent = &state.buses[bus->parent];
+      float* target = bus->parent == 0 ? dst : state.busBuffers[bus->parent];
+      if (bus->parent != 0 && !parent->active) {
+        memset(target, 0, frames * 2 * sizeof(float));
+        parent->active = true;
+      }
+      mix_ramp(target, state.busBuffers[index], frames, bus->gain, bus->volume);
+    }
+    bus->gain = bus->volume;
+  }
+}
+
+// Stats
+
+static void resetStats(void) {
+  state.stats.mix = state.stats.spatializer = state.stats.decode = 0.;
+  atomic_store_explicit(&state.stats.callbacks, 0, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.underruns, 0, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.starved, 0, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.mixMin, ~0u, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.mixMax, 0, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.mixTotal, 0, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.spatializerTotal, 0, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.decodeTotal, 0, memory_order_relaxed);
+}
+
+// Audio thread: publishes the stats for a callback that started at start and produced frames
+static void recordStats(double start, uint32_t frames, double spatializerTime) {
+  double time = os_get_time() - start;
+  uint32_t ns = (uint32_t) MIN(time * 1e9, 4e9);
+  spatializerTime += atomic_exchange_explicit(&state.stats.spatializerTime, 0, memory_order_relaxed) / 1e9;
+  double decodeTime = atomic_exchange_explicit(&state.stats.decodeTime, 0, memory_order_relaxed) / 1e9;
+  state.stats.mix += time;
+  state.stats.spatializer += spatializerTime;
+  state.stats.decode += decodeTime;
+
+  if (time * SAMPLE_RATE > frames) {
+    atomic_fetch_add_explicit(&state.stats.underruns, 1, memory_order_relaxed);
+  }
+
+  if (ns < atomic_load_explicit(&state.stats.mixMin, memory_order_relaxed)) {
+    atomic_store_explicit(&state.stats.mixMin, ns, memory_order_relaxed);
+  }
+
+  if (ns > atomic_load_explicit(&state.stats.mixMax, memory_order_relaxed)) {
+    atomic_store_explicit(&state.stats.mixMax, ns, memory_order_relaxed);
+  }
+
+  atomic_store_explicit(&state.stats.period, frames, memory_order_relaxed);
+  atomic_store_explicit(&state.stats.mixTotal, (uint32_t) (state.stats.mix * 1e6), memory_order_relaxed);
+  atomic_store_explicit(&state.stats.spatializerTotal, (uint32_t) (state.stats.spatializer * 1e6), memory_order_relaxed);
+  atomic_store_explicit(&state.stats.decodeTotal, (uint32_t) (state.stats.decode * 1e6), memory_order_relaxed);
+  atomic_fetch_add_explicit(&state.stats.callbacks, 1, memory_order_release);
+}
+
 // Device callbacks
 
 static void onPlayback(ma_device* device, void* out, const void* in, uint32_t count) {
-  float raw[BUFFER_SIZE * 2];
   float aux[BUFFER_SIZE * 2];
   float mix[BUFFER_SIZE * 2];
+  uint32_t frames = state.blockSize;
   uint32_t total = count;
   float* output = out;
+  double start = os_get_time();
+  double tailTime = 0.;
+  mixing = true;
+  lovrProfileBegin("onPlayback");
+
+  if (!scheduled) {
+    applyScheduling(false);
+  }
+
+  uint32_t reset = atomic_load_explicit(&state.stats.reset, memory_order_acquire);
+  if (reset != state.stats.resetServed) {
+    state.stats.resetServed = reset;
+    resetStats();
+  }
 
   // Consume any leftovers from the previous callback
   if (state.leftoverFrames > 0) {
@@ -89,107 +1119,65 @@ static void onPlayback(ma_device* device, void* out, const void* in, uint32_t co
     }
   }
 
-  ma_mutex_lock(&state.lock);
+  drain();
+
+  if (state.busesChanged) {
+    updateBuses();
+  }
+
+  // setGeometry can take a while, so if it's in progress the spatializer is skipped for a callback
+  bool spatialize = !atomic_flag_test_and_set_explicit(&state.geometryLock, memory_order_acquire);
+  state.spatialize = spatialize;
 
   do {
-    float* dst = count >= BUFFER_SIZE ? output : state.leftovers;
-    float* buf = NULL; // The "current" buffer (used for fast paths)
+    float* dst = count >= frames ? output : state.leftovers;
 
     if (dst == state.leftovers) {
       memset(dst, 0, sizeof(state.leftovers));
     }
 
-    Source* source;
-    FOREACH_SOURCE(source) {
-      if (!source->playing) {
-        state.sources[source->index] = NULL;
-        state.sourceMask &= ~(1ull << source->index);
-        state.spatializer->sourceDestroy(source);
-        source->index = ~0u;
-        lovrRelease(source, lovrSourceDestroy);
-        continue;
-      }
-
-      // Read and convert raw frames until there's BUFFER_SIZE converted frames
-      // - No converter: just read frames into raw (it has enough space for BUFFER_SIZE frames).
-      // - Converter: keep reading as many frames as possible/needed into raw and convert into aux.
-      // - If EOF is reached, rewind and continue for looping sources, otherwise pad end with zero.
-      buf = source->converter ? aux : raw;
-      float* cursor = buf; // Edge of processed frames
-      uint32_t channelsOut = lovrSourceUsesSpatializer(source) ? 1 : 2; // If spatializer isn't converting to stereo, converter must do it
-      uint32_t framesRemaining = BUFFER_SIZE;
-      uint32_t framesProcessed = 0;
-      while (framesRemaining > 0) {
-        uint32_t framesRead;
-
-        if (source->converter) {
-          uint32_t channelsIn = lovrSoundGetChannelCount(source->sound);
-          uint32_t capacity = sizeof(raw) / (channelsIn * sizeof(float));
-          uint32_t chunk = MIN(ma_data_converter_get_required_input_frame_count(source->converter, framesRemaining), capacity);
-          framesRead = lovrSoundRead(source->sound, source->offset, chunk, raw);
-        } else {
-          framesRead = lovrSoundRead(source->sound, source->offset, framesRemaining, cursor);
-        }
-
-        if (framesRead == 0) {
-          if (source->looping) {
-            source->offset = 0;
-            continue;
-          } else {
-            source->offset = 0;
-            source->playing = false;
-            memset(cursor, 0, framesRemaining * channelsOut * sizeof(float));
-            break;
-          }
-        } else {
-          source->offset += framesRead;
-        }
-
-        if (source->converter) {
-          ma_uint64 framesIn = framesRead;
-          ma_uint64 framesOut = framesRemaining;
-          ma_data_converter_process_pcm_frames(source->converter, raw, &framesIn, cursor, &framesOut);
-          cursor += framesOut * channelsOut;
-          framesProcessed += framesOut;
-          framesRemaining -= framesOut;
-        } else {
-          cursor += framesRead * channelsOut;
-          framesProcessed += framesRead;
-          framesRemaining -= framesRead;
-        }
-      }
+    assign();
 
-      // Spatialize
-      if (lovrSourceUsesSpatializer(source)) {
-        state.spatializer->apply(source, buf, mix, BUFFER_SIZE, BUFFER_SIZE);
-        buf = mix;
-      }
-
-      // Mix
-      float volume = source->volume;
-      for (uint32_t i = 0; i < OUTPUT_CHANNELS * BUFFER_SIZE; i++) {
-        dst[i] += buf[i] * volume;
+    uint32_t voices = 0;
+    uint32_t virtualVoices = 0;
+    for (uint32_t i = 0; i < state.sourceCount; i++) {
+      Source* source = state.sources[i];
+      if (!source->params[1].playing) {
+        continue;
+      } else if (source->index == ~0u) {
+        skip(source, frames);
+        virtualVoices++;
+      } else {
+        voices++;
       }
     }
+    atomic_store_explicit(&state.stats.voices, voices, memory_order_relaxed);
+    atomic_store_explicit(&state.stats.virtualVoices, virtualVoices, memory_order_relaxed);
+
+    schedule();
+    runJobs();
+    mixBuses(dst);
 
     // Tail
-    uint32_t tailCount = state.spatializer->tail(aux, mix, BUFFER_SIZE);
-    for (uint32_t i = 0; i < tailCount * OUTPUT_CHANNELS; i++) {
-      dst[i] += mix[i];
-    }
+    double tailStart = os_get_time();
+    uint32_t tailCount = spatialize ? state.spatializer->tail(aux, mix, frames) : 0;
+    tailTime += os_get_time() - tailStart;
+    mix_ramp(dst, mix, tailCount, 1.f, 1.f);
 
     // Copy some leftovers to output
     if (dst == state.leftovers) {
       memcpy(output, state.leftovers, count * OUTPUT_CHANNELS * sizeof(float));
-      state.leftoverFrames = BUFFER_SIZE - count;
+      state.leftoverFrames = frames - count;
       state.leftoverOffset = count;
     }
 
-    output += BUFFER_SIZE * OUTPUT_CHANNELS;
-    count -= MIN(count, BUFFER_SIZE);
+    output += frames * OUTPUT_CHANNELS;
+    count -= MIN(count, frames);
   } while (count > 0);
 
-  ma_mutex_unlock(&state.lock);
+  if (spatialize) {
+    atomic_flag_clear_explicit(&state.geometryLock, memory_order_release);
+  }
 
 sink:
   if (state.sinks[AUDIO_PLAYBACK]) {
@@ -197,6 +1185,15 @@ sink:
     uint64_t capacity = sizeof(aux) / lovrSoundGetChannelCount(state.sinks[AUDIO_PLAYBACK]) / sizeof(float);
     output = out;
 
+    while (remaining > 0 && !state.playbackResample) {
+      Sound* sink = state.sinks[AUDIO_PLAYBACK];
+      uint32_t chunk = (uint32_t) MIN(remaining, capacity);
+      lovrSoundConvert(output, SAMPLE_F32, OUTPUT_CHANNELS, aux, lovrSoundGetFormat(sink), lovrSoundGetChannelCount(sink), chunk);
+      lovrSoundWrite(sink, 0, chunk, aux);
+      output += chunk * OUTPUT_CHANNELS;
+      remaining -= chunk;
+    }
+
     while (remaining > 0) {
       ma_uint64 framesConsumed = remaining;
       ma_uint64 framesWritten = capacity;
@@ -206,9 +1203,16 @@ sink:
       remaining -= framesConsumed;
     }
   }
+
+  lovrProfileEnd();
+  recordStats(start, total, tailTime);
 }
 
 static void onCapture(ma_device* device, void* output, const void* input, uint32_t count) {
+  if (state.captureCallback) {
+    state.captureCallback(input, count, state.captureUserdata);
+  }
+
   lovrSoundWrite(state.sinks[AUDIO_CAPTURE], 0, count, input);
 }
 
@@ -226,14 +1230,23 @@ static Spatializer* spatializers[] = {
 
 // Entry
 
-bool lovrAudioInit(const char* spatializer) {
+bool lovrAudioInit(const char* spatializer, uint32_t voices, uint32_t threads, uint64_t affinity, os_thread_priority priority) {
   if (state.initialized) return false;
+  state.affinity = affinity;
+  state.priority = priority;
 
   ma_result result = ma_context_init(NULL, 0, NULL, &state.context);
   lovrAssert(result == MA_SUCCESS, "Failed to initialize miniaudio");
 
-  result = ma_mutex_init(&state.lock);
-  lovrAssert(result == MA_SUCCESS, "Failed to create audio mutex");
+  atomic_init(&state.head, 0);
+  atomic_init(&state.tail, 0);
+  atomic_init(&state.finished, 0);
+  atomic_flag_clear(&state.commandLock);
+  atomic_flag_clear(&state.geometryLock);
+  atomic_flag_clear(&state.busLock);
+  atomic_flag_clear(&state.spatializerLock);
+  atomic_init(&state.stats.reset, 0);
+  resetStats();
 
   for (size_t i = 0; i < sizeof(spatializers) / sizeof(spatializers[0]); i++) {
     if (spatializer && strcmp(spatializer, spatializers[i]->name)) {
@@ -247,12 +1260,49 @@ bool lovrAudioInit(const char* spatializer) {
   }
   lovrAssert(state.spatializer, "Must have at least one spatializer");
 
+  if (state.spatializer != &simpleSpatializer) {
+    state.panning = simpleSpatializer.init();
+  }
+
+  atomic_init(&state.detailLimit, MAX_VOICES);
+
   // SteamAudio's default frequency-dependent absorption coefficients for air
-  state.absorption[0] = .0002f;
-  state.absorption[1] = .0017f;
-  state.absorption[1] = .0182f;
+  state.absorption[0][0] = state.absorption[1][0] = .0002f;
+  state.absorption[0][1] = state.absorption[1][1] = .0017f;
+  state.absorption[0][2] = state.absorption[1][2] = .0182f;
 
   quat_identity(state.orientation);
+  state.blockSize = BUFFER_SIZE;
+  state.voiceLimit = voices > 0 ? MIN(voices, MAX_VOICES) : MAX_VOICES;
+
+  // Bus 0 is the output
+  state.busMask = 1;
+  state.buses[0] = (MixBus) { .volume = 1.f, .gain = 1.f, .level = 1.f, .effects = EFFECT_ALL, .mask = EFFECT_ALL, .used = true };
+
+#ifndef LOVR_DISABLE_THREAD
+  atomic_init(&state.mixBatch, 0);
+  atomic_init(&state.mixWork, 0);
+  atomic_init(&state.mixDone, 0);
+  atomic_init(&state.mixSleepers, 0);
+  atomic_init(&state.mixQuit, 0);
+  lovrAssert(mtx_init(&state.mixLock, mtx_plain) == thrd_success, "Failed to create audio mixing lock");
+  lovrAssert(cnd_init(&state.mixCond) == thrd_success, "Failed to create audio mixing condition variable");
+  state.mixThreadCount = MIN(threads, MAX_MIX_THREADS);
+  for (uint32_t i = 0; i < state.mixThreadCount; i++) {
+    lovrAssert(thrd_create(&state.mixThreads[i], mixLoop, NULL) == thrd_success, "Failed to create audio mixing thread");
+  }
+
+  arr_init(&state.decoding, realloc);
+  arr_init(&state.pending, realloc);
+  atomic_init(&state.decodeQuit, 0);
+  lovrAssert(mtx_init(&state.decodeLock, mtx_plain) == thrd_success, "Failed to create audio decoder lock");
+  lovrAssert(thrd_create(&state.decodeThread, decodeLoop, NULL) == thrd_success, "Failed to create audio decoder thread");
+
+  lovrAssert(mtx_init(&state.geometryMutex, mtx_plain) == thrd_success, "Failed to create audio geometry lock");
+  lovrAssert(cnd_init(&state.geometryCond) == thrd_success, "Failed to create audio geometry condition variable");
+#endif
+
+  arr_init(&state.geometry, realloc);
 
   return state.initialized = true;
 }
@@ -262,13 +1312,45 @@ void lovrAudioDestroy() {
   for (size_t i = 0; i < 2; i++) {
     ma_device_uninit(&state.devices[i]);
   }
-  Source* source;
-  FOREACH_SOURCE(source) lovrRelease(source, lovrSourceDestroy);
-  ma_mutex_uninit(&state.lock);
+#ifndef LOVR_DISABLE_THREAD
+  atomic_store(&state.mixQuit, 1);
+  wake();
+  for (uint32_t i = 0; i < state.mixThreadCount; i++) {
+    thrd_join(state.mixThreads[i], NULL);
+  }
+  cnd_destroy(&state.mixCond);
+  mtx_destroy(&state.mixLock);
+  atomic_store(&state.decodeQuit, 1);
+  thrd_join(state.decodeThread, NULL);
+  for (size_t i = 0; i < state.decoding.length; i++) lovrRelease(state.decoding.data[i], lovrSourceDestroy);
+  for (size_t i = 0; i < state.pending.length; i++) lovrRelease(state.pending.data[i], lovrSourceDestroy);
+  arr_free(&state.decoding);
+  arr_free(&state.pending);
+  mtx_destroy(&state.decodeLock);
+  if (state.geometryThreadStarted) {
+    mtx_lock(&state.geometryMutex);
+    state.geometryQuit = true;
+    cnd_signal(&state.geometryCond);
+    mtx_unlock(&state.geometryMutex);
+    thrd_join(state.geometryThread, NULL);
+  }
+  cnd_destroy(&state.geometryCond);
+  mtx_destroy(&state.geometryMutex);
+#endif
+  for (size_t i = 0; i < state.geometry.length; i++) {
+    free(state.geometry.data[i].vertices);
+    free(state.geometry.data[i].indices);
+  }
+  arr_free(&state.geometry);
+  drain();
+  for (uint32_t i = 0; i < state.sourceCount; i++) {
+    lovrRelease(state.sources[i], lovrSourceDestroy);
+  }
   ma_context_uninit(&state.context);
   lovrRelease(state.sinks[AUDIO_PLAYBACK], lovrSoundDestroy);
   lovrRelease(state.sinks[AUDIO_CAPTURE], lovrSoundDestroy);
   if (state.spatializer) state.spatializer->destroy();
+  if (state.panning) simpleSpatializer.destroy();
   ma_data_converter_uninit(&state.playbackConverter);
   memset(&state, 0, sizeof(state));
 }
@@ -290,7 +1372,7 @@ void lovrAudioEnumerateDevices(AudioType type, AudioDeviceCallback* callback, vo
   ma_context_enumerate_devices(&state.context, type == AUDIO_PLAYBACK ? enumPlayback : enumCapture, userdata);
 }
 
-bool lovrAudioSetDevice(AudioType type, void* id, size_t size, Sound* sink, AudioShareMode shareMode) {
+bool lovrAudioSetDevice(AudioType type, void* id, size_t size, Sound* sink, AudioShareMode shareMode, uint32_t periodSize, uint32_t periodCount) {
   if (id && size != sizeof(ma_device_id)) return false;
 
   // If no sink is provided for a capture device, one is created internally
@@ -307,6 +1389,10 @@ bool lovrAudioSetDevice(AudioType type, void* id, size_t size, Sound* sink, Audi
   lovrRelease(state.sinks[type], lovrSoundDestroy);
   state.sinks[type] = sink;
 
+  if (type == AUDIO_PLAYBACK) {
+    state.leftoverFrames = 0;
+  }
+
 #ifdef ANDROID
   // XXX<nevyn> miniaudio doesn't seem to be happy to set a specific device an android (fails with
   // error -2 on device init). Since there is only one playback and one capture device in OpenSL,
@@ -328,7 +1414,8 @@ bool lovrAudioSetDevice(AudioType type, void* id, size_t size, Sound* sink, Audi
     config.playback.format = ma_format_f32;
     config.playback.channels = OUTPUT_CHANNELS;
     config.sampleRate = SAMPLE_RATE;
-    if (sink) {
+    state.playbackResample = sink && lovrSoundGetSampleRate(sink) != SAMPLE_RATE;
+    if (state.playbackResample) {
       ma_data_converter_config converterConfig = ma_data_converter_config_init_default();
       converterConfig.formatIn = config.playback.format;
       converterConfig.formatOut = miniaudioFormats[lovrSoundGetFormat(sink)];
@@ -352,14 +1439,61 @@ bool lovrAudioSetDevice(AudioType type, void* id, size_t size, Sound* sink, Audi
   }
 
 #ifndef EMSCRIPTEN // Web needs to use the default bigger buffer size to prevent stutters
-  config.periodSizeInFrames = BUFFER_SIZE;
+  config.periodSizeInFrames = periodSize > 0 ? periodSize : BUFFER_SIZE;
 #endif
+  config.periods = periodCount;
+  config.performanceProfile = ma_performance_profile_low_latency;
   config.dataCallback = callbacks[type];
 
   ma_result result = ma_device_init(&state.context, &config, &state.devices[type]);
+
+  // The mixer works in blocks that evenly divide the device period, so callbacks don't need to go
+  // through the leftovers.  When the device is resampling, the callback size can wander anyway.
+  if (result == MA_SUCCESS && type == AUDIO_PLAYBACK) {
+    ma_device* device = &state.devices[type];
+    uint32_t period = device->playback.internalSampleRate == SAMPLE_RATE ? device->playback.internalPeriodSizeInFrames : config.periodSizeInFrames;
+    uint32_t block = MIN(period, BUFFER_SIZE);
+    while (block > 0 && period % block) block--;
+    if (state.spatializer->needFixedBuffer || period == 0) {
+      state.blockSize = BUFFER_SIZE;
+    } else {
+      state.blockSize = block >= 32 ? block : MIN(period, BUFFER_SIZE);
+    }
+  }
+
   return result == MA_SUCCESS;
 }
 
+// Seconds between mixing a frame and hearing it, roughly (the device's buffering plus a block)
+double lovrAudioGetLatency(void) {
+  ma_device* device = &state.devices[AUDIO_PLAYBACK];
+  if (device->playback.internalSampleRate == 0) return 0.;
+  uint32_t frames = device->playback.internalPeriodSizeInFrames * device->playback.internalPeriods;
+  return (double) frames / device->playback.internalSampleRate + (double) state.blockSize / SAMPLE_RATE;
+}
+
+void lovrAudioGetStats(AudioStats* stats) {
+  uint32_t callbacks = atomic_load_explicit(&state.stats.callbacks, memory_order_acquire);
+  double n = MAX(callbacks, 1);
+  stats->callbacks = callbacks;
+  stats->underruns = atomic_load_explicit(&state.stats.underruns, memory_order_relaxed);
+  stats->starved = atomic_load_explicit(&state.stats.starved, memory_order_relaxed);
+  stats->voices = atomic_load_explicit(&state.stats.voices, memory_order_relaxed);
+  stats->virtualVoices = atomic_load_explicit(&state.stats.virtualVoices, memory_order_relaxed);
+  stats->period = atomic_load_explicit(&state.stats.period, memory_order_relaxed) / (double) SAMPLE_RATE;
+  stats->mixTimeMin = callbacks ? atomic_load_explicit(&state.stats.mixMin, memory_order_relaxed) / 1e9 : 0.;
+  stats->mixTimeAverage = atomic_load_explicit(&state.stats.mixTotal, memory_order_relaxed) / 1e6 / n;
+  stats->mixTimeMax = atomic_load_explicit(&state.stats.mixMax, memory_order_relaxed) / 1e9;
+  stats->spatializerTime = atomic_load_explicit(&state.stats.spatializerTotal, memory_order_relaxed) / 1e6 / n;
+  stats->decodeTime = atomic_load_explicit(&state.stats.decodeTotal, memory_order_relaxed) / 1e6 / n;
+  stats->streamTime = atomic_load_explicit(&state.stats.streamTotal, memory_order_relaxed) / 1e6 / n;
+}
+
+// The audio thread (and the decoder thread) reset their stats the next time they run
+void lovrAudioResetStats(void) {
+  atomic_fetch_add_explicit(&state.stats.reset, 1, memory_order_release);
+}
+
 bool lovrAudioStart(AudioType type) {
   return ma_device_start(&state.devices[type]) == MA_SUCCESS;
 }
@@ -372,6 +1506,18 @@ bool lovrAudioIsStarted(AudioType type) {
   return ma_device_is_started(&state.devices[type]);
 }
 
+// The callback gets the captured frames straight from the device, in the capture sink's format, on
+// the device's thread, before they're copied into the sink.  It needs to return quickly, handing
+// the frames to an encoder or a queue, or the device will drop frames.  The capture device is
+// stopped while the callback is swapped so it never sees a half-changed callback and userdata.
+void lovrAudioSetCaptureCallback(AudioCaptureCallback* callback, void* userdata) {
+  bool started = lovrAudioIsStarted(AUDIO_CAPTURE);
+  if (started) lovrAudioStop(AUDIO_CAPTURE);
+  state.captureCallback = callback;
+  state.captureUserdata = userdata;
+  if (started) lovrAudioStart(AUDIO_CAPTURE);
+}
+
 float lovrAudioGetVolume(VolumeUnit units) {
   float volume = 0.f;
   ma_device_get_master_volume(&state.devices[AUDIO_PLAYBACK], &volume);
@@ -389,28 +1535,217 @@ void lovrAudioGetPose(float position[4], float orientation[4]) {
 }
 
 void lovrAudioSetPose(float position[4], float orientation[4]) {
-  state.spatializer->setListenerPose(position, orientation);
+  memcpy(state.position, position, sizeof(state.position));
+  memcpy(state.orientation, orientation, sizeof(state.orientation));
+  lock();
+  Command* command = push(COMMAND_LISTENER, NULL);
+  memcpy(command->pose, position, 4 * sizeof(float));
+  memcpy(command->pose + 4, orientation, 4 * sizeof(float));
+  submit();
+  unlock();
+}
+
+// Geometry
+
+static void lockGeometry(void) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.geometryMutex);
+#endif
+}
+
+static void unlockGeometry(void) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_unlock(&state.geometryMutex);
+#endif
+}
+
+// Merges the chunks and has the spatializer build them, then swaps the result in.  Called with the
+// geometry mutex held, which is released during the slow parts so chunks can keep changing.  If
+// they do, the stale build is thrown away and the next pass builds the newer version.
+static void rebuildGeometry(void) {
+  uint32_t version = state.geometryVersion;
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+  for (size_t i = 0; i < state.geometry.length; i++) {
+    vertexCount += state.geometry.data[i].vertexCount;
+    indexCount += state.geometry.data[i].indexCount;
+  }
+
+  // This runs on the geometry thread, where errors can't be thrown, so running out of memory just
+  // skips the build
+  float* vertices = malloc(MAX(vertexCount, 1) * 3 * sizeof(float));
+  uint32_t* indices = malloc(MAX(indexCount, 1) * sizeof(uint32_t));
+  AudioMaterial* materials = malloc(MAX(indexCount / 3, 1) * sizeof(AudioMaterial));
+  if (!vertices || !indices || !materials) {
+    free(vertices);
+    free(indices);
+    free(materials);
+    state.geometryBuilt = version;
+    return;
+  }
+
+  uint32_t baseVertex = 0;
+  float* vertex = vertices;
+  uint32_t* index = indices;
+  AudioMaterial* material = materials;
+  for (size_t i = 0; i < state.geometry.length; i++) {
+    GeometryChunk* chunk = &state.geometry.data[i];
+    memcpy(vertex, chunk->vertices, chunk->vertexCount * 3 * sizeof(float));
+    for (uint32_t j = 0; j < chunk->indexCount; j++) {
+      index[j] = chunk->indices[j] + baseVertex;
+    }
+    for (uint32_t j = 0; j < chunk->indexCount / 3; j++) {
+      material[j] = chunk->material;
+    }
+    vertex += chunk->vertexCount * 3;
+    index += chunk->indexCount;
+    material += chunk->indexCount / 3;
+    baseVertex += chunk->vertexCount;
+  }
+
+  unlockGeometry();
+  void* geometry = state.spatializer->buildGeometry(vertices, indices, vertexCount, indexCount, materials);
+  free(vertices);
+  free(indices);
+  free(materials);
+  lockGeometry();
+
+  if (version == state.geometryVersion) {
+    if (geometry) {
+      while (atomic_flag_test_and_set_explicit(&state.geometryLock, memory_order_acquire));
+      geometry = state.spatializer->swapGeometry(geometry);
+      atomic_flag_clear_explicit(&state.geometryLock, memory_order_release);
+    }
+    state.geometryBuilt = version;
+  }
+
+  if (geometry) {
+    unlockGeometry();
+    state.spatializer->destroyGeometry(geometry);
+    lockGeometry();
+  }
+}
+
+#ifndef LOVR_DISABLE_THREAD
+static int geometryLoop(void* arg) {
+  mtx_lock(&state.geometryMutex);
+  while (!state.geometryQuit) {
+    if (state.geometryBuilt == state.geometryVersion) {
+      cnd_wait(&state.geometryCond, &state.geometryMutex);
+    } else {
+      rebuildGeometry();
+    }
+  }
+  mtx_unlock(&state.geometryMutex);
+  return 0;
+}
+#endif
+
+// Called with the geometry mutex held after the chunks change
+static void updateGeometry(void) {
+  state.geometryVersion++;
+#ifndef LOVR_DISABLE_THREAD
+  if (!state.geometryThreadStarted) {
+    lovrAssert(thrd_create(&state.geometryThread, geometryLoop, NULL) == thrd_success, "Failed to create audio geometry thread");
+    state.geometryThreadStarted = true;
+  }
+  cnd_signal(&state.geometryCond);
+#else
+  rebuildGeometry();
+#endif
 }
 
+// Replaces all of the geometry, including chunks, and builds it right away
 bool lovrAudioSetGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material) {
-  ma_mutex_lock(&state.lock);
+  lockGeometry();
+  for (size_t i = 0; i < state.geometry.length; i++) {
+    free(state.geometry.data[i].vertices);
+    free(state.geometry.data[i].indices);
+  }
+  arr_clear(&state.geometry);
+  state.geometryBuilt = ++state.geometryVersion; // Discards any build in progress
+
+  while (atomic_flag_test_and_set_explicit(&state.geometryLock, memory_order_acquire));
   bool success = state.spatializer->setGeometry(vertices, indices, vertexCount, indexCount, material);
-  ma_mutex_unlock(&state.lock);
+  atomic_flag_clear_explicit(&state.geometryLock, memory_order_release);
+  unlockGeometry();
   return success;
 }
 
+// Chunks are built into the spatializer's geometry on a worker thread, so streaming them in and out
+// doesn't stall the caller, and the mixer keeps using the previous geometry until the new one is
+// swapped in.  Returns 0 if the spatializer doesn't support geometry.
+uint32_t lovrAudioAddGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material) {
+  if (!state.spatializer->buildGeometry) {
+    return 0;
+  }
+
+  lovrAssert(indexCount % 3 == 0, "Index count must be a multiple of 3");
+  GeometryChunk chunk = {
+    .vertexCount = vertexCount,
+    .indexCount = indexCount,
+    .material = material,
+    .vertices = malloc(MAX(vertexCount, 1) * 3 * sizeof(float)),
+    .indices = malloc(MAX(indexCount, 1) * sizeof(uint32_t))
+  };
+  lovrAssert(chunk.vertices && chunk.indices, "Out of memory");
+  memcpy(chunk.vertices, vertices, vertexCount * 3 * sizeof(float));
+  memcpy(chunk.indices, indices, indexCount * sizeof(uint32_t));
+
+  lockGeometry();
+  chunk.id = ++state.geometryId;
+  arr_push(&state.geometry, chunk);
+  updateGeometry();
+  unlockGeometry();
+  return chunk.id;
+}
+
+void lovrAudioRemoveGeometry(uint32_t id) {
+  lockGeometry();
+  for (size_t i = 0; i < state.geometry.length; i++) {
+    if (state.geometry.data[i].id == id) {
+      free(state.geometry.data[i].vertices);
+      free(state.geometry.data[i].indices);
+      arr_splice(&state.geometry, i, 1);
+      updateGeometry();
+      break;
+    }
+  }
+  unlockGeometry();
+}
+
+// Whether the latest chunk changes have been built and are being used by the mixer
+bool lovrAudioIsGeometryReady() {
+  lockGeometry();
+  bool ready = state.geometryBuilt == state.geometryVersion;
+  unlockGeometry();
+  return ready;
+}
+
 const char* lovrAudioGetSpatializer() {
   return state.spatializer->name;
 }
 
+// How many voices get the full spatializer, the rest are panned.  Doesn't do anything when the
+// spatializer is the simple one.
+uint32_t lovrAudioGetSpatializerVoices() {
+  return atomic_load_explicit(&state.detailLimit, memory_order_relaxed);
+}
+
+void lovrAudioSetSpatializerVoices(uint32_t voices) {
+  atomic_store_explicit(&state.detailLimit, MIN(voices, MAX_VOICES), memory_order_relaxed);
+}
+
 void lovrAudioGetAbsorption(float absorption[3]) {
-  memcpy(absorption, state.absorption, 3 * sizeof(float));
+  memcpy(absorption, state.absorption[mixing], 3 * sizeof(float));
 }
 
 void lovrAudioSetAbsorption(float absorption[3]) {
-  ma_mutex_lock(&state.lock);
-  memcpy(state.absorption, absorption, 3 * sizeof(float));
-  ma_mutex_unlock(&state.lock);
+  memcpy(state.absorption[0], absorption, 3 * sizeof(float));
+  lock();
+  memcpy(push(COMMAND_ABSORPTION, NULL)->absorption, absorption, 3 * sizeof(float));
+  submit();
+  unlock();
 }
 
 // Source
@@ -421,12 +1756,14 @@ Source* lovrSourceCreate(Sound* sound, uint32_t effects) {
   lovrAssert(source, "Out of memory");
   source->ref = 1;
   source->index = ~0u;
+  source->entry = ~0u;
+  source->slot = ~0u;
   source->sound = sound;
   lovrRetain(source->sound);
 
-  source->volume = 1.f;
-  source->effects = effects;
-  quat_identity(source->orientation);
+  source->params[0].volume = 1.f;
+  source->params[0].effects = effects;
+  quat_identity(source->params[0].orientation);
 
   ma_data_converter_config config = ma_data_converter_config_init_default();
   config.formatIn = miniaudioFormats[lovrSoundGetFormat(sound)];
@@ -436,7 +1773,8 @@ Source* lovrSourceCreate(Sound* sound, uint32_t effects) {
   config.sampleRateIn = lovrSoundGetSampleRate(sound);
   config.sampleRateOut = SAMPLE_RATE;
 
-  if (config.formatIn != config.formatOut || config.channelsIn != config.channelsOut || config.sampleRateIn != config.sampleRateOut) {
+  // Only resampling needs a converter, other conversions are done while decoding (see decode)
+  if (config.sampleRateIn != config.sampleRateOut) {
     source->converter = malloc(sizeof(ma_data_converter));
     lovrAssert(source->converter, "Out of memory");
     ma_result status = ma_data_converter_init(&config, source->converter);
@@ -451,16 +1789,14 @@ Source* lovrSourceClone(Source* source) {
   lovrAssert(clone, "Out of memory");
   clone->ref = 1;
   clone->index = ~0u;
+  clone->entry = ~0u;
+  clone->slot = ~0u;
   clone->sound = source->sound;
   lovrRetain(clone->sound);
-  clone->volume = source->volume;
-  memcpy(clone->position, source->position, 4 * sizeof(float));
-  memcpy(clone->orientation, source->orientation, 4 * sizeof(float));
-  clone->radius = source->radius;
-  clone->dipoleWeight = source->dipoleWeight;
-  clone->dipolePower = source->dipolePower;
-  clone->effects = source->effects;
-  clone->looping = source->looping;
+  clone->bus = source->bus;
+  lovrRetain(clone->bus);
+  clone->params[0] = source->params[0];
+  clone->params[0].playing = false;
   if (source->converter) {
     clone->converter = malloc(sizeof(ma_data_converter));
     lovrAssert(clone->converter, "Out of memory");
@@ -473,6 +1809,12 @@ Source* lovrSourceClone(Source* source) {
 void lovrSourceDestroy(void* ref) {
   Source* source = ref;
   lovrRelease(source->sound, lovrSoundDestroy);
+  lovrRelease(source->decoder, lovrSoundDestroy);
+  lovrRelease(source->bus, lovrBusDestroy);
+  if (source->ring) {
+    ma_pcm_rb_uninit(source->ring);
+    free(source->ring);
+  }
   ma_data_converter_uninit(source->converter);
   free(source->converter);
   free(source);
@@ -483,30 +1825,52 @@ Sound* lovrSourceGetSound(Source* source) {
 }
 
 bool lovrSourcePlay(Source* source) {
-  if (state.sourceMask == ~0ull) {
-    return false;
+#ifndef LOVR_DISABLE_THREAD
+  if (!source->ring && lovrSoundIsCompressed(source->sound)) {
+    startDecoding(source);
   }
+#endif
+
+  lock();
+  reclaim();
 
-  ma_mutex_lock(&state.lock);
+  // If the source isn't tracked, give it the first free slot
+  if (source->slot == ~0u) {
+    uint32_t slot = ~0u;
+    for (uint32_t i = 0; i < MAX_SOURCES / 64; i++) {
+      if (state.slots[i] != ~0ull) {
+        slot = 64 * i + (state.slots[i] ? CTZL(~state.slots[i]) : 0);
+        break;
+      }
+    }
 
-  source->playing = true;
+    if (slot == ~0u) {
+      unlock();
+      return false;
+    }
 
-  // If the source isn't tracked, set its index to the right-most zero bit in the mask
-  if (source->index == ~0u) {
-    uint32_t index = state.sourceMask ? CTZL(~state.sourceMask) : 0;
-    state.sourceMask |= (1ull << index);
-    state.sources[index] = source;
-    source->index = index;
+    state.slots[slot / 64] |= (1ull << (slot % 64));
+    state.owners[slot] = source;
+    source->slot = slot;
     lovrRetain(source);
-    state.spatializer->sourceCreate(source);
   }
 
-  ma_mutex_unlock(&state.lock);
+  source->params[0].playing = true;
+  Command* command = push(COMMAND_PLAY, source);
+  command->generation = ++source->generation;
+  command->params = source->params[0];
+  submit();
+  unlock();
   return true;
 }
 
 void lovrSourcePause(Source* source) {
-  source->playing = false;
+  source->params[0].playing = false;
+  if (source->slot != ~0u) {
+    lock();
+    release(source->slot);
+    unlock();
+  }
 }
 
 void lovrSourceStop(Source* source) {
@@ -515,35 +1879,43 @@ void lovrSourceStop(Source* source) {
 }
 
 bool lovrSourceIsPlaying(Source* source) {
-  return source->playing;
+  if (mixing) return source->params[1].playing;
+  return source->params[0].playing && atomic_load_explicit(&source->finished, memory_order_acquire) != source->generation;
 }
 
 bool lovrSourceIsLooping(Source* source) {
-  return source->looping;
+  return source->params[mixing].looping;
 }
 
 void lovrSourceSetLooping(Source* source, bool loop) {
   lovrAssert(loop == false || lovrSoundIsStream(source->sound) == false, "Can't loop streams");
-  source->looping = loop;
+  source->params[0].looping = loop;
+  sendParams(source);
 }
 
 float lovrSourceGetVolume(Source* source, VolumeUnit units) {
-  return units == UNIT_LINEAR ? source->volume : linearToDb(source->volume);
+  float volume = source->params[mixing].volume;
+  return units == UNIT_LINEAR ? volume : linearToDb(volume);
 }
 
 void lovrSourceSetVolume(Source* source, float volume, VolumeUnit units) {
   if (units == UNIT_DECIBELS) volume = dbToLinear(volume);
-  source->volume = CLAMP(volume, 0.f, 1.f);
+  source->params[0].volume = CLAMP(volume, 0.f, 1.f);
+  sendParams(source);
 }
 
 void lovrSourceSeek(Source* source, double time, TimeUnit units) {
-  ma_mutex_lock(&state.lock);
-  source->offset = units == UNIT_SECONDS ? (uint32_t) (time * lovrSoundGetSampleRate(source->sound) + .5) : (uint32_t) time;
-  ma_mutex_unlock(&state.lock);
+  uint32_t offset = units == UNIT_SECONDS ? (uint32_t) (time * lovrSoundGetSampleRate(source->sound) + .5) : (uint32_t) time;
+  atomic_store_explicit(&source->cursor, offset, memory_order_relaxed);
+  lock();
+  push(COMMAND_SEEK, source)->offset = offset;
+  submit();
+  unlock();
 }
 
 double lovrSourceTell(Source* source, TimeUnit units) {
-  return units == UNIT_SECONDS ? (double) source->offset / lovrSoundGetSampleRate(source->sound) : source->offset;
+  uint32_t offset = atomic_load_explicit(&source->cursor, memory_order_relaxed);
+  return units == UNIT_SECONDS ? (double) offset / lovrSoundGetSampleRate(source->sound) : offset;
 }
 
 double lovrSourceGetDuration(Source* source, TimeUnit units) {
@@ -552,49 +1924,78 @@ double lovrSourceGetDuration(Source* source, TimeUnit units) {
 }
 
 bool lovrSourceUsesSpatializer(Source* source) {
-  return source->effects != EFFECT_NONE; // Currently, all effects require the spatializer
+  return source->params[mixing].effects != EFFECT_NONE; // Currently, all effects require the spatializer
 }
 
 void lovrSourceGetPose(Source *source, float position[4], float orientation[4]) {
-  memcpy(position, source->position, sizeof(source->position));
-  memcpy(orientation, source->orientation, sizeof(source->orientation));
+  SourceParams* params = &source->params[mixing];
+  memcpy(position, params->position, sizeof(params->position));
+  memcpy(orientation, params->orientation, sizeof(params->orientation));
 }
 
 void lovrSourceSetPose(Source *source, float position[4], float orientation[4]) {
-  ma_mutex_lock(&state.lock);
-  memcpy(source->position, position, sizeof(source->position));
-  memcpy(source->orientation, orientation, sizeof(source->orientation));
-  ma_mutex_unlock(&state.lock);
+  SourceParams* params = &source->params[0];
+  memcpy(params->position, position, sizeof(params->position));
+  memcpy(params->orientation, orientation, sizeof(params->orientation));
+  sendParams(source);
+}
+
+Bus* lovrSourceGetBus(Source* source) {
+  return source->bus;
+}
+
+void lovrSourceSetBus(Source* source, Bus* bus) {
+  lovrRetain(bus);
+  lovrRelease(source->bus, lovrBusDestroy);
+  source->bus = bus;
+  source->params[0].bus = bus ? bus->index : 0;
+  sendParams(source);
+}
+
+int32_t lovrSourceGetPriority(Source* source) {
+  return source->params[mixing].priority;
+}
+
+void lovrSourceSetPriority(Source* source, int32_t priority) {
+  source->params[0].priority = priority;
+  sendParams(source);
 }
 
 float lovrSourceGetRadius(Source* source) {
-  return source->radius;
+  return source->params[mixing].radius;
 }
 
 void lovrSourceSetRadius(Source* source, float radius) {
-  source->radius = radius;
+  source->params[0].radius = radius;
+  sendParams(source);
 }
 
 void lovrSourceGetDirectivity(Source* source, float* weight, float* power) {
-  *weight = source->dipoleWeight;
-  *power = source->dipolePower;
+  *weight = source->params[mixing].dipoleWeight;
+  *power = source->params[mixing].dipolePower;
 }
 
 void lovrSourceSetDirectivity(Source* source, float weight, float power) {
-  source->dipoleWeight = weight;
-  source->dipolePower = power;
+  source->params[0].dipoleWeight = weight;
+  source->params[0].dipolePower = power;
+  sendParams(source);
 }
 
 bool lovrSourceIsEffectEnabled(Source* source, Effect effect) {
-  return source->effects == EFFECT_NONE ? false : (source->effects & (1 << effect));
+  uint8_t effects = source->params[mixing].effects;
+  if (effects == EFFECT_NONE) return false;
+  if (mixing) effects &= state.buses[source->params[1].bus].mask; // The mixer applies the Bus effects
+  return effects & (1 << effect);
 }
 
 void lovrSourceSetEffectEnabled(Source* source, Effect effect, bool enabled) {
-  if (enabled && source->effects != EFFECT_NONE) {
-    source->effects |= (1 << effect);
+  SourceParams* params = &source->params[0];
+  if (enabled && params->effects != EFFECT_NONE) {
+    params->effects |= (1 << effect);
   } else {
-    source->effects &= ~(1 << effect);
+    params->effects &= ~(1 << effect);
   }
+  sendParams(source);
 }
 
 intptr_t* lovrSourceGetSpatializerMemoField(Source* source) {
@@ -604,3 +2005,75 @@ intptr_t* lovrSourceGetSpatializerMemoField(Source* source) {
 uint32_t lovrSourceGetIndex(Source* source) {
   return source->index;
 }
+
+// Bus
+
+static void sendBus(Bus* bus, bool reset) {
+  lock();
+  Command* command = push(COMMAND_BUS, NULL);
+  command->bus.index = bus->index;
+  command->bus.parent = bus->parent ? bus->parent->index : 0;
+  command->bus.volume = bus->volume;
+  command->bus.effects = bus->effects;
+  command->bus.reset = reset;
+  submit();
+  unlock();
+}
+
+Bus* lovrBusCreate(Bus* parent) {
+  while (atomic_flag_test_and_set_explicit(&state.busLock, memory_order_acquire));
+  uint32_t index = ~state.busMask ? CTZL(~state.busMask) : ~0u;
+  if (index != ~0u) state.busMask |= (1ull << index);
+  atomic_flag_clear_explicit(&state.busLock, memory_order_release);
+  lovrAssert(index != ~0u, "Too many Buses (the limit is %d)", MAX_BUSES - 1);
+
+  Bus* bus = calloc(1, sizeof(Bus));
+  lovrAssert(bus, "Out of memory");
+  bus->ref = 1;
+  bus->index = index;
+  bus->parent = parent;
+  lovrRetain(parent);
+  bus->volume = 1.f;
+  bus->effects = EFFECT_ALL;
+  sendBus(bus, true);
+  return bus;
+}
+
+// This can run on the audio thread (when it lets go of the last Source using the Bus), so it can't
+// send commands.  It doesn't need to, nothing mixes into the Bus anymore and the mixer's copy is
+// overwritten when the index is reused.
+void lovrBusDestroy(void* ref) {
+  Bus* bus = ref;
+  while (atomic_flag_test_and_set_explicit(&state.busLock, memory_order_acquire));
+  state.busMask &= ~(1ull << bus->index);
+  atomic_flag_clear_explicit(&state.busLock, memory_order_release);
+  lovrRelease(bus->parent, lovrBusDestroy);
+  free(bus);
+}
+
+Bus* lovrBusGetParent(Bus* bus) {
+  return bus->parent;
+}
+
+float lovrBusGetVolume(Bus* bus, VolumeUnit units) {
+  return units == UNIT_LINEAR ? bus->volume : linearToDb(bus->volume);
+}
+
+void lovrBusSetVolume(Bus* bus, float volume, VolumeUnit units) {
+  if (units == UNIT_DECIBELS) volume = dbToLinear(volume);
+  bus->volume = CLAMP(volume, 0.f, 1.f);
+  sendBus(bus, false);
+}
+
+bool lovrBusIsEffectEnabled(Bus* bus, Effect effect) {
+  return bus->effects & (1 << effect);
+}
+
+void lovrBusSetEffectEnabled(Bus* bus, Effect effect, bool enabled) {
+  if (enabled) {
+    bus->effects |= (1 << effect);
+  } else {
+    bus->effects &= ~(1 << effect);
+  }
+  sendBus(bus, false);
+}
@@ -1,3 +1,4 @@
+#include "core/os.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
@@ -6,11 +7,14 @@
 
 #define SAMPLE_RATE 48000
 #define BUFFER_SIZE 256
-#define MAX_SOURCES 64
+#define MAX_SOURCES 4096
+#define MAX_VOICES 64
+#define MAX_BUSES 64
 
 struct Sound;
 
 typedef struct Source Source;
+typedef struct Bus Bus;
 
 typedef enum {
   EFFECT_ABSORPTION,
@@ -47,6 +51,23 @@ typedef enum {
   AUDIO_CAPTURE
 } AudioType;
 
+// Times are in seconds, and everything except the voice counts and period covers every playback
+// callback since the stats were last reset.  Times on worker threads are summed.
+typedef struct {
+  uint32_t callbacks;
+  uint32_t underruns; // Callbacks that took longer to mix than the audio they produced lasts
+  uint32_t starved; // Voice buffers that went silent because the decoder thread was behind
+  uint32_t voices; // Last callback
+  uint32_t virtualVoices; // Playing Sources that didn't get a voice, last callback
+  double period; // Length of the audio in the last callback
+  double mixTimeMin;
+  double mixTimeAverage;
+  double mixTimeMax;
+  double spatializerTime; // Average per callback, like the other times below
+  double decodeTime; // Reading and resampling voices on the mixer
+  double streamTime; // Decoding compressed Sounds ahead on the decoder thread
+} AudioStats;
+
 typedef enum {
   UNIT_SECONDS,
   UNIT_FRAMES
@@ -58,20 +79,30 @@ typedef enum {
 } VolumeUnit;
 
 typedef void AudioDeviceCallback(const void* id, size_t size, const char* name, bool isDefault, void* userdata);
+typedef void AudioCaptureCallback(const void* frames, uint32_t count, void* userdata);
 
-bool lovrAudioInit(const char* spatializer);
+bool lovrAudioInit(const char* spatializer, uint32_t voices, uint32_t threads, uint64_t affinity, os_thread_priority priority);
 void lovrAudioDestroy(void);
 void lovrAudioEnumerateDevices(AudioType type, AudioDeviceCallback* callback, void* userdata);
-bool lovrAudioSetDevice(AudioType type, void* id, size_t size, struct Sound* sink, AudioShareMode shareMode);
+bool lovrAudioSetDevice(AudioType type, void* id, size_t size, struct Sound* sink, AudioShareMode shareMode, uint32_t periodSize, uint32_t periodCount);
+double lovrAudioGetLatency(void);
+void lovrAudioGetStats(AudioStats* stats);
+void lovrAudioResetStats(void);
 bool lovrAudioStart(AudioType type);
 bool lovrAudioStop(AudioType type);
 bool lovrAudioIsStarted(AudioType type);
+void lovrAudioSetCaptureCallback(AudioCaptureCallback* callback, void* userdata);
 float lovrAudioGetVolume(VolumeUnit units);
 void lovrAudioSetVolume(float volume, VolumeUnit units);
 void lovrAudioGetPose(float position[4], float orientation[4]);
 void lovrAudioSetPose(float position[4], float orientation[4]);
 bool lovrAudioSetGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material);
+uint32_t lovrAudioAddGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material);
+void lovrAudioRemoveGeometry(uint32_t id);
+bool lovrAudioIsGeometryReady(void);
 const char* lovrAudioGetSpatializer(void);
+uint32_t lovrAudioGetSpatializerVoices(void);
+void lovrAudioSetSpatializerVoices(uint32_t voices);
 void lovrAudioGetAbsorption(float absorption[3]);
 void lovrAudioSetAbsorption(float absorption[3]);
 
@@ -95,9 +126,23 @@ double lovrSourceGetDuration(Source* source, TimeUnit units);
 bool lovrSourceUsesSpatializer(Source* source);
 void lovrSourceGetPose(Source* source, float position[4], float orientation[4]);
 void lovrSourceSetPose(Source* source, float position[4], float orientation[4]);
+Bus* lovrSourceGetBus(Source* source);
+void lovrSourceSetBus(Source* source, Bus* bus);
+int32_t lovrSourceGetPriority(Source* source);
+void lovrSourceSetPriority(Source* source, int32_t priority);
 float lovrSourceGetRadius(Source* source);
 void lovrSourceSetRadius(Source* source, float radius);
 void lovrSourceGetDirectivity(Source* source, float* weight, float* power);
 void lovrSourceSetDirectivity(Source* source, float weight, float power);
 bool lovrSourceIsEffectEnabled(Source* source, Effect effect);
 void lovrSourceSetEffectEnabled(Source* Source, Effect effect, bool enabled);
+
+// Bus
+
+Bus* lovrBusCreate(Bus* parent);
+void lovrBusDestroy(void* ref);
+Bus* lovrBusGetParent(Bus* bus);
+float lovrBusGetVolume(Bus* bus, VolumeUnit units);
+void lovrBusSetVolume(Bus* bus, float volume, VolumeUnit units);
+bool lovrBusIsEffectEnabled(Bus* bus, Effect effect);
+void lovrBusSetEffectEnabled(Bus* bus, Effect effect, bool enabled);
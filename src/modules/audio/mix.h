@@ -0,0 +1,197 @@
+#include "core/util.h"
+#include <stdint.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIX_SSE
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIX_SSE2
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MIX_NEON
+#endif
+
+#pragma once
+
+// Mixing kernels, with SSE and NEON paths (the scalar loops handle any leftover frames).  Stereo
+// buffers are interleaved, frame counts are per channel, and buffers don't need to be aligned.  The
+// SSE path also covers WebAssembly SIMD, which Emscripten provides xmmintrin.h for.
+
+// dst += src * gain, where gain moves linearly from `from` to `to` over the frames (stereo)
+static inline void mix_ramp(float* dst, const float* src, uint32_t frames, float from, float to) {
+  float step = frames > 0 ? (to - from) / frames : 0.f;
+  uint32_t i = 0;
+#if defined(MIX_SSE)
+  __m128 g = _mm_setr_ps(from, from, from + step, from + step);
+  __m128 dg = _mm_set1_ps(2.f * step);
+  for (; i + 2 <= frames; i += 2) {
+    __m128 d = _mm_loadu_ps(dst + 2 * i);
+    __m128 s = _mm_loadu_ps(src + 2 * i);
+    _mm_storeu_ps(dst + 2 * i, _mm_add_ps(d, _mm_mul_ps(s, g)));
+    g = _mm_add_ps(g, dg);
+  }
+#elif defined(MIX_NEON)
+  float init[4] = { from, from, from + step, from + step };
+  float32x4_t g = vld1q_f32(init);
+  float32x4_t dg = vdupq_n_f32(2.f * step);
+  for (; i + 2 <= frames; i += 2) {
+    float32x4_t d = vld1q_f32(dst + 2 * i);
+    float32x4_t s = vld1q_f32(src + 2 * i);
+    vst1q_f32(dst + 2 * i, vmlaq_f32(d, s, g));
+    g = vaddq_f32(g, dg);
+  }
+#endif
+  for (; i < frames; i++) {
+    float gain = from + step * i;
+    dst[2 * i + 0] += src[2 * i + 0] * gain;
+    dst[2 * i + 1] += src[2 * i + 1] * gain;
+  }
+}
+
+// Pans mono src into stereo dst with a gain per channel.  Each gain moves towards its target by at
+// most rate per frame, and is updated to where it ended up.
+static inline void mix_pan(float* dst, const float* src, uint32_t frames, float gain[2], const float target[2], float rate) {
+  float step[2], lo[2], hi[2];
+  for (uint32_t c = 0; c < 2; c++) {
+    step[c] = target[c] > gain[c] ? rate : -rate;
+    lo[c] = MIN(gain[c], target[c]);
+    hi[c] = MAX(gain[c], target[c]);
+  }
+
+  uint32_t i = 0;
+#if defined(MIX_SSE)
+  __m128 g = _mm_setr_ps(gain[0], gain[1], gain[0] + step[0], gain[1] + step[1]);
+  __m128 dg = _mm_setr_ps(2.f * step[0], 2.f * step[1], 2.f * step[0], 2.f * step[1]);
+  __m128 vlo = _mm_setr_ps(lo[0], lo[1], lo[0], lo[1]);
+  __m128 vhi = _mm_setr_ps(hi[0], hi[1], hi[0], hi[1]);
+  for (; i + 4 <= frames; i += 4) {
+    __m128 s = _mm_loadu_ps(src + i);
+    __m128 g0 = _mm_min_ps(_mm_max_ps(g, vlo), vhi);
+    g = _mm_add_ps(g, dg);
+    __m128 g1 = _mm_min_ps(_mm_max_ps(g, vlo), vhi);
+    g = _mm_add_ps(g, dg);
+    _mm_storeu_ps(dst + 2 * i + 0, _mm_mul_ps(_mm_unpacklo_ps(s, s), g0));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_mul_ps(_mm_unpackhi_ps(s, s), g1));
+  }
+#elif defined(MIX_NEON)
+  float init[4] = { gain[0], gain[1], gain[0] + step[0], gain[1] + step[1] };
+  float steps[4] = { 2.f * step[0], 2.f * step[1], 2.f * step[0], 2.f * step[1] };
+  float los[4] = { lo[0], lo[1], lo[0], lo[1] };
+  float his[4] = { hi[0], hi[1], hi[0], hi[1] };
+  float32x4_t g = vld1q_f32(init);
+  float32x4_t dg = vld1q_f32(steps);
+  float32x4_t vlo = vld1q_f32(los);
+  float32x4_t vhi = vld1q_f32(his);
+  for (; i + 4 <= frames; i += 4) {
+    float32x4x2_t s = vzipq_f32(vld1q_f32(src + i), vld1q_f32(src + i));
+    float32x4_t g0 = vminq_f32(vmaxq_f32(g, vlo), vhi);
+    g = vaddq_f32(g, dg);
+    float32x4_t g1 = vminq_f32(vmaxq_f32(g, vlo), vhi);
+    g = vaddq_f32(g, dg);
+    vst1q_f32(dst + 2 * i + 0, vmulq_f32(s.val[0], g0));
+    vst1q_f32(dst + 2 * i + 4, vmulq_f32(s.val[1], g1));
+  }
+#endif
+  for (; i < frames; i++) {
+    dst[2 * i + 0] = src[i] * CLAMP(gain[0] + step[0] * i, lo[0], hi[0]);
+    dst[2 * i + 1] = src[i] * CLAMP(gain[1] + step[1] * i, lo[1], hi[1]);
+  }
+
+  gain[0] = CLAMP(gain[0] + step[0] * frames, lo[0], hi[0]);
+  gain[1] = CLAMP(gain[1] + step[1] * frames, lo[1], hi[1]);
+}
+
+// Copies mono src into both channels of stereo dst
+static inline void mix_interleave(float* dst, const float* src, uint32_t frames) {
+  uint32_t i = 0;
+#if defined(MIX_SSE)
+  for (; i + 4 <= frames; i += 4) {
+    __m128 s = _mm_loadu_ps(src + i);
+    _mm_storeu_ps(dst + 2 * i + 0, _mm_unpacklo_ps(s, s));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(s, s));
+  }
+#elif defined(MIX_NEON)
+  for (; i + 4 <= frames; i += 4) {
+    float32x4_t s = vld1q_f32(src + i);
+    vst2q_f32(dst + 2 * i, (float32x4x2_t) { { s, s } });
+  }
+#endif
+  for (; i < frames; i++) {
+    dst[2 * i + 0] = dst[2 * i + 1] = src[i];
+  }
+}
+
+// Averages the channels of stereo src into mono dst
+static inline void mix_downmix(float* dst, const float* src, uint32_t frames) {
+  uint32_t i = 0;
+#if defined(MIX_SSE)
+  __m128 half = _mm_set1_ps(.5f);
+  for (; i + 4 <= frames; i += 4) {
+    __m128 a = _mm_loadu_ps(src + 2 * i + 0);
+    __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+    __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+  }
+#elif defined(MIX_NEON)
+  for (; i + 4 <= frames; i += 4) {
+    float32x4x2_t s = vld2q_f32(src + 2 * i);
+    vst1q_f32(dst + i, vmulq_n_f32(vaddq_f32(s.val[0], s.val[1]), .5f));
+  }
+#endif
+  for (; i < frames; i++) {
+    dst[i] = (src[2 * i + 0] + src[2 * i + 1]) * .5f;
+  }
+}
+
+// Converts 16 bit samples to floats (counts are in samples here, not frames)
+static inline void mix_i16_to_f32(float* dst, const int16_t* src, uint32_t samples) {
+  uint32_t i = 0;
+#if defined(MIX_SSE2)
+  __m128 scale = _mm_set1_ps(1.f / 32768.f);
+  for (; i + 8 <= samples; i += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+    _mm_storeu_ps(dst + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+#elif defined(MIX_NEON)
+  for (; i + 8 <= samples; i += 8) {
+    int16x8_t s = vld1q_s16(src + i);
+    vst1q_f32(dst + i + 0, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), 1.f / 32768.f));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), 1.f / 32768.f));
+  }
+#endif
+  for (; i < samples; i++) {
+    dst[i] = src[i] * (1.f / 32768.f);
+  }
+}
+
+// Converts floats to 16 bit samples, clipping anything outside of [-1, 1]
+static inline void mix_f32_to_i16(int16_t* dst, const float* src, uint32_t samples) {
+  uint32_t i = 0;
+#if defined(MIX_SSE2)
+  __m128 scale = _mm_set1_ps(32767.f);
+  __m128 one = _mm_set1_ps(1.f);
+  __m128 minusOne = _mm_set1_ps(-1.f);
+  for (; i + 8 <= samples; i += 8) {
+    __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 0), minusOne), one);
+    __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), minusOne), one);
+    __m128i lo = _mm_cvttps_epi32(_mm_mul_ps(a, scale));
+    __m128i hi = _mm_cvttps_epi32(_mm_mul_ps(b, scale));
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_packs_epi32(lo, hi));
+  }
+#elif defined(MIX_NEON)
+  for (; i + 8 <= samples; i += 8) {
+    int32x4_t lo = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 0), 32767.f));
+    int32x4_t hi = vcvtq_s32_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32767.f));
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  }
+#endif
+  for (; i < samples; i++) {
+    dst[i] = (int16_t) (CLAMP(src[i], -1.f, 1.f) * 32767.f);
+  }
+}
@@ -2,24 +2,49 @@
 
 // Private Source functions for spatializer use
 intptr_t* lovrSourceGetSpatializerMemoField(Source* source);
-uint32_t lovrSourceGetIndex(Source* source);
+uint32_t lovrSourceGetIndex(Source* source); // The Source's voice, less than MAX_VOICES
+
+#define MAX_SPATIALIZER_BATCH 8
+
+// Poses of a batch of Sources, one array per component (x, y, z and x, y, z, w)
+typedef struct {
+  float position[3][MAX_SPATIALIZER_BATCH];
+  float orientation[4][MAX_SPATIALIZER_BATCH];
+} SourcePoses;
 
 typedef struct {
   bool (*init)(void);
   void (*destroy)(void);
   // input is mono, output is interleaved stereo, framesIn is mono frames, framesOut is stereo frames.
-  // Safe to assume framesIn == framesOut unless spatializer requests needFixedBuffer.
+  // Safe to assume framesIn == framesOut.  Frame counts are the mixer's block size, which follows the
+  // device period (up to BUFFER_SIZE) unless the spatializer requests needFixedBuffer.
   // Return value is number of samples written into output.
   uint32_t (*apply)(Source* source, const float* input, float* output, uint32_t framesIn, uint32_t framesOut);
+  // Optional, spatializes up to MAX_SPATIALIZER_BATCH Sources at once instead of calling apply for
+  // each one.  Inputs are mono, outputs are packed one after another (frames stereo frames each).
+  void (*applyBatch)(Source** sources, const float** inputs, float* outputs, const SourcePoses* poses, uint32_t count, uint32_t frames);
   // called at end of frame for any "additional noise", like echo.
   // output is stereo, frames is stereo frames, scratch is a buffer the length of output (in case that helps)
   // return value is number of stereo frames written.
   uint32_t (*tail)(float* scratch, float* output, uint32_t frames);
   void (*setListenerPose)(float position[4], float orientation[4]);
   bool (*setGeometry)(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material);
+  // Optional, splits setGeometry up so geometry can be built on a worker thread while the mixer
+  // keeps using the old geometry.  buildGeometry can't touch anything the mixer uses, it takes a
+  // material per triangle and returns NULL on failure.  swapGeometry installs new geometry and
+  // returns the old, and is called with the geometry lock held so it has to be quick.
+  // destroyGeometry frees geometry that was swapped out, off the audio thread.
+  void* (*buildGeometry)(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial* materials);
+  void* (*swapGeometry)(void* geometry);
+  void (*destroyGeometry)(void* geometry);
   void (*sourceCreate)(Source* source);
   void (*sourceDestroy)(Source* source);
   const char* name;
+  // apply can be called from several mixing threads at once (for different voices).  Otherwise the
+  // mixer serializes calls to it.
+  bool parallel;
+  // apply and tail always get BUFFER_SIZE frames
+  bool needFixedBuffer;
 } Spatializer;
 
 #ifdef LOVR_ENABLE_PHONON
@@ -120,9 +120,9 @@ static struct {
   IPLhandle environmentalRenderer;
   IPLhandle binauralRenderer;
   IPLhandle ambisonicsBinauralEffect;
-  IPLhandle binauralEffect[MAX_SOURCES];
-  IPLhandle directSoundEffect[MAX_SOURCES];
-  IPLhandle convolutionEffect[MAX_SOURCES];
+  IPLhandle binauralEffect[MAX_VOICES];
+  IPLhandle directSoundEffect[MAX_VOICES];
+  IPLhandle convolutionEffect[MAX_VOICES];
   IPLRenderingSettings renderingSettings;
   float listenerPosition[4];
   float listenerOrientation[4];
@@ -168,7 +168,7 @@ bool phonon_init() {
 
 void phonon_destroy() {
   if (state.scratchpad) free(state.scratchpad);
-  for (size_t i = 0; i < MAX_SOURCES; i++) {
+  for (size_t i = 0; i < MAX_VOICES; i++) {
     if (state.binauralEffect[i]) phonon_iplDestroyBinauralEffect(&state.binauralEffect[i]);
     if (state.directSoundEffect[i]) phonon_iplDestroyDirectSoundEffect(&state.directSoundEffect[i]);
     if (state.convolutionEffect[i]) phonon_iplDestroyConvolutionEffect(&state.convolutionEffect[i]);
@@ -178,7 +178,7 @@ void phonon_destroy() {
   if (state.environmentalRenderer) phonon_iplDestroyEnvironmentalRenderer(&state.environmentalRenderer);
   if (state.environment) phonon_iplDestroyEnvironment(&state.environment);
   if (state.mesh) phonon_iplDestroyStaticMesh(&state.mesh);
-  if (state.scene) phonon_iplDestroyStaticMesh(&state.scene);
+  if (state.scene) phonon_iplDestroyScene(&state.scene);
   if (state.context) phonon_iplDestroyContext(&state.context);
   phonon_iplCleanup();
   phonon_dlclose(state.library);
@@ -258,6 +258,11 @@ uint32_t phonon_apply(Source* source, const float* input, float* output, uint32_
   phonon_iplApplyBinauralEffect(state.binauralEffect[index], state.binauralRenderer, tmp, path.direction, interpolation, blend, out);
 
   if (state.mesh && lovrSourceIsEffectEnabled(source, EFFECT_REVERB)) {
+    if (!state.convolutionEffect[index]) {
+      IPLBakedDataIdentifier id = { 0 };
+      phonon_iplCreateConvolutionEffect(state.environmentalRenderer, id, IPL_SIMTYPE_REALTIME, MONO, AMBISONIC, &state.convolutionEffect[index]);
+    }
+
     phonon_iplSetDryAudioForConvolutionEffect(state.convolutionEffect[index], iplSource, in);
   }
 
@@ -300,13 +305,31 @@ void phonon_setListenerPose(float position[4], float orientation[4]) {
   memcpy(state.listenerOrientation, orientation, sizeof(state.listenerOrientation));
 }
 
-bool phonon_setGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material) {
-  if (state.mesh) phonon_iplDestroyStaticMesh(&state.mesh);
-  if (state.scene) phonon_iplDestroyScene(&state.scene);
-  if (state.environment) phonon_iplDestroyEnvironment(&state.environment);
-  if (state.environmentalRenderer) phonon_iplDestroyEnvironment(&state.environmentalRenderer);
+// Everything that depends on the scene is built together, so it can be swapped in as a unit.
+// Convolution effects render into the environmental renderer, so they're retired along with it
+// and recreated for the new one the next time a voice needs reverb.
+typedef struct {
+  IPLhandle scene;
+  IPLhandle mesh;
+  IPLhandle environment;
+  IPLhandle environmentalRenderer;
+  IPLhandle convolutionEffect[MAX_VOICES];
+} PhononGeometry;
+
+void phonon_destroyGeometry(void* ref) {
+  PhononGeometry* geometry = ref;
+  for (size_t i = 0; i < MAX_VOICES; i++) {
+    if (geometry->convolutionEffect[i]) phonon_iplDestroyConvolutionEffect(&geometry->convolutionEffect[i]);
+  }
+  if (geometry->environmentalRenderer) phonon_iplDestroyEnvironmentalRenderer(&geometry->environmentalRenderer);
+  if (geometry->environment) phonon_iplDestroyEnvironment(&geometry->environment);
+  if (geometry->mesh) phonon_iplDestroyStaticMesh(&geometry->mesh);
+  if (geometry->scene) phonon_iplDestroyScene(&geometry->scene);
+  free(geometry);
+}
 
-  IPLMaterial materials[] = {
+void* phonon_buildGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial* materials) {
+  IPLMaterial materialProperties[] = {
     [MATERIAL_GENERIC] = { .10f, .20f, .30f, .05f, .100f, .050f, .030f },
     [MATERIAL_BRICK] = { .03f, .04f, .07f, .05f, .015f, .015f, .015f },
     [MATERIAL_CARPET] = { .24f, .69f, .73f, .05f, .020f, .005f, .003f },
@@ -329,45 +352,82 @@ bool phonon_setGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount
     .numThreads = PHONON_THREADS,
     .irDuration = PHONON_MAX_REVERB,
     .ambisonicsOrder = PHONON_AMBISONIC_ORDER,
-    .maxConvolutionSources = MAX_SOURCES,
+    .maxConvolutionSources = MAX_VOICES,
     .bakingBatchSize = 1,
     .irradianceMinDistance = .1f
   };
 
+  PhononGeometry* geometry = calloc(1, sizeof(PhononGeometry));
   IPLint32* triangleMaterials = malloc(indexCount / 3 * sizeof(IPLint32));
-  if (!triangleMaterials) goto fail;
+  if (!geometry || (!triangleMaterials && indexCount > 0)) goto fail;
 
   for (uint32_t i = 0; i < indexCount / 3; i++) {
-    triangleMaterials[i] = material;
+    triangleMaterials[i] = materials[i];
   }
 
+  IPLint32 materialCount = sizeof(materialProperties) / sizeof(materialProperties[0]);
+
   IPLerror status;
-  status = phonon_iplCreateScene(state.context, NULL, IPL_SCENETYPE_PHONON, 1, materials, NULL, NULL, NULL, NULL, NULL, &state.scene);
+  status = phonon_iplCreateScene(state.context, NULL, IPL_SCENETYPE_PHONON, materialCount, materialProperties, NULL, NULL, NULL, NULL, NULL, &geometry->scene);
   if (status != IPL_STATUS_SUCCESS) goto fail;
 
   if (vertexCount > 0 && indexCount > 0) {
-    status = phonon_iplCreateStaticMesh(state.scene, vertexCount, indexCount / 3, (IPLVector3*) vertices, (IPLTriangle*) indices, triangleMaterials, &state.mesh);
+    status = phonon_iplCreateStaticMesh(geometry->scene, vertexCount, indexCount / 3, (IPLVector3*) vertices, (IPLTriangle*) indices, triangleMaterials, &geometry->mesh);
     if (status != IPL_STATUS_SUCCESS) goto fail;
   }
 
-  status = phonon_iplCreateEnvironment(state.context, NULL, settings, state.scene, NULL, &state.environment);
+  status = phonon_iplCreateEnvironment(state.context, NULL, settings, geometry->scene, NULL, &geometry->environment);
   if (status != IPL_STATUS_SUCCESS) goto fail;
 
-  status = phonon_iplCreateEnvironmentalRenderer(state.context, state.environment, state.renderingSettings, AMBISONIC, NULL, NULL, &state.environmentalRenderer);
+  status = phonon_iplCreateEnvironmentalRenderer(state.context, geometry->environment, state.renderingSettings, AMBISONIC, NULL, NULL, &geometry->environmentalRenderer);
   if (status != IPL_STATUS_SUCCESS) goto fail;
 
   free(triangleMaterials);
-  return true;
+  return geometry;
 
 fail:
   free(triangleMaterials);
-  if (state.mesh) phonon_iplDestroyStaticMesh(&state.mesh);
-  if (state.scene) phonon_iplDestroyScene(&state.scene);
-  if (state.environment) phonon_iplDestroyEnvironment(&state.environment);
-  if (state.environmentalRenderer) phonon_iplDestroyEnvironmentalRenderer(&state.environmentalRenderer);
-  phonon_iplCreateEnvironment(state.context, NULL, settings, NULL, NULL, &state.environment);
-  phonon_iplCreateEnvironmentalRenderer(state.context, state.environment, state.renderingSettings, AMBISONIC, NULL, NULL, &state.environmentalRenderer);
-  return false;
+  if (geometry) phonon_destroyGeometry(geometry);
+  return NULL;
+}
+
+// The new geometry's handles are traded for the current ones, so the same struct comes back holding
+// the old geometry
+void* phonon_swapGeometry(void* ref) {
+  PhononGeometry* geometry = ref;
+  IPLhandle scene = state.scene;
+  IPLhandle mesh = state.mesh;
+  IPLhandle environment = state.environment;
+  IPLhandle environmentalRenderer = state.environmentalRenderer;
+
+  state.scene = geometry->scene;
+  state.mesh = geometry->mesh;
+  state.environment = geometry->environment;
+  state.environmentalRenderer = geometry->environmentalRenderer;
+
+  geometry->scene = scene;
+  geometry->mesh = mesh;
+  geometry->environment = environment;
+  geometry->environmentalRenderer = environmentalRenderer;
+  memcpy(geometry->convolutionEffect, state.convolutionEffect, sizeof(state.convolutionEffect));
+  memset(state.convolutionEffect, 0, sizeof(state.convolutionEffect));
+  return geometry;
+}
+
+bool phonon_setGeometry(float* vertices, uint32_t* indices, uint32_t vertexCount, uint32_t indexCount, AudioMaterial material) {
+  AudioMaterial* materials = malloc(indexCount / 3 * sizeof(AudioMaterial));
+  if (!materials && indexCount > 0) return false;
+
+  for (uint32_t i = 0; i < indexCount / 3; i++) {
+    materials[i] = material;
+  }
+
+  void* geometry = phonon_buildGeometry(vertices, indices, vertexCount, indexCount, materials);
+  free(materials);
+  if (!geometry) return false;
+
+  phonon_destroyGeometry(phonon_swapGeometry(geometry));
+  return true;
 }
 
 void phonon_sourceCreate(Source* source) {
@@ -381,7 +441,7 @@ void phonon_sourceCreate(Source* source) {
     phonon_iplCreateDirectSoundEffect(MONO, MONO, state.renderingSettings, &state.directSoundEffect[index]);
   }
 
-  if (!state.convolutionEffect[index]) {
+  if (!state.convolutionEffect[index] && state.environmentalRenderer) {
     IPLBakedDataIdentifier id = { 0 };
     phonon_iplCreateConvolutionEffect(state.environmentalRenderer, id, IPL_SIMTYPE_REALTIME, MONO, AMBISONIC, &state.convolutionEffect[index]);
   }
@@ -401,7 +461,11 @@ Spatializer phononSpatializer = {
   .tail = phonon_tail,
   .setListenerPose = phonon_setListenerPose,
   .setGeometry = phonon_setGeometry,
+  .buildGeometry = phonon_buildGeometry,
+  .swapGeometry = phonon_swapGeometry,
+  .destroyGeometry = phonon_destroyGeometry,
   .sourceCreate = phonon_sourceCreate,
   .sourceDestroy = phonon_sourceDestroy,
-  .name = "phonon"
+  .name = "phonon",
+  .needFixedBuffer = true
 };
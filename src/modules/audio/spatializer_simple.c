@@ -1,11 +1,12 @@
 #include "spatializer.h"
+#include "audio/mix.h"
 #include "core/maf.h"
 #include "core/util.h"
 #include <math.h>
 
 static struct {
   float listener[16];
-  float gain[MAX_SOURCES][2];
+  float gain[MAX_VOICES][2];
 } state;
 
 bool simple_init(void) {
@@ -17,68 +18,77 @@ void simple_destroy(void) {
   //
 }
 
-uint32_t simple_apply(Source* source, const float* input, float* output, uint32_t frames, uint32_t _frames) {
-  float sourcePos[4], sourceOrientation[4];
-  lovrSourceGetPose(source, sourcePos, sourceOrientation);
-
+void simple_applyBatch(Source** sources, const float** inputs, float* outputs, const SourcePoses* poses, uint32_t count, uint32_t frames) {
   float listenerPos[4] = { 0.f };
+  float leftEar[4] = { -0.1f, 0.0f, 0.0f, 1.0f };
+  float rightEar[4] = { 0.1f, 0.0f, 0.0f, 1.0f };
   mat4_transform(state.listener, listenerPos);
-
-  float target[2] = { 1.f, 1.f };
-  if (lovrSourceIsEffectEnabled(source, EFFECT_SPATIALIZATION)) {
-    float leftEar[4] = { -0.1f, 0.0f, 0.0f, 1.0f };
-    float rightEar[4] = { 0.1f, 0.0f, 0.0f, 1.0f };
-    mat4_transform(state.listener, leftEar);
-    mat4_transform(state.listener, rightEar);
-    float ldistance = vec3_distance(sourcePos, leftEar);
-    float rdistance = vec3_distance(sourcePos, rightEar);
-    target[0] = .5f + (rdistance - ldistance) * 2.5f;
-    target[1] = .5f + (ldistance - rdistance) * 2.5f;
-  }
-
-  float weight, power;
-  lovrSourceGetDirectivity(source, &weight, &power);
-  if (weight > 0.f && power > 0.f) {
-    float sourceDirection[4];
-    float sourceToListener[4];
-    quat_getDirection(sourceOrientation, sourceDirection);
-    vec3_normalize(vec3_sub(vec3_init(sourceToListener, listenerPos), sourcePos));
-    float dot = vec3_dot(sourceToListener, sourceDirection);
-    float factor = powf(fabsf(1.f - weight + weight * dot), power);
-    target[0] *= factor;
-    target[1] *= factor;
-  }
-
-  if (lovrSourceIsEffectEnabled(source, EFFECT_ATTENUATION)) {
-    float distance = vec3_distance(sourcePos, listenerPos);
-    float attenuation = 1.f / MAX(distance, 1.f);
-    target[0] *= attenuation;
-    target[1] *= attenuation;
+  mat4_transform(state.listener, leftEar);
+  mat4_transform(state.listener, rightEar);
+
+  // Distances to the ears and the listener for every Source at once
+  const float* x = poses->position[0];
+  const float* y = poses->position[1];
+  const float* z = poses->position[2];
+  float ldistance[MAX_SPATIALIZER_BATCH];
+  float rdistance[MAX_SPATIALIZER_BATCH];
+  float distance[MAX_SPATIALIZER_BATCH];
+  for (uint32_t i = 0; i < count; i++) {
+    float lx = x[i] - leftEar[0], ly = y[i] - leftEar[1], lz = z[i] - leftEar[2];
+    float rx = x[i] - rightEar[0], ry = y[i] - rightEar[1], rz = z[i] - rightEar[2];
+    float dx = x[i] - listenerPos[0], dy = y[i] - listenerPos[1], dz = z[i] - listenerPos[2];
+    ldistance[i] = sqrtf(lx * lx + ly * ly + lz * lz);
+    rdistance[i] = sqrtf(rx * rx + ry * ry + rz * rz);
+    distance[i] = sqrtf(dx * dx + dy * dy + dz * dz);
   }
 
-  uint32_t index = lovrSourceGetIndex(source);
-  float* gain = state.gain[index];
-
   float lerpDuration = .05f;
   float lerpFrames = SAMPLE_RATE * lerpDuration;
   float lerpRate = 1.f / lerpFrames;
 
-  for (uint32_t c = 0; c < 2; c++) {
-    float sign = target[c] > gain[c] ? 1.f : -1.f;
+  for (uint32_t i = 0; i < count; i++) {
+    Source* source = sources[i];
 
-    uint32_t lerpCount = fabsf(target[c] - gain[c]) / lerpRate;
-    lerpCount = MIN(lerpCount, frames);
+    float target[2] = { 1.f, 1.f };
+    if (lovrSourceIsEffectEnabled(source, EFFECT_SPATIALIZATION)) {
+      target[0] = .5f + (rdistance[i] - ldistance[i]) * 2.5f;
+      target[1] = .5f + (ldistance[i] - rdistance[i]) * 2.5f;
+    }
 
-    for (uint32_t i = 0; i < lerpCount; i++) {
-      output[i * 2 + c] = input[i] * gain[c];
-      gain[c] += lerpRate * sign;
+    float weight, power;
+    lovrSourceGetDirectivity(source, &weight, &power);
+    if (weight > 0.f && power > 0.f) {
+      float sourcePos[4] = { x[i], y[i], z[i], 1.f };
+      float sourceOrientation[4];
+      for (uint32_t c = 0; c < 4; c++) sourceOrientation[c] = poses->orientation[c][i];
+      float sourceDirection[4];
+      float sourceToListener[4];
+      quat_getDirection(sourceOrientation, sourceDirection);
+      vec3_normalize(vec3_sub(vec3_init(sourceToListener, listenerPos), sourcePos));
+      float dot = vec3_dot(sourceToListener, sourceDirection);
+      float factor = powf(fabsf(1.f - weight + weight * dot), power);
+      target[0] *= factor;
+      target[1] *= factor;
     }
 
-    for (uint32_t i = lerpCount; i < frames; i++) {
-      output[i * 2 + c] = input[i] * gain[c];
+    if (lovrSourceIsEffectEnabled(source, EFFECT_ATTENUATION)) {
+      float attenuation = 1.f / MAX(distance[i], 1.f);
+      target[0] *= attenuation;
+      target[1] *= attenuation;
     }
+
+    uint32_t index = lovrSourceGetIndex(source);
+    mix_pan(outputs + i * frames * 2, inputs[i], frames, state.gain[index], target, lerpRate);
   }
+}
 
+uint32_t simple_apply(Source* source, const float* input, float* output, uint32_t frames, uint32_t _frames) {
+  float position[4], orientation[4];
+  lovrSourceGetPose(source, position, orientation);
+  SourcePoses poses;
+  for (uint32_t c = 0; c < 3; c++) poses.position[c][0] = position[c];
+  for (uint32_t c = 0; c < 4; c++) poses.orientation[c][0] = orientation[c];
+  simple_applyBatch(&source, &input, output, &poses, 1, frames);
   return frames;
 }
 
@@ -110,10 +120,12 @@ Spatializer simpleSpatializer = {
   .init = simple_init,
   .destroy = simple_destroy,
   .apply = simple_apply,
+  .applyBatch = simple_applyBatch,
   .tail = simple_tail,
   .setListenerPose = simple_setListenerPose,
   .setGeometry = simple_setGeometry,
   .sourceCreate = simple_sourceCreate,
   .sourceDestroy = simple_sourceDestroy,
-  .name = "simple"
+  .name = "simple",
+  .parallel = true
 };
@@ -1,6 +1,8 @@
 #include "data/blob.h"
+#include "core/fs.h"
 #include "core/util.h"
 #include <stdlib.h>
+#include <string.h>
 
 Blob* lovrBlobCreate(void* data, size_t size, const char* name) {
   Blob* blob = calloc(1, sizeof(Blob));
@@ -12,8 +14,56 @@ Blob* lovrBlobCreate(void* data, size_t size, const char* name) {
   return blob;
 }
 
+static void onTempReset(void* ref) {
+  Blob* blob = ref;
+  blob->data = NULL;
+  blob->size = 0;
+  lovrRelease(blob, lovrBlobDestroy);
+}
+
+// Copies the data if there is any (zeroes it otherwise) and adds a null terminator, like newBlob
+Blob* lovrBlobCreateTemporary(const void* data, size_t size, const char* name) {
+  char* memory = temp_alloc(size + 1);
+  if (data) {
+    memcpy(memory, data, size);
+  } else {
+    memset(memory, 0, size);
+  }
+  memory[size] = '\0';
+  Blob* blob = lovrBlobCreate(memory, size, name);
+  blob->temporary = true;
+  lovrRetain(blob);
+  temp_defer(onTempReset, blob);
+  return blob;
+}
+
+// A view shares the memory of a range of another Blob and keeps it alive
+Blob* lovrBlobCreateView(Blob* parent, size_t offset, size_t size, const char* name) {
+  lovrAssert(!parent->temporary, "Temporary Blobs can not have views");
+  lovrAssert(offset + size <= parent->size, "Blob view is out of bounds");
+  Blob* blob = lovrBlobCreate((char*) parent->data + offset, size, name);
+  blob->parent = parent;
+  lovrRetain(parent);
+  return blob;
+}
+
 void lovrBlobDestroy(void* ref) {
   Blob* blob = ref;
-  free(blob->data);
+  if (blob->parent) {
+    lovrRelease(blob->parent, lovrBlobDestroy);
+  } else if (blob->mapped) {
+    fs_unmap(blob->data, blob->size);
+  } else if (!blob->temporary) {
+    free(blob->data);
+  }
   free(blob);
 }
+
+// For Blobs backed by a file mapping, lets the OS drop a range's pages until they're read again
+void lovrBlobEvict(Blob* blob, size_t offset, size_t size) {
+  Blob* root = blob;
+  while (root->parent) root = root->parent;
+  if (root->mapped && offset < blob->size) {
+    fs_evict((char*) blob->data + offset, MIN(size, blob->size - offset));
+  }
+}
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -8,7 +9,16 @@ typedef struct Blob {
   void* data;
   size_t size;
   const char* name;
+  bool mapped;
+  bool temporary;
+  struct Blob* parent;
 } Blob;
 
+// Temporary Blobs use the temporary memory of the thread that creates them.  When that memory is
+// reset they're emptied, their data becomes NULL and their size 0.
+
 Blob* lovrBlobCreate(void* data, size_t size, const char* name);
+Blob* lovrBlobCreateTemporary(const void* data, size_t size, const char* name);
+Blob* lovrBlobCreateView(Blob* parent, size_t offset, size_t size, const char* name);
 void lovrBlobDestroy(void* ref);
+void lovrBlobEvict(Blob* blob, size_t offset, size_t size);
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
 
 #define FOUR_CC(a, b, c, d) ((uint32_t) (((d)<<24) | ((c)<<16) | ((b)<<8) | (a)))
 
@@ -392,6 +393,101 @@ static bool parseKTX(uint8_t* bytes, size_t size, Image* image) {
   return true;
 }
 
+static bool parseKTX2(uint8_t* bytes, size_t size, Image* image, bool flip) {
+  typedef struct {
+    uint8_t magic[12];
+    uint32_t vkFormat;
+    uint32_t typeSize;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t layerCount;
+    uint32_t faceCount;
+    uint32_t levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset;
+    uint32_t dfdByteLength;
+    uint32_t kvdByteOffset;
+    uint32_t kvdByteLength;
+    uint64_t sgdByteOffset;
+    uint64_t sgdByteLength;
+  } KTX2Header;
+
+  typedef struct {
+    uint64_t byteOffset;
+    uint64_t byteLength;
+    uint64_t uncompressedByteLength;
+  } KTX2Level;
+
+  KTX2Header* ktx = (KTX2Header*) bytes;
+  uint8_t magic[] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+  if (size < sizeof(KTX2Header) || memcmp(ktx->magic, magic, sizeof(magic))) {
+    return false;
+  }
+
+  if (ktx->pixelDepth > 1 || ktx->layerCount > 1 || ktx->faceCount > 1) {
+    return false;
+  }
+
+  // Basis Universal payloads (BasisLZ or UASTC) need a transcoder, which isn't included
+  lovrAssert(ktx->vkFormat != 0 && ktx->supercompressionScheme == 0, "KTX2 files with Basis Universal or Zstandard compression are not supported");
+
+  bool compressed = true;
+  switch (ktx->vkFormat) {
+    case 23: case 29: image->format = FORMAT_RGB; compressed = false; break;
+    case 37: case 43: image->format = FORMAT_RGBA; compressed = false; break;
+    case 131: case 132: case 133: case 134: image->format = FORMAT_DXT1; break;
+    case 135: case 136: image->format = FORMAT_DXT3; break;
+    case 137: case 138: image->format = FORMAT_DXT5; break;
+    default:
+      // The ASTC formats are consecutive unorm/srgb pairs, in the same order as TextureFormat
+      if (ktx->vkFormat >= 157 && ktx->vkFormat <= 184) {
+        image->format = FORMAT_ASTC_4x4 + (ktx->vkFormat - 157) / 2;
+        break;
+      }
+      lovrThrow("Unsupported KTX2 format '%d' (please open an issue)", ktx->vkFormat);
+  }
+
+  uint32_t levelCount = MAX(ktx->levelCount, 1);
+  KTX2Level* levels = (KTX2Level*) (bytes + sizeof(KTX2Header));
+  lovrAssert(sizeof(KTX2Header) + levelCount * sizeof(KTX2Level) <= size, "Invalid KTX2 file");
+  for (uint32_t i = 0; i < levelCount; i++) {
+    lovrAssert(levels[i].byteOffset + levels[i].byteLength <= size, "Invalid KTX2 file");
+  }
+
+  uint32_t width = image->width = ktx->pixelWidth;
+  uint32_t height = image->height = ktx->pixelHeight;
+
+  if (!compressed) {
+    size_t pixelSize = getPixelSize(image->format);
+    size_t length = (size_t) width * height * pixelSize;
+    lovrAssert(levels[0].byteLength >= length, "Invalid KTX2 file");
+    uint8_t* data = malloc(length);
+    lovrAssert(data, "Out of memory");
+    size_t stride = width * pixelSize;
+    for (uint32_t y = 0; y < height; y++) {
+      uint32_t row = flip ? height - 1 - y : y;
+      memcpy(data + y * stride, bytes + levels[0].byteOffset + row * stride, stride);
+    }
+    image->blob->data = data;
+    image->blob->size = length;
+    image->mipmapCount = 0;
+    return true;
+  }
+
+  image->mipmapCount = levelCount;
+  image->mipmaps = malloc(levelCount * sizeof(Mipmap));
+  lovrAssert(image->mipmaps, "Out of memory");
+  for (uint32_t i = 0; i < levelCount; i++) {
+    image->mipmaps[i] = (Mipmap) { .width = width, .height = height, .data = bytes + levels[i].byteOffset, .size = levels[i].byteLength };
+    width = MAX(width >> 1, 1u);
+    height = MAX(height >> 1, 1u);
+  }
+
+  return true;
+}
+
 static bool parseASTC(uint8_t* bytes, size_t size, Image* image) {
   typedef struct {
     uint32_t magic;
@@ -489,6 +585,12 @@ Image* lovrImageCreateFromBlob(Blob* blob, bool flip) {
     image->source = blob;
     lovrRetain(blob);
     return image;
+  } else if (parseKTX2(blob->data, blob->size, image, flip)) {
+    if (image->mipmapCount > 0) {
+      image->source = blob;
+      lovrRetain(blob);
+    }
+    return image;
   } else if (parseASTC(blob->data, blob->size, image)) {
     image->source = blob;
     lovrRetain(blob);
@@ -631,116 +733,435 @@ static uint32_t crc32(uint8_t* data, size_t length) {
   return c ^ 0xffffffff;
 }
 
-Blob* lovrImageEncode(Image* image) {
-  lovrAssert(image->format == FORMAT_RGBA, "Only RGBA Image can be encoded");
+static void writeLE(uint8_t* dst, uint64_t value, uint32_t bytes) {
+  for (uint32_t i = 0; i < bytes; i++) {
+    dst[i] = (uint8_t) (value >> (8 * i));
+  }
+}
+
+// Output for the encoders, sized up front for the worst case so writes don't need to check
+typedef struct {
+  uint8_t* data;
+  size_t size;
+  uint64_t bits;
+  uint32_t bitCount;
+} Writer;
+
+static void writeBits(Writer* writer, uint32_t value, uint32_t count) {
+  writer->bits |= (uint64_t) value << writer->bitCount;
+  writer->bitCount += count;
+  while (writer->bitCount >= 8) {
+    writer->data[writer->size++] = (uint8_t) writer->bits;
+    writer->bits >>= 8;
+    writer->bitCount -= 8;
+  }
+}
+
+static void flushBits(Writer* writer) {
+  if (writer->bitCount > 0) {
+    writeBits(writer, 0, 8 - writer->bitCount);
+  }
+}
+
+static uint32_t reverseBits(uint32_t code, uint32_t length) {
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < length; i++) {
+    result = (result << 1) | (code & 1);
+    code >>= 1;
+  }
+  return result;
+}
+
+// Fixed huffman codes from the deflate spec, stored bit-reversed so they can be written LSB first
+static struct {
+  bool ready;
+  uint16_t literalCodes[288];
+  uint8_t literalLengths[288];
+  uint8_t distanceCodes[30];
+  uint8_t lengthSymbols[259];
+  uint8_t distanceSymbols[512];
+} deflateTables;
+
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void deflateInit(void) {
+  if (deflateTables.ready) return;
+  for (uint32_t i = 0; i < 288; i++) {
+    uint32_t code, length;
+    if (i < 144) { code = 0x30 + i; length = 8; }
+    else if (i < 256) { code = 0x190 + i - 144; length = 9; }
+    else if (i < 280) { code = i - 256; length = 7; }
+    else { code = 0xc0 + i - 280; length = 8; }
+    deflateTables.literalCodes[i] = (uint16_t) reverseBits(code, length);
+    deflateTables.literalLengths[i] = (uint8_t) length;
+  }
+  for (uint32_t i = 0; i < 30; i++) {
+    deflateTables.distanceCodes[i] = (uint8_t) reverseBits(i, 5);
+  }
+  for (uint32_t i = 0, length = 3; length <= 258; length++) {
+    while (i < 28 && length >= lengthBase[i + 1]) i++;
+    deflateTables.lengthSymbols[length] = (uint8_t) i;
+  }
+  // Distances up to 256 are looked up directly, larger ones by their upper bits
+  for (uint32_t i = 0, distance = 1; distance <= 256; distance++) {
+    while (i < 29 && distance >= distanceBase[i + 1]) i++;
+    deflateTables.distanceSymbols[distance - 1] = (uint8_t) i;
+  }
+  for (uint32_t i = 0, d = 256; d < 32768; d += 128) {
+    while (i < 29 && d + 1 >= distanceBase[i + 1]) i++;
+    deflateTables.distanceSymbols[256 + (d >> 7)] = (uint8_t) i;
+  }
+  deflateTables.ready = true;
+}
+
+static void writeLiteral(Writer* writer, uint32_t symbol) {
+  writeBits(writer, deflateTables.literalCodes[symbol], deflateTables.literalLengths[symbol]);
+}
+
+static void writeMatch(Writer* writer, uint32_t length, uint32_t distance) {
+  uint32_t l = deflateTables.lengthSymbols[length];
+  writeLiteral(writer, 257 + l);
+  writeBits(writer, length - lengthBase[l], lengthExtra[l]);
+  uint32_t d = distance <= 256 ? deflateTables.distanceSymbols[distance - 1] : deflateTables.distanceSymbols[256 + ((distance - 1) >> 7)];
+  writeBits(writer, deflateTables.distanceCodes[d], 5);
+  writeBits(writer, distance - distanceBase[d], distanceExtra[d]);
+}
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_MATCH 258
+
+// Writes a zlib stream.  Level 0 uses stored blocks, level 1 uses greedy LZ77 matching with one
+// probe per position, higher levels follow hash chains (up to 2^level probes) for longer matches.
+// A single fixed huffman block is used, which is much faster than building dynamic trees.
+static void deflate(Writer* writer, const uint8_t* data, size_t size, uint32_t level) {
+  writer->data[writer->size++] = 0x78;
+  writer->data[writer->size++] = 0x01;
+
+  if (level == 0) {
+    size_t offset = 0;
+    do {
+      size_t length = MIN(size - offset, 65535);
+      writeBits(writer, offset + length == size, 1);
+      writeBits(writer, 0, 2);
+      flushBits(writer);
+      writeLE(writer->data + writer->size, length, 2);
+      writeLE(writer->data + writer->size + 2, ~length & 0xffff, 2);
+      memcpy(writer->data + writer->size + 4, data + offset, length);
+      writer->size += 4 + length;
+      offset += length;
+    } while (offset < size);
+  } else {
+    deflateInit();
+    uint32_t probes = level == 1 ? 1 : 1u << MIN(level, 8);
+    int32_t* head = malloc((1 << DEFLATE_HASH_BITS) * sizeof(int32_t));
+    int32_t* chain = probes > 1 ? malloc(DEFLATE_WINDOW * sizeof(int32_t)) : NULL;
+    lovrAssert(head && (probes == 1 || chain), "Out of memory");
+    memset(head, 0xff, (1 << DEFLATE_HASH_BITS) * sizeof(int32_t));
+
+    writeBits(writer, 1, 1);
+    writeBits(writer, 1, 2);
+
+    size_t i = 0;
+    while (i + 3 <= size) {
+      uint32_t hash = ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+      int32_t candidate = head[hash];
+      head[hash] = (int32_t) i;
+      if (chain) chain[i % DEFLATE_WINDOW] = candidate;
+
+      size_t bestLength = 0;
+      size_t bestDistance = 0;
+      size_t limit = MIN(size - i, DEFLATE_MAX_MATCH);
+      for (uint32_t p = 0; p < probes && candidate >= 0 && i - candidate <= DEFLATE_WINDOW; p++) {
+        const uint8_t* a = data + candidate;
+        const uint8_t* b = data + i;
+        size_t length = 0;
+        while (length < limit && a[length] == b[length]) length++;
+        if (length > bestLength) {
+          bestLength = length;
+          bestDistance = i - candidate;
+          if (length == limit) break;
+        }
+        if (!chain) break;
+        int32_t next = chain[candidate % DEFLATE_WINDOW];
+        if (next >= candidate) break;
+        candidate = next;
+      }
+
+      if (bestLength >= 3) {
+        writeMatch(writer, (uint32_t) bestLength, (uint32_t) bestDistance);
+        for (size_t j = 1; j < bestLength && i + j + 3 <= size; j++) {
+          size_t k = i + j;
+          uint32_t h = ((data[k] << 16 | data[k + 1] << 8 | data[k + 2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+          if (chain) chain[k % DEFLATE_WINDOW] = head[h];
+          head[h] = (int32_t) k;
+        }
+        i += bestLength;
+      } else {
+        writeLiteral(writer, data[i++]);
+      }
+    }
+
+    while (i < size) {
+      writeLiteral(writer, data[i++]);
+    }
+
+    writeLiteral(writer, 256);
+    flushBits(writer);
+    free(chain);
+    free(head);
+  }
+
+  uint32_t s1 = 1, s2 = 0;
+  for (size_t i = 0; i < size;) {
+    size_t end = MIN(i + 5552, size);
+    for (; i < end; i++) {
+      s1 += data[i];
+      s2 += s1;
+    }
+    s1 %= 65521;
+    s2 %= 65521;
+  }
+
+  uint8_t* p = writer->data + writer->size;
+  memcpy(p, (uint8_t[4]) { s2 >> 8, s2 >> 0, s1 >> 8, s1 >> 0 }, 4);
+  writer->size += 4;
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+}
+
+// Filters a row with each of the png filters and keeps the one with the smallest sum of absolute
+// (signed) differences, the heuristic recommended by the png spec
+static void filterRow(uint8_t* dst, const uint8_t* row, const uint8_t* prev, size_t length, size_t bpp, uint8_t* scratch) {
+  uint32_t bestSum = UINT32_MAX;
+
+  for (uint8_t filter = 0; filter < 5; filter++) {
+    uint8_t* out = filter == 0 ? dst + 1 : scratch;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+      uint8_t a = i >= bpp ? row[i - bpp] : 0;
+      uint8_t b = prev ? prev[i] : 0;
+      uint8_t c = (i >= bpp && prev) ? prev[i - bpp] : 0;
+      uint8_t x;
+      switch (filter) {
+        case 0: x = row[i]; break;
+        case 1: x = row[i] - a; break;
+        case 2: x = row[i] - b; break;
+        case 3: x = row[i] - ((a + b) >> 1); break;
+        default: x = row[i] - paeth(a, b, c); break;
+      }
+      out[i] = x;
+      sum += x < 128 ? x : 256 - x;
+    }
+
+    if (sum < bestSum) {
+      bestSum = sum;
+      dst[0] = filter;
+      if (filter > 0) {
+        memcpy(dst + 1, scratch, length);
+      }
+    }
+  }
+}
+
+static Blob* encodePNG(Image* image, uint32_t level) {
   uint32_t w = image->width;
   uint32_t h = image->height;
-  uint8_t* pixels = (uint8_t*) image->blob->data + (h - 1) * w * 4;
-  int32_t stride = -1 * (int) (w * 4);
+  uint8_t depth, colorType;
+  switch (image->format) {
+    case FORMAT_RGB: depth = 8; colorType = 2; break;
+    case FORMAT_RGBA: depth = 8; colorType = 6; break;
+    case FORMAT_R16: depth = 16; colorType = 0; break;
+    case FORMAT_RG16: depth = 16; colorType = 4; break;
+    case FORMAT_RGBA16: depth = 16; colorType = 6; break;
+    default: lovrThrow("Only rgb, rgba, r16, rg16, and rgba16 Images can be encoded as png");
+  }
+
+  size_t bpp = getPixelSize(image->format);
+  size_t rowSize = w * bpp;
+  size_t filteredSize = (rowSize + 1) * h;
+  uint8_t* filtered = malloc(filteredSize);
+  uint8_t* rows = malloc(2 * rowSize);
+  uint8_t* scratch = malloc(rowSize);
+  lovrAssert(filtered && rows && scratch, "Out of memory");
+
+  // Rows are stored bottom to top, png wants them top to bottom (and 16 bit samples big endian)
+  uint8_t* row = rows;
+  uint8_t* prev = NULL;
+  for (uint32_t y = 0; y < h; y++) {
+    const uint8_t* src = (uint8_t*) image->blob->data + (h - 1 - y) * rowSize;
+    if (depth == 16) {
+      for (size_t i = 0; i < rowSize; i += 2) {
+        row[i + 0] = src[i + 1];
+        row[i + 1] = src[i + 0];
+      }
+    } else {
+      memcpy(row, src, rowSize);
+    }
+
+    uint8_t* dst = filtered + y * (rowSize + 1);
+    if (level == 0) {
+      dst[0] = 0;
+      memcpy(dst + 1, row, rowSize);
+    } else {
+      filterRow(dst, row, prev, rowSize, bpp, scratch);
+    }
+
+    prev = row;
+    row = row == rows ? rows + rowSize : rows;
+  }
 
-  // The world's worst png encoder
-  // Encoding uses one unfiltered IDAT chunk, each row is an uncompressed huffman block
-  // The total IDAT chunk data size is
-  // - 2 bytes for the zlib header
-  // - 6 bytes per block (5 bytes for the huffman block header + 1 byte scanline filter prefix)
-  // - n bytes for the image data itself (width * height * 4)
-  // - 4 bytes for the adler32 checksum
+  free(scratch);
+  free(rows);
 
   uint8_t signature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
   uint8_t header[13] = {
     w >> 24, w >> 16, w >> 8, w >> 0,
     h >> 24, h >> 16, h >> 8, h >> 0,
-    8, 6, 0, 0, 0
+    depth, colorType, 0, 0, 0
   };
 
-  size_t rowSize = w * 4;
-  size_t imageSize = rowSize * h;
-  size_t blockSize = rowSize + 1;
-  size_t idatSize = 2 + (h * (5 + 1)) + imageSize + 4;
-
-  size_t size = sizeof(signature);
-  size += 4 + strlen("IHDR") + sizeof(header) + 4;
-  size += 4 + strlen("IDAT") + idatSize + 4;
-  size += 4 + strlen("IEND") + 4;
-  uint8_t* data = malloc(size);
-  lovrAssert(data, "Out of memory");
+  // Worst case for the zlib stream is 9 bits per byte (fixed huffman) or 5 bytes per 64K block
+  size_t maxIdatSize = 2 + filteredSize + filteredSize / 8 + 5 * (filteredSize / 65535 + 1) + 16 + 4;
+  size_t maxSize = sizeof(signature) + (12 + sizeof(header)) + (12 + maxIdatSize) + 12;
+  Writer writer = { .data = malloc(maxSize) };
+  lovrAssert(writer.data, "Out of memory");
 
   crc_init();
   uint32_t crc;
 
   // Signature
-  memcpy(data, signature, sizeof(signature));
-  data += sizeof(signature);
+  memcpy(writer.data, signature, sizeof(signature));
+  writer.size += sizeof(signature);
 
   // IHDR
-  memcpy(data, (uint8_t[4]) { 0, 0, 0, sizeof(header) }, 4);
-  memcpy(data + 4, "IHDR", 4);
-  memcpy(data + 8, header, sizeof(header));
-  crc = crc32(data + 4, 4 + sizeof(header));
-  memcpy(data + 8 + sizeof(header), (uint8_t[4]) { crc >> 24, crc >> 16, crc >> 8, crc >> 0 }, 4);
-  data += 8 + sizeof(header) + 4;
+  uint8_t* chunk = writer.data + writer.size;
+  memcpy(chunk, (uint8_t[4]) { 0, 0, 0, sizeof(header) }, 4);
+  memcpy(chunk + 4, "IHDR", 4);
+  memcpy(chunk + 8, header, sizeof(header));
+  crc = crc32(chunk + 4, 4 + sizeof(header));
+  memcpy(chunk + 8 + sizeof(header), (uint8_t[4]) { crc >> 24, crc >> 16, crc >> 8, crc >> 0 }, 4);
+  writer.size += 8 + sizeof(header) + 4;
 
   // IDAT
-  memcpy(data, (uint8_t[4]) { idatSize >> 24 & 0xff, idatSize >> 16 & 0xff, idatSize >> 8 & 0xff, idatSize >> 0 & 0xff }, 4);
-  memcpy(data + 4, "IDAT", 4);
+  size_t idatStart = writer.size;
+  memcpy(writer.data + idatStart + 4, "IDAT", 4);
+  writer.size += 8;
+  deflate(&writer, filtered, filteredSize, level);
+  free(filtered);
+  size_t idatSize = writer.size - idatStart - 8;
+  chunk = writer.data + idatStart;
+  memcpy(chunk, (uint8_t[4]) { idatSize >> 24 & 0xff, idatSize >> 16 & 0xff, idatSize >> 8 & 0xff, idatSize >> 0 & 0xff }, 4);
+  crc = crc32(chunk + 4, idatSize + 4);
+  memcpy(chunk + 8 + idatSize, (uint8_t[4]) { crc >> 24, crc >> 16, crc >> 8, crc }, 4);
+  writer.size += 4;
 
-  {
-    uint8_t* p = data + 8;
-    size_t length = imageSize;
-
-    // adler32 counters
-    uint64_t s1 = 1, s2 = 0;
+  // IEND
+  chunk = writer.data + writer.size;
+  memcpy(chunk, (uint8_t[4]) { 0 }, 4);
+  memcpy(chunk + 4, "IEND", 4);
+  crc = crc32(chunk + 4, 4);
+  memcpy(chunk + 8, (uint8_t[4]) { crc >> 24, crc >> 16, crc >> 8, crc >> 0 }, 4);
+  writer.size += 8 + 4;
+
+  return lovrBlobCreate(realloc(writer.data, writer.size), writer.size, "Encoded Image");
+}
 
-    // zlib header
-    *p++ = (7 << 4) + (8 << 0);
-    *p++ = 1;
+// QOI (https://qoiformat.org) compresses a bit worse than png but is many times faster to write
+static Blob* encodeQOI(Image* image) {
+  lovrAssert(image->format == FORMAT_RGB || image->format == FORMAT_RGBA, "Only rgb and rgba Images can be encoded as qoi");
+  uint32_t w = image->width;
+  uint32_t h = image->height;
+  uint32_t channels = image->format == FORMAT_RGBA ? 4 : 3;
+  size_t maxSize = 14 + (size_t) w * h * (channels + 1) + 8;
+  uint8_t* data = malloc(maxSize);
+  lovrAssert(data, "Out of memory");
 
-    while (length >= rowSize) {
+  uint8_t* p = data;
+  memcpy(p, "qoif", 4);
+  memcpy(p + 4, (uint8_t[10]) { w >> 24, w >> 16, w >> 8, w, h >> 24, h >> 16, h >> 8, h, channels, 0 }, 10);
+  p += 14;
 
-      // 1 indicates the final block
-      *p++ = (length == rowSize);
+  uint8_t index[64][4];
+  memset(index, 0, sizeof(index));
+  uint8_t previous[4] = { 0, 0, 0, 255 };
+  uint32_t run = 0;
 
-      // Write length and negated length
-      memcpy(p + 0, &(uint16_t) {  blockSize & 0xffff }, 2);
-      memcpy(p + 2, &(uint16_t) { ~blockSize & 0xffff }, 2);
-      p += 4;
+  for (uint32_t y = 0; y < h; y++) {
+    const uint8_t* row = (uint8_t*) image->blob->data + (size_t) (h - 1 - y) * w * channels;
+    for (uint32_t x = 0; x < w; x++) {
+      const uint8_t* src = row + x * channels;
+      uint8_t pixel[4] = { src[0], src[1], src[2], channels == 4 ? src[3] : 255 };
+      bool last = y == h - 1 && x == w - 1;
+
+      if (!memcmp(pixel, previous, 4)) {
+        if (++run == 62 || last) {
+          *p++ = 0xc0 | (run - 1);
+          run = 0;
+        }
+        continue;
+      }
 
-      // Write the filter method (0) and the row data
-      *p++ = 0x00;
-      memcpy(p, pixels, rowSize);
+      if (run > 0) {
+        *p++ = 0xc0 | (run - 1);
+        run = 0;
+      }
 
-      // Update adler32
-      s1 += 0;
-      s2 += s1;
-      for (size_t i = 0; i < rowSize; i++) {
-        s1 = (s1 + pixels[i]);
-        s2 = (s2 + s1);
+      uint32_t hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+      if (!memcmp(index[hash], pixel, 4)) {
+        *p++ = (uint8_t) hash;
+      } else {
+        memcpy(index[hash], pixel, 4);
+        if (pixel[3] == previous[3]) {
+          int8_t dr = (int8_t) (pixel[0] - previous[0]);
+          int8_t dg = (int8_t) (pixel[1] - previous[1]);
+          int8_t db = (int8_t) (pixel[2] - previous[2]);
+          int8_t drg = dr - dg;
+          int8_t dbg = db - dg;
+          if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            *p++ = 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2);
+          } else if (drg >= -8 && drg <= 7 && dg >= -32 && dg <= 31 && dbg >= -8 && dbg <= 7) {
+            *p++ = 0x80 | (dg + 32);
+            *p++ = (drg + 8) << 4 | (dbg + 8);
+          } else {
+            *p++ = 0xfe;
+            memcpy(p, pixel, 3);
+            p += 3;
+          }
+        } else {
+          *p++ = 0xff;
+          memcpy(p, pixel, 4);
+          p += 4;
+        }
       }
-      s1 %= 65521;
-      s2 %= 65521;
 
-      // Update cursors
-      p += rowSize;
-      pixels += stride;
-      length -= rowSize;
+      memcpy(previous, pixel, 4);
     }
-
-    // Write adler32 checksum
-    memcpy(p, (uint8_t[4]) { s2 >> 8, s2 >> 0, s1 >> 8, s1 >> 0 }, 4);
   }
 
-  crc = crc32(data + 4, idatSize + 4);
-  memcpy(data + 8 + idatSize, (uint8_t[4]) { crc >> 24, crc >> 16, crc >> 8, crc }, 4);
-  data += 8 + idatSize + 4;
+  memcpy(p, (uint8_t[8]) { 0, 0, 0, 0, 0, 0, 0, 1 }, 8);
+  p += 8;
 
-  // IEND
-  memcpy(data, (uint8_t[4]) { 0 }, 4);
-  memcpy(data + 4, "IEND", 4);
-  crc = crc32(data + 4, 4);
-  memcpy(data + 8, (uint8_t[4]) { crc >> 24, crc >> 16, crc >> 8, crc >> 0 }, 4);
-  data += 8 + 4;
+  size_t size = p - data;
+  return lovrBlobCreate(realloc(data, size), size, "Encoded Image");
+}
 
-  return lovrBlobCreate(data - size, size, "Encoded Image");
+Blob* lovrImageEncode(Image* image, ImageEncoding encoding, uint32_t level) {
+  lovrAssert(image->blob->data, "Image does not have any pixel data");
+  switch (encoding) {
+    case ENCODING_PNG: return encodePNG(image, level);
+    case ENCODING_QOI: return encodeQOI(image);
+    default: lovrThrow("Unreachable");
+  }
 }
 
 void lovrImagePaste(Image* image, Image* source, uint32_t dx, uint32_t dy, uint32_t sx, uint32_t sy, uint32_t w, uint32_t h) {
@@ -750,10 +1171,436 @@ void lovrImagePaste(Image* image, Image* source, uint32_t dx, uint32_t dy, uint3
   lovrAssert(dx + w <= image->width && dy + h <= image->height, "Attempt to paste outside of destination Image bounds");
   lovrAssert(sx + w <= source->width && sy + h <= source->height, "Attempt to paste from outside of source Image bounds");
   uint8_t* src = (uint8_t*) source->blob->data + ((source->height - 1 - sy) * source->width + sx) * pixelSize;
-  uint8_t* dst = (uint8_t*) image->blob->data + ((image->height - 1 - dy) * image->width + sx) * pixelSize;
+  uint8_t* dst = (uint8_t*) image->blob->data + ((image->height - 1 - dy) * image->width + dx) * pixelSize;
   for (uint32_t y = 0; y < h; y++) {
     memcpy(dst, src, w * pixelSize);
     src -= source->width * pixelSize;
     dst -= image->width * pixelSize;
   }
 }
+
+// Box filters an RGB or RGBA Image down to half size, for building mipmaps on the CPU
+Image* lovrImageDownsample(Image* source) {
+  lovrAssert(source->format == FORMAT_RGB || source->format == FORMAT_RGBA, "Only rgb and rgba Images can be downsampled");
+  uint32_t width = MAX(source->width >> 1, 1);
+  uint32_t height = MAX(source->height >> 1, 1);
+  uint32_t channels = source->format == FORMAT_RGBA ? 4 : 3;
+  Image* image = lovrImageCreate(width, height, NULL, 0, source->format);
+  uint8_t* src = source->blob->data;
+  uint8_t* dst = image->blob->data;
+
+  for (uint32_t y = 0; y < height; y++) {
+    uint32_t y0 = MIN(2 * y, source->height - 1);
+    uint32_t y1 = MIN(2 * y + 1, source->height - 1);
+    for (uint32_t x = 0; x < width; x++) {
+      uint32_t x0 = MIN(2 * x, source->width - 1);
+      uint32_t x1 = MIN(2 * x + 1, source->width - 1);
+      for (uint32_t c = 0; c < channels; c++) {
+        uint32_t sum =
+          src[(y0 * source->width + x0) * channels + c] +
+          src[(y0 * source->width + x1) * channels + c] +
+          src[(y1 * source->width + x0) * channels + c] +
+          src[(y1 * source->width + x1) * channels + c];
+        dst[(y * width + x) * channels + c] = (uint8_t) ((sum + 2) / 4);
+      }
+    }
+  }
+
+  return image;
+}
+
+static uint16_t pack565(const uint8_t* color) {
+  return (uint16_t) (((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3));
+}
+
+static void unpack565(uint16_t value, uint8_t* color) {
+  color[0] = (uint8_t) (((value >> 11) & 0x1f) * 255 / 31);
+  color[1] = (uint8_t) (((value >> 5) & 0x3f) * 255 / 63);
+  color[2] = (uint8_t) ((value & 0x1f) * 255 / 31);
+}
+
+// Bounding box endpoints inset by 1/16th, then the closest of the 4 palette colors for each pixel
+static void encodeColorBlock(const uint8_t pixels[16][4], uint8_t* dst) {
+  uint8_t lo[3] = { 255, 255, 255 };
+  uint8_t hi[3] = { 0, 0, 0 };
+
+  for (uint32_t i = 0; i < 16; i++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      lo[c] = MIN(lo[c], pixels[i][c]);
+      hi[c] = MAX(hi[c], pixels[i][c]);
+    }
+  }
+
+  for (uint32_t c = 0; c < 3; c++) {
+    uint8_t inset = (hi[c] - lo[c]) >> 4;
+    lo[c] += inset;
+    hi[c] -= inset;
+  }
+
+  uint16_t c0 = pack565(hi);
+  uint16_t c1 = pack565(lo);
+  uint32_t indices = 0;
+
+  if (c0 != c1) {
+    uint8_t palette[4][3];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (uint32_t c = 0; c < 3; c++) {
+      palette[2][c] = (uint8_t) ((2 * palette[0][c] + palette[1][c]) / 3);
+      palette[3][c] = (uint8_t) ((palette[0][c] + 2 * palette[1][c]) / 3);
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+      uint32_t best = 0;
+      int bestDistance = INT32_MAX;
+      for (uint32_t j = 0; j < 4; j++) {
+        int dr = pixels[i][0] - palette[j][0];
+        int dg = pixels[i][1] - palette[j][1];
+        int db = pixels[i][2] - palette[j][2];
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          best = j;
+        }
+      }
+      indices |= best << (2 * i);
+    }
+  }
+
+  writeLE(dst + 0, c0, 2);
+  writeLE(dst + 2, c1, 2);
+  writeLE(dst + 4, indices, 4);
+}
+
+static void encodeAlphaBlock(const uint8_t pixels[16][4], uint8_t* dst) {
+  uint8_t a0 = 0;
+  uint8_t a1 = 255;
+
+  for (uint32_t i = 0; i < 16; i++) {
+    a0 = MAX(a0, pixels[i][3]);
+    a1 = MIN(a1, pixels[i][3]);
+  }
+
+  uint64_t indices = 0;
+
+  if (a0 != a1) {
+    uint8_t palette[8] = { a0, a1 };
+    for (uint32_t j = 1; j < 7; j++) {
+      palette[j + 1] = (uint8_t) (((7 - j) * a0 + j * a1) / 7);
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+      uint64_t best = 0;
+      int bestDistance = INT32_MAX;
+      for (uint32_t j = 0; j < 8; j++) {
+        int distance = abs(pixels[i][3] - palette[j]);
+        if (distance < bestDistance) {
+          bestDistance = distance;
+          best = j;
+        }
+      }
+      indices |= best << (3 * i);
+    }
+  }
+
+  dst[0] = a0;
+  dst[1] = a1;
+  writeLE(dst + 2, indices, 6);
+}
+
+// Encodes an rgb or rgba Image as DXT1 or DXT5, optionally with a full chain of mipmaps.  This is
+// a fast single pass encoder meant for content generated at runtime, not for offline assets.
+Image* lovrImageCompress(Image* source, TextureFormat format, bool mipmaps) {
+  lovrAssert(source->format == FORMAT_RGB || source->format == FORMAT_RGBA, "Only rgb and rgba Images can be compressed");
+  lovrAssert(format == FORMAT_DXT1 || format == FORMAT_DXT5, "Images can only be compressed to dxt1 or dxt5");
+  uint32_t channels = source->format == FORMAT_RGBA ? 4 : 3;
+  size_t blockSize = format == FORMAT_DXT1 ? 8 : 16;
+  uint32_t mipmapCount = mipmaps ? log2(MAX(source->width, source->height)) + 1 : 1;
+
+  size_t size = 0;
+  uint32_t width = source->width;
+  uint32_t height = source->height;
+  for (uint32_t i = 0; i < mipmapCount; i++) {
+    size += (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    width = MAX(width >> 1, 1);
+    height = MAX(height >> 1, 1);
+  }
+
+  Image* image = calloc(1, sizeof(Image));
+  lovrAssert(image, "Out of memory");
+  image->ref = 1;
+  image->width = source->width;
+  image->height = source->height;
+  image->format = format;
+  image->mipmapCount = mipmapCount;
+  image->mipmaps = malloc(mipmapCount * sizeof(Mipmap));
+  uint8_t* data = malloc(size);
+  lovrAssert(image->mipmaps && data, "Out of memory");
+  image->blob = lovrBlobCreate(NULL, 0, NULL);
+  image->source = lovrBlobCreate(data, size, "Compressed Image");
+
+  Image* level = source;
+  lovrRetain(level);
+  for (uint32_t i = 0; i < mipmapCount; i++) {
+    width = level->width;
+    height = level->height;
+    uint8_t* pixels = level->blob->data;
+    size_t levelSize = (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    image->mipmaps[i] = (Mipmap) { .width = width, .height = height, .data = data, .size = levelSize };
+
+    for (uint32_t by = 0; by < height; by += 4) {
+      for (uint32_t bx = 0; bx < width; bx += 4) {
+        uint8_t block[16][4];
+        for (uint32_t p = 0; p < 16; p++) {
+          uint32_t x = MIN(bx + (p & 3), width - 1);
+          uint32_t y = MIN(by + (p >> 2), height - 1);
+          uint8_t* pixel = pixels + (y * width + x) * channels;
+          block[p][0] = pixel[0];
+          block[p][1] = pixel[1];
+          block[p][2] = pixel[2];
+          block[p][3] = channels == 4 ? pixel[3] : 255;
+        }
+
+        if (format == FORMAT_DXT5) {
+          encodeAlphaBlock(block, data);
+          data += 8;
+        }
+
+        encodeColorBlock(block, data);
+        data += 8;
+      }
+    }
+
+    if (i < mipmapCount - 1) {
+      Image* next = lovrImageDownsample(level);
+      lovrRelease(level, lovrImageDestroy);
+      level = next;
+    }
+  }
+  lovrRelease(level, lovrImageDestroy);
+
+  return image;
+}
+
+// Bulk conversions.  These work a row at a time through a float RGBA scratch row, with the kernels
+// kept as simple branch-free loops over the row so the compiler can vectorize them.
+
+static float halfToFloat(uint16_t h) {
+  uint32_t sign = (uint32_t) (h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+  union { uint32_t u32; float f32; } result;
+  if (exponent == 0) {
+    result.f32 = mantissa * (1.f / 16777216.f);
+    result.u32 |= sign;
+  } else if (exponent == 31) {
+    result.u32 = sign | 0x7f800000 | (mantissa << 13);
+  } else {
+    result.u32 = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  return result.f32;
+}
+
+static uint16_t floatToHalf(float f) {
+  union { float f32; uint32_t u32; } x = { f };
+  uint32_t sign = (x.u32 >> 16) & 0x8000;
+  int32_t exponent = (int32_t) ((x.u32 >> 23) & 0xff) - 112;
+  uint32_t mantissa = x.u32 & 0x7fffff;
+  if (((x.u32 >> 23) & 0xff) == 0xff) {
+    return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+  } else if (exponent >= 31) {
+    return (uint16_t) (sign | 0x7c00);
+  } else if (exponent <= 0) {
+    if (exponent < -10) return (uint16_t) sign;
+    mantissa |= 0x800000;
+    return (uint16_t) (sign | ((mantissa >> (14 - exponent)) + ((mantissa >> (13 - exponent)) & 1)));
+  } else {
+    return (uint16_t) (sign + ((exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+  }
+}
+
+static float gammaToLinear(float x) {
+  return x <= .04045f ? x / 12.92f : powf((x + .055f) / 1.055f, 2.4f);
+}
+
+static float linearToGamma(float x) {
+  return x <= .0031308f ? x * 12.92f : 1.055f * powf(x, 1.f / 2.4f) - .055f;
+}
+
+static struct {
+  bool ready;
+  float unorm[256];
+  uint8_t gammaToLinear[256];
+  uint8_t linearToGamma[256];
+} conversionTables;
+
+static void initConversionTables(void) {
+  if (conversionTables.ready) return;
+  for (uint32_t i = 0; i < 256; i++) {
+    conversionTables.unorm[i] = i / 255.f;
+    conversionTables.gammaToLinear[i] = (uint8_t) (gammaToLinear(i / 255.f) * 255.f + .5f);
+    conversionTables.linearToGamma[i] = (uint8_t) (linearToGamma(i / 255.f) * 255.f + .5f);
+  }
+  conversionTables.ready = true;
+}
+
+static bool isConvertible(TextureFormat format) {
+  return format == FORMAT_RGB || format == FORMAT_RGBA || format == FORMAT_RGBA16F || format == FORMAT_RGBA32F;
+}
+
+static void decodeRow(const uint8_t* restrict src, float* restrict dst, TextureFormat format, size_t count) {
+  const float* unorm = conversionTables.unorm;
+  switch (format) {
+    case FORMAT_RGB:
+      for (size_t i = 0; i < count; i++) {
+        dst[4 * i + 0] = unorm[src[3 * i + 0]];
+        dst[4 * i + 1] = unorm[src[3 * i + 1]];
+        dst[4 * i + 2] = unorm[src[3 * i + 2]];
+        dst[4 * i + 3] = 1.f;
+      }
+      break;
+    case FORMAT_RGBA:
+      for (size_t i = 0; i < 4 * count; i++) {
+        dst[i] = unorm[src[i]];
+      }
+      break;
+    case FORMAT_RGBA16F: {
+      const uint16_t* f16 = (const uint16_t*) src;
+      for (size_t i = 0; i < 4 * count; i++) {
+        dst[i] = halfToFloat(f16[i]);
+      }
+      break;
+    }
+    case FORMAT_RGBA32F:
+      memcpy(dst, src, 4 * count * sizeof(float));
+      break;
+    default: lovrThrow("Unreachable");
+  }
+}
+
+static void encodeRow(const float* restrict src, uint8_t* restrict dst, TextureFormat format, size_t count) {
+  switch (format) {
+    case FORMAT_RGB:
+      for (size_t i = 0; i < count; i++) {
+        dst[3 * i + 0] = (uint8_t) (CLAMP(src[4 * i + 0], 0.f, 1.f) * 255.f + .5f);
+        dst[3 * i + 1] = (uint8_t) (CLAMP(src[4 * i + 1], 0.f, 1.f) * 255.f + .5f);
+        dst[3 * i + 2] = (uint8_t) (CLAMP(src[4 * i + 2], 0.f, 1.f) * 255.f + .5f);
+      }
+      break;
+    case FORMAT_RGBA:
+      for (size_t i = 0; i < 4 * count; i++) {
+        dst[i] = (uint8_t) (CLAMP(src[i], 0.f, 1.f) * 255.f + .5f);
+      }
+      break;
+    case FORMAT_RGBA16F: {
+      uint16_t* f16 = (uint16_t*) dst;
+      for (size_t i = 0; i < 4 * count; i++) {
+        f16[i] = floatToHalf(src[i]);
+      }
+      break;
+    }
+    case FORMAT_RGBA32F:
+      memcpy(dst, src, 4 * count * sizeof(float));
+      break;
+    default: lovrThrow("Unreachable");
+  }
+}
+
+// Converts between rgb, rgba, rgba16f, and rgba32f.  Conversions between 8 bit formats stay exact.
+Image* lovrImageConvert(Image* source, TextureFormat format) {
+  lovrAssert(source->blob->data, "Image does not have any pixel data");
+  lovrAssert(isConvertible(source->format) && isConvertible(format), "Images can only be converted between rgb, rgba, rgba16f, and rgba32f");
+  initConversionTables();
+  Image* image = lovrImageCreate(source->width, source->height, NULL, 0x0, format);
+  size_t srcStride = source->width * getPixelSize(source->format);
+  size_t dstStride = image->width * getPixelSize(format);
+  uint8_t* src = source->blob->data;
+  uint8_t* dst = image->blob->data;
+
+  if (source->format == format) {
+    memcpy(dst, src, image->blob->size);
+    return image;
+  }
+
+  if (source->format == FORMAT_RGB && format == FORMAT_RGBA) {
+    size_t count = (size_t) source->width * source->height;
+    for (size_t i = 0; i < count; i++) {
+      dst[4 * i + 0] = src[3 * i + 0];
+      dst[4 * i + 1] = src[3 * i + 1];
+      dst[4 * i + 2] = src[3 * i + 2];
+      dst[4 * i + 3] = 0xff;
+    }
+    return image;
+  }
+
+  float* row = malloc(source->width * 4 * sizeof(float));
+  lovrAssert(row, "Out of memory");
+  for (uint32_t y = 0; y < source->height; y++) {
+    decodeRow(src + y * srcStride, row, source->format, source->width);
+    encodeRow(row, dst + y * dstStride, format, source->width);
+  }
+  free(row);
+  return image;
+}
+
+// Applies an operation to the color channels in place.  8 bit formats go through lookup tables,
+// float formats are converted through a scratch row.
+typedef enum { OP_GAMMA_TO_LINEAR, OP_LINEAR_TO_GAMMA, OP_PREMULTIPLY } ColorOp;
+
+static void applyColorOp(Image* image, ColorOp op) {
+  lovrAssert(image->blob->data, "Image does not have any pixel data");
+  lovrAssert(isConvertible(image->format), "Only rgb, rgba, rgba16f, and rgba32f Images can be converted");
+  lovrAssert(op != OP_PREMULTIPLY || image->format != FORMAT_RGB, "Images without alpha can not be premultiplied");
+  initConversionTables();
+  size_t count = (size_t) image->width * image->height;
+  uint8_t* u8 = image->blob->data;
+
+  if (image->format == FORMAT_RGB || image->format == FORMAT_RGBA) {
+    size_t channels = image->format == FORMAT_RGBA ? 4 : 3;
+    if (op == OP_PREMULTIPLY) {
+      for (size_t i = 0; i < count; i++) {
+        uint32_t a = u8[4 * i + 3];
+        u8[4 * i + 0] = (uint8_t) ((u8[4 * i + 0] * a + 127) / 255);
+        u8[4 * i + 1] = (uint8_t) ((u8[4 * i + 1] * a + 127) / 255);
+        u8[4 * i + 2] = (uint8_t) ((u8[4 * i + 2] * a + 127) / 255);
+      }
+    } else {
+      const uint8_t* table = op == OP_GAMMA_TO_LINEAR ? conversionTables.gammaToLinear : conversionTables.linearToGamma;
+      for (size_t i = 0; i < count; i++) {
+        u8[channels * i + 0] = table[u8[channels * i + 0]];
+        u8[channels * i + 1] = table[u8[channels * i + 1]];
+        u8[channels * i + 2] = table[u8[channels * i + 2]];
+      }
+    }
+    return;
+  }
+
+  size_t stride = image->width * getPixelSize(image->format);
+  float* row = malloc(image->width * 4 * sizeof(float));
+  lovrAssert(row, "Out of memory");
+  for (uint32_t y = 0; y < image->height; y++) {
+    decodeRow(u8 + y * stride, row, image->format, image->width);
+    for (uint32_t i = 0; i < image->width; i++) {
+      float* p = row + 4 * i;
+      switch (op) {
+        case OP_GAMMA_TO_LINEAR: p[0] = gammaToLinear(p[0]); p[1] = gammaToLinear(p[1]); p[2] = gammaToLinear(p[2]); break;
+        case OP_LINEAR_TO_GAMMA: p[0] = linearToGamma(p[0]); p[1] = linearToGamma(p[1]); p[2] = linearToGamma(p[2]); break;
+        case OP_PREMULTIPLY: p[0] *= p[3]; p[1] *= p[3]; p[2] *= p[3]; break;
+      }
+    }
+    encodeRow(row, u8 + y * stride, image->format, image->width);
+  }
+  free(row);
+}
+
+void lovrImageGammaToLinear(Image* image) {
+  applyColorOp(image, OP_GAMMA_TO_LINEAR);
+}
+
+void lovrImageLinearToGamma(Image* image) {
+  applyColorOp(image, OP_LINEAR_TO_GAMMA);
+}
+
+void lovrImagePremultiply(Image* image) {
+  applyColorOp(image, OP_PREMULTIPLY);
+}
@@ -51,6 +51,11 @@ typedef struct {
   void* data;
 } Mipmap;
 
+typedef enum {
+  ENCODING_PNG,
+  ENCODING_QOI
+} ImageEncoding;
+
 typedef struct Image {
   uint32_t ref;
   struct Blob* blob;
@@ -67,5 +72,11 @@ Image* lovrImageCreateFromBlob(struct Blob* blob, bool flip);
 void lovrImageDestroy(void* ref);
 Color lovrImageGetPixel(Image* image, uint32_t x, uint32_t y);
 void lovrImageSetPixel(Image* image, uint32_t x, uint32_t y, Color color);
-struct Blob* lovrImageEncode(Image* image);
+struct Blob* lovrImageEncode(Image* image, ImageEncoding encoding, uint32_t level);
 void lovrImagePaste(Image* image, Image* source, uint32_t dx, uint32_t dy, uint32_t sx, uint32_t sy, uint32_t w, uint32_t h);
+Image* lovrImageDownsample(Image* source);
+Image* lovrImageCompress(Image* source, TextureFormat format, bool mipmaps);
+Image* lovrImageConvert(Image* source, TextureFormat format);
+void lovrImageGammaToLinear(Image* image);
+void lovrImageLinearToGamma(Image* image);
+void lovrImagePremultiply(Image* image);
@@ -1,25 +1,69 @@
 #include "data/modelData.h"
 #include "data/blob.h"
 #include "data/image.h"
+#include "core/profile.h"
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
 
-ModelData* lovrModelDataCreate(Blob* source, ModelDataIO* io) {
+// Primitives smaller than this aren't worth simplifying
+#define LOD_MIN_VERTICES 1024
+
+// Size of the simulated post-transform cache used to order triangles
+#define VERTEX_CACHE_SIZE 32
+
+static ModelData* createModelData(Blob* source, ModelDataIO* io, bool optimize) {
   ModelData* model = calloc(1, sizeof(ModelData));
   lovrAssert(model, "Out of memory");
   model->ref = 1;
 
-  if (lovrModelDataInitGltf(model, source, io)) {
-    return model;
-  } else if (lovrModelDataInitObj(model, source, io)) {
+  // Cached models were already optimized and have their LODs, everything is used as-is
+  if (lovrModelDataInitCache(model, source, io)) {
     return model;
-  } else if (lovrModelDataInitStl(model, source, io)) {
+  }
+
+  // Optimizing rewrites buffers in place, and glb buffers point into the source Blob, so a Blob that
+  // someone else is holding on to (or a read-only mapped file) gets copied first
+  const char* name = source->name;
+  Blob* copy = NULL;
+  if (optimize && (source->ref > 1 || source->mapped)) {
+    void* data = malloc(source->size);
+    lovrAssert(data, "Out of memory");
+    memcpy(data, source->data, source->size);
+    source = copy = lovrBlobCreate(data, source->size, source->name);
+  }
+
+  if (lovrModelDataInitGltf(model, source, io) || lovrModelDataInitObj(model, source, io) || lovrModelDataInitStl(model, source, io)) {
+    if (optimize) {
+      lovrModelDataOptimize(model);
+    }
+
+    if (copy) {
+      copy->name = NULL;
+      lovrRelease(copy, lovrBlobDestroy);
+    }
+
+    lovrModelDataGenerateLods(model);
     return model;
   }
 
-  lovrThrow("Unable to load model from '%s'", source->name);
+  if (copy) {
+    copy->name = NULL;
+    lovrRelease(copy, lovrBlobDestroy);
+  }
+
+  lovrThrow("Unable to load model from '%s'", name);
   return NULL;
 }
 
+ModelData* lovrModelDataCreate(Blob* source, ModelDataIO* io, bool optimize) {
+  lovrProfileBegin("lovrModelDataCreate");
+  ModelData* model = createModelData(source, io, optimize);
+  lovrProfileEnd();
+  return model;
+}
+
 void lovrModelDataDestroy(void* ref) {
   ModelData* model = ref;
   for (uint32_t i = 0; i < model->blobCount; i++) {
@@ -31,6 +75,7 @@ void lovrModelDataDestroy(void* ref) {
   map_free(&model->animationMap);
   map_free(&model->materialMap);
   map_free(&model->nodeMap);
+  free(model->lodIndices);
   free(model->data);
   free(model);
 }
@@ -75,3 +120,605 @@ void lovrModelDataAllocate(ModelData* model) {
   map_init(&model->materialMap, model->materialCount);
   map_init(&model->nodeMap, model->nodeCount);
 }
+
+static uint32_t readIndex(ModelData* model, ModelAttribute* indices, uint32_t i) {
+  char* p = model->buffers[indices->buffer].data + indices->offset;
+  switch (indices->type) {
+    case U8: return ((uint8_t*) p)[i];
+    case U16: return ((uint16_t*) p)[i];
+    case U32: return ((uint32_t*) p)[i];
+    default: return 0;
+  }
+}
+
+// Generates LODs for large triangle meshes using vertex clustering: vertices are snapped to a grid
+// over the primitive's bounds, every vertex in a cell is replaced by the first one seen, and
+// triangles that collapse are dropped.  The vertex data is untouched, so LODs are just index lists.
+// Each level halves the grid resolution, and is meant to be used once a grid cell is a few pixels.
+// Levels stop once they stop removing a meaningful amount of triangles.
+void lovrModelDataGenerateLods(ModelData* model) {
+  arr_t(uint32_t) lodIndices;
+  arr_t(uint32_t) remap;
+  arr_init(&lodIndices, realloc);
+  arr_init(&remap, realloc);
+
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+
+    if (primitive->mode != DRAW_TRIANGLES || !position || position->type != F32 || position->components < 3) continue;
+    if (!position->hasMin || !position->hasMax || position->count < LOD_MIN_VERTICES) continue;
+
+    ModelBuffer* buffer = &model->buffers[position->buffer];
+    size_t stride = buffer->stride ? buffer->stride : position->components * sizeof(float);
+    char* positions = buffer->data + position->offset;
+    uint32_t indexCount = primitive->indices ? primitive->indices->count : position->count;
+    uint32_t previousCount = indexCount;
+
+    float extent = 0.f;
+    for (uint32_t j = 0; j < 3; j++) {
+      extent = MAX(extent, position->max[j] - position->min[j]);
+    }
+
+    if (extent <= 0.f) continue;
+
+    arr_reserve(&remap, position->count);
+
+    for (uint32_t level = 1; level < MAX_LODS; level++) {
+      uint32_t resolution = 64 >> level;
+      float scale = resolution / extent;
+      map_t cells;
+      map_init(&cells, position->count / 4);
+
+      for (uint32_t v = 0; v < position->count; v++) {
+        float* p = (float*) (positions + v * stride);
+        uint32_t cell[3];
+        for (uint32_t j = 0; j < 3; j++) {
+          cell[j] = (uint32_t) CLAMP((p[j] - position->min[j]) * scale, 0.f, (float) resolution);
+        }
+        uint64_t hash = hash64(cell, sizeof(cell));
+        uint64_t representative = map_get(&cells, hash);
+        if (representative == MAP_NIL) {
+          map_set(&cells, hash, v);
+          representative = v;
+        }
+        remap.data[v] = (uint32_t) representative;
+      }
+
+      map_free(&cells);
+
+      size_t start = lodIndices.length;
+      for (uint32_t j = 0; j + 2 < indexCount; j += 3) {
+        uint32_t a = primitive->indices ? readIndex(model, primitive->indices, j + 0) : j + 0;
+        uint32_t b = primitive->indices ? readIndex(model, primitive->indices, j + 1) : j + 1;
+        uint32_t c = primitive->indices ? readIndex(model, primitive->indices, j + 2) : j + 2;
+        if (a >= position->count || b >= position->count || c >= position->count) continue;
+        a = remap.data[a], b = remap.data[b], c = remap.data[c];
+        if (a != b && b != c && c != a) {
+          arr_push(&lodIndices, a);
+          arr_push(&lodIndices, b);
+          arr_push(&lodIndices, c);
+        }
+      }
+
+      uint32_t count = (uint32_t) (lodIndices.length - start);
+      if (count == 0 || count > previousCount * 3 / 4) {
+        lodIndices.length = start;
+        break;
+      }
+
+      primitive->lods[primitive->lodCount++] = (ModelLod) {
+        .start = (uint32_t) start,
+        .count = count,
+        .screenSize = resolution / 256.f
+      };
+
+      previousCount = count;
+    }
+  }
+
+  arr_free(&remap);
+  model->lodIndices = lodIndices.data;
+  model->lodIndexCount = (uint32_t) lodIndices.length;
+}
+
+static void writeIndex(ModelData* model, ModelAttribute* indices, uint32_t i, uint32_t value) {
+  char* p = model->buffers[indices->buffer].data + indices->offset;
+  switch (indices->type) {
+    case U8: ((uint8_t*) p)[i] = (uint8_t) value; break;
+    case U16: ((uint16_t*) p)[i] = (uint16_t) value; break;
+    case U32: ((uint32_t*) p)[i] = value; break;
+    default: break;
+  }
+}
+
+static size_t getAttributeSize(ModelAttribute* attribute) {
+  static const size_t sizes[] = { [I8] = 1, [U8] = 1, [I16] = 2, [U16] = 2, [I32] = 4, [U32] = 4, [F32] = 4 };
+  return sizes[attribute->type] * attribute->components;
+}
+
+static char* getAttributeElement(ModelData* model, ModelAttribute* attribute, uint32_t i) {
+  ModelBuffer* buffer = &model->buffers[attribute->buffer];
+  size_t stride = buffer->stride ? buffer->stride : getAttributeSize(attribute);
+  return buffer->data + attribute->offset + i * stride;
+}
+
+// Forsyth's vertex score: vertices that were used recently and have few triangles left score higher
+static float getVertexScore(uint32_t cachePosition, uint32_t trianglesLeft) {
+  if (trianglesLeft == 0) {
+    return -1.f;
+  }
+
+  float score = 0.f;
+  if (cachePosition < 3) {
+    score = .75f;
+  } else if (cachePosition < VERTEX_CACHE_SIZE) {
+    score = powf(1.f - (cachePosition - 3) / (float) (VERTEX_CACHE_SIZE - 3), 1.5f);
+  }
+
+  return score + 2.f * powf((float) trianglesLeft, -.5f);
+}
+
+// Reorders triangles for the post-transform vertex cache (Tom Forsyth's linear-speed algorithm).
+// When no triangle touches the cache, the next unemitted triangle in the input order is used.
+static void optimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount) {
+  uint32_t triangleCount = indexCount / 3;
+  uint32_t* offsets = calloc(vertexCount + 1, sizeof(uint32_t));
+  uint32_t* remaining = calloc(vertexCount, sizeof(uint32_t));
+  uint32_t* cachePositions = malloc(vertexCount * sizeof(uint32_t));
+  float* vertexScores = malloc(vertexCount * sizeof(float));
+  uint32_t* adjacency = malloc(indexCount * sizeof(uint32_t));
+  float* triangleScores = malloc(triangleCount * sizeof(float));
+  bool* emitted = calloc(triangleCount, sizeof(bool));
+  uint32_t* output = malloc(indexCount * sizeof(uint32_t));
+  lovrAssert(offsets && remaining && cachePositions && vertexScores && adjacency && triangleScores && emitted && output, "Out of memory");
+
+  for (uint32_t i = 0; i < indexCount; i++) {
+    remaining[indices[i]]++;
+  }
+
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    offsets[i + 1] = offsets[i] + remaining[i];
+    cachePositions[i] = ~0u;
+    vertexScores[i] = getVertexScore(~0u, remaining[i]);
+    remaining[i] = 0;
+  }
+
+  for (uint32_t i = 0; i < indexCount; i++) {
+    uint32_t v = indices[i];
+    adjacency[offsets[v] + remaining[v]++] = i / 3;
+  }
+
+  for (uint32_t i = 0; i < triangleCount; i++) {
+    triangleScores[i] = vertexScores[indices[3 * i + 0]] + vertexScores[indices[3 * i + 1]] + vertexScores[indices[3 * i + 2]];
+  }
+
+  uint32_t cache[VERTEX_CACHE_SIZE + 3];
+  uint32_t cacheCount = 0;
+  uint32_t cursor = 0;
+  uint32_t best = ~0u;
+
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    if (best == ~0u) {
+      while (emitted[cursor]) cursor++;
+      best = cursor;
+    }
+
+    uint32_t* triangle = indices + 3 * best;
+    memcpy(output + 3 * t, triangle, 3 * sizeof(uint32_t));
+    emitted[best] = true;
+
+    // Remove the triangle from the adjacency of its vertices
+    for (uint32_t i = 0; i < 3; i++) {
+      uint32_t v = triangle[i];
+      uint32_t* list = adjacency + offsets[v];
+      for (uint32_t j = 0; j < remaining[v]; j++) {
+        if (list[j] == best) {
+          list[j] = list[--remaining[v]];
+          break;
+        }
+      }
+    }
+
+    // Put the vertices of the triangle at the front of the cache
+    uint32_t newCache[VERTEX_CACHE_SIZE + 3];
+    uint32_t newCount = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+      newCache[newCount++] = triangle[i];
+    }
+    for (uint32_t i = 0; i < cacheCount; i++) {
+      uint32_t v = cache[i];
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        newCache[newCount++] = v;
+      }
+    }
+
+    // Rescore everything that was in the cache (including vertices that just fell out of it)
+    for (uint32_t i = 0; i < newCount; i++) {
+      uint32_t v = newCache[i];
+      cachePositions[v] = i < VERTEX_CACHE_SIZE ? i : ~0u;
+      vertexScores[v] = getVertexScore(cachePositions[v], remaining[v]);
+    }
+
+    best = ~0u;
+    float bestScore = -FLT_MAX;
+    for (uint32_t i = 0; i < newCount; i++) {
+      uint32_t v = newCache[i];
+      for (uint32_t j = 0; j < remaining[v]; j++) {
+        uint32_t n = adjacency[offsets[v] + j];
+        uint32_t* other = indices + 3 * n;
+        triangleScores[n] = vertexScores[other[0]] + vertexScores[other[1]] + vertexScores[other[2]];
+        if (triangleScores[n] > bestScore) {
+          bestScore = triangleScores[n];
+          best = n;
+        }
+      }
+    }
+
+    cacheCount = MIN(newCount, VERTEX_CACHE_SIZE);
+    memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+  }
+
+  memcpy(indices, output, triangleCount * 3 * sizeof(uint32_t));
+  free(offsets);
+  free(remaining);
+  free(cachePositions);
+  free(vertexScores);
+  free(adjacency);
+  free(triangleScores);
+  free(emitted);
+  free(output);
+}
+
+typedef struct {
+  float sort;
+  uint32_t start;
+  uint32_t count;
+} TriangleCluster;
+
+static int compareClusters(const void* a, const void* b) {
+  float x = ((const TriangleCluster*) a)->sort;
+  float y = ((const TriangleCluster*) b)->sort;
+  return (x < y) - (x > y);
+}
+
+// Reduces overdraw without undoing the cache optimization: the triangles are split into clusters
+// wherever the cache order jumps to an unrelated part of the mesh, and clusters that face away from
+// the center of the mesh are drawn first, since they're likely to occlude the rest of it.
+static void optimizeOverdraw(ModelData* model, ModelAttribute* position, uint32_t* indices, uint32_t indexCount) {
+  uint32_t triangleCount = indexCount / 3;
+  arr_t(TriangleCluster) clusters;
+  arr_init(&clusters, realloc);
+
+  uint32_t cache[16];
+  uint32_t cacheHead = 0;
+  memset(cache, 0xff, sizeof(cache));
+
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < 3; i++) {
+      uint32_t v = indices[3 * t + i];
+      bool hit = false;
+      for (uint32_t j = 0; j < 16; j++) {
+        hit |= cache[j] == v;
+      }
+      if (!hit) {
+        cache[cacheHead++ % 16] = v;
+        misses++;
+      }
+    }
+
+    if (clusters.length == 0 || (misses == 3 && clusters.data[clusters.length - 1].count >= 16)) {
+      arr_push(&clusters, ((TriangleCluster) { .start = t }));
+    }
+
+    clusters.data[clusters.length - 1].count++;
+  }
+
+  if (clusters.length <= 1) {
+    arr_free(&clusters);
+    return;
+  }
+
+  float center[3] = { 0.f };
+  for (uint32_t i = 0; i < 3; i++) {
+    center[i] = (position->min[i] + position->max[i]) / 2.f;
+  }
+
+  for (size_t c = 0; c < clusters.length; c++) {
+    TriangleCluster* cluster = &clusters.data[c];
+    float centroid[3] = { 0.f };
+    float normal[3] = { 0.f };
+    float area = 0.f;
+
+    for (uint32_t t = cluster->start; t < cluster->start + cluster->count; t++) {
+      float* a = (float*) getAttributeElement(model, position, indices[3 * t + 0]);
+      float* b = (float*) getAttributeElement(model, position, indices[3 * t + 1]);
+      float* c = (float*) getAttributeElement(model, position, indices[3 * t + 2]);
+      float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+      float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+      float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+      float weight = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (uint32_t i = 0; i < 3; i++) {
+        centroid[i] += (a[i] + b[i] + c[i]) / 3.f * weight;
+        normal[i] += n[i];
+      }
+      area += weight;
+    }
+
+    float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    if (area > 0.f && length > 0.f) {
+      cluster->sort = 0.f;
+      for (uint32_t i = 0; i < 3; i++) {
+        cluster->sort += (centroid[i] / area - center[i]) * normal[i] / length;
+      }
+    }
+  }
+
+  qsort(clusters.data, clusters.length, sizeof(TriangleCluster), compareClusters);
+
+  uint32_t* output = malloc(indexCount * sizeof(uint32_t));
+  lovrAssert(output, "Out of memory");
+  uint32_t* cursor = output;
+  for (size_t c = 0; c < clusters.length; c++) {
+    memcpy(cursor, indices + 3 * clusters.data[c].start, 3 * clusters.data[c].count * sizeof(uint32_t));
+    cursor += 3 * clusters.data[c].count;
+  }
+
+  memcpy(indices, output, 3 * triangleCount * sizeof(uint32_t));
+  arr_free(&clusters);
+  free(output);
+}
+
+typedef arr_t(ModelAttribute*) arr_attribute_t;
+
+// A group of primitives that all use the same vertex attributes.  If nothing else reads from the
+// buffers of those attributes, the vertices can be merged and reordered for the whole group.
+typedef struct {
+  arr_t(uint32_t) primitives;
+  ModelAttribute* attributes[MAX_DEFAULT_ATTRIBUTES];
+  uint32_t vertexCount;
+} VertexGroup;
+
+static bool canRemapVertices(ModelData* model, VertexGroup* group) {
+  uint32_t vertexCount = ~0u;
+
+  for (uint32_t i = 0; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+    ModelAttribute* attribute = group->attributes[i];
+    if (!attribute) continue;
+    if (attribute->matrix || (vertexCount != ~0u && attribute->count != vertexCount)) return false;
+    vertexCount = attribute->count;
+  }
+
+  for (size_t i = 0; i < group->primitives.length; i++) {
+    if (!model->primitives[group->primitives.data[i]].indices) return false;
+  }
+
+  for (uint32_t i = 0; i < model->attributeCount; i++) {
+    ModelAttribute* other = &model->attributes[i];
+    bool member = false;
+    bool shared = false;
+    for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+      member |= group->attributes[j] == other;
+      shared |= group->attributes[j] && group->attributes[j]->buffer == other->buffer;
+    }
+    if (shared && !member) return false;
+  }
+
+  group->vertexCount = vertexCount;
+  return vertexCount != ~0u && vertexCount > 0;
+}
+
+// Applies a vertex remap (old index to new index, ~0u for unused vertices) to the vertex data and
+// to the index lists of a group.  Several old vertices can map to the same new one.
+static void remapVertices(ModelData* model, VertexGroup* group, uint32_t* remap, uint32_t newCount, arr_attribute_t* indexLists) {
+  for (size_t i = 0; i < indexLists->length; i++) {
+    ModelAttribute* indices = indexLists->data[i];
+    for (uint32_t j = 0; j < indices->count; j++) {
+      writeIndex(model, indices, j, remap[readIndex(model, indices, j)]);
+    }
+  }
+
+  for (uint32_t i = 0; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+    ModelAttribute* attribute = group->attributes[i];
+    if (!attribute) continue;
+    size_t size = getAttributeSize(attribute);
+    char* scratch = malloc(newCount * size);
+    lovrAssert(scratch, "Out of memory");
+
+    for (uint32_t v = 0; v < group->vertexCount; v++) {
+      if (remap[v] != ~0u) {
+        memcpy(scratch + remap[v] * size, getAttributeElement(model, attribute, v), size);
+      }
+    }
+
+    for (uint32_t v = 0; v < newCount; v++) {
+      memcpy(getAttributeElement(model, attribute, v), scratch + v * size, size);
+    }
+
+    attribute->count = newCount;
+    free(scratch);
+  }
+
+  group->vertexCount = newCount;
+}
+
+// Merges vertices whose attributes are identical
+static void deduplicateVertices(ModelData* model, VertexGroup* group, arr_attribute_t* indexLists) {
+  uint32_t* remap = malloc(group->vertexCount * sizeof(uint32_t));
+  uint32_t* unique = malloc(group->vertexCount * sizeof(uint32_t));
+  lovrAssert(remap && unique, "Out of memory");
+  map_t vertices;
+  map_init(&vertices, group->vertexCount);
+  uint32_t newCount = 0;
+
+  for (uint32_t v = 0; v < group->vertexCount; v++) {
+    uint64_t hash = 0;
+    for (uint32_t i = 0; i < MAX_DEFAULT_ATTRIBUTES; i++) {
+      if (group->attributes[i]) {
+        uint64_t h = hash64(getAttributeElement(model, group->attributes[i], v), getAttributeSize(group->attributes[i]));
+        hash = hash * 31 + h;
+      }
+    }
+
+    // Probe past hash matches that turn out to be different vertices
+    for (;;) {
+      uint64_t index = map_get(&vertices, hash);
+      if (index == MAP_NIL) {
+        map_set(&vertices, hash, newCount);
+        unique[newCount] = v;
+        remap[v] = newCount++;
+        break;
+      }
+
+      bool equal = true;
+      for (uint32_t i = 0; i < MAX_DEFAULT_ATTRIBUTES && equal; i++) {
+        ModelAttribute* attribute = group->attributes[i];
+        if (attribute) {
+          equal = !memcmp(getAttributeElement(model, attribute, v), getAttributeElement(model, attribute, unique[index]), getAttributeSize(attribute));
+        }
+      }
+
+      if (equal) {
+        remap[v] = (uint32_t) index;
+        break;
+      }
+
+      hash++;
+    }
+  }
+
+  map_free(&vertices);
+
+  if (newCount < group->vertexCount) {
+    remapVertices(model, group, remap, newCount, indexLists);
+  }
+
+  free(remap);
+  free(unique);
+}
+
+// Orders vertices by first use, so vertex fetches walk through memory linearly.  Unused vertices
+// are dropped.
+static void optimizeVertexFetch(ModelData* model, VertexGroup* group, arr_attribute_t* indexLists) {
+  uint32_t* remap = malloc(group->vertexCount * sizeof(uint32_t));
+  lovrAssert(remap, "Out of memory");
+  memset(remap, 0xff, group->vertexCount * sizeof(uint32_t));
+  uint32_t newCount = 0;
+
+  for (size_t i = 0; i < indexLists->length; i++) {
+    ModelAttribute* indices = indexLists->data[i];
+    for (uint32_t j = 0; j < indices->count; j++) {
+      uint32_t v = readIndex(model, indices, j);
+      if (remap[v] == ~0u) {
+        remap[v] = newCount++;
+      }
+    }
+  }
+
+  remapVertices(model, group, remap, newCount, indexLists);
+  free(remap);
+}
+
+static bool isIndexListValid(ModelData* model, ModelAttribute* indices, uint32_t vertexCount) {
+  if (indices->type != U8 && indices->type != U16 && indices->type != U32) return false;
+  for (uint32_t i = 0; i < indices->count; i++) {
+    if (readIndex(model, indices, i) >= vertexCount) return false;
+  }
+  return true;
+}
+
+// Optimizes the geometry of a model for the GPU.  This is opt-in since it rewrites the buffers:
+// - Identical vertices are merged.
+// - Triangles are ordered for the post-transform vertex cache, then clusters of them are ordered to
+//   reduce overdraw.
+// - Vertices are ordered by first use, for better vertex fetch locality.
+// Vertex data is only rewritten when the buffers it's in aren't read by anything else.  The results
+// live in the ModelData, so creating several Models from one ModelData only optimizes once.
+void lovrModelDataOptimize(ModelData* model) {
+  bool* visited = calloc(model->primitiveCount, sizeof(bool));
+  lovrAssert(visited, "Out of memory");
+  arr_attribute_t indexLists;
+  arr_init(&indexLists, realloc);
+
+  VertexGroup group;
+  arr_init(&group.primitives, realloc);
+
+  for (uint32_t p = 0; p < model->primitiveCount; p++) {
+    if (visited[p]) continue;
+
+    arr_clear(&group.primitives);
+    memcpy(group.attributes, model->primitives[p].attributes, sizeof(group.attributes));
+    for (uint32_t i = p; i < model->primitiveCount; i++) {
+      if (!visited[i] && !memcmp(model->primitives[i].attributes, group.attributes, sizeof(group.attributes))) {
+        arr_push(&group.primitives, i);
+        visited[i] = true;
+      }
+    }
+
+    ModelAttribute* position = group.attributes[ATTR_POSITION];
+    if (!position) continue;
+
+    // Unique index lists of the group (primitives can share them)
+    arr_clear(&indexLists);
+    bool valid = true;
+    for (size_t i = 0; i < group.primitives.length; i++) {
+      ModelAttribute* indices = model->primitives[group.primitives.data[i]].indices;
+      bool seen = false;
+      for (size_t j = 0; j < indexLists.length; j++) {
+        seen |= indexLists.data[j] == indices;
+      }
+      if (indices && !seen) {
+        valid &= isIndexListValid(model, indices, position->count);
+        arr_push(&indexLists, indices);
+      }
+    }
+
+    if (!valid) continue;
+
+    bool remappable = canRemapVertices(model, &group);
+    if (remappable) {
+      deduplicateVertices(model, &group, &indexLists);
+    }
+
+    for (size_t i = 0; i < group.primitives.length; i++) {
+      ModelPrimitive* primitive = &model->primitives[group.primitives.data[i]];
+      ModelAttribute* indices = primitive->indices;
+      if (primitive->mode != DRAW_TRIANGLES || !indices || indices->count < 3) continue;
+
+      // Primitives sharing an index list all get the same (first) optimization
+      bool done = false;
+      for (size_t j = 0; j < i; j++) {
+        done |= model->primitives[group.primitives.data[j]].indices == indices;
+      }
+      if (done) continue;
+
+      uint32_t count = indices->count - indices->count % 3;
+      uint32_t* list = malloc(count * sizeof(uint32_t));
+      lovrAssert(list, "Out of memory");
+      for (uint32_t j = 0; j < count; j++) {
+        list[j] = readIndex(model, indices, j);
+      }
+
+      optimizeVertexCache(list, count, position->count);
+
+      if (position->type == F32 && position->components >= 3 && position->hasMin && position->hasMax) {
+        optimizeOverdraw(model, position, list, count);
+      }
+
+      for (uint32_t j = 0; j < count; j++) {
+        writeIndex(model, indices, j, list[j]);
+      }
+
+      free(list);
+    }
+
+    if (remappable) {
+      optimizeVertexFetch(model, &group, &indexLists);
+    }
+  }
+
+  arr_free(&group.primitives);
+  arr_free(&indexLists);
+  free(visited);
+}
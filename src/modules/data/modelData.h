@@ -6,7 +6,8 @@
 
 #pragma once
 
-#define MAX_BONES 48
+#define MAX_BONES 256
+#define MAX_LODS 4
 
 struct Blob;
 struct Image;
@@ -148,11 +149,21 @@ typedef struct {
   TextureWrap wraps[MAX_MATERIAL_TEXTURES];
 } ModelMaterial;
 
+// A simplified version of a primitive, as a range of ModelData's lodIndices (32 bit indices into
+// the primitive's vertices).  It's used when the primitive covers less than screenSize of the view.
+typedef struct {
+  uint32_t start;
+  uint32_t count;
+  float screenSize;
+} ModelLod;
+
 typedef struct {
   ModelAttribute* attributes[MAX_DEFAULT_ATTRIBUTES];
   ModelAttribute* indices;
   DrawMode mode;
   uint32_t material;
+  ModelLod lods[MAX_LODS - 1];
+  uint32_t lodCount;
 } ModelPrimitive;
 
 typedef struct {
@@ -170,6 +181,8 @@ typedef struct {
   uint32_t primitiveIndex;
   uint32_t primitiveCount;
   uint32_t skin;
+  uint32_t instanceCount; // Number of EXT_mesh_gpu_instancing instances, 0 if not instanced
+  ModelAttribute* instances[3]; // Instance translations, rotations, and scales (all optional)
   bool matrix;
 } ModelNode;
 
@@ -212,6 +225,9 @@ typedef struct ModelData {
   uint32_t jointCount;
   uint32_t charCount;
 
+  uint32_t* lodIndices;
+  uint32_t lodIndexCount;
+
   map_t animationMap;
   map_t materialMap;
   map_t nodeMap;
@@ -219,9 +235,13 @@ typedef struct ModelData {
 
 typedef void* ModelDataIO(const char* filename, size_t* bytesRead);
 
-ModelData* lovrModelDataCreate(struct Blob* blob, ModelDataIO* io);
+ModelData* lovrModelDataCreate(struct Blob* blob, ModelDataIO* io, bool optimize);
 ModelData* lovrModelDataInitGltf(ModelData* model, struct Blob* blob, ModelDataIO* io);
 ModelData* lovrModelDataInitObj(ModelData* model, struct Blob* blob, ModelDataIO* io);
 ModelData* lovrModelDataInitStl(ModelData* model, struct Blob* blob, ModelDataIO* io);
+ModelData* lovrModelDataInitCache(ModelData* model, struct Blob* blob, ModelDataIO* io);
+struct Blob* lovrModelDataEncode(ModelData* model);
 void lovrModelDataDestroy(void* ref);
 void lovrModelDataAllocate(ModelData* model);
+void lovrModelDataOptimize(ModelData* model);
+void lovrModelDataGenerateLods(ModelData* model);
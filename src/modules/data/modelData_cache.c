@@ -0,0 +1,598 @@
+#include "data/modelData.h"
+#include "data/blob.h"
+#include "data/image.h"
+#include <stdlib.h>
+#include <string.h>
+
+// LÖVR's own ModelData format, meant to be written once from a loaded ModelData and loaded quickly
+// later.  It's a header followed by 16 byte aligned sections of fixed size records, then the raw
+// buffer and image data.  Records refer to each other by index and to data by file offset, so
+// loading is just a pass over the records with no parsing, and buffers point into the file (which
+// is memory mapped when possible).  The format isn't meant to be portable across LÖVR versions.
+
+#define MAGIC_LOVR 0x4c444d4c // LMDL
+#define CACHE_VERSION 1
+#define CACHE_NONE (~0u)
+
+typedef enum {
+  SECTION_BUFFERS,
+  SECTION_IMAGES,
+  SECTION_MIPMAPS,
+  SECTION_MATERIALS,
+  SECTION_ATTRIBUTES,
+  SECTION_PRIMITIVES,
+  SECTION_ANIMATIONS,
+  SECTION_CHANNELS,
+  SECTION_SKINS,
+  SECTION_NODES,
+  SECTION_CHILDREN,
+  SECTION_JOINTS,
+  SECTION_CHARS,
+  SECTION_LOD_INDICES,
+  SECTION_DATA,
+  MAX_SECTIONS
+} CacheSection;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t rootNode;
+  uint32_t counts[MAX_SECTIONS];
+  uint64_t offsets[MAX_SECTIONS];
+} CacheHeader;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t stride;
+  uint32_t padding;
+} CacheBuffer;
+
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;
+  uint32_t mipmap;
+  uint32_t mipmapCount;
+  uint32_t padding;
+} CacheImage;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+} CacheMipmap;
+
+typedef struct {
+  uint32_t name;
+  uint32_t images[MAX_MATERIAL_TEXTURES];
+  uint32_t filters[MAX_MATERIAL_TEXTURES];
+  uint32_t wraps[MAX_MATERIAL_TEXTURES][3];
+  float anisotropy[MAX_MATERIAL_TEXTURES];
+  float scalars[MAX_MATERIAL_SCALARS];
+  float colors[MAX_MATERIAL_COLORS][4];
+} CacheMaterial;
+
+typedef struct {
+  uint32_t offset;
+  uint32_t buffer;
+  uint32_t count;
+  uint32_t type;
+  uint32_t components;
+  uint32_t flags;
+  float min[4];
+  float max[4];
+} CacheAttribute;
+
+enum {
+  ATTRIBUTE_NORMALIZED = (1 << 0),
+  ATTRIBUTE_MATRIX = (1 << 1),
+  ATTRIBUTE_HAS_MIN = (1 << 2),
+  ATTRIBUTE_HAS_MAX = (1 << 3)
+};
+
+typedef struct {
+  uint32_t attributes[MAX_DEFAULT_ATTRIBUTES];
+  uint32_t indices;
+  uint32_t mode;
+  uint32_t material;
+  uint32_t lodCount;
+  ModelLod lods[MAX_LODS - 1];
+} CachePrimitive;
+
+typedef struct {
+  uint32_t name;
+  uint32_t channelIndex;
+  uint32_t channelCount;
+  float duration;
+} CacheAnimation;
+
+typedef struct {
+  uint32_t nodeIndex;
+  uint32_t property;
+  uint32_t smoothing;
+  uint32_t keyframeCount;
+  uint64_t times;
+  uint64_t data;
+} CacheChannel;
+
+typedef struct {
+  uint32_t jointIndex;
+  uint32_t jointCount;
+  uint64_t inverseBindMatrices;
+} CacheSkin;
+
+typedef struct {
+  uint32_t name;
+  uint32_t childIndex;
+  uint32_t childCount;
+  uint32_t primitiveIndex;
+  uint32_t primitiveCount;
+  uint32_t skin;
+  uint32_t matrix;
+  float transform[16];
+} CacheNode;
+
+static const size_t sectionSizes[] = {
+  [SECTION_BUFFERS] = sizeof(CacheBuffer),
+  [SECTION_IMAGES] = sizeof(CacheImage),
+  [SECTION_MIPMAPS] = sizeof(CacheMipmap),
+  [SECTION_MATERIALS] = sizeof(CacheMaterial),
+  [SECTION_ATTRIBUTES] = sizeof(CacheAttribute),
+  [SECTION_PRIMITIVES] = sizeof(CachePrimitive),
+  [SECTION_ANIMATIONS] = sizeof(CacheAnimation),
+  [SECTION_CHANNELS] = sizeof(CacheChannel),
+  [SECTION_SKINS] = sizeof(CacheSkin),
+  [SECTION_NODES] = sizeof(CacheNode),
+  [SECTION_CHILDREN] = sizeof(uint32_t),
+  [SECTION_JOINTS] = sizeof(uint32_t),
+  [SECTION_CHARS] = sizeof(char),
+  [SECTION_LOD_INDICES] = sizeof(uint32_t),
+  [SECTION_DATA] = 1
+};
+
+ModelData* lovrModelDataInitCache(ModelData* model, Blob* source, ModelDataIO* io) {
+  CacheHeader* header = source->data;
+  if (source->size < sizeof(CacheHeader) || header->magic != MAGIC_LOVR) {
+    return NULL;
+  }
+
+  lovrAssert(header->version == CACHE_VERSION, "Model file was written by a different version of LÖVR (version %d, expected %d)", header->version, CACHE_VERSION);
+  for (uint32_t i = 0; i < MAX_SECTIONS; i++) {
+    lovrAssert(header->offsets[i] + (uint64_t) header->counts[i] * sectionSizes[i] <= source->size, "Model file is truncated");
+  }
+
+  char* base = source->data;
+  uint32_t* counts = header->counts;
+  uint64_t* offsets = header->offsets;
+  lovrAssert(counts[SECTION_NODES] == 0 || header->rootNode < counts[SECTION_NODES], "Invalid root node");
+
+  model->blobCount = 1;
+  model->bufferCount = counts[SECTION_BUFFERS];
+  model->imageCount = counts[SECTION_IMAGES];
+  model->materialCount = counts[SECTION_MATERIALS];
+  model->attributeCount = counts[SECTION_ATTRIBUTES];
+  model->primitiveCount = counts[SECTION_PRIMITIVES];
+  model->animationCount = counts[SECTION_ANIMATIONS];
+  model->skinCount = counts[SECTION_SKINS];
+  model->nodeCount = counts[SECTION_NODES];
+  model->channelCount = counts[SECTION_CHANNELS];
+  lovrModelDataAllocate(model);
+
+  // Index lists and names are used straight out of the file
+  model->children = (uint32_t*) (base + offsets[SECTION_CHILDREN]);
+  model->joints = (uint32_t*) (base + offsets[SECTION_JOINTS]);
+  model->chars = base + offsets[SECTION_CHARS];
+  model->childCount = counts[SECTION_CHILDREN];
+  model->jointCount = counts[SECTION_JOINTS];
+  model->charCount = counts[SECTION_CHARS];
+  model->rootNode = header->rootNode;
+
+  lovrRetain(source);
+  model->blobs[0] = source;
+
+  CacheBuffer* buffers = (CacheBuffer*) (base + offsets[SECTION_BUFFERS]);
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    lovrAssert(buffers[i].offset + buffers[i].size <= source->size, "Model file is truncated");
+    model->buffers[i].data = base + buffers[i].offset;
+    model->buffers[i].size = buffers[i].size;
+    model->buffers[i].stride = buffers[i].stride;
+  }
+
+  // Compressed images reference their mipmaps in the file, other images get a copy of their pixels
+  CacheImage* images = (CacheImage*) (base + offsets[SECTION_IMAGES]);
+  CacheMipmap* mipmaps = (CacheMipmap*) (base + offsets[SECTION_MIPMAPS]);
+  for (uint32_t i = 0; i < model->imageCount; i++) {
+    CacheImage* cached = &images[i];
+    lovrAssert(cached->mipmap + MAX(cached->mipmapCount, 1) <= counts[SECTION_MIPMAPS], "Model file is truncated");
+    CacheMipmap* mipmap = &mipmaps[cached->mipmap];
+    for (uint32_t j = 0; j < MAX(cached->mipmapCount, 1); j++) {
+      lovrAssert(mipmap[j].offset + mipmap[j].size <= source->size, "Model file is truncated");
+    }
+
+    if (cached->mipmapCount > 0) {
+      Image* image = calloc(1, sizeof(Image));
+      lovrAssert(image, "Out of memory");
+      image->ref = 1;
+      image->blob = lovrBlobCreate(NULL, 0, NULL);
+      image->width = cached->width;
+      image->height = cached->height;
+      image->format = cached->format;
+      image->mipmapCount = cached->mipmapCount;
+      image->mipmaps = malloc(image->mipmapCount * sizeof(Mipmap));
+      lovrAssert(image->mipmaps, "Out of memory");
+      for (uint32_t j = 0; j < image->mipmapCount; j++) {
+        image->mipmaps[j] = (Mipmap) {
+          .width = mipmap[j].width,
+          .height = mipmap[j].height,
+          .size = mipmap[j].size,
+          .data = base + mipmap[j].offset
+        };
+      }
+      lovrRetain(source);
+      image->source = source;
+      model->images[i] = image;
+    } else {
+      Blob* pixels = lovrBlobCreate(base + mipmap->offset, mipmap->size, NULL);
+      model->images[i] = lovrImageCreate(cached->width, cached->height, pixels, 0, cached->format);
+      pixels->data = NULL;
+      lovrRelease(pixels, lovrBlobDestroy);
+    }
+  }
+
+  CacheMaterial* materials = (CacheMaterial*) (base + offsets[SECTION_MATERIALS]);
+  for (uint32_t i = 0; i < model->materialCount; i++) {
+    CacheMaterial* cached = &materials[i];
+    ModelMaterial* material = &model->materials[i];
+    material->name = cached->name == CACHE_NONE ? NULL : model->chars + cached->name;
+    for (uint32_t j = 0; j < MAX_MATERIAL_TEXTURES; j++) {
+      material->images[j] = cached->images[j];
+      material->filters[j] = (TextureFilter) { .mode = cached->filters[j], .anisotropy = cached->anisotropy[j] };
+      material->wraps[j] = (TextureWrap) { cached->wraps[j][0], cached->wraps[j][1], cached->wraps[j][2] };
+    }
+    memcpy(material->scalars, cached->scalars, sizeof(material->scalars));
+    memcpy(material->colors, cached->colors, sizeof(material->colors));
+    if (material->name) {
+      map_set(&model->materialMap, hash64(material->name, strlen(material->name)), i);
+    }
+  }
+
+  CacheAttribute* attributes = (CacheAttribute*) (base + offsets[SECTION_ATTRIBUTES]);
+  for (uint32_t i = 0; i < model->attributeCount; i++) {
+    CacheAttribute* cached = &attributes[i];
+    lovrAssert(cached->buffer < model->bufferCount, "Invalid attribute buffer");
+    model->attributes[i] = (ModelAttribute) {
+      .offset = cached->offset,
+      .buffer = cached->buffer,
+      .count = cached->count,
+      .type = cached->type,
+      .components = cached->components,
+      .normalized = !!(cached->flags & ATTRIBUTE_NORMALIZED),
+      .matrix = !!(cached->flags & ATTRIBUTE_MATRIX),
+      .hasMin = !!(cached->flags & ATTRIBUTE_HAS_MIN),
+      .hasMax = !!(cached->flags & ATTRIBUTE_HAS_MAX)
+    };
+    memcpy(model->attributes[i].min, cached->min, sizeof(cached->min));
+    memcpy(model->attributes[i].max, cached->max, sizeof(cached->max));
+  }
+
+  CachePrimitive* primitives = (CachePrimitive*) (base + offsets[SECTION_PRIMITIVES]);
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    CachePrimitive* cached = &primitives[i];
+    ModelPrimitive* primitive = &model->primitives[i];
+    for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+      lovrAssert(cached->attributes[j] == CACHE_NONE || cached->attributes[j] < model->attributeCount, "Invalid primitive attribute");
+      primitive->attributes[j] = cached->attributes[j] == CACHE_NONE ? NULL : &model->attributes[cached->attributes[j]];
+    }
+    lovrAssert(cached->indices == CACHE_NONE || cached->indices < model->attributeCount, "Invalid primitive indices");
+    lovrAssert(cached->lodCount < MAX_LODS, "Invalid primitive LOD count");
+    primitive->indices = cached->indices == CACHE_NONE ? NULL : &model->attributes[cached->indices];
+    primitive->mode = cached->mode;
+    primitive->material = cached->material;
+    primitive->lodCount = cached->lodCount;
+    memcpy(primitive->lods, cached->lods, sizeof(cached->lods));
+  }
+
+  CacheAnimation* animations = (CacheAnimation*) (base + offsets[SECTION_ANIMATIONS]);
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    CacheAnimation* cached = &animations[i];
+    ModelAnimation* animation = &model->animations[i];
+    lovrAssert(cached->channelIndex + cached->channelCount <= model->channelCount, "Invalid animation channels");
+    animation->name = cached->name == CACHE_NONE ? NULL : model->chars + cached->name;
+    animation->channels = &model->channels[cached->channelIndex];
+    animation->channelCount = cached->channelCount;
+    animation->duration = cached->duration;
+    if (animation->name) {
+      map_set(&model->animationMap, hash64(animation->name, strlen(animation->name)), i);
+    }
+  }
+
+  CacheChannel* channels = (CacheChannel*) (base + offsets[SECTION_CHANNELS]);
+  for (uint32_t i = 0; i < model->channelCount; i++) {
+    CacheChannel* cached = &channels[i];
+    lovrAssert(cached->times < source->size && cached->data < source->size, "Model file is truncated");
+    model->channels[i] = (ModelAnimationChannel) {
+      .nodeIndex = cached->nodeIndex,
+      .property = cached->property,
+      .smoothing = cached->smoothing,
+      .keyframeCount = cached->keyframeCount,
+      .times = (float*) (base + cached->times),
+      .data = (float*) (base + cached->data)
+    };
+  }
+
+  CacheSkin* skins = (CacheSkin*) (base + offsets[SECTION_SKINS]);
+  for (uint32_t i = 0; i < model->skinCount; i++) {
+    CacheSkin* cached = &skins[i];
+    lovrAssert(cached->jointIndex + cached->jointCount <= model->jointCount, "Invalid skin joints");
+    model->skins[i].joints = &model->joints[cached->jointIndex];
+    model->skins[i].jointCount = cached->jointCount;
+    model->skins[i].inverseBindMatrices = cached->inverseBindMatrices == ~0ull ? NULL : (float*) (base + cached->inverseBindMatrices);
+  }
+
+  CacheNode* nodes = (CacheNode*) (base + offsets[SECTION_NODES]);
+  for (uint32_t i = 0; i < model->nodeCount; i++) {
+    CacheNode* cached = &nodes[i];
+    ModelNode* node = &model->nodes[i];
+    lovrAssert(cached->childIndex + cached->childCount <= model->childCount, "Invalid node children");
+    node->name = cached->name == CACHE_NONE ? NULL : model->chars + cached->name;
+    memcpy(node->transform.matrix, cached->transform, sizeof(cached->transform));
+    node->children = &model->children[cached->childIndex];
+    node->childCount = cached->childCount;
+    node->primitiveIndex = cached->primitiveIndex;
+    node->primitiveCount = cached->primitiveCount;
+    node->skin = cached->skin;
+    node->matrix = cached->matrix;
+    if (node->name) {
+      map_set(&model->nodeMap, hash64(node->name, strlen(node->name)), i);
+    }
+  }
+
+  if (counts[SECTION_LOD_INDICES] > 0) {
+    size_t size = counts[SECTION_LOD_INDICES] * sizeof(uint32_t);
+    model->lodIndices = malloc(size);
+    lovrAssert(model->lodIndices, "Out of memory");
+    memcpy(model->lodIndices, base + offsets[SECTION_LOD_INDICES], size);
+    model->lodIndexCount = counts[SECTION_LOD_INDICES];
+  }
+
+  return model;
+}
+
+static uint32_t appendString(char* chars, uint32_t* length, const char* string) {
+  if (!string) {
+    return CACHE_NONE;
+  }
+
+  uint32_t offset = *length;
+  size_t size = strlen(string) + 1;
+  if (chars) {
+    memcpy(chars + offset, string, size);
+  }
+  *length += size;
+  return offset;
+}
+
+// Channel keyframes and inverse bind matrices point into buffers, this converts them to file offsets
+static uint64_t getDataOffset(ModelData* model, uint64_t* bufferOffsets, const void* pointer) {
+  if (!pointer) {
+    return ~0ull;
+  }
+
+  const char* p = pointer;
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    ModelBuffer* buffer = &model->buffers[i];
+    if (p >= buffer->data && p < buffer->data + buffer->size) {
+      return bufferOffsets[i] + (p - buffer->data);
+    }
+  }
+
+  lovrThrow("Model data is not stored in one of its buffers");
+  return ~0ull;
+}
+
+Blob* lovrModelDataEncode(ModelData* model) {
+  CacheHeader header = { .magic = MAGIC_LOVR, .version = CACHE_VERSION, .rootNode = model->rootNode };
+  uint32_t* counts = header.counts;
+  uint64_t* offsets = header.offsets;
+
+  uint32_t charCount = 0;
+  for (uint32_t i = 0; i < model->materialCount; i++) appendString(NULL, &charCount, model->materials[i].name);
+  for (uint32_t i = 0; i < model->animationCount; i++) appendString(NULL, &charCount, model->animations[i].name);
+  for (uint32_t i = 0; i < model->nodeCount; i++) appendString(NULL, &charCount, model->nodes[i].name);
+
+  uint32_t mipmapCount = 0;
+  for (uint32_t i = 0; i < model->imageCount; i++) {
+    mipmapCount += MAX(model->images[i]->mipmapCount, 1);
+  }
+
+  counts[SECTION_BUFFERS] = model->bufferCount;
+  counts[SECTION_IMAGES] = model->imageCount;
+  counts[SECTION_MIPMAPS] = mipmapCount;
+  counts[SECTION_MATERIALS] = model->materialCount;
+  counts[SECTION_ATTRIBUTES] = model->attributeCount;
+  counts[SECTION_PRIMITIVES] = model->primitiveCount;
+  counts[SECTION_ANIMATIONS] = model->animationCount;
+  counts[SECTION_CHANNELS] = model->channelCount;
+  counts[SECTION_SKINS] = model->skinCount;
+  counts[SECTION_NODES] = model->nodeCount;
+  counts[SECTION_CHILDREN] = model->childCount;
+  counts[SECTION_JOINTS] = model->jointCount;
+  counts[SECTION_CHARS] = charCount;
+  counts[SECTION_LOD_INDICES] = model->lodIndexCount;
+
+  size_t size = ALIGN(sizeof(CacheHeader), 16);
+  for (uint32_t i = 0; i < SECTION_DATA; i++) {
+    offsets[i] = size;
+    size += ALIGN(counts[i] * sectionSizes[i], 16);
+  }
+
+  offsets[SECTION_DATA] = size;
+  uint64_t* bufferOffsets = malloc(MAX(model->bufferCount, 1) * sizeof(uint64_t));
+  lovrAssert(bufferOffsets, "Out of memory");
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    bufferOffsets[i] = size;
+    size += ALIGN(model->buffers[i].size, 16);
+  }
+
+  for (uint32_t i = 0; i < model->imageCount; i++) {
+    Image* image = model->images[i];
+    if (image->mipmapCount > 0) {
+      for (uint32_t j = 0; j < image->mipmapCount; j++) {
+        size += ALIGN(image->mipmaps[j].size, 16);
+      }
+    } else {
+      size += ALIGN(image->blob->size, 16);
+    }
+  }
+
+  char* data = calloc(1, size);
+  lovrAssert(data, "Out of memory");
+  memcpy(data, &header, sizeof(header));
+
+  char* chars = data + offsets[SECTION_CHARS];
+  charCount = 0;
+
+  CacheBuffer* buffers = (CacheBuffer*) (data + offsets[SECTION_BUFFERS]);
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    ModelBuffer* buffer = &model->buffers[i];
+    buffers[i] = (CacheBuffer) { bufferOffsets[i], buffer->size, buffer->stride, 0 };
+    if (buffer->data) {
+      memcpy(data + bufferOffsets[i], buffer->data, buffer->size);
+    }
+  }
+
+  uint64_t cursor = offsets[SECTION_DATA];
+  for (uint32_t i = 0; i < model->bufferCount; i++) {
+    cursor += ALIGN(model->buffers[i].size, 16);
+  }
+
+  CacheImage* images = (CacheImage*) (data + offsets[SECTION_IMAGES]);
+  CacheMipmap* mipmaps = (CacheMipmap*) (data + offsets[SECTION_MIPMAPS]);
+  uint32_t mipmap = 0;
+  for (uint32_t i = 0; i < model->imageCount; i++) {
+    Image* image = model->images[i];
+    images[i] = (CacheImage) { image->width, image->height, image->format, mipmap, image->mipmapCount, 0 };
+
+    if (image->mipmapCount > 0) {
+      for (uint32_t j = 0; j < image->mipmapCount; j++, mipmap++) {
+        Mipmap* m = &image->mipmaps[j];
+        mipmaps[mipmap] = (CacheMipmap) { cursor, m->size, m->width, m->height };
+        memcpy(data + cursor, m->data, m->size);
+        cursor += ALIGN(m->size, 16);
+      }
+    } else {
+      lovrAssert(image->blob->data, "Model images need pixel data to be encoded");
+      mipmaps[mipmap++] = (CacheMipmap) { cursor, image->blob->size, image->width, image->height };
+      memcpy(data + cursor, image->blob->data, image->blob->size);
+      cursor += ALIGN(image->blob->size, 16);
+    }
+  }
+
+  CacheMaterial* materials = (CacheMaterial*) (data + offsets[SECTION_MATERIALS]);
+  for (uint32_t i = 0; i < model->materialCount; i++) {
+    ModelMaterial* material = &model->materials[i];
+    CacheMaterial* cached = &materials[i];
+    cached->name = appendString(chars, &charCount, material->name);
+    for (uint32_t j = 0; j < MAX_MATERIAL_TEXTURES; j++) {
+      cached->images[j] = material->images[j];
+      cached->filters[j] = material->filters[j].mode;
+      cached->anisotropy[j] = material->filters[j].anisotropy;
+      cached->wraps[j][0] = material->wraps[j].s;
+      cached->wraps[j][1] = material->wraps[j].t;
+      cached->wraps[j][2] = material->wraps[j].r;
+    }
+    memcpy(cached->scalars, material->scalars, sizeof(cached->scalars));
+    memcpy(cached->colors, material->colors, sizeof(cached->colors));
+  }
+
+  CacheAttribute* attributes = (CacheAttribute*) (data + offsets[SECTION_ATTRIBUTES]);
+  for (uint32_t i = 0; i < model->attributeCount; i++) {
+    ModelAttribute* attribute = &model->attributes[i];
+    CacheAttribute* cached = &attributes[i];
+    cached->offset = attribute->offset;
+    cached->buffer = attribute->buffer;
+    cached->count = attribute->count;
+    cached->type = attribute->type;
+    cached->components = attribute->components;
+    cached->flags =
+      (attribute->normalized ? ATTRIBUTE_NORMALIZED : 0) |
+      (attribute->matrix ? ATTRIBUTE_MATRIX : 0) |
+      (attribute->hasMin ? ATTRIBUTE_HAS_MIN : 0) |
+      (attribute->hasMax ? ATTRIBUTE_HAS_MAX : 0);
+    memcpy(cached->min, attribute->min, sizeof(cached->min));
+    memcpy(cached->max, attribute->max, sizeof(cached->max));
+  }
+
+  CachePrimitive* primitives = (CachePrimitive*) (data + offsets[SECTION_PRIMITIVES]);
+  for (uint32_t i = 0; i < model->primitiveCount; i++) {
+    ModelPrimitive* primitive = &model->primitives[i];
+    CachePrimitive* cached = &primitives[i];
+    for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+      cached->attributes[j] = primitive->attributes[j] ? (uint32_t) (primitive->attributes[j] - model->attributes) : CACHE_NONE;
+    }
+    cached->indices = primitive->indices ? (uint32_t) (primitive->indices - model->attributes) : CACHE_NONE;
+    cached->mode = primitive->mode;
+    cached->material = primitive->material;
+    cached->lodCount = primitive->lodCount;
+    memcpy(cached->lods, primitive->lods, sizeof(cached->lods));
+  }
+
+  CacheAnimation* animations = (CacheAnimation*) (data + offsets[SECTION_ANIMATIONS]);
+  for (uint32_t i = 0; i < model->animationCount; i++) {
+    ModelAnimation* animation = &model->animations[i];
+    animations[i] = (CacheAnimation) {
+      .name = appendString(chars, &charCount, animation->name),
+      .channelIndex = (uint32_t) (animation->channels - model->channels),
+      .channelCount = animation->channelCount,
+      .duration = animation->duration
+    };
+  }
+
+  CacheChannel* channels = (CacheChannel*) (data + offsets[SECTION_CHANNELS]);
+  for (uint32_t i = 0; i < model->channelCount; i++) {
+    ModelAnimationChannel* channel = &model->channels[i];
+    channels[i] = (CacheChannel) {
+      .nodeIndex = channel->nodeIndex,
+      .property = channel->property,
+      .smoothing = channel->smoothing,
+      .keyframeCount = channel->keyframeCount,
+      .times = getDataOffset(model, bufferOffsets, channel->times),
+      .data = getDataOffset(model, bufferOffsets, channel->data)
+    };
+  }
+
+  CacheSkin* skins = (CacheSkin*) (data + offsets[SECTION_SKINS]);
+  for (uint32_t i = 0; i < model->skinCount; i++) {
+    ModelSkin* skin = &model->skins[i];
+    skins[i] = (CacheSkin) {
+      .jointIndex = (uint32_t) (skin->joints - model->joints),
+      .jointCount = skin->jointCount,
+      .inverseBindMatrices = getDataOffset(model, bufferOffsets, skin->inverseBindMatrices)
+    };
+  }
+
+  CacheNode* nodes = (CacheNode*) (data + offsets[SECTION_NODES]);
+  for (uint32_t i = 0; i < model->nodeCount; i++) {
+    ModelNode* node = &model->nodes[i];
+    CacheNode* cached = &nodes[i];
+    cached->name = appendString(chars, &charCount, node->name);
+    cached->childIndex = node->childCount > 0 ? (uint32_t) (node->children - model->children) : 0;
+    cached->childCount = node->childCount;
+    cached->primitiveIndex = node->primitiveIndex;
+    cached->primitiveCount = node->primitiveCount;
+    cached->skin = node->skin;
+    cached->matrix = node->matrix;
+    memcpy(cached->transform, node->transform.matrix, sizeof(cached->transform));
+  }
+
+  memcpy(data + offsets[SECTION_CHILDREN], model->children, model->childCount * sizeof(uint32_t));
+  memcpy(data + offsets[SECTION_JOINTS], model->joints, model->jointCount * sizeof(uint32_t));
+  if (model->lodIndexCount > 0) {
+    memcpy(data + offsets[SECTION_LOD_INDICES], model->lodIndices, model->lodIndexCount * sizeof(uint32_t));
+  }
+
+  free(bufferOffsets);
+  return lovrBlobCreate(data, size, "Model");
+}
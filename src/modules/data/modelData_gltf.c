@@ -3,10 +3,16 @@
 #include "data/image.h"
 #include "core/maf.h"
 #include "lib/jsmn/jsmn.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
 #include <stdbool.h>
+#include <stdio.h>
+#include <setjmp.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
 
 #define MAX_STACK_TOKENS 1024
 
@@ -126,6 +132,346 @@ static void* decodeBase64(char* str, size_t length, size_t decodedSize) {
   return data;
 }
 
+// EXT_meshopt_compression decoders, following the bitstream described in the extension spec
+
+typedef enum {
+  MESHOPT_ATTRIBUTES,
+  MESHOPT_TRIANGLES,
+  MESHOPT_INDICES
+} MeshoptMode;
+
+typedef enum {
+  MESHOPT_FILTER_NONE,
+  MESHOPT_FILTER_OCTAHEDRAL,
+  MESHOPT_FILTER_QUATERNION,
+  MESHOPT_FILTER_EXPONENTIAL
+} MeshoptFilter;
+
+typedef struct {
+  uint32_t buffer;
+  size_t offset;
+  size_t length;
+  size_t stride;
+  size_t count;
+  MeshoptMode mode;
+  MeshoptFilter filter;
+} gltfMeshopt;
+
+static const uint8_t* meshoptDecodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* buffer, size_t size) {
+  const uint8_t* header = data;
+  size_t headerSize = (size / 16 + 3) / 4;
+  if ((size_t) (end - data) < headerSize) return NULL;
+  data += headerSize;
+
+  for (size_t i = 0; i < size; i += 16) {
+    if ((size_t) (end - data) < 24) return NULL;
+    size_t group = i / 16;
+    uint32_t bits = (header[group / 4] >> ((group % 4) * 2)) & 3;
+    uint8_t* out = buffer + i;
+
+    if (bits == 0) {
+      memset(out, 0, 16);
+    } else if (bits == 3) {
+      memcpy(out, data, 16);
+      data += 16;
+    } else {
+      // Packed 2 or 4 bit values, where an all-ones value escapes to a full byte stored afterwards
+      uint32_t width = bits == 1 ? 2 : 4;
+      uint32_t mask = (1 << width) - 1;
+      const uint8_t* extra = data + 16 * width / 8;
+      for (uint32_t j = 0; j < 16; j++) {
+        uint32_t value = (data[j * width / 8] >> (8 - width - (j * width) % 8)) & mask;
+        out[j] = value == mask ? *extra++ : value;
+      }
+      data = extra;
+    }
+  }
+
+  return data;
+}
+
+static bool meshoptDecodeVertices(uint8_t* dst, size_t count, size_t stride, const uint8_t* data, size_t length) {
+  if (stride == 0 || stride > 256 || stride % 4 != 0 || length < 1 + stride) return false;
+  if ((data[0] & 0xf0) != 0xa0 || (data[0] & 0x0f) > 0) return false;
+  const uint8_t* end = data + length;
+  data++;
+
+  uint8_t last[256];
+  uint8_t deltas[256];
+  memcpy(last, end - stride, stride);
+
+  size_t blockSize = (8192 / stride) & ~15;
+  blockSize = MIN(blockSize, 256);
+  for (size_t offset = 0; offset < count; offset += blockSize) {
+    size_t n = MIN(blockSize, count - offset);
+    uint8_t* block = dst + offset * stride;
+
+    // Each byte of the vertex is stored as its own delta-encoded stream
+    for (size_t k = 0; k < stride; k++) {
+      if (!(data = meshoptDecodeBytes(data, end, deltas, (n + 15) & ~15))) return false;
+      uint8_t p = last[k];
+      for (size_t i = 0; i < n; i++) {
+        uint8_t v = deltas[i];
+        p += (uint8_t) (-(v & 1) ^ (v >> 1));
+        block[i * stride + k] = p;
+      }
+    }
+
+    memcpy(last, block + (n - 1) * stride, stride);
+  }
+
+  return (size_t) (end - data) == MAX(stride, 32);
+}
+
+static uint32_t meshoptDecodeVByte(const uint8_t** data) {
+  const uint8_t* p = *data;
+  uint32_t result = *p & 127;
+  if (*p++ >= 128) {
+    for (uint32_t i = 0, shift = 7; i < 4; i++, shift += 7) {
+      uint8_t group = *p++;
+      result |= (uint32_t) (group & 127) << shift;
+      if (group < 128) break;
+    }
+  }
+  *data = p;
+  return result;
+}
+
+static uint32_t meshoptDecodeIndex(const uint8_t** data, uint32_t last) {
+  uint32_t v = meshoptDecodeVByte(data);
+  return last + ((v >> 1) ^ -(v & 1));
+}
+
+static void meshoptWriteIndex(void* dst, size_t stride, size_t i, uint32_t index) {
+  if (stride == 2) {
+    ((uint16_t*) dst)[i] = index;
+  } else {
+    ((uint32_t*) dst)[i] = index;
+  }
+}
+
+static bool meshoptDecodeTriangles(void* dst, size_t count, size_t stride, const uint8_t* data, size_t length) {
+  if (count % 3 != 0 || (stride != 2 && stride != 4) || length < 1 + count / 3 + 16) return false;
+  if ((data[0] & 0xf0) != 0xe0 || (data[0] & 0x0f) > 1) return false;
+
+  uint32_t edges[16][2];
+  uint32_t vertices[16];
+  memset(edges, 0xff, sizeof(edges));
+  memset(vertices, 0xff, sizeof(vertices));
+  uint32_t edgeOffset = 0;
+  uint32_t vertexOffset = 0;
+  uint32_t next = 0;
+  uint32_t last = 0;
+  uint32_t fecmax = (data[0] & 0x0f) >= 1 ? 13 : 15;
+
+  const uint8_t* code = data + 1;
+  const uint8_t* end = data + length - 16;
+  const uint8_t* codeaux = end;
+  data = code + count / 3;
+
+#define PUSH_EDGE(x, y) edges[edgeOffset][0] = x, edges[edgeOffset][1] = y, edgeOffset = (edgeOffset + 1) & 15
+#define PUSH_VERTEX(v, cond) vertices[vertexOffset] = v, vertexOffset = (vertexOffset + (cond)) & 15
+
+  for (size_t i = 0; i < count; i += 3) {
+    if (data > end) return false;
+    uint8_t codetri = *code++;
+    uint32_t a, b, c;
+
+    if (codetri < 0xf0) {
+      // Triangle reuses an edge from the fifo, with the third vertex from the fifo or encoded
+      uint32_t fe = codetri >> 4;
+      uint32_t fec = codetri & 15;
+      a = edges[(edgeOffset - 1 - fe) & 15][0];
+      b = edges[(edgeOffset - 1 - fe) & 15][1];
+
+      if (fec < fecmax) {
+        c = fec == 0 ? next++ : vertices[(vertexOffset - 1 - fec) & 15];
+        PUSH_VERTEX(c, fec == 0);
+      } else {
+        last = c = fec != 15 ? last + (fec == 13 ? -1 : 1) : meshoptDecodeIndex(&data, last);
+        PUSH_VERTEX(c, 1);
+      }
+
+      PUSH_EDGE(c, b);
+      PUSH_EDGE(a, c);
+    } else {
+      // Triangle doesn't share an edge, vertex references come from a lookup table or a full byte
+      uint32_t fea, feb, fec;
+      if (codetri < 0xfe) {
+        uint8_t aux = codeaux[codetri & 15];
+        fea = 0;
+        feb = aux >> 4;
+        fec = aux & 15;
+      } else {
+        uint8_t aux = *data++;
+        if (aux == 0) next = 0;
+        fea = codetri == 0xfe ? 0 : 15;
+        feb = aux >> 4;
+        fec = aux & 15;
+      }
+
+      a = fea == 0 ? next++ : 0;
+      b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+      c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+      if (fea == 15) last = a = meshoptDecodeIndex(&data, last);
+      if (feb == 15) last = b = meshoptDecodeIndex(&data, last);
+      if (fec == 15) last = c = meshoptDecodeIndex(&data, last);
+
+      PUSH_VERTEX(a, 1);
+      PUSH_VERTEX(b, feb == 0 || feb == 15);
+      PUSH_VERTEX(c, fec == 0 || fec == 15);
+      PUSH_EDGE(b, a);
+      PUSH_EDGE(c, b);
+      PUSH_EDGE(a, c);
+    }
+
+    meshoptWriteIndex(dst, stride, i + 0, a);
+    meshoptWriteIndex(dst, stride, i + 1, b);
+    meshoptWriteIndex(dst, stride, i + 2, c);
+  }
+
+#undef PUSH_EDGE
+#undef PUSH_VERTEX
+
+  return data == end;
+}
+
+static bool meshoptDecodeIndices(void* dst, size_t count, size_t stride, const uint8_t* data, size_t length) {
+  if ((stride != 2 && stride != 4) || length < 1 + count + 4) return false;
+  if ((data[0] & 0xf0) != 0xd0 || (data[0] & 0x0f) > 1) return false;
+  const uint8_t* end = data + length - 4;
+  data++;
+
+  uint32_t last[2] = { 0, 0 };
+  for (size_t i = 0; i < count; i++) {
+    if (data >= end) return false;
+    uint32_t v = meshoptDecodeVByte(&data);
+    uint32_t baseline = v & 1;
+    v >>= 1;
+    last[baseline] += (v >> 1) ^ -(v & 1);
+    meshoptWriteIndex(dst, stride, i, last[baseline]);
+  }
+
+  return data == end;
+}
+
+static int32_t meshoptRound(float x) {
+  return (int32_t) (x + (x >= 0.f ? .5f : -.5f));
+}
+
+static void meshoptApplyFilter(void* data, size_t count, size_t stride, MeshoptFilter filter) {
+  switch (filter) {
+    case MESHOPT_FILTER_NONE: break;
+    case MESHOPT_FILTER_OCTAHEDRAL: {
+      lovrAssert(stride == 4 || stride == 8, "Octahedral meshopt filter requires a byteStride of 4 or 8");
+      for (size_t i = 0; i < count; i++) {
+        int8_t* s8 = (int8_t*) data + i * 4;
+        int16_t* s16 = (int16_t*) data + i * 4;
+        float x = stride == 4 ? s8[0] : s16[0];
+        float y = stride == 4 ? s8[1] : s16[1];
+        float z = (stride == 4 ? s8[2] : s16[2]) - fabsf(x) - fabsf(y);
+        float t = MIN(z, 0.f);
+        x += x >= 0.f ? t : -t;
+        y += y >= 0.f ? t : -t;
+        float scale = (stride == 4 ? 127.f : 32767.f) / sqrtf(x * x + y * y + z * z);
+        if (stride == 4) {
+          s8[0] = meshoptRound(x * scale);
+          s8[1] = meshoptRound(y * scale);
+          s8[2] = meshoptRound(z * scale);
+        } else {
+          s16[0] = meshoptRound(x * scale);
+          s16[1] = meshoptRound(y * scale);
+          s16[2] = meshoptRound(z * scale);
+        }
+      }
+      break;
+    }
+    case MESHOPT_FILTER_QUATERNION: {
+      lovrAssert(stride == 8, "Quaternion meshopt filter requires a byteStride of 8");
+      for (size_t i = 0; i < count; i++) {
+        int16_t* q = (int16_t*) data + i * 4;
+        float scale = (1.f / sqrtf(2.f)) / (q[3] | 3);
+        float x = q[0] * scale;
+        float y = q[1] * scale;
+        float z = q[2] * scale;
+        float w = sqrtf(MAX(1.f - x * x - y * y - z * z, 0.f));
+        uint32_t component = q[3] & 3;
+        q[(component + 1) & 3] = meshoptRound(x * 32767.f);
+        q[(component + 2) & 3] = meshoptRound(y * 32767.f);
+        q[(component + 3) & 3] = meshoptRound(z * 32767.f);
+        q[(component + 0) & 3] = meshoptRound(w * 32767.f);
+      }
+      break;
+    }
+    case MESHOPT_FILTER_EXPONENTIAL: {
+      lovrAssert(stride % 4 == 0, "Exponential meshopt filter requires a byteStride that is a multiple of 4");
+      uint32_t* words = data;
+      for (size_t i = 0; i < count * stride / 4; i++) {
+        int32_t mantissa = (int32_t) (words[i] << 8) >> 8;
+        int32_t exponent = (int32_t) words[i] >> 24;
+        union { float f; uint32_t u; } value = { .u = (uint32_t) (exponent + 127) << 23 };
+        value.f *= mantissa;
+        words[i] = value.u;
+      }
+      break;
+    }
+  }
+}
+
+static Blob* meshoptDecode(gltfMeshopt* meshopt, Blob* blob, ptrdiff_t offset) {
+  lovrAssert(blob && offset + meshopt->offset + meshopt->length <= blob->size, "Compressed bufferView is out of range");
+  const uint8_t* src = (uint8_t*) blob->data + offset + meshopt->offset;
+  size_t size = meshopt->count * meshopt->stride;
+  void* data = malloc(MAX(size, 1));
+  lovrAssert(data, "Out of memory");
+
+  bool success = false;
+  switch (meshopt->mode) {
+    case MESHOPT_ATTRIBUTES: success = meshoptDecodeVertices(data, meshopt->count, meshopt->stride, src, meshopt->length); break;
+    case MESHOPT_TRIANGLES: success = meshoptDecodeTriangles(data, meshopt->count, meshopt->stride, src, meshopt->length); break;
+    case MESHOPT_INDICES: success = meshoptDecodeIndices(data, meshopt->count, meshopt->stride, src, meshopt->length); break;
+  }
+
+  if (!success) {
+    free(data);
+    lovrThrow("Could not decode meshopt compressed bufferView");
+  }
+
+  meshoptApplyFilter(data, meshopt->count, meshopt->stride, meshopt->filter);
+  return lovrBlobCreate(data, size, NULL);
+}
+
+typedef struct {
+  Blob* blob;
+  bool borrowed;
+  Image* image;
+  jmp_buf catch;
+  char error[256];
+} gltfImageJob;
+
+static void onImageError(void* userdata, const char* format, va_list args) {
+  gltfImageJob* job = userdata;
+  vsnprintf(job->error, sizeof(job->error), format, args);
+  longjmp(job->catch, 1);
+}
+
+// Decoding is the slow part of loading most glTF files, so images decode on the thread pool when
+// it's running.  Errors are caught here and thrown once every image is done.
+static void decodeImage(void* arg) {
+  gltfImageJob* job = arg;
+  if (!job->blob) {
+    return;
+  }
+
+  errorFn* callback = lovrErrorCallback;
+  void* userdata = lovrErrorUserdata;
+  lovrSetErrorCallback(onImageError, job);
+  if (!setjmp(job->catch)) {
+    job->image = lovrImageCreateFromBlob(job->blob, false);
+  }
+  lovrSetErrorCallback(callback, userdata);
+}
+
 static jsmntok_t* resolveTexture(const char* json, jsmntok_t* token, ModelMaterial* material, MaterialTexture textureType, gltfTexture* textures, gltfSampler* samplers) {
   for (int k = (token++)->size; k > 0; k--) {
     gltfString key = NOM_STR(json, token);
@@ -223,6 +569,7 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     jsmntok_t* scenes;
     jsmntok_t* skins;
     int sceneCount;
+    int meshoptCount;
   } info;
 
   memset(&info, 0, sizeof(info));
@@ -299,8 +646,29 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     } else if (STR_EQ(key, "bufferViews")) {
       info.bufferViews = token;
       model->bufferCount = token->size;
+      jsmntok_t* t = token;
+      for (int i = (t++)->size; i > 0; i--) {
+        for (int k = (t++)->size; k > 0; k--) {
+          gltfString key = NOM_STR(json, t);
+          if (STR_EQ(key, "extensions")) {
+            for (int kk = (t++)->size; kk > 0; kk--) {
+              gltfString extension = NOM_STR(json, t);
+              if (STR_EQ(extension, "EXT_meshopt_compression")) { info.meshoptCount++; }
+              t += NOM_VALUE(json, t);
+            }
+          } else {
+            t += NOM_VALUE(json, t);
+          }
+        }
+      }
       token += NOM_VALUE(json, token);
 
+    } else if (key.length == strlen("extensionsRequired") && STR_EQ(key, "extensionsRequired")) {
+      for (int i = (token++)->size; i > 0; i--) {
+        gltfString extension = NOM_STR(json, token);
+        lovrAssert(!STR_EQ(extension, "KHR_draco_mesh_compression"), "Draco compressed glTF files are not supported, EXT_meshopt_compression can be used instead");
+      }
+
     } else if (STR_EQ(key, "images")) {
       info.images = token;
       model->imageCount = token->size;
@@ -458,24 +826,49 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     model->nodeCount++;
   }
 
+  // Decoded meshopt bufferViews get their own blobs, after the ones for the glTF buffers
+  model->blobCount += info.meshoptCount;
+
   // Allocate memory, then revisit all of the tokens that were recorded during the prepass and write
   // their data into this memory.
   lovrModelDataAllocate(model);
 
   // Blobs
-  if (model->blobCount > 0) {
+  if (info.buffers) {
     jsmntok_t* token = info.buffers;
     Blob** blob = model->blobs;
     for (int i = (token++)->size; i > 0; i--, blob++) {
       gltfString uri;
       memset(&uri, 0, sizeof(uri));
       size_t size = 0;
+      bool fallback = false;
 
       for (int k = (token++)->size; k > 0; k--) {
         gltfString key = NOM_STR(json, token);
         if (STR_EQ(key, "byteLength")) { size = NOM_INT(json, token); }
         else if (STR_EQ(key, "uri")) { uri = NOM_STR(json, token); }
-        else { token += NOM_VALUE(json, token); }
+        else if (STR_EQ(key, "extensions")) {
+          for (int kk = (token++)->size; kk > 0; kk--) {
+            gltfString extension = NOM_STR(json, token);
+            if (STR_EQ(extension, "EXT_meshopt_compression")) {
+              for (int kkk = (token++)->size; kkk > 0; kkk--) {
+                gltfString key = NOM_STR(json, token);
+                if (STR_EQ(key, "fallback")) { fallback = NOM_BOOL(json, token); }
+                else { token += NOM_VALUE(json, token); }
+              }
+            } else {
+              token += NOM_VALUE(json, token);
+            }
+          }
+        } else {
+          token += NOM_VALUE(json, token);
+        }
+      }
+
+      // Fallback buffers only exist for loaders without meshopt support and usually have no data
+      if (fallback && !uri.data) {
+        *blob = NULL;
+        continue;
       }
 
       if (uri.data) {
@@ -503,15 +896,65 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
   if (model->bufferCount > 0) {
     jsmntok_t* token = info.bufferViews;
     ModelBuffer* buffer = model->buffers;
+    Blob** decoded = model->blobs + model->blobCount - info.meshoptCount;
     for (int i = (token++)->size; i > 0; i--, buffer++) {
       size_t offset = 0;
+      gltfMeshopt meshopt = { .buffer = ~0u };
       for (int k = (token++)->size; k > 0; k--) {
         gltfString key = NOM_STR(json, token);
-        if (STR_EQ(key, "buffer")) { buffer->data = model->blobs[NOM_INT(json, token)]->data; }
+        if (STR_EQ(key, "buffer")) {
+          Blob* blob = model->blobs[NOM_INT(json, token)];
+          buffer->data = blob ? blob->data : NULL;
+        }
         else if (STR_EQ(key, "byteOffset")) { offset = NOM_INT(json, token); }
         else if (STR_EQ(key, "byteLength")) { buffer->size = NOM_INT(json, token); }
         else if (STR_EQ(key, "byteStride")) { buffer->stride = NOM_INT(json, token); }
-        else { token += NOM_VALUE(json, token); }
+        else if (STR_EQ(key, "extensions")) {
+          for (int kk = (token++)->size; kk > 0; kk--) {
+            gltfString extension = NOM_STR(json, token);
+            if (STR_EQ(extension, "EXT_meshopt_compression")) {
+              for (int kkk = (token++)->size; kkk > 0; kkk--) {
+                gltfString key = NOM_STR(json, token);
+                if (STR_EQ(key, "buffer")) { meshopt.buffer = NOM_INT(json, token); }
+                else if (STR_EQ(key, "byteOffset")) { meshopt.offset = NOM_INT(json, token); }
+                else if (STR_EQ(key, "byteLength")) { meshopt.length = NOM_INT(json, token); }
+                else if (STR_EQ(key, "byteStride")) { meshopt.stride = NOM_INT(json, token); }
+                else if (STR_EQ(key, "count")) { meshopt.count = NOM_INT(json, token); }
+                else if (STR_EQ(key, "mode")) {
+                  gltfString mode = NOM_STR(json, token);
+                  if (STR_EQ(mode, "ATTRIBUTES")) { meshopt.mode = MESHOPT_ATTRIBUTES; }
+                  else if (STR_EQ(mode, "TRIANGLES")) { meshopt.mode = MESHOPT_TRIANGLES; }
+                  else if (STR_EQ(mode, "INDICES")) { meshopt.mode = MESHOPT_INDICES; }
+                  else { lovrThrow("Unknown meshopt compression mode"); }
+                } else if (STR_EQ(key, "filter")) {
+                  gltfString filter = NOM_STR(json, token);
+                  if (STR_EQ(filter, "NONE")) { meshopt.filter = MESHOPT_FILTER_NONE; }
+                  else if (STR_EQ(filter, "OCTAHEDRAL")) { meshopt.filter = MESHOPT_FILTER_OCTAHEDRAL; }
+                  else if (STR_EQ(filter, "QUATERNION")) { meshopt.filter = MESHOPT_FILTER_QUATERNION; }
+                  else if (STR_EQ(filter, "EXPONENTIAL")) { meshopt.filter = MESHOPT_FILTER_EXPONENTIAL; }
+                  else { lovrThrow("Unknown meshopt compression filter"); }
+                } else {
+                  token += NOM_VALUE(json, token);
+                }
+              }
+            } else {
+              token += NOM_VALUE(json, token);
+            }
+          }
+        } else {
+          token += NOM_VALUE(json, token);
+        }
+      }
+
+      // Compressed bufferViews are decoded into a new blob, which replaces the fallback data
+      if (meshopt.buffer != ~0u) {
+        lovrAssert(meshopt.buffer < model->blobCount - info.meshoptCount, "Invalid meshopt buffer index");
+        Blob* blob = model->blobs[meshopt.buffer];
+        *decoded = meshoptDecode(&meshopt, blob, blob == source && glb ? binOffset : 0);
+        buffer->data = (*decoded)->data;
+        buffer->size = (*decoded)->size;
+        decoded++;
+        continue;
       }
 
       // If this is the glb binary data, increment the offset to account for the file header
@@ -649,19 +1092,21 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
     }
   }
 
-  // Images
+  // Images (read in order, then decoded in parallel)
   if (model->imageCount > 0) {
     jsmntok_t* token = info.images;
-    Image** image = model->images;
-    for (int i = (token++)->size; i > 0; i--, image++) {
+    gltfImageJob* jobs = calloc(model->imageCount, sizeof(gltfImageJob));
+    void** args = malloc(model->imageCount * sizeof(void*));
+    lovrAssert(jobs && args, "Out of memory");
+    for (int i = (token++)->size, j = 0; i > 0; i--, j++) {
+      gltfImageJob* job = &jobs[j];
+      args[j] = job;
       for (int k = (token++)->size; k > 0; k--) {
         gltfString key = NOM_STR(json, token);
         if (STR_EQ(key, "bufferView")) {
           ModelBuffer* buffer = &model->buffers[NOM_INT(json, token)];
-          Blob* blob = lovrBlobCreate(buffer->data, buffer->size, NULL);
-          *image = lovrImageCreateFromBlob(blob, false);
-          blob->data = NULL; // XXX Blob data ownership
-          lovrRelease(blob, lovrBlobDestroy);
+          job->blob = lovrBlobCreate(buffer->data, buffer->size, NULL);
+          job->borrowed = true;
         } else if (STR_EQ(key, "uri")) {
           size_t size = 0;
           gltfString uri = NOM_STR(json, token);
@@ -670,15 +1115,40 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
           strncat(filename, uri.data, uri.length);
           void* data = io(filename, &size);
           lovrAssert(data && size > 0, "Unable to read image from '%s'", filename);
-          Blob* blob = lovrBlobCreate(data, size, NULL);
-          *image = lovrImageCreateFromBlob(blob, false);
-          lovrRelease(blob, lovrBlobDestroy);
+          job->blob = lovrBlobCreate(data, size, NULL);
           *root = '\0';
         } else {
           token += NOM_VALUE(json, token);
         }
       }
     }
+
+#ifndef LOVR_DISABLE_THREAD
+    lovrThreadPoolRun(decodeImage, args, model->imageCount);
+#else
+    for (uint32_t i = 0; i < model->imageCount; i++) {
+      decodeImage(args[i]);
+    }
+#endif
+
+    const char* error = NULL;
+    for (uint32_t i = 0; i < model->imageCount; i++) {
+      if (jobs[i].blob && jobs[i].borrowed) jobs[i].blob->data = NULL; // XXX Blob data ownership
+      lovrRelease(jobs[i].blob, lovrBlobDestroy);
+      model->images[i] = jobs[i].image;
+      if (!error && jobs[i].error[0]) error = jobs[i].error;
+    }
+
+    if (error) {
+      char message[sizeof(jobs->error)];
+      memcpy(message, error, sizeof(message));
+      free(jobs);
+      free(args);
+      lovrThrow("%s", message);
+    }
+
+    free(jobs);
+    free(args);
   }
 
   // Materials
@@ -853,6 +1323,34 @@ ModelData* lovrModelDataInitGltf(ModelData* model, Blob* source, ModelDataIO* io
           scale[0] = NOM_FLOAT(json, token);
           scale[1] = NOM_FLOAT(json, token);
           scale[2] = NOM_FLOAT(json, token);
+        } else if (STR_EQ(key, "extensions")) {
+          for (int kk = (token++)->size; kk > 0; kk--) {
+            gltfString extension = NOM_STR(json, token);
+            if (STR_EQ(extension, "EXT_mesh_gpu_instancing")) {
+              for (int kkk = (token++)->size; kkk > 0; kkk--) {
+                gltfString key = NOM_STR(json, token);
+                if (STR_EQ(key, "attributes")) {
+                  for (int a = (token++)->size; a > 0; a--) {
+                    gltfString name = NOM_STR(json, token);
+                    ModelAttribute* attribute = &model->attributes[NOM_INT(json, token)];
+                    int property = -1;
+                    if (STR_EQ(name, "TRANSLATION")) { property = PROP_TRANSLATION; }
+                    else if (STR_EQ(name, "ROTATION")) { property = PROP_ROTATION; }
+                    else if (STR_EQ(name, "SCALE")) { property = PROP_SCALE; }
+                    if (property >= 0) {
+                      lovrAssert(node->instanceCount == 0 || node->instanceCount == attribute->count, "Node instancing attributes must have the same count");
+                      node->instances[property] = attribute;
+                      node->instanceCount = attribute->count;
+                    }
+                  }
+                } else {
+                  token += NOM_VALUE(json, token);
+                }
+              }
+            } else {
+              token += NOM_VALUE(json, token);
+            }
+          }
         } else if (STR_EQ(key, "name")) {
           gltfString name = NOM_STR(json, token);
           map_set(&model->nodeMap, hash64(name.data, name.length), model->nodeCount - i);
@@ -4,6 +4,9 @@
 #include "core/maf.h"
 #include "core/map.h"
 #include "core/util.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
 #include <stdlib.h>
 #include <float.h>
 #include <ctype.h>
@@ -14,10 +17,34 @@ typedef struct {
   int count;
 } objGroup;
 
+// A mtllib or usemtl line, along with how many face vertices came before it in its chunk
+typedef struct {
+  const char* line;
+  size_t length;
+  size_t corner;
+} objCommand;
+
+// Large files are split into chunks at line boundaries which are parsed in parallel.  Each chunk
+// collects its own vertex data and face vertices (as position/uv/normal index triples), then they
+// are stitched together in order.
+typedef struct {
+  char* data;
+  size_t size;
+  arr_t(float) positions;
+  arr_t(float) normals;
+  arr_t(float) uvs;
+  arr_t(uint32_t) corners;
+  arr_t(objCommand) commands;
+  const char* error;
+} objChunk;
+
 typedef arr_t(ModelMaterial) arr_material_t;
 typedef arr_t(Image*) arr_image_t;
 typedef arr_t(objGroup) arr_group_t;
 
+// Chunks smaller than this aren't worth a separate job
+#define OBJ_MIN_CHUNK_SIZE (1 << 20)
+
 #define STARTS_WITH(a, b) !strncmp(a, b, strlen(b))
 
 static uint32_t nomu32(char* s, char** end) {
@@ -27,6 +54,61 @@ static uint32_t nomu32(char* s, char** end) {
   return n;
 }
 
+// Faster than strtof since it doesn't deal with locales, hex floats, or infinities.  Exact for
+// typical OBJ numbers, which have fewer than 16 significant digits.
+static float nomf32(char* s, char** end) {
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  while (*s == ' ' || *s == '\t') s++;
+  char* start = s;
+  bool negative = *s == '-';
+  if (*s == '-' || *s == '+') s++;
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int digits = 0;
+  bool any = false;
+
+  for (; isdigit(*s); s++, any = true) {
+    if (digits < 19) mantissa = 10 * mantissa + (*s - '0'), digits += mantissa > 0;
+    else exponent++;
+  }
+
+  if (*s == '.') {
+    for (s++; isdigit(*s); s++, any = true) {
+      if (digits < 19) mantissa = 10 * mantissa + (*s - '0'), digits += mantissa > 0, exponent--;
+    }
+  }
+
+  if (!any) {
+    *end = start;
+    return 0.f;
+  }
+
+  if (*s == 'e' || *s == 'E') {
+    char* t = s + 1;
+    bool negativeExponent = *t == '-';
+    if (*t == '-' || *t == '+') t++;
+    if (isdigit(*t)) {
+      int n = 0;
+      for (; isdigit(*t); t++) n = n < 1000 ? 10 * n + (*t - '0') : n;
+      exponent += negativeExponent ? -n : n;
+      s = t;
+    }
+  }
+
+  *end = s;
+
+  double value = (double) mantissa;
+  while (exponent > 22) value *= 1e22, exponent -= 22;
+  while (exponent < -22) value /= 1e22, exponent += 22;
+  value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+  return (float) (negative ? -value : value);
+}
+
 static void parseMtl(char* path, char* base, ModelDataIO* io, arr_image_t* images, arr_material_t* materials, map_t* names) {
   size_t size = 0;
   char* p = io(path, &size);
@@ -57,9 +139,9 @@ static void parseMtl(char* path, char* base, ModelDataIO* io, arr_image_t* image
     } else if (line[0] == 'K' && line[1] == 'd' && line[2] == ' ') {
       float r, g, b;
       char* s = line + 3;
-      r = strtof(s, &s);
-      g = strtof(s, &s);
-      b = strtof(s, &s);
+      r = nomf32(s, &s);
+      g = nomf32(s, &s);
+      b = nomf32(s, &s);
       ModelMaterial* material = &materials->data[materials->length - 1];
       material->colors[COLOR_DIFFUSE] = (Color) { r, g, b, 1.f };
     } else if (STARTS_WITH(line, "map_Kd ")) {
@@ -91,14 +173,94 @@ static void parseMtl(char* path, char* base, ModelDataIO* io, arr_image_t* image
   free(p);
 }
 
+static void parseChunk(void* arg) {
+  objChunk* chunk = arg;
+  char* data = chunk->data;
+  size_t size = chunk->size;
+
+  while (size > 0) {
+    while (size > 0 && (*data == ' ' || *data == '\t')) data++, size--;
+    char* newline = memchr(data, '\n', size);
+    if (size == 0 || *data == '#') goto next;
+
+    char line[1024];
+    size_t length = newline ? (size_t) (newline - data) : size;
+    while (length > 0 && (data[length - 1] == '\r' || data[length - 1] == '\t' || data[length - 1] == ' ')) length--;
+    if (length >= sizeof(line)) {
+      chunk->error = "Line length is too long (max is 1023)";
+      return;
+    }
+    memcpy(line, data, length);
+    line[length] = '\0';
+
+    if (line[0] == 'v' && line[1] == ' ') {
+      float v[3];
+      char* s = line + 2;
+      v[0] = nomf32(s, &s);
+      v[1] = nomf32(s, &s);
+      v[2] = nomf32(s, &s);
+      arr_append(&chunk->positions, v, 3);
+    } else if (line[0] == 'v' && line[1] == 'n' && line[2] == ' ') {
+      float vn[3];
+      char* s = line + 3;
+      vn[0] = nomf32(s, &s);
+      vn[1] = nomf32(s, &s);
+      vn[2] = nomf32(s, &s);
+      arr_append(&chunk->normals, vn, 3);
+    } else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ') {
+      float vt[2];
+      char* s = line + 3;
+      vt[0] = nomf32(s, &s);
+      vt[1] = nomf32(s, &s);
+      arr_append(&chunk->uvs, vt, 2);
+    } else if (line[0] == 'f' && line[1] == ' ') {
+      char* s = line + 2;
+      for (size_t i = 0; i < 3; i++) {
+
+        // Find first number/slash
+        while (*s && !(*s >= '/' && *s <= '9')) s++;
+
+        // Handle v//vn, v/vt, v/vt/vtn, and v
+        uint32_t corner[3] = { 0 };
+        corner[0] = nomu32(s, &s);
+        if (corner[0] == 0) {
+          chunk->error = "Expected positive number for face vertex position index";
+          return;
+        }
+
+        if (s[0] == '/') {
+          if (s[1] == '/') {
+            corner[2] = nomu32(s + 2, &s);
+          } else {
+            corner[1] = nomu32(s + 1, &s);
+            if (s[0] == '/') {
+              corner[2] = nomu32(s + 1, &s);
+            }
+          }
+        }
+
+        arr_append(&chunk->corners, corner, 3);
+
+        // Skip the rest of the number/slash run
+        while (*s && *s >= '/' && *s <= '9') s++;
+      }
+    } else if (STARTS_WITH(line, "mtllib ") || STARTS_WITH(line, "usemtl ")) {
+      objCommand command = { data, length, chunk->corners.length / 3 };
+      arr_push(&chunk->commands, command);
+    }
+
+    next:
+    if (!newline) break;
+    size -= newline - data + 1;
+    data = newline + 1;
+  }
+}
+
 ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io) {
   if (source->size < 7 || (memcmp(source->data, "v ", 2) && memcmp(source->data, "o ", 2) && memcmp(source->data, "mtllib ", 7) && memcmp(source->data, "#", 1))) {
     return NULL;
   }
 
-  char* data = (char*) source->data;
-  size_t size = source->size;
-
   arr_group_t groups;
   arr_image_t images;
   arr_material_t materials;
@@ -106,9 +268,6 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
   arr_t(int) indexBlob;
   map_t materialMap;
   map_t vertexMap;
-  arr_t(float) positions;
-  arr_t(float) normals;
-  arr_t(float) uvs;
 
   arr_init(&groups, realloc);
   arr_init(&images, realloc);
@@ -117,9 +276,6 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
   arr_init(&vertexBlob, realloc);
   arr_init(&indexBlob, realloc);
   map_init(&vertexMap, 0);
-  arr_init(&positions, realloc);
-  arr_init(&normals, realloc);
-  arr_init(&uvs, realloc);
 
   arr_push(&groups, ((objGroup) { .material = -1 }));
 
@@ -133,75 +289,112 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
   size_t baseLength = base - path;
   *base = '\0';
 
-  while (size > 0) {
-    while (size > 0 && (*data == ' ' || *data == '\t')) data++, size--;
-    char* newline = memchr(data, '\n', size);
-    if (*data == '#') goto next;
+  // Split the file into chunks, one per worker, ending each chunk on a line boundary
+  uint32_t chunkCount = 1;
+#ifndef LOVR_DISABLE_THREAD
+  uint32_t workerCount = lovrThreadPoolGetWorkerCount();
+  if (workerCount > 0) {
+    chunkCount = (uint32_t) CLAMP(source->size / OBJ_MIN_CHUNK_SIZE, 1, workerCount + 1);
+  }
+#endif
 
-    char line[1024];
-    size_t length = newline ? (size_t) (newline - data) : size;
-    while (length > 0 && (data[length - 1] == '\r' || data[length - 1] == '\t' || data[length - 1] == ' ')) length--;
-    lovrAssert(length < sizeof(line), "OBJ line length is too long (max is %d)", sizeof(line) - 1);
-    memcpy(line, data, length);
-    line[length] = '\0';
+  objChunk* chunks = calloc(chunkCount, sizeof(objChunk));
+  void** args = malloc(chunkCount * sizeof(void*));
+  lovrAssert(chunks && args, "Out of memory");
 
-    if (line[0] == 'v' && line[1] == ' ') {
-      float v[3];
-      char* s = line + 2;
-      v[0] = strtof(s, &s);
-      v[1] = strtof(s, &s);
-      v[2] = strtof(s, &s);
-      arr_append(&positions, v, 3);
-    } else if (line[0] == 'v' && line[1] == 'n' && line[2] == ' ') {
-      float vn[3];
-      char* s = line + 3;
-      vn[0] = strtof(s, &s);
-      vn[1] = strtof(s, &s);
-      vn[2] = strtof(s, &s);
-      arr_append(&normals, vn, 3);
-    } else if (line[0] == 'v' && line[1] == 't' && line[2] == ' ') {
-      float vt[2];
-      char* s = line + 3;
-      vt[0] = strtof(s, &s);
-      vt[1] = strtof(s, &s);
-      arr_append(&uvs, vt, 2);
-    } else if (line[0] == 'f' && line[1] == ' ') {
-      char* s = line + 2;
-      for (size_t i = 0; i < 3; i++) {
+  char* data = (char*) source->data;
+  char* end = data + source->size;
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    char* split = i == chunkCount - 1 ? end : data + (end - data) / (chunkCount - i);
+    char* newline = split < end ? memchr(split, '\n', end - split) : NULL;
+    split = newline ? newline + 1 : end;
+    chunks[i].data = data;
+    chunks[i].size = split - data;
+    arr_init(&chunks[i].positions, realloc);
+    arr_init(&chunks[i].normals, realloc);
+    arr_init(&chunks[i].uvs, realloc);
+    arr_init(&chunks[i].corners, realloc);
+    arr_init(&chunks[i].commands, realloc);
+    args[i] = &chunks[i];
+    data = split;
+  }
 
-        // Find first number/slash
-        while (*s && !(*s >= '/' && *s <= '9')) s++;
+#ifndef LOVR_DISABLE_THREAD
+  lovrThreadPoolRun(parseChunk, args, chunkCount);
+#else
+  parseChunk(args[0]);
+#endif
 
-        // Find next non-number/non-slash
-        char* t = s;
-        while (*t && *t >= '/' && *t <= '9') t++;
-
-        // If the vertex already exists, add its index and skip
-        uint64_t hash = hash64(s, t - s);
-        uint64_t index = map_get(&vertexMap, hash);
-        if (index != MAP_NIL) {
-          arr_push(&indexBlob, index);
-          s = t;
-          continue;
-        }
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    lovrAssert(!chunks[i].error, "Bad OBJ: %s", chunks[i].error);
+  }
 
-        uint32_t v = 0;
-        uint32_t vt = 0;
-        uint32_t vn = 0;
-        v = nomu32(s, &s);
-        lovrAssert(v > 0, "Bad OBJ: Expected positive number for face vertex position index");
+  // Stitch the vertex data together in file order
+  arr_t(float) positions;
+  arr_t(float) normals;
+  arr_t(float) uvs;
+  arr_init(&positions, realloc);
+  arr_init(&normals, realloc);
+  arr_init(&uvs, realloc);
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    arr_append(&positions, chunks[i].positions.data, chunks[i].positions.length);
+    arr_append(&normals, chunks[i].normals.data, chunks[i].normals.length);
+    arr_append(&uvs, chunks[i].uvs.data, chunks[i].uvs.length);
+  }
 
-        // Handle v//vn, v/vt, v/vt/vtn, and v
-        if (s[0] == '/') {
-          if (s[1] == '/') {
-            vn = nomu32(s + 2, &s);
-          } else {
-            vt = nomu32(s + 1, &s);
-            if (s[0] == '/') {
-              vn = nomu32(s + 1, &s);
-            }
+  size_t positionCount = positions.length / 3;
+  size_t normalCount = normals.length / 3;
+  size_t uvCount = uvs.length / 2;
+  map_reserve(&vertexMap, (uint32_t) MAX(positionCount, MAX(normalCount, uvCount)));
+
+  // Walk the faces and material commands in order, deduplicating vertices
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    objChunk* chunk = &chunks[i];
+    size_t cornerCount = chunk->corners.length / 3;
+    size_t command = 0;
+
+    for (size_t c = 0; c <= cornerCount; c++) {
+      for (; command < chunk->commands.length && chunk->commands.data[command].corner == c; command++) {
+        objCommand* cmd = &chunk->commands.data[command];
+        char line[1024];
+        memcpy(line, cmd->line, cmd->length);
+        line[cmd->length] = '\0';
+
+        if (STARTS_WITH(line, "mtllib ")) {
+          const char* filename = line + 7;
+          size_t filenameLength = strlen(filename);
+          lovrAssert(baseLength + filenameLength < sizeof(path), "Bad OBJ: Material filename is too long");
+          memcpy(path + baseLength, filename, filenameLength);
+          path[baseLength + filenameLength] = '\0';
+          parseMtl(path, base, io, &images, &materials, &materialMap);
+        } else {
+          uint64_t index = map_get(&materialMap, hash64(line + 7, cmd->length - 7));
+          uint32_t material = index == MAP_NIL ? ~0u : index;
+          objGroup* group = &groups.data[groups.length - 1];
+          if (group->count > 0) {
+            objGroup next = { .material = material, .start = group->start + group->count };
+            arr_push(&groups, next);
+          } else { // If the group doesn't have any faces yet, it's safe to modify its material
+            group->material = material;
           }
         }
+      }
+
+      if (c == cornerCount) {
+        break;
+      }
+
+      // If the vertex already exists, add its index and skip
+      uint32_t* corner = chunk->corners.data + 3 * c;
+      uint64_t hash = hash64(corner, 3 * sizeof(uint32_t));
+      uint64_t index = map_get(&vertexMap, hash);
+      if (index != MAP_NIL) {
+        arr_push(&indexBlob, index);
+      } else {
+        uint32_t v = corner[0];
+        uint32_t vt = corner[1];
+        uint32_t vn = corner[2];
+        lovrAssert(v <= positionCount && vt <= uvCount && vn <= normalCount, "Bad OBJ: Face vertex index is out of range");
 
         float empty[3] = { 0.f };
         arr_push(&indexBlob, (int) vertexBlob.length / 8);
@@ -209,34 +402,23 @@ ModelData* lovrModelDataInitObj(ModelData* model, Blob* source, ModelDataIO* io)
         arr_append(&vertexBlob, positions.data + 3 * (v - 1), 3);
         arr_append(&vertexBlob, vn > 0 ? (normals.data + 3 * (vn - 1)) : empty, 3);
         arr_append(&vertexBlob, vt > 0 ? (uvs.data + 2 * (vt - 1)) : empty, 2);
-
-        s = t;
       }
-      groups.data[groups.length - 1].count += 3;
-    } else if (STARTS_WITH(line, "mtllib ")) {
-      const char* filename = line + 7;
-      size_t filenameLength = strlen(filename);
-      lovrAssert(baseLength + filenameLength < sizeof(path), "Bad OBJ: Material filename is too long");
-      memcpy(path + baseLength, filename, filenameLength);
-      path[baseLength + filenameLength] = '\0';
-      parseMtl(path, base, io, &images, &materials, &materialMap);
-    } else if (STARTS_WITH(line, "usemtl ")) {
-      uint64_t index = map_get(&materialMap, hash64(line + 7, length - 7));
-      uint32_t material = index == MAP_NIL ? ~0u : index;
-      objGroup* group = &groups.data[groups.length - 1];
-      if (group->count > 0) {
-        objGroup next = { .material = material, .start = group->start + group->count };
-        arr_push(&groups, next);
-      } else { // If the group doesn't have any faces yet, it's safe to modify its material
-        group->material = material;
+
+      if (c % 3 == 2) {
+        groups.data[groups.length - 1].count += 3;
       }
     }
+  }
 
-    next:
-    if (!newline) break;
-    size -= newline - data + 1;
-    data = newline + 1;
+  for (uint32_t i = 0; i < chunkCount; i++) {
+    arr_free(&chunks[i].positions);
+    arr_free(&chunks[i].normals);
+    arr_free(&chunks[i].uvs);
+    arr_free(&chunks[i].corners);
+    arr_free(&chunks[i].commands);
   }
+  free(chunks);
+  free(args);
 
   if (vertexBlob.length == 0 || indexBlob.length == 0) {
     model = NULL;
@@ -13,6 +13,7 @@ struct Rasterizer {
   uint32_t ref;
   stbtt_fontinfo font;
   struct Blob* blob;
+  uint64_t hash;
   float size;
   float scale;
   int glyphCount;
@@ -35,6 +36,7 @@ Rasterizer* lovrRasterizerCreate(Blob* blob, float size) {
 
   lovrRetain(blob);
   rasterizer->blob = blob;
+  rasterizer->hash = blob ? hash64(blob->data, blob->size) : hash64(data, src_resources_VarelaRound_ttf_len);
   rasterizer->size = size;
   rasterizer->scale = stbtt_ScaleForMappingEmToPixels(font, size);
   rasterizer->glyphCount = font->numGlyphs;
@@ -62,6 +64,10 @@ float lovrRasterizerGetSize(Rasterizer* rasterizer) {
   return rasterizer->size;
 }
 
+uint64_t lovrRasterizerGetHash(Rasterizer* rasterizer) {
+  return rasterizer->hash;
+}
+
 int lovrRasterizerGetGlyphCount(Rasterizer* rasterizer) {
   return rasterizer->glyphCount;
 }
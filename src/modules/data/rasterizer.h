@@ -24,6 +24,7 @@ typedef struct Rasterizer Rasterizer;
 Rasterizer* lovrRasterizerCreate(struct Blob* blob, float size);
 void lovrRasterizerDestroy(void* ref);
 float lovrRasterizerGetSize(Rasterizer* rasterizer);
+uint64_t lovrRasterizerGetHash(Rasterizer* rasterizer);
 int lovrRasterizerGetGlyphCount(Rasterizer* rasterizer);
 int lovrRasterizerGetHeight(Rasterizer* rasterizer);
 int lovrRasterizerGetAdvance(Rasterizer* rasterizer);
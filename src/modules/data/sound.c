@@ -1,14 +1,31 @@
 #include "data/sound.h"
 #include "data/blob.h"
+#include "audio/mix.h"
 #include "core/util.h"
 #include "lib/stb/stb_vorbis.h"
 #include "lib/miniaudio/miniaudio.h"
 #define MINIMP3_FLOAT_OUTPUT
 #define MINIMP3_NO_STDIO
 #include "lib/minimp3/minimp3_ex.h"
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Compressed Sounds that decode to less than CACHE_THRESHOLD bytes are decoded when they're loaded,
+// and the samples are shared through a cache keyed by the compressed bytes.  Short sound effects
+// that are loaded over and over are decoded once and read with memcpy.
+#define CACHE_LIMIT (32 << 20)
+#define CACHE_THRESHOLD (1 << 20)
+#define MAX_CACHE_ENTRIES 256
+
+// Long compressed Sounds loaded from a file mapping are streamed: the decoder faults compressed pages
+// in as it reads them, and pages more than EVICT_WINDOW bytes behind it are handed back to the OS, so
+// resident memory stays bounded no matter how long the track is.
+#define EVICT_WINDOW (256 << 10)
+
+// Conversions between formats and layouts go through float scratch buffers this many frames at a time
+#define CONVERT_CHUNK 256
+
 static const ma_format miniaudioFormats[] = {
   [SAMPLE_I16] = ma_format_s16,
   [SAMPLE_F32] = ma_format_f32
@@ -27,8 +44,78 @@ struct Sound {
   uint32_t sampleRate;
   uint32_t frames;
   uint32_t cursor;
+  size_t evicted;
+  Blob* window;
+  uint32_t acquired;
 };
 
+typedef struct {
+  uint64_t hash;
+  uint64_t tick;
+  Blob* samples;
+} CacheEntry;
+
+static struct {
+  atomic_flag lock;
+  CacheEntry entries[MAX_CACHE_ENTRIES];
+  uint32_t count;
+  uint64_t tick;
+  size_t size;
+} cache;
+
+static uint64_t cacheKey(Blob* blob) {
+  return hash64(blob->data, blob->size) ^ blob->size;
+}
+
+// Returns a new reference to cached samples, or NULL
+static Blob* cacheGet(uint64_t key) {
+  Blob* samples = NULL;
+  while (atomic_flag_test_and_set_explicit(&cache.lock, memory_order_acquire));
+  for (uint32_t i = 0; i < cache.count; i++) {
+    if (cache.entries[i].hash == key) {
+      cache.entries[i].tick = ++cache.tick;
+      samples = cache.entries[i].samples;
+      lovrRetain(samples);
+      break;
+    }
+  }
+  atomic_flag_clear_explicit(&cache.lock, memory_order_release);
+  return samples;
+}
+
+static void cachePut(uint64_t key, Blob* samples) {
+  while (atomic_flag_test_and_set_explicit(&cache.lock, memory_order_acquire));
+
+  // Evict the least recently used entries until there's room
+  while (cache.count > 0 && (cache.count == MAX_CACHE_ENTRIES || cache.size + samples->size > CACHE_LIMIT)) {
+    uint32_t oldest = 0;
+    for (uint32_t i = 1; i < cache.count; i++) {
+      if (cache.entries[i].tick < cache.entries[oldest].tick) {
+        oldest = i;
+      }
+    }
+    cache.size -= cache.entries[oldest].samples->size;
+    lovrRelease(cache.entries[oldest].samples, lovrBlobDestroy);
+    cache.entries[oldest] = cache.entries[--cache.count];
+  }
+
+  lovrRetain(samples);
+  cache.entries[cache.count++] = (CacheEntry) { key, ++cache.tick, samples };
+  cache.size += samples->size;
+  atomic_flag_clear_explicit(&cache.lock, memory_order_release);
+}
+
+// Decoders call this with their byte offset into the compressed data after reading
+static void evict(Sound* sound, size_t position) {
+  if (position < sound->evicted) {
+    sound->evicted = position;
+  } else if (position - sound->evicted >= 2 * EVICT_WINDOW) {
+    size_t end = position - EVICT_WINDOW;
+    lovrBlobEvict(sound->blob, sound->evicted, end - sound->evicted);
+    sound->evicted = end;
+  }
+}
+
 // Readers
 
 static uint32_t lovrSoundReadRaw(Sound* sound, uint32_t offset, uint32_t count, void* data) {
@@ -57,6 +144,7 @@ static uint32_t lovrSoundReadOgg(Sound* sound, uint32_t offset, uint32_t count,
   uint32_t channelCount = lovrSoundGetChannelCount(sound);
   uint32_t sampleCount = count * channelCount;
   uint32_t n = stb_vorbis_get_samples_float_interleaved(sound->decoder, channelCount, data, sampleCount);
+  evict(sound, stb_vorbis_get_file_offset(sound->decoder));
   sound->cursor += n;
   return n;
 }
@@ -70,6 +158,7 @@ static uint32_t lovrSoundReadMp3(Sound* sound, uint32_t offset, uint32_t count,
   uint32_t channels = lovrSoundGetChannelCount(sound);
   size_t samples = mp3dec_ex_read(sound->decoder, data, count * channels);
   uint32_t frames = samples / channels;
+  evict(sound, (size_t) ((mp3dec_ex_t*) sound->decoder)->offset);
   sound->cursor += frames;
   return frames;
 }
@@ -97,6 +186,22 @@ Sound* lovrSoundCreateRaw(uint32_t frames, SampleFormat format, ChannelLayout la
   return sound;
 }
 
+// Like lovrSoundCreateRaw, but the samples are read straight out of the Blob instead of a copy
+Sound* lovrSoundCreateView(uint32_t frames, SampleFormat format, ChannelLayout layout, uint32_t sampleRate, Blob* blob) {
+  Sound* sound = calloc(1, sizeof(Sound));
+  lovrAssert(sound, "Out of memory");
+  sound->ref = 1;
+  sound->frames = frames;
+  sound->format = format;
+  sound->layout = layout;
+  sound->sampleRate = sampleRate;
+  sound->read = lovrSoundReadRaw;
+  lovrAssert(blob->size >= frames * lovrSoundGetStride(sound), "Blob is too small to hold the Sound's samples");
+  sound->blob = blob;
+  lovrRetain(blob);
+  return sound;
+}
+
 Sound* lovrSoundCreateStream(uint32_t frames, SampleFormat format, ChannelLayout layout, uint32_t sampleRate) {
   Sound* sound = calloc(1, sizeof(Sound));
   lovrAssert(sound, "Out of memory");
@@ -128,10 +233,22 @@ static bool loadOgg(Sound* sound, Blob* blob, bool decode) {
   sound->layout = info.channels >= 2 ? CHANNEL_STEREO : CHANNEL_MONO;
   sound->sampleRate = info.sample_rate;
   sound->frames = stb_vorbis_stream_length_in_samples(sound->decoder);
+  size_t size = sound->frames * lovrSoundGetStride(sound);
+  uint64_t key = 0;
+
+  if (!decode && size <= CACHE_THRESHOLD) {
+    key = cacheKey(blob);
+    if ((sound->blob = cacheGet(key)) != NULL) {
+      stb_vorbis_close(sound->decoder);
+      sound->decoder = NULL;
+      sound->read = lovrSoundReadRaw;
+      return true;
+    }
+    decode = true;
+  }
 
   if (decode) {
     sound->read = lovrSoundReadRaw;
-    size_t size = sound->frames * lovrSoundGetStride(sound);
     void* data = calloc(1, size);
     lovrAssert(data, "Out of memory");
     sound->blob = lovrBlobCreate(data, size, "Sound");
@@ -140,6 +257,7 @@ static bool loadOgg(Sound* sound, Blob* blob, bool decode) {
     }
     stb_vorbis_close(sound->decoder);
     sound->decoder = NULL;
+    if (key) cachePut(key, sound->blob);
     return true;
   } else {
     sound->read = lovrSoundReadOgg;
@@ -223,9 +341,19 @@ static bool loadWAV(Sound* sound, Blob* blob, bool decode) {
     }
   }
 
-  // Conversion
   size_t samples = sound->frames * lovrSoundGetChannelCount(sound);
   size_t bytes = sound->frames * lovrSoundGetStride(sound);
+
+  // Samples that don't need conversion are read straight out of mapped files
+  size_t alignment = sound->format == SAMPLE_F32 ? 4 : 2;
+  bool native = !amb && (f32 || (pcm && wav->sampleSize == 16));
+  if (blob->mapped && native && ((uintptr_t) data % alignment) == 0) {
+    sound->blob = lovrBlobCreateView(blob, data - (char*) blob->data, bytes, blob->name);
+    sound->read = lovrSoundReadRaw;
+    return true;
+  }
+
+  // Conversion
   void* raw = malloc(bytes);
   lovrAssert(raw, "Out of memory");
   if (pcm && wav->sampleSize == 24) {
@@ -276,19 +404,9 @@ static bool loadWAV(Sound* sound, Blob* blob, bool decode) {
 static bool loadMP3(Sound* sound, Blob* blob, bool decode) {
   if (mp3dec_detect_buf(blob->data, blob->size)) return false;
 
-  if (decode) {
-    mp3dec_t decoder;
-    mp3dec_file_info_t info;
-    int status = mp3dec_load_buf(&decoder, blob->data, blob->size, &info, NULL, NULL);
-    lovrAssert(!status, "Could not decode mp3 from '%s'", blob->name);
-    sound->blob = lovrBlobCreate(info.buffer, info.samples * sizeof(float), blob->name);
-    sound->format = SAMPLE_F32;
-    sound->sampleRate = info.hz;
-    sound->layout = info.channels == 2 ? CHANNEL_STEREO : CHANNEL_MONO;
-    sound->frames = info.samples / info.channels;
-    sound->read = lovrSoundReadRaw;
-    return true;
-  } else {
+  // Without decode, frames are decoded as they're read (unless the Sound is short enough to cache)
+  uint64_t key = 0;
+  if (!decode) {
     mp3dec_ex_t* decoder = sound->decoder = malloc(sizeof(mp3dec_ex_t));
     lovrAssert(decoder, "Out of memory");
     if (mp3dec_ex_open_buf(sound->decoder, blob->data, blob->size, MP3D_SEEK_TO_SAMPLE)) {
@@ -300,22 +418,125 @@ static bool loadMP3(Sound* sound, Blob* blob, bool decode) {
     sound->layout = decoder->info.channels == 2 ? CHANNEL_STEREO : CHANNEL_MONO;
     sound->frames = decoder->samples / decoder->info.channels;
     sound->read = lovrSoundReadMp3;
-    sound->blob = blob;
-    lovrRetain(blob);
-    return true;
+
+    if (sound->frames * lovrSoundGetStride(sound) > CACHE_THRESHOLD) {
+      lovrBlobEvict(blob, 0, blob->size); // Building the seek index read the whole file
+      sound->blob = blob;
+      lovrRetain(blob);
+      return true;
+    }
+
+    mp3dec_ex_close(sound->decoder);
+    free(sound->decoder);
+    sound->decoder = NULL;
+    sound->read = lovrSoundReadRaw;
+
+    key = cacheKey(blob);
+    if ((sound->blob = cacheGet(key)) != NULL) {
+      return true;
+    }
+  }
+
+  mp3dec_t decoder;
+  mp3dec_file_info_t info;
+  int status = mp3dec_load_buf(&decoder, blob->data, blob->size, &info, NULL, NULL);
+  lovrAssert(!status, "Could not decode mp3 from '%s'", blob->name);
+  sound->blob = lovrBlobCreate(info.buffer, info.samples * sizeof(float), blob->name);
+  sound->format = SAMPLE_F32;
+  sound->sampleRate = info.hz;
+  sound->layout = info.channels == 2 ? CHANNEL_STEREO : CHANNEL_MONO;
+  sound->frames = info.samples / info.channels;
+  sound->read = lovrSoundReadRaw;
+  if (key) cachePut(key, sound->blob);
+  return true;
+}
+
+// Converts the samples of a Sound held in memory to a new sample rate.  Resampled samples go through
+// the cache too, keyed by the compressed bytes and the rate, so reloading a file doesn't redo it.
+static void resample(Sound* sound, Blob* file, uint32_t sampleRate) {
+  uint64_t key = 0;
+  size_t stride = lovrSoundGetStride(sound);
+  if (sound->frames * stride <= CACHE_THRESHOLD) {
+    uint64_t pair[2] = { cacheKey(file), sampleRate };
+    key = hash64(pair, sizeof(pair));
+    Blob* samples = cacheGet(key);
+    if (samples) {
+      lovrRelease(sound->blob, lovrBlobDestroy);
+      sound->blob = samples;
+      sound->frames = (uint32_t) (samples->size / stride);
+      sound->sampleRate = sampleRate;
+      return;
+    }
   }
+
+  ma_format format = miniaudioFormats[sound->format];
+  uint32_t channels = lovrSoundGetChannelCount(sound);
+  ma_data_converter_config config = ma_data_converter_config_init(format, format, channels, channels, sound->sampleRate, sampleRate);
+  ma_data_converter converter;
+  ma_result status = ma_data_converter_init(&config, &converter);
+  lovrAssert(status == MA_SUCCESS, "Problem resampling Sound: %s (%d)", ma_result_description(status), status);
+
+  ma_uint64 framesIn = sound->frames;
+  ma_uint64 framesOut = ma_data_converter_get_expected_output_frame_count(&converter, framesIn);
+  void* data = malloc(framesOut * stride);
+  lovrAssert(data, "Out of memory");
+  ma_data_converter_process_pcm_frames(&converter, sound->blob->data, &framesIn, data, &framesOut);
+  ma_data_converter_uninit(&converter);
+
+  Blob* samples = lovrBlobCreate(data, framesOut * stride, sound->blob->name);
+  lovrRelease(sound->blob, lovrBlobDestroy);
+  sound->blob = samples;
+  sound->frames = (uint32_t) framesOut;
+  sound->sampleRate = sampleRate;
+  if (key) cachePut(key, samples);
 }
 
-Sound* lovrSoundCreateFromFile(Blob* blob, bool decode) {
+// With a sample rate, Sounds that end up fully decoded are resampled to it once, up front, so the
+// Sources playing them don't need a resampler of their own.  Streamed Sounds keep their rate.
+Sound* lovrSoundCreateFromFile(Blob* blob, bool decode, uint32_t sampleRate) {
   Sound* sound = calloc(1, sizeof(Sound));
   lovrAssert(sound, "Out of memory");
   sound->ref = 1;
 
-  if (loadOgg(sound, blob, decode)) return sound;
-  if (loadWAV(sound, blob, decode)) return sound;
-  if (loadMP3(sound, blob, decode)) return sound;
+  if (!loadOgg(sound, blob, decode) && !loadWAV(sound, blob, decode) && !loadMP3(sound, blob, decode)) {
+    lovrThrow("Could not load sound from '%s': Audio format not recognized", blob->name);
+  }
+
+  if (sampleRate > 0 && sampleRate != sound->sampleRate && sound->read == lovrSoundReadRaw) {
+    resample(sound, blob, sampleRate);
+  }
+
+  return sound;
+}
+
+Sound* lovrSoundCreateDecoder(Sound* sound) {
+  if (!sound->decoder) {
+    lovrRetain(sound);
+    return sound;
+  }
+
+  Sound* copy = calloc(1, sizeof(Sound));
+  lovrAssert(copy, "Out of memory");
+  *copy = *sound;
+  copy->ref = 1;
+  copy->cursor = 0;
+  copy->evicted = 0;
+  lovrRetain(copy->blob);
+
+  if (sound->read == lovrSoundReadOgg) {
+    copy->decoder = stb_vorbis_open_memory(copy->blob->data, (int) copy->blob->size, NULL, NULL);
+    lovrAssert(copy->decoder, "Could not load Ogg from '%s'", copy->blob->name);
+  } else {
+    copy->decoder = malloc(sizeof(mp3dec_ex_t));
+    lovrAssert(copy->decoder, "Out of memory");
+    if (mp3dec_ex_open_buf(copy->decoder, copy->blob->data, copy->blob->size, MP3D_SEEK_TO_SAMPLE)) {
+      free(copy->decoder);
+      lovrThrow("Could not load mp3 from '%s'", copy->blob->name);
+    }
+    lovrBlobEvict(copy->blob, 0, copy->blob->size);
+  }
 
-  lovrThrow("Could not load sound from '%s': Audio format not recognized", blob->name);
+  return copy;
 }
 
 Sound* lovrSoundCreateFromCallback(SoundCallback read, void *callbackMemo, SoundDestroyCallback callbackMemoDestroy, SampleFormat format, uint32_t sampleRate, ChannelLayout layout, uint32_t maxFrames) {
@@ -334,6 +555,11 @@ Sound* lovrSoundCreateFromCallback(SoundCallback read, void *callbackMemo, Sound
 
 void lovrSoundDestroy(void* ref) {
   Sound* sound = (Sound*) ref;
+  if (sound->window) {
+    sound->window->data = NULL;
+    sound->window->size = 0;
+    lovrRelease(sound->window, lovrBlobDestroy);
+  }
   if (sound->callbackMemoDestroy) sound->callbackMemoDestroy(sound);
   lovrRelease(sound->blob, lovrBlobDestroy);
   if (sound->read == lovrSoundReadOgg) stb_vorbis_close(sound->decoder);
@@ -383,6 +609,38 @@ uint32_t lovrSoundRead(Sound* sound, uint32_t offset, uint32_t count, void* data
   return sound->read(sound, offset, count, data);
 }
 
+// Streams can be read in place: this returns a Blob wrapping up to count frames that are contiguous
+// in the ring buffer, without copying them.  They stay there until they're released, which empties
+// the Blob, so a reader that holds on to it afterwards sees an empty Blob instead of stale memory.
+Blob* lovrSoundAcquireFrames(Sound* sound, uint32_t count) {
+  lovrAssert(sound->stream, "Only streams can acquire frames");
+  lovrAssert(sound->acquired == 0, "Frames are already acquired, they need to be released first");
+
+  if (!sound->window) {
+    sound->window = lovrBlobCreate(NULL, 0, "Sound frames");
+  }
+
+  void* data = NULL;
+  uint32_t frames = count;
+  ma_pcm_rb_acquire_read(sound->stream, &frames, &data);
+  sound->acquired = frames;
+  sound->window->data = data;
+  sound->window->size = frames * lovrSoundGetStride(sound);
+  return sound->window;
+}
+
+void lovrSoundReleaseFrames(Sound* sound) {
+  if (sound->acquired > 0) {
+    ma_pcm_rb_commit_read(sound->stream, sound->acquired, sound->window->data);
+    sound->acquired = 0;
+  }
+
+  if (sound->window) {
+    sound->window->data = NULL;
+    sound->window->size = 0;
+  }
+}
+
 uint32_t lovrSoundWrite(Sound* sound, uint32_t offset, uint32_t count, const void* data) {
   lovrAssert(!sound->decoder, "Compressed Sound can not be written to");
   lovrAssert(sound->stream || sound->blob, "Live-generated sound can not be written to");
@@ -410,14 +668,103 @@ uint32_t lovrSoundWrite(Sound* sound, uint32_t offset, uint32_t count, const voi
   return frames;
 }
 
+// Converts frames between sample formats, and between mono and stereo (stereo is mixed down to mono
+// by averaging).  Channel counts need to match otherwise.
+void lovrSoundConvert(const void* src, SampleFormat srcFormat, uint32_t srcChannels, void* dst, SampleFormat dstFormat, uint32_t dstChannels, uint32_t count) {
+  lovrAssert(srcChannels == dstChannels || srcChannels + dstChannels == 3, "Only mono and stereo can be converted between");
+  size_t srcStride = srcChannels * (srcFormat == SAMPLE_I16 ? sizeof(int16_t) : sizeof(float));
+  size_t dstStride = dstChannels * (dstFormat == SAMPLE_I16 ? sizeof(int16_t) : sizeof(float));
+
+  if (srcFormat == dstFormat && srcChannels == dstChannels) {
+    memcpy(dst, src, count * srcStride);
+    return;
+  }
+
+  float a[CONVERT_CHUNK * 4];
+  float b[CONVERT_CHUNK * 4];
+  const char* in = src;
+  char* out = dst;
+
+  while (count > 0) {
+    uint32_t frames = MIN(count, CONVERT_CHUNK);
+    const float* samples = (const float*) in;
+
+    if (srcFormat == SAMPLE_I16) {
+      mix_i16_to_f32(a, (const int16_t*) in, frames * srcChannels);
+      samples = a;
+    }
+
+    if (srcChannels != dstChannels) {
+      float* mixed = samples == a ? b : a;
+      if (srcChannels == 1) {
+        mix_interleave(mixed, samples, frames);
+      } else {
+        mix_downmix(mixed, samples, frames);
+      }
+      samples = mixed;
+    }
+
+    if (dstFormat == SAMPLE_I16) {
+      mix_f32_to_i16((int16_t*) out, samples, frames * dstChannels);
+    } else {
+      memcpy(out, samples, frames * dstStride);
+    }
+
+    in += frames * srcStride;
+    out += frames * dstStride;
+    count -= frames;
+  }
+}
+
+// Copies between Sounds with different formats or layouts read a chunk of the source at a time and
+// convert it straight into the destination.  Streams only take as many frames as they have room for.
+static uint32_t copyConverted(Sound* src, Sound* dst, uint32_t count, uint32_t srcOffset, uint32_t dstOffset) {
+  uint32_t srcChannels = lovrSoundGetChannelCount(src);
+  uint32_t dstChannels = lovrSoundGetChannelCount(dst);
+  size_t dstStride = lovrSoundGetStride(dst);
+  char raw[CONVERT_CHUNK * 4 * sizeof(float)];
+  uint32_t frames = 0;
+
+  if (!dst->stream) {
+    count = MIN(count, dst->frames - dstOffset);
+  }
+
+  while (frames < count) {
+    uint32_t chunk = MIN(count - frames, CONVERT_CHUNK);
+    void* data = NULL;
+
+    if (dst->stream) {
+      ma_pcm_rb_acquire_write(dst->stream, &chunk, &data);
+    } else {
+      data = (char*) dst->blob->data + (dstOffset + frames) * dstStride;
+    }
+
+    uint32_t read = chunk > 0 ? src->read(src, srcOffset + frames, chunk, raw) : 0;
+    lovrSoundConvert(raw, src->format, srcChannels, data, dst->format, dstChannels, read);
+
+    if (dst->stream) {
+      ma_pcm_rb_commit_write(dst->stream, read, data);
+    }
+
+    if (read == 0) break;
+    frames += read;
+  }
+
+  return frames;
+}
+
 uint32_t lovrSoundCopy(Sound* src, Sound* dst, uint32_t count, uint32_t srcOffset, uint32_t dstOffset) {
   lovrAssert(!dst->decoder, "Compressed Sound can not be written to");
   lovrAssert(dst->stream || dst->blob, "Live-generated sound can not be written to");
   lovrAssert(src != dst, "Can not copy a Sound to itself");
-  lovrAssert(src->format == dst->format, "Sound formats need to match");
-  lovrAssert(src->layout == dst->layout, "Sound channel layouts need to match");
   uint32_t frames = 0;
 
+  if (src->format != dst->format || src->layout != dst->layout) {
+    bool mixable = src->layout != CHANNEL_AMBISONIC && dst->layout != CHANNEL_AMBISONIC;
+    lovrAssert(src->layout == dst->layout || mixable, "Sound channel layouts need to match, or be mono and stereo");
+    return copyConverted(src, dst, count, srcOffset, dstOffset);
+  }
+
   if (dst->stream) {
     while (frames < count) {
       void* data;
@@ -26,8 +26,10 @@ typedef uint32_t (SoundCallback)(Sound* sound, uint32_t offset, uint32_t count,
 typedef void (SoundDestroyCallback)(Sound* sound);
 
 Sound* lovrSoundCreateRaw(uint32_t frames, SampleFormat format, ChannelLayout channels, uint32_t sampleRate, struct Blob* data);
+Sound* lovrSoundCreateView(uint32_t frames, SampleFormat format, ChannelLayout channels, uint32_t sampleRate, struct Blob* blob);
 Sound* lovrSoundCreateStream(uint32_t frames, SampleFormat format, ChannelLayout channels, uint32_t sampleRate);
-Sound* lovrSoundCreateFromFile(struct Blob* blob, bool decode);
+Sound* lovrSoundCreateFromFile(struct Blob* blob, bool decode, uint32_t sampleRate);
+Sound* lovrSoundCreateDecoder(Sound* sound);
 Sound* lovrSoundCreateFromCallback(SoundCallback read, void *callbackMemo, SoundDestroyCallback callbackDataDestroy, SampleFormat format, uint32_t sampleRate, ChannelLayout channels, uint32_t maxFrames);
 void lovrSoundDestroy(void* ref);
 struct Blob* lovrSoundGetBlob(Sound* sound);
@@ -40,6 +42,9 @@ size_t lovrSoundGetStride(Sound* sound);
 bool lovrSoundIsCompressed(Sound* sound);
 bool lovrSoundIsStream(Sound* sound);
 uint32_t lovrSoundRead(Sound* sound, uint32_t offset, uint32_t count, void* data);
+struct Blob* lovrSoundAcquireFrames(Sound* sound, uint32_t count);
+void lovrSoundReleaseFrames(Sound* sound);
 uint32_t lovrSoundWrite(Sound* sound, uint32_t offset, uint32_t count, const void* data);
 uint32_t lovrSoundCopy(Sound* src, Sound* dst, uint32_t frames, uint32_t srcOffset, uint32_t dstOffset);
+void lovrSoundConvert(const void* src, SampleFormat srcFormat, uint32_t srcChannels, void* dst, SampleFormat dstFormat, uint32_t dstChannels, uint32_t count);
 void *lovrSoundGetCallbackMemo(Sound *sound);
@@ -0,0 +1,195 @@
+#include "data/soundBank.h"
+#include "data/sound.h"
+#include "data/blob.h"
+#include "core/map.h"
+#include "core/util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A SoundBank packs many Sounds into one file, so loading them is a single read (or map) of the
+// bank instead of one read and header parse per file.  It's a header, then a table of fixed size
+// entries, then the null terminated names, then the sample data of each Sound aligned to 16 bytes.
+// Uncompressed Sounds are stored as raw samples and read straight out of the bank.  Compressed
+// Sounds keep their original ogg/mp3 bytes and decode from the bank the same way they would from
+// their own file.  Like the ModelData cache, the format isn't meant to be portable across versions.
+
+#define MAGIC_BANK 0x4b4e4253 // SBNK
+#define BANK_VERSION 1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t charCount;
+} BankHeader;
+
+typedef struct {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t name;
+  uint32_t frames;
+  uint32_t sampleRate;
+  uint32_t loopStart;
+  uint32_t loopEnd;
+  uint8_t format;
+  uint8_t layout;
+  uint8_t compressed;
+  uint8_t padding;
+} BankEntry;
+
+struct SoundBank {
+  uint32_t ref;
+  uint32_t count;
+  Blob* blob;
+  BankEntry* entries;
+  const char* chars;
+  Sound** sounds;
+  map_t names;
+};
+
+static size_t getStride(uint8_t format, uint8_t layout) {
+  static const size_t sampleSizes[] = { [SAMPLE_F32] = 4, [SAMPLE_I16] = 2 };
+  static const size_t channelCounts[] = { [CHANNEL_MONO] = 1, [CHANNEL_STEREO] = 2, [CHANNEL_AMBISONIC] = 4 };
+  return sampleSizes[format] * channelCounts[layout];
+}
+
+Blob* lovrSoundBankEncode(SoundBankEntry* entries, uint32_t count) {
+  size_t charCount = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    Sound* sound = entries[i].sound;
+    lovrAssert(!lovrSoundIsStream(sound) && lovrSoundGetBlob(sound), "Sound '%s' can not be added to a SoundBank (only Sounds with samples or compressed data can be)", entries[i].name);
+    lovrAssert(entries[i].loopStart <= entries[i].loopEnd && entries[i].loopEnd <= lovrSoundGetFrameCount(sound), "Loop points of Sound '%s' are out of range", entries[i].name);
+    charCount += strlen(entries[i].name) + 1;
+  }
+
+  lovrAssert(charCount <= UINT32_MAX, "SoundBank names are too long");
+  size_t size = ALIGN(sizeof(BankHeader) + count * sizeof(BankEntry) + charCount, 16);
+  for (uint32_t i = 0; i < count; i++) {
+    Sound* sound = entries[i].sound;
+    bool compressed = lovrSoundIsCompressed(sound);
+    size += ALIGN(compressed ? lovrSoundGetBlob(sound)->size : lovrSoundGetFrameCount(sound) * lovrSoundGetStride(sound), 16);
+  }
+
+  char* data = calloc(1, size);
+  lovrAssert(data, "Out of memory");
+  BankHeader* header = (BankHeader*) data;
+  BankEntry* table = (BankEntry*) (header + 1);
+  char* chars = (char*) (table + count);
+  header->magic = MAGIC_BANK;
+  header->version = BANK_VERSION;
+  header->count = count;
+  header->charCount = (uint32_t) charCount;
+
+  uint32_t name = 0;
+  uint64_t offset = ALIGN(sizeof(BankHeader) + count * sizeof(BankEntry) + charCount, 16);
+  for (uint32_t i = 0; i < count; i++) {
+    Sound* sound = entries[i].sound;
+    Blob* blob = lovrSoundGetBlob(sound);
+    BankEntry* entry = &table[i];
+    entry->compressed = lovrSoundIsCompressed(sound);
+    entry->size = entry->compressed ? blob->size : lovrSoundGetFrameCount(sound) * lovrSoundGetStride(sound);
+    entry->offset = offset;
+    entry->name = name;
+    entry->frames = lovrSoundGetFrameCount(sound);
+    entry->sampleRate = lovrSoundGetSampleRate(sound);
+    entry->loopStart = entries[i].loopStart;
+    entry->loopEnd = entries[i].loopEnd;
+    entry->format = lovrSoundGetFormat(sound);
+    entry->layout = lovrSoundGetChannelLayout(sound);
+    lovrAssert(blob->size >= entry->size, "Sound '%s' is missing samples", entries[i].name);
+    memcpy(data + offset, blob->data, entry->size);
+    offset += ALIGN(entry->size, 16);
+
+    size_t length = strlen(entries[i].name);
+    memcpy(chars + name, entries[i].name, length + 1);
+    name += (uint32_t) length + 1;
+  }
+
+  return lovrBlobCreate(data, size, "SoundBank");
+}
+
+SoundBank* lovrSoundBankCreate(Blob* blob) {
+  BankHeader* header = blob->data;
+  lovrAssert(blob->size >= sizeof(BankHeader) && header->magic == MAGIC_BANK, "Could not load SoundBank from '%s': not a SoundBank", blob->name);
+  lovrAssert(header->version == BANK_VERSION, "SoundBank was written by a different version of LÖVR (version %d, expected %d)", header->version, BANK_VERSION);
+  lovrAssert(sizeof(BankHeader) + (uint64_t) header->count * sizeof(BankEntry) + header->charCount <= blob->size, "SoundBank is truncated");
+
+  SoundBank* bank = calloc(1, sizeof(SoundBank));
+  lovrAssert(bank, "Out of memory");
+  bank->ref = 1;
+  bank->count = header->count;
+  bank->blob = blob;
+  bank->entries = (BankEntry*) (header + 1);
+  bank->chars = (const char*) (bank->entries + bank->count);
+  bank->sounds = calloc(bank->count, sizeof(Sound*));
+  lovrAssert(bank->sounds || bank->count == 0, "Out of memory");
+  lovrRetain(blob);
+
+  const char* chars = bank->chars;
+  lovrAssert(header->charCount == 0 || chars[header->charCount - 1] == '\0', "SoundBank is corrupt");
+
+  map_init(&bank->names, bank->count);
+  for (uint32_t i = 0; i < bank->count; i++) {
+    BankEntry* entry = &bank->entries[i];
+    lovrAssert(entry->name < header->charCount, "SoundBank is corrupt");
+    lovrAssert(entry->offset + entry->size <= blob->size, "SoundBank is truncated");
+    lovrAssert(entry->format <= SAMPLE_I16 && entry->layout <= CHANNEL_AMBISONIC, "SoundBank is corrupt");
+    lovrAssert(entry->compressed || entry->size >= entry->frames * getStride(entry->format, entry->layout), "SoundBank is truncated");
+    const char* name = chars + entry->name;
+    map_set(&bank->names, hash64(name, strlen(name)), i);
+  }
+
+  return bank;
+}
+
+void lovrSoundBankDestroy(void* ref) {
+  SoundBank* bank = ref;
+  for (uint32_t i = 0; i < bank->count; i++) {
+    lovrRelease(bank->sounds[i], lovrSoundDestroy);
+  }
+  lovrRelease(bank->blob, lovrBlobDestroy);
+  map_free(&bank->names);
+  free(bank->sounds);
+  free(bank);
+}
+
+Blob* lovrSoundBankGetBlob(SoundBank* bank) {
+  return bank->blob;
+}
+
+uint32_t lovrSoundBankGetCount(SoundBank* bank) {
+  return bank->count;
+}
+
+uint32_t lovrSoundBankFind(SoundBank* bank, const char* name, size_t length) {
+  uint64_t index = map_get(&bank->names, hash64(name, length));
+  return index == MAP_NIL ? BANK_NONE : (uint32_t) index;
+}
+
+const char* lovrSoundBankGetName(SoundBank* bank, uint32_t index) {
+  lovrAssert(index < bank->count, "Invalid SoundBank index %d", index + 1);
+  return bank->chars + bank->entries[index].name;
+}
+
+void lovrSoundBankGetLoop(SoundBank* bank, uint32_t index, uint32_t* start, uint32_t* end) {
+  lovrAssert(index < bank->count, "Invalid SoundBank index %d", index + 1);
+  *start = bank->entries[index].loopStart;
+  *end = bank->entries[index].loopEnd;
+}
+
+// Sounds are created the first time they're used, as views of the bank's Blob
+Sound* lovrSoundBankGetSound(SoundBank* bank, uint32_t index) {
+  lovrAssert(index < bank->count, "Invalid SoundBank index %d", index + 1);
+  if (!bank->sounds[index]) {
+    BankEntry* entry = &bank->entries[index];
+    const char* name = bank->chars + entry->name;
+    Blob* view = lovrBlobCreateView(bank->blob, entry->offset, entry->size, name);
+    if (entry->compressed) {
+      bank->sounds[index] = lovrSoundCreateFromFile(view, false, 0);
+    } else {
+      bank->sounds[index] = lovrSoundCreateView(entry->frames, entry->format, entry->layout, entry->sampleRate, view);
+    }
+    lovrRelease(view, lovrBlobDestroy);
+  }
+  return bank->sounds[index];
+}
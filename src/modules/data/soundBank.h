@@ -0,0 +1,28 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#pragma once
+
+struct Blob;
+struct Sound;
+
+#define BANK_NONE (~0u)
+
+typedef struct SoundBank SoundBank;
+
+typedef struct {
+  const char* name;
+  struct Sound* sound;
+  uint32_t loopStart;
+  uint32_t loopEnd;
+} SoundBankEntry;
+
+struct Blob* lovrSoundBankEncode(SoundBankEntry* entries, uint32_t count);
+SoundBank* lovrSoundBankCreate(struct Blob* blob);
+void lovrSoundBankDestroy(void* ref);
+struct Blob* lovrSoundBankGetBlob(SoundBank* bank);
+uint32_t lovrSoundBankGetCount(SoundBank* bank);
+uint32_t lovrSoundBankFind(SoundBank* bank, const char* name, size_t length);
+const char* lovrSoundBankGetName(SoundBank* bank, uint32_t index);
+void lovrSoundBankGetLoop(SoundBank* bank, uint32_t index, uint32_t* start, uint32_t* end);
+struct Sound* lovrSoundBankGetSound(SoundBank* bank, uint32_t index);
@@ -2,18 +2,61 @@
 #include "thread/thread.h"
 #include "core/os.h"
 #include "core/util.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#endif
 #include <stdlib.h>
 #include <string.h>
 
+// Events go in a ring that's allocated up front.  It only grows if a burst fills it, so a steady
+// stream of events doesn't allocate.  Threads can push events (errors), so there's a lock.
+#define INITIAL_EVENT_CAPACITY 256
+
 static struct {
   bool initialized;
-  arr_t(Event) events;
-  size_t head;
+#ifndef LOVR_DISABLE_THREAD
+  mtx_t lock;
+#endif
+  Event* events;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t count;
 } state;
 
+#ifndef LOVR_DISABLE_THREAD
+#define lock() mtx_lock(&state.lock)
+#define unlock() mtx_unlock(&state.lock)
+#else
+#define lock()
+#define unlock()
+#endif
+
+static void destroyEvent(Event* event) {
+  switch (event->type) {
+#ifndef LOVR_DISABLE_THREAD
+    case EVENT_THREAD_ERROR: lovrRelease(event->data.thread.thread, lovrThreadDestroy); break;
+#endif
+    case EVENT_FILECHANGED: free(event->data.file.path); break;
+    case EVENT_CUSTOM:
+      for (uint32_t i = 0; i < event->data.custom.count; i++) {
+        lovrVariantDestroy(&event->data.custom.data[i]);
+      }
+      break;
+    default: break;
+  }
+}
+
 void lovrVariantDestroy(Variant* variant) {
   switch (variant->type) {
     case TYPE_STRING: free(variant->value.string); return;
+    case TYPE_TABLE: {
+      Variant* objects = (Variant*) (variant->value.table.data + ALIGN(variant->value.table.size, 8));
+      for (uint32_t i = 0; i < variant->value.table.objectCount; i++) {
+        lovrVariantDestroy(&objects[i]);
+      }
+      free(variant->value.table.data);
+      return;
+    }
     case TYPE_OBJECT: lovrRelease(variant->value.object.pointer, variant->value.object.destructor); return;
     default: return;
   }
@@ -21,27 +64,22 @@ void lovrVariantDestroy(Variant* variant) {
 
 bool lovrEventInit() {
   if (state.initialized) return false;
-  arr_init(&state.events, realloc);
+#ifndef LOVR_DISABLE_THREAD
+  mtx_init(&state.lock, mtx_plain);
+#endif
+  state.capacity = INITIAL_EVENT_CAPACITY;
+  state.events = malloc(state.capacity * sizeof(Event));
+  lovrAssert(state.events, "Out of memory");
   return state.initialized = true;
 }
 
 void lovrEventDestroy() {
   if (!state.initialized) return;
-  for (size_t i = state.head; i < state.events.length; i++) {
-    Event* event = &state.events.data[i];
-    switch (event->type) {
+  lovrEventClear();
+  free(state.events);
 #ifndef LOVR_DISABLE_THREAD
-      case EVENT_THREAD_ERROR: lovrRelease(event->data.thread.thread, lovrThreadDestroy); break;
+  mtx_destroy(&state.lock);
 #endif
-      case EVENT_CUSTOM:
-        for (uint32_t j = 0; j < event->data.custom.count; j++) {
-          lovrVariantDestroy(&event->data.custom.data[j]);
-        }
-        break;
-      default: break;
-    }
-  }
-  arr_free(&state.events);
   memset(&state, 0, sizeof(state));
 }
 
@@ -56,20 +94,50 @@ void lovrEventPush(Event event) {
   }
 #endif
 
-  arr_push(&state.events, event);
+  lock();
+
+  // Unwraps the ring into the front of the new one
+  if (state.count == state.capacity) {
+    Event* events = malloc(2 * state.capacity * sizeof(Event));
+    lovrAssert(events, "Out of memory");
+    uint32_t tail = state.capacity - state.head;
+    memcpy(events, state.events + state.head, tail * sizeof(Event));
+    memcpy(events + tail, state.events, state.head * sizeof(Event));
+    free(state.events);
+    state.events = events;
+    state.capacity *= 2;
+    state.head = 0;
+  }
+
+  state.events[(state.head + state.count) & (state.capacity - 1)] = event;
+  state.count++;
+  unlock();
 }
 
 bool lovrEventPoll(Event* event) {
-  if (state.head == state.events.length) {
-    state.head = state.events.length = 0;
-    return false;
+  lock();
+  bool found = state.count > 0;
+  if (found) {
+    *event = state.events[state.head];
+    state.head = (state.head + 1) & (state.capacity - 1);
+    state.count--;
   }
+  unlock();
+  return found;
+}
 
-  *event = state.events.data[state.head++];
-  return true;
+uint32_t lovrEventGetCount() {
+  lock();
+  uint32_t count = state.count;
+  unlock();
+  return count;
 }
 
 void lovrEventClear() {
-  arr_clear(&state.events);
-  state.head = 0;
+  lock();
+  for (uint32_t i = 0; i < state.count; i++) {
+    destroyEvent(&state.events[(state.head + i) & (state.capacity - 1)]);
+  }
+  state.head = state.count = 0;
+  unlock();
 }
@@ -19,6 +19,7 @@ typedef enum {
   EVENT_THREAD_ERROR,
 #endif
   EVENT_PERMISSION,
+  EVENT_FILECHANGED,
   EVENT_CUSTOM
 } EventType;
 
@@ -27,6 +28,8 @@ typedef enum {
   TYPE_BOOLEAN,
   TYPE_NUMBER,
   TYPE_STRING,
+  TYPE_MINISTRING,
+  TYPE_TABLE,
   TYPE_OBJECT
 } VariantType;
 
@@ -34,6 +37,15 @@ typedef union {
   bool boolean;
   double number;
   char* string;
+  struct {
+    char data[23];
+    uint8_t length;
+  } ministring; // Short strings are stored inline, without allocating
+  struct {
+    char* data; // Serialized keys and values, followed by an array of object Variants they use
+    uint32_t size;
+    uint32_t objectCount;
+  } table;
   struct {
     void* pointer;
     const char* type;
@@ -86,6 +98,10 @@ typedef struct {
   bool granted;
 } PermissionEvent;
 
+typedef struct {
+  char* path;
+} FileEvent;
+
 typedef union {
   QuitEvent quit;
   BoolEvent boolean;
@@ -95,6 +111,7 @@ typedef union {
   ThreadEvent thread;
   CustomEvent custom;
   PermissionEvent permission;
+  FileEvent file;
 } EventData;
 
 typedef struct {
@@ -109,4 +126,5 @@ void lovrEventDestroy(void);
 void lovrEventPump(void);
 void lovrEventPush(Event event);
 bool lovrEventPoll(Event* event);
+uint32_t lovrEventGetCount(void);
 void lovrEventClear(void);
@@ -2,9 +2,13 @@
 #include "core/fs.h"
 #include "core/map.h"
 #include "core/os.h"
+#include "core/profile.h"
 #include "core/util.h"
 #include "core/zip.h"
-#include "lib/stb/stb_image.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
@@ -35,17 +39,31 @@ typedef struct {
   uint16_t mdate;
   uint16_t mtime;
   FileInfo info;
+  void* cache;
+  uint32_t newer;
+  uint32_t older;
 } zip_node;
 
+// A cached stat result for a path in a directory archive, including paths that don't exist
+typedef struct {
+  FileInfo info;
+  bool exists;
+} dir_entry;
+
 typedef struct Archive {
   bool (*stat)(struct Archive* archive, const char* path, FileInfo* info);
   void (*list)(struct Archive* archive, const char* path, fs_list_cb callback, void* context);
-  bool (*read)(struct Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data);
+  bool (*read)(struct Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data, arr_allocator* alloc);
   void (*close)(struct Archive* archive);
   zip_state zip;
   strpool strings;
   arr_t(zip_node) nodes;
+  arr_t(dir_entry) entries;
+  fs_watcher* watcher;
   map_t lookup;
+  size_t cacheSize;
+  uint32_t newest;
+  uint32_t oldest;
   size_t path;
   size_t pathLength;
   size_t mountpoint;
@@ -61,6 +79,8 @@ static struct {
   char requirePath[1024];
   char identity[64];
   bool fused;
+  size_t cacheLimit;
+  atomic_flag cacheLock;
 } state;
 
 // Rejects any path component that would escape the virtual filesystem (./, ../, :, and \)
@@ -158,6 +178,15 @@ bool lovrFilesystemIsFused() {
 // Archives
 
 static bool dir_init(Archive* archive, const char* path, const char* mountpoint, const char* root);
+static bool dir_resolve(char* buffer, Archive* archive, const char* path);
+static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data, arr_allocator* alloc);
+static void dir_forget(Archive* archive, const char* path);
+static void lock(void);
+static void unlock(void);
+static zip_node* zip_lookup(Archive* archive, const char* path);
+static void zip_cache(Archive* archive, zip_node* node, void* data, size_t size);
+static void zip_evict(Archive* archive, size_t limit);
+static bool zip_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** dst, arr_allocator* alloc);
 static bool zip_init(Archive* archive, const char* path, const char* mountpoint, const char* root);
 
 bool lovrFilesystemMount(const char* path, const char* mountpoint, bool append, const char* root) {
@@ -167,7 +196,7 @@ bool lovrFilesystemMount(const char* path, const char* mountpoint, bool append,
     }
   }
 
-  Archive archive;
+  Archive archive = { 0 };
   arr_init(&archive.strings, realloc);
 
   if (!dir_init(&archive, path, mountpoint, root) && !zip_init(&archive, path, mountpoint, root)) {
@@ -245,20 +274,64 @@ uint64_t lovrFilesystemGetSize(const char* path) {
   return archiveStat(path, &info) ? info.size : ~0ull;
 }
 
+// Always goes to the disk so that polling for changes works
 uint64_t lovrFilesystemGetLastModified(const char* path) {
   FileInfo info;
+  lovrFilesystemRefresh(path);
   return archiveStat(path, &info) ? info.lastModified : ~0ull;
 }
 
-void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead) {
+static void* archiveRead(const char* path, size_t bytes, size_t* bytesRead, arr_allocator* alloc) {
+  void* data = NULL;
   if (valid(path)) {
-    void* data;
+    lovrProfileBegin("lovrFilesystemRead");
     FOREACH_ARCHIVE(archive) {
-      if (archive->read(archive, path, bytes, bytesRead, &data)) {
-        return data;
+      if (archive->read(archive, path, bytes, bytesRead, &data, alloc)) {
+        break;
       }
+      data = NULL;
     }
+    lovrProfileEnd();
+  }
+  return data;
+}
+
+void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead) {
+  return archiveRead(path, bytes, bytesRead, realloc);
+}
+
+// The contents are temporary memory, see temp_alloc
+void* lovrFilesystemReadTemp(const char* path, size_t bytes, size_t* bytesRead) {
+  return archiveRead(path, bytes, bytesRead, temp_realloc);
+}
+
+// Files in directories are mapped directly.  Files stored in zips without compression are mapped as
+// a range of the zip file, so the mapping doesn't depend on the archive staying mounted.  Compressed
+// files can't be mapped and need to be read.  On Android the project is the apk itself, and the
+// build stores asset types listed in ANDROID_STORED_EXTENSIONS so they take this path.
+void* lovrFilesystemMap(const char* path, size_t* size) {
+  FileInfo info;
+  Archive* archive = archiveStat(path, &info);
+  if (!archive || info.type != FILE_REGULAR || info.size == 0) {
+    return NULL;
   }
+
+  if (archive->read == dir_read) {
+    char resolved[LOVR_PATH_MAX];
+    return dir_resolve(resolved, archive, path) ? fs_map(resolved, size) : NULL;
+  } else if (archive->read == zip_read) {
+    uint16_t method;
+    const zip_node* node = zip_lookup(archive, path);
+    const char* data = node ? zip_load(&archive->zip, node->offset, &method) : NULL;
+    if (!data || method != ZIP_STORE || node->csize != info.size) {
+      return NULL;
+    }
+
+    *size = info.size;
+    uint64_t offset = data - (const char*) archive->zip.data;
+    return fs_map_range(strpool_resolve(&archive->strings, archive->path), offset, *size);
+  }
+
   return NULL;
 }
 
@@ -362,12 +435,17 @@ bool lovrFilesystemCreateDirectory(const char* path) {
     cursor++;
   }
 
+  lovrFilesystemRefresh(NULL);
   return fs_mkdir(resolved);
 }
 
 bool lovrFilesystemRemove(const char* path) {
   char resolved[LOVR_PATH_MAX];
-  return valid(path) && concat(resolved, state.savePath, state.savePathLength, path, strlen(path)) && fs_remove(resolved);
+  if (!valid(path) || !concat(resolved, state.savePath, state.savePathLength, path, strlen(path))) {
+    return false;
+  }
+  lovrFilesystemRefresh(NULL);
+  return fs_remove(resolved);
 }
 
 size_t lovrFilesystemWrite(const char* path, const char* content, size_t size, bool append) {
@@ -383,9 +461,93 @@ size_t lovrFilesystemWrite(const char* path, const char* content, size_t size, b
 
   fs_write(file, content, &size);
   fs_close(file);
+  lovrFilesystemRefresh(path);
   return size;
 }
 
+// Watches directory archives for changes.  Returns false if the platform doesn't support it.
+bool lovrFilesystemWatch() {
+  bool watching = false;
+  FOREACH_ARCHIVE(archive) {
+    if (archive->read == dir_read) {
+      if (!archive->watcher) {
+        archive->watcher = fs_watch(strpool_resolve(&archive->strings, archive->path));
+      }
+      watching |= !!archive->watcher;
+    }
+  }
+  return watching;
+}
+
+void lovrFilesystemUnwatch() {
+  FOREACH_ARCHIVE(archive) {
+    if (archive->watcher) {
+      fs_unwatch(archive->watcher);
+      archive->watcher = NULL;
+    }
+  }
+}
+
+typedef struct {
+  Archive* archive;
+  void (*callback)(void* context, const char* path);
+  void* context;
+} ChangeContext;
+
+static void onChange(void* userdata, const char* path) {
+  ChangeContext* change = userdata;
+  Archive* archive = change->archive;
+  char buffer[LOVR_PATH_MAX];
+
+  // Changes are reported relative to the archive, so they need to be moved under its mountpoint
+  const char* mountpoint = strpool_resolve(&archive->strings, archive->mountpoint);
+  if (archive->mountpointLength > 0) {
+    if (!concat(buffer, mountpoint, archive->mountpointLength, path, strlen(path))) return;
+    path = buffer;
+  }
+
+  // Files in new or moved directories may have been cached as missing
+  FileInfo info;
+  lovrFilesystemRefresh(path);
+  if (archive->stat(archive, path, &info) && info.type == FILE_DIRECTORY) {
+    lovrFilesystemRefresh(NULL);
+  }
+
+  change->callback(change->context, path);
+}
+
+// Reports files in watched archives that changed since the last poll, as virtual paths
+void lovrFilesystemPollChanges(void (*callback)(void* context, const char* path), void* context) {
+  FOREACH_ARCHIVE(archive) {
+    if (archive->watcher) {
+      ChangeContext change = { archive, callback, context };
+      fs_watch_poll(archive->watcher, onChange, &change);
+    }
+  }
+}
+
+// Directory archives cache stat results.  Files changed outside of lovr.filesystem need to be
+// refreshed, either individually or all at once (NULL)
+void lovrFilesystemRefresh(const char* path) {
+  if (path && !valid(path)) {
+    return;
+  }
+
+  lock();
+  FOREACH_ARCHIVE(archive) {
+    if (archive->read == dir_read) {
+      if (path) {
+        dir_forget(archive, path);
+      } else {
+        map_free(&archive->lookup);
+        map_init(&archive->lookup, 0);
+        arr_clear(&archive->entries);
+      }
+    }
+  }
+  unlock();
+}
+
 // Paths
 
 size_t lovrFilesystemGetAppdataDirectory(char* buffer, size_t size) {
@@ -404,6 +566,85 @@ size_t lovrFilesystemGetWorkingDirectory(char* buffer, size_t size) {
   return os_get_working_directory(buffer, size);
 }
 
+// Decompressed files are kept in an LRU cache (per zip archive) with a size limit, 0 disables it
+size_t lovrFilesystemGetCacheLimit() {
+  return state.cacheLimit;
+}
+
+void lovrFilesystemSetCacheLimit(size_t limit) {
+  state.cacheLimit = limit;
+  FOREACH_ARCHIVE(archive) {
+    if (archive->read == zip_read) {
+      zip_evict(archive, limit);
+    }
+  }
+}
+
+typedef struct {
+  Archive* archive;
+  zip_node* node;
+  const void* data;
+  uint16_t method;
+} PreloadJob;
+
+static void preloadFile(void* arg) {
+  PreloadJob* job = arg;
+  size_t size = job->node->info.size;
+  void* data = malloc(size);
+  if (!data) return;
+  if (zip_decompress(job->method, data, size, job->data, job->node->csize)) {
+    zip_cache(job->archive, job->node, data, size);
+  } else {
+    free(data);
+  }
+}
+
+// Decompresses a batch of files into the cache, in parallel when the thread pool is running
+void lovrFilesystemPreload(const char** paths, uint32_t count) {
+  if (state.cacheLimit == 0) {
+    return;
+  }
+
+  PreloadJob* jobs = malloc(count * sizeof(PreloadJob));
+  void** args = malloc(count * sizeof(void*));
+  if (!jobs || !args) {
+    free(jobs);
+    free(args);
+    return;
+  }
+
+  uint32_t jobCount = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    FileInfo info;
+    Archive* archive = archiveStat(paths[i], &info);
+    if (!archive || archive->read != zip_read || info.type != FILE_REGULAR) {
+      continue;
+    }
+
+    uint16_t method;
+    zip_node* node = zip_lookup(archive, paths[i]);
+    const void* data = zip_load(&archive->zip, node->offset, &method);
+    if (!data || method == ZIP_STORE || node->cache || node->info.size > state.cacheLimit) {
+      continue;
+    }
+
+    jobs[jobCount] = (PreloadJob) { archive, node, data, method };
+    args[jobCount] = &jobs[jobCount];
+    jobCount++;
+  }
+
+#ifndef LOVR_DISABLE_THREAD
+  lovrThreadPoolRun(preloadFile, args, jobCount);
+#else
+  for (uint32_t i = 0; i < jobCount; i++) {
+    preloadFile(args[i]);
+  }
+#endif
+
+  free(jobs);
+  free(args);
+}
+
 const char* lovrFilesystemGetRequirePath() {
   return state.requirePath;
 }
@@ -433,9 +674,47 @@ static bool dir_resolve(char* buffer, Archive* archive, const char* path) {
   return concat(buffer, strpool_resolve(&archive->strings, archive->path), archive->pathLength, path, length);
 }
 
+static uint64_t dir_hash(const char* path) {
+  char buffer[LOVR_PATH_MAX];
+  size_t length = strlen(path);
+  if (length >= sizeof(buffer)) return 0;
+  length = normalize(buffer, path, length);
+  return hash64(buffer, length);
+}
+
+// Returns false if the path isn't cached yet
+static bool dir_lookup(Archive* archive, uint64_t hash, dir_entry* entry) {
+  lock();
+  uint64_t index = map_get(&archive->lookup, hash);
+  if (index != MAP_NIL) *entry = archive->entries.data[index];
+  unlock();
+  return index != MAP_NIL;
+}
+
+static void dir_forget(Archive* archive, const char* path) {
+  map_remove(&archive->lookup, dir_hash(path));
+}
+
 static bool dir_stat(Archive* archive, const char* path, FileInfo* info) {
+  dir_entry entry;
+  uint64_t hash = dir_hash(path);
+  if (dir_lookup(archive, hash, &entry)) {
+    *info = entry.info;
+    return entry.exists;
+  }
+
   char resolved[LOVR_PATH_MAX];
-  return dir_resolve(resolved, archive, path) && fs_stat(resolved, info);
+  entry.exists = dir_resolve(resolved, archive, path) && fs_stat(resolved, &entry.info);
+  *info = entry.info;
+
+  lock();
+  if (map_get(&archive->lookup, hash) == MAP_NIL) {
+    map_set(&archive->lookup, hash, archive->entries.length);
+    arr_push(&archive->entries, entry);
+  }
+  unlock();
+
+  return entry.exists;
 }
 
 static void dir_list(Archive* archive, const char* path, fs_list_cb callback, void* context) {
@@ -445,10 +724,16 @@ static void dir_list(Archive* archive, const char* path, fs_list_cb callback, vo
   }
 }
 
-static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data) {
+static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** data, arr_allocator* alloc) {
   char resolved[LOVR_PATH_MAX];
   fs_handle file;
 
+  // Skip the open syscall for files that are known to be missing
+  dir_entry entry;
+  if (dir_lookup(archive, dir_hash(path), &entry) && !entry.exists) {
+    return false;
+  }
+
   if (!dir_resolve(resolved, archive, path) || !fs_open(resolved, OPEN_READ, &file)) {
     return false;
   }
@@ -463,14 +748,14 @@ static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* b
     }
   }
 
-  if ((*data = malloc(bytes)) == NULL) {
+  if ((*data = alloc(NULL, bytes)) == NULL) {
     fs_close(file);
     return true;
   }
 
   if (!fs_read(file, *data, &bytes)) {
     fs_close(file);
-    free(*data);
+    alloc(*data, 0);
     *data = NULL;
     return true;
   }
@@ -481,6 +766,9 @@ static bool dir_read(Archive* archive, const char* path, size_t bytes, size_t* b
 }
 
 static void dir_close(Archive* archive) {
+  if (archive->watcher) fs_unwatch(archive->watcher);
+  arr_free(&archive->entries);
+  map_free(&archive->lookup);
   arr_free(&archive->strings);
 }
 
@@ -490,6 +778,9 @@ static bool dir_init(Archive* archive, const char* path, const char* mountpoint,
     return false;
   }
 
+  arr_init(&archive->entries, realloc);
+  map_init(&archive->lookup, 0);
+  archive->watcher = NULL;
   archive->stat = dir_stat;
   archive->list = dir_list;
   archive->read = dir_read;
@@ -544,8 +835,81 @@ static void zip_list(Archive* archive, const char* path, fs_list_cb callback, vo
   }
 }
 
-static bool zip_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** dst) {
-  const zip_node* node = zip_lookup(archive, path);
+// Cache
+
+static void lock(void) {
+  while (atomic_flag_test_and_set_explicit(&state.cacheLock, memory_order_acquire));
+}
+
+static void unlock(void) {
+  atomic_flag_clear_explicit(&state.cacheLock, memory_order_release);
+}
+
+static void zip_unlink(Archive* archive, zip_node* node) {
+  if (node->newer == ~0u) archive->newest = node->older;
+  else archive->nodes.data[node->newer].older = node->older;
+  if (node->older == ~0u) archive->oldest = node->newer;
+  else archive->nodes.data[node->older].newer = node->newer;
+}
+
+static void zip_link(Archive* archive, zip_node* node) {
+  uint32_t index = (uint32_t) (node - archive->nodes.data);
+  node->newer = ~0u;
+  node->older = archive->newest;
+  if (archive->newest == ~0u) archive->oldest = index;
+  else archive->nodes.data[archive->newest].newer = index;
+  archive->newest = index;
+}
+
+static void zip_evict(Archive* archive, size_t limit) {
+  lock();
+  while (archive->cacheSize > limit && archive->oldest != ~0u) {
+    zip_node* node = &archive->nodes.data[archive->oldest];
+    zip_unlink(archive, node);
+    archive->cacheSize -= node->info.size;
+    free(node->cache);
+    node->cache = NULL;
+  }
+  unlock();
+}
+
+// Takes ownership of the data
+static void zip_cache(Archive* archive, zip_node* node, void* data, size_t size) {
+  if (size > state.cacheLimit) {
+    free(data);
+    return;
+  }
+
+  lock();
+  if (node->cache) {
+    unlock();
+    free(data);
+    return;
+  }
+  node->cache = data;
+  archive->cacheSize += size;
+  zip_link(archive, node);
+  unlock();
+
+  zip_evict(archive, state.cacheLimit);
+}
+
+// Copies a cached file and marks it as the most recently used
+static bool zip_uncache(Archive* archive, zip_node* node, void* data, size_t size) {
+  lock();
+  if (!node->cache) {
+    unlock();
+    return false;
+  }
+  memcpy(data, node->cache, size);
+  zip_unlink(archive, node);
+  zip_link(archive, node);
+  unlock();
+  return true;
+}
+
+static bool zip_read(Archive* archive, const char* path, size_t bytes, size_t* bytesRead, void** dst, arr_allocator* alloc) {
+  zip_node* node = zip_lookup(archive, path);
   if (!node) return false;
 
   // Directories can't be read (but still return true because the file was present in the archive)
@@ -556,25 +920,34 @@ static bool zip_read(Archive* archive, const char* path, size_t bytes, size_t* b
 
   size_t dstSize = node->info.size;
   size_t srcSize = node->csize;
-  bool compressed;
+  uint16_t method;
   const void* src;
 
-  if ((src = zip_load(&archive->zip, node->offset, &compressed)) == NULL) {
+  if ((src = zip_load(&archive->zip, node->offset, &method)) == NULL) {
     *dst = NULL;
     return true;
   }
 
-  if ((*dst = malloc(dstSize)) == NULL) {
+  if ((*dst = alloc(NULL, dstSize)) == NULL) {
     return true;
   }
 
   *bytesRead = (bytes == (size_t) -1 || bytes > dstSize) ? (uint32_t) dstSize : bytes;
 
-  if (compressed) {
-    srcSize += 4; // pad buffer to fix an stb_image "bug"
-    if (stbi_zlib_decode_noheader_buffer(*dst, (int) dstSize, src, (int) srcSize) < 0) {
-      free(*dst);
+  if (method != ZIP_STORE) {
+    if (zip_uncache(archive, node, *dst, dstSize)) {
+      return true;
+    }
+
+    if (!zip_decompress(method, *dst, dstSize, src, srcSize)) {
+      alloc(*dst, 0);
       *dst = NULL;
+    } else if (state.cacheLimit >= dstSize) {
+      void* copy = malloc(dstSize);
+      if (copy) {
+        memcpy(copy, *dst, dstSize);
+        zip_cache(archive, node, copy, dstSize);
+      }
     }
   } else {
     memcpy(*dst, src, *bytesRead);
@@ -584,6 +957,7 @@ static bool zip_read(Archive* archive, const char* path, size_t bytes, size_t* b
 }
 
 static void zip_close(Archive* archive) {
+  zip_evict(archive, 0);
   arr_free(&archive->nodes);
   map_free(&archive->lookup);
   arr_free(&archive->strings);
@@ -594,6 +968,9 @@ static bool zip_init(Archive* archive, const char* filename, const char* mountpo
   char path[LOVR_PATH_MAX];
   memset(&archive->lookup, 0, sizeof(archive->lookup));
   arr_init(&archive->nodes, realloc);
+  archive->cacheSize = 0;
+  archive->newest = ~0u;
+  archive->oldest = ~0u;
 
   // mmap the zip file, try to parse it, and figure out how many files there are
   archive->zip.data = fs_map(filename, &archive->zip.size);
@@ -643,7 +1020,9 @@ static bool zip_init(Archive* archive, const char* filename, const char* mountpo
       .mtime = info.mtime,
       .info.size = info.size,
       .info.lastModified = ~0ull,
-      .info.type = FILE_REGULAR
+      .info.type = FILE_REGULAR,
+      .newer = ~0u,
+      .older = ~0u
     };
 
     // Filenames that end in slashes are directories
@@ -24,6 +24,8 @@ bool lovrFilesystemIsDirectory(const char* path);
 uint64_t lovrFilesystemGetSize(const char* path);
 uint64_t lovrFilesystemGetLastModified(const char* path);
 void* lovrFilesystemRead(const char* path, size_t bytes, size_t* bytesRead);
+void* lovrFilesystemReadTemp(const char* path, size_t bytes, size_t* bytesRead);
+void* lovrFilesystemMap(const char* path, size_t* size);
 void lovrFilesystemGetDirectoryItems(const char* path, void (*callback)(void* context, const char* path), void* context);
 const char* lovrFilesystemGetIdentity(void);
 bool lovrFilesystemSetIdentity(const char* identity, bool precedence);
@@ -31,9 +33,16 @@ const char* lovrFilesystemGetSaveDirectory(void);
 bool lovrFilesystemCreateDirectory(const char* path);
 bool lovrFilesystemRemove(const char* path);
 size_t lovrFilesystemWrite(const char* path, const char* content, size_t size, bool append);
+void lovrFilesystemRefresh(const char* path);
+bool lovrFilesystemWatch(void);
+void lovrFilesystemUnwatch(void);
+void lovrFilesystemPollChanges(void (*callback)(void* context, const char* path), void* context);
 size_t lovrFilesystemGetAppdataDirectory(char* buffer, size_t size);
 size_t lovrFilesystemGetExecutablePath(char* buffer, size_t size);
 size_t lovrFilesystemGetUserDirectory(char* buffer, size_t size);
 size_t lovrFilesystemGetWorkingDirectory(char* buffer, size_t size);
 const char* lovrFilesystemGetRequirePath(void);
 void lovrFilesystemSetRequirePath(const char* requirePath);
+size_t lovrFilesystemGetCacheLimit(void);
+void lovrFilesystemSetCacheLimit(size_t limit);
+void lovrFilesystemPreload(const char** paths, uint32_t count);
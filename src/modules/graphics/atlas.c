@@ -0,0 +1,185 @@
+#include "graphics/atlas.h"
+#include "graphics/texture.h"
+#include "data/image.h"
+#include "core/util.h"
+#include <stdlib.h>
+#include <string.h>
+
+// An Atlas packs small Images into one Texture so draws using different sprites can share a
+// Material (and a batch).  Each layer is packed with a skyline: a list of horizontal segments
+// marking the top of the occupied space, where new rectangles go at the lowest fitting spot.
+// With more than one layer the Texture is an array texture, and sprites also have a layer index.
+
+typedef struct {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+} SkylineNode;
+
+typedef arr_t(SkylineNode) arr_skyline_t;
+
+struct Atlas {
+  uint32_t ref;
+  Texture* texture;
+  uint32_t width;
+  uint32_t height;
+  uint32_t layerCount;
+  uint32_t padding;
+  arr_skyline_t* skylines;
+};
+
+Atlas* lovrAtlasCreate(uint32_t width, uint32_t height, uint32_t layers, uint32_t padding, bool srgb) {
+  lovrAssert(width > 0 && height > 0 && layers > 0, "Atlas dimensions must be positive");
+  Atlas* atlas = calloc(1, sizeof(Atlas));
+  lovrAssert(atlas, "Out of memory");
+  atlas->ref = LOVR_REF_LOCAL | 1;
+  atlas->width = width;
+  atlas->height = height;
+  atlas->layerCount = layers;
+  atlas->padding = padding;
+  atlas->skylines = malloc(layers * sizeof(arr_skyline_t));
+  lovrAssert(atlas->skylines, "Out of memory");
+
+  for (uint32_t i = 0; i < layers; i++) {
+    arr_init(&atlas->skylines[i], realloc);
+    arr_push(&atlas->skylines[i], ((SkylineNode) { 0, 0, width }));
+  }
+
+  // Clear the layers so padding doesn't bleed garbage into filtered samples
+  Image* image = lovrImageCreate(width, height, NULL, 0x0, FORMAT_RGBA);
+  atlas->texture = lovrTextureCreate(layers > 1 ? TEXTURE_ARRAY : TEXTURE_2D, NULL, 0, srgb, false, 0);
+  lovrTextureAllocate(atlas->texture, width, height, layers, FORMAT_RGBA);
+  lovrTextureSetFilter(atlas->texture, (TextureFilter) { .mode = FILTER_BILINEAR });
+  lovrTextureSetWrap(atlas->texture, (TextureWrap) { .s = WRAP_CLAMP, .t = WRAP_CLAMP, .r = WRAP_CLAMP });
+  for (uint32_t i = 0; i < layers; i++) {
+    lovrTextureReplacePixels(atlas->texture, image, 0, 0, i, 0);
+  }
+  lovrRelease(image, lovrImageDestroy);
+
+  return atlas;
+}
+
+void lovrAtlasDestroy(void* ref) {
+  Atlas* atlas = ref;
+  for (uint32_t i = 0; i < atlas->layerCount; i++) {
+    arr_free(&atlas->skylines[i]);
+  }
+  free(atlas->skylines);
+  lovrRelease(atlas->texture, lovrTextureDestroy);
+  free(atlas);
+}
+
+// Returns the y coordinate a rectangle starting at node index would sit at, or ~0u if it won't fit
+static uint32_t fitSkyline(Atlas* atlas, arr_skyline_t* skyline, size_t index, uint32_t width, uint32_t height) {
+  uint32_t x = skyline->data[index].x;
+  if (x + width > atlas->width) {
+    return ~0u;
+  }
+
+  uint32_t y = 0;
+  uint32_t remaining = width;
+  for (size_t i = index; remaining > 0; i++) {
+    y = MAX(y, skyline->data[i].y);
+    if (y + height > atlas->height) {
+      return ~0u;
+    }
+    remaining -= MIN(remaining, skyline->data[i].width);
+  }
+
+  return y;
+}
+
+static void insertSkyline(arr_skyline_t* skyline, size_t index, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  arr_reserve(skyline, skyline->length + 1);
+  memmove(skyline->data + index + 1, skyline->data + index, (skyline->length - index) * sizeof(SkylineNode));
+  skyline->data[index] = (SkylineNode) { x, y + height, width };
+  skyline->length++;
+
+  // Trim or remove the nodes now covered by the new one
+  uint32_t right = x + width;
+  for (size_t i = index + 1; i < skyline->length;) {
+    SkylineNode* node = &skyline->data[i];
+    if (node->x >= right) {
+      break;
+    }
+
+    uint32_t shrink = right - node->x;
+    if (shrink >= node->width) {
+      arr_splice(skyline, i, 1);
+    } else {
+      node->x += shrink;
+      node->width -= shrink;
+      break;
+    }
+  }
+
+  // Merge neighbors at the same height
+  for (size_t i = 0; i + 1 < skyline->length;) {
+    if (skyline->data[i].y == skyline->data[i + 1].y) {
+      skyline->data[i].width += skyline->data[i + 1].width;
+      arr_splice(skyline, i + 1, 1);
+    } else {
+      i++;
+    }
+  }
+}
+
+// Packs an Image into the first layer it fits in, writing its uv rectangle (x, y, width, height,
+// normalized) and layer.  Returns false if it doesn't fit anywhere.
+bool lovrAtlasAdd(Atlas* atlas, Image* image, float uv[4], uint32_t* layer) {
+  lovrAssert(image->format == FORMAT_RGBA || image->format == FORMAT_RGB, "Only rgb and rgba Images can be added to an Atlas");
+  uint32_t width = image->width + 2 * atlas->padding;
+  uint32_t height = image->height + 2 * atlas->padding;
+
+  for (uint32_t l = 0; l < atlas->layerCount; l++) {
+    arr_skyline_t* skyline = &atlas->skylines[l];
+    size_t best = SIZE_MAX;
+    uint32_t bestY = ~0u;
+    uint32_t bestWidth = ~0u;
+
+    for (size_t i = 0; i < skyline->length; i++) {
+      uint32_t y = fitSkyline(atlas, skyline, i, width, height);
+      if (y != ~0u && (y + height < bestY || (y + height == bestY && skyline->data[i].width < bestWidth))) {
+        best = i;
+        bestY = y + height;
+        bestWidth = skyline->data[i].width;
+      }
+    }
+
+    if (best == SIZE_MAX) {
+      continue;
+    }
+
+    uint32_t x = skyline->data[best].x;
+    uint32_t y = bestY - height;
+    insertSkyline(skyline, best, x, y, width, height);
+
+    Image* pixels = image;
+    if (image->format == FORMAT_RGB) {
+      pixels = lovrImageConvert(image, FORMAT_RGBA);
+    }
+
+    lovrTextureReplacePixels(atlas->texture, pixels, x + atlas->padding, y + atlas->padding, l, 0);
+
+    if (pixels != image) {
+      lovrRelease(pixels, lovrImageDestroy);
+    }
+
+    uv[0] = (float) (x + atlas->padding) / atlas->width;
+    uv[1] = (float) (y + atlas->padding) / atlas->height;
+    uv[2] = (float) image->width / atlas->width;
+    uv[3] = (float) image->height / atlas->height;
+    *layer = l;
+    return true;
+  }
+
+  return false;
+}
+
+Texture* lovrAtlasGetTexture(Atlas* atlas) {
+  return atlas->texture;
+}
+
+uint32_t lovrAtlasGetLayerCount(Atlas* atlas) {
+  return atlas->layerCount;
+}
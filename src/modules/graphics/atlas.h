@@ -0,0 +1,14 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+struct Image;
+struct Texture;
+
+typedef struct Atlas Atlas;
+Atlas* lovrAtlasCreate(uint32_t width, uint32_t height, uint32_t layers, uint32_t padding, bool srgb);
+void lovrAtlasDestroy(void* ref);
+bool lovrAtlasAdd(Atlas* atlas, struct Image* image, float uv[4], uint32_t* layer);
+struct Texture* lovrAtlasGetTexture(Atlas* atlas);
+uint32_t lovrAtlasGetLayerCount(Atlas* atlas);
@@ -9,6 +9,7 @@ typedef enum {
   BUFFER_UNIFORM,
   BUFFER_SHADER_STORAGE,
   BUFFER_GENERIC,
+  BUFFER_INDIRECT,
   MAX_BUFFER_TYPES
 } BufferType;
 
@@ -20,6 +21,7 @@ typedef enum {
 
 typedef struct Buffer Buffer;
 Buffer* lovrBufferCreate(size_t size, void* data, BufferType type, BufferUsage usage, bool readable);
+Buffer* lovrBufferCreatePersistent(size_t size, BufferType type);
 void lovrBufferDestroy(void* ref);
 size_t lovrBufferGetSize(Buffer* buffer);
 bool lovrBufferIsReadable(Buffer* buffer);
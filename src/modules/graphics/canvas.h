@@ -4,6 +4,8 @@
 
 #define MAX_CANVAS_ATTACHMENTS 4
 
+struct Blob;
+struct Buffer;
 struct Image;
 struct Texture;
 
@@ -39,4 +41,13 @@ void lovrCanvasSetWidth(Canvas* canvas, uint32_t width);
 void lovrCanvasSetHeight(Canvas* canvas, uint32_t height);
 uint32_t lovrCanvasGetMSAA(Canvas* canvas);
 struct Texture* lovrCanvasGetDepthTexture(Canvas* canvas);
+void lovrCanvasSetDepthTexture(Canvas* canvas, struct Texture* texture);
 struct Image* lovrCanvasNewImage(Canvas* canvas, uint32_t index);
+
+typedef struct Readback Readback;
+Readback* lovrReadbackCreate(Canvas* canvas, uint32_t index);
+Readback* lovrReadbackCreateBuffer(struct Buffer* buffer, size_t offset, size_t size);
+void lovrReadbackDestroy(void* ref);
+bool lovrReadbackIsReady(Readback* readback);
+struct Image* lovrReadbackGetImage(Readback* readback);
+struct Blob* lovrReadbackGetBlob(Readback* readback);
@@ -2,7 +2,11 @@
 #include "graphics/texture.h"
 #include "data/rasterizer.h"
 #include "data/image.h"
+#include "data/blob.h"
 #include "core/map.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
 #include <string.h>
 #include <stdlib.h>
 
@@ -13,7 +17,9 @@ typedef struct {
   uint32_t height;
   uint32_t rowHeight;
   uint32_t padding;
+  size_t pending;
   arr_t(Glyph) glyphs;
+  arr_t(uint32_t) codepoints;
   map_t glyphMap;
 } FontAtlas;
 
@@ -21,6 +27,7 @@ struct Font {
   uint32_t ref;
   Rasterizer* rasterizer;
   Texture* texture;
+  TextureFormat format;
   FontAtlas atlas;
   map_t kerning;
   double spread;
@@ -28,36 +35,58 @@ struct Font {
   float lineHeight;
   float pixelDensity;
   bool flip;
+  uint32_t version;
 };
 
-static float* lovrFontAlignLine(float* x, float* lineEnd, float width, HorizontalAlign halign) {
-  while (x < lineEnd) {
+// Text caches the layout of a string.  Anything that moves glyphs around (repacking the atlas,
+// changing the line height, etc.) bumps the Font's version, which makes Text lay itself out again.
+struct Text {
+  uint32_t ref;
+  Font* font;
+  char* string;
+  size_t length;
+  float wrap;
+  HorizontalAlign halign;
+  GlyphVertex* vertices;
+  uint32_t* indices;
+  uint32_t glyphCount;
+  uint32_t capacity;
+  float height;
+  uint32_t version;
+  bool dirty;
+};
+
+static GlyphVertex* lovrFontAlignLine(GlyphVertex* vertex, GlyphVertex* lineEnd, float width, HorizontalAlign halign) {
+  while (vertex < lineEnd) {
     if (halign == ALIGN_CENTER) {
-      *x -= width / 2.f;
+      vertex->x -= width / 2.f;
     } else if (halign == ALIGN_RIGHT) {
-      *x -= width;
+      vertex->x -= width;
     }
 
-    x += 8;
+    vertex++;
   }
 
-  return x;
+  return vertex;
 }
 
 static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint);
+static Glyph* lovrFontInsertGlyph(Font* font, uint32_t codepoint, Glyph* glyph);
 static void lovrFontAddGlyph(Font* font, Glyph* glyph);
 static void lovrFontExpandTexture(Font* font);
-static void lovrFontCreateTexture(Font* font);
+static Texture* lovrFontCreateTexture(Font* font);
 
-Font* lovrFontCreate(Rasterizer* rasterizer, uint32_t padding, double spread) {
+Font* lovrFontCreate(Rasterizer* rasterizer, uint32_t padding, double spread, TextureFormat format) {
+  lovrAssert(format == FORMAT_RGBA || format == FORMAT_RGBA16F || format == FORMAT_RGBA32F, "Font atlas format must be rgba, rgba16f, or rgba32f");
   Font* font = calloc(1, sizeof(Font));
   lovrAssert(font, "Out of memory");
-  font->ref = 1;
+  font->ref = LOVR_REF_LOCAL | 1;
 
   lovrRetain(rasterizer);
   font->rasterizer = rasterizer;
   font->padding = padding;
   font->spread = spread;
+  font->format = format;
   font->lineHeight = 1.f;
   font->pixelDensity = (float) lovrRasterizerGetHeight(rasterizer);
   map_init(&font->kerning, 0);
@@ -72,6 +101,7 @@ Font* lovrFontCreate(Rasterizer* rasterizer, uint32_t padding, double spread) {
   font->atlas.height = 256;
   font->atlas.padding = atlasPadding;
   arr_init(&font->atlas.glyphs, realloc);
+  arr_init(&font->atlas.codepoints, realloc);
   map_init(&font->atlas.glyphMap, 0);
 
   // Set initial atlas size
@@ -80,7 +110,7 @@ Font* lovrFontCreate(Rasterizer* rasterizer, uint32_t padding, double spread) {
   }
 
   // Create the texture
-  lovrFontCreateTexture(font);
+  font->texture = lovrFontCreateTexture(font);
 
   return font;
 }
@@ -93,6 +123,7 @@ void lovrFontDestroy(void* ref) {
     lovrRelease(font->atlas.glyphs.data[i].data, lovrImageDestroy);
   }
   arr_free(&font->atlas.glyphs);
+  arr_free(&font->atlas.codepoints);
   map_free(&font->atlas.glyphMap);
   map_free(&font->kerning);
   free(font);
@@ -106,7 +137,7 @@ Texture* lovrFontGetTexture(Font* font) {
   return font->texture;
 }
 
-void lovrFontRender(Font* font, const char* str, size_t length, float wrap, HorizontalAlign halign, float* vertices, uint16_t* indices, uint16_t baseVertex) {
+void lovrFontRender(Font* font, const char* str, size_t length, float wrap, HorizontalAlign halign, GlyphVertex* vertices, uint32_t* indices, uint32_t baseVertex) {
   FontAtlas* atlas = &font->atlas;
   bool flip = font->flip;
 
@@ -124,10 +155,10 @@ void lovrFontRender(Font* font, const char* str, size_t length, float wrap, Hori
   unsigned int codepoint;
   size_t bytes;
 
-  float* vertexCursor = vertices;
-  uint16_t* indexCursor = indices;
-  float* lineStart = vertices;
-  uint16_t I = baseVertex;
+  GlyphVertex* vertexCursor = vertices;
+  uint32_t* indexCursor = indices;
+  GlyphVertex* lineStart = vertices;
+  uint32_t I = baseVertex;
 
   while ((bytes = utf8_decode(str, end, &codepoint)) > 0) {
 
@@ -171,21 +202,19 @@ void lovrFontRender(Font* font, const char* str, size_t length, float wrap, Hori
       float y1 = cy + (glyph->dy + padding) * (flip ? -1.f : 1.f);
       float x2 = x1 + glyph->tw;
       float y2 = y1 - glyph->th * (flip ? -1.f : 1.f);
-      float s1 = glyph->x / u;
-      float t1 = (glyph->y + glyph->th) / v;
-      float s2 = (glyph->x + glyph->tw) / u;
-      float t2 = glyph->y / v;
+      uint16_t s1 = (uint16_t) (glyph->x / u * 65535.f + .5f);
+      uint16_t t1 = (uint16_t) ((glyph->y + glyph->th) / v * 65535.f + .5f);
+      uint16_t s2 = (uint16_t) ((glyph->x + glyph->tw) / u * 65535.f + .5f);
+      uint16_t t2 = (uint16_t) (glyph->y / v * 65535.f + .5f);
 
-      memcpy(vertexCursor, (float[32]) {
-        x1, y1, 0.f, 0.f, 0.f, 0.f, s1, t1,
-        x1, y2, 0.f, 0.f, 0.f, 0.f, s1, t2,
-        x2, y1, 0.f, 0.f, 0.f, 0.f, s2, t1,
-        x2, y2, 0.f, 0.f, 0.f, 0.f, s2, t2
-      }, 32 * sizeof(float));
+      vertexCursor[0] = (GlyphVertex) { x1, y1, s1, t1, 0, { 0 } };
+      vertexCursor[1] = (GlyphVertex) { x1, y2, s1, t2, 0, { 0 } };
+      vertexCursor[2] = (GlyphVertex) { x2, y1, s2, t1, 0, { 0 } };
+      vertexCursor[3] = (GlyphVertex) { x2, y2, s2, t2, 0, { 0 } };
 
-      memcpy(indexCursor, (uint16_t[6]) { I + 0, I + 1, I + 2, I + 2, I + 1, I + 3 }, 6 * sizeof(uint16_t));
+      memcpy(indexCursor, (uint32_t[6]) { I + 0, I + 1, I + 2, I + 2, I + 1, I + 3 }, 6 * sizeof(uint32_t));
 
-      vertexCursor += 32;
+      vertexCursor += 4;
       indexCursor += 6;
       I += 4;
     }
@@ -236,6 +265,7 @@ float lovrFontGetLineHeight(Font* font) {
 
 void lovrFontSetLineHeight(Font* font, float lineHeight) {
   font->lineHeight = lineHeight;
+  font->version++;
 }
 
 bool lovrFontIsFlipEnabled(Font* font) {
@@ -244,6 +274,7 @@ bool lovrFontIsFlipEnabled(Font* font) {
 
 void lovrFontSetFlipEnabled(Font* font, bool flip) {
   font->flip = flip;
+  font->version++;
 }
 
 int32_t lovrFontGetKerning(Font* font, uint32_t left, uint32_t right) {
@@ -269,6 +300,78 @@ void lovrFontSetPixelDensity(Font* font, float pixelDensity) {
   }
 
   font->pixelDensity = pixelDensity;
+  font->version++;
+}
+
+typedef struct {
+  Font* font;
+  uint32_t codepoint;
+  Glyph glyph;
+} GlyphJob;
+
+static void loadGlyph(void* arg) {
+  GlyphJob* job = arg;
+  lovrRasterizerLoadGlyph(job->font->rasterizer, job->codepoint, job->font->padding, job->font->spread, &job->glyph);
+}
+
+// Generating the MSDF for a glyph is by far the slowest part of adding it, so preloading renders
+// all of the missing glyphs in a string up front, on the thread pool when it's running.
+void lovrFontPreload(Font* font, const char* str, size_t length) {
+  FontAtlas* atlas = &font->atlas;
+  temp_mark_t mark = temp_mark();
+  arr_t(GlyphJob) jobs;
+  arr_init(&jobs, temp_realloc);
+  map_t seen = { 0 };
+
+  const char* end = str + length;
+  unsigned int codepoint;
+  size_t bytes;
+  while ((bytes = utf8_decode(str, end, &codepoint)) > 0) {
+    str += bytes;
+    uint64_t hash = hash64(&codepoint, sizeof(codepoint));
+    if (codepoint == '\n' || map_get(&atlas->glyphMap, hash) != MAP_NIL) {
+      continue;
+    }
+
+    // This is usually called with strings that are already loaded, so avoid allocating until needed
+    if (!seen.hashes) {
+      map_init(&seen, 0);
+    } else if (map_get(&seen, hash) != MAP_NIL) {
+      continue;
+    }
+
+    if (lovrRasterizerHasGlyph(font->rasterizer, codepoint)) {
+      map_set(&seen, hash, 1);
+      arr_push(&jobs, ((GlyphJob) { .font = font, .codepoint = codepoint }));
+    }
+  }
+
+  if (jobs.length == 0) {
+    map_free(&seen);
+    temp_rewind(mark);
+    return;
+  }
+
+  void** args = temp_alloc(jobs.length * sizeof(void*));
+  for (size_t i = 0; i < jobs.length; i++) {
+    args[i] = &jobs.data[i];
+  }
+
+#ifndef LOVR_DISABLE_THREAD
+  lovrThreadPoolRun(loadGlyph, args, (uint32_t) jobs.length);
+#else
+  for (size_t i = 0; i < jobs.length; i++) {
+    loadGlyph(args[i]);
+  }
+#endif
+
+  arr_reserve(&atlas->glyphs, atlas->glyphs.length + jobs.length);
+  for (size_t i = 0; i < jobs.length; i++) {
+    lovrFontInsertGlyph(font, jobs.data[i].codepoint, &jobs.data[i].glyph);
+  }
+
+  map_free(&seen);
+  temp_rewind(mark);
 }
 
 static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint) {
@@ -278,16 +381,141 @@ static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint) {
 
   // Add the glyph to the atlas if it isn't there
   if (index == MAP_NIL) {
-    index = atlas->glyphs.length;
-    arr_reserve(&atlas->glyphs, atlas->glyphs.length + 1);
-    lovrRasterizerLoadGlyph(font->rasterizer, codepoint, font->padding, font->spread, &atlas->glyphs.data[atlas->glyphs.length++]);
-    map_set(&atlas->glyphMap, hash, index);
-    lovrFontAddGlyph(font, &atlas->glyphs.data[index]);
+    Glyph glyph;
+    lovrRasterizerLoadGlyph(font->rasterizer, codepoint, font->padding, font->spread, &glyph);
+    return lovrFontInsertGlyph(font, codepoint, &glyph);
   }
 
   return &atlas->glyphs.data[index];
 }
 
+static Glyph* lovrFontInsertGlyph(Font* font, uint32_t codepoint, Glyph* glyph) {
+  FontAtlas* atlas = &font->atlas;
+  uint64_t hash = hash64(&codepoint, sizeof(codepoint));
+  uint64_t index = atlas->glyphs.length;
+  arr_push(&atlas->glyphs, *glyph);
+  arr_push(&atlas->codepoints, codepoint);
+  map_set(&atlas->glyphMap, hash, index);
+  lovrFontAddGlyph(font, &atlas->glyphs.data[index]);
+  return &atlas->glyphs.data[index];
+}
+
+// The cache stores the metrics and SDF pixels (as half floats) of every glyph in the atlas.  It's
+// keyed by everything that affects the output of the rasterizer so a stale cache is never used.
+#define FONT_CACHE_MAGIC 0x31434656 // "VFC1"
+
+typedef struct {
+  uint32_t magic;
+  uint32_t glyphCount;
+  uint64_t key;
+} FontCacheHeader;
+
+typedef struct {
+  uint32_t codepoint;
+  uint32_t w, h, tw, th;
+  int32_t dx, dy, advance;
+} FontCacheGlyph;
+
+static uint64_t lovrFontGetCacheKey(Font* font) {
+  struct { uint64_t hash; float size; uint32_t padding; double spread; } key;
+  memset(&key, 0, sizeof(key));
+  key.hash = lovrRasterizerGetHash(font->rasterizer);
+  key.size = lovrRasterizerGetSize(font->rasterizer);
+  key.padding = font->padding;
+  key.spread = font->spread;
+  return hash64(&key, sizeof(key));
+}
+
+Blob* lovrFontGetCache(Font* font) {
+  FontAtlas* atlas = &font->atlas;
+  size_t size = sizeof(FontCacheHeader);
+  for (size_t i = 0; i < atlas->glyphs.length; i++) {
+    Glyph* glyph = &atlas->glyphs.data[i];
+    size += sizeof(FontCacheGlyph) + glyph->tw * glyph->th * 4 * sizeof(uint16_t);
+  }
+
+  uint8_t* data = malloc(size);
+  lovrAssert(data, "Out of memory");
+  uint8_t* cursor = data;
+
+  FontCacheHeader header = { FONT_CACHE_MAGIC, (uint32_t) atlas->glyphs.length, lovrFontGetCacheKey(font) };
+  memcpy(cursor, &header, sizeof(header));
+  cursor += sizeof(header);
+
+  for (size_t i = 0; i < atlas->glyphs.length; i++) {
+    Glyph* glyph = &atlas->glyphs.data[i];
+    FontCacheGlyph entry = {
+      atlas->codepoints.data[i],
+      glyph->w, glyph->h, glyph->tw, glyph->th,
+      glyph->dx, glyph->dy, glyph->advance
+    };
+    memcpy(cursor, &entry, sizeof(entry));
+    cursor += sizeof(entry);
+
+    Image* pixels = lovrImageConvert(glyph->data, FORMAT_RGBA16F);
+    memcpy(cursor, pixels->blob->data, pixels->blob->size);
+    cursor += pixels->blob->size;
+    lovrRelease(pixels, lovrImageDestroy);
+  }
+
+  return lovrBlobCreate(data, size, "Font cache");
+}
+
+// Returns false if the cache was made for a different font, size, padding, or spread
+bool lovrFontLoadCache(Font* font, Blob* blob) {
+  FontAtlas* atlas = &font->atlas;
+  const uint8_t* cursor = blob->data;
+  const uint8_t* end = cursor + blob->size;
+
+  FontCacheHeader header;
+  if (blob->size < sizeof(header)) {
+    return false;
+  }
+
+  memcpy(&header, cursor, sizeof(header));
+  cursor += sizeof(header);
+  if (header.magic != FONT_CACHE_MAGIC || header.key != lovrFontGetCacheKey(font)) {
+    return false;
+  }
+
+  arr_reserve(&atlas->glyphs, atlas->glyphs.length + header.glyphCount);
+  for (uint32_t i = 0; i < header.glyphCount; i++) {
+    FontCacheGlyph entry;
+    lovrAssert(cursor + sizeof(entry) <= end, "Font cache is truncated");
+    memcpy(&entry, cursor, sizeof(entry));
+    cursor += sizeof(entry);
+
+    size_t size = (size_t) entry.tw * entry.th * 4 * sizeof(uint16_t);
+    lovrAssert(cursor + size <= end, "Font cache is truncated");
+
+    uint64_t hash = hash64(&entry.codepoint, sizeof(entry.codepoint));
+    if (map_get(&atlas->glyphMap, hash) != MAP_NIL) {
+      cursor += size;
+      continue;
+    }
+
+    Image* half = lovrImageCreate(entry.tw, entry.th, NULL, 0x0, FORMAT_RGBA16F);
+    memcpy(half->blob->data, cursor, size);
+    cursor += size;
+
+    Glyph glyph = {
+      .w = entry.w,
+      .h = entry.h,
+      .tw = entry.tw,
+      .th = entry.th,
+      .dx = entry.dx,
+      .dy = entry.dy,
+      .advance = entry.advance,
+      .data = lovrImageConvert(half, FORMAT_RGBA32F)
+    };
+
+    lovrRelease(half, lovrImageDestroy);
+    lovrFontInsertGlyph(font, entry.codepoint, &glyph);
+  }
+
+  return true;
+}
+
 static void lovrFontAddGlyph(Font* font, Glyph* glyph) {
   FontAtlas* atlas = &font->atlas;
 
@@ -296,33 +524,114 @@ static void lovrFontAddGlyph(Font* font, Glyph* glyph) {
     return;
   }
 
-  // If the glyph does not fit, you must acquit (new row)
-  if (atlas->x + glyph->tw > atlas->width - 2 * atlas->padding) {
-    atlas->x = atlas->padding;
-    atlas->y += atlas->rowHeight + atlas->padding;
-    atlas->rowHeight = 0;
-  }
+  for (;;) {
 
-  // Expand the texture if needed. Expanding the texture re-adds all the glyphs, so we can return.
-  if (atlas->y + glyph->th > atlas->height - 2 * atlas->padding) {
-    lovrFontExpandTexture(font);
-    return;
+    // If the glyph does not fit, you must acquit (new row)
+    if (atlas->x + glyph->tw > atlas->width - 2 * atlas->padding) {
+      atlas->x = atlas->padding;
+      atlas->y += atlas->rowHeight + atlas->padding;
+      atlas->rowHeight = 0;
+    }
+
+    // Expand the texture if needed. Glyphs keep their positions when the atlas grows, so try again.
+    if (atlas->y + glyph->th > atlas->height - 2 * atlas->padding) {
+      lovrFontExpandTexture(font);
+      continue;
+    }
+
+    break;
   }
 
-  // Keep track of glyph's position in the atlas
+  // Keep track of glyph's position in the atlas.  Its pixels are uploaded by lovrFontFlush.
   glyph->x = atlas->x;
   glyph->y = atlas->y;
 
-  // Paste glyph into texture
-  lovrTextureReplacePixels(font->texture, glyph->data, atlas->x, atlas->y, 0, 0);
-
   // Advance atlas cursor
   atlas->x += glyph->tw + atlas->padding;
   atlas->rowHeight = MAX(atlas->rowHeight, glyph->th);
 }
 
+// Uploads a rectangle of the atlas containing pending glyphs.  The rectangle never overlaps glyphs
+// that were uploaded earlier, and the rest of it is empty space, so it can be written all at once.
+static void lovrFontUploadRegion(Font* font, uint32_t x1, uint32_t y1, uint32_t x2, uint32_t y2, bool row) {
+  FontAtlas* atlas = &font->atlas;
+  uint32_t width = x2 - x1;
+  uint32_t height = y2 - y1;
+  Image* image = lovrImageCreate(width, height, NULL, 0x0, FORMAT_RGBA32F);
+  float* pixels = image->blob->data;
+
+  for (size_t i = atlas->pending; i < atlas->glyphs.length; i++) {
+    Glyph* glyph = &atlas->glyphs.data[i];
+    if ((glyph->w == 0 && glyph->h == 0) || (glyph->y == y1) != row) {
+      continue;
+    }
+
+    float* src = glyph->data->blob->data;
+    float* dst = pixels + ((glyph->y - y1) * width + (glyph->x - x1)) * 4;
+    for (uint32_t y = 0; y < glyph->th; y++) {
+      memcpy(dst, src, glyph->tw * 4 * sizeof(float));
+      src += glyph->tw * 4;
+      dst += width * 4;
+    }
+  }
+
+  // 8 bit atlases need to be converted, float atlases are converted by the driver during upload
+  if (font->format == FORMAT_RGBA) {
+    Image* converted = lovrImageConvert(image, FORMAT_RGBA);
+    lovrRelease(image, lovrImageDestroy);
+    image = converted;
+  }
+
+  lovrTextureReplacePixels(font->texture, image, x1, y1, 0, 0);
+  lovrRelease(image, lovrImageDestroy);
+}
+
+// Glyphs are packed in rows, so the ones added since the last flush cover at most two rectangles:
+// the remainder of the row that was current during the last flush, and all of the rows after it.
+void lovrFontFlush(Font* font) {
+  FontAtlas* atlas = &font->atlas;
+
+  if (!font->texture) {
+    return;
+  }
+
+  bool found = false;
+  uint32_t row = 0;
+  uint32_t a[4] = { UINT32_MAX, UINT32_MAX, 0, 0 };
+  uint32_t b[4] = { UINT32_MAX, UINT32_MAX, 0, 0 };
+  for (size_t i = atlas->pending; i < atlas->glyphs.length; i++) {
+    Glyph* glyph = &atlas->glyphs.data[i];
+    if (glyph->w == 0 && glyph->h == 0) {
+      continue;
+    }
+
+    if (!found) {
+      row = glyph->y;
+      found = true;
+    }
+
+    uint32_t* r = glyph->y == row ? a : b;
+    r[0] = MIN(r[0], glyph->x);
+    r[1] = MIN(r[1], glyph->y);
+    r[2] = MAX(r[2], glyph->x + glyph->tw);
+    r[3] = MAX(r[3], glyph->y + glyph->th);
+  }
+
+  if (found) {
+    lovrFontUploadRegion(font, a[0], a[1], a[2], a[3], true);
+    if (b[2] > 0) {
+      lovrFontUploadRegion(font, b[0], b[1], b[2], b[3], false);
+    }
+  }
+
+  atlas->pending = atlas->glyphs.length;
+}
+
 static void lovrFontExpandTexture(Font* font) {
   FontAtlas* atlas = &font->atlas;
+  uint32_t width = atlas->width;
+  uint32_t height = atlas->height;
+  font->version++;
 
   if (atlas->width == atlas->height) {
     atlas->width *= 2;
@@ -334,27 +643,119 @@ static void lovrFontExpandTexture(Font* font) {
     return;
   }
 
-  // Recreate the texture
-  lovrFontCreateTexture(font);
-
-  // Reset the cursor
-  atlas->x = atlas->padding;
-  atlas->y = atlas->padding;
-  atlas->rowHeight = 0;
-
-  // Re-pack all the glyphs
-  for (size_t i = 0; i < atlas->glyphs.length; i++) {
-    lovrFontAddGlyph(font, &atlas->glyphs.data[i]);
+  // Glyphs stay where they are, so the old atlas is copied into the corner of the new one on the
+  // GPU.  If that isn't supported, every glyph gets uploaded again on the next flush.
+  lovrFontFlush(font);
+  Texture* texture = lovrFontCreateTexture(font);
+  if (!lovrTextureCopy(texture, font->texture, 0, 0, width, height)) {
+    atlas->pending = 0;
   }
+
+  lovrRelease(font->texture, lovrTextureDestroy);
+  font->texture = texture;
 }
 
 // TODO we only need the Image here to clear the texture, but it's a big waste of memory.
 // Could look into using glClearTexImage when supported to make this more efficient.
-static void lovrFontCreateTexture(Font* font) {
-  lovrRelease(font->texture, lovrTextureDestroy);
-  Image* image = lovrImageCreate(font->atlas.width, font->atlas.height, NULL, 0x0, FORMAT_RGBA16F);
-  font->texture = lovrTextureCreate(TEXTURE_2D, &image, 1, false, false, 0);
-  lovrTextureSetFilter(font->texture, (TextureFilter) { .mode = FILTER_BILINEAR });
-  lovrTextureSetWrap(font->texture, (TextureWrap) { .s = WRAP_CLAMP, .t = WRAP_CLAMP });
+static Texture* lovrFontCreateTexture(Font* font) {
+  Image* image = lovrImageCreate(font->atlas.width, font->atlas.height, NULL, 0x0, font->format);
+  Texture* texture = lovrTextureCreate(TEXTURE_2D, &image, 1, false, false, 0);
+  lovrTextureSetFilter(texture, (TextureFilter) { .mode = FILTER_BILINEAR });
+  lovrTextureSetWrap(texture, (TextureWrap) { .s = WRAP_CLAMP, .t = WRAP_CLAMP });
   lovrRelease(image, lovrImageDestroy);
+  return texture;
+}
+
+// Text
+
+Text* lovrTextCreate(Font* font, const char* string, size_t length, float wrap, HorizontalAlign halign) {
+  Text* text = calloc(1, sizeof(Text));
+  lovrAssert(text, "Out of memory");
+  text->ref = LOVR_REF_LOCAL | 1;
+  text->font = font;
+  text->wrap = wrap;
+  text->halign = halign;
+  lovrRetain(font);
+  lovrTextSetString(text, string, length);
+  return text;
+}
+
+void lovrTextDestroy(void* ref) {
+  Text* text = ref;
+  lovrRelease(text->font, lovrFontDestroy);
+  free(text->string);
+  free(text->vertices);
+  free(text->indices);
+  free(text);
+}
+
+Font* lovrTextGetFont(Text* text) {
+  return text->font;
+}
+
+const char* lovrTextGetString(Text* text, size_t* length) {
+  *length = text->length;
+  return text->string;
+}
+
+void lovrTextSetString(Text* text, const char* string, size_t length) {
+  if (text->string && length == text->length && !memcmp(string, text->string, length)) {
+    return;
+  }
+
+  free(text->string);
+  text->string = malloc(length + 1);
+  lovrAssert(text->string, "Out of memory");
+  memcpy(text->string, string, length);
+  text->string[length] = '\0';
+  text->length = length;
+  text->dirty = true;
+}
+
+float lovrTextGetWrap(Text* text) {
+  return text->wrap;
+}
+
+void lovrTextSetWrap(Text* text, float wrap) {
+  text->dirty |= wrap != text->wrap;
+  text->wrap = wrap;
+}
+
+HorizontalAlign lovrTextGetAlign(Text* text) {
+  return text->halign;
+}
+
+void lovrTextSetAlign(Text* text, HorizontalAlign halign) {
+  text->dirty |= halign != text->halign;
+  text->halign = halign;
+}
+
+// Returns the cached vertices (with 0-based indices), laying the text out again if it's stale
+const GlyphVertex* lovrTextGetVertices(Text* text, const uint32_t** indices, uint32_t* glyphCount, float* height) {
+  if (text->dirty || text->version != text->font->version) {
+    lovrFontPreload(text->font, text->string, text->length);
+
+    float width;
+    uint32_t lineCount;
+    lovrFontMeasure(text->font, text->string, text->length, text->wrap, &width, &text->height, &lineCount, &text->glyphCount);
+
+    if (text->glyphCount > text->capacity) {
+      text->capacity = text->glyphCount;
+      text->vertices = realloc(text->vertices, text->capacity * 4 * sizeof(GlyphVertex));
+      text->indices = realloc(text->indices, text->capacity * 6 * sizeof(uint32_t));
+      lovrAssert(text->vertices && text->indices, "Out of memory");
+    }
+
+    if (text->glyphCount > 0) {
+      lovrFontRender(text->font, text->string, text->length, text->wrap, text->halign, text->vertices, text->indices, 0);
+    }
+
+    text->version = text->font->version;
+    text->dirty = false;
+  }
+
+  *indices = text->indices;
+  *glyphCount = text->glyphCount;
+  *height = text->height;
+  return text->vertices;
 }
@@ -1,9 +1,11 @@
+#include "data/image.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
 #pragma once
 
+struct Blob;
 struct Rasterizer;
 struct Texture;
 
@@ -19,12 +21,23 @@ typedef enum {
   ALIGN_BOTTOM
 } VerticalAlign;
 
+typedef struct {
+  float x, y;
+  uint16_t u, v;
+  uint8_t drawId;
+  uint8_t padding[3];
+} GlyphVertex;
+
 typedef struct Font Font;
-Font* lovrFontCreate(struct Rasterizer* rasterizer, uint32_t padding, double spread);
+Font* lovrFontCreate(struct Rasterizer* rasterizer, uint32_t padding, double spread, TextureFormat format);
 void lovrFontDestroy(void* ref);
 struct Rasterizer* lovrFontGetRasterizer(Font* font);
 struct Texture* lovrFontGetTexture(Font* font);
-void lovrFontRender(Font* font, const char* str, size_t length, float wrap, HorizontalAlign halign, float* vertices, uint16_t* indices, uint16_t baseVertex);
+void lovrFontPreload(Font* font, const char* str, size_t length);
+void lovrFontFlush(Font* font);
+struct Blob* lovrFontGetCache(Font* font);
+bool lovrFontLoadCache(Font* font, struct Blob* blob);
+void lovrFontRender(Font* font, const char* str, size_t length, float wrap, HorizontalAlign halign, GlyphVertex* vertices, uint32_t* indices, uint32_t baseVertex);
 void lovrFontMeasure(Font* font, const char* string, size_t length, float wrap, float* width, float* height, uint32_t* lineCount, uint32_t* glyphCount);
 uint32_t lovrFontGetPadding(Font* font);
 double lovrFontGetSpread(Font* font);
@@ -39,3 +52,15 @@ void lovrFontSetFlipEnabled(Font* font, bool flip);
 int32_t lovrFontGetKerning(Font* font, unsigned int a, unsigned int b);
 float lovrFontGetPixelDensity(Font* font);
 void lovrFontSetPixelDensity(Font* font, float pixelDensity);
+
+typedef struct Text Text;
+Text* lovrTextCreate(Font* font, const char* string, size_t length, float wrap, HorizontalAlign halign);
+void lovrTextDestroy(void* ref);
+Font* lovrTextGetFont(Text* text);
+const char* lovrTextGetString(Text* text, size_t* length);
+void lovrTextSetString(Text* text, const char* string, size_t length);
+float lovrTextGetWrap(Text* text);
+void lovrTextSetWrap(Text* text, float wrap);
+HorizontalAlign lovrTextGetAlign(Text* text);
+void lovrTextSetAlign(Text* text, HorizontalAlign halign);
+const GlyphVertex* lovrTextGetVertices(Text* text, const uint32_t** indices, uint32_t* glyphCount, float* height);
@@ -5,29 +5,38 @@
 #include "graphics/mesh.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
+#include "data/blob.h"
+#include "data/image.h"
+#include "data/modelData.h"
 #include "data/rasterizer.h"
 #include "event/event.h"
 #include "math/math.h"
+#include "resources/shaders.h"
+#include "core/fs.h"
 #include "core/maf.h"
 #include "core/os.h"
+#include "core/profile.h"
 #include "core/util.h"
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
 #include <math.h>
 
-#define MAX_TRANSFORMS 64
-#define MAX_BATCHES 4
+#define MAX_TRANSFORMS 256
 #define MAX_DRAWS 256
-
-typedef enum {
-  STREAM_VERTEX,
-  STREAM_DRAWID,
-  STREAM_INDEX,
-  STREAM_MODEL,
-  STREAM_COLOR,
-  STREAM_FRAME,
-  MAX_STREAMS
-} StreamType;
+#define DEFAULT_BATCH_LIMIT 64
+#define MAX_CACHED_GEOMETRY 32
+#define TEXTURE_STREAM_BUDGET (8 << 20)
+#define LIGHT_GRID_X 8
+#define LIGHT_GRID_Y 8
+#define LIGHT_GRID_Z 16
+#define LIGHT_CLUSTERS (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+#define MAX_LIGHT_INDICES 4096
+#define LIGHT_NEAR .1f
+#define LIGHT_FAR 100.f
+#define MAX_GEOMETRY_STREAMS (STREAM_INDEX + 1)
 
 typedef enum {
   BATCH_POINTS,
@@ -40,7 +49,10 @@ typedef enum {
   BATCH_SKYBOX,
   BATCH_TEXT,
   BATCH_FILL,
-  BATCH_MESH
+  BATCH_MASK,
+  BATCH_MESH,
+  BATCH_INDIRECT,
+  BATCH_OCCLUSION
 } BatchType;
 
 typedef union {
@@ -51,8 +63,11 @@ typedef union {
   struct { float r1; float r2; bool capped; int segments; } cylinder;
   struct { int segments; } sphere;
   struct { float spread; } text;
+  struct { float width; } lines;
   struct { float u; float v; float w; float h; } fill;
-  struct { uint32_t rangeStart; uint32_t rangeCount; uint32_t instances; float* pose; } mesh;
+  struct { uint32_t rangeStart; uint32_t rangeCount; uint32_t instances; uint32_t boneCount; } mesh;
+  struct { Buffer* buffer; size_t offset; uint32_t count; } indirect;
+  struct { uint32_t query; } occlusion;
 } BatchParams;
 
 typedef struct {
@@ -68,8 +83,10 @@ typedef struct {
   uint32_t vertexCount;
   uint32_t indexCount;
   float** vertices;
-  uint16_t** indices;
-  uint16_t* baseVertex;
+  uint32_t** indices;
+  uint32_t* baseVertex;
+  uint8_t* drawId;
+  float* pose;
   bool instanced;
 } BatchRequest;
 
@@ -78,18 +95,129 @@ typedef struct {
   BatchParams params;
   DrawCommand draw;
   Material* material;
-  mat4 transforms;
-  Color* colors;
   uint32_t drawStart;
   uint32_t drawCount;
+  uint32_t poseStart;
   bool indexed;
+  bool lines;
 } Batch;
 
+// Per-draw uniform data for a Batch.  This lives in a CPU-side arena (parallel to the batch list)
+// and is copied into the STREAM_MODEL/STREAM_COLOR/STREAM_MATERIAL uniform buffers when the
+// batches are flushed.  Material colors and scalars are per-draw, so draws with different Materials
+// can share a batch as long as their textures match.
+// Skinned draws also store the index of their joint matrices in the pose arena, which get packed
+// into STREAM_POSE so the shader can find the pose of a draw using its draw id.
+typedef struct {
+  float transforms[MAX_DRAWS][16];
+  Color colors[MAX_DRAWS];
+  float materials[MAX_DRAWS][12];
+  uint32_t poses[MAX_DRAWS];
+} BatchDraws;
+
+// While a DrawList is recording, the geometry streams write to arrays in the list instead of the
+// stream buffers, and flushes move the batches into the list instead of drawing them.  When it's
+// done recording, the arrays become static Buffers with their own set of stream Meshes, so drawing
+// the list only has to copy its batches and per-draw data back into the batch list.  Streamed
+// batches that aren't indexed get sequential indices, so the list Meshes can keep their index
+// buffer bound.  Default shaders are looked up again when drawing, since they depend on the Canvas.
+typedef enum {
+  LIST_MESH_NONE,
+  LIST_MESH_TRIANGLES,
+  LIST_MESH_INSTANCED,
+  LIST_MESH_GLYPHS,
+  LIST_MESH_LINES
+} ListMesh;
+
+typedef struct {
+  Batch batch;
+  ListMesh mesh;
+  int defaultShader; // -1 if the batch uses a custom Shader
+  uint32_t drawStart;
+  uint32_t poseStart;
+} RecordedBatch;
+
+struct DrawList {
+  uint32_t ref;
+  arr_t(RecordedBatch) batches;
+  arr_t(float) transforms;
+  arr_t(Color) colors;
+  arr_t(float) materials;
+  arr_t(float) poses;
+  arr_t(uint8_t) streams[MAX_GEOMETRY_STREAMS];
+  Buffer* buffers[MAX_GEOMETRY_STREAMS];
+  Mesh* mesh;
+  Mesh* instancedMesh;
+  Mesh* glyphMesh;
+  Mesh* lineMesh;
+};
+
+typedef struct {
+  uint64_t key;
+  uint32_t index;
+} BatchKey;
+
+// Tessellated primitive geometry that has been requested more than once is kept in a static Mesh,
+// so later draws of the same primitive are instanced draws of that Mesh instead of re-tessellating.
+typedef void (*Tessellator)(BatchParams* params, float* vertices, uint32_t* indices, uint32_t baseVertex);
+
+typedef struct {
+  BatchType type;
+  BatchParams params;
+  Mesh* mesh;
+  uint64_t lastUsed;
+} CachedGeometry;
+
+// A pass that has been recorded but not flushed yet.  Its loads happen at the start of the flush
+// and its stores (resolves, discards) at the end, so independent passes can share a flush.
+typedef struct {
+  Canvas* canvas;
+  Pass info;
+  bool loaded;
+} DeferredPass;
+
+// A Texture that gets its mipmaps over several frames.  The mipmap chain is downsampled on the CPU,
+// then uploaded smallest level first, with the base level of the Texture following the uploads.
+typedef struct {
+  Texture* texture;
+  Image* mipmaps[32];
+  uint32_t mipmapCount;
+  uint32_t downsampled;
+  uint32_t uploaded;
+  float priority;
+} TextureStream;
+
+typedef struct {
+  Readback* readback;
+  uint32_t id;
+} Capture;
+
 typedef struct {
   float viewMatrix[2][16];
   float projection[2][16];
+  float motionTransform[2][16];
 } FrameData;
 
+typedef struct {
+  float position[4];
+  float color[4];
+} Light;
+
+// Lights are binned into clusters, which are slices of the view frustum (froxels), whenever the
+// lights or the camera change.  Each cluster is a range of the index list (offset << 16 | count),
+// and the indices are 8 bits.  Shaders find their cluster from the world position of the pixel, so
+// each pixel only shades the lights that can reach it.  This layout matches the std140 block, which
+// is padded to a multiple of 256 bytes so every copy of it in the stream can be bound.
+typedef struct {
+  float view[16];
+  float grid[4];
+  float depth[4];
+  Light lights[MAX_LIGHTS];
+  uint32_t clusters[LIGHT_CLUSTERS];
+  uint8_t indices[MAX_LIGHT_INDICES];
+  uint8_t padding[160];
+} LightData;
+
 static struct {
   bool initialized;
   bool debug;
@@ -98,12 +226,23 @@ static struct {
   Canvas* backbuffer;
   FrameData frameData;
   bool frameDataDirty;
+  LightData lightData;
+  uint32_t lightCount;
+  bool lightsDirty;
+  float previousViewProjection[2][16];
+  bool hasPreviousViewProjection[2];
+  void (*viewLatch)(float viewMatrix[2][16]);
+  const float* viewMask;
+  uint32_t viewMaskCount;
   Canvas* defaultCanvas;
   Shader* defaultShaders[MAX_DEFAULT_SHADERS][2];
+  Shader* skinningShader;
+  Shader* particleShaders[2];
   Material* defaultMaterial;
   Font* defaultFont;
   TextureFilter defaultFilter;
   float transforms[MAX_TRANSFORMS][16];
+  bool identity[MAX_TRANSFORMS];
   int transform;
   Color backgroundColor;
   Color linearBackgroundColor;
@@ -116,44 +255,85 @@ static struct {
   Shader* shader;
   Mesh* mesh;
   Mesh* instancedMesh;
+  Mesh* glyphMesh;
+  Mesh* lineMesh;
+  Buffer* lineCorners;
   Buffer* identityBuffer;
+  Buffer* identityPose;
   Buffer* buffers[MAX_STREAMS];
+  uint32_t bufferCount[MAX_STREAMS];
   uint32_t head[MAX_STREAMS];
   uint32_t tail[MAX_STREAMS];
-  Batch batches[MAX_BATCHES];
-  uint8_t batchCount;
+  DrawList* recording;
+  uint32_t savedHead[MAX_GEOMETRY_STREAMS];
+  uint32_t savedTail[MAX_GEOMETRY_STREAMS];
+  uint32_t savedCount[MAX_GEOMETRY_STREAMS];
+  arr_t(Batch) batches;
+  arr_t(BatchDraws) batchDraws;
+  arr_t(BatchKey) batchKeys;
+  arr_t(float) poses;
+  uint32_t batchLimit;
+  bool sorting;
+  bool depthPrepass;
+  arr_t(DeferredPass) passes;
+  bool inPass;
+  CachedGeometry geometry[MAX_CACHED_GEOMETRY];
+  arr_t(TextureStream) textureStreams;
+  uint64_t geometryTick;
+  uint32_t frameIndex;
+  arr_t(Capture) captures;
+  uint32_t captureId;
+  bool headless;
+  bool pacing;
+  double frameStart; // When the last pacing wait ended
+  double vblank; // When the last swap finished
+  double refreshPeriod; // Averaged time between swaps, 0 until measured
+  double workTime; // Decaying peak of the time from frameStart to the swap
 } state;
 
+// Initial stream sizes.  The uniform streams grow (up to the batch limit) when a flush needs more
+// space than they have, everything else stays at its initial size.  Indices are 32 bits, so the
+// vertex stream isn't limited to 16 bit index range.  Text uses its own stream of GlyphVertex,
+// which has no normal and stores the draw id inline, so it's half the size of a regular vertex.
+// Batches only bind a MAX_DRAWS (or MAX_BONES) sized range of a uniform stream, so WebGL's small
+// uniform block size limit applies to the range and not to the whole stream.
 static const uint32_t bufferCount[] = {
-  [STREAM_VERTEX] = (1 << 16) - 1,
-  [STREAM_DRAWID] = (1 << 16) - 1,
-  [STREAM_INDEX] = 1 << 16,
-#if defined(LOVR_WEBGL) // Work around bugs where big UBOs don't work
-  [STREAM_MODEL] = MAX_DRAWS,
-  [STREAM_COLOR] = MAX_DRAWS,
-#else
-  [STREAM_MODEL] = MAX_DRAWS * MAX_BATCHES,
-  [STREAM_COLOR] = MAX_DRAWS * MAX_BATCHES,
-#endif
-  [STREAM_FRAME] = 4
+  [STREAM_VERTEX] = 1 << 18,
+  [STREAM_DRAWID] = 1 << 18,
+  [STREAM_GLYPH] = 1 << 17,
+  [STREAM_INDEX] = 1 << 19,
+  [STREAM_MODEL] = MAX_DRAWS * 4,
+  [STREAM_COLOR] = MAX_DRAWS * 4,
+  [STREAM_MATERIAL] = MAX_DRAWS * 4,
+  [STREAM_POSE] = MAX_BONES * 4,
+  [STREAM_FRAME] = 4,
+  [STREAM_LIGHT] = 4
 };
 
 static const size_t bufferStride[] = {
   [STREAM_VERTEX] = 8 * sizeof(float),
   [STREAM_DRAWID] = sizeof(uint8_t),
-  [STREAM_INDEX] = sizeof(uint16_t),
+  [STREAM_GLYPH] = sizeof(GlyphVertex),
+  [STREAM_INDEX] = sizeof(uint32_t),
   [STREAM_MODEL] = 16 * sizeof(float),
   [STREAM_COLOR] = 4 * sizeof(float),
-  [STREAM_FRAME] = sizeof(FrameData)
+  [STREAM_MATERIAL] = 12 * sizeof(float),
+  [STREAM_FRAME] = sizeof(FrameData),
+  [STREAM_POSE] = 16 * sizeof(float),
+  [STREAM_LIGHT] = sizeof(LightData)
 };
 
 static const BufferType bufferType[] = {
   [STREAM_VERTEX] = BUFFER_VERTEX,
   [STREAM_DRAWID] = BUFFER_GENERIC,
+  [STREAM_GLYPH] = BUFFER_VERTEX,
   [STREAM_INDEX] = BUFFER_INDEX,
   [STREAM_MODEL] = BUFFER_UNIFORM,
   [STREAM_COLOR] = BUFFER_UNIFORM,
-  [STREAM_FRAME] = BUFFER_UNIFORM
+  [STREAM_MATERIAL] = BUFFER_UNIFORM,
+  [STREAM_FRAME] = BUFFER_UNIFORM,
+  [STREAM_POSE] = BUFFER_UNIFORM,
+  [STREAM_LIGHT] = BUFFER_UNIFORM
 };
 
 static void gammaCorrect(Color* color) {
@@ -175,22 +355,238 @@ static void onResizeWindow(int width, int height) {
 }
 
 static void* lovrGraphicsMapBuffer(StreamType type, uint32_t count) {
-  lovrAssert(count <= bufferCount[type], "Whoa there!  Tried to get %d elements from a buffer that only has %d elements.", count, bufferCount[type]);
+  if (state.recording && type < MAX_GEOMETRY_STREAMS) {
+    DrawList* list = state.recording;
+    arr_reserve(&list->streams[type], (state.head[type] + count) * bufferStride[type]);
+    return list->streams[type].data + state.head[type] * bufferStride[type];
+  }
 
-  if (state.head[type] + count > bufferCount[type]) {
-    lovrAssert(state.batchCount == 0, "Internal error: Batches still exist during Buffer reset");
+  lovrAssert(count <= state.bufferCount[type], "Whoa there!  Tried to get %d elements from a buffer that only has %d elements.", count, state.bufferCount[type]);
+
+  if (state.head[type] + count > state.bufferCount[type]) {
+    lovrAssert(state.batches.length == 0, "Internal error: Batches still exist during Buffer reset");
     lovrBufferDiscard(state.buffers[type]);
     state.tail[type] = 0;
     state.head[type] = 0;
   }
 
+  lovrGpuCountStream(type, count * bufferStride[type]);
   return lovrBufferMap(state.buffers[type], state.head[type] * bufferStride[type], true);
 }
 
+// Bins the lights into clusters for the current cameras.  The grid is laid out in the space of the
+// first view, spanning the tangents of both projections so it covers the second eye too (pixels
+// that still fall outside of it use the clusters on the edge, which get the lights outside of it).
+// Depth slices are exponential from LIGHT_NEAR to LIGHT_FAR.  Orthographic projections put every
+// light in a single cluster that all pixels use.
+static void lovrGraphicsUpdateLights(void) {
+  LightData* data = &state.lightData;
+  float* view = state.frameData.viewMatrix[0];
+  mat4_init(data->view, view);
+  memset(data->clusters, 0, sizeof(data->clusters));
+
+  if (state.frameData.projection[0][11] == 0.f) {
+    memcpy(data->grid, (float[4]) { 0.f, 0.f, 0.f, 0.f }, 4 * sizeof(float));
+    memcpy(data->depth, (float[4]) { 1.f, 0.f, (float) state.lightCount, 0.f }, 4 * sizeof(float));
+    for (uint32_t i = 0; i < state.lightCount; i++) {
+      data->indices[i] = (uint8_t) i;
+    }
+    data->clusters[0] = state.lightCount;
+  } else {
+    float left = FLT_MAX, right = -FLT_MAX, down = FLT_MAX, up = -FLT_MAX;
+    for (uint32_t i = 0; i < 2; i++) {
+      float* m = state.frameData.projection[i];
+      float l = (m[8] - 1.f) / m[0], r = (m[8] + 1.f) / m[0];
+      float d = (m[9] - 1.f) / m[5], u = (m[9] + 1.f) / m[5];
+      left = MIN(left, l);
+      right = MAX(right, r);
+      down = MIN(down, d);
+      up = MAX(up, u);
+    }
+
+    float scaleX = LIGHT_GRID_X / (right - left);
+    float scaleY = LIGHT_GRID_Y / (up - down);
+    float scaleZ = LIGHT_GRID_Z / logf(LIGHT_FAR / LIGHT_NEAR);
+    memcpy(data->grid, (float[4]) { left, down, scaleX, scaleY }, 4 * sizeof(float));
+    memcpy(data->depth, (float[4]) { LIGHT_NEAR, scaleZ, (float) state.lightCount, 0.f }, 4 * sizeof(float));
+
+    // Find the range of clusters touched by the view space bounding box of each light
+    uint32_t visibleCount = 0;
+    struct { uint8_t index, min[3], max[3]; } visible[MAX_LIGHTS];
+    for (uint32_t i = 0; i < state.lightCount; i++) {
+      float p[4], radius = data->lights[i].position[3];
+      vec3_init(p, data->lights[i].position);
+      mat4_transform(view, p);
+
+      float zNear = -p[2] - radius;
+      float zFar = -p[2] + radius;
+      if (zFar < LIGHT_NEAR) continue;
+
+      int min[3] = { 0, 0, 0 };
+      int max[3] = { LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1, LIGHT_GRID_Z - 1 };
+      max[2] = CLAMP((int) (logf(zFar / LIGHT_NEAR) * scaleZ), 0, LIGHT_GRID_Z - 1);
+
+      // Lights crossing the zNear plane can cover any direction
+      if (zNear > LIGHT_NEAR) {
+        float x0 = MIN((p[0] - radius) / zNear, (p[0] - radius) / zFar);
+        float x1 = MAX((p[0] + radius) / zNear, (p[0] + radius) / zFar);
+        float y0 = MIN((p[1] - radius) / zNear, (p[1] - radius) / zFar);
+        float y1 = MAX((p[1] + radius) / zNear, (p[1] + radius) / zFar);
+        min[0] = CLAMP((int) floorf((x0 - left) * scaleX), 0, LIGHT_GRID_X - 1);
+        max[0] = CLAMP((int) floorf((x1 - left) * scaleX), 0, LIGHT_GRID_X - 1);
+        min[1] = CLAMP((int) floorf((y0 - down) * scaleY), 0, LIGHT_GRID_Y - 1);
+        max[1] = CLAMP((int) floorf((y1 - down) * scaleY), 0, LIGHT_GRID_Y - 1);
+        min[2] = CLAMP((int) (logf(zNear / LIGHT_NEAR) * scaleZ), 0, LIGHT_GRID_Z - 1);
+      }
+
+      visible[visibleCount].index = (uint8_t) i;
+      for (uint32_t j = 0; j < 3; j++) {
+        visible[visibleCount].min[j] = (uint8_t) min[j];
+        visible[visibleCount].max[j] = (uint8_t) max[j];
+      }
+      visibleCount++;
+    }
+
+    // If the index list fills up, the remaining clusters are missing lights
+    uint32_t cursor = 0;
+    for (uint32_t z = 0, c = 0; z < LIGHT_GRID_Z; z++) {
+      for (uint32_t y = 0; y < LIGHT_GRID_Y; y++) {
+        for (uint32_t x = 0; x < LIGHT_GRID_X; x++, c++) {
+          uint32_t start = cursor;
+          for (uint32_t i = 0; i < visibleCount && cursor < MAX_LIGHT_INDICES; i++) {
+            if (
+              x >= visible[i].min[0] && x <= visible[i].max[0] &&
+              y >= visible[i].min[1] && y <= visible[i].max[1] &&
+              z >= visible[i].min[2] && z <= visible[i].max[2]
+            ) {
+              data->indices[cursor++] = visible[i].index;
+            }
+          }
+          data->clusters[c] = (start << 16) | (cursor - start);
+        }
+      }
+    }
+  }
+
+  void* buffer = lovrGraphicsMapBuffer(STREAM_LIGHT, 1);
+  memcpy(buffer, data, sizeof(LightData));
+  state.head[STREAM_LIGHT]++;
+}
+
+// Grows one of the uniform streams so it can hold at least count elements.  This can only happen
+// when no batches are using the stream, since the old Buffer is thrown away.
+static void lovrGraphicsGrowBuffer(StreamType type, uint32_t count) {
+  uint32_t limit = (type == STREAM_POSE ? MAX_BONES : MAX_DRAWS) * state.batchLimit;
+  uint32_t size = state.bufferCount[type];
+
+  if (size >= count || size >= limit) {
+    return;
+  }
+
+  while (size < count) size <<= 1;
+  size = MIN(size, limit);
+
+  lovrRelease(state.buffers[type], lovrBufferDestroy);
+  state.buffers[type] = lovrBufferCreatePersistent(size * bufferStride[type], bufferType[type]);
+  state.bufferCount[type] = size;
+  state.head[type] = 0;
+  state.tail[type] = 0;
+}
+
+// Texture streaming
+
+// Streams an Image into the mipmaps of an allocated Texture.  Returns false if the Image can't be
+// streamed (compressed or high precision formats), in which case the caller should upload it.
+bool lovrGraphicsStreamTexture(Texture* texture, Image* image) {
+  if (image->format != FORMAT_RGB && image->format != FORMAT_RGBA) {
+    return false;
+  }
+
+  uint32_t mipmapCount = lovrTextureGetMipmapCount(texture);
+  lovrAssert(mipmapCount <= 32, "Unreachable");
+  lovrTextureSetBaseMipmap(texture, mipmapCount - 1);
+  lovrRetain(texture);
+  lovrRetain(image);
+  arr_push(&state.textureStreams, ((TextureStream) {
+    .texture = texture,
+    .mipmaps[0] = image,
+    .mipmapCount = mipmapCount,
+    .downsampled = 1
+  }));
+  return true;
+}
+
+// Textures that are bigger on screen get their mipmaps first
+void lovrGraphicsPrioritizeTexture(Texture* texture, float priority) {
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+    if (stream->texture == texture) {
+      stream->priority = MAX(stream->priority, priority);
+      return;
+    }
+  }
+}
+
+// Fraction of a Texture's mipmaps that have been uploaded, 1 if it isn't streaming
+float lovrGraphicsGetStreamProgress(Texture* texture) {
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+    if (stream->texture == texture) {
+      return (float) stream->uploaded / stream->mipmapCount;
+    }
+  }
+  return 1.f;
+}
+
+// Does a frame's worth of work on the texture streams.  Each step either downsamples or uploads one
+// mipmap, and at least one step happens per frame so big images still make progress.
+static void lovrGraphicsUpdateTextureStreams() {
+  size_t budget = TEXTURE_STREAM_BUDGET;
+  bool first = true;
+
+  while (state.textureStreams.length > 0 && (budget > 0 || first)) {
+    TextureStream* stream = &state.textureStreams.data[0];
+    for (size_t i = 1; i < state.textureStreams.length; i++) {
+      if (state.textureStreams.data[i].priority > stream->priority) {
+        stream = &state.textureStreams.data[i];
+      }
+    }
+
+    size_t cost;
+    if (stream->downsampled < stream->mipmapCount) {
+      Image* source = stream->mipmaps[stream->downsampled - 1];
+      stream->mipmaps[stream->downsampled++] = lovrImageDownsample(source);
+      cost = source->blob->size;
+    } else {
+      uint32_t level = stream->mipmapCount - 1 - stream->uploaded++;
+      Image* image = stream->mipmaps[level];
+      lovrTextureReplacePixels(stream->texture, image, 0, 0, 0, level);
+      lovrTextureSetBaseMipmap(stream->texture, level);
+      cost = image->blob->size;
+    }
+
+    budget = cost >= budget ? 0 : budget - cost;
+    first = false;
+
+    if (stream->uploaded == stream->mipmapCount) {
+      lovrRelease(stream->texture, lovrTextureDestroy);
+      for (uint32_t i = 0; i < stream->mipmapCount; i++) {
+        lovrRelease(stream->mipmaps[i], lovrImageDestroy);
+      }
+      arr_splice(&state.textureStreams, stream - state.textureStreams.data, 1);
+    }
+  }
+
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    state.textureStreams.data[i].priority = 0.f;
+  }
+}
+
 // Base
 
-bool lovrGraphicsInit(bool debug) {
+bool lovrGraphicsInit(bool debug, uint32_t batchLimit) {
   state.debug = debug;
+  state.batchLimit = batchLimit > 0 ? batchLimit : DEFAULT_BATCH_LIMIT;
   return false; // See lovrGraphicsCreateWindow for actual initialization
 }
 
@@ -203,12 +599,42 @@ void lovrGraphicsDestroy() {
     lovrRelease(state.defaultShaders[i][false], lovrShaderDestroy);
     lovrRelease(state.defaultShaders[i][true], lovrShaderDestroy);
   }
+  lovrRelease(state.skinningShader, lovrShaderDestroy);
+  lovrRelease(state.particleShaders[0], lovrShaderDestroy);
+  lovrRelease(state.particleShaders[1], lovrShaderDestroy);
   for (int i = 0; i < MAX_STREAMS; i++) {
     lovrRelease(state.buffers[i], lovrBufferDestroy);
   }
+  arr_free(&state.batches);
+  arr_free(&state.batchDraws);
+  arr_free(&state.batchKeys);
+  arr_free(&state.poses);
+  for (size_t i = 0; i < state.passes.length; i++) {
+    lovrRelease(state.passes.data[i].canvas, lovrCanvasDestroy);
+  }
+  arr_free(&state.passes);
+  for (int i = 0; i < MAX_CACHED_GEOMETRY; i++) {
+    lovrRelease(state.geometry[i].mesh, lovrMeshDestroy);
+  }
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+    lovrRelease(stream->texture, lovrTextureDestroy);
+    for (uint32_t j = 0; j < stream->downsampled; j++) {
+      lovrRelease(stream->mipmaps[j], lovrImageDestroy);
+    }
+  }
+  arr_free(&state.textureStreams);
+  for (size_t i = 0; i < state.captures.length; i++) {
+    lovrRelease(state.captures.data[i].readback, lovrReadbackDestroy);
+  }
+  arr_free(&state.captures);
   lovrRelease(state.mesh, lovrMeshDestroy);
   lovrRelease(state.instancedMesh, lovrMeshDestroy);
+  lovrRelease(state.glyphMesh, lovrMeshDestroy);
+  lovrRelease(state.lineMesh, lovrMeshDestroy);
+  lovrRelease(state.lineCorners, lovrBufferDestroy);
   lovrRelease(state.identityBuffer, lovrBufferDestroy);
+  lovrRelease(state.identityPose, lovrBufferDestroy);
   lovrRelease(state.defaultMaterial, lovrMaterialDestroy);
   lovrRelease(state.defaultFont, lovrFontDestroy);
   lovrRelease(state.defaultCanvas, lovrCanvasDestroy);
@@ -216,10 +642,122 @@ void lovrGraphicsDestroy() {
   memset(&state, 0, sizeof(state));
 }
 
-void lovrGraphicsPresent() {
+// Frame pacing lowers latency under vsync.  Normally the swap blocks until a vblank and the next
+// frame starts right away, so its input is most of a refresh old by the time it's shown, and the
+// driver may queue more frames on top of that.  With pacing, each swap waits for the flip, and then
+// the next frame is held back until just before it has to start to make the following vblank.  The
+// wait is the refresh period minus the slowest recent frame and a margin.  os_sleep can oversleep,
+// so the end of the wait is a spin.  Missing a vblank backs the wait off.
+#define PACING_MARGIN .0015
+#define PACING_SPIN .002
+
+static void pace(double swapStart) {
+  double now = os_get_time();
+  double interval = now - state.vblank;
+  double work = swapStart - state.frameStart;
+  state.vblank = now;
+
+  if (state.frameStart == 0.) {
+    state.frameStart = now;
+    return;
+  }
+
+  if (state.refreshPeriod == 0.) {
+    state.refreshPeriod = interval;
+  } else if (interval < state.refreshPeriod * 1.5) {
+    state.refreshPeriod += (interval - state.refreshPeriod) * .05;
+  } else {
+    work += .001; // Missed a vblank
+  }
+
+  state.workTime = MAX(work, state.workTime - (state.workTime - work) * .05);
+
+  double target = now + state.refreshPeriod - state.workTime - PACING_MARGIN;
+  if (target - now > PACING_SPIN) {
+    os_sleep(target - now - PACING_SPIN);
+  }
+  while (os_get_time() < target);
+
+  state.frameStart = os_get_time();
+}
+
+// Skipping the swap still finishes the frame, for frames that didn't draw anything to the window
+void lovrGraphicsPresent(bool swap) {
   lovrGraphicsFlush();
-  os_window_swap();
+  double swapStart = os_get_time();
+  if (swap) os_window_swap();
+  bool pacing = swap && state.pacing && !state.headless;
+  if (pacing) lovrGpuFinish(); // Returns when the frame flips, which is the vblank under vsync
   lovrGpuPresent();
+  lovrGraphicsUpdateTextureStreams();
+  state.frameIndex++;
+  if (pacing) pace(swapStart);
+}
+
+bool lovrGraphicsIsFramePacing() {
+  return state.pacing;
+}
+
+void lovrGraphicsSetFramePacing(bool pacing) {
+  if (pacing && !state.pacing) {
+    state.frameStart = state.vblank = state.refreshPeriod = state.workTime = 0.;
+  }
+  state.pacing = pacing;
+}
+
+// Creates the Meshes that draw geometry from a set of streams, skipping any that are NULL.  Expanded
+// lines and points are an instanced quad per segment.  The segment endpoints and draw ids are read
+// from the regular streams as instanced attributes, offset to each batch's range.
+static void createStreamMeshes(Buffer** streams, Mesh** mesh, Mesh** instancedMesh, Mesh** glyphMesh, Mesh** lineMesh) {
+  Buffer* vertexBuffer = streams[STREAM_VERTEX];
+  size_t stride = bufferStride[STREAM_VERTEX];
+
+  MeshAttribute position = { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 };
+  MeshAttribute normal = { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 };
+  MeshAttribute texCoord = { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 };
+  MeshAttribute drawId = { .buffer = streams[STREAM_DRAWID], .type = U8, .components = 1 };
+  MeshAttribute identity = { .buffer = state.identityBuffer, .type = U8, .components = 1, .divisor = 1 };
+
+  if (mesh) {
+    *mesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
+    lovrMeshAttachAttribute(*mesh, "lovrPosition", &position);
+    lovrMeshAttachAttribute(*mesh, "lovrNormal", &normal);
+    lovrMeshAttachAttribute(*mesh, "lovrTexCoord", &texCoord);
+    lovrMeshAttachAttribute(*mesh, "lovrDrawID", &drawId);
+  }
+
+  if (instancedMesh) {
+    *instancedMesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
+    lovrMeshAttachAttribute(*instancedMesh, "lovrPosition", &position);
+    lovrMeshAttachAttribute(*instancedMesh, "lovrNormal", &normal);
+    lovrMeshAttachAttribute(*instancedMesh, "lovrTexCoord", &texCoord);
+    lovrMeshAttachAttribute(*instancedMesh, "lovrDrawID", &identity);
+  }
+
+  if (glyphMesh) {
+    Buffer* glyphBuffer = streams[STREAM_GLYPH];
+    MeshAttribute glyphPosition = { .buffer = glyphBuffer, .offset = offsetof(GlyphVertex, x), .stride = sizeof(GlyphVertex), .type = F32, .components = 2 };
+    MeshAttribute glyphTexCoord = { .buffer = glyphBuffer, .offset = offsetof(GlyphVertex, u), .stride = sizeof(GlyphVertex), .type = U16, .components = 2, .normalized = true };
+    MeshAttribute glyphDrawId = { .buffer = glyphBuffer, .offset = offsetof(GlyphVertex, drawId), .stride = sizeof(GlyphVertex), .type = U8, .components = 1 };
+    *glyphMesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
+    lovrMeshAttachAttribute(*glyphMesh, "lovrPosition", &glyphPosition);
+    lovrMeshAttachAttribute(*glyphMesh, "lovrTexCoord", &glyphTexCoord);
+    lovrMeshAttachAttribute(*glyphMesh, "lovrDrawID", &glyphDrawId);
+  }
+
+  if (lineMesh) {
+    MeshAttribute lineCorner = { .buffer = state.lineCorners, .stride = 2 * sizeof(float), .type = F32, .components = 2 };
+    MeshAttribute lineStart = { .buffer = vertexBuffer, .stride = stride, .type = F32, .components = 3, .divisor = 1 };
+    MeshAttribute lineEnd = { .buffer = vertexBuffer, .stride = stride, .type = F32, .components = 3, .divisor = 1 };
+    MeshAttribute lineStartId = { .buffer = streams[STREAM_DRAWID], .type = U8, .components = 1, .divisor = 1 };
+    MeshAttribute lineEndId = { .buffer = streams[STREAM_DRAWID], .type = U8, .components = 1, .divisor = 1 };
+    *lineMesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
+    lovrMeshAttachAttribute(*lineMesh, "lovrLineCorner", &lineCorner);
+    lovrMeshAttachAttribute(*lineMesh, "lovrPosition", &lineStart);
+    lovrMeshAttachAttribute(*lineMesh, "lovrLineEnd", &lineEnd);
+    lovrMeshAttachAttribute(*lineMesh, "lovrDrawID", &lineStartId);
+    lovrMeshAttachAttribute(*lineMesh, "lovrLineEndID", &lineEndId);
+  }
 }
 
 void lovrGraphicsCreateWindow(WindowFlags* flags) {
@@ -229,6 +767,7 @@ void lovrGraphicsCreateWindow(WindowFlags* flags) {
     .fullscreen = flags->fullscreen,
     .resizable = flags->resizable,
     .debug = state.debug,
+    .headless = flags->headless,
     .vsync = flags->vsync,
     .msaa = flags->msaa,
     .title = flags->title,
@@ -238,20 +777,47 @@ void lovrGraphicsCreateWindow(WindowFlags* flags) {
   };
 
   lovrAssert(!state.initialized, "Window is already created");
-  lovrAssert(os_window_open(&config), "Could not create window");
+  if (flags->headless) {
+    lovrAssert(os_window_open(&config), "Could not create a headless context (it needs EGL with EGL_KHR_surfaceless_context)");
+  } else {
+    lovrAssert(os_window_open(&config), "Could not create window");
+  }
+
   os_window_set_vsync(flags->vsync); // Force vsync in case lovr.headset changed it in a previous restart
+  state.headless = flags->headless;
+  lovrGraphicsSetFramePacing(flags->pacing);
   os_on_quit(onQuitRequest);
   os_on_resize(onResizeWindow);
   os_window_get_fbsize(&state.width, &state.height);
   lovrGpuInit(os_get_gl_proc_address, state.debug);
 
-  state.defaultCanvas = lovrCanvasCreateFromHandle(state.width, state.height, (CanvasFlags) { .stereo = false }, 0, 0, 0, 1, true);
+  // Without a window, the backbuffer is a regular Canvas, and presenting doesn't swap anything
+  if (flags->headless) {
+    CanvasFlags canvasFlags = { .depth = { .enabled = true, .format = FORMAT_D24S8 }, .msaa = flags->msaa };
+    state.defaultCanvas = lovrCanvasCreate(state.width, state.height, canvasFlags);
+    Texture* texture = lovrTextureCreate(TEXTURE_2D, NULL, 0, true, false, flags->msaa);
+    lovrTextureAllocate(texture, state.width, state.height, 1, FORMAT_RGBA);
+    lovrCanvasSetAttachments(state.defaultCanvas, &(Attachment) { texture, 0, 0 }, 1);
+    lovrRelease(texture, lovrTextureDestroy);
+  } else {
+    state.defaultCanvas = lovrCanvasCreateFromHandle(state.width, state.height, (CanvasFlags) { .stereo = false }, 0, 0, 0, 1, true);
+  }
+
   state.backbuffer = state.defaultCanvas;
 
   for (int i = 0; i < MAX_STREAMS; i++) {
-    state.buffers[i] = lovrBufferCreate(bufferCount[i] * bufferStride[i], NULL, bufferType[i], USAGE_STREAM, false);
+    state.bufferCount[i] = bufferCount[i];
+    state.buffers[i] = lovrBufferCreatePersistent(bufferCount[i] * bufferStride[i], bufferType[i]);
   }
 
+  arr_init(&state.batches, realloc);
+  arr_init(&state.batchDraws, realloc);
+  arr_init(&state.batchKeys, realloc);
+  arr_init(&state.poses, realloc);
+  arr_init(&state.passes, realloc);
+  arr_init(&state.textureStreams, realloc);
+  arr_init(&state.captures, realloc);
+
   // The identity buffer is used for autoinstanced meshes and instanced primitives and maps the
   // instance ID to a vertex attribute.  Its contents never change, so they are initialized here.
   state.identityBuffer = lovrBufferCreate(MAX_DRAWS * sizeof(uint8_t), NULL, BUFFER_VERTEX, USAGE_STATIC, false);
@@ -260,26 +826,19 @@ void lovrGraphicsCreateWindow(WindowFlags* flags) {
   lovrBufferFlush(state.identityBuffer, 0, MAX_DRAWS);
   lovrBufferUnmap(state.identityBuffer);
 
-  Buffer* vertexBuffer = state.buffers[STREAM_VERTEX];
-  size_t stride = bufferStride[STREAM_VERTEX];
-
-  MeshAttribute position = { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 };
-  MeshAttribute normal = { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 };
-  MeshAttribute texCoord = { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 };
-  MeshAttribute drawId = { .buffer = state.buffers[STREAM_DRAWID], .type = U8, .components = 1 };
-  MeshAttribute identity = { .buffer = state.identityBuffer, .type = U8, .components = 1, .divisor = 1 };
+  // Draws that aren't skinned use a pose block full of identity matrices
+  size_t poseSize = MAX_BONES * bufferStride[STREAM_POSE];
+  state.identityPose = lovrBufferCreate(poseSize, NULL, BUFFER_UNIFORM, USAGE_STATIC, false);
+  float* pose = lovrBufferMap(state.identityPose, 0, true);
+  for (int i = 0; i < MAX_BONES; i++) mat4_identity(pose + 16 * i);
+  lovrBufferFlush(state.identityPose, 0, poseSize);
+  lovrBufferUnmap(state.identityPose);
 
-  state.mesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
-  lovrMeshAttachAttribute(state.mesh, "lovrPosition", &position);
-  lovrMeshAttachAttribute(state.mesh, "lovrNormal", &normal);
-  lovrMeshAttachAttribute(state.mesh, "lovrTexCoord", &texCoord);
-  lovrMeshAttachAttribute(state.mesh, "lovrDrawID", &drawId);
+  // The corners of the quads that expanded lines and points are drawn with
+  float corners[12] = { 0.f, -1.f, 1.f, -1.f, 0.f, 1.f, 0.f, 1.f, 1.f, -1.f, 1.f, 1.f };
+  state.lineCorners = lovrBufferCreate(sizeof(corners), corners, BUFFER_VERTEX, USAGE_STATIC, false);
 
-  state.instancedMesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, 0);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrPosition", &position);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrNormal", &normal);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrTexCoord", &texCoord);
-  lovrMeshAttachAttribute(state.instancedMesh, "lovrDrawID", &identity);
+  createStreamMeshes(state.buffers, &state.mesh, &state.instancedMesh, &state.glyphMesh, &state.lineMesh);
 
   lovrGraphicsReset();
   state.initialized = true;
@@ -304,6 +863,8 @@ float lovrGraphicsGetPixelDensity() {
   }
 }
 
+static void drawViewMask(void);
+
 void lovrGraphicsSetBackbuffer(Canvas* canvas, bool stereo, bool clear) {
   lovrGraphicsFlush();
 
@@ -319,6 +880,10 @@ void lovrGraphicsSetBackbuffer(Canvas* canvas, bool stereo, bool clear) {
 
   if (clear) {
     lovrGpuClear(state.backbuffer, &state.linearBackgroundColor, &(float) { 1. }, &(int) { 0 });
+
+    if (state.viewMaskCount > 0 && !state.canvas && lovrCanvasIsStereo(canvas)) {
+      drawViewMask();
+    }
   }
 }
 
@@ -356,10 +921,68 @@ void lovrGraphicsSetProjection(uint32_t index, float* projection) {
   state.frameDataDirty = true;
 }
 
+// Multiview shaders output motion vectors by moving each vertex from the current camera's clip space
+// to the previous camera's.  Without a previous camera (NULL), nothing appears to move.
+void lovrGraphicsSetPreviousViewProjection(uint32_t index, float* viewProjection) {
+  lovrAssert(index < 2, "Invalid view index %d", index);
+  lovrGraphicsFlush();
+  if (viewProjection) {
+    mat4_init(state.previousViewProjection[index], viewProjection);
+  }
+  state.hasPreviousViewProjection[index] = viewProjection != NULL;
+  state.frameDataDirty = true;
+}
+
+// While a latch is set, each flush of draws to the backbuffer asks it for the view matrices first,
+// so they're as fresh as possible when the draws are submitted.  This replaces any view matrix that
+// was set in the meantime, and whoever sets it has to present with the views it handed out last.
+void lovrGraphicsSetViewLatch(void (*latch)(float viewMatrix[2][16])) {
+  lovrGraphicsFlush();
+  state.viewLatch = latch;
+}
+
+// The view mask is a triangle list of the areas of each view that the lenses hide, as (x, y, view)
+// in normalized device coordinates.  Headsets set it around their rendering, and clearing a stereo
+// backbuffer writes it to the near plane of the depth buffer, so fragments under it are rejected by
+// the depth test early.  The vertices aren't copied and have to stay valid until the mask is unset.
+void lovrGraphicsSetViewMask(const float* vertices, uint32_t count) {
+  state.viewMask = vertices;
+  state.viewMaskCount = vertices ? count : 0;
+}
+
+// Default shaders are usually created the first time they're drawn with, which can hitch.  This
+// creates all of them up front (with the program cache, this is mostly loading binaries).
+void lovrGraphicsPrecompileShaders() {
+  for (int i = 0; i < MAX_DEFAULT_SHADERS; i++) {
+    for (int stereo = 0; stereo < 2; stereo++) {
+      if (!state.defaultShaders[i][stereo]) {
+        state.defaultShaders[i][stereo] = lovrShaderCreateDefault(i, NULL, 0, stereo);
+      }
+    }
+  }
+}
+
 Buffer* lovrGraphicsGetIdentityBuffer() {
   return state.identityBuffer;
 }
 
+Shader* lovrGraphicsGetSkinningShader() {
+  if (!state.skinningShader) {
+    state.skinningShader = lovrShaderCreateCompute(lovrSkinningComputeShader, -1, NULL, 0);
+  }
+
+  return state.skinningShader;
+}
+
+// The particle update shader, or the sorting shader when sort is true
+Shader* lovrGraphicsGetParticleShader(bool sort) {
+  if (!state.particleShaders[sort]) {
+    state.particleShaders[sort] = lovrShaderCreateCompute(sort ? lovrParticleSortComputeShader : lovrParticleComputeShader, -1, NULL, 0);
+  }
+
+  return state.particleShaders[sort];
+}
+
 // State
 
 void lovrGraphicsReset() {
@@ -381,9 +1004,12 @@ void lovrGraphicsReset() {
   lovrGraphicsSetLineWidth(1.f);
   lovrGraphicsSetPointSize(1.f);
   lovrGraphicsSetShader(NULL);
+  lovrGraphicsSetSortingEnabled(false);
+  lovrGraphicsSetDepthPrepassEnabled(false);
   lovrGraphicsSetStencilTest(COMPARE_NONE, 0);
   lovrGraphicsSetWinding(WINDING_COUNTERCLOCKWISE);
   lovrGraphicsSetWireframe(false);
+  lovrGraphicsClearLights();
   lovrGraphicsOrigin();
 }
 
@@ -421,6 +1047,8 @@ Canvas* lovrGraphicsGetCanvas() {
 }
 
 void lovrGraphicsSetCanvas(Canvas* canvas) {
+  lovrAssert(!state.inPass, "The Canvas can not be changed during a pass");
+
   if (state.canvas && canvas != state.canvas) {
     // The canvas must be flushed because if someone uses its textures to do a draw there is no way
     // to know that using that Texture requires the Canvas' batches to be flushed.
@@ -483,7 +1111,7 @@ Font* lovrGraphicsGetFont() {
   if (!state.font) {
     if (!state.defaultFont) {
       Rasterizer* rasterizer = lovrRasterizerCreate(NULL, 32);
-      state.defaultFont = lovrFontCreate(rasterizer, 1, 3.);
+      state.defaultFont = lovrFontCreate(rasterizer, 1, 3., FORMAT_RGBA16F);
       lovrRelease(rasterizer, lovrRasterizerDestroy);
     }
 
@@ -526,6 +1154,28 @@ void lovrGraphicsSetShader(Shader* shader) {
   state.shader = shader;
 }
 
+bool lovrGraphicsIsSortingEnabled() {
+  return state.sorting;
+}
+
+void lovrGraphicsSetSortingEnabled(bool sorting) {
+  if (state.sorting != sorting) {
+    lovrGraphicsFlush();
+    state.sorting = sorting;
+  }
+}
+
+bool lovrGraphicsIsDepthPrepassEnabled() {
+  return state.depthPrepass;
+}
+
+void lovrGraphicsSetDepthPrepassEnabled(bool enable) {
+  if (state.depthPrepass != enable) {
+    lovrGraphicsFlush();
+    state.depthPrepass = enable;
+  }
+}
+
 void lovrGraphicsGetStencilTest(CompareMode* mode, int* value) {
   *mode = state.pipeline.stencilMode;
   *value = state.pipeline.stencilValue;
@@ -559,6 +1209,7 @@ void lovrGraphicsSetWireframe(bool wireframe) {
 void lovrGraphicsPush() {
   lovrAssert(++state.transform < MAX_TRANSFORMS, "Unbalanced matrix stack (more pushes than pops?)");
   mat4_init(state.transforms[state.transform], state.transforms[state.transform - 1]);
+  state.identity[state.transform] = state.identity[state.transform - 1];
 }
 
 void lovrGraphicsPop() {
@@ -567,30 +1218,191 @@ void lovrGraphicsPop() {
 
 void lovrGraphicsOrigin() {
   mat4_identity(state.transforms[state.transform]);
+  state.identity[state.transform] = true;
 }
 
 void lovrGraphicsTranslate(vec3 translation) {
   mat4_translate(state.transforms[state.transform], translation[0], translation[1], translation[2]);
+  state.identity[state.transform] = false;
 }
 
 void lovrGraphicsRotate(quat rotation) {
-  mat4_rotateQuat(state.transforms[state.transform], rotation);
+  if (state.identity[state.transform]) {
+    mat4_fromQuat(state.transforms[state.transform], rotation);
+  } else {
+    mat4_rotateQuat(state.transforms[state.transform], rotation);
+  }
+  state.identity[state.transform] = false;
 }
 
 void lovrGraphicsScale(vec3 scale) {
   mat4_scale(state.transforms[state.transform], scale[0], scale[1], scale[2]);
+  state.identity[state.transform] = false;
+}
+
+void lovrGraphicsGetTransform(mat4 transform) {
+  mat4_init(transform, state.transforms[state.transform]);
 }
 
 void lovrGraphicsMatrixTransform(mat4 transform) {
-  mat4_mul(state.transforms[state.transform], transform);
+  if (state.identity[state.transform]) {
+    mat4_init(state.transforms[state.transform], transform);
+  } else {
+    mat4_mul(state.transforms[state.transform], transform);
+  }
+  state.identity[state.transform] = false;
+}
+
+// Lights
+
+// Point lights are positioned with the current transform and last until they're cleared.  The
+// alpha of the color is the intensity, and the radius is the distance where the light fades out.
+void lovrGraphicsAddLight(vec3 position, float radius, Color color) {
+  lovrAssert(state.lightCount < MAX_LIGHTS, "Too many lights (the maximum is %d)", MAX_LIGHTS);
+  lovrAssert(radius > 0.f, "Light radius must be positive");
+  lovrGraphicsFlush();
+#if !defined(LOVR_WEBGL) && !defined(LOVR_USE_PICO)
+  gammaCorrect(&color);
+#endif
+  Light* light = &state.lightData.lights[state.lightCount++];
+  vec3_init(light->position, position);
+  mat4_transform(state.transforms[state.transform], light->position);
+  light->position[3] = radius;
+  light->color[0] = color.r * color.a;
+  light->color[1] = color.g * color.a;
+  light->color[2] = color.b * color.a;
+  light->color[3] = 0.f;
+  state.lightsDirty = true;
+}
+
+void lovrGraphicsClearLights() {
+  if (state.lightCount > 0) {
+    lovrGraphicsFlush();
+    state.lightCount = 0;
+    state.lightsDirty = true;
+  }
+}
+
+uint32_t lovrGraphicsGetLightCount() {
+  return state.lightCount;
+}
+
+// Profiling
+
+// Pending batches are flushed on both ends of a scope so their GPU work is attributed to it
+void lovrGraphicsPushProfile(const char* label) {
+  lovrGraphicsFlush();
+  lovrGpuPushProfile(label);
+}
+
+void lovrGraphicsPopProfile() {
+  lovrGraphicsFlush();
+  lovrGpuPopProfile();
 }
 
 // Rendering
 
+// Opaque draws can be drawn in any order without changing the result
+static bool isPipelineOpaque(Pipeline* pipeline) {
+  return pipeline->blendMode == BLEND_NONE && pipeline->depthTest != COMPARE_NONE && pipeline->depthWrite;
+}
+
+// Batches that get drawn in the depth prepass.  Shading only the front-most pixels of these gives
+// the same image, as long as they're solid triangles with a depth test that passes on equal depth.
+static bool isPrepassBatch(Batch* batch) {
+  Pipeline* pipeline = &batch->draw.pipeline;
+  switch (batch->type) {
+    case BATCH_PLANE:
+    case BATCH_BOX:
+    case BATCH_ARC:
+    case BATCH_SPHERE:
+    case BATCH_CYLINDER:
+    case BATCH_MESH:
+    case BATCH_INDIRECT:
+      return isPipelineOpaque(pipeline) &&
+        (pipeline->depthTest == COMPARE_LESS || pipeline->depthTest == COMPARE_LEQUAL) &&
+        batch->draw.topology >= DRAW_TRIANGLES &&
+        batch->draw.query == 0 &&
+        pipeline->colorMask != 0 &&
+        !pipeline->alphaSampling &&
+        !pipeline->wireframe;
+    default:
+      return false;
+  }
+}
+
+static uint64_t getSortBits(const void* data, size_t size, uint32_t bits) {
+  return hash64(data, size) & ((1ull << bits) - 1);
+}
+
+// When sorting is enabled, opaque batches get a key made of (hashed) canvas, shader, material, mesh,
+// and pipeline bits so batches sharing state end up next to each other.  Transparent batches go
+// after all the opaque ones, keyed by submission order.  Hash collisions only make grouping worse.
+static uint64_t getBatchKey(Batch* batch, uint32_t index) {
+  if (batch->type == BATCH_MASK) {
+    return 0;
+  }
+
+  if (!isPipelineOpaque(&batch->draw.pipeline)) {
+    return (1ull << 63) | index;
+  }
+
+  uint64_t key = 0;
+  key |= getSortBits(&batch->draw.canvas, sizeof(Canvas*), 7) << 56;
+  key |= getSortBits(&batch->draw.shader, sizeof(Shader*), 14) << 42;
+  key |= getSortBits(&batch->material, sizeof(Material*), 14) << 28;
+  key |= getSortBits(&batch->draw.mesh, sizeof(Mesh*), 12) << 16;
+  key |= getSortBits(&batch->draw.pipeline, sizeof(Pipeline), 16);
+  return key;
+}
+
+// Stable LSD radix sort, 8 bits at a time, skipping passes where every key has the same digit
+static void sortBatchKeys(BatchKey* keys, BatchKey* scratch, uint32_t count) {
+  BatchKey* src = keys;
+  BatchKey* dst = scratch;
+
+  for (uint32_t shift = 0; shift < 64; shift += 8) {
+    uint32_t counts[256] = { 0 };
+
+    for (uint32_t i = 0; i < count; i++) {
+      counts[(src[i].key >> shift) & 0xff]++;
+    }
+
+    if (counts[(src[0].key >> shift) & 0xff] == count) {
+      continue;
+    }
+
+    for (uint32_t i = 0, total = 0; i < 256; i++) {
+      uint32_t n = counts[i];
+      counts[i] = total;
+      total += n;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      dst[counts[(src[i].key >> shift) & 0xff]++] = src[i];
+    }
+
+    BatchKey* temp = src;
+    src = dst;
+    dst = temp;
+  }
+
+  if (src != keys) {
+    memcpy(keys, src, count * sizeof(BatchKey));
+  }
+}
+
 static void lovrGraphicsBatch(BatchRequest* req) {
+  lovrProfileBegin("lovrGraphicsBatch");
+
+  // Draws outside of a pass might read the results of the deferred passes
+  if (state.passes.length > 0 && !state.inPass) {
+    lovrGraphicsFlush();
+  }
 
   // Resolve objects
-  Mesh* mesh = req->mesh ? req->mesh : (req->instanced ? state.instancedMesh : state.mesh);
+  Mesh* mesh = req->mesh ? req->mesh : (req->type == BATCH_TEXT ? state.glyphMesh : (req->shader == SHADER_LINE ? state.lineMesh : (req->instanced ? state.instancedMesh : state.mesh)));
+  StreamType vertexStream = req->type == BATCH_TEXT ? STREAM_GLYPH : STREAM_VERTEX;
   Canvas* canvas = state.canvas ? state.canvas : state.backbuffer;
   bool stereo = lovrCanvasIsStereo(canvas);
   Shader* shader = state.shader ? state.shader : (state.defaultShaders[req->shader][stereo] ? state.defaultShaders[req->shader][stereo] : (state.defaultShaders[req->shader][stereo] = lovrShaderCreateDefault(req->shader, NULL, 0, stereo)));
@@ -599,32 +1411,26 @@ static void lovrGraphicsBatch(BatchRequest* req) {
 
   if (!req->material) {
     if (req->type == BATCH_SKYBOX && lovrTextureGetType(req->texture) == TEXTURE_CUBE) {
-      lovrShaderSetTextures(shader, "lovrSkyboxTexture", &req->texture, 0, 1);
+      lovrShaderSetBuiltin(shader, BUILTIN_SKYBOX_TEXTURE, UNIFORM_SAMPLER, &req->texture, 0, 1);
     } else {
       lovrMaterialSetTexture(material, TEXTURE_DIFFUSE, req->texture);
     }
   }
 
-  if (lovrShaderHasUniform(shader, "lovrPose")) {
-    if (req->type == BATCH_MESH && req->params.mesh.pose) {
-      lovrShaderSetMatrices(shader, "lovrPose", req->params.mesh.pose, 0, MAX_BONES * 16);
-    } else {
-      lovrShaderSetMatrices(shader, "lovrPose", (float[]) MAT4_IDENTITY, 0, 16);
-    }
-  }
-
   // Try to find an existing batch to use
   Batch* batch = NULL;
-  for (int i = state.batchCount - 1; i >= 0; i--) {
+  for (int i = (int) state.batches.length - 1; i >= 0; i--) {
     if (req->type == BATCH_MESH && req->params.mesh.instances > 1) { break; }
+    if (req->type == BATCH_INDIRECT) { break; }
 
-    Batch* b = &state.batches[i];
+    Batch* b = &state.batches.data[i];
     if (b->type != req->type) { goto next; }
     if (b->drawCount >= MAX_DRAWS) { goto next; }
+    if (b->type == BATCH_MESH && (b->drawCount + 1) * b->params.mesh.boneCount > MAX_BONES) { goto next; }
     if (b->draw.mesh != mesh) { goto next; }
     if (b->draw.canvas != canvas) { goto next; }
     if (b->draw.shader != shader) { goto next; }
-    if (b->material != material) { goto next; }
+    if (b->material != material && !lovrMaterialIsCompatible(b->material, material)) { goto next; }
     if (memcmp(&b->draw.pipeline, pipeline, sizeof(Pipeline))) { goto next; }
     if (memcmp(&b->params, &req->params, sizeof(BatchParams))) { goto next; }
     batch = b;
@@ -632,7 +1438,13 @@ static void lovrGraphicsBatch(BatchRequest* req) {
 
 next:
     // Draws can't be reordered when blending is on, depth test is off, or either of the batches
-    // are streaming their vertices (since the vertices of a batch must be contiguous)
+    // are streaming their vertices (since the vertices of a batch must be contiguous).  When
+    // sorting is enabled, all opaque batches are drawn first, so opaque requests can look past
+    // any other batch.
+    if (state.sorting && isPipelineOpaque(pipeline)) {
+      if (!req->instanced) { break; }
+      continue;
+    }
     if (b->draw.pipeline.blendMode != BLEND_NONE || pipeline->blendMode != BLEND_NONE) { break; }
     if (b->draw.pipeline.depthTest == COMPARE_NONE || pipeline->depthTest == COMPARE_NONE) { break; }
     if (!req->instanced) { break; }
@@ -646,47 +1458,54 @@ next:
   // Figure out if a flush is necessary before mapping buffers for vertex data or UBOs.
   // - A flush is necessary if vertices are about to be written (during the first element of an
   //   instanced batch or any element of a stream batch) and any of the ranges go past the end.
-  // - If a new batch is required but there isn't space for it, flush to make space.
-  // - If a new batch is required, make sure there is space for the matrix/color UBO streams.
+  // - If a new batch is required but the batch limit has been reached, flush to make space.
+  // The matrix/color UBO streams are only written during the flush, so they don't matter here.
   // It's important to flush before mapping any streams, because flushing unmaps all streams.
+  FlushReason reason = FLUSH_STREAM;
   bool needFlush = false;
   bool hasVertices = req->vertexCount > 0 && (!req->instanced || !batch);
   bool hasIndices = hasVertices && req->indexCount > 0;
-  needFlush = needFlush || (hasVertices && state.head[STREAM_VERTEX] + req->vertexCount > bufferCount[STREAM_VERTEX]);
-  needFlush = needFlush || (hasVertices && state.head[STREAM_DRAWID] + req->vertexCount > bufferCount[STREAM_DRAWID]);
-  needFlush = needFlush || (hasIndices && state.head[STREAM_INDEX] + req->indexCount > bufferCount[STREAM_INDEX]);
-  needFlush = needFlush || (!batch && state.batchCount >= MAX_BATCHES);
-  needFlush = needFlush || (!batch && state.head[STREAM_MODEL] + MAX_DRAWS > bufferCount[STREAM_MODEL]);
-  needFlush = needFlush || (!batch && state.head[STREAM_COLOR] + MAX_DRAWS > bufferCount[STREAM_COLOR]);
-  if (needFlush) lovrGraphicsFlush();
-
-  if (req->vertexCount > 0 && (!req->instanced || !batch)) {
-    *(req->vertices) = lovrGraphicsMapBuffer(STREAM_VERTEX, req->vertexCount);
-    ids = lovrGraphicsMapBuffer(STREAM_DRAWID, req->vertexCount);
+  bool hasDrawIds = hasVertices && vertexStream == STREAM_VERTEX;
+  needFlush = needFlush || (hasVertices && state.head[vertexStream] + req->vertexCount > state.bufferCount[vertexStream]);
+  needFlush = needFlush || (hasDrawIds && state.head[STREAM_DRAWID] + req->vertexCount > state.bufferCount[STREAM_DRAWID]);
+  needFlush = needFlush || (hasIndices && state.head[STREAM_INDEX] + req->indexCount > state.bufferCount[STREAM_INDEX]);
+  if (!needFlush && !batch && state.batches.length >= state.batchLimit) {
+    needFlush = true;
+    reason = FLUSH_BATCH_LIMIT;
+  }
+  if (needFlush) lovrGraphicsFlushFor(reason);
+
+  if (hasVertices) {
+    *(req->vertices) = lovrGraphicsMapBuffer(vertexStream, req->vertexCount);
+    ids = hasDrawIds ? lovrGraphicsMapBuffer(STREAM_DRAWID, req->vertexCount) : NULL;
 
     if (req->indexCount > 0) {
       *(req->indices) = lovrGraphicsMapBuffer(STREAM_INDEX, req->indexCount);
-      *(req->baseVertex) = state.head[STREAM_VERTEX];
+      *(req->baseVertex) = state.head[vertexStream];
     }
   }
 
   // Start a new batch
-  if (!batch || state.batchCount == 0) {
-    float* transforms = lovrGraphicsMapBuffer(STREAM_MODEL, MAX_DRAWS);
-    Color* colors = lovrGraphicsMapBuffer(STREAM_COLOR, MAX_DRAWS);
-
+  if (!batch || state.batches.length == 0) {
     uint32_t rangeStart, rangeCount, instances;
     if (req->type == BATCH_MESH) {
       rangeStart = req->params.mesh.rangeStart;
       rangeCount = req->params.mesh.rangeCount;
       instances = req->instanced ? 0 : req->params.mesh.instances;
+    } else if (req->mesh) {
+      uint32_t indexCount = lovrMeshGetIndexCount(mesh);
+      rangeStart = 0;
+      rangeCount = indexCount > 0 ? indexCount : lovrMeshGetVertexCount(mesh);
+      instances = 0;
     } else {
-      rangeStart = req->indexCount > 0 ? state.head[STREAM_INDEX] : state.head[STREAM_VERTEX];
+      rangeStart = req->indexCount > 0 ? state.head[STREAM_INDEX] : state.head[vertexStream];
       rangeCount = 0;
       instances = 0;
     }
 
-    batch = &state.batches[state.batchCount++];
+    arr_reserve(&state.batchDraws, state.batches.length + 1);
+    arr_expand(&state.batches, 1);
+    batch = &state.batches.data[state.batches.length++];
     *batch = (Batch) {
       .type = req->type,
       .params = req->params,
@@ -701,27 +1520,44 @@ next:
         .instances = instances
       },
       .material = material,
-      .transforms = transforms,
-      .colors = colors,
-      .drawStart = state.head[STREAM_MODEL],
-      .indexed = req->indexCount > 0
+      .indexed = req->indexCount > 0,
+      .lines = mesh == state.lineMesh
     };
 
-    state.head[STREAM_MODEL] += MAX_DRAWS;
-    state.head[STREAM_COLOR] += MAX_DRAWS;
+    if (req->type == BATCH_INDIRECT) {
+      batch->draw.indirectBuffer = req->params.indirect.buffer;
+      batch->draw.indirectOffset = req->params.indirect.offset;
+      batch->draw.indirectCount = req->params.indirect.count;
+    } else if (req->type == BATCH_OCCLUSION) {
+      batch->draw.query = req->params.occlusion.query;
+    }
   }
 
+  BatchDraws* draws = &state.batchDraws.data[batch - state.batches.data];
+
   // Transform
-  if (req->transform) {
-    float transform[16];
-    mat4_mul(mat4_init(transform, state.transforms[state.transform]), req->transform);
-    memcpy(&batch->transforms[16 * batch->drawCount], transform, 16 * sizeof(float));
+  // Draws made without any transforms applied (common with an explicit transform per draw) skip
+  // the matrix multiply
+  if (req->transform && state.identity[state.transform]) {
+    mat4_init(draws->transforms[batch->drawCount], req->transform);
   } else {
-    memcpy(&batch->transforms[16 * batch->drawCount], state.transforms[state.transform], 16 * sizeof(float));
+    mat4_init(draws->transforms[batch->drawCount], state.transforms[state.transform]);
+    if (req->transform) {
+      mat4_mul(draws->transforms[batch->drawCount], req->transform);
+    }
   }
 
   // Color
-  batch->colors[batch->drawCount] = state.linearColor;
+  draws->colors[batch->drawCount] = state.linearColor;
+
+  // Material
+  memcpy(draws->materials[batch->drawCount], lovrMaterialGetDrawData(material), 12 * sizeof(float));
+
+  // Pose
+  if (req->pose) {
+    draws->poses[batch->drawCount] = (uint32_t) state.poses.length;
+    arr_append(&state.poses, req->pose, 16 * req->params.mesh.boneCount);
+  }
 
   // Cursors
   if (!req->instanced || batch->drawCount == 0) {
@@ -729,9 +1565,14 @@ next:
       memset(ids, batch->drawCount, req->vertexCount * sizeof(uint8_t));
     }
 
+    // Glyph vertices store their draw id inline, so the caller writes it with the vertices
+    if (req->drawId) {
+      *req->drawId = (uint8_t) batch->drawCount;
+    }
+
     batch->draw.rangeCount += batch->indexed ? req->indexCount : req->vertexCount;
-    state.head[STREAM_VERTEX] += req->vertexCount;
-    state.head[STREAM_DRAWID] += req->vertexCount;
+    state.head[vertexStream] += req->vertexCount;
+    state.head[STREAM_DRAWID] += hasDrawIds ? req->vertexCount : 0;
     state.head[STREAM_INDEX] += req->indexCount;
   }
 
@@ -740,119 +1581,850 @@ next:
   }
 
   batch->drawCount++;
+  lovrProfileEnd();
 }
 
-void lovrGraphicsFlush() {
-  if (state.batchCount == 0) {
-    return;
+static Mesh* lovrGraphicsCreateGeometry(BatchRequest* req, Tessellator tessellate) {
+  size_t stride = bufferStride[STREAM_VERTEX];
+  float* vertices = malloc(req->vertexCount * stride);
+  uint32_t* indices = req->indexCount > 0 ? malloc(req->indexCount * sizeof(uint32_t)) : NULL;
+  lovrAssert(vertices && (indices || req->indexCount == 0), "Out of memory");
+  tessellate(&req->params, vertices, indices, 0);
+
+  Buffer* vertexBuffer = lovrBufferCreate(req->vertexCount * stride, vertices, BUFFER_VERTEX, USAGE_STATIC, false);
+  Mesh* mesh = lovrMeshCreate(req->topology, vertexBuffer, req->vertexCount);
+  MeshAttribute position = { .buffer = vertexBuffer, .offset = 0, .stride = stride, .type = F32, .components = 3 };
+  MeshAttribute normal = { .buffer = vertexBuffer, .offset = 12, .stride = stride, .type = F32, .components = 3 };
+  MeshAttribute texCoord = { .buffer = vertexBuffer, .offset = 24, .stride = stride, .type = F32, .components = 2 };
+  MeshAttribute drawId = { .buffer = state.identityBuffer, .type = U8, .components = 1, .divisor = 1 };
+  lovrMeshAttachAttribute(mesh, "lovrPosition", &position);
+  lovrMeshAttachAttribute(mesh, "lovrNormal", &normal);
+  lovrMeshAttachAttribute(mesh, "lovrTexCoord", &texCoord);
+  lovrMeshAttachAttribute(mesh, "lovrDrawID", &drawId);
+  lovrRelease(vertexBuffer, lovrBufferDestroy);
+
+  if (indices) {
+    Buffer* indexBuffer = lovrBufferCreate(req->indexCount * sizeof(uint32_t), indices, BUFFER_INDEX, USAGE_STATIC, false);
+    lovrMeshSetIndexBuffer(mesh, indexBuffer, req->indexCount, sizeof(uint32_t), 0);
+    lovrRelease(indexBuffer, lovrBufferDestroy);
   }
 
-  // Prevent infinite flushing >_>
-  int batchCount = state.batchCount;
-  state.batchCount = 0;
+  free(vertices);
+  free(indices);
+  return mesh;
+}
 
-  if (state.frameDataDirty) {
-    state.frameDataDirty = false;
-    void* data = lovrGraphicsMapBuffer(STREAM_FRAME, 1);
-    memcpy(data, &state.frameData, sizeof(FrameData));
-    state.head[STREAM_FRAME]++;
-  }
+// Returns the cached Mesh for a primitive, or NULL if it should be streamed.  Geometry is only
+// uploaded the second time it's seen, so primitives whose parameters change every call (like
+// cylinders used as lines) keep streaming instead of churning through static Buffers.
+static Mesh* lovrGraphicsGetGeometry(BatchRequest* req, Tessellator tessellate) {
+  CachedGeometry* oldest = &state.geometry[0];
 
-  // Flush buffers
-  for (int i = 0; i < MAX_STREAMS; i++) {
-    lovrBufferFlush(state.buffers[i], state.tail[i] * bufferStride[i], (state.head[i] - state.tail[i]) * bufferStride[i]);
-    lovrBufferUnmap(state.buffers[i]);
-    state.tail[i] = state.head[i];
+  for (int i = 0; i < MAX_CACHED_GEOMETRY; i++) {
+    CachedGeometry* entry = &state.geometry[i];
+    if (entry->lastUsed > 0 && entry->type == req->type && !memcmp(&entry->params, &req->params, sizeof(BatchParams))) {
+      entry->lastUsed = ++state.geometryTick;
+      if (!entry->mesh) {
+        entry->mesh = lovrGraphicsCreateGeometry(req, tessellate);
+      }
+      return entry->mesh;
+    } else if (entry->lastUsed < oldest->lastUsed) {
+      oldest = entry;
+    }
+  }
+
+  lovrRelease(oldest->mesh, lovrMeshDestroy);
+  *oldest = (CachedGeometry) { .type = req->type, .params = req->params, .lastUsed = ++state.geometryTick };
+  return NULL;
+}
+
+static void lovrGraphicsPrimitive(BatchRequest* req, Tessellator tessellate) {
+  Mesh* mesh = lovrGraphicsGetGeometry(req, tessellate);
+
+  if (mesh) {
+    req->mesh = mesh;
+    req->vertexCount = 0;
+    req->indexCount = 0;
+    lovrGraphicsBatch(req);
+    return;
+  }
+
+  float* vertices = NULL;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
+  req->vertices = &vertices;
+  req->indices = &indices;
+  req->baseVertex = &baseVertex;
+  lovrGraphicsBatch(req);
+
+  if (vertices) {
+    tessellate(&req->params, vertices, indices, baseVertex);
   }
+}
 
-  for (int b = 0; b < batchCount; b++) {
-    Batch* batch = &state.batches[b];
+static bool canvasHasBatches(Canvas* canvas) {
+  for (int i = (int) state.batches.length - 1; i >= 0; i--) {
+    if (state.batches.data[i].draw.canvas == canvas) {
+      return true;
+    }
+  }
+  return false;
+}
 
-    // Uniforms
-    lovrMaterialBind(batch->material, batch->draw.shader);
-    lovrShaderSetBlock(batch->draw.shader, "lovrModelBlock", state.buffers[STREAM_MODEL], batch->drawStart * bufferStride[STREAM_MODEL], MAX_DRAWS * bufferStride[STREAM_MODEL], ACCESS_READ);
-    lovrShaderSetBlock(batch->draw.shader, "lovrColorBlock", state.buffers[STREAM_COLOR], batch->drawStart * bufferStride[STREAM_COLOR], MAX_DRAWS * bufferStride[STREAM_COLOR], ACCESS_READ);
-    lovrShaderSetBlock(batch->draw.shader, "lovrFrameBlock", state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
-    if (batch->type == BATCH_TEXT) {
-      Texture* texture = lovrMaterialGetTexture(batch->material, TEXTURE_DIFFUSE);
-      uint32_t width = lovrTextureGetWidth(texture, 0);
-      uint32_t height = lovrTextureGetHeight(texture, 0);
-      float range[2] = { batch->params.text.spread / width, batch->params.text.spread / height };
-      lovrShaderSetFloats(batch->draw.shader, "lovrSdfRange", range, 0, 2);
+static bool canvasWritesTexture(Canvas* canvas, Texture* texture) {
+  uint32_t count;
+  const Attachment* attachments = lovrCanvasGetAttachments(canvas, &count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (attachments[i].texture == texture) {
+      return true;
     }
-    if (batch->draw.topology == DRAW_POINTS) {
-      lovrShaderSetFloats(batch->draw.shader, "lovrPointSize", &state.pointSize, 0, 1);
+  }
+  return lovrCanvasGetDepthTexture(canvas) == texture;
+}
+
+// Invalidating attachments before clearing them lets tiled GPUs skip loading their old contents
+static void lovrGraphicsLoadPasses() {
+  for (size_t i = 0; i < state.passes.length; i++) {
+    DeferredPass* pass = &state.passes.data[i];
+    bool* clear = pass->info.clear;
+    if (!pass->loaded && (clear[0] || clear[1] || clear[2])) {
+      lovrGpuDiscard(pass->canvas, clear[0], clear[1], clear[2]);
+      lovrGpuClear(pass->canvas,
+        clear[0] ? &pass->info.clearColor : NULL,
+        clear[1] ? &pass->info.clearDepth : NULL,
+        clear[2] ? &pass->info.clearStencil : NULL);
     }
+    pass->loaded = true;
+  }
+}
 
-    // Other bindings (TODO try to get rid of all this!)
-    if (batch->type == BATCH_MESH) {
-      lovrMeshSetAttributeEnabled(batch->draw.mesh, "lovrDrawID", batch->params.mesh.instances <= 1);
-    } else {
-      if (batch->draw.mesh == state.instancedMesh && batch->draw.instances <= 1) {
-        batch->draw.mesh = state.mesh;
-      }
+// The pass being recorded keeps drawing after the flush, so it isn't stored until it ends.  Passes
+// that discard their color don't need to be resolved.
+static void lovrGraphicsStorePasses() {
+  size_t count = state.passes.length - state.inPass;
+  for (size_t i = 0; i < count; i++) {
+    DeferredPass* pass = &state.passes.data[i];
+    bool* discard = pass->info.discard;
+    if (!discard[0]) {
+      lovrCanvasResolve(pass->canvas);
+    }
+    if (discard[0] || discard[1] || discard[2]) {
+      lovrGpuDiscard(pass->canvas, discard[0], discard[1], discard[2]);
+    }
+    lovrRelease(pass->canvas, lovrCanvasDestroy);
+  }
+  arr_splice(&state.passes, 0, count);
+}
+
+void lovrGraphicsFlush() {
+  lovrGraphicsFlushFor(FLUSH_OTHER);
+}
+
+// Traces only see what reaches the GPU, so anything that's been batched is flushed first
+void lovrGraphicsStartTrace() {
+  lovrGraphicsFlush();
+  lovrGpuStartTrace(state.width, state.height);
+}
+
+Blob* lovrGraphicsStopTrace() {
+  lovrGraphicsFlush();
+  return lovrGpuStopTrace();
+}
+
+typedef struct {
+  double frameStart;
+  double total;
+  double min;
+  double max;
+  uint32_t frames;
+  uint64_t drawCalls;
+} ReplayTimes;
+
+// Waits for the GPU after every frame, so frame times include the GPU's work
+static void onReplayFrame(void* userdata) {
+  ReplayTimes* times = userdata;
+  times->drawCalls += lovrGpuGetStats()->drawCalls;
+  lovrGraphicsPresent(true);
+  lovrGpuFinish();
+  double now = os_get_time();
+  double time = now - times->frameStart;
+  times->total += time;
+  times->min = MIN(times->min, time);
+  times->max = MAX(times->max, time);
+  times->frames++;
+  times->frameStart = now;
+}
+
+// Replays a trace in a window of the size it was recorded at, without vsync, and prints the frame
+// times as JSON.  This doesn't need Lua or a project, so it can be used to compare builds, drivers,
+// or GPUs on the exact same frames.
+int lovrGraphicsReplay(const char* path, uint32_t loops) {
+  size_t size;
+  void* data = fs_map(path, &size);
+  lovrAssert(data, "Could not read trace '%s'", path);
+
+  TraceHeader header;
+  lovrAssert(size >= sizeof(header), "Trace '%s' is truncated", path);
+  memcpy(&header, data, sizeof(header));
+  lovrAssert(!memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)), "'%s' is not a trace", path);
+
+  lovrGraphicsInit(false, 0);
+  lovrGraphicsCreateWindow(&(WindowFlags) {
+    .width = header.width,
+    .height = header.height,
+    .vsync = 0,
+    .pacing = false,
+    .title = "LÖVR Replay"
+  });
+
+  ReplayTimes times = { .min = HUGE_VAL };
+  for (uint32_t i = 0; i < MAX(loops, 1); i++) {
+    times.frameStart = os_get_time();
+    lovrGpuReplay(data, size, onReplayFrame, &times);
+  }
+
+  printf("{\n  \"trace\": \"%s\",\n  \"width\": %u,\n  \"height\": %u,\n", path, header.width, header.height);
+  printf("  \"frames\": %u,\n  \"drawCalls\": %.1f,\n", times.frames, times.frames ? (double) times.drawCalls / times.frames : 0.);
+  printf("  \"meanMs\": %.3f,\n  \"minMs\": %.3f,\n  \"maxMs\": %.3f\n}\n",
+    times.frames ? times.total * 1e3 / times.frames : 0., times.frames ? times.min * 1e3 : 0., times.max * 1e3);
+
+  lovrGraphicsDestroy();
+  fs_unmap(data, size);
+  return times.frames > 0 ? 0 : 1;
+}
+
+// Flushes are only counted when there were batches to flush
+static void captureBatches(void);
+
+void lovrGraphicsFlushFor(FlushReason reason) {
+  if (state.recording) {
+    captureBatches();
+    return;
+  }
+
+  if (state.batches.length == 0) {
+    if (state.passes.length > 0) {
+      lovrGraphicsLoadPasses();
+      lovrGraphicsStorePasses();
+    }
+    return;
+  }
 
-      if (batch->indexed) {
-        lovrMeshSetIndexBuffer(batch->draw.mesh, state.buffers[STREAM_INDEX], bufferCount[STREAM_INDEX], sizeof(uint16_t), 0);
+  lovrGpuCountFlush(reason);
+
+  lovrProfileBegin("lovrGraphicsFlush");
+
+  // Prevent infinite flushing >_>
+  // The batch data stays valid during the flush since nothing is able to create new batches.
+  uint32_t batchCount = (uint32_t) state.batches.length;
+  Batch* batches = state.batches.data;
+  arr_clear(&state.batches);
+  lovrGraphicsLoadPasses();
+
+  // Figure out the order to draw the batches in.  The second half of the key array is scratch space.
+  BatchKey* keys = NULL;
+  uint32_t skinnedCount = 0;
+  for (uint32_t i = 0; i < batchCount; i++) {
+    skinnedCount += batches[i].type == BATCH_MESH && batches[i].params.mesh.boneCount > 0;
+  }
+
+  if (state.sorting) {
+    arr_reserve(&state.batchKeys, 2 * batchCount);
+    keys = state.batchKeys.data;
+    for (uint32_t i = 0; i < batchCount; i++) {
+      keys[i] = (BatchKey) { getBatchKey(&batches[i], i), i };
+    }
+    sortBatchKeys(keys, keys + batchCount, batchCount);
+  }
+
+  if (state.viewLatch && !state.canvas) {
+    state.viewLatch(state.frameData.viewMatrix);
+    state.frameDataDirty = true;
+  }
+
+  if (state.frameDataDirty || state.lightsDirty) {
+    state.lightsDirty = false;
+    lovrGraphicsUpdateLights();
+  }
+
+  if (state.frameDataDirty) {
+    state.frameDataDirty = false;
+    for (uint32_t i = 0; i < 2; i++) {
+      float* motion = state.frameData.motionTransform[i];
+      if (state.hasPreviousViewProjection[i]) {
+        float m[16];
+        mat4_init(m, state.frameData.projection[i]);
+        mat4_mul(m, state.frameData.viewMatrix[i]);
+        mat4_invert(m);
+        mat4_init(motion, state.previousViewProjection[i]);
+        mat4_mul(motion, m);
       } else {
-        lovrMeshSetIndexBuffer(batch->draw.mesh, NULL, 0, 0, 0);
+        mat4_identity(motion);
       }
     }
+    void* data = lovrGraphicsMapBuffer(STREAM_FRAME, 1);
+    memcpy(data, &state.frameData, sizeof(FrameData));
+    state.head[STREAM_FRAME]++;
+  }
 
-    lovrGpuDraw(&batch->draw);
+  // If the uniform streams are too small to hold the draw data of every batch, grow them.  If they
+  // can't grow any further, the batches get uploaded and drawn in multiple chunks.
+  lovrGraphicsGrowBuffer(STREAM_MODEL, batchCount * MAX_DRAWS);
+  lovrGraphicsGrowBuffer(STREAM_COLOR, batchCount * MAX_DRAWS);
+  lovrGraphicsGrowBuffer(STREAM_MATERIAL, batchCount * MAX_DRAWS);
+  lovrGraphicsGrowBuffer(STREAM_POSE, skinnedCount * MAX_BONES);
+
+  for (uint32_t start = 0, end = 0; start < batchCount; start = end) {
+
+    // Upload draw data for as many batches as will fit in the uniform streams
+    for (end = start; end < batchCount; end++) {
+      uint32_t index = keys ? keys[end].index : end;
+      Batch* batch = &batches[index];
+      BatchDraws* draws = &state.batchDraws.data[index];
+      uint32_t boneCount = batch->type == BATCH_MESH ? batch->params.mesh.boneCount : 0;
+
+      if (end > start && state.head[STREAM_MODEL] + MAX_DRAWS > state.bufferCount[STREAM_MODEL]) { break; }
+      if (end > start && state.head[STREAM_COLOR] + MAX_DRAWS > state.bufferCount[STREAM_COLOR]) { break; }
+      if (end > start && state.head[STREAM_MATERIAL] + MAX_DRAWS > state.bufferCount[STREAM_MATERIAL]) { break; }
+      if (end > start && boneCount > 0 && state.head[STREAM_POSE] + MAX_BONES > state.bufferCount[STREAM_POSE]) { break; }
+
+      float* transforms = lovrGraphicsMapBuffer(STREAM_MODEL, MAX_DRAWS);
+      Color* colors = lovrGraphicsMapBuffer(STREAM_COLOR, MAX_DRAWS);
+      float* materials = lovrGraphicsMapBuffer(STREAM_MATERIAL, MAX_DRAWS);
+      memcpy(transforms, draws->transforms, batch->drawCount * 16 * sizeof(float));
+      memcpy(colors, draws->colors, batch->drawCount * sizeof(Color));
+      memcpy(materials, draws->materials, batch->drawCount * 12 * sizeof(float));
+      batch->drawStart = state.head[STREAM_MODEL];
+      state.head[STREAM_MODEL] += MAX_DRAWS;
+      state.head[STREAM_COLOR] += MAX_DRAWS;
+      state.head[STREAM_MATERIAL] += MAX_DRAWS;
+
+      if (boneCount > 0) {
+        float* poses = lovrGraphicsMapBuffer(STREAM_POSE, MAX_BONES);
+        for (uint32_t i = 0; i < batch->drawCount; i++) {
+          memcpy(poses + 16 * boneCount * i, state.poses.data + draws->poses[i], 16 * boneCount * sizeof(float));
+        }
+        batch->poseStart = state.head[STREAM_POSE];
+        state.head[STREAM_POSE] += MAX_BONES;
+      }
+    }
+
+    // Flush buffers
+    for (int i = 0; i < MAX_STREAMS; i++) {
+      lovrBufferFlush(state.buffers[i], state.tail[i] * bufferStride[i], (state.head[i] - state.tail[i]) * bufferStride[i]);
+      lovrBufferUnmap(state.buffers[i]);
+      state.tail[i] = state.head[i];
+    }
+
+    // With the depth prepass, opaque batches are visited twice: first to draw them depth-only, then
+    // to draw them with an equal depth test, so only the front-most pixels get shaded
+    uint32_t count = end - start;
+    for (uint32_t i = state.depthPrepass ? 0 : count; i < 2 * count; i++) {
+      uint32_t b = start + i % count;
+      Batch* batch = &batches[keys ? keys[b].index : b];
+      bool prepass = state.depthPrepass && isPrepassBatch(batch);
+      bool depthOnly = i < count;
+      if (depthOnly && !prepass) continue;
+
+      // Uniforms
+      lovrMaterialBind(batch->material, batch->draw.shader);
+      lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_MODEL_BLOCK, state.buffers[STREAM_MODEL], batch->drawStart * bufferStride[STREAM_MODEL], MAX_DRAWS * bufferStride[STREAM_MODEL], ACCESS_READ);
+      lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_COLOR_BLOCK, state.buffers[STREAM_COLOR], batch->drawStart * bufferStride[STREAM_COLOR], MAX_DRAWS * bufferStride[STREAM_COLOR], ACCESS_READ);
+      lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_MATERIAL_BLOCK, state.buffers[STREAM_MATERIAL], batch->drawStart * bufferStride[STREAM_MATERIAL], MAX_DRAWS * bufferStride[STREAM_MATERIAL], ACCESS_READ);
+      lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_FRAME_BLOCK, state.buffers[STREAM_FRAME], (state.head[STREAM_FRAME] - 1) * bufferStride[STREAM_FRAME], bufferStride[STREAM_FRAME], ACCESS_READ);
+      lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_LIGHT_BLOCK, state.buffers[STREAM_LIGHT], (state.head[STREAM_LIGHT] - 1) * bufferStride[STREAM_LIGHT], bufferStride[STREAM_LIGHT], ACCESS_READ);
+      int poseStride = batch->type == BATCH_MESH ? (int) batch->params.mesh.boneCount : 0;
+      if (poseStride > 0) {
+        lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_POSE_BLOCK, state.buffers[STREAM_POSE], batch->poseStart * bufferStride[STREAM_POSE], MAX_BONES * bufferStride[STREAM_POSE], ACCESS_READ);
+      } else {
+        lovrShaderSetBuiltinBlock(batch->draw.shader, BUILTIN_POSE_BLOCK, state.identityPose, 0, MAX_BONES * bufferStride[STREAM_POSE], ACCESS_READ);
+      }
+      lovrShaderSetBuiltin(batch->draw.shader, BUILTIN_POSE_STRIDE, UNIFORM_INT, &poseStride, 0, 1);
+      if (batch->type == BATCH_TEXT) {
+        Texture* texture = lovrMaterialGetTexture(batch->material, TEXTURE_DIFFUSE);
+        uint32_t width = lovrTextureGetWidth(texture, 0);
+        uint32_t height = lovrTextureGetHeight(texture, 0);
+        float range[2] = { batch->params.text.spread / width, batch->params.text.spread / height };
+        lovrShaderSetBuiltin(batch->draw.shader, BUILTIN_SDF_RANGE, UNIFORM_FLOAT, range, 0, 2);
+      }
+      if (batch->draw.topology == DRAW_POINTS) {
+        lovrShaderSetBuiltin(batch->draw.shader, BUILTIN_POINT_SIZE, UNIFORM_FLOAT, &state.pointSize, 0, 1);
+      }
+      if (batch->lines) {
+        float size[2] = { lovrCanvasGetWidth(batch->draw.canvas), lovrCanvasGetHeight(batch->draw.canvas) };
+        size[0] /= lovrCanvasIsStereo(batch->draw.canvas) ? 2.f : 1.f;
+        lovrShaderSetBuiltin(batch->draw.shader, BUILTIN_LINE_WIDTH, UNIFORM_FLOAT, &batch->params.lines.width, 0, 1);
+        lovrShaderSetBuiltin(batch->draw.shader, BUILTIN_VIEWPORT_SIZE, UNIFORM_FLOAT, size, 0, 2);
+      }
+
+      // Other bindings (TODO try to get rid of all this!)
+      if (batch->type == BATCH_MESH) {
+        lovrMeshSetAttributeEnabled(batch->draw.mesh, "lovrDrawID", batch->params.mesh.instances <= 1);
+      } else if (batch->type == BATCH_INDIRECT) {
+        lovrMeshSetAttributeEnabled(batch->draw.mesh, "lovrDrawID", false);
+      } else if (batch->lines) {
+        uint32_t start = batch->draw.rangeStart;
+        uint32_t end = batch->type == BATCH_LINES ? start + 1 : start;
+        size_t stride = bufferStride[STREAM_VERTEX];
+        lovrMeshSetAttributeOffset(batch->draw.mesh, "lovrPosition", start * stride);
+        lovrMeshSetAttributeOffset(batch->draw.mesh, "lovrLineEnd", end * stride);
+        lovrMeshSetAttributeOffset(batch->draw.mesh, "lovrDrawID", start);
+        lovrMeshSetAttributeOffset(batch->draw.mesh, "lovrLineEndID", end);
+        batch->draw.instances = batch->draw.rangeCount - (end - start);
+        batch->draw.rangeStart = 0;
+        batch->draw.rangeCount = 6;
+        if (batch->draw.instances == 0) continue;
+      } else if (batch->draw.mesh == state.mesh || batch->draw.mesh == state.instancedMesh || batch->draw.mesh == state.glyphMesh) {
+        if (batch->draw.mesh == state.instancedMesh && batch->draw.instances <= 1) {
+          batch->draw.mesh = state.mesh;
+        }
+
+        if (batch->indexed) {
+          lovrMeshSetIndexBuffer(batch->draw.mesh, state.buffers[STREAM_INDEX], state.bufferCount[STREAM_INDEX], sizeof(uint32_t), 0);
+        } else {
+          lovrMeshSetIndexBuffer(batch->draw.mesh, NULL, 0, 0, 0);
+        }
+      }
+
+      if (prepass) {
+        DrawCommand draw = batch->draw;
+        draw.depthOnly = depthOnly;
+        if (depthOnly) {
+          draw.pipeline.colorMask = 0;
+        } else {
+          draw.pipeline.depthTest = COMPARE_EQUAL;
+          draw.pipeline.depthWrite = false;
+        }
+        lovrGpuDraw(&draw);
+      } else {
+        lovrGpuDraw(&batch->draw);
+      }
+    }
   }
+
+  arr_clear(&state.poses);
+  lovrGraphicsStorePasses();
+  lovrProfileEnd();
 }
 
 void lovrGraphicsFlushCanvas(Canvas* canvas) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
-    if (state.batches[i].draw.canvas == canvas) {
-      lovrGraphicsFlush();
-      return;
-    }
+  if (canvasHasBatches(canvas)) {
+    lovrGraphicsFlushFor(FLUSH_CANVAS);
   }
 }
 
 void lovrGraphicsFlushShader(Shader* shader) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
-    if (state.batches[i].draw.shader == shader) {
-      lovrGraphicsFlush();
+  for (int i = (int) state.batches.length - 1; i >= 0; i--) {
+    if (state.batches.data[i].draw.shader == shader) {
+      lovrGraphicsFlushFor(FLUSH_SHADER);
       return;
     }
   }
 }
 
 void lovrGraphicsFlushMaterial(Material* material) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
-    if (state.batches[i].material == material) {
-      lovrGraphicsFlush();
+  for (int i = (int) state.batches.length - 1; i >= 0; i--) {
+    if (state.batches.data[i].material == material) {
+      lovrGraphicsFlushFor(FLUSH_MATERIAL);
       return;
     }
   }
 }
 
 void lovrGraphicsFlushMesh(Mesh* mesh) {
-  for (int i = state.batchCount - 1; i >= 0; i--) {
-    if (state.batches[i].draw.mesh == mesh) {
-      lovrGraphicsFlush();
+  for (int i = (int) state.batches.length - 1; i >= 0; i--) {
+    if (state.batches.data[i].draw.mesh == mesh) {
+      lovrGraphicsFlushFor(FLUSH_MESH);
       return;
     }
   }
 }
 
+void lovrGraphicsFlushBuffer(Buffer* buffer) {
+  for (int i = (int) state.batches.length - 1; i >= 0; i--) {
+    if (state.batches.data[i].draw.indirectBuffer == buffer) {
+      lovrGraphicsFlushFor(FLUSH_BUFFER);
+      return;
+    }
+  }
+}
+
+// DrawList
+
+DrawList* lovrDrawListCreate(void) {
+  DrawList* list = calloc(1, sizeof(DrawList));
+  lovrAssert(list, "Out of memory");
+  list->ref = LOVR_REF_LOCAL | 1;
+  arr_init(&list->batches, realloc);
+  arr_init(&list->transforms, realloc);
+  arr_init(&list->colors, realloc);
+  arr_init(&list->materials, realloc);
+  arr_init(&list->poses, realloc);
+  for (int i = 0; i < MAX_GEOMETRY_STREAMS; i++) {
+    arr_init(&list->streams[i], realloc);
+  }
+  return list;
+}
+
+static void clearDrawList(DrawList* list) {
+  for (size_t i = 0; i < list->batches.length; i++) {
+    RecordedBatch* recorded = &list->batches.data[i];
+    if (recorded->mesh == LIST_MESH_NONE) lovrRelease(recorded->batch.draw.mesh, lovrMeshDestroy);
+    if (recorded->defaultShader < 0) lovrRelease(recorded->batch.draw.shader, lovrShaderDestroy);
+    lovrRelease(recorded->batch.material, lovrMaterialDestroy);
+  }
+  for (int i = 0; i < MAX_GEOMETRY_STREAMS; i++) {
+    lovrRelease(list->buffers[i], lovrBufferDestroy);
+    list->buffers[i] = NULL;
+    arr_clear(&list->streams[i]);
+  }
+  lovrRelease(list->mesh, lovrMeshDestroy);
+  lovrRelease(list->instancedMesh, lovrMeshDestroy);
+  lovrRelease(list->glyphMesh, lovrMeshDestroy);
+  lovrRelease(list->lineMesh, lovrMeshDestroy);
+  list->mesh = list->instancedMesh = list->glyphMesh = list->lineMesh = NULL;
+  arr_clear(&list->batches);
+  arr_clear(&list->transforms);
+  arr_clear(&list->colors);
+  arr_clear(&list->materials);
+  arr_clear(&list->poses);
+}
+
+void lovrDrawListDestroy(void* ref) {
+  DrawList* list = ref;
+  clearDrawList(list);
+  arr_free(&list->batches);
+  arr_free(&list->transforms);
+  arr_free(&list->colors);
+  arr_free(&list->materials);
+  arr_free(&list->poses);
+  for (int i = 0; i < MAX_GEOMETRY_STREAMS; i++) {
+    arr_free(&list->streams[i]);
+  }
+  free(list);
+}
+
+uint32_t lovrDrawListGetBatchCount(DrawList* list) {
+  return (uint32_t) list->batches.length;
+}
+
+uint32_t lovrDrawListGetDrawCount(DrawList* list) {
+  return (uint32_t) list->colors.length;
+}
+
+bool lovrGraphicsIsRecording() {
+  return state.recording != NULL;
+}
+
+// The geometry streams start over at zero while recording, so the vertex and index ranges of the
+// recorded batches are already relative to the arrays of the list
+void lovrGraphicsBeginDrawList(DrawList* list) {
+  lovrAssert(!state.recording, "DrawLists can not be recorded while another DrawList is recording");
+  lovrAssert(!state.inPass, "DrawLists can not be recorded during a pass");
+  lovrGraphicsFlush();
+  clearDrawList(list);
+  for (int i = 0; i < MAX_GEOMETRY_STREAMS; i++) {
+    state.savedHead[i] = state.head[i];
+    state.savedTail[i] = state.tail[i];
+    state.savedCount[i] = state.bufferCount[i];
+    state.head[i] = state.tail[i] = 0;
+    state.bufferCount[i] = 1u << 30;
+  }
+  state.recording = list;
+}
+
+// Moves the batches into the recording DrawList.  Textures set on the default Material can change
+// after the list is recorded, so batches using it get their own Material with the same texture.
+static void captureBatches(void) {
+  DrawList* list = state.recording;
+  uint32_t batchCount = (uint32_t) state.batches.length;
+  Batch* batches = state.batches.data;
+  arr_clear(&state.batches);
+
+  for (uint32_t i = 0; i < batchCount; i++) {
+    BatchType type = batches[i].type;
+    if (type == BATCH_SKYBOX || type == BATCH_MASK || type == BATCH_INDIRECT || type == BATCH_OCCLUSION) {
+      arr_clear(&state.poses);
+      lovrThrow("Skyboxes, indirect draws, and occlusion queries can not be recorded in a DrawList");
+    }
+  }
+
+  for (uint32_t i = 0; i < batchCount; i++) {
+    Batch batch = batches[i];
+    BatchDraws* draws = &state.batchDraws.data[i];
+
+    ListMesh mesh = LIST_MESH_NONE;
+    if (batch.draw.mesh == state.mesh) {
+      mesh = LIST_MESH_TRIANGLES;
+    } else if (batch.draw.mesh == state.instancedMesh) {
+      mesh = batch.draw.instances <= 1 ? LIST_MESH_TRIANGLES : LIST_MESH_INSTANCED;
+    } else if (batch.draw.mesh == state.glyphMesh) {
+      mesh = LIST_MESH_GLYPHS;
+    } else if (batch.draw.mesh == state.lineMesh) {
+      mesh = LIST_MESH_LINES;
+    } else {
+      lovrRetain(batch.draw.mesh);
+    }
+
+    if (mesh != LIST_MESH_NONE && mesh != LIST_MESH_LINES && !batch.indexed) {
+      uint32_t* indices = lovrGraphicsMapBuffer(STREAM_INDEX, batch.draw.rangeCount);
+      for (uint32_t j = 0; j < batch.draw.rangeCount; j++) {
+        indices[j] = batch.draw.rangeStart + j;
+      }
+      batch.draw.rangeStart = state.head[STREAM_INDEX];
+      state.head[STREAM_INDEX] += batch.draw.rangeCount;
+      batch.indexed = true;
+    }
+
+    if (batch.material == state.defaultMaterial) {
+      Material* material = lovrMaterialCreate();
+      lovrMaterialSetTexture(material, TEXTURE_DIFFUSE, lovrMaterialGetTexture(batch.material, TEXTURE_DIFFUSE));
+      batch.material = material;
+    } else {
+      lovrRetain(batch.material);
+    }
+
+    int defaultShader = -1;
+    for (int j = 0; j < MAX_DEFAULT_SHADERS; j++) {
+      if (batch.draw.shader == state.defaultShaders[j][false] || batch.draw.shader == state.defaultShaders[j][true]) {
+        defaultShader = j;
+        break;
+      }
+    }
+
+    if (defaultShader < 0) {
+      lovrRetain(batch.draw.shader);
+    }
+
+    uint32_t drawStart = (uint32_t) list->colors.length;
+    uint32_t poseStart = (uint32_t) list->poses.length;
+    arr_append(&list->transforms, draws->transforms[0], 16 * batch.drawCount);
+    arr_append(&list->colors, draws->colors, batch.drawCount);
+    arr_append(&list->materials, draws->materials[0], 12 * batch.drawCount);
+
+    uint32_t boneCount = batch.type == BATCH_MESH ? batch.params.mesh.boneCount : 0;
+    for (uint32_t j = 0; j < batch.drawCount && boneCount > 0; j++) {
+      arr_append(&list->poses, state.poses.data + draws->poses[j], 16 * boneCount);
+    }
+
+    arr_push(&list->batches, ((RecordedBatch) {
+      .batch = batch,
+      .mesh = mesh,
+      .defaultShader = defaultShader,
+      .drawStart = drawStart,
+      .poseStart = poseStart
+    }));
+  }
+
+  arr_clear(&state.poses);
+}
+
+void lovrGraphicsEndDrawList() {
+  DrawList* list = state.recording;
+  lovrAssert(list, "No DrawList is being recorded");
+  lovrGraphicsFlush();
+  state.recording = NULL;
+
+  uint32_t counts[MAX_GEOMETRY_STREAMS];
+  for (int i = 0; i < MAX_GEOMETRY_STREAMS; i++) {
+    counts[i] = state.head[i];
+    state.head[i] = state.savedHead[i];
+    state.tail[i] = state.savedTail[i];
+    state.bufferCount[i] = state.savedCount[i];
+
+    if (counts[i] > 0) {
+      list->buffers[i] = lovrBufferCreate(counts[i] * bufferStride[i], list->streams[i].data, bufferType[i], USAGE_STATIC, false);
+    }
+
+    arr_free(&list->streams[i]);
+    arr_init(&list->streams[i], realloc);
+  }
+
+  bool used[LIST_MESH_LINES + 1] = { 0 };
+  for (size_t i = 0; i < list->batches.length; i++) {
+    used[list->batches.data[i].mesh] = true;
+  }
+
+  createStreamMeshes(list->buffers,
+    used[LIST_MESH_TRIANGLES] ? &list->mesh : NULL,
+    used[LIST_MESH_INSTANCED] ? &list->instancedMesh : NULL,
+    used[LIST_MESH_GLYPHS] ? &list->glyphMesh : NULL,
+    used[LIST_MESH_LINES] ? &list->lineMesh : NULL);
+
+  Mesh* meshes[] = {
+    [LIST_MESH_NONE] = NULL,
+    [LIST_MESH_TRIANGLES] = list->mesh,
+    [LIST_MESH_INSTANCED] = list->instancedMesh,
+    [LIST_MESH_GLYPHS] = list->glyphMesh,
+    [LIST_MESH_LINES] = list->lineMesh
+  };
+
+  for (int i = LIST_MESH_TRIANGLES; i <= LIST_MESH_GLYPHS; i++) {
+    if (meshes[i]) {
+      lovrMeshSetIndexBuffer(meshes[i], list->buffers[STREAM_INDEX], counts[STREAM_INDEX], sizeof(uint32_t), 0);
+    }
+  }
+
+  for (size_t i = 0; i < list->batches.length; i++) {
+    RecordedBatch* recorded = &list->batches.data[i];
+    if (recorded->mesh != LIST_MESH_NONE) {
+      recorded->batch.draw.mesh = meshes[recorded->mesh];
+    }
+  }
+}
+
+// The batches of the list are added as they are, so they don't merge with other draws.  The draws
+// are transformed by the current transform and the parent transform, if there is one.
+void lovrGraphicsDrawList(DrawList* list, mat4 transform) {
+  lovrAssert(list != state.recording, "A DrawList can not draw itself while it's being recorded");
+
+  if (state.passes.length > 0 && !state.inPass) {
+    lovrGraphicsFlush();
+  }
+
+  Canvas* canvas = state.canvas ? state.canvas : state.backbuffer;
+  bool stereo = lovrCanvasIsStereo(canvas);
+  bool identity = state.identity[state.transform] && !transform;
+  float parent[16];
+  mat4_init(parent, state.transforms[state.transform]);
+  if (transform) {
+    mat4_mul(parent, transform);
+  }
+
+  for (size_t i = 0; i < list->batches.length; i++) {
+    RecordedBatch* recorded = &list->batches.data[i];
+    int s = recorded->defaultShader;
+    if (s >= 0 && !state.defaultShaders[s][stereo]) {
+      state.defaultShaders[s][stereo] = lovrShaderCreateDefault(s, NULL, 0, stereo);
+    }
+
+    if (state.batches.length >= state.batchLimit) {
+      lovrGraphicsFlushFor(FLUSH_BATCH_LIMIT);
+    }
+
+    arr_reserve(&state.batchDraws, state.batches.length + 1);
+    arr_expand(&state.batches, 1);
+    BatchDraws* draws = &state.batchDraws.data[state.batches.length];
+    Batch* batch = &state.batches.data[state.batches.length++];
+    *batch = recorded->batch;
+    batch->draw.canvas = canvas;
+    batch->draw.shader = s >= 0 ? state.defaultShaders[s][stereo] : recorded->batch.draw.shader;
+
+    uint32_t count = batch->drawCount;
+    float* transforms = list->transforms.data + 16 * recorded->drawStart;
+    if (identity) {
+      memcpy(draws->transforms, transforms, count * 16 * sizeof(float));
+    } else {
+      for (uint32_t j = 0; j < count; j++) {
+        mat4_init(draws->transforms[j], parent);
+        mat4_mul(draws->transforms[j], transforms + 16 * j);
+      }
+    }
+
+    memcpy(draws->colors, list->colors.data + recorded->drawStart, count * sizeof(Color));
+    memcpy(draws->materials, list->materials.data + 12 * recorded->drawStart, count * 12 * sizeof(float));
+
+    uint32_t boneCount = batch->type == BATCH_MESH ? batch->params.mesh.boneCount : 0;
+    if (boneCount > 0) {
+      for (uint32_t j = 0; j < count; j++) {
+        draws->poses[j] = (uint32_t) state.poses.length + 16 * boneCount * j;
+      }
+      arr_append(&state.poses, list->poses.data + recorded->poseStart, 16 * boneCount * count);
+    }
+  }
+}
+
 void lovrGraphicsClear(Color* color, float* depth, int* stencil) {
+  lovrAssert(!state.recording, "Clears can not be recorded in a DrawList");
 #if !defined(LOVR_WEBGL) && !defined(LOVR_USE_PICO)
   if (color) gammaCorrect(color);
 #endif
+
+  // A clear before anything is drawn in a pass becomes part of the pass instead of flushing it
+  if (state.inPass) {
+    DeferredPass* pass = &state.passes.data[state.passes.length - 1];
+    if (!pass->loaded && !canvasHasBatches(pass->canvas)) {
+      if (color) pass->info.clear[0] = true, pass->info.clearColor = *color;
+      if (depth) pass->info.clear[1] = true, pass->info.clearDepth = *depth;
+      if (stencil) pass->info.clear[2] = true, pass->info.clearStencil = *stencil;
+      return;
+    }
+  }
+
   if (color || depth || stencil) lovrGraphicsFlush();
   lovrGpuClear(state.canvas ? state.canvas : state.backbuffer, color, depth, stencil);
 }
 
 void lovrGraphicsDiscard(bool color, bool depth, bool stencil) {
+  lovrAssert(!state.recording, "Discards can not be recorded in a DrawList");
   if (color || depth || stencil) lovrGraphicsFlush();
   lovrGpuDiscard(state.canvas ? state.canvas : state.backbuffer, color, depth, stencil);
 }
 
+void lovrGraphicsPass(Canvas* canvas, Pass* pass, PassCallback callback, void* userdata) {
+  lovrAssert(!state.inPass, "Passes can not be nested");
+  lovrAssert(!state.recording, "Passes can not be recorded in a DrawList");
+
+  // Passes are deferred until something needs their results, so the draws of independent passes
+  // are flushed (and sorted) together.  A pass that draws to the Canvas of a deferred pass or reads
+  // from one of its Textures has to wait for it, as does a pass reading from the active Canvas.
+  bool dependent = false;
+  for (size_t i = 0; i < state.passes.length && !dependent; i++) {
+    dependent = state.passes.data[i].canvas == canvas;
+    for (uint32_t j = 0; j < pass->readCount && !dependent; j++) {
+      dependent = canvasWritesTexture(state.passes.data[i].canvas, pass->reads[j]);
+    }
+  }
+
+  bool readsCanvas = false;
+  for (uint32_t i = 0; state.canvas && i < pass->readCount && !readsCanvas; i++) {
+    readsCanvas = canvasWritesTexture(state.canvas, pass->reads[i]);
+  }
+
+  if (dependent || readsCanvas) {
+    lovrGraphicsFlush();
+  } else {
+    lovrGraphicsFlushCanvas(canvas);
+  }
+
+  if (readsCanvas) {
+    lovrCanvasResolve(state.canvas);
+  }
+
+  DeferredPass deferred = { .canvas = canvas, .info = *pass };
+#if !defined(LOVR_WEBGL) && !defined(LOVR_USE_PICO)
+  if (pass->clear[0]) gammaCorrect(&deferred.info.clearColor);
+#endif
+  lovrRetain(canvas);
+  arr_push(&state.passes, deferred);
+
+  Canvas* previous = state.canvas;
+  state.canvas = canvas;
+  state.inPass = true;
+  callback(userdata);
+  state.inPass = false;
+  state.canvas = previous;
+}
+
+// Points and lines are expanded into quads on the GPU unless there's a custom shader, which would
+// not know how to do the expansion.
 void lovrGraphicsPoints(uint32_t count, float** vertices) {
+  if (!state.shader) {
+    Pipeline pipeline = state.pipeline;
+    pipeline.culling = false;
+    pipeline.wireframe = false;
+    lovrGraphicsBatch(&(BatchRequest) {
+      .type = BATCH_POINTS,
+      .params.lines.width = state.pointSize,
+      .topology = DRAW_TRIANGLES,
+      .shader = SHADER_LINE,
+      .pipeline = &pipeline,
+      .vertexCount = count,
+      .vertices = vertices
+    });
+    return;
+  }
+
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_POINTS,
     .topology = DRAW_POINTS,
@@ -862,9 +2434,25 @@ void lovrGraphicsPoints(uint32_t count, float** vertices) {
 }
 
 void lovrGraphicsLine(uint32_t count, float** vertices) {
+  if (!state.shader) {
+    Pipeline pipeline = state.pipeline;
+    pipeline.culling = false;
+    pipeline.wireframe = false;
+    lovrGraphicsBatch(&(BatchRequest) {
+      .type = BATCH_LINES,
+      .params.lines.width = state.pipeline.lineWidth,
+      .topology = DRAW_TRIANGLES,
+      .shader = SHADER_LINE,
+      .pipeline = &pipeline,
+      .vertexCount = count,
+      .vertices = vertices
+    });
+    return;
+  }
+
   uint32_t indexCount = count + 1;
-  uint16_t* indices;
-  uint16_t baseVertex;
+  uint32_t* indices;
+  uint32_t baseVertex;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_LINES,
@@ -876,7 +2464,7 @@ void lovrGraphicsLine(uint32_t count, float** vertices) {
     .baseVertex = &baseVertex
   });
 
-  indices[0] = 0xffff;
+  indices[0] = 0xffffffff;
   for (uint32_t i = 1; i < indexCount; i++) {
     indices[i] = baseVertex + i - 1;
   }
@@ -884,8 +2472,8 @@ void lovrGraphicsLine(uint32_t count, float** vertices) {
 
 void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, float u, float v, float w, float h) {
   float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_PLANE,
@@ -910,7 +2498,7 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
 
     memcpy(vertices, vertexData, sizeof(vertexData));
 
-    indices[0] = 0xffff;
+    indices[0] = 0xffffffff;
     indices[1] = 0 + baseVertex;
     indices[2] = 1 + baseVertex;
     indices[3] = 2 + baseVertex;
@@ -935,8 +2523,8 @@ void lovrGraphicsPlane(DrawStyle style, Material* material, mat4 transform, floa
 
 void lovrGraphicsBox(DrawStyle style, Material* material, mat4 transform) {
   float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
 
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_BOX,
@@ -1022,6 +2610,28 @@ void lovrGraphicsBox(DrawStyle style, Material* material, mat4 transform) {
   }
 }
 
+static void tessellateArc(BatchParams* params, float* vertices, uint32_t* indices, uint32_t baseVertex) {
+  float r1 = params->arc.r1;
+  float r2 = params->arc.r2;
+  int segments = params->arc.segments;
+
+  if (params->arc.mode == ARC_MODE_PIE && fabsf(r1 - r2) < 2.f * (float) M_PI) {
+    memcpy(vertices, ((float[]) { 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, .5f, .5f }), 8 * sizeof(float));
+    vertices += 8;
+  }
+
+  float theta = r1;
+  float angleShift = (r2 - r1) / (float) segments;
+
+  for (int i = 0; i <= segments; i++) {
+    float x = cosf(theta);
+    float y = sinf(theta);
+    memcpy(vertices, ((float[]) { x, y, 0.f, 0.f, 0.f, 1.f, (1.f + x) * .5f, (1.f - y) * .5f }), 8 * sizeof(float));
+    vertices += 8;
+    theta += angleShift;
+  }
+}
+
 void lovrGraphicsArc(DrawStyle style, ArcMode mode, Material* material, mat4 transform, float r1, float r2, int segments) {
   bool hasCenterPoint = false;
 
@@ -1032,10 +2642,7 @@ void lovrGraphicsArc(DrawStyle style, ArcMode mode, Material* material, mat4 tra
     hasCenterPoint = mode == ARC_MODE_PIE;
   }
 
-  uint32_t vertexCount = segments + 1 + hasCenterPoint;
-  float* vertices = NULL;
-
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_ARC,
     .params.arc.r1 = r1,
     .params.arc.r2 = r2,
@@ -1045,32 +2652,85 @@ void lovrGraphicsArc(DrawStyle style, ArcMode mode, Material* material, mat4 tra
     .topology = style == STYLE_LINE ? (mode == ARC_MODE_OPEN ? DRAW_LINE_STRIP : DRAW_LINE_LOOP) : DRAW_TRIANGLE_FAN,
     .material = material,
     .transform = transform,
-    .vertexCount = vertexCount,
-    .vertices = &vertices,
+    .vertexCount = segments + 1 + hasCenterPoint,
     .instanced = true
-  });
+  }, tessellateArc);
+}
 
-  if (vertices) {
-    if (hasCenterPoint) {
-      memcpy(vertices, ((float[]) { 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, .5f, .5f }), 8 * sizeof(float));
+void lovrGraphicsCircle(DrawStyle style, Material* material, mat4 transform, int segments) {
+  lovrGraphicsArc(style, ARC_MODE_OPEN, material, transform, 0, 2.f * (float) M_PI, segments);
+}
+
+static void tessellateCylinder(BatchParams* params, float* vertices, uint32_t* indices, uint32_t baseVertex) {
+  float r1 = params->cylinder.r1;
+  float r2 = params->cylinder.r2;
+  bool capped = params->cylinder.capped;
+  int segments = params->cylinder.segments;
+  float* v = vertices;
+
+  // Ring
+  for (int i = 0; i <= segments; i++) {
+    float t = (float) i / segments;
+    float theta = t * (2 * M_PI);
+    float X = cosf(theta);
+    float Y = sinf(theta);
+    memcpy(vertices, (float[16]) {
+      r1 * X, r1 * Y, -.5f, X, Y, 0.f, 1.f - t, 1.f,
+      r2 * X, r2 * Y,  .5f, X, Y, 0.f, 1.f - t, 0.f
+    }, 16 * sizeof(float));
+    vertices += 16;
+  }
+
+  // Top
+  int top = (segments + 1) * 2 + baseVertex;
+  if (capped && r1 != 0) {
+    memcpy(vertices, (float[8]) { 0.f, 0.f, -.5f, 0.f, 0.f, -1.f, .5f, .5f }, 8 * sizeof(float));
+    vertices += 8;
+    for (int i = 0; i <= segments; i++) {
+      int j = i * 2 * 8;
+      float x = v[j + 0];
+      float y = v[j + 1];
+      float z = v[j + 2];
+      float u = 1.f - (x / r1 * .5 + .5);
+      float v = y / r1 * .5 + .5;
+      memcpy(vertices, (float[8]) { x, y, z, 0.f, 0.f, -1.f, u, v }, 8 * sizeof(float));
       vertices += 8;
     }
+  }
 
-    float theta = r1;
-    float angleShift = (r2 - r1) / (float) segments;
-
+  // Bottom
+  int bot = (segments + 1) * 2 + (1 + segments + 1) * (capped && r1 != 0) + baseVertex;
+  if (capped && r2 != 0) {
+    memcpy(vertices, (float[8]) { 0.f, 0.f, .5f, 0.f, 0.f, 1.f, .5f, .5f }, 8 * sizeof(float));
+    vertices += 8;
     for (int i = 0; i <= segments; i++) {
-      float x = cosf(theta);
-      float y = sinf(theta);
-      memcpy(vertices, ((float[]) { x, y, 0.f, 0.f, 0.f, 1.f, (1.f + x) * .5f, (1.f - y) * .5f }), 8 * sizeof(float));
+      int j = i * 2 * 8 + 8;
+      float x = v[j + 0];
+      float y = v[j + 1];
+      float z = v[j + 2];
+      float u = x / r1 * .5 + .5;
+      float v = y / r1 * .5 + .5;
+      memcpy(vertices, (float[8]) { x, y, z, 0.f, 0.f, 1.f, u, v }, 8 * sizeof(float));
       vertices += 8;
-      theta += angleShift;
     }
   }
-}
 
-void lovrGraphicsCircle(DrawStyle style, Material* material, mat4 transform, int segments) {
-  lovrGraphicsArc(style, ARC_MODE_OPEN, material, transform, 0, 2.f * (float) M_PI, segments);
+  // Indices
+  for (int i = 0; i < segments; i++) {
+    int j = 2 * i + baseVertex;
+    memcpy(indices, (uint32_t[6]) { j, j + 2, j + 1, j + 1, j + 2, j + 3 }, 6 * sizeof(uint32_t));
+    indices += 6;
+
+    if (capped && r1 != 0.f) {
+      memcpy(indices, (uint32_t[3]) { top, top + i + 2, top + i + 1 }, 3 * sizeof(uint32_t));
+      indices += 3;
+    }
+
+    if (capped && r2 != 0.f) {
+      memcpy(indices, (uint32_t[3]) { bot, bot + i + 1, bot + i + 2 }, 3 * sizeof(uint32_t));
+      indices += 3;
+    }
+  }
 }
 
 void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2, bool capped, int segments) {
@@ -1078,13 +2738,7 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
   r1 /= length;
   r2 /= length;
 
-  uint32_t vertexCount = ((capped && r1) * (segments + 2) + (capped && r2) * (segments + 2) + 2 * (segments + 1));
-  uint32_t indexCount = 3 * segments * ((capped && r1) + (capped && r2) + 2);
-  float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
-
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_CYLINDER,
     .params.cylinder.r1 = r1,
     .params.cylinder.r2 = r2,
@@ -1093,89 +2747,43 @@ void lovrGraphicsCylinder(Material* material, mat4 transform, float r1, float r2
     .topology = DRAW_TRIANGLES,
     .material = material,
     .transform = transform,
-    .vertexCount = vertexCount,
-    .indexCount = indexCount,
-    .vertices = &vertices,
-    .indices = &indices,
-    .baseVertex = &baseVertex,
+    .vertexCount = ((capped && r1) * (segments + 2) + (capped && r2) * (segments + 2) + 2 * (segments + 1)),
+    .indexCount = 3 * segments * ((capped && r1) + (capped && r2) + 2),
     .instanced = true
-  });
-
-  if (vertices) {
-    float* v = vertices;
-
-    // Ring
-    for (int i = 0; i <= segments; i++) {
-      float t = (float) i / segments;
-      float theta = t * (2 * M_PI);
-      float X = cosf(theta);
-      float Y = sinf(theta);
-      memcpy(vertices, (float[16]) {
-        r1 * X, r1 * Y, -.5f, X, Y, 0.f, 1.f - t, 1.f,
-        r2 * X, r2 * Y,  .5f, X, Y, 0.f, 1.f - t, 0.f
-      }, 16 * sizeof(float));
-      vertices += 16;
-    }
-
-    // Top
-    int top = (segments + 1) * 2 + baseVertex;
-    if (capped && r1 != 0) {
-      memcpy(vertices, (float[8]) { 0.f, 0.f, -.5f, 0.f, 0.f, -1.f, .5f, .5f }, 8 * sizeof(float));
+  }, tessellateCylinder);
+}
+
+static void tessellateSphere(BatchParams* params, float* vertices, uint32_t* indices, uint32_t baseVertex) {
+  int segments = params->sphere.segments;
+
+  for (int i = 0; i <= segments; i++) {
+    float v = i / (float) segments;
+    float sinV = sinf(v * (float) M_PI);
+    float cosV = cosf(v * (float) M_PI);
+    for (int k = 0; k <= segments; k++) {
+      float u = k / (float) segments;
+      float x = sinf(u * 2.f * (float) M_PI) * sinV;
+      float y = cosV;
+      float z = -cosf(u * 2.f * (float) M_PI) * sinV;
+      memcpy(vertices, ((float[8]) { x, y, z, x, y, z, u, 1.f - v }), 8 * sizeof(float));
       vertices += 8;
-      for (int i = 0; i <= segments; i++) {
-        int j = i * 2 * 8;
-        float x = v[j + 0];
-        float y = v[j + 1];
-        float z = v[j + 2];
-        float u = 1.f - (x / r1 * .5 + .5);
-        float v = y / r1 * .5 + .5;
-        memcpy(vertices, (float[8]) { x, y, z, 0.f, 0.f, -1.f, u, v }, 8 * sizeof(float));
-        vertices += 8;
-      }
-    }
-
-    // Bottom
-    int bot = (segments + 1) * 2 + (1 + segments + 1) * (capped && r1 != 0) + baseVertex;
-    if (capped && r2 != 0) {
-      memcpy(vertices, (float[8]) { 0.f, 0.f, .5f, 0.f, 0.f, 1.f, .5f, .5f }, 8 * sizeof(float));
-      vertices += 8;
-      for (int i = 0; i <= segments; i++) {
-        int j = i * 2 * 8 + 8;
-        float x = v[j + 0];
-        float y = v[j + 1];
-        float z = v[j + 2];
-        float u = x / r1 * .5 + .5;
-        float v = y / r1 * .5 + .5;
-        memcpy(vertices, (float[8]) { x, y, z, 0.f, 0.f, 1.f, u, v }, 8 * sizeof(float));
-        vertices += 8;
-      }
     }
+  }
 
-    // Indices
-    for (int i = 0; i < segments; i++) {
-      int j = 2 * i + baseVertex;
-      memcpy(indices, (uint16_t[6]) { j, j + 2, j + 1, j + 1, j + 2, j + 3 }, 6 * sizeof(uint16_t));
+  for (int i = 0; i < segments; i++) {
+    uint32_t offset0 = i * (segments + 1) + baseVertex;
+    uint32_t offset1 = (i + 1) * (segments + 1) + baseVertex;
+    for (int j = 0; j < segments; j++) {
+      uint32_t i0 = offset0 + j;
+      uint32_t i1 = offset1 + j;
+      memcpy(indices, ((uint32_t[]) { i0, i0 + 1, i1, i1, i0 + 1, i1 + 1 }), 6 * sizeof(uint32_t));
       indices += 6;
-
-      if (capped && r1 != 0.f) {
-        memcpy(indices, (uint16_t[3]) { top, top + i + 2, top + i + 1 }, 3 * sizeof(uint16_t));
-        indices += 3;
-      }
-
-      if (capped && r2 != 0.f) {
-        memcpy(indices, (uint16_t[3]) { bot, bot + i + 1, bot + i + 2 }, 3 * sizeof(uint16_t));
-        indices += 3;
-      }
     }
   }
 }
 
 void lovrGraphicsSphere(Material* material, mat4 transform, int segments) {
-  float* vertices = NULL;
-  uint16_t* indices = NULL;
-  uint16_t baseVertex;
-
-  lovrGraphicsBatch(&(BatchRequest) {
+  lovrGraphicsPrimitive(&(BatchRequest) {
     .type = BATCH_SPHERE,
     .params.sphere.segments = segments,
     .topology = DRAW_TRIANGLES,
@@ -1183,38 +2791,8 @@ void lovrGraphicsSphere(Material* material, mat4 transform, int segments) {
     .transform = transform,
     .vertexCount = (segments + 1) * (segments + 1),
     .indexCount = segments * segments * 6,
-    .vertices = &vertices,
-    .indices = &indices,
-    .baseVertex = &baseVertex,
     .instanced = true
-  });
-
-  if (vertices) {
-    for (int i = 0; i <= segments; i++) {
-      float v = i / (float) segments;
-      float sinV = sinf(v * (float) M_PI);
-      float cosV = cosf(v * (float) M_PI);
-      for (int k = 0; k <= segments; k++) {
-        float u = k / (float) segments;
-        float x = sinf(u * 2.f * (float) M_PI) * sinV;
-        float y = cosV;
-        float z = -cosf(u * 2.f * (float) M_PI) * sinV;
-        memcpy(vertices, ((float[8]) { x, y, z, x, y, z, u, 1.f - v }), 8 * sizeof(float));
-        vertices += 8;
-      }
-    }
-
-    for (int i = 0; i < segments; i++) {
-      uint16_t offset0 = i * (segments + 1) + baseVertex;
-      uint16_t offset1 = (i + 1) * (segments + 1) + baseVertex;
-      for (int j = 0; j < segments; j++) {
-        uint16_t i0 = offset0 + j;
-        uint16_t i1 = offset1 + j;
-        memcpy(indices, ((uint16_t[]) { i0, i0 + 1, i1, i1, i0 + 1, i1 + 1 }), 6 * sizeof(uint16_t));
-        indices += 6;
-      }
-    }
-  }
+  }, tessellateSphere);
 }
 
 void lovrGraphicsSkybox(Texture* texture) {
@@ -1261,6 +2839,10 @@ void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wra
     return;
   }
 
+  // Glyphs need to be in the atlas before the batch starts, uploading pixels would flush it
+  lovrFontPreload(font, str, length);
+  lovrFontFlush(font);
+
   float scale = 1.f / lovrFontGetPixelDensity(font);
   mat4_scale(transform, scale, scale, scale);
   mat4_translate(transform, 0.f, height * (valign / 2.f), 0.f);
@@ -1269,8 +2851,9 @@ void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wra
   pipeline.blendMode = pipeline.blendMode == BLEND_NONE ? BLEND_ALPHA : pipeline.blendMode;
 
   float* vertices;
-  uint16_t* indices;
-  uint16_t baseVertex;
+  uint32_t* indices;
+  uint32_t baseVertex;
+  uint8_t drawId;
   lovrGraphicsBatch(&(BatchRequest) {
     .type = BATCH_TEXT,
     .params.text.spread = lovrFontGetSpread(font),
@@ -1283,10 +2866,67 @@ void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wra
     .indexCount = glyphCount * 6,
     .vertices = &vertices,
     .indices = &indices,
-    .baseVertex = &baseVertex
+    .baseVertex = &baseVertex,
+    .drawId = &drawId
+  });
+
+  GlyphVertex* glyphs = (GlyphVertex*) vertices;
+  lovrFontRender(font, str, length, wrap, halign, glyphs, indices, baseVertex);
+  for (uint32_t i = 0; i < glyphCount * 4; i++) {
+    glyphs[i].drawId = drawId;
+  }
+}
+
+// Like print, but copies the cached layout of a Text instead of laying the string out again
+void lovrGraphicsPrintText(Text* text, mat4 transform, VerticalAlign valign) {
+  const uint32_t* textIndices;
+  uint32_t glyphCount;
+  float height;
+  const GlyphVertex* textVertices = lovrTextGetVertices(text, &textIndices, &glyphCount, &height);
+
+  if (glyphCount == 0) {
+    return;
+  }
+
+  Font* font = lovrTextGetFont(text);
+  lovrFontFlush(font);
+
+  float scale = 1.f / lovrFontGetPixelDensity(font);
+  mat4_scale(transform, scale, scale, scale);
+  mat4_translate(transform, 0.f, height * (valign / 2.f), 0.f);
+
+  Pipeline pipeline = state.pipeline;
+  pipeline.blendMode = pipeline.blendMode == BLEND_NONE ? BLEND_ALPHA : pipeline.blendMode;
+
+  float* vertices;
+  uint32_t* indices;
+  uint32_t baseVertex;
+  uint8_t drawId;
+  lovrGraphicsBatch(&(BatchRequest) {
+    .type = BATCH_TEXT,
+    .params.text.spread = lovrFontGetSpread(font),
+    .topology = DRAW_TRIANGLES,
+    .shader = SHADER_FONT,
+    .pipeline = &pipeline,
+    .transform = transform,
+    .texture = lovrFontGetTexture(font),
+    .vertexCount = glyphCount * 4,
+    .indexCount = glyphCount * 6,
+    .vertices = &vertices,
+    .indices = &indices,
+    .baseVertex = &baseVertex,
+    .drawId = &drawId
   });
 
-  lovrFontRender(font, str, length, wrap, halign, vertices, indices, baseVertex);
+  GlyphVertex* glyphs = (GlyphVertex*) vertices;
+  memcpy(glyphs, textVertices, glyphCount * 4 * sizeof(GlyphVertex));
+  for (uint32_t i = 0; i < glyphCount * 4; i++) {
+    glyphs[i].drawId = drawId;
+  }
+
+  for (uint32_t i = 0; i < glyphCount * 6; i++) {
+    indices[i] = textIndices[i] + baseVertex;
+  }
 }
 
 void lovrGraphicsFill(Texture* texture, float u, float v, float w, float h) {
@@ -1317,7 +2957,45 @@ void lovrGraphicsFill(Texture* texture, float u, float v, float w, float h) {
   }
 }
 
-void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float* pose) {
+// The mask batch always sorts first, so it's drawn before anything else in the flush (at whatever
+// viewport the backbuffer has then) and ignores the active Shader.  Depth writes need a depth test.
+static void drawViewMask() {
+  Pipeline pipeline = state.pipeline;
+  pipeline.blendMode = BLEND_NONE;
+  pipeline.colorMask = 0;
+  pipeline.culling = false;
+  pipeline.depthTest = COMPARE_LEQUAL;
+  pipeline.depthWrite = true;
+  pipeline.stencilMode = COMPARE_NONE;
+  pipeline.wireframe = false;
+
+  Shader* shader = state.shader;
+  state.shader = NULL;
+
+  uint32_t vertexCount = state.viewMaskCount;
+  float* vertices = NULL;
+
+  lovrGraphicsBatch(&(BatchRequest) {
+    .type = BATCH_MASK,
+    .topology = DRAW_TRIANGLES,
+    .shader = SHADER_MASK,
+    .pipeline = &pipeline,
+    .vertexCount = vertexCount,
+    .vertices = &vertices
+  });
+
+  state.shader = shader;
+
+  if (vertices) {
+    const float* mask = state.viewMask;
+    for (uint32_t i = 0; i < vertexCount; i++, mask += 3) {
+      memcpy(vertices, (float[8]) { mask[0], mask[1], mask[2], 0.f, 0.f, 0.f, 0.f, 0.f }, 8 * sizeof(float));
+      vertices += 8;
+    }
+  }
+}
+
+void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float* pose, uint32_t boneCount) {
   uint32_t vertexCount = lovrMeshGetVertexCount(mesh);
   uint32_t indexCount = lovrMeshGetIndexCount(mesh);
   uint32_t defaultCount = indexCount > 0 ? indexCount : vertexCount;
@@ -1332,7 +3010,8 @@ void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float*
     .params.mesh.rangeStart = rangeStart,
     .params.mesh.rangeCount = rangeCount,
     .params.mesh.instances = instances,
-    .params.mesh.pose = pose,
+    .params.mesh.boneCount = pose ? boneCount : 0,
+    .pose = pose,
     .mesh = mesh,
     .topology = mode,
     .transform = transform,
@@ -1340,3 +3019,226 @@ void lovrGraphicsDrawMesh(Mesh* mesh, mat4 transform, uint32_t instances, float*
     .instanced = instances <= 1
   });
 }
+
+// Estimates how much of the screen a box covers, as the largest extent of its corners in normalized
+// device coordinates (1 is the whole viewport).  Boxes that cross the near plane count as covering it.
+float lovrGraphicsGetBoxScreenSize(float aabb[6], mat4 transform) {
+  Canvas* canvas = state.canvas ? state.canvas : state.backbuffer;
+  uint32_t viewCount = lovrCanvasIsStereo(canvas) ? 2 : 1;
+  float size = 0.f;
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    mat4_init(m, state.frameData.projection[i]);
+    mat4_mul(m, state.frameData.viewMatrix[i]);
+    mat4_mul(m, state.transforms[state.transform]);
+    if (transform) {
+      mat4_mul(m, transform);
+    }
+
+    float min[2] = { FLT_MAX, FLT_MAX };
+    float max[2] = { -FLT_MAX, -FLT_MAX };
+    for (uint32_t j = 0; j < 8; j++) {
+      float p[4] = { aabb[0 + (j & 1)], aabb[2 + ((j >> 1) & 1)], aabb[4 + ((j >> 2) & 1)], 1.f };
+      mat4_mulVec4(m, p);
+      if (p[3] <= 0.f) {
+        return 1.f;
+      }
+      for (uint32_t k = 0; k < 2; k++) {
+        min[k] = MIN(min[k], p[k] / p[3]);
+        max[k] = MAX(max[k], p[k] / p[3]);
+      }
+    }
+
+    size = MAX(size, MAX(max[0] - min[0], max[1] - min[1]) / 2.f);
+  }
+
+  return MIN(size, 1.f);
+}
+
+// Tests a box against the frusta of the active views.  The box is transformed by the current
+// transform and an optional extra transform.  Corners are tested in clip space, and the box is
+// only culled if all of them are outside the same plane, so this never culls anything visible.
+bool lovrGraphicsIsBoxVisible(float aabb[6], mat4 transform) {
+  Canvas* canvas = state.canvas ? state.canvas : state.backbuffer;
+  uint32_t viewCount = lovrCanvasIsStereo(canvas) ? 2 : 1;
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    mat4_init(m, state.frameData.projection[i]);
+    mat4_mul(m, state.frameData.viewMatrix[i]);
+    mat4_mul(m, state.transforms[state.transform]);
+    if (transform) {
+      mat4_mul(m, transform);
+    }
+
+    uint8_t outside = 0x3f;
+    for (uint32_t j = 0; j < 8 && outside; j++) {
+      float p[4] = { aabb[0 + (j & 1)], aabb[2 + ((j >> 1) & 1)], aabb[4 + ((j >> 2) & 1)], 1.f };
+      mat4_mulVec4(m, p);
+      outside &=
+        ((p[0] < -p[3]) << 0) | ((p[0] > p[3]) << 1) |
+        ((p[1] < -p[3]) << 2) | ((p[1] > p[3]) << 3) |
+        ((p[2] < -p[3]) << 4) | ((p[2] > p[3]) << 5);
+    }
+
+    if (!outside) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Draws a box around the AABB with color and depth writes turned off, wrapped in an occlusion query
+// that records whether any of it passed the depth test.  The box doesn't write depth, so it's sorted
+// after all the opaque batches and gets tested against everything drawn this frame.  Boxes that
+// cross the near plane are partly clipped and would give false negatives, so they aren't tested and
+// false is returned (the caller should treat them as visible).
+bool lovrGraphicsTestOcclusion(float aabb[6], mat4 transform, uint32_t query) {
+  Canvas* canvas = state.canvas ? state.canvas : state.backbuffer;
+  uint32_t viewCount = lovrCanvasIsStereo(canvas) ? 2 : 1;
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    mat4_init(m, state.frameData.projection[i]);
+    mat4_mul(m, state.frameData.viewMatrix[i]);
+    mat4_mul(m, state.transforms[state.transform]);
+    if (transform) {
+      mat4_mul(m, transform);
+    }
+
+    for (uint32_t j = 0; j < 8; j++) {
+      float p[4] = { aabb[0 + (j & 1)], aabb[2 + ((j >> 1) & 1)], aabb[4 + ((j >> 2) & 1)], 1.f };
+      mat4_mulVec4(m, p);
+      if (p[3] <= 0.f || p[2] < -p[3]) {
+        return false;
+      }
+    }
+  }
+
+  Pipeline pipeline = state.pipeline;
+  pipeline.colorMask = 0;
+  pipeline.depthWrite = false;
+  pipeline.culling = false;
+  pipeline.wireframe = false;
+
+  float* vertices = NULL;
+  uint32_t* indices = NULL;
+  uint32_t baseVertex;
+
+  lovrGraphicsBatch(&(BatchRequest) {
+    .type = BATCH_OCCLUSION,
+    .params.occlusion.query = query,
+    .topology = DRAW_TRIANGLES,
+    .pipeline = &pipeline,
+    .transform = transform,
+    .vertexCount = 8,
+    .indexCount = 36,
+    .vertices = &vertices,
+    .indices = &indices,
+    .baseVertex = &baseVertex
+  });
+
+  if (vertices) {
+    for (uint32_t j = 0; j < 8; j++) {
+      *vertices++ = aabb[0 + (j & 1)];
+      *vertices++ = aabb[2 + ((j >> 1) & 1)];
+      *vertices++ = aabb[4 + ((j >> 2) & 1)];
+      memset(vertices, 0, 5 * sizeof(float));
+      vertices += 5;
+    }
+
+    static const uint32_t indexData[] = {
+      0, 2, 1, 1, 2, 3, // -z
+      4, 5, 6, 5, 7, 6, // +z
+      0, 4, 2, 2, 4, 6, // -x
+      1, 3, 5, 3, 7, 5, // +x
+      0, 1, 4, 1, 5, 4, // -y
+      2, 6, 3, 3, 6, 7  // +y
+    };
+
+    for (uint32_t j = 0; j < 36; j++) {
+      indices[j] = indexData[j] + baseVertex;
+    }
+  }
+
+  return true;
+}
+
+// Frames are counted by lovrGraphicsPresent, so occlusion results can be matched with the frame
+// they were issued in.
+uint32_t lovrGraphicsGetFrameIndex() {
+  return state.frameIndex;
+}
+
+// Captures read back a Canvas (the backbuffer by default) without waiting for the GPU, so a render
+// loop can keep a few frames in flight and collect the pixels of earlier ones as they finish.  They
+// are collected in the order they were made.  Windows can't be captured, only headless backbuffers.
+uint32_t lovrGraphicsCapture(Canvas* canvas) {
+  uint32_t count;
+  canvas = canvas ? canvas : state.defaultCanvas;
+  const Attachment* attachments = lovrCanvasGetAttachments(canvas, &count);
+  lovrAssert(count > 0 && attachments[0].texture, "Only Canvases with Textures (or the backbuffer in headless mode) can be captured");
+  lovrGraphicsFlush();
+  Capture capture = { .readback = lovrReadbackCreate(canvas, 0), .id = ++state.captureId };
+  arr_push(&state.captures, capture);
+  return capture.id;
+}
+
+// Returns the oldest capture, if it's done or wait is set.  The caller releases the Image.
+bool lovrGraphicsGetCapture(bool wait, uint32_t* id, Image** image) {
+  if (state.captures.length == 0) {
+    return false;
+  }
+
+  Capture* capture = &state.captures.data[0];
+  if (!wait && !lovrReadbackIsReady(capture->readback)) {
+    return false;
+  }
+
+  *id = capture->id;
+  *image = lovrReadbackGetImage(capture->readback);
+  lovrRetain(*image);
+  lovrRelease(capture->readback, lovrReadbackDestroy);
+  arr_splice(&state.captures, 0, 1);
+  return true;
+}
+
+// Draws a Mesh using draw parameters stored in a Buffer, which can be written by compute shaders.
+// Every draw uses the current transform and color, and lovrDrawID is always zero.
+void lovrGraphicsDrawIndirect(Mesh* mesh, Buffer* buffer, size_t offset, uint32_t count) {
+  lovrAssert(lovrGraphicsGetFeatures()->indirect, "Indirect drawing is not supported on this system");
+  size_t stride = (lovrMeshGetIndexCount(mesh) > 0 ? 5 : 4) * sizeof(uint32_t);
+  lovrAssert(offset % 4 == 0, "Indirect draw offset must be a multiple of 4");
+  lovrAssert(offset + count * stride <= lovrBufferGetSize(buffer), "Tried to draw %d indirect commands starting at offset %d, but the Buffer is only %d bytes", count, (int) offset, (int) lovrBufferGetSize(buffer));
+
+  if (count == 0) {
+    return;
+  }
+
+  lovrGraphicsBatch(&(BatchRequest) {
+    .type = BATCH_INDIRECT,
+    .params.indirect.buffer = buffer,
+    .params.indirect.offset = offset,
+    .params.indirect.count = count,
+    .mesh = mesh,
+    .topology = lovrMeshGetDrawMode(mesh),
+    .material = lovrMeshGetMaterial(mesh)
+  });
+}
+
+// Particles are an indirect draw whose instance count was written by the particle update shader
+void lovrGraphicsDrawParticles(Mesh* mesh, Buffer* buffer, Material* material, mat4 transform) {
+  lovrGraphicsBatch(&(BatchRequest) {
+    .type = BATCH_INDIRECT,
+    .params.indirect.buffer = buffer,
+    .params.indirect.offset = 0,
+    .params.indirect.count = 1,
+    .mesh = mesh,
+    .topology = DRAW_TRIANGLE_STRIP,
+    .shader = SHADER_PARTICLE,
+    .material = material,
+    .transform = transform
+  });
+}
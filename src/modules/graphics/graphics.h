@@ -6,15 +6,21 @@
 
 #pragma once
 
+struct Blob;
 struct Buffer;
 struct Canvas;
 struct Font;
+struct Text;
+struct Image;
 struct Material;
 struct Mesh;
 struct Shader;
 struct Texture;
 
+typedef struct DrawList DrawList;
+
 typedef void (*StencilCallback)(void* userdata);
+typedef void (*PassCallback)(void* userdata);
 
 typedef enum {
   ARC_MODE_PIE,
@@ -53,6 +59,21 @@ typedef enum {
   STYLE_LINE
 } DrawStyle;
 
+// Why a flush of pending batches happened: a stream ran out of space, the batch limit was reached,
+// an object used by a batch changed, a stencil operation, or any other state change
+typedef enum {
+  FLUSH_STREAM,
+  FLUSH_BATCH_LIMIT,
+  FLUSH_CANVAS,
+  FLUSH_SHADER,
+  FLUSH_MATERIAL,
+  FLUSH_MESH,
+  FLUSH_BUFFER,
+  FLUSH_STENCIL,
+  FLUSH_OTHER,
+  MAX_FLUSH_REASONS
+} FlushReason;
+
 typedef enum {
   STENCIL_REPLACE,
   STENCIL_INCREMENT,
@@ -62,6 +83,20 @@ typedef enum {
   STENCIL_INVERT
 } StencilAction;
 
+typedef enum {
+  STREAM_VERTEX,
+  STREAM_DRAWID,
+  STREAM_GLYPH,
+  STREAM_INDEX,
+  STREAM_MODEL,
+  STREAM_COLOR,
+  STREAM_MATERIAL,
+  STREAM_FRAME,
+  STREAM_POSE,
+  STREAM_LIGHT,
+  MAX_STREAMS
+} StreamType;
+
 typedef enum {
   WINDING_CLOCKWISE,
   WINDING_COUNTERCLOCKWISE
@@ -88,8 +123,10 @@ typedef struct {
   bool fullscreen;
   bool resizable;
   bool debug;
+  bool headless;
   int vsync;
   int msaa;
+  bool pacing;
   const char* title;
   struct {
     void* data;
@@ -98,10 +135,27 @@ typedef struct {
   } icon;
 } WindowFlags;
 
+#define MAX_PASS_READS 8
+#define MAX_LIGHTS 128
+
+// Describes what a Canvas pass loads and stores, and which Textures (from earlier passes) it reads.
+// Attachments that are cleared or discarded never have their old contents loaded.
+typedef struct {
+  bool clear[3]; // color, depth, stencil
+  bool discard[3]; // Contents aren't needed after the pass
+  Color clearColor;
+  float clearDepth;
+  int clearStencil;
+  struct Texture* reads[MAX_PASS_READS];
+  uint32_t readCount;
+} Pass;
+
 // Base
-bool lovrGraphicsInit(bool debug);
+bool lovrGraphicsInit(bool debug, uint32_t batchLimit);
 void lovrGraphicsDestroy(void);
-void lovrGraphicsPresent(void);
+void lovrGraphicsPresent(bool swap);
+bool lovrGraphicsIsFramePacing(void);
+void lovrGraphicsSetFramePacing(bool pacing);
 void lovrGraphicsCreateWindow(WindowFlags* flags);
 int lovrGraphicsGetWidth(void);
 int lovrGraphicsGetHeight(void);
@@ -111,12 +165,24 @@ void lovrGraphicsGetViewMatrix(uint32_t index, float* viewMatrix);
 void lovrGraphicsSetViewMatrix(uint32_t index, float* viewMatrix);
 void lovrGraphicsGetProjection(uint32_t index, float* projection);
 void lovrGraphicsSetProjection(uint32_t index, float* projection);
+void lovrGraphicsSetPreviousViewProjection(uint32_t index, float* viewProjection);
+void lovrGraphicsSetViewLatch(void (*latch)(float viewMatrix[2][16]));
+void lovrGraphicsSetViewMask(const float* vertices, uint32_t count);
 struct Buffer* lovrGraphicsGetIdentityBuffer(void);
+struct Shader* lovrGraphicsGetSkinningShader(void);
+struct Shader* lovrGraphicsGetParticleShader(bool sort);
+bool lovrGraphicsStreamTexture(struct Texture* texture, struct Image* image);
+void lovrGraphicsPrioritizeTexture(struct Texture* texture, float priority);
+float lovrGraphicsGetStreamProgress(struct Texture* texture);
+void lovrGraphicsPrecompileShaders(void);
 #define lovrGraphicsTick lovrGpuTick
 #define lovrGraphicsTock lovrGpuTock
 #define lovrGraphicsGetFeatures lovrGpuGetFeatures
 #define lovrGraphicsGetLimits lovrGpuGetLimits
 #define lovrGraphicsGetStats lovrGpuGetStats
+#define lovrGraphicsGetProfile lovrGpuGetProfile
+#define lovrGraphicsGetTextureBudget lovrGpuGetTextureBudget
+#define lovrGraphicsSetTextureBudget lovrGpuSetTextureBudget
 
 // State
 void lovrGraphicsReset(void);
@@ -146,6 +212,10 @@ float lovrGraphicsGetPointSize(void);
 void lovrGraphicsSetPointSize(float size);
 struct Shader* lovrGraphicsGetShader(void);
 void lovrGraphicsSetShader(struct Shader* shader);
+bool lovrGraphicsIsSortingEnabled(void);
+void lovrGraphicsSetSortingEnabled(bool sorting);
+bool lovrGraphicsIsDepthPrepassEnabled(void);
+void lovrGraphicsSetDepthPrepassEnabled(bool enable);
 void lovrGraphicsGetStencilTest(CompareMode* mode, int* value);
 void lovrGraphicsSetStencilTest(CompareMode mode, int value);
 Winding lovrGraphicsGetWinding(void);
@@ -160,16 +230,32 @@ void lovrGraphicsOrigin(void);
 void lovrGraphicsTranslate(vec3 translation);
 void lovrGraphicsRotate(quat rotation);
 void lovrGraphicsScale(vec3 scale);
+void lovrGraphicsGetTransform(mat4 transform);
 void lovrGraphicsMatrixTransform(mat4 transform);
 
+// Lights
+void lovrGraphicsAddLight(vec3 position, float radius, Color color);
+void lovrGraphicsClearLights(void);
+uint32_t lovrGraphicsGetLightCount(void);
+
+// Profiling
+void lovrGraphicsPushProfile(const char* label);
+void lovrGraphicsPopProfile(void);
+
 // Rendering
 void lovrGraphicsFlush(void);
+void lovrGraphicsFlushFor(FlushReason reason);
+void lovrGraphicsStartTrace(void);
+struct Blob* lovrGraphicsStopTrace(void);
+int lovrGraphicsReplay(const char* path, uint32_t loops);
 void lovrGraphicsFlushCanvas(struct Canvas* canvas);
 void lovrGraphicsFlushShader(struct Shader* shader);
 void lovrGraphicsFlushMaterial(struct Material* material);
 void lovrGraphicsFlushMesh(struct Mesh* mesh);
+void lovrGraphicsFlushBuffer(struct Buffer* buffer);
 void lovrGraphicsClear(Color* color, float* depth, int* stencil);
 void lovrGraphicsDiscard(bool color, bool depth, bool stencil);
+void lovrGraphicsPass(struct Canvas* canvas, Pass* pass, PassCallback callback, void* userdata);
 void lovrGraphicsPoints(uint32_t count, float** vertices);
 void lovrGraphicsLine(uint32_t count, float** vertices);
 void lovrGraphicsPlane(DrawStyle style, struct Material* material, mat4 transform, float u, float v, float w, float h);
@@ -179,18 +265,38 @@ void lovrGraphicsCircle(DrawStyle style, struct Material* material, mat4 transfo
 void lovrGraphicsCylinder(struct Material* material, mat4 transform, float r1, float r2, bool capped, int segments);
 void lovrGraphicsSphere(struct Material* material, mat4 transform, int segments);
 void lovrGraphicsSkybox(struct Texture* texture);
+void lovrGraphicsPrintText(struct Text* text, mat4 transform, VerticalAlign valign);
 void lovrGraphicsPrint(const char* str, size_t length, mat4 transform, float wrap, HorizontalAlign halign, VerticalAlign valign);
 void lovrGraphicsFill(struct Texture* texture, float u, float v, float w, float h);
-void lovrGraphicsDrawMesh(struct Mesh* mesh, mat4 transform, uint32_t instances, float* pose);
+void lovrGraphicsDrawMesh(struct Mesh* mesh, mat4 transform, uint32_t instances, float* pose, uint32_t boneCount);
+void lovrGraphicsDrawIndirect(struct Mesh* mesh, struct Buffer* buffer, size_t offset, uint32_t count);
+void lovrGraphicsDrawParticles(struct Mesh* mesh, struct Buffer* buffer, struct Material* material, mat4 transform);
+bool lovrGraphicsIsBoxVisible(float aabb[6], mat4 transform);
+float lovrGraphicsGetBoxScreenSize(float aabb[6], mat4 transform);
+bool lovrGraphicsTestOcclusion(float aabb[6], mat4 transform, uint32_t query);
+uint32_t lovrGraphicsGetFrameIndex(void);
+uint32_t lovrGraphicsCapture(struct Canvas* canvas);
+bool lovrGraphicsGetCapture(bool wait, uint32_t* id, struct Image** image);
 #define lovrGraphicsStencil lovrGpuStencil
 #define lovrGraphicsCompute lovrGpuCompute
 
+// DrawList
+DrawList* lovrDrawListCreate(void);
+void lovrDrawListDestroy(void* ref);
+uint32_t lovrDrawListGetBatchCount(DrawList* list);
+uint32_t lovrDrawListGetDrawCount(DrawList* list);
+bool lovrGraphicsIsRecording(void);
+void lovrGraphicsBeginDrawList(DrawList* list);
+void lovrGraphicsEndDrawList(void);
+void lovrGraphicsDrawList(DrawList* list, mat4 transform);
+
 // GPU
 
 typedef struct {
   bool astc;
   bool compute;
   bool dxt;
+  bool indirect;
   bool instancedStereo;
   bool multiview;
   bool timers;
@@ -206,6 +312,8 @@ typedef struct {
   int compute[3];
 } GpuLimits;
 
+// Shader switches, render passes, draw calls, and everything after the texture restores are counted
+// per frame.  Buffer uploads include the data written to the streams.
 typedef struct {
   uint32_t shaderSwitches;
   uint32_t renderPasses;
@@ -214,8 +322,28 @@ typedef struct {
   uint32_t textureCount;
   uint64_t bufferMemory;
   uint64_t textureMemory;
+  uint32_t textureEvictions;
+  uint32_t textureRestores;
+  uint32_t flushes[MAX_FLUSH_REASONS];
+  uint64_t vertices;
+  uint64_t triangles;
+  uint64_t streamBytes[MAX_STREAMS];
+  uint64_t textureUploadBytes;
+  uint64_t bufferUploadBytes;
+  uint64_t uniformUploadBytes;
 } GpuStats;
 
+// A profile scope from a recent frame.  Scopes are stored in the order they were pushed, so parents
+// always come before their children.  Times are in seconds and include nested scopes.
+typedef struct {
+  char label[32];
+  uint32_t parent; // ~0u for top level scopes
+  double cpuTime;
+  double gpuTime;
+  uint32_t drawCalls;
+  uint32_t shaderSwitches;
+} GpuProfileScope;
+
 typedef struct {
   struct Mesh* mesh;
   struct Canvas* canvas;
@@ -225,8 +353,24 @@ typedef struct {
   uint32_t rangeStart;
   uint32_t rangeCount;
   uint32_t instances;
+  struct Buffer* indirectBuffer;
+  size_t indirectOffset;
+  uint32_t indirectCount;
+  uint32_t query; // Occlusion query wrapping the draw, or 0
+  bool depthOnly; // Draws with a depth-only variant of the shader
 } DrawCommand;
 
+// Traces start with this header, followed by the recorded commands (see opengl.c)
+#define TRACE_MAGIC "LOVRTRAC"
+#define TRACE_VERSION 1
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t width; // Window size when the trace was started
+  uint32_t height;
+} TraceHeader;
+
 void lovrGpuInit(void (*getProcAddress(const char*))(void), bool debug);
 void lovrGpuDestroy(void);
 void lovrGpuClear(struct Canvas* canvas, Color* color, float* depth, int* stencil);
@@ -235,10 +379,24 @@ void lovrGpuDiscard(struct Canvas* canvas, bool color, bool depth, bool stencil)
 void lovrGpuDraw(DrawCommand* draw);
 void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback callback, void* userdata);
 void lovrGpuPresent(void);
+void lovrGpuFinish(void);
 void lovrGpuDirtyTexture(void);
 void lovrGpuResetState(void);
 void lovrGpuTick(const char* label);
 double lovrGpuTock(const char* label);
+uint32_t lovrGpuCreateOcclusionQuery(void);
+void lovrGpuDestroyOcclusionQuery(uint32_t query);
+bool lovrGpuGetOcclusionResult(uint32_t query, bool* visible);
+void lovrGpuPushProfile(const char* label);
+void lovrGpuPopProfile(void);
+const GpuProfileScope* lovrGpuGetProfile(uint32_t* count);
 const GpuFeatures* lovrGpuGetFeatures(void);
 const GpuLimits* lovrGpuGetLimits(void);
 const GpuStats* lovrGpuGetStats(void);
+void lovrGpuCountFlush(FlushReason reason);
+void lovrGpuCountStream(StreamType type, size_t bytes);
+uint64_t lovrGpuGetTextureBudget(void);
+void lovrGpuSetTextureBudget(uint64_t budget);
+void lovrGpuStartTrace(uint32_t width, uint32_t height);
+struct Blob* lovrGpuStopTrace(void);
+uint32_t lovrGpuReplay(const void* data, size_t size, void (*onFrame)(void* userdata), void* userdata);
@@ -2,9 +2,10 @@
 #include "graphics/graphics.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
-#include "resources/shaders.h"
+#include "math/math.h"
 #include "core/util.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 struct Material {
@@ -13,12 +14,14 @@ struct Material {
   Color colors[MAX_MATERIAL_COLORS];
   struct Texture* textures[MAX_MATERIAL_TEXTURES];
   float transform[9];
+  float data[12];
+  bool dirty;
 };
 
 Material* lovrMaterialCreate() {
   Material* material = calloc(1, sizeof(Material));
   lovrAssert(material, "Out of memory");
-  material->ref = 1;
+  material->ref = LOVR_REF_LOCAL | 1;
 
   for (int i = 0; i < MAX_MATERIAL_SCALARS; i++) {
     material->scalars[i] = i == SCALAR_ALPHA_CUTOFF ? 0.f : 1.f;
@@ -33,6 +36,7 @@ Material* lovrMaterialCreate() {
   }
 
   lovrMaterialSetTransform(material, 0.f, 0.f, 1.f, 1.f, 0.f);
+  material->dirty = true;
   return material;
 }
 
@@ -45,20 +49,42 @@ void lovrMaterialDestroy(void* ref) {
   free(material);
 }
 
+// Colors and scalars are per-draw data (see lovrMaterialGetDrawData), only the textures and the
+// transform are bound for the whole batch.  Draws copy the per-draw data when they're recorded, so
+// changing a color or scalar doesn't need to flush the batches that use the Material.
 void lovrMaterialBind(Material* material, Shader* shader) {
-  for (int i = 0; i < MAX_MATERIAL_SCALARS; i++) {
-    lovrShaderSetFloats(shader, lovrShaderScalarUniforms[i], &material->scalars[i], 0, 1);
+  for (int i = 0; i < MAX_MATERIAL_TEXTURES; i++) {
+    lovrShaderSetBuiltin(shader, BUILTIN_DIFFUSE_TEXTURE + i, UNIFORM_SAMPLER, &material->textures[i], 0, 1);
   }
 
-  for (int i = 0; i < MAX_MATERIAL_COLORS; i++) {
-    lovrShaderSetColor(shader, lovrShaderColorUniforms[i], material->colors[i]);
-  }
+  lovrShaderSetBuiltin(shader, BUILTIN_MATERIAL_TRANSFORM, UNIFORM_MATRIX, material->transform, 0, 9);
+}
 
-  for (int i = 0; i < MAX_MATERIAL_TEXTURES; i++) {
-    lovrShaderSetTextures(shader, lovrShaderTextureUniforms[i], &material->textures[i], 0, 1);
+// Batches can contain draws with different materials as long as they share textures and transform
+bool lovrMaterialIsCompatible(Material* a, Material* b) {
+  return !memcmp(a->textures, b->textures, sizeof(a->textures)) && !memcmp(a->transform, b->transform, sizeof(a->transform));
+}
+
+// Returns the linear diffuse color, linear emissive color, and scalars, as the 3 vec4s of the
+// per-draw material block
+const float* lovrMaterialGetDrawData(Material* material) {
+  if (material->dirty) {
+    for (int i = 0; i < MAX_MATERIAL_COLORS; i++) {
+      Color color = material->colors[i];
+      material->data[4 * i + 0] = lovrMathGammaToLinear(color.r);
+      material->data[4 * i + 1] = lovrMathGammaToLinear(color.g);
+      material->data[4 * i + 2] = lovrMathGammaToLinear(color.b);
+      material->data[4 * i + 3] = color.a;
+    }
+
+    for (int i = 0; i < 4; i++) {
+      material->data[8 + i] = i < MAX_MATERIAL_SCALARS ? material->scalars[i] : 0.f;
+    }
+
+    material->dirty = false;
   }
 
-  lovrShaderSetMatrices(shader, "lovrMaterialTransform", material->transform, 0, 9);
+  return material->data;
 }
 
 float lovrMaterialGetScalar(Material* material, MaterialScalar scalarType) {
@@ -67,8 +93,8 @@ float lovrMaterialGetScalar(Material* material, MaterialScalar scalarType) {
 
 void lovrMaterialSetScalar(Material* material, MaterialScalar scalarType, float value) {
   if (material->scalars[scalarType] != value) {
-    lovrGraphicsFlushMaterial(material);
     material->scalars[scalarType] = value;
+    material->dirty = true;
   }
 }
 
@@ -78,8 +104,8 @@ Color lovrMaterialGetColor(Material* material, MaterialColor colorType) {
 
 void lovrMaterialSetColor(Material* material, MaterialColor colorType, Color color) {
   if (memcmp(&material->colors[colorType], &color, 4 * sizeof(float))) {
-    lovrGraphicsFlushMaterial(material);
     material->colors[colorType] = color;
+    material->dirty = true;
   }
 }
 
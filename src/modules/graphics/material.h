@@ -9,6 +9,8 @@ typedef struct Material Material;
 Material* lovrMaterialCreate(void);
 void lovrMaterialDestroy(void* ref);
 void lovrMaterialBind(Material* material, struct Shader* shader);
+bool lovrMaterialIsCompatible(Material* a, Material* b);
+const float* lovrMaterialGetDrawData(Material* material);
 float lovrMaterialGetScalar(Material* material, MaterialScalar scalarType);
 void lovrMaterialSetScalar(Material* material, MaterialScalar scalarType, float value);
 Color lovrMaterialGetColor(Material* material, MaterialColor colorType);
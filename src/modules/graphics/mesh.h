@@ -37,6 +37,7 @@ uint32_t lovrMeshGetAttributeIndex(Mesh* mesh, const char* name);
 const char* lovrMeshGetAttributeName(Mesh* mesh, uint32_t index);
 bool lovrMeshIsAttributeEnabled(Mesh* mesh, const char* name);
 void lovrMeshSetAttributeEnabled(Mesh* mesh, const char* name, bool enabled);
+void lovrMeshSetAttributeOffset(Mesh* mesh, const char* name, uint32_t offset);
 DrawMode lovrMeshGetDrawMode(Mesh* mesh);
 void lovrMeshSetDrawMode(Mesh* mesh, DrawMode mode);
 void lovrMeshGetDrawRange(Mesh* mesh, uint32_t* start, uint32_t* count);
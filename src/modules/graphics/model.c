@@ -3,17 +3,66 @@
 #include "graphics/graphics.h"
 #include "graphics/material.h"
 #include "graphics/mesh.h"
+#include "graphics/shader.h"
 #include "graphics/texture.h"
 #include "resources/shaders.h"
 #include "core/maf.h"
+#include "core/map.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
 #include <stdlib.h>
 #include <float.h>
 #include <math.h>
+#include <string.h>
 
 typedef struct {
   float properties[3][4];
 } NodeTransform;
 
+// Compressed copies of the positions, normals, tangents, and texture coordinates of a primitive.
+// Positions are 16 bit unorms relative to the primitive's bounds, and the dequantize transform
+// (a translation and a uniform scale, so normals aren't skewed) is applied when drawing.
+typedef struct {
+  struct Buffer* buffer;
+  float dequantize[16];
+  bool texCoord;
+} QuantizedVertices;
+
+// Occlusion state of a node.  Results arrive a frame or more after the query is issued, so nodes
+// are drawn or skipped based on the latest result, and a node that wasn't considered last frame
+// (it was off screen, or occlusion culling was off) is drawn until a fresh result comes back.
+typedef struct {
+  uint32_t id;
+  uint32_t frame; // When the last query was issued
+  uint32_t lastSeen;
+  bool pending;
+  bool visible;
+} OcclusionQuery;
+
+// Static primitives that share a material (and set of attributes) are merged into one Mesh by
+// lovrModelBake, with vertices transformed into the space of the Model.  Bounds are in that space.
+typedef struct {
+  struct Mesh* mesh;
+  float bounds[6];
+  uint32_t material;
+  uint32_t attributes;
+  uint32_t vertexStart;
+  uint32_t vertexCount;
+  uint32_t indexStart;
+  uint32_t indexCount;
+} BakedBatch;
+
+// Draws of primitives that are instanced (EXT_mesh_gpu_instancing) or used by more than one node
+// are collected while traversing the hierarchy and issued grouped by primitive, so each group
+// becomes one instanced batch, with its transforms in the per-draw transform block.
+typedef struct {
+  uint32_t primitive;
+  uint32_t sequence;
+  struct Mesh* mesh;
+  float transform[16];
+} DeferredDraw;
+
 struct Model {
   uint32_t ref;
   struct ModelData* data;
@@ -27,51 +76,292 @@ struct Model {
   uint32_t indexCount;
   NodeTransform* localTransforms;
   float* globalTransforms;
+  uint32_t* nodeOrder;
+  uint32_t* nodeParents;
+  uint32_t nodeOrderCount;
+  bool* nodesDirty;
+  float* nodeBounds;
+  float* poses;
+  uint32_t* poseOffsets;
+  bool posesDirty;
+  bool animating;
+  uint32_t* keyframeCursors;
+  float* blendValues;
+  float* blendWeights;
+  uint32_t* animationCursors;
+  struct Mesh** skinnedMeshes;
+  struct Buffer** skinVertices;
+  struct Buffer** skinnedVertices;
+  struct Buffer* poseBuffer;
+  size_t poseStride;
   bool transformsDirty;
+  bool skinningDirty;
+  bool computeSkinning;
+  bool streaming;
+  bool culling;
+  bool occlusionCulling;
+  OcclusionQuery* occlusionQueries;
+  struct Mesh** lodMeshes;
+  struct Buffer* lodBuffer;
+  uint8_t* nodeLods;
+  bool lod;
+  QuantizedVertices* quantized;
+  BakedBatch* baked;
+  uint32_t bakedCount;
+  struct Buffer* bakedVertices;
+  struct Buffer* bakedIndices;
+  bool* nodesBaked;
+  float* instanceTransforms;
+  uint32_t* instanceOffsets;
+  bool* primitivesRepeated;
+  arr_t(DeferredDraw) deferred;
 };
 
-static void updateGlobalTransform(Model* model, uint32_t nodeIndex, mat4 parent) {
-  mat4 global = model->globalTransforms + 16 * nodeIndex;
-  NodeTransform* local = &model->localTransforms[nodeIndex];
-  vec3 T = local->properties[PROP_TRANSLATION];
-  quat R = local->properties[PROP_ROTATION];
-  vec3 S = local->properties[PROP_SCALE];
+static void markNodeDirty(Model* model, uint32_t nodeIndex) {
+  model->nodesDirty[nodeIndex] = true;
+  model->transformsDirty = true;
+  model->skinningDirty = true;
+  model->posesDirty = true;
+}
 
-  mat4_init(global, parent);
-  mat4_translate(global, T[0], T[1], T[2]);
-  mat4_rotateQuat(global, R);
-  mat4_scale(global, S[0], S[1], S[2]);
+// Nodes are stored in depth-first order, so parents always come before their children and the
+// global transforms can be updated in one pass.  Only the subtrees of nodes that changed are updated.
+static void updateGlobalTransforms(Model* model) {
+  if (!model->transformsDirty) {
+    return;
+  }
 
-  ModelNode* node = &model->data->nodes[nodeIndex];
-  for (uint32_t i = 0; i < node->childCount; i++) {
-    updateGlobalTransform(model, node->children[i], global);
+  for (uint32_t i = 0; i < model->nodeOrderCount; i++) {
+    uint32_t nodeIndex = model->nodeOrder[i];
+    uint32_t parentIndex = model->nodeParents[nodeIndex];
+
+    if (parentIndex != ~0u && model->nodesDirty[parentIndex]) {
+      model->nodesDirty[nodeIndex] = true;
+    }
+
+    if (!model->nodesDirty[nodeIndex]) {
+      continue;
+    }
+
+    mat4 global = model->globalTransforms + 16 * nodeIndex;
+    NodeTransform* local = &model->localTransforms[nodeIndex];
+    vec3 T = local->properties[PROP_TRANSLATION];
+    quat R = local->properties[PROP_ROTATION];
+    vec3 S = local->properties[PROP_SCALE];
+
+    if (parentIndex == ~0u) {
+      mat4_identity(global);
+    } else {
+      mat4_init(global, model->globalTransforms + 16 * parentIndex);
+    }
+
+    mat4_translate(global, T[0], T[1], T[2]);
+    mat4_rotateQuat(global, R);
+    mat4_scale(global, S[0], S[1], S[2]);
   }
+
+  memset(model->nodesDirty, 0, model->data->nodeCount * sizeof(bool));
+  model->transformsDirty = false;
 }
 
-static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
+// Computes the joint matrices of a skinned node, relative to the node
+static void computePose(Model* model, uint32_t nodeIndex, float* pose) {
   ModelNode* node = &model->data->nodes[nodeIndex];
+  ModelSkin* skin = &model->data->skins[node->skin];
   mat4 globalTransform = model->globalTransforms + 16 * nodeIndex;
-  float poseMatrix[16 * MAX_BONES];
-  float* pose = NULL;
 
-  if (node->skin != ~0u) {
-    ModelSkin* skin = &model->data->skins[node->skin];
-    pose = poseMatrix;
+  for (uint32_t j = 0; j < skin->jointCount; j++) {
+    mat4 globalJointTransform = model->globalTransforms + 16 * skin->joints[j];
+    mat4 inverseBindMatrix = skin->inverseBindMatrices + 16 * j;
+    mat4 jointPose = pose + 16 * j;
+
+    mat4_set(jointPose, globalTransform);
+    mat4_invert(jointPose);
+    mat4_mul(jointPose, globalJointTransform);
+    mat4_mul(jointPose, inverseBindMatrix);
+  }
+}
+
+// The joint matrices of every skinned node are kept until the pose changes, so drawing a Model more
+// than once (or skinning it) doesn't compute them again
+static void updatePoses(Model* model) {
+  if (!model->posesDirty || !model->poses) {
+    return;
+  }
+
+  updateGlobalTransforms(model);
+  for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+    if (model->data->nodes[i].skin != ~0u) {
+      computePose(model, i, model->poses + model->poseOffsets[i]);
+    }
+  }
+
+  model->posesDirty = false;
+}
 
-    for (uint32_t j = 0; j < skin->jointCount; j++) {
-      mat4 globalJointTransform = model->globalTransforms + 16 * skin->joints[j];
-      mat4 inverseBindMatrix = skin->inverseBindMatrices + 16 * j;
-      mat4 jointPose = pose + 16 * j;
+// Finds the first keyframe of a channel at or after a time.  Animations usually play forward, so the
+// keyframe found last time (or the one after it) is checked before falling back to a binary search.
+static uint32_t findKeyframe(ModelAnimationChannel* channel, uint32_t* cursor, float time) {
+  uint32_t count = channel->keyframeCount;
+  float* times = channel->times;
 
-      mat4_set(jointPose, globalTransform);
-      mat4_invert(jointPose);
-      mat4_mul(jointPose, globalJointTransform);
-      mat4_mul(jointPose, inverseBindMatrix);
+  for (uint32_t keyframe = *cursor; keyframe <= count && keyframe <= *cursor + 1; keyframe++) {
+    if ((keyframe == 0 || times[keyframe - 1] < time) && (keyframe == count || times[keyframe] >= time)) {
+      return *cursor = keyframe;
     }
   }
 
+  uint32_t keyframe = 0;
+  while (count > 0) {
+    uint32_t step = count / 2;
+    if (times[keyframe + step] < time) {
+      keyframe += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+
+  return *cursor = keyframe;
+}
+
+// Picks the LOD level of a node from its screen size.  Primitives of a node can have different LOD
+// counts, so the screen size where a node switches to a level is the largest one among the
+// primitives that have it.  A node only moves to a coarser level once it's 20% smaller than the
+// switch point, so nodes right at the threshold don't flicker between levels.
+static uint32_t selectLod(Model* model, uint32_t nodeIndex, float screenSize) {
+  ModelNode* node = &model->data->nodes[nodeIndex];
+  float thresholds[MAX_LODS] = { 0.f };
+  uint32_t levels = 0;
+
   for (uint32_t i = 0; i < node->primitiveCount; i++) {
-    lovrGraphicsDrawMesh(model->meshes[node->primitiveIndex + i], globalTransform, instances, pose);
+    ModelPrimitive* primitive = &model->data->primitives[node->primitiveIndex + i];
+    for (uint32_t j = 0; j < primitive->lodCount; j++) {
+      thresholds[j + 1] = MAX(thresholds[j + 1], primitive->lods[j].screenSize);
+    }
+    levels = MAX(levels, primitive->lodCount);
+  }
+
+  uint32_t lod = MIN(model->nodeLods[nodeIndex], levels);
+
+  while (lod > 0 && screenSize > thresholds[lod]) {
+    lod--;
+  }
+
+  while (lod < levels && screenSize < thresholds[lod + 1] * .8f) {
+    lod++;
+  }
+
+  model->nodeLods[nodeIndex] = (uint8_t) lod;
+  return lod;
+}
+
+// Returns whether the node should be drawn, issuing a new query if the previous one has finished.
+// A Model drawn more than once per frame only tests the first draw and reuses its result after that.
+static bool testOcclusion(Model* model, uint32_t nodeIndex, float* bounds, mat4 transform) {
+  OcclusionQuery* query = &model->occlusionQueries[nodeIndex];
+  uint32_t frame = lovrGraphicsGetFrameIndex();
+
+  if (query->pending && query->frame != frame) {
+    query->pending = !lovrGpuGetOcclusionResult(query->id, &query->visible);
+  }
+
+  bool stale = query->lastSeen + 1 < frame;
+  query->lastSeen = frame;
+
+  if (!query->pending && query->frame != frame) {
+    if (!query->id) {
+      query->id = lovrGpuCreateOcclusionQuery();
+    }
+
+    if (lovrGraphicsTestOcclusion(bounds, transform, query->id)) {
+      query->pending = true;
+      query->frame = frame;
+    } else {
+      query->visible = true;
+    }
+  }
+
+  return stale || query->visible;
+}
+
+static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
+  ModelNode* node = &model->data->nodes[nodeIndex];
+  mat4 globalTransform = model->globalTransforms + 16 * nodeIndex;
+  bool skinned = node->skin != ~0u;
+
+  // Instances and skinned vertices can end up anywhere, so only static single draws are culled
+  float* bounds = model->nodeBounds + 6 * nodeIndex;
+  bool cull = model->culling && instances <= 1 && node->instanceCount == 0 && !skinned && bounds[0] <= bounds[1];
+  bool baked = model->nodesBaked && model->nodesBaked[nodeIndex];
+  bool visible = node->primitiveCount > 0 && !baked && (!cull || lovrGraphicsIsBoxVisible(bounds, globalTransform));
+
+  if (visible && cull && model->occlusionCulling) {
+    visible = testOcclusion(model, nodeIndex, bounds, globalTransform);
+  }
+
+  if (visible) {
+
+    // Streaming textures of nodes that cover more of the screen get their mipmaps sooner
+    float screenSize = 0.f;
+    if (model->streaming || model->lod) {
+      screenSize = bounds[0] <= bounds[1] && !skinned ? lovrGraphicsGetBoxScreenSize(bounds, globalTransform) : 1.f;
+    }
+
+    uint32_t lod = model->lod && instances <= 1 && node->instanceCount == 0 ? selectLod(model, nodeIndex, screenSize) : 0;
+    uint32_t instanceCount = MAX(node->instanceCount, 1);
+
+    for (uint32_t i = 0; i < node->primitiveCount; i++) {
+      uint32_t index = node->primitiveIndex + i;
+
+      if (model->streaming) {
+        Material* material = lovrMeshGetMaterial(model->meshes[index]);
+        for (uint32_t j = 0; material && j < MAX_MATERIAL_TEXTURES; j++) {
+          Texture* texture = lovrMaterialGetTexture(material, j);
+          if (texture) lovrGraphicsPrioritizeTexture(texture, screenSize);
+        }
+      }
+
+      // Primitives skinned by the compute shader are drawn like static meshes
+      bool computeSkinned = skinned && model->computeSkinning && model->skinnedMeshes[index];
+
+      float* pose = skinned && !computeSkinned ? model->poses + model->poseOffsets[nodeIndex] : NULL;
+      uint32_t boneCount = pose ? model->data->skins[node->skin].jointCount : 0;
+      uint32_t level = MIN(lod, model->data->primitives[index].lodCount);
+      Mesh* mesh = level > 0 ? model->lodMeshes[index * (MAX_LODS - 1) + level - 1] : model->meshes[index];
+      bool quantized = !computeSkinned && model->quantized && model->quantized[index].buffer;
+      bool defer = !skinned && instances <= 1 && (node->instanceCount > 0 || (model->primitivesRepeated && model->primitivesRepeated[index]));
+
+      if (computeSkinned) {
+        mesh = model->skinnedMeshes[index];
+      }
+
+      if (!defer && !quantized && node->instanceCount == 0) {
+        lovrGraphicsDrawMesh(mesh, globalTransform, instances, pose, boneCount);
+        continue;
+      }
+
+      for (uint32_t j = 0; j < instanceCount; j++) {
+        float transform[16];
+        mat4_init(transform, globalTransform);
+
+        if (node->instanceCount > 0) {
+          mat4_mul(transform, model->instanceTransforms + 16 * (model->instanceOffsets[nodeIndex] + j));
+        }
+
+        if (quantized) {
+          mat4_mul(transform, model->quantized[index].dequantize);
+        }
+
+        if (defer) {
+          DeferredDraw draw = { .primitive = index, .sequence = (uint32_t) model->deferred.length, .mesh = mesh };
+          mat4_init(draw.transform, transform);
+          arr_push(&model->deferred, draw);
+        } else {
+          lovrGraphicsDrawMesh(mesh, transform, instances, pose, boneCount);
+        }
+      }
+    }
   }
 
   for (uint32_t i = 0; i < node->childCount; i++) {
@@ -79,11 +369,319 @@ static void renderNode(Model* model, uint32_t nodeIndex, uint32_t instances) {
   }
 }
 
-Model* lovrModelCreate(ModelData* data) {
+static int compareDeferredDraws(const void* a, const void* b) {
+  const DeferredDraw* x = a;
+  const DeferredDraw* y = b;
+  if (x->primitive != y->primitive) return x->primitive < y->primitive ? -1 : 1;
+  return x->sequence < y->sequence ? -1 : (x->sequence > y->sequence);
+}
+
+// Reads one element of a vertex attribute as floats, applying normalization
+static void readAttribute(ModelData* data, ModelAttribute* attribute, uint32_t index, float* value) {
+  static const size_t sizes[] = { [I8] = 1, [U8] = 1, [I16] = 2, [U16] = 2, [I32] = 4, [U32] = 4, [F32] = 4 };
+  static const float ranges[] = { [I8] = 127.f, [U8] = 255.f, [I16] = 32767.f, [U16] = 65535.f, [I32] = 1.f, [U32] = 1.f, [F32] = 1.f };
+  ModelBuffer* buffer = &data->buffers[attribute->buffer];
+  size_t size = sizes[attribute->type];
+  size_t stride = buffer->stride == 0 ? size * attribute->components : buffer->stride;
+  char* p = buffer->data + attribute->offset + index * stride;
+
+  for (uint32_t i = 0; i < attribute->components; i++, p += size) {
+    switch (attribute->type) {
+      case I8: value[i] = *(int8_t*) p; break;
+      case U8: value[i] = *(uint8_t*) p; break;
+      case I16: value[i] = *(int16_t*) p; break;
+      case U16: value[i] = *(uint16_t*) p; break;
+      case I32: value[i] = (float) *(int32_t*) p; break;
+      case U32: value[i] = (float) *(uint32_t*) p; break;
+      case F32: value[i] = *(float*) p; break;
+      default: break;
+    }
+
+    if (attribute->normalized) {
+      value[i] = MAX(value[i] / ranges[attribute->type], -1.f);
+    }
+  }
+}
+
+// Sets up compute skinning for a primitive.  Its vertices are unpacked into a storage buffer that
+// the skinning shader reads from, and a copy of its Mesh sources positions and normals from the
+// buffer the skinning shader writes to.  Primitives without joints or weights are left alone.
+static void createSkinnedMesh(Model* model, uint32_t index) {
+  ModelData* data = model->data;
+  ModelPrimitive* primitive = &data->primitives[index];
+  ModelAttribute* positions = primitive->attributes[ATTR_POSITION];
+  ModelAttribute* normals = primitive->attributes[ATTR_NORMAL];
+  ModelAttribute* joints = primitive->attributes[ATTR_BONES];
+  ModelAttribute* weights = primitive->attributes[ATTR_WEIGHTS];
+
+  if (!positions || !joints || !weights) {
+    return;
+  }
+
+  // Each vertex is a position, normal, 4 joint indices, and 4 weights, padded to vec4s for std430
+  uint32_t vertexCount = positions->count;
+  float* vertices = calloc(vertexCount, 16 * sizeof(float));
+  lovrAssert(vertices, "Out of memory");
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    float* vertex = vertices + 16 * i;
+    float jointIndices[4] = { 0.f };
+    uint32_t jointData[4];
+    readAttribute(data, positions, i, vertex + 0);
+    if (normals) readAttribute(data, normals, i, vertex + 4);
+    readAttribute(data, joints, i, jointIndices);
+    readAttribute(data, weights, i, vertex + 12);
+    for (uint32_t j = 0; j < 4; j++) jointData[j] = (uint32_t) jointIndices[j];
+    memcpy(vertex + 8, jointData, sizeof(jointData));
+  }
+
+  model->skinVertices[index] = lovrBufferCreate(vertexCount * 16 * sizeof(float), vertices, BUFFER_SHADER_STORAGE, USAGE_STATIC, false);
+  model->skinnedVertices[index] = lovrBufferCreate(vertexCount * 8 * sizeof(float), NULL, BUFFER_SHADER_STORAGE, USAGE_STATIC, false);
+  free(vertices);
+
+  Mesh* source = model->meshes[index];
+  Mesh* mesh = lovrMeshCreate(primitive->mode, NULL, vertexCount);
+  lovrMeshAttachAttribute(mesh, "lovrPosition", &(MeshAttribute) { .buffer = model->skinnedVertices[index], .offset = 0, .stride = 32, .type = F32, .components = 3 });
+  lovrMeshAttachAttribute(mesh, "lovrNormal", &(MeshAttribute) { .buffer = model->skinnedVertices[index], .offset = 16, .stride = 32, .type = F32, .components = 3 });
+
+  for (uint32_t i = 0; i < lovrMeshGetAttributeCount(source); i++) {
+    const char* name = lovrMeshGetAttributeName(source, i);
+    if (!strcmp(name, "lovrPosition") || !strcmp(name, "lovrNormal") || !strcmp(name, "lovrBones") || !strcmp(name, "lovrBoneWeights")) {
+      continue;
+    }
+
+    MeshAttribute attribute = *lovrMeshGetAttribute(source, i);
+    lovrMeshAttachAttribute(mesh, name, &attribute);
+  }
+
+  if (primitive->indices) {
+    ModelAttribute* attribute = primitive->indices;
+    size_t indexSize = attribute->type == U16 ? 2 : 4;
+    lovrMeshSetIndexBuffer(mesh, model->buffers[attribute->buffer], attribute->count, indexSize, attribute->offset);
+  }
+
+  uint32_t rangeStart, rangeCount;
+  lovrMeshGetDrawRange(source, &rangeStart, &rangeCount);
+  lovrMeshSetDrawRange(mesh, rangeStart, rangeCount);
+  lovrMeshSetMaterial(mesh, lovrMeshGetMaterial(source));
+  model->skinnedMeshes[index] = mesh;
+}
+
+// Runs the skinning shader for every skinned primitive.  This only happens when the pose changes,
+// so the skinned vertices are reused by every view and pass that draws the Model afterwards.
+static void skinModel(Model* model) {
+  ModelData* data = model->data;
+  Shader* shader = lovrGraphicsGetSkinningShader();
+
+  char* poses = lovrBufferMap(model->poseBuffer, 0, true);
+  size_t slot = 0;
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    if (data->nodes[i].skin != ~0u) {
+      size_t poseSize = data->skins[data->nodes[i].skin].jointCount * 16 * sizeof(float);
+      memcpy(poses + slot++ * model->poseStride, model->poses + model->poseOffsets[i], poseSize);
+    }
+  }
+  lovrBufferFlush(model->poseBuffer, 0, slot * model->poseStride);
+  lovrBufferUnmap(model->poseBuffer);
+
+  slot = 0;
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    ModelNode* node = &data->nodes[i];
+
+    if (node->skin == ~0u) {
+      continue;
+    }
+
+    size_t poseSize = data->skins[node->skin].jointCount * 16 * sizeof(float);
+    lovrShaderSetBlock(shader, "lovrSkinPose", model->poseBuffer, slot++ * model->poseStride, poseSize, ACCESS_READ);
+
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      uint32_t index = node->primitiveIndex + j;
+
+      if (!model->skinnedMeshes[index]) {
+        continue;
+      }
+
+      uint32_t vertexCount = lovrMeshGetVertexCount(model->skinnedMeshes[index]);
+      lovrShaderSetBlock(shader, "lovrSkinVertices", model->skinVertices[index], 0, vertexCount * 16 * sizeof(float), ACCESS_READ);
+      lovrShaderSetBlock(shader, "lovrSkinnedVertices", model->skinnedVertices[index], 0, vertexCount * 8 * sizeof(float), ACCESS_WRITE);
+      lovrGraphicsCompute(shader, (vertexCount + 63) / 64, 1, 1);
+    }
+  }
+}
+
+#define QUANTIZED_STRIDE 28
+
+static const MeshAttribute quantizedLayout[] = {
+  [ATTR_POSITION] = { .offset = 0, .stride = QUANTIZED_STRIDE, .type = U16, .components = 4, .normalized = true },
+  [ATTR_NORMAL] = { .offset = 8, .stride = QUANTIZED_STRIDE, .type = I16, .components = 4, .normalized = true },
+  [ATTR_TEXCOORD] = { .offset = 24, .stride = QUANTIZED_STRIDE, .type = U16, .components = 2, .normalized = true },
+  [ATTR_TANGENT] = { .offset = 16, .stride = QUANTIZED_STRIDE, .type = I16, .components = 4, .normalized = true }
+};
+
+static uint16_t quantizeUnorm(float x) {
+  return (uint16_t) (CLAMP(x, 0.f, 1.f) * 65535.f + .5f);
+}
+
+static int16_t quantizeSnorm(float x) {
+  return (int16_t) roundf(CLAMP(x, -1.f, 1.f) * 32767.f);
+}
+
+// Builds quantized vertices for a primitive, sharing them with an earlier primitive if it has the
+// same attributes.  Skinned primitives are left alone, since skinning happens before the dequantize
+// transform could be applied.  Texture coordinates are only quantized if they're all in [0, 1].
+static void quantizePrimitive(Model* model, uint32_t index) {
+  ModelData* data = model->data;
+  ModelPrimitive* primitive = &data->primitives[index];
+  ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+  QuantizedVertices* quantized = &model->quantized[index];
+
+  if (!position || position->count == 0 || position->components < 3 || primitive->attributes[ATTR_BONES] || primitive->attributes[ATTR_WEIGHTS]) {
+    return;
+  }
+
+  for (uint32_t i = 0; i < index; i++) {
+    if (!memcmp(data->primitives[i].attributes, primitive->attributes, sizeof(primitive->attributes))) {
+      *quantized = model->quantized[i];
+      lovrRetain(quantized->buffer);
+      return;
+    }
+  }
+
+  uint32_t count = position->count;
+  float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  bool texCoord = !!primitive->attributes[ATTR_TEXCOORD];
+  for (uint32_t v = 0; v < count; v++) {
+    float p[4];
+    readAttribute(data, position, v, p);
+    for (uint32_t i = 0; i < 3; i++) {
+      min[i] = MIN(min[i], p[i]);
+      max[i] = MAX(max[i], p[i]);
+    }
+
+    if (texCoord) {
+      float uv[4];
+      readAttribute(data, primitive->attributes[ATTR_TEXCOORD], v, uv);
+      texCoord = uv[0] >= 0.f && uv[0] <= 1.f && uv[1] >= 0.f && uv[1] <= 1.f;
+    }
+  }
+
+  float extent = MAX(MAX(max[0] - min[0], max[1] - min[1]), max[2] - min[2]);
+  float scale = extent > 0.f ? 1.f / extent : 0.f;
+
+  char* vertices = calloc(count, QUANTIZED_STRIDE);
+  lovrAssert(vertices, "Out of memory");
+
+  for (uint32_t v = 0; v < count; v++) {
+    char* vertex = vertices + v * QUANTIZED_STRIDE;
+    float value[4] = { 0.f, 0.f, 0.f, 1.f };
+
+    uint16_t* p = (uint16_t*) (vertex + quantizedLayout[ATTR_POSITION].offset);
+    readAttribute(data, position, v, value);
+    for (uint32_t i = 0; i < 3; i++) {
+      p[i] = quantizeUnorm((value[i] - min[i]) * scale);
+    }
+    p[3] = 65535;
+
+    if (primitive->attributes[ATTR_NORMAL]) {
+      int16_t* n = (int16_t*) (vertex + quantizedLayout[ATTR_NORMAL].offset);
+      readAttribute(data, primitive->attributes[ATTR_NORMAL], v, value);
+      for (uint32_t i = 0; i < 3; i++) {
+        n[i] = quantizeSnorm(value[i]);
+      }
+    }
+
+    if (primitive->attributes[ATTR_TANGENT]) {
+      int16_t* t = (int16_t*) (vertex + quantizedLayout[ATTR_TANGENT].offset);
+      value[3] = 1.f;
+      readAttribute(data, primitive->attributes[ATTR_TANGENT], v, value);
+      for (uint32_t i = 0; i < 4; i++) {
+        t[i] = quantizeSnorm(value[i]);
+      }
+    }
+
+    if (texCoord) {
+      uint16_t* uv = (uint16_t*) (vertex + quantizedLayout[ATTR_TEXCOORD].offset);
+      readAttribute(data, primitive->attributes[ATTR_TEXCOORD], v, value);
+      uv[0] = quantizeUnorm(value[0]);
+      uv[1] = quantizeUnorm(value[1]);
+    }
+  }
+
+  quantized->buffer = lovrBufferCreate(count * QUANTIZED_STRIDE, vertices, BUFFER_VERTEX, USAGE_STATIC, false);
+  quantized->texCoord = texCoord;
+  mat4_identity(quantized->dequantize);
+  mat4_translate(quantized->dequantize, min[0], min[1], min[2]);
+  mat4_scale(quantized->dequantize, extent, extent, extent);
+  free(vertices);
+}
+
+// Creates a Mesh with the vertex attributes and material of a primitive, but no index buffer
+static Mesh* createPrimitiveMesh(Model* model, ModelPrimitive* primitive) {
+  uint32_t vertexCount = primitive->attributes[ATTR_POSITION] ? primitive->attributes[ATTR_POSITION]->count : 0;
+  Mesh* mesh = lovrMeshCreate(primitive->mode, NULL, vertexCount);
+
+  if (primitive->material != ~0u) {
+    lovrMeshSetMaterial(mesh, model->materials[primitive->material]);
+  }
+
+  QuantizedVertices* quantized = model->quantized ? &model->quantized[primitive - model->data->primitives] : NULL;
+
+  bool setDrawRange = false;
+  for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
+    if (primitive->attributes[j]) {
+      ModelAttribute* attribute = primitive->attributes[j];
+
+      if (quantized && quantized->buffer && (j != ATTR_TEXCOORD || quantized->texCoord) && j <= ATTR_TANGENT && quantizedLayout[j].components > 0) {
+        MeshAttribute meshAttribute = quantizedLayout[j];
+        meshAttribute.buffer = quantized->buffer;
+        lovrMeshAttachAttribute(mesh, lovrShaderAttributeNames[j], &meshAttribute);
+
+        if (!setDrawRange && !primitive->indices) {
+          lovrMeshSetDrawRange(mesh, 0, attribute->count);
+          setDrawRange = true;
+        }
+
+        continue;
+      }
+
+      if (!model->buffers[attribute->buffer]) {
+        ModelBuffer* buffer = &model->data->buffers[attribute->buffer];
+        model->buffers[attribute->buffer] = lovrBufferCreate(buffer->size, buffer->data, BUFFER_VERTEX, USAGE_STATIC, false);
+      }
+
+      lovrMeshAttachAttribute(mesh, lovrShaderAttributeNames[j], &(MeshAttribute) {
+        .buffer = model->buffers[attribute->buffer],
+        .offset = attribute->offset,
+        .stride = model->data->buffers[attribute->buffer].stride,
+        .type = attribute->type,
+        .components = attribute->components,
+        .normalized = attribute->normalized
+      });
+
+      if (!setDrawRange && !primitive->indices) {
+        lovrMeshSetDrawRange(mesh, 0, attribute->count);
+        setDrawRange = true;
+      }
+    }
+  }
+
+  lovrMeshAttachAttribute(mesh, "lovrDrawID", &(MeshAttribute) {
+    .buffer = lovrGraphicsGetIdentityBuffer(),
+    .type = U8,
+    .components = 1,
+    .divisor = 1
+  });
+
+  return mesh;
+}
+
+Model* lovrModelCreate(ModelData* data, bool streamTextures, bool quantize) {
   Model* model = calloc(1, sizeof(Model));
   lovrAssert(model, "Out of memory");
-  model->ref = 1;
+  model->ref = LOVR_REF_LOCAL | 1;
   model->data = data;
+  model->streaming = streamTextures;
   lovrRetain(data);
 
   // Materials
@@ -112,7 +710,15 @@ Model* lovrModelCreate(ModelData* data) {
           if (!model->textures[index]) {
             Image* image = data->images[index];
             bool srgb = j == TEXTURE_DIFFUSE || j == TEXTURE_EMISSIVE;
-            model->textures[index] = lovrTextureCreate(TEXTURE_2D, &image, 1, srgb, true, 0);
+            if (streamTextures) {
+              model->textures[index] = lovrTextureCreate(TEXTURE_2D, NULL, 0, srgb, true, 0);
+              lovrTextureAllocate(model->textures[index], image->width, image->height, 1, image->format);
+              if (!lovrGraphicsStreamTexture(model->textures[index], image)) {
+                lovrTextureReplacePixels(model->textures[index], image, 0, 0, 0, 0);
+              }
+            } else {
+              model->textures[index] = lovrTextureCreate(TEXTURE_2D, &image, 1, srgb, true, 0);
+            }
             lovrTextureSetFilter(model->textures[index], data->materials[i].filters[j]);
             lovrTextureSetWrap(model->textures[index], data->materials[i].wraps[j]);
           }
@@ -131,48 +737,18 @@ Model* lovrModelCreate(ModelData* data) {
       model->buffers = calloc(data->bufferCount, sizeof(Buffer*));
     }
 
+    if (quantize) {
+      model->quantized = calloc(data->primitiveCount, sizeof(QuantizedVertices));
+      lovrAssert(model->quantized, "Out of memory");
+      for (uint32_t i = 0; i < data->primitiveCount; i++) {
+        quantizePrimitive(model, i);
+      }
+    }
+
     model->meshes = calloc(data->primitiveCount, sizeof(Mesh*));
     for (uint32_t i = 0; i < data->primitiveCount; i++) {
       ModelPrimitive* primitive = &data->primitives[i];
-      uint32_t vertexCount = primitive->attributes[ATTR_POSITION] ? primitive->attributes[ATTR_POSITION]->count : 0;
-      model->meshes[i] = lovrMeshCreate(primitive->mode, NULL, vertexCount);
-
-      if (primitive->material != ~0u) {
-        lovrMeshSetMaterial(model->meshes[i], model->materials[primitive->material]);
-      }
-
-      bool setDrawRange = false;
-      for (uint32_t j = 0; j < MAX_DEFAULT_ATTRIBUTES; j++) {
-        if (primitive->attributes[j]) {
-          ModelAttribute* attribute = primitive->attributes[j];
-
-          if (!model->buffers[attribute->buffer]) {
-            ModelBuffer* buffer = &data->buffers[attribute->buffer];
-            model->buffers[attribute->buffer] = lovrBufferCreate(buffer->size, buffer->data, BUFFER_VERTEX, USAGE_STATIC, false);
-          }
-
-          lovrMeshAttachAttribute(model->meshes[i], lovrShaderAttributeNames[j], &(MeshAttribute) {
-            .buffer = model->buffers[attribute->buffer],
-            .offset = attribute->offset,
-            .stride = data->buffers[attribute->buffer].stride,
-            .type = attribute->type,
-            .components = attribute->components,
-            .normalized = attribute->normalized
-          });
-
-          if (!setDrawRange && !primitive->indices) {
-            lovrMeshSetDrawRange(model->meshes[i], 0, attribute->count);
-            setDrawRange = true;
-          }
-        }
-      }
-
-      lovrMeshAttachAttribute(model->meshes[i], "lovrDrawID", &(MeshAttribute) {
-        .buffer = lovrGraphicsGetIdentityBuffer(),
-        .type = U8,
-        .components = 1,
-        .divisor = 1
-      });
+      model->meshes[i] = createPrimitiveMesh(model, primitive);
 
       if (primitive->indices) {
         ModelAttribute* attribute = primitive->indices;
@@ -189,12 +765,166 @@ Model* lovrModelCreate(ModelData* data) {
     }
   }
 
-  // Ensure skin bone count doesn't exceed the maximum supported limit
+  // LODs reuse the vertex attributes of their primitive and draw from a shared index buffer
+  if (data->lodIndexCount > 0) {
+    model->lodBuffer = lovrBufferCreate(data->lodIndexCount * sizeof(uint32_t), data->lodIndices, BUFFER_INDEX, USAGE_STATIC, false);
+    model->lodMeshes = calloc(data->primitiveCount * (MAX_LODS - 1), sizeof(Mesh*));
+    lovrAssert(model->lodMeshes, "Out of memory");
+    for (uint32_t i = 0; i < data->primitiveCount; i++) {
+      ModelPrimitive* primitive = &data->primitives[i];
+      for (uint32_t j = 0; j < primitive->lodCount; j++) {
+        ModelLod* lod = &primitive->lods[j];
+        Mesh* mesh = createPrimitiveMesh(model, primitive);
+        lovrMeshSetIndexBuffer(mesh, model->lodBuffer, lod->count, sizeof(uint32_t), lod->start * sizeof(uint32_t));
+        lovrMeshSetDrawRange(mesh, 0, lod->count);
+        model->lodMeshes[i * (MAX_LODS - 1) + j] = mesh;
+      }
+    }
+  }
+
+  model->nodeLods = calloc(data->nodeCount, sizeof(uint8_t));
+  lovrAssert(model->nodeLods, "Out of memory");
+  model->lod = true;
+
+  // Ensure skin bone count doesn't exceed the maximum supported limit.  Each skinned node gets a
+  // slot for its joint matrices that is big enough for the largest skin.
+  uint32_t maxJointCount = 0;
   for (uint32_t i = 0; i < data->skinCount; i++) {
     uint32_t jointCount = data->skins[i].jointCount;
-    lovrAssert(jointCount < MAX_BONES, "ModelData skin '%d' has too many joints (%d, max is %d)", i, jointCount, MAX_BONES);
+    lovrAssert(jointCount <= MAX_BONES, "ModelData skin '%d' has too many joints (%d, max is %d)", i, jointCount, MAX_BONES);
+    maxJointCount = MAX(maxJointCount, jointCount);
+  }
+
+  if (maxJointCount > 0) {
+    uint32_t skinnedNodeCount = 0;
+    model->poseOffsets = malloc(data->nodeCount * sizeof(uint32_t));
+    lovrAssert(model->poseOffsets, "Out of memory");
+    for (uint32_t i = 0; i < data->nodeCount; i++) {
+      model->poseOffsets[i] = 16 * maxJointCount * skinnedNodeCount;
+      skinnedNodeCount += data->nodes[i].skin != ~0u;
+    }
+    model->poses = malloc(16 * sizeof(float) * maxJointCount * MAX(skinnedNodeCount, 1));
+    lovrAssert(model->poses, "Out of memory");
+    model->posesDirty = true;
+  }
+
+  // Node bounds are in the local space of the node.  If any primitive is missing its bounds, the
+  // node is left with an empty (inverted) box and never gets culled.
+  model->nodeBounds = malloc(6 * sizeof(float) * data->nodeCount);
+  lovrAssert(model->nodeBounds, "Out of memory");
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    ModelNode* node = &data->nodes[i];
+    float* bounds = model->nodeBounds + 6 * i;
+    bounds[0] = bounds[2] = bounds[4] = FLT_MAX;
+    bounds[1] = bounds[3] = bounds[5] = -FLT_MAX;
+
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      ModelAttribute* position = data->primitives[node->primitiveIndex + j].attributes[ATTR_POSITION];
+      if (!position || !position->hasMin || !position->hasMax) {
+        bounds[0] = FLT_MAX;
+        bounds[1] = -FLT_MAX;
+        break;
+      }
+
+      for (uint32_t k = 0; k < 3; k++) {
+        bounds[2 * k + 0] = MIN(bounds[2 * k + 0], position->min[k]);
+        bounds[2 * k + 1] = MAX(bounds[2 * k + 1], position->max[k]);
+      }
+    }
+  }
+
+  // Keyframe cursors, one per animation channel
+  if (data->animationCount > 0) {
+    uint32_t channelCount = 0;
+    model->animationCursors = malloc(data->animationCount * sizeof(uint32_t));
+    lovrAssert(model->animationCursors, "Out of memory");
+    for (uint32_t i = 0; i < data->animationCount; i++) {
+      model->animationCursors[i] = channelCount;
+      channelCount += data->animations[i].channelCount;
+    }
+
+    model->keyframeCursors = calloc(MAX(channelCount, 1), sizeof(uint32_t));
+    lovrAssert(model->keyframeCursors, "Out of memory");
+  }
+
+  // Flatten the node hierarchy into depth-first order, using the order array as the stack
+  model->nodeOrder = malloc(data->nodeCount * sizeof(uint32_t));
+  model->nodeParents = malloc(data->nodeCount * sizeof(uint32_t));
+  model->nodesDirty = calloc(data->nodeCount, sizeof(bool));
+  lovrAssert(model->nodeOrder && model->nodeParents && model->nodesDirty, "Out of memory");
+  if (data->nodeCount > 0) {
+    uint32_t* stack = malloc(data->nodeCount * sizeof(uint32_t));
+    lovrAssert(stack, "Out of memory");
+    uint32_t top = 0;
+    stack[top++] = data->rootNode;
+    model->nodeParents[data->rootNode] = ~0u;
+    while (top > 0 && model->nodeOrderCount < data->nodeCount) {
+      uint32_t nodeIndex = stack[--top];
+      ModelNode* node = &data->nodes[nodeIndex];
+      model->nodeOrder[model->nodeOrderCount++] = nodeIndex;
+      for (uint32_t i = node->childCount; i > 0 && top < data->nodeCount; i--) {
+        model->nodeParents[node->children[i - 1]] = nodeIndex;
+        stack[top++] = node->children[i - 1];
+      }
+    }
+    free(stack);
+  }
+
+  // Per-instance transforms of nodes using EXT_mesh_gpu_instancing, relative to their node
+  uint32_t instanceTotal = 0;
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    instanceTotal += data->nodes[i].instanceCount;
+  }
+
+  if (instanceTotal > 0) {
+    model->instanceTransforms = malloc(16 * sizeof(float) * instanceTotal);
+    model->instanceOffsets = malloc(data->nodeCount * sizeof(uint32_t));
+    lovrAssert(model->instanceTransforms && model->instanceOffsets, "Out of memory");
+    float* transform = model->instanceTransforms;
+    for (uint32_t i = 0, offset = 0; i < data->nodeCount; i++) {
+      ModelNode* node = &data->nodes[i];
+      model->instanceOffsets[i] = offset;
+      offset += node->instanceCount;
+      for (uint32_t j = 0; j < node->instanceCount; j++, transform += 16) {
+        float translation[4] = { 0.f, 0.f, 0.f, 0.f };
+        float rotation[4] = { 0.f, 0.f, 0.f, 1.f };
+        float scale[4] = { 1.f, 1.f, 1.f, 1.f };
+        if (node->instances[PROP_TRANSLATION]) readAttribute(data, node->instances[PROP_TRANSLATION], j, translation);
+        if (node->instances[PROP_ROTATION]) readAttribute(data, node->instances[PROP_ROTATION], j, rotation);
+        if (node->instances[PROP_SCALE]) readAttribute(data, node->instances[PROP_SCALE], j, scale);
+        mat4_identity(transform);
+        mat4_translate(transform, translation[0], translation[1], translation[2]);
+        mat4_rotateQuat(transform, rotation);
+        mat4_scale(transform, scale[0], scale[1], scale[2]);
+      }
+    }
+  }
+
+  // Primitives used by more than one static node are drawn together, see DeferredDraw
+  uint32_t* references = calloc(MAX(data->primitiveCount, 1), sizeof(uint32_t));
+  lovrAssert(references, "Out of memory");
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    ModelNode* node = &data->nodes[i];
+    if (node->skin == ~0u && node->instanceCount == 0) {
+      for (uint32_t j = 0; j < node->primitiveCount; j++) {
+        references[node->primitiveIndex + j]++;
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < data->primitiveCount; i++) {
+    if (references[i] > 1) {
+      if (!model->primitivesRepeated) {
+        model->primitivesRepeated = calloc(data->primitiveCount, sizeof(bool));
+        lovrAssert(model->primitivesRepeated, "Out of memory");
+      }
+      model->primitivesRepeated[i] = true;
+    }
   }
+  free(references);
+  arr_init(&model->deferred, realloc);
 
+  model->culling = true;
   model->localTransforms = malloc(sizeof(NodeTransform) * data->nodeCount);
   model->globalTransforms = malloc(16 * sizeof(float) * data->nodeCount);
   lovrModelResetPose(model);
@@ -232,9 +962,81 @@ void lovrModelDestroy(void* ref) {
     free(model->materials);
   }
 
+  if (model->lodMeshes) {
+    for (uint32_t i = 0; i < model->data->primitiveCount * (MAX_LODS - 1); i++) {
+      lovrRelease(model->lodMeshes[i], lovrMeshDestroy);
+    }
+    free(model->lodMeshes);
+  }
+
+  lovrRelease(model->lodBuffer, lovrBufferDestroy);
+
+  if (model->quantized) {
+    for (uint32_t i = 0; i < model->data->primitiveCount; i++) {
+      lovrRelease(model->quantized[i].buffer, lovrBufferDestroy);
+    }
+    free(model->quantized);
+  }
+
+  if (model->baked) {
+    for (uint32_t i = 0; i < model->bakedCount; i++) {
+      lovrRelease(model->baked[i].mesh, lovrMeshDestroy);
+    }
+    free(model->baked);
+  }
+
+  lovrRelease(model->bakedVertices, lovrBufferDestroy);
+  lovrRelease(model->bakedIndices, lovrBufferDestroy);
+  free(model->nodesBaked);
+  free(model->instanceTransforms);
+  free(model->instanceOffsets);
+  free(model->primitivesRepeated);
+  arr_free(&model->deferred);
+  free(model->nodeLods);
   lovrRelease(model->data, lovrModelDataDestroy);
   free(model->globalTransforms);
+  free(model->nodeOrder);
+  free(model->nodeParents);
+  free(model->nodesDirty);
   free(model->localTransforms);
+  free(model->nodeBounds);
+  free(model->poses);
+  free(model->poseOffsets);
+
+  // Boxes tested this frame might still be waiting in a batch
+  if (model->occlusionQueries) {
+    for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+      if (model->occlusionQueries[i].frame == lovrGraphicsGetFrameIndex()) {
+        lovrGraphicsFlush();
+        break;
+      }
+    }
+
+    for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+      if (model->occlusionQueries[i].id) {
+        lovrGpuDestroyOcclusionQuery(model->occlusionQueries[i].id);
+      }
+    }
+    free(model->occlusionQueries);
+  }
+
+  free(model->keyframeCursors);
+  free(model->blendValues);
+  free(model->blendWeights);
+  free(model->animationCursors);
+
+  if (model->skinnedMeshes) {
+    for (uint32_t i = 0; i < model->data->primitiveCount; i++) {
+      lovrRelease(model->skinnedMeshes[i], lovrMeshDestroy);
+      lovrRelease(model->skinVertices[i], lovrBufferDestroy);
+      lovrRelease(model->skinnedVertices[i], lovrBufferDestroy);
+    }
+    free(model->skinnedMeshes);
+    free(model->skinVertices);
+    free(model->skinnedVertices);
+    lovrRelease(model->poseBuffer, lovrBufferDestroy);
+  }
+
   free(model);
 }
 
@@ -242,24 +1044,122 @@ ModelData* lovrModelGetModelData(Model* model) {
   return model->data;
 }
 
+float lovrModelGetStreamProgress(Model* model) {
+  if (!model->textures) {
+    return 1.f;
+  }
+
+  float progress = 0.f;
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < model->data->imageCount; i++) {
+    if (model->textures[i]) {
+      progress += lovrGraphicsGetStreamProgress(model->textures[i]);
+      count++;
+    }
+  }
+  return count > 0 ? progress / count : 1.f;
+}
+
 void lovrModelDraw(Model* model, mat4 transform, uint32_t instances) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
+  updateGlobalTransforms(model);
+  updatePoses(model);
+
+  if (model->computeSkinning && model->skinningDirty) {
+    skinModel(model);
+    model->skinningDirty = false;
   }
 
   lovrGraphicsPush();
   lovrGraphicsMatrixTransform(transform);
   renderNode(model, model->data->rootNode, instances);
+
+  if (model->deferred.length > 0) {
+    qsort(model->deferred.data, model->deferred.length, sizeof(DeferredDraw), compareDeferredDraws);
+    for (size_t i = 0; i < model->deferred.length; i++) {
+      lovrGraphicsDrawMesh(model->deferred.data[i].mesh, model->deferred.data[i].transform, 1, NULL, 0);
+    }
+    model->deferred.length = 0;
+  }
+
+  for (uint32_t i = 0; i < model->bakedCount; i++) {
+    BakedBatch* batch = &model->baked[i];
+
+    if (model->culling && instances <= 1 && !lovrGraphicsIsBoxVisible(batch->bounds, NULL)) {
+      continue;
+    }
+
+    if (model->streaming) {
+      float screenSize = lovrGraphicsGetBoxScreenSize(batch->bounds, NULL);
+      Material* material = lovrMeshGetMaterial(batch->mesh);
+      for (uint32_t j = 0; material && j < MAX_MATERIAL_TEXTURES; j++) {
+        Texture* texture = lovrMaterialGetTexture(material, j);
+        if (texture) lovrGraphicsPrioritizeTexture(texture, screenSize);
+      }
+    }
+
+    lovrGraphicsDrawMesh(batch->mesh, NULL, instances, NULL, 0);
+  }
+
   lovrGraphicsPop();
 }
 
-void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha) {
-  if (alpha <= 0.f) {
-    return;
+// Samples the value of an animation channel at a time
+static void sampleChannel(Model* model, uint32_t animationIndex, uint32_t channelIndex, float time, float* property) {
+  ModelAnimationChannel* channel = &model->data->animations[animationIndex].channels[channelIndex];
+  uint32_t* cursor = &model->keyframeCursors[model->animationCursors[animationIndex] + channelIndex];
+  uint32_t keyframe = findKeyframe(channel, cursor, time);
+
+  bool rotate = channel->property == PROP_ROTATION;
+  size_t n = 3 + rotate;
+  float* (*lerp)(float* a, float* b, float t) = rotate ? quat_slerp : vec3_lerp;
+
+  if (keyframe == 0 || keyframe >= channel->keyframeCount) {
+    size_t index = MIN(keyframe, channel->keyframeCount - 1);
+
+    // For cubic interpolation, each keyframe has 3 parts, and the actual data is in the middle (*3, +1)
+    if (channel->smoothing == SMOOTH_CUBIC) {
+      index = 3 * index + 1;
+    }
+
+    memcpy(property, channel->data + index * n, n * sizeof(float));
+  } else {
+    float t1 = channel->times[keyframe - 1];
+    float t2 = channel->times[keyframe];
+    float z = (time - t1) / (t2 - t1);
+
+    switch (channel->smoothing) {
+      case SMOOTH_STEP:
+        memcpy(property, channel->data + (z >= .5f ? keyframe : keyframe - 1) * n, n * sizeof(float));
+        break;
+      case SMOOTH_LINEAR:
+        memcpy(property, channel->data + (keyframe - 1) * n, n * sizeof(float));
+        lerp(property, channel->data + keyframe * n, z);
+        break;
+      case SMOOTH_CUBIC: {
+        size_t stride = 3 * n;
+        float* p0 = channel->data + (keyframe - 1) * stride + 1 * n;
+        float* m0 = channel->data + (keyframe - 1) * stride + 2 * n;
+        float* p1 = channel->data + (keyframe - 0) * stride + 1 * n;
+        float* m1 = channel->data + (keyframe - 0) * stride + 0 * n;
+        float dt = t2 - t1;
+        float z2 = z * z;
+        float z3 = z2 * z;
+        float a = 2.f * z3 - 3.f * z2 + 1.f;
+        float b = 2.f * z3 - 3.f * z2 + 1.f;
+        float c = (-2.f * z3 + 3.f * z2);
+        float d = (z3 * -z2) * dt;
+        for (size_t j = 0; j < n; j++) {
+          property[j] = a * p0[j] + b * m0[j] + c * p1[j] + d * m1[j];
+        }
+        break;
+      }
+      default:
+        break;
+    }
   }
+}
 
-  lovrAssert(animationIndex < model->data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", animationIndex, model->data->animationCount);
+static void animate(Model* model, uint32_t animationIndex, float time, float alpha) {
   ModelAnimation* animation = &model->data->animations[animationIndex];
   time = fmodf(time, animation->duration);
 
@@ -268,69 +1168,147 @@ void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float a
     uint32_t nodeIndex = channel->nodeIndex;
     NodeTransform* transform = &model->localTransforms[nodeIndex];
 
-    uint32_t keyframe = 0;
-    while (keyframe < channel->keyframeCount && channel->times[keyframe] < time) {
-      keyframe++;
-    }
-
     float property[4];
+    sampleChannel(model, animationIndex, i, time, property);
     bool rotate = channel->property == PROP_ROTATION;
     size_t n = 3 + rotate;
     float* (*lerp)(float* a, float* b, float t) = rotate ? quat_slerp : vec3_lerp;
 
-    if (keyframe == 0 || keyframe >= channel->keyframeCount) {
-      size_t index = MIN(keyframe, channel->keyframeCount - 1);
+    if (alpha >= 1.f) {
+      memcpy(transform->properties[channel->property], property, n * sizeof(float));
+    } else {
+      lerp(transform->properties[channel->property], property, alpha);
+    }
+
+    markNodeDirty(model, nodeIndex);
+  }
+}
+
+void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha) {
+  if (alpha <= 0.f) {
+    return;
+  }
+
+  lovrAssert(animationIndex < model->data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", animationIndex, model->data->animationCount);
+  animate(model, animationIndex, time, alpha);
+}
+
+typedef struct {
+  Model** models;
+  AnimationLayer* layers;
+} AnimateContext;
+
+static void animateRange(void* arg, uint32_t start, uint32_t end) {
+  AnimateContext* context = arg;
+  for (uint32_t i = start; i < end; i++) {
+    Model* model = context->models[i];
+    AnimationLayer* layer = &context->layers[i];
+    if (layer->weight > 0.f) {
+      animate(model, layer->animation, layer->time, layer->weight);
+    }
+    updateGlobalTransforms(model);
+    updatePoses(model);
+  }
+}
 
-      // For cubic interpolation, each keyframe has 3 parts, and the actual data is in the middle (*3, +1)
-      if (channel->smoothing == SMOOTH_CUBIC) {
-        index = 3 * index + 1;
+// Animates each Model with its own layer, on the thread pool.  Models only touch their own state
+// while animating, so they run in parallel as long as none of them is in the list twice.  The
+// global transforms and joint matrices are updated too, so drawing them afterwards (or skinning
+// them with compute) only has to upload the results.
+void lovrModelAnimateAll(Model** models, AnimationLayer* layers, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t animationCount = models[i]->data->animationCount;
+    lovrAssert(layers[i].weight <= 0.f || layers[i].animation < animationCount, "Invalid animation index '%d' (Model only has %d animations)", layers[i].animation, animationCount);
+  }
+
+  uint32_t marked = 0;
+  bool duplicate = false;
+  while (marked < count && !duplicate) {
+    duplicate = models[marked]->animating;
+    models[marked++]->animating = true;
+  }
+
+  for (uint32_t i = 0; i < marked; i++) {
+    models[i]->animating = false;
+  }
+
+  lovrAssert(!duplicate, "A Model can only be animated once per call");
+
+  AnimateContext context = { models, layers };
+#ifndef LOVR_DISABLE_THREAD
+  lovrThreadPoolParallelFor(animateRange, &context, count, 4);
+#else
+  animateRange(&context, 0, count);
+#endif
+}
+
+// Blends several animations in one pass.  Each node property is the weighted average of the layers
+// that animate it, and properties that none of the layers animate are left alone.
+void lovrModelBlendAnimations(Model* model, AnimationLayer* layers, uint32_t count) {
+  ModelData* data = model->data;
+
+  if (!model->blendValues) {
+    model->blendValues = malloc(data->nodeCount * 3 * 4 * sizeof(float));
+    model->blendWeights = malloc(data->nodeCount * 3 * sizeof(float));
+    lovrAssert(model->blendValues && model->blendWeights, "Out of memory");
+  }
+
+  memset(model->blendWeights, 0, data->nodeCount * 3 * sizeof(float));
+
+  for (uint32_t i = 0; i < count; i++) {
+    AnimationLayer* layer = &layers[i];
+    if (layer->weight <= 0.f) {
+      continue;
+    }
+
+    lovrAssert(layer->animation < data->animationCount, "Invalid animation index '%d' (Model only has %d animations)", layer->animation, data->animationCount);
+    ModelAnimation* animation = &data->animations[layer->animation];
+    float time = fmodf(layer->time, animation->duration);
+
+    for (uint32_t j = 0; j < animation->channelCount; j++) {
+      ModelAnimationChannel* channel = &animation->channels[j];
+      uint32_t slot = 3 * channel->nodeIndex + channel->property;
+      float* value = model->blendValues + 4 * slot;
+      float* total = model->blendWeights + slot;
+      bool rotate = channel->property == PROP_ROTATION;
+      size_t n = 3 + rotate;
+
+      float property[4];
+      sampleChannel(model, layer->animation, j, time, property);
+
+      // Quaternions on opposite hemispheres would cancel out, so they're flipped to match
+      float sign = 1.f;
+      if (rotate && *total > 0.f) {
+        float dot = value[0] * property[0] + value[1] * property[1] + value[2] * property[2] + value[3] * property[3];
+        sign = dot < 0.f ? -1.f : 1.f;
       }
 
-      memcpy(property, channel->data + index * n, n * sizeof(float));
-    } else {
-      float t1 = channel->times[keyframe - 1];
-      float t2 = channel->times[keyframe];
-      float z = (time - t1) / (t2 - t1);
-
-      switch (channel->smoothing) {
-        case SMOOTH_STEP:
-          memcpy(property, channel->data + (z >= .5f ? keyframe : keyframe - 1) * n, n * sizeof(float));
-          break;
-        case SMOOTH_LINEAR:
-          memcpy(property, channel->data + (keyframe - 1) * n, n * sizeof(float));
-          lerp(property, channel->data + keyframe * n, z);
-          break;
-        case SMOOTH_CUBIC: {
-          size_t stride = 3 * n;
-          float* p0 = channel->data + (keyframe - 1) * stride + 1 * n;
-          float* m0 = channel->data + (keyframe - 1) * stride + 2 * n;
-          float* p1 = channel->data + (keyframe - 0) * stride + 1 * n;
-          float* m1 = channel->data + (keyframe - 0) * stride + 0 * n;
-          float dt = t2 - t1;
-          float z2 = z * z;
-          float z3 = z2 * z;
-          float a = 2.f * z3 - 3.f * z2 + 1.f;
-          float b = 2.f * z3 - 3.f * z2 + 1.f;
-          float c = (-2.f * z3 + 3.f * z2);
-          float d = (z3 * -z2) * dt;
-          for (size_t j = 0; j < n; j++) {
-            property[j] = a * p0[j] + b * m0[j] + c * p1[j] + d * m1[j];
-          }
-          break;
-        }
-        default:
-          break;
+      for (size_t k = 0; k < n; k++) {
+        value[k] = (*total > 0.f ? value[k] : 0.f) + property[k] * sign * layer->weight;
       }
-    }
 
-    if (alpha >= 1.f) {
-      memcpy(transform->properties[channel->property], property, n * sizeof(float));
-    } else {
-      lerp(transform->properties[channel->property], property, alpha);
+      *total += layer->weight;
     }
   }
 
-  model->transformsDirty = true;
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    for (uint32_t p = 0; p < 3; p++) {
+      float total = model->blendWeights[3 * i + p];
+      if (total <= 0.f) {
+        continue;
+      }
+
+      float* value = model->blendValues + 4 * (3 * i + p);
+      float* property = model->localTransforms[i].properties[p];
+      if (p == PROP_ROTATION) {
+        quat_init(property, quat_normalize(value));
+      } else {
+        vec3_set(property, value[0] / total, value[1] / total, value[2] / total);
+      }
+
+      markNodeDirty(model, i);
+    }
+  }
 }
 
 void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], CoordinateSpace space) {
@@ -339,10 +1317,7 @@ void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], f
     vec3_init(position, model->localTransforms[nodeIndex].properties[PROP_TRANSLATION]);
     quat_init(rotation, model->localTransforms[nodeIndex].properties[PROP_ROTATION]);
   } else {
-    if (model->transformsDirty) {
-      updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-      model->transformsDirty = false;
-    }
+    updateGlobalTransforms(model);
 
     mat4_getPosition(model->globalTransforms + 16 * nodeIndex, position);
     mat4_getOrientation(model->globalTransforms + 16 * nodeIndex, rotation);
@@ -363,7 +1338,7 @@ void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float ro
     vec3_lerp(transform->properties[PROP_TRANSLATION], position, alpha);
     quat_slerp(transform->properties[PROP_ROTATION], rotation, alpha);
   }
-  model->transformsDirty = true;
+  markNodeDirty(model, nodeIndex);
 }
 
 void lovrModelResetPose(Model* model) {
@@ -377,9 +1352,9 @@ void lovrModelResetPose(Model* model) {
       quat_init(model->localTransforms[i].properties[PROP_ROTATION], model->data->nodes[i].transform.properties.rotation);
       vec3_init(model->localTransforms[i].properties[PROP_SCALE], model->data->nodes[i].transform.properties.scale);
     }
-  }
 
-  model->transformsDirty = true;
+    markNodeDirty(model, i);
+  }
 }
 
 Material* lovrModelGetMaterial(Model* model, uint32_t material) {
@@ -431,16 +1406,89 @@ static void applyAABB(Model* model, uint32_t nodeIndex, float aabb[6]) {
 }
 
 void lovrModelGetAABB(Model* model, float aabb[6]) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
-  }
+  updateGlobalTransforms(model);
 
   aabb[0] = aabb[2] = aabb[4] = FLT_MAX;
   aabb[1] = aabb[3] = aabb[5] = -FLT_MAX;
   applyAABB(model, model->data->rootNode, aabb);
 }
 
+bool lovrModelIsCullingEnabled(Model* model) {
+  return model->culling;
+}
+
+void lovrModelSetCullingEnabled(Model* model, bool enabled) {
+  model->culling = enabled;
+}
+
+bool lovrModelIsOcclusionCullingEnabled(Model* model) {
+  return model->occlusionCulling;
+}
+
+void lovrModelSetOcclusionCullingEnabled(Model* model, bool enabled) {
+  if (enabled && !model->occlusionQueries) {
+    model->occlusionQueries = calloc(model->data->nodeCount, sizeof(OcclusionQuery));
+    lovrAssert(model->occlusionQueries, "Out of memory");
+    for (uint32_t i = 0; i < model->data->nodeCount; i++) {
+      model->occlusionQueries[i].frame = ~0u;
+      model->occlusionQueries[i].visible = true;
+    }
+  }
+
+  model->occlusionCulling = enabled;
+}
+
+bool lovrModelIsLodEnabled(Model* model) {
+  return model->lod;
+}
+
+void lovrModelSetLodEnabled(Model* model, bool enabled) {
+  model->lod = enabled;
+}
+
+bool lovrModelIsComputeSkinningEnabled(Model* model) {
+  return model->computeSkinning;
+}
+
+void lovrModelSetComputeSkinningEnabled(Model* model, bool enabled) {
+  ModelData* data = model->data;
+
+  if (!enabled || data->skinCount == 0) {
+    model->computeSkinning = false;
+    return;
+  }
+
+  if (!model->skinnedMeshes) {
+    lovrAssert(lovrGraphicsGetFeatures()->compute, "Compute skinning requires compute shaders, which are not supported on this system");
+    model->skinnedMeshes = calloc(data->primitiveCount, sizeof(Mesh*));
+    model->skinVertices = calloc(data->primitiveCount, sizeof(Buffer*));
+    model->skinnedVertices = calloc(data->primitiveCount, sizeof(Buffer*));
+    lovrAssert(model->skinnedMeshes && model->skinVertices && model->skinnedVertices, "Out of memory");
+
+    // Every skinned node gets a slot for its joint matrices, aligned for storage buffer bindings
+    uint32_t skinnedNodeCount = 0;
+    uint32_t maxJointCount = 0;
+    for (uint32_t i = 0; i < data->nodeCount; i++) {
+      ModelNode* node = &data->nodes[i];
+      if (node->skin != ~0u) {
+        skinnedNodeCount++;
+        maxJointCount = MAX(maxJointCount, data->skins[node->skin].jointCount);
+        for (uint32_t j = 0; j < node->primitiveCount; j++) {
+          if (!model->skinnedMeshes[node->primitiveIndex + j]) {
+            createSkinnedMesh(model, node->primitiveIndex + j);
+          }
+        }
+      }
+    }
+
+    model->poseStride = ALIGN(MAX(maxJointCount, 1) * 16 * sizeof(float), 256);
+    model->poseBuffer = lovrBufferCreate(MAX(skinnedNodeCount, 1) * model->poseStride, NULL, BUFFER_SHADER_STORAGE, USAGE_DYNAMIC, false);
+  }
+
+  model->computeSkinning = true;
+  model->skinningDirty = true;
+}
+
 static void countVertices(Model* model, uint32_t nodeIndex, uint32_t* vertexCount, uint32_t* indexCount) {
   ModelNode* node = &model->data->nodes[nodeIndex];
 
@@ -511,10 +1559,7 @@ static void collectVertices(Model* model, uint32_t nodeIndex, float** vertices,
 }
 
 void lovrModelGetTriangles(Model* model, float** vertices, uint32_t* vertexCount, uint32_t** indices, uint32_t* indexCount) {
-  if (model->transformsDirty) {
-    updateGlobalTransform(model, model->data->rootNode, (float[]) MAT4_IDENTITY);
-    model->transformsDirty = false;
-  }
+  updateGlobalTransforms(model);
 
   if (!model->vertices) {
     countVertices(model, model->data->rootNode, &model->vertexCount, &model->indexCount);
@@ -532,3 +1577,273 @@ void lovrModelGetTriangles(Model* model, float** vertices, uint32_t* vertexCount
   *vertices = model->vertices;
   *indices = model->indices;
 }
+
+#define BAKED_STRIDE 16
+
+static const MeshAttribute bakedLayout[] = {
+  [ATTR_POSITION] = { .offset = 0, .stride = BAKED_STRIDE * sizeof(float), .type = F32, .components = 3 },
+  [ATTR_NORMAL] = { .offset = 12, .stride = BAKED_STRIDE * sizeof(float), .type = F32, .components = 3 },
+  [ATTR_TEXCOORD] = { .offset = 24, .stride = BAKED_STRIDE * sizeof(float), .type = F32, .components = 2 },
+  [ATTR_COLOR] = { .offset = 32, .stride = BAKED_STRIDE * sizeof(float), .type = F32, .components = 4 },
+  [ATTR_TANGENT] = { .offset = 48, .stride = BAKED_STRIDE * sizeof(float), .type = F32, .components = 4 }
+};
+
+// Primitives can be baked if they're indexed or unindexed triangle lists without joints or LODs
+static bool isPrimitiveBakeable(ModelPrimitive* primitive) {
+  ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+  return position && position->count > 0 && position->components >= 3 &&
+    primitive->mode == DRAW_TRIANGLES &&
+    primitive->lodCount == 0 &&
+    !primitive->attributes[ATTR_BONES] &&
+    !primitive->attributes[ATTR_WEIGHTS];
+}
+
+static uint32_t getBakedAttributes(ModelPrimitive* primitive) {
+  uint32_t mask = 0;
+  for (uint32_t i = ATTR_NORMAL; i <= ATTR_TANGENT; i++) {
+    mask |= primitive->attributes[i] ? (1 << i) : 0;
+  }
+  return mask;
+}
+
+// Writes the vertices of a primitive in the baked layout, transformed by the node's transform.  If
+// the transform mirrors the primitive, the triangles are flipped to keep the winding the same.
+static void bakePrimitive(Model* model, ModelPrimitive* primitive, mat4 transform, BakedBatch* batch, float* vertices, uint32_t* indices) {
+  ModelData* data = model->data;
+  ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+  float* vertex = vertices + (batch->vertexStart + batch->vertexCount) * BAKED_STRIDE;
+
+  float normalMatrix[16];
+  mat4_init(normalMatrix, transform);
+  mat4_invert(normalMatrix);
+  mat4_transpose(normalMatrix);
+
+  float cross[4];
+  vec3_cross(vec3_init(cross, transform + 0), transform + 4);
+  bool mirrored = vec3_dot(cross, transform + 8) < 0.f;
+
+  for (uint32_t i = 0; i < position->count; i++, vertex += BAKED_STRIDE) {
+    float v[4] = { 0.f, 0.f, 0.f, 0.f };
+    readAttribute(data, position, i, v);
+    mat4_transform(transform, v);
+    memcpy(vertex + 0, v, 3 * sizeof(float));
+
+    for (uint32_t j = 0; j < 3; j++) {
+      batch->bounds[2 * j + 0] = MIN(batch->bounds[2 * j + 0], v[j]);
+      batch->bounds[2 * j + 1] = MAX(batch->bounds[2 * j + 1], v[j]);
+    }
+
+    if (primitive->attributes[ATTR_NORMAL]) {
+      float n[4] = { 0.f, 0.f, 0.f, 0.f };
+      readAttribute(data, primitive->attributes[ATTR_NORMAL], i, n);
+      mat4_transformDirection(normalMatrix, n);
+      vec3_normalize(n);
+      memcpy(vertex + 3, n, 3 * sizeof(float));
+    }
+
+    if (primitive->attributes[ATTR_TEXCOORD]) {
+      readAttribute(data, primitive->attributes[ATTR_TEXCOORD], i, vertex + 6);
+    }
+
+    if (primitive->attributes[ATTR_COLOR]) {
+      float c[4] = { 1.f, 1.f, 1.f, 1.f };
+      readAttribute(data, primitive->attributes[ATTR_COLOR], i, c);
+      memcpy(vertex + 8, c, 4 * sizeof(float));
+    }
+
+    if (primitive->attributes[ATTR_TANGENT]) {
+      float t[4] = { 1.f, 0.f, 0.f, 1.f };
+      readAttribute(data, primitive->attributes[ATTR_TANGENT], i, t);
+      float w = mirrored ? -t[3] : t[3];
+      mat4_transformDirection(transform, t);
+      vec3_normalize(t);
+      t[3] = w;
+      memcpy(vertex + 12, t, 4 * sizeof(float));
+    }
+  }
+
+  uint32_t* index = indices + batch->indexStart + batch->indexCount;
+  uint32_t base = batch->vertexCount;
+  uint32_t count;
+
+  if (primitive->indices) {
+    ModelAttribute* attribute = primitive->indices;
+    ModelBuffer* buffer = &data->buffers[attribute->buffer];
+    char* p = buffer->data + attribute->offset;
+    size_t stride = buffer->stride == 0 ? (attribute->type == U16 ? 2 : 4) : buffer->stride;
+    count = attribute->count;
+    for (uint32_t i = 0; i < count; i++, p += stride) {
+      index[i] = (attribute->type == U16 ? (uint32_t) *(uint16_t*) p : *(uint32_t*) p) + base;
+    }
+  } else {
+    count = position->count;
+    for (uint32_t i = 0; i < count; i++) {
+      index[i] = i + base;
+    }
+  }
+
+  if (mirrored) {
+    for (uint32_t i = 0; i + 2 < count; i += 3) {
+      uint32_t temp = index[i + 1];
+      index[i + 1] = index[i + 2];
+      index[i + 2] = temp;
+    }
+  }
+
+  batch->vertexCount += position->count;
+  batch->indexCount += count;
+}
+
+// Merges the primitives of nodes that can't move into one Mesh per material, so drawing them is a
+// draw per material instead of a draw per primitive.  Nodes that are animated, skinned, or under an
+// animated node are left alone.  Vertices use the current pose, so posing a baked node afterwards
+// has no effect until the Model is baked again.  Baked nodes are culled per batch instead of per
+// node and always use their most detailed LOD.
+void lovrModelBake(Model* model) {
+  ModelData* data = model->data;
+  updateGlobalTransforms(model);
+
+  if (model->baked) {
+    for (uint32_t i = 0; i < model->bakedCount; i++) {
+      lovrRelease(model->baked[i].mesh, lovrMeshDestroy);
+    }
+    free(model->baked);
+    model->baked = NULL;
+    model->bakedCount = 0;
+    lovrRelease(model->bakedVertices, lovrBufferDestroy);
+    lovrRelease(model->bakedIndices, lovrBufferDestroy);
+    model->bakedVertices = NULL;
+    model->bakedIndices = NULL;
+  }
+
+  if (!model->nodesBaked) {
+    model->nodesBaked = malloc(data->nodeCount * sizeof(bool));
+    lovrAssert(model->nodesBaked, "Out of memory");
+  }
+
+  // Nodes are static unless they (or one of their parents) are animated or skinned
+  bool* dynamic = calloc(data->nodeCount, sizeof(bool));
+  lovrAssert(dynamic, "Out of memory");
+  for (uint32_t i = 0; i < data->animationCount; i++) {
+    for (uint32_t j = 0; j < data->animations[i].channelCount; j++) {
+      dynamic[data->animations[i].channels[j].nodeIndex] = true;
+    }
+  }
+
+  map_t batchMap;
+  map_init(&batchMap, 0);
+  arr_t(BakedBatch) batches;
+  arr_init(&batches, realloc);
+
+  for (uint32_t i = 0; i < model->nodeOrderCount; i++) {
+    uint32_t nodeIndex = model->nodeOrder[i];
+    uint32_t parentIndex = model->nodeParents[nodeIndex];
+    ModelNode* node = &data->nodes[nodeIndex];
+    dynamic[nodeIndex] |= node->skin != ~0u || (parentIndex != ~0u && dynamic[parentIndex]);
+
+    bool bakeable = !dynamic[nodeIndex] && node->primitiveCount > 0 && node->instanceCount == 0;
+    for (uint32_t j = 0; bakeable && j < node->primitiveCount; j++) {
+      bakeable = isPrimitiveBakeable(&data->primitives[node->primitiveIndex + j]);
+    }
+
+    model->nodesBaked[nodeIndex] = bakeable;
+    if (!bakeable) continue;
+
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      ModelPrimitive* primitive = &data->primitives[node->primitiveIndex + j];
+      uint32_t attributes = getBakedAttributes(primitive);
+      uint64_t key = ((uint64_t) primitive->material << 32) | attributes;
+      uint64_t index = map_get(&batchMap, key);
+
+      if (index == MAP_NIL) {
+        index = batches.length;
+        map_set(&batchMap, key, index);
+        arr_push(&batches, ((BakedBatch) {
+          .bounds = { FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX, FLT_MAX, -FLT_MAX },
+          .material = primitive->material,
+          .attributes = attributes
+        }));
+      }
+
+      BakedBatch* batch = &batches.data[index];
+      ModelAttribute* position = primitive->attributes[ATTR_POSITION];
+      batch->vertexCount += position->count;
+      batch->indexCount += primitive->indices ? primitive->indices->count : position->count;
+    }
+  }
+
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+  for (uint32_t i = 0; i < batches.length; i++) {
+    BakedBatch* batch = &batches.data[i];
+    batch->vertexStart = vertexCount;
+    batch->indexStart = indexCount;
+    vertexCount += batch->vertexCount;
+    indexCount += batch->indexCount;
+    batch->vertexCount = 0;
+    batch->indexCount = 0;
+  }
+
+  if (batches.length > 0) {
+    float* vertices = calloc(vertexCount, BAKED_STRIDE * sizeof(float));
+    uint32_t* indices = malloc(indexCount * sizeof(uint32_t));
+    lovrAssert(vertices && indices, "Out of memory");
+
+    for (uint32_t i = 0; i < model->nodeOrderCount; i++) {
+      uint32_t nodeIndex = model->nodeOrder[i];
+      if (!model->nodesBaked[nodeIndex]) continue;
+      ModelNode* node = &data->nodes[nodeIndex];
+      mat4 transform = model->globalTransforms + 16 * nodeIndex;
+      for (uint32_t j = 0; j < node->primitiveCount; j++) {
+        ModelPrimitive* primitive = &data->primitives[node->primitiveIndex + j];
+        uint64_t key = ((uint64_t) primitive->material << 32) | getBakedAttributes(primitive);
+        BakedBatch* batch = &batches.data[map_get(&batchMap, key)];
+        bakePrimitive(model, primitive, transform, batch, vertices, indices);
+      }
+    }
+
+    model->bakedVertices = lovrBufferCreate(vertexCount * BAKED_STRIDE * sizeof(float), vertices, BUFFER_VERTEX, USAGE_STATIC, false);
+    model->bakedIndices = lovrBufferCreate(indexCount * sizeof(uint32_t), indices, BUFFER_INDEX, USAGE_STATIC, false);
+    free(vertices);
+    free(indices);
+
+    for (uint32_t i = 0; i < batches.length; i++) {
+      BakedBatch* batch = &batches.data[i];
+      Mesh* mesh = lovrMeshCreate(DRAW_TRIANGLES, NULL, batch->vertexCount);
+
+      for (uint32_t j = ATTR_POSITION; j <= ATTR_TANGENT; j++) {
+        if (j == ATTR_POSITION || (batch->attributes & (1 << j))) {
+          MeshAttribute attribute = bakedLayout[j];
+          attribute.buffer = model->bakedVertices;
+          attribute.offset += batch->vertexStart * BAKED_STRIDE * sizeof(float);
+          lovrMeshAttachAttribute(mesh, lovrShaderAttributeNames[j], &attribute);
+        }
+      }
+
+      lovrMeshAttachAttribute(mesh, "lovrDrawID", &(MeshAttribute) {
+        .buffer = lovrGraphicsGetIdentityBuffer(),
+        .type = U8,
+        .components = 1,
+        .divisor = 1
+      });
+
+      lovrMeshSetIndexBuffer(mesh, model->bakedIndices, batch->indexCount, sizeof(uint32_t), batch->indexStart * sizeof(uint32_t));
+      lovrMeshSetDrawRange(mesh, 0, batch->indexCount);
+
+      if (batch->material != ~0u) {
+        lovrMeshSetMaterial(mesh, model->materials[batch->material]);
+      }
+
+      batch->mesh = mesh;
+    }
+  }
+
+  model->baked = batches.data;
+  model->bakedCount = (uint32_t) batches.length;
+  map_free(&batchMap);
+  free(dynamic);
+}
+
+bool lovrModelIsBaked(Model* model) {
+  return model->nodesBaked != NULL;
+}
@@ -11,15 +11,36 @@ typedef enum {
   SPACE_GLOBAL
 } CoordinateSpace;
 
+#define MAX_ANIMATION_LAYERS 16
+
+typedef struct {
+  uint32_t animation;
+  float time;
+  float weight;
+} AnimationLayer;
+
 typedef struct Model Model;
-Model* lovrModelCreate(struct ModelData* data);
+Model* lovrModelCreate(struct ModelData* data, bool streamTextures, bool quantize);
 void lovrModelDestroy(void* ref);
 struct ModelData* lovrModelGetModelData(Model* model);
+float lovrModelGetStreamProgress(Model* model);
 void lovrModelDraw(Model* model, float* transform, uint32_t instances);
 void lovrModelAnimate(Model* model, uint32_t animationIndex, float time, float alpha);
+void lovrModelBlendAnimations(Model* model, AnimationLayer* layers, uint32_t count);
+void lovrModelAnimateAll(Model** models, AnimationLayer* layers, uint32_t count);
 void lovrModelGetNodePose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], CoordinateSpace space);
 void lovrModelPose(Model* model, uint32_t nodeIndex, float position[4], float rotation[4], float alpha);
 void lovrModelResetPose(Model* model);
 struct Material* lovrModelGetMaterial(Model* model, uint32_t material);
 void lovrModelGetAABB(Model* model, float aabb[6]);
+bool lovrModelIsCullingEnabled(Model* model);
+void lovrModelSetCullingEnabled(Model* model, bool enabled);
+bool lovrModelIsOcclusionCullingEnabled(Model* model);
+void lovrModelSetOcclusionCullingEnabled(Model* model, bool enabled);
+bool lovrModelIsLodEnabled(Model* model);
+void lovrModelSetLodEnabled(Model* model, bool enabled);
+bool lovrModelIsComputeSkinningEnabled(Model* model);
+void lovrModelSetComputeSkinningEnabled(Model* model, bool enabled);
 void lovrModelGetTriangles(Model* model, float** vertices, uint32_t* vertexCount, uint32_t** indices, uint32_t* indexCount);
+void lovrModelBake(Model* model);
+bool lovrModelIsBaked(Model* model);
@@ -8,7 +8,9 @@
 #include "resources/shaders.h"
 #include "data/blob.h"
 #include "data/modelData.h"
+#include "filesystem/filesystem.h"
 #include "math/math.h"
+#include "core/os.h"
 #include <math.h>
 #include <limits.h>
 #include <string.h>
@@ -29,6 +31,9 @@
 #define MAX_TEXTURES 16
 #define MAX_IMAGES 8
 #define MAX_BLOCK_BUFFERS 8
+#define MAX_BUFFER_FRAMES 3
+#define MAX_EVICTIONS 4
+#define MIN_RESIDENT_MIPMAPS 7
 
 #define LOVR_SHADER_POSITION 0
 #define LOVR_SHADER_NORMAL 1
@@ -50,7 +55,13 @@ struct Buffer {
   BufferUsage usage;
   bool mapped;
   bool readable;
-  uint8_t incoherent;
+  bool persistent;
+  bool used; // Bound for a draw since the last discard
+  uint64_t lastWrite;
+  uint8_t frame;
+  uint32_t frames[MAX_BUFFER_FRAMES];
+  void* pointers[MAX_BUFFER_FRAMES];
+  GLsync fences[MAX_BUFFER_FRAMES];
 };
 
 struct Texture {
@@ -67,12 +78,17 @@ struct Texture {
   CompareMode compareMode;
   TextureFilter filter;
   TextureWrap wrap;
+  GLuint sampler;
   uint32_t msaa;
   bool srgb;
   bool mipmaps;
   bool allocated;
   bool native;
-  uint8_t incoherent;
+  uint64_t lastWrite;
+  uint64_t lastUse;
+  uint32_t dropped;
+  Blob* source;
+  bool flip;
 };
 
 struct Canvas {
@@ -85,30 +101,74 @@ struct Canvas {
   CanvasFlags flags;
   Attachment attachments[MAX_CANVAS_ATTACHMENTS];
   Attachment depth;
+  struct Texture* externalDepth;
   uint32_t attachmentCount;
   bool needsAttach;
+  bool needsDepthAttach;
   bool needsResolve;
+  bool tiledMSAA;
   bool immortal;
 };
 
+struct Readback {
+  uint32_t ref;
+  uint32_t buffer;
+  GLsync fence;
+  uint32_t width;
+  uint32_t height;
+  size_t size;
+  struct Image* image;
+  struct Blob* blob;
+};
+
 struct ShaderBlock {
   uint32_t ref;
   BlockType type;
   arr_uniform_t uniforms;
   map_t uniformMap;
   struct Buffer* buffer;
+  uint8_t* shadow;
+  size_t staleFrom[MAX_BUFFER_FRAMES];
+  size_t staleTo[MAX_BUFFER_FRAMES];
 };
 
+// Linked programs are shared by every Shader compiled from the same sources, flags, and multiview
+// setting.  Shaders keep their own uniform values, so the program remembers which Shader last used
+// it, and binding a different one uploads all of its uniforms again.  The defaults are the initial
+// values of the uniforms, read once when the program is first set up.
+typedef struct {
+  uint32_t ref;
+  uint32_t id;
+  uint64_t key;
+  bool linked;
+  struct Shader* owner;
+  void* defaults;
+} Program;
+
 struct Shader {
   uint32_t ref;
   uint32_t program;
+  Program* shared;
   ShaderType type;
   arr_uniform_t uniforms;
   arr_block_t blocks[2];
   map_t attributes;
   map_t uniformMap;
   map_t blockMap;
+  int viewportCountLocation;
+  int viewIDLocation;
+  int viewportCount;
+  int viewID;
   bool multiview;
+  bool ready;
+  GLuint stages[2];
+  uint64_t key;
+  int builtins[MAX_BUILTIN_UNIFORMS];
+  uint64_t builtinBlocks[MAX_BUILTIN_BLOCKS];
+  struct Shader* variant;
+  struct Shader* depthVariant;
+  char* sources[3];
+  int sourceLengths[2];
 };
 
 struct Mesh {
@@ -119,6 +179,7 @@ struct Mesh {
   char attributeNames[MAX_ATTRIBUTES][MAX_ATTRIBUTE_NAME_LENGTH];
   MeshAttribute attributes[MAX_ATTRIBUTES];
   uint8_t locations[MAX_ATTRIBUTES];
+  uint32_t locationBuffers[MAX_ATTRIBUTES];
   uint16_t enabledLocations;
   uint16_t divisors[MAX_ATTRIBUTES];
   map_t attributeMap;
@@ -134,8 +195,12 @@ struct Mesh {
   struct Material* material;
 };
 
+// Each kind of access to a resource written by a shader needs its own barrier bit
 typedef enum {
   BARRIER_BLOCK,
+  BARRIER_COMMAND,
+  BARRIER_VERTEX,
+  BARRIER_BUFFER,
   BARRIER_UNIFORM_TEXTURE,
   BARRIER_UNIFORM_IMAGE,
   BARRIER_TEXTURE,
@@ -162,6 +227,74 @@ typedef struct {
   uint64_t nanoseconds;
 } Timer;
 
+// Texture uploads are copied into a persistently mapped pixel unpack buffer with one region per
+// frame, so glTexSubImage can return without the driver copying client memory.  The size of a
+// region is the per-frame upload budget, uploads past it go directly from client memory.
+#define STAGING_FRAME_SIZE (4 << 20)
+
+typedef struct {
+  uint32_t id;
+  uint8_t* data;
+  size_t cursor;
+  uint32_t frame;
+  GLsync fences[MAX_BUFFER_FRAMES];
+} StagingBuffer;
+
+// Profile scopes are recorded into a ring of frames.  Each scope has a pair of timestamp queries
+// (at queries[2 * i] and queries[2 * i + 1]), which are read back when the frame's slot comes up
+// again, by which point the GPU has almost certainly finished with them.
+#define MAX_PROFILE_FRAMES 4
+
+typedef struct {
+  GpuProfileScope info;
+  double cpuStart;
+  uint32_t drawCalls;
+  uint32_t shaderSwitches;
+} ProfileScope;
+
+typedef struct {
+  arr_t(ProfileScope) scopes;
+  arr_t(GLuint) queries;
+} ProfileFrame;
+
+#ifdef LOVR_GL
+// Multi draw indirect is core in GL 4.3 but the loader doesn't know about it, so it's loaded here
+typedef void (APIENTRYP PFNGLMULTIDRAWARRAYSINDIRECTPROC)(GLenum mode, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+static PFNGLMULTIDRAWARRAYSINDIRECTPROC lovrMultiDrawArraysIndirect;
+static PFNGLMULTIDRAWELEMENTSINDIRECTPROC lovrMultiDrawElementsIndirect;
+#endif
+
+// With EXT_multisampled_render_to_texture, tiled GPUs multisample in tile memory and resolve as the
+// tiles are written out, so multisampled Canvases don't need multisampled renderbuffers or a blit
+typedef void (APIENTRYP PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level, GLsizei samples);
+typedef void (APIENTRYP PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC)(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height);
+static PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC lovrFramebufferTexture2DMultisampleEXT;
+static PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC lovrRenderbufferStorageMultisampleEXT;
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static void lovrShaderFinish(Shader* shader);
+static Shader* lovrShaderGetVariant(Shader* shader, bool multiview);
+static Shader* lovrShaderGetDepthVariant(Shader* shader);
+static void lovrShaderCopyState(Shader* shader, Shader* variant);
+static void lovrGpuUpdateResidency(void);
+static void traceDraw(DrawCommand* draw);
+static void traceClear(Canvas* canvas, Color* color, float* depth, int* stencil);
+static void traceDiscard(Canvas* canvas, bool color, bool depth, bool stencil);
+static void traceResolve(Canvas* canvas);
+static void traceStencil(StencilAction action, int replaceValue);
+static void traceStencilEnd(void);
+static void traceBufferData(Buffer* buffer);
+static void traceBufferDiscard(Buffer* buffer);
+static void traceTextureData(Texture* texture, Image* image, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap);
+static void traceForget(void* object);
+static void traceFrame(void);
+
+typedef arr_t(uint8_t) arr_bytes_t;
+
 static struct {
   Texture* defaultTexture;
   enum { NONE, INSTANCED_STEREO, MULTIVIEW } singlepass;
@@ -182,6 +315,8 @@ static struct {
   bool stencilWriting;
   Winding winding;
   bool wireframe;
+  Pipeline pipeline;
+  bool pipelineDirty;
   uint32_t framebuffer;
   uint32_t program;
   Mesh* vertexArray;
@@ -189,18 +324,44 @@ static struct {
   BlockBuffer blockBuffers[2][MAX_BLOCK_BUFFERS];
   int activeTexture;
   Texture* textures[MAX_TEXTURES];
+  GLuint samplers[MAX_TEXTURES];
+  map_t samplerCache;
   StorageImage images[MAX_IMAGES];
   float viewports[2][4];
   uint32_t viewportCount;
-  arr_t(void*) incoherents[MAX_BARRIERS];
+  uint64_t writeCount;
+  uint64_t barriers[MAX_BARRIERS];
   QueryPool queryPool;
   arr_t(Timer) timers;
   uint32_t activeTimer;
   map_t timerMap;
+  map_t programs;
+  GLenum occlusionTarget;
+  ProfileFrame profileFrames[MAX_PROFILE_FRAMES];
+  uint32_t profileFrame;
+  uint32_t profileScope;
+  arr_t(GpuProfileScope) profile;
   GpuFeatures features;
   GpuLimits limits;
   GpuStats stats;
+  uint64_t frame;
+  uint64_t textureBudget;
+  arr_t(Texture*) managedTextures;
   bool amd;
+  bool persistentBuffers;
+  StagingBuffer staging;
+  bool programBinaries;
+  bool parallelShaderCompile;
+  bool tiledMSAA;
+  uint64_t driverHash;
+  struct {
+    bool active;
+    arr_bytes_t data;
+    arr_bytes_t scratch;
+    map_t ids;
+    map_t hashes;
+    uint32_t nextId;
+  } trace;
 } state;
 
 // Helper functions
@@ -436,8 +597,10 @@ static uint64_t getTextureMemorySize(Texture* texture) {
     case FORMAT_ASTC_12x12: bitrate = 0.89f; break;
     default: lovrThrow("Unreachable");
   }
-  size = texture->width * texture->height * texture->depth * (bitrate / 8.f) * (texture->mipmaps ? 1.33f : 1.f);
-  size += texture->msaa > 1 ? (texture->width * texture->height * texture->msaa * (bitrate / 8.f)) : 0.f;
+  uint32_t width = MAX(texture->width >> texture->dropped, 1);
+  uint32_t height = MAX(texture->height >> texture->dropped, 1);
+  size = width * height * texture->depth * (bitrate / 8.f) * (texture->mipmaps ? 1.33f : 1.f);
+  size += texture->msaaId ? (texture->width * texture->height * texture->msaa * (bitrate / 8.f)) : 0.f;
   return (uint64_t) (size + .5f);
 }
 
@@ -461,6 +624,7 @@ static GLenum convertBufferType(BufferType type) {
     case BUFFER_UNIFORM: return GL_UNIFORM_BUFFER;
     case BUFFER_SHADER_STORAGE: return GL_SHADER_STORAGE_BUFFER;
     case BUFFER_GENERIC: return GL_COPY_WRITE_BUFFER;
+    case BUFFER_INDIRECT: return GL_DRAW_INDIRECT_BUFFER;
     default: lovrThrow("Unreachable");
   }
 }
@@ -627,40 +791,33 @@ static const char* getUniformTypeName(const Uniform* uniform) {
   return "";
 }
 
-// Syncing resources is only relevant for compute shaders
+// Syncing resources is only relevant for compute shaders.  Resources remember the last shader
+// write to them and each barrier remembers the last write it covered, so only the barriers needed
+// by the resources that are actually used get issued, and nothing has to be tracked in lists.
+static bool lovrGpuIsIncoherent(uint64_t lastWrite, Barrier barrier) {
+  return lastWrite > state.barriers[barrier];
+}
+
+static void lovrGpuMarkWrite(uint64_t* lastWrite) {
+  *lastWrite = ++state.writeCount;
+}
+
 #ifndef LOVR_WEBGL
 static void lovrGpuSync(uint8_t flags) {
-  if (!flags) {
-    return;
-  }
-
   GLbitfield bits = 0;
   for (int i = 0; i < MAX_BARRIERS; i++) {
     if (!((flags >> i) & 1)) {
       continue;
     }
 
-    if (state.incoherents[i].length == 0) {
-      flags &= ~(1 << i);
-      continue;
-    }
-
-    if (i == BARRIER_BLOCK) {
-      for (size_t j = 0; j < state.incoherents[i].length; j++) {
-        Buffer* buffer = state.incoherents[i].data[j];
-        buffer->incoherent &= ~(1 << i);
-      }
-    } else {
-      for (size_t j = 0; j < state.incoherents[i].length; j++) {
-        Texture* texture = state.incoherents[i].data[j];
-        texture->incoherent &= ~(1 << i);
-      }
-    }
-
-    arr_clear(&state.incoherents[i]);
+    // A barrier covers every write that came before it, not just the ones to a particular resource
+    state.barriers[i] = state.writeCount;
 
     switch (i) {
       case BARRIER_BLOCK: bits |= GL_SHADER_STORAGE_BARRIER_BIT; break;
+      case BARRIER_COMMAND: bits |= GL_COMMAND_BARRIER_BIT; break;
+      case BARRIER_VERTEX: bits |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT; break;
+      case BARRIER_BUFFER: bits |= GL_BUFFER_UPDATE_BARRIER_BIT; break;
       case BARRIER_UNIFORM_IMAGE: bits |= GL_SHADER_IMAGE_ACCESS_BARRIER_BIT; break;
       case BARRIER_UNIFORM_TEXTURE: bits |= GL_TEXTURE_FETCH_BARRIER_BIT; break;
       case BARRIER_TEXTURE: bits |= GL_TEXTURE_UPDATE_BARRIER_BIT; break;
@@ -674,23 +831,6 @@ static void lovrGpuSync(uint8_t flags) {
 }
 #endif
 
-static void lovrGpuDestroySyncResource(void* resource, uint8_t incoherent) {
-  if (!incoherent) {
-    return;
-  }
-
-  for (uint32_t i = 0; i < MAX_BARRIERS; i++) {
-    if (incoherent & (1 << i)) {
-      for (size_t j = 0; j < state.incoherents[i].length; j++) {
-        if (state.incoherents[i].data[j] == resource) {
-          arr_splice(&state.incoherents[i], j, 1);
-          break;
-        }
-      }
-    }
-  }
-}
-
 static void lovrGpuBindFramebuffer(uint32_t framebuffer) {
   if (state.framebuffer != framebuffer) {
     state.framebuffer = framebuffer;
@@ -753,6 +893,7 @@ static void lovrGpuBindBlockBuffer(BlockType type, uint32_t buffer, int slot, si
 static void lovrGpuBindTexture(Texture* texture, int slot) {
   lovrAssert(slot >= 0 && slot < MAX_TEXTURES, "Invalid texture slot %d", slot);
   texture = texture ? texture : state.defaultTexture;
+  texture->lastUse = state.frame;
 
   if (texture != state.textures[slot]) {
     lovrRetain(texture);
@@ -764,6 +905,102 @@ static void lovrGpuBindTexture(Texture* texture, int slot) {
     }
     glBindTexture(texture->target, texture->id);
   }
+
+  if (texture->sampler != state.samplers[slot]) {
+    glBindSampler(slot, texture->sampler);
+    state.samplers[slot] = texture->sampler;
+  }
+}
+
+// Binds the textures for a draw's sampler uniforms, starting at slot 0.  Only the range of slots
+// that changed is touched, and with ARB_multi_bind the whole range is bound in two calls instead of
+// switching the active unit for every slot.
+static void lovrGpuBindTextures(Texture** textures, uint32_t count) {
+  uint32_t first = ~0u;
+  uint32_t last = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    Texture* texture = textures[i] ? textures[i] : state.defaultTexture;
+    texture->lastUse = state.frame;
+    if (texture != state.textures[i] || texture->sampler != state.samplers[i]) {
+      first = MIN(first, i);
+      last = i;
+    }
+  }
+
+  if (first == ~0u) {
+    return;
+  }
+
+#ifdef LOVR_GL
+  if (GLAD_GL_ARB_multi_bind) {
+    GLuint ids[MAX_TEXTURES];
+    for (uint32_t i = first; i <= last; i++) {
+      Texture* texture = textures[i] ? textures[i] : state.defaultTexture;
+      texture->lastUse = state.frame;
+      if (texture != state.textures[i]) {
+        lovrRetain(texture);
+        lovrRelease(state.textures[i], lovrTextureDestroy);
+        state.textures[i] = texture;
+      }
+      ids[i] = texture->id;
+      state.samplers[i] = texture->sampler;
+    }
+    glBindTextures(first, last - first + 1, ids + first);
+    glBindSamplers(first, last - first + 1, state.samplers + first);
+    return;
+  }
+#endif
+
+  for (uint32_t i = first; i <= last; i++) {
+    lovrGpuBindTexture(textures[i], i);
+  }
+}
+
+// Samplers are shared by every Texture with the same sampling state
+static GLuint lovrGpuGetSampler(TextureFilter filter, TextureWrap wrap, CompareMode compareMode, bool mipmaps) {
+  struct { uint32_t mode; float anisotropy; uint32_t wrap[3]; uint32_t compareMode; uint32_t mipmaps; } key = {
+    filter.mode, filter.anisotropy, { wrap.s, wrap.t, wrap.r }, compareMode, mipmaps
+  };
+
+  uint64_t hash = hash64(&key, sizeof(key));
+  uint64_t value = map_get(&state.samplerCache, hash);
+  if (value != MAP_NIL) {
+    return (GLuint) value;
+  }
+
+  GLuint sampler;
+  glGenSamplers(1, &sampler);
+
+  switch (filter.mode) {
+    case FILTER_NEAREST:
+      glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      break;
+    case FILTER_BILINEAR:
+      glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_NEAREST : GL_LINEAR);
+      glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      break;
+    case FILTER_TRILINEAR:
+      glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+      glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      break;
+  }
+
+  glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, MAX(filter.anisotropy, 1.f));
+  glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, convertWrapMode(wrap.s));
+  glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, convertWrapMode(wrap.t));
+  glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, convertWrapMode(wrap.r));
+
+  if (compareMode == COMPARE_NONE) {
+    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+  } else {
+    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glSamplerParameteri(sampler, GL_TEXTURE_COMPARE_FUNC, convertCompareMode(compareMode));
+  }
+
+  map_set(&state.samplerCache, hash, sampler);
+  return sampler;
 }
 
 #ifndef LOVR_WEBGL
@@ -784,6 +1021,7 @@ static void lovrGpuBindImage(StorageImage* image, int slot, const char* name) {
     bool layered = image->slice == -1;
     int slice = layered ? 0 : image->slice;
 
+    lovrTextureSetSource(texture, NULL, false);
     lovrRetain(texture);
     lovrRelease(state.images[slot].texture, lovrTextureDestroy);
     glBindImageTexture(slot, texture->id, image->mipmap, layered, slice, glAccess, glFormat);
@@ -816,6 +1054,13 @@ static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, int baseDivisor) {
     if ((attribute = &mesh->attributes[i])->disabled) { continue; }
     if ((location = lovrShaderGetAttributeLocation(shader, mesh->attributeNames[i], &integer)) < 0) { continue; }
 
+#ifndef LOVR_WEBGL
+    // Vertices written by a compute shader (e.g. skinned vertices) need a barrier before drawing
+    if (lovrGpuIsIncoherent(attribute->buffer->lastWrite, BARRIER_VERTEX)) {
+      lovrGpuSync(1 << BARRIER_VERTEX);
+    }
+#endif
+
     lovrBufferUnmap(attribute->buffer);
     enabledLocations |= (1 << location);
 
@@ -825,9 +1070,10 @@ static void lovrGpuBindMesh(Mesh* mesh, Shader* shader, int baseDivisor) {
       mesh->divisors[location] = divisor;
     }
 
-    if (mesh->locations[location] == i) { continue; }
+    if (mesh->locations[location] == i && mesh->locationBuffers[location] == attribute->buffer->id) { continue; }
 
     mesh->locations[location] = i;
+    mesh->locationBuffers[location] = attribute->buffer->id;
     lovrGpuBindBuffer(BUFFER_VERTEX, attribute->buffer->id);
     GLenum type = convertAttributeType(attribute->type);
     GLvoid* offset = (GLvoid*) (intptr_t) attribute->offset;
@@ -872,7 +1118,7 @@ static void lovrGpuBindCanvas(Canvas* canvas, bool willDraw) {
 #ifndef LOVR_WEBGL
   for (uint32_t i = 0; i < canvas->attachmentCount; i++) {
     Texture* texture = canvas->attachments[i].texture;
-    if (texture->incoherent && (texture->incoherent >> BARRIER_CANVAS) & 1) {
+    if (lovrGpuIsIncoherent(texture->lastWrite, BARRIER_CANVAS)) {
       lovrGpuSync(1 << BARRIER_CANVAS);
       break;
     }
@@ -893,6 +1139,8 @@ static void lovrGpuBindCanvas(Canvas* canvas, bool willDraw) {
 #else
       glFramebufferTextureMultisampleMultiviewOVR(GL_FRAMEBUFFER, drawBuffer, texture->id, level, canvas->flags.msaa, slice, 2);
 #endif
+    } else if (canvas->tiledMSAA) {
+      lovrFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, drawBuffer, GL_TEXTURE_2D, texture->id, level, canvas->flags.msaa);
     } else {
       if (canvas->flags.msaa) {
         glFramebufferRenderbuffer(GL_FRAMEBUFFER, drawBuffer, GL_RENDERBUFFER, texture->msaaId);
@@ -909,6 +1157,35 @@ static void lovrGpuBindCanvas(Canvas* canvas, bool willDraw) {
   }
   glDrawBuffers(canvas->attachmentCount, buffers);
 
+#ifndef LOVR_WEBGL
+  if (canvas->flags.depth.enabled && canvas->flags.stereo && state.singlepass == MULTIVIEW) {
+    Texture* depth = canvas->externalDepth ? canvas->externalDepth : canvas->depth.texture;
+    GLenum attachment = canvas->flags.depth.format == FORMAT_D24S8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    glFramebufferTextureMultisampleMultiviewOVR(GL_FRAMEBUFFER, attachment, depth->id, 0, canvas->flags.msaa, 0, 2);
+  }
+#endif
+
+  if (canvas->flags.depth.enabled && canvas->needsDepthAttach && (!canvas->flags.stereo || state.singlepass != MULTIVIEW)) {
+    // Multisampled depth is rendered to the Canvas's own buffer and resolved to the external one
+    GLenum attachment = canvas->flags.depth.format == FORMAT_D24S8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    if (canvas->tiledMSAA && (canvas->externalDepth || canvas->depth.texture)) {
+      Texture* depth = canvas->externalDepth ? canvas->externalDepth : canvas->depth.texture;
+      lovrFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depth->id, 0, canvas->flags.msaa);
+    } else if (canvas->tiledMSAA) {
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, canvas->depthBuffer);
+    } else if (canvas->flags.msaa) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas->resolveBuffer);
+      glFramebufferTexture2D(GL_READ_FRAMEBUFFER, attachment, GL_TEXTURE_2D, canvas->externalDepth ? canvas->externalDepth->id : 0, 0);
+    } else if (canvas->externalDepth) {
+      glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, GL_TEXTURE_2D, canvas->externalDepth->id, 0);
+    } else if (canvas->depth.texture) {
+      glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, attachment, GL_TEXTURE_2D, canvas->depth.texture->id, 0);
+    } else {
+      glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, attachment, GL_RENDERBUFFER, canvas->depthBuffer);
+    }
+  }
+  canvas->needsDepthAttach = false;
+
   GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
   switch (status) {
     case GL_FRAMEBUFFER_COMPLETE: break;
@@ -921,6 +1198,12 @@ static void lovrGpuBindCanvas(Canvas* canvas, bool willDraw) {
 }
 
 static void lovrGpuBindPipeline(Pipeline* pipeline) {
+  if (!state.pipelineDirty && !memcmp(&state.pipeline, pipeline, sizeof(Pipeline))) {
+    return;
+  }
+
+  state.pipeline = *pipeline;
+  state.pipelineDirty = false;
 
   // Alpha Coverage
   if (state.alphaToCoverage != pipeline->alphaSampling) {
@@ -1011,10 +1294,11 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
   }
 
   // Depth test and depth write
+  bool depthWrite = pipeline->depthWrite && !state.stencilWriting;
   bool updateDepthTest = pipeline->depthTest != state.depthTest;
-  bool updateDepthWrite = state.depthWrite != (pipeline->depthWrite && !state.stencilWriting);
+  bool updateDepthWrite = state.depthWrite != depthWrite;
   if (updateDepthTest || updateDepthWrite) {
-    bool enable = state.depthTest != COMPARE_NONE || state.depthWrite;
+    bool enable = pipeline->depthTest != COMPARE_NONE || depthWrite;
 
     if (enable && !state.depthEnabled) {
       glEnable(GL_DEPTH_TEST);
@@ -1029,7 +1313,7 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
     }
 
     if (enable && updateDepthWrite) {
-      state.depthWrite = pipeline->depthWrite && !state.stencilWriting;
+      state.depthWrite = depthWrite;
       glDepthMask(state.depthWrite);
     }
   }
@@ -1085,14 +1369,28 @@ static void lovrGpuBindPipeline(Pipeline* pipeline) {
 }
 
 static void lovrGpuBindShader(Shader* shader) {
+  if (!shader->ready) lovrShaderFinish(shader);
   lovrGpuUseProgram(shader->program);
 
+  // Another Shader sharing the program may have uploaded different uniform values
+  if (shader->shared->owner != shader) {
+    shader->shared->owner = shader;
+    shader->viewportCount = -1;
+    shader->viewID = -1;
+    for (size_t i = 0; i < shader->uniforms.length; i++) {
+      Uniform* uniform = &shader->uniforms.data[i];
+      uniform->dirty = true;
+      uniform->dirtyStart = 0;
+      uniform->dirtyEnd = uniform->count;
+    }
+  }
+
   // Figure out if we need to wait for pending writes on resources to complete
 #ifndef LOVR_WEBGL
   uint8_t flags = 0;
   for (size_t i = 0; i < shader->blocks[BLOCK_COMPUTE].length; i++) {
     UniformBlock* block = &shader->blocks[BLOCK_COMPUTE].data[i];
-    if (block->source && (block->source->incoherent >> BARRIER_BLOCK) & 1) {
+    if (block->source && lovrGpuIsIncoherent(block->source->lastWrite, BARRIER_BLOCK)) {
       flags |= 1 << BARRIER_BLOCK;
       break;
     }
@@ -1103,21 +1401,17 @@ static void lovrGpuBindShader(Shader* shader) {
     if (uniform->type == UNIFORM_SAMPLER) {
       for (int j = 0; j < uniform->count; j++) {
         Texture* texture = uniform->value.textures[j];
-        if (texture && texture->incoherent && (texture->incoherent >> BARRIER_UNIFORM_TEXTURE) & 1) {
+        if (texture && lovrGpuIsIncoherent(texture->lastWrite, BARRIER_UNIFORM_TEXTURE)) {
           flags |= 1 << BARRIER_UNIFORM_TEXTURE;
-          if (flags & (1 << BARRIER_UNIFORM_IMAGE)) {
-            break;
-          }
+          break;
         }
       }
     } else if (uniform->type == UNIFORM_IMAGE) {
       for (int j = 0; j < uniform->count; j++) {
         Texture* texture = uniform->value.images[j].texture;
-        if (texture && texture->incoherent && (texture->incoherent >> BARRIER_UNIFORM_IMAGE) & 1) {
+        if (texture && lovrGpuIsIncoherent(texture->lastWrite, BARRIER_UNIFORM_IMAGE)) {
           flags |= 1 << BARRIER_UNIFORM_IMAGE;
-          if (flags & (1 << BARRIER_UNIFORM_TEXTURE)) {
-            break;
-          }
+          break;
         }
       }
     }
@@ -1126,7 +1420,9 @@ static void lovrGpuBindShader(Shader* shader) {
   lovrGpuSync(flags);
 #endif
 
-  // Bind uniforms
+  // Bind uniforms, textures are gathered and bound together afterwards
+  Texture* textures[MAX_TEXTURES] = { 0 };
+  uint32_t textureCount = 0;
   for (size_t i = 0; i < shader->uniforms.length; i++) {
     Uniform* uniform = &shader->uniforms.data[i];
 
@@ -1134,34 +1430,47 @@ static void lovrGpuBindShader(Shader* shader) {
       continue;
     }
 
-    uniform->dirty = false;
     int count = uniform->count;
+    int location = uniform->location;
     void* data = uniform->value.data;
 
+    // Only the elements of an array that changed are uploaded, if their locations are sequential
+    if (uniform->dirty && uniform->contiguous && uniform->type != UNIFORM_SAMPLER && uniform->type != UNIFORM_IMAGE) {
+      count = uniform->dirtyEnd - uniform->dirtyStart;
+      location += uniform->dirtyStart;
+      data = uniform->value.bytes + uniform->dirtyStart * (uniform->size / uniform->count);
+    }
+
+    uniform->dirty = false;
+
+    if (uniform->type != UNIFORM_SAMPLER && uniform->type != UNIFORM_IMAGE) {
+      state.stats.uniformUploadBytes += count * (uniform->size / uniform->count);
+    }
+
     switch (uniform->type) {
       case UNIFORM_FLOAT:
         switch (uniform->components) {
-          case 1: glUniform1fv(uniform->location, count, data); break;
-          case 2: glUniform2fv(uniform->location, count, data); break;
-          case 3: glUniform3fv(uniform->location, count, data); break;
-          case 4: glUniform4fv(uniform->location, count, data); break;
+          case 1: glUniform1fv(location, count, data); break;
+          case 2: glUniform2fv(location, count, data); break;
+          case 3: glUniform3fv(location, count, data); break;
+          case 4: glUniform4fv(location, count, data); break;
         }
         break;
 
       case UNIFORM_INT:
         switch (uniform->components) {
-          case 1: glUniform1iv(uniform->location, count, data); break;
-          case 2: glUniform2iv(uniform->location, count, data); break;
-          case 3: glUniform3iv(uniform->location, count, data); break;
-          case 4: glUniform4iv(uniform->location, count, data); break;
+          case 1: glUniform1iv(location, count, data); break;
+          case 2: glUniform2iv(location, count, data); break;
+          case 3: glUniform3iv(location, count, data); break;
+          case 4: glUniform4iv(location, count, data); break;
         }
         break;
 
       case UNIFORM_MATRIX:
         switch (uniform->components) {
-          case 2: glUniformMatrix2fv(uniform->location, count, GL_FALSE, data); break;
-          case 3: glUniformMatrix3fv(uniform->location, count, GL_FALSE, data); break;
-          case 4: glUniformMatrix4fv(uniform->location, count, GL_FALSE, data); break;
+          case 2: glUniformMatrix2fv(location, count, GL_FALSE, data); break;
+          case 3: glUniformMatrix3fv(location, count, GL_FALSE, data); break;
+          case 4: glUniformMatrix4fv(location, count, GL_FALSE, data); break;
         }
         break;
 
@@ -1172,12 +1481,9 @@ static void lovrGpuBindShader(Shader* shader) {
           Texture* texture = image->texture;
           lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
 
-          // If the Shader can write to the texture, mark it as incoherent
+          // If the Shader can write to the texture, later reads of it need a barrier
           if (texture && image->access != ACCESS_READ) {
-            for (Barrier barrier = BARRIER_BLOCK + 1; barrier < MAX_BARRIERS; barrier++) {
-              texture->incoherent |= 1 << barrier;
-              arr_push(&state.incoherents[barrier], texture);
-            }
+            lovrGpuMarkWrite(&texture->lastWrite);
           }
 
           lovrGpuBindImage(image, uniform->baseSlot + j, uniform->name);
@@ -1190,24 +1496,28 @@ static void lovrGpuBindShader(Shader* shader) {
           Texture* texture = uniform->value.textures[j];
           lovrAssert(!texture || texture->type == uniform->textureType, "Uniform texture type mismatch for uniform '%s'", uniform->name);
           lovrAssert(!texture || (uniform->shadow == (texture->compareMode != COMPARE_NONE)), "Uniform '%s' requires a Texture with%s a compare mode", uniform->name, uniform->shadow ? "" : "out");
-          lovrGpuBindTexture(texture, uniform->baseSlot + j);
+          lovrAssert(uniform->baseSlot + j < MAX_TEXTURES, "Invalid texture slot %d", uniform->baseSlot + j);
+          textures[uniform->baseSlot + j] = texture;
+          textureCount = MAX(textureCount, (uint32_t) (uniform->baseSlot + j + 1));
         }
         break;
     }
   }
 
+  lovrGpuBindTextures(textures, textureCount);
+
   // Bind uniform blocks
   for (BlockType type = BLOCK_UNIFORM; type <= BLOCK_COMPUTE; type++) {
     for (size_t i = 0; i < shader->blocks[type].length; i++) {
       UniformBlock* block = &shader->blocks[type].data[i];
       if (block->source) {
         if (type == BLOCK_COMPUTE && block->access != ACCESS_READ) {
-          block->source->incoherent |= (1 << BARRIER_BLOCK);
-          arr_push(&state.incoherents[BARRIER_BLOCK], block->source);
+          lovrGpuMarkWrite(&block->source->lastWrite);
         }
 
         lovrBufferUnmap(block->source);
         lovrGpuBindBlockBuffer(type, block->source->id, block->slot, block->offset, block->size);
+        block->source->used = true;
       } else {
         lovrGpuBindBlockBuffer(type, 0, block->slot, 0, 0);
       }
@@ -1246,6 +1556,20 @@ static void GLAPIENTRY onMessage(GLenum source, GLenum type, GLuint id, GLenum s
 }
 #endif
 
+#ifndef LOVR_WEBGL
+static bool hasExtension(const char* name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; i++) {
+    const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+    if (extension && !strcmp(extension, name)) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
 void lovrGpuInit(void (*getProcAddress(const char*))(void), bool debug) {
 #ifdef LOVR_GL
   gladLoadGLLoader((GLADloadproc) getProcAddress);
@@ -1260,6 +1584,10 @@ void lovrGpuInit(void (*getProcAddress(const char*))(void), bool debug) {
   }
   const char* vendor = (const char*) glGetString(GL_VENDOR);
   state.amd = vendor && (strstr(vendor, "ATI Technologies") || strstr(vendor, "AMD") || strstr(vendor, "Advanced Micro Devices"));
+  const char* renderer = (const char*) glGetString(GL_RENDERER);
+  const char* version = (const char*) glGetString(GL_VERSION);
+  uint64_t driver[3] = { hash64(vendor, vendor ? strlen(vendor) : 0), hash64(renderer, renderer ? strlen(renderer) : 0), hash64(version, version ? strlen(version) : 0) };
+  state.driverHash = hash64(driver, sizeof(driver));
   state.features.astc = GLAD_GL_ES_VERSION_3_2;
   state.features.compute = GLAD_GL_ES_VERSION_3_1 || (GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object && GLAD_GL_ARB_shader_image_load_store);
   state.features.dxt = GLAD_GL_EXT_texture_compression_s3tc;
@@ -1267,6 +1595,52 @@ void lovrGpuInit(void (*getProcAddress(const char*))(void), bool debug) {
   state.features.multiview = GLAD_GL_ES_VERSION_3_0 && GLAD_GL_OVR_multiview2 && GLAD_GL_OVR_multiview_multisampled_render_to_texture;
   state.features.timers = GLAD_GL_VERSION_3_3;
 #ifdef LOVR_GL
+  GLint major, minor;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major >= 4) {
+    glad_glDrawArraysIndirect = (PFNGLDRAWARRAYSINDIRECTPROC) getProcAddress("glDrawArraysIndirect");
+    glad_glDrawElementsIndirect = (PFNGLDRAWELEMENTSINDIRECTPROC) getProcAddress("glDrawElementsIndirect");
+  }
+  if (major > 4 || (major == 4 && minor >= 1)) {
+    glad_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC) getProcAddress("glGetProgramBinary");
+    glad_glProgramBinary = (PFNGLPROGRAMBINARYPROC) getProcAddress("glProgramBinary");
+    glad_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC) getProcAddress("glProgramParameteri");
+  }
+  if (major > 4 || (major == 4 && minor >= 3)) {
+    state.occlusionTarget = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+    lovrMultiDrawArraysIndirect = (PFNGLMULTIDRAWARRAYSINDIRECTPROC) getProcAddress("glMultiDrawArraysIndirect");
+    lovrMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC) getProcAddress("glMultiDrawElementsIndirect");
+  }
+#endif
+  state.features.indirect = glDrawArraysIndirect && glDrawElementsIndirect;
+#ifndef LOVR_WEBGL
+  GLint binaryFormats = 0;
+  if (glGetProgramBinary && glProgramBinary && glProgramParameteri) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+  }
+  state.programBinaries = binaryFormats > 0;
+
+  // Let the driver use as many compiler threads as it wants
+  bool khrParallel = hasExtension("GL_KHR_parallel_shader_compile");
+  if (khrParallel || hasExtension("GL_ARB_parallel_shader_compile")) {
+    void (APIENTRYP maxShaderCompilerThreads)(GLuint count) = (void (APIENTRYP)(GLuint)) getProcAddress(khrParallel ? "glMaxShaderCompilerThreadsKHR" : "glMaxShaderCompilerThreadsARB");
+    if (maxShaderCompilerThreads) {
+      maxShaderCompilerThreads(0xffffffff);
+    }
+    state.parallelShaderCompile = true;
+  }
+
+#ifdef LOVR_GLES
+  if (hasExtension("GL_EXT_multisampled_render_to_texture")) {
+    lovrFramebufferTexture2DMultisampleEXT = (PFNGLFRAMEBUFFERTEXTURE2DMULTISAMPLEEXTPROC) getProcAddress("glFramebufferTexture2DMultisampleEXT");
+    lovrRenderbufferStorageMultisampleEXT = (PFNGLRENDERBUFFERSTORAGEMULTISAMPLEEXTPROC) getProcAddress("glRenderbufferStorageMultisampleEXT");
+    state.tiledMSAA = lovrFramebufferTexture2DMultisampleEXT && lovrRenderbufferStorageMultisampleEXT;
+  }
+#endif
+#endif
+#ifdef LOVR_GL
+  state.persistentBuffers = GLAD_GL_ARB_buffer_storage && !state.amd;
   glEnable(GL_LINE_SMOOTH);
   glEnable(GL_PROGRAM_POINT_SIZE);
   glEnable(GL_FRAMEBUFFER_SRGB);
@@ -1345,13 +1719,12 @@ void lovrGpuInit(void (*getProcAddress(const char*))(void), bool debug) {
   glFrontFace(GL_CCW);
 
   state.wireframe = false;
+  state.pipelineDirty = true;
 #ifdef LOVR_GL
   glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 #endif
 
-  for (int i = 0; i < MAX_BARRIERS; i++) {
-    arr_init(&state.incoherents[i], realloc);
-  }
+  map_init(&state.samplerCache, 0);
 
   Image* image = lovrImageCreate(1, 1, NULL, 0xff, FORMAT_RGBA);
   state.defaultTexture = lovrTextureCreate(TEXTURE_2D, &image, 1, true, false, 0);
@@ -1360,8 +1733,22 @@ void lovrGpuInit(void (*getProcAddress(const char*))(void), bool debug) {
   lovrRelease(image, lovrImageDestroy);
 
   map_init(&state.timerMap, 4);
+  map_init(&state.programs, 0);
   state.queryPool.next = ~0u;
+#ifdef LOVR_GL
+  state.occlusionTarget = state.occlusionTarget ? state.occlusionTarget : GL_ANY_SAMPLES_PASSED;
+#else
+  state.occlusionTarget = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+#endif
   state.activeTimer = ~0u;
+
+  for (uint32_t i = 0; i < MAX_PROFILE_FRAMES; i++) {
+    arr_init(&state.profileFrames[i].scopes, realloc);
+    arr_init(&state.profileFrames[i].queries, realloc);
+  }
+  arr_init(&state.profile, realloc);
+  state.profileScope = ~0u;
+  arr_init(&state.managedTextures, realloc);
 }
 
 void lovrGpuDestroy() {
@@ -1369,20 +1756,50 @@ void lovrGpuDestroy() {
   for (int i = 0; i < MAX_TEXTURES; i++) {
     lovrRelease(state.textures[i], lovrTextureDestroy);
   }
+  for (uint32_t i = 0; i < state.samplerCache.size; i++) {
+    if (state.samplerCache.hashes[i] != MAP_NIL) {
+      GLuint sampler = (GLuint) state.samplerCache.values[i];
+      glDeleteSamplers(1, &sampler);
+    }
+  }
+  map_free(&state.samplerCache);
   for (int i = 0; i < MAX_IMAGES; i++) {
     lovrRelease(state.images[i].texture, lovrTextureDestroy);
   }
-  for (int i = 0; i < MAX_BARRIERS; i++) {
-    arr_free(&state.incoherents[i]);
-  }
   glDeleteQueries(state.queryPool.count, state.queryPool.queries);
   free(state.queryPool.queries);
   arr_free(&state.timers);
   map_free(&state.timerMap);
+  map_free(&state.programs);
+  for (uint32_t i = 0; i < MAX_PROFILE_FRAMES; i++) {
+    ProfileFrame* frame = &state.profileFrames[i];
+    if (frame->queries.length > 0) {
+      glDeleteQueries((GLsizei) frame->queries.length, frame->queries.data);
+    }
+    arr_free(&frame->scopes);
+    arr_free(&frame->queries);
+  }
+  arr_free(&state.profile);
+  arr_free(&state.managedTextures);
+  if (state.trace.active) {
+    arr_free(&state.trace.data);
+    arr_free(&state.trace.scratch);
+    map_free(&state.trace.ids);
+    map_free(&state.trace.hashes);
+  }
+#ifdef LOVR_GL
+  for (uint32_t i = 0; i < MAX_BUFFER_FRAMES; i++) {
+    if (state.staging.fences[i]) {
+      glDeleteSync(state.staging.fences[i]);
+    }
+  }
+  glDeleteBuffers(1, &state.staging.id);
+#endif
   memset(&state, 0, sizeof(state));
 }
 
 void lovrGpuClear(Canvas* canvas, Color* color, float* depth, int* stencil) {
+  if (state.trace.active) traceClear(canvas, color, depth, stencil);
   lovrGpuBindCanvas(canvas, true);
 
   if (color) {
@@ -1394,6 +1811,7 @@ void lovrGpuClear(Canvas* canvas, Color* color, float* depth, int* stencil) {
 
   if (depth && !state.depthWrite) {
     state.depthWrite = true;
+    state.pipelineDirty = true;
     glDepthMask(state.depthWrite);
   }
 
@@ -1422,6 +1840,7 @@ void lovrGpuCompute(Shader* shader, int x, int y, int z) {
 }
 
 void lovrGpuDiscard(Canvas* canvas, bool color, bool depth, bool stencil) {
+  if (state.trace.active) traceDiscard(canvas, color, depth, stencil);
 #ifndef LOVR_GL
   lovrGpuBindCanvas(canvas, false);
 
@@ -1445,32 +1864,109 @@ void lovrGpuDiscard(Canvas* canvas, bool color, bool depth, bool stencil) {
 
   glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
 #endif
+
+  // There's nothing worth resolving in discarded color attachments
+  if (color && canvas->framebuffer) {
+    canvas->needsResolve = false;
+  }
+}
+
+// The view uniforms change between draws (and eyes), so they bypass the uniform map and dirty
+// tracking, and are only uploaded when they differ from what the program already has.
+static void lovrGpuBindBuiltins(Shader* shader, int viewportCount, int viewID) {
+  if (shader->viewportCount != viewportCount) {
+    shader->viewportCount = viewportCount;
+    if (shader->viewportCountLocation >= 0) {
+      glUniform1i(shader->viewportCountLocation, viewportCount);
+    }
+  }
+
+  if (shader->viewID != viewID) {
+    shader->viewID = viewID;
+    if (shader->viewIDLocation >= 0) {
+      glUniform1i(shader->viewIDLocation, viewID);
+    }
+  }
+}
+
+// The commands are tightly packed structs of 4 (arrays) or 5 (elements) uints.  Without multi draw
+// indirect, each command is issued separately.
+static void lovrGpuDrawIndirect(DrawCommand* draw, GLenum topology) {
+#ifndef LOVR_WEBGL
+  Buffer* buffer = draw->indirectBuffer;
+  Mesh* mesh = draw->mesh;
+
+  if (lovrGpuIsIncoherent(buffer->lastWrite, BARRIER_COMMAND)) {
+    lovrGpuSync(1 << BARRIER_COMMAND);
+  }
+
+  lovrBufferUnmap(buffer);
+  lovrGpuBindBuffer(BUFFER_INDIRECT, buffer->id);
+
+  if (mesh->indexCount > 0) {
+    GLenum indexType = mesh->indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+#ifdef LOVR_GL
+    if (lovrMultiDrawElementsIndirect) {
+      lovrMultiDrawElementsIndirect(topology, indexType, (GLvoid*) draw->indirectOffset, draw->indirectCount, 0);
+      state.stats.drawCalls++;
+      return;
+    }
+#endif
+    for (uint32_t i = 0; i < draw->indirectCount; i++) {
+      glDrawElementsIndirect(topology, indexType, (GLvoid*) (draw->indirectOffset + i * 5 * sizeof(uint32_t)));
+    }
+  } else {
+#ifdef LOVR_GL
+    if (lovrMultiDrawArraysIndirect) {
+      lovrMultiDrawArraysIndirect(topology, (GLvoid*) draw->indirectOffset, draw->indirectCount, 0);
+      state.stats.drawCalls++;
+      return;
+    }
+#endif
+    for (uint32_t i = 0; i < draw->indirectCount; i++) {
+      glDrawArraysIndirect(topology, (GLvoid*) (draw->indirectOffset + i * 4 * sizeof(uint32_t)));
+    }
+  }
+
+  state.stats.drawCalls += draw->indirectCount;
+#endif
 }
 
 void lovrGpuDraw(DrawCommand* draw) {
-  lovrAssert(state.singlepass != MULTIVIEW || draw->shader->multiview == draw->canvas->flags.stereo, "Shader and Canvas multiview settings must match!");
+  if (state.trace.active) traceDraw(draw);
+  Shader* shader = draw->depthOnly ? lovrShaderGetDepthVariant(draw->shader) : draw->shader;
+  shader = state.singlepass == MULTIVIEW ? lovrShaderGetVariant(shader, draw->canvas->flags.stereo) : shader;
   uint32_t viewportCount = (draw->canvas->flags.stereo && state.singlepass != MULTIVIEW) ? 2 : 1;
   uint32_t drawCount = state.singlepass == NONE ? viewportCount : 1;
   uint32_t instanceMultiplier = state.singlepass == INSTANCED_STEREO ? viewportCount : 1;
   uint32_t viewportsPerDraw = instanceMultiplier;
   uint32_t instances = MAX(draw->instances, 1) * instanceMultiplier;
+  lovrAssert(!draw->indirectBuffer || instanceMultiplier == 1, "Indirect draws to stereo Canvases are not supported with instanced stereo rendering");
 
   float w = state.singlepass == MULTIVIEW ? draw->canvas->width : draw->canvas->width / (float) viewportCount;
   float h = draw->canvas->height;
   float viewports[2][4] = { { 0.f, 0.f, w, h }, { w, 0.f, w, h } };
-  lovrShaderSetInts(draw->shader, "lovrViewportCount", &(int) { viewportCount }, 0, 1);
 
   lovrGpuBindCanvas(draw->canvas, true);
   lovrGpuBindPipeline(&draw->pipeline);
-  lovrGpuBindMesh(draw->mesh, draw->shader, instanceMultiplier);
+  lovrGpuBindMesh(draw->mesh, shader, instanceMultiplier);
+
+  if (draw->query) {
+    glBeginQuery(state.occlusionTarget, draw->query);
+  }
 
   for (uint32_t i = 0; i < drawCount; i++) {
     lovrGpuSetViewports(&viewports[i][0], viewportsPerDraw);
-    lovrShaderSetInts(draw->shader, "lovrViewID", &(int) { i }, 0, 1);
-    lovrGpuBindShader(draw->shader);
+    lovrGpuBindShader(shader);
+    lovrGpuBindBuiltins(shader, viewportCount, i);
 
     Mesh* mesh = draw->mesh;
     GLenum topology = convertTopology(draw->topology);
+    if (draw->indirectBuffer) {
+      lovrGpuDrawIndirect(draw, topology);
+      continue;
+    }
+
     if (mesh->indexCount > 0) {
       GLenum indexType = mesh->indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
       GLvoid* offset = (GLvoid*) (mesh->indexOffset + draw->rangeStart * mesh->indexSize);
@@ -1487,18 +1983,89 @@ void lovrGpuDraw(DrawCommand* draw) {
       }
     }
 
+    uint32_t count = draw->rangeCount;
+    switch (draw->topology) {
+      case DRAW_TRIANGLES: state.stats.triangles += (uint64_t) (count / 3) * instances; break;
+      case DRAW_TRIANGLE_STRIP:
+      case DRAW_TRIANGLE_FAN: state.stats.triangles += (uint64_t) (count > 2 ? count - 2 : 0) * instances; break;
+      default: break;
+    }
+    state.stats.vertices += (uint64_t) count * instances;
     state.stats.drawCalls++;
   }
+
+  if (draw->query) {
+    glEndQuery(state.occlusionTarget);
+  }
 }
 
 void lovrGpuPresent() {
+  if (state.trace.active) traceFrame();
+
+  // Close any scopes that were left open, then read back the oldest frame before its slot is reused
+  while (state.profileScope != ~0u) {
+    lovrGpuPopProfile();
+  }
+
+  state.profileFrame = (state.profileFrame + 1) % MAX_PROFILE_FRAMES;
+  ProfileFrame* frame = &state.profileFrames[state.profileFrame];
+  arr_clear(&state.profile);
+  arr_reserve(&state.profile, frame->scopes.length);
+  for (size_t i = 0; i < frame->scopes.length; i++) {
+    GpuProfileScope* scope = &frame->scopes.data[i].info;
+#ifdef LOVR_GL
+    if (state.features.timers) {
+      GLuint64 start, end;
+      glGetQueryObjectui64v(frame->queries.data[2 * i + 0], GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(frame->queries.data[2 * i + 1], GL_QUERY_RESULT, &end);
+      scope->gpuTime = (end - start) / 1e9;
+    }
+#endif
+    state.profile.data[state.profile.length++] = *scope;
+  }
+  arr_clear(&frame->scopes);
+
+#ifdef LOVR_GL
+  // Move on to the next staging region, waiting for the GPU to finish reading from it
+  if (state.staging.id) {
+    StagingBuffer* staging = &state.staging;
+    staging->fences[staging->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    staging->frame = (staging->frame + 1) % MAX_BUFFER_FRAMES;
+    staging->cursor = 0;
+
+    GLsync fence = staging->fences[staging->frame];
+    if (fence) {
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(fence);
+      staging->fences[staging->frame] = NULL;
+    }
+  }
+#endif
+
+  lovrGpuUpdateResidency();
+
   state.stats.shaderSwitches = 0;
   state.stats.renderPasses = 0;
   state.stats.drawCalls = 0;
+  memset(state.stats.flushes, 0, sizeof(state.stats.flushes));
+  state.stats.vertices = 0;
+  state.stats.triangles = 0;
+  memset(state.stats.streamBytes, 0, sizeof(state.stats.streamBytes));
+  state.stats.textureUploadBytes = 0;
+  state.stats.bufferUploadBytes = 0;
+  state.stats.uniformUploadBytes = 0;
+  state.frame++;
+}
+
+// Waits for all submitted GPU work, including the last swap
+void lovrGpuFinish() {
+  glFinish();
 }
 
 void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback callback, void* userdata) {
-  lovrGraphicsFlush();
+  lovrAssert(!lovrGraphicsIsRecording(), "Stencil writes can not be recorded in a DrawList");
+  lovrGraphicsFlushFor(FLUSH_STENCIL);
+  if (state.trace.active) traceStencil(action, replaceValue);
   if (!state.stencilEnabled) {
     state.stencilEnabled = true;
     glEnable(GL_STENCIL_TEST);
@@ -1519,10 +2086,13 @@ void lovrGpuStencil(StencilAction action, int replaceValue, StencilCallback call
   glStencilOp(GL_KEEP, GL_KEEP, glAction);
 
   state.stencilWriting = true;
+  state.pipelineDirty = true;
   callback(userdata);
-  lovrGraphicsFlush();
+  lovrGraphicsFlushFor(FLUSH_STENCIL);
+  if (state.trace.active) traceStencilEnd();
   state.stencilWriting = false;
   state.stencilMode = ~0; // Dirty
+  state.pipelineDirty = true;
 }
 
 void lovrGpuDirtyTexture() {
@@ -1557,6 +2127,8 @@ void lovrGpuResetState() {
   } else {
     glDisable(GL_DEPTH_TEST);
   }
+
+  state.pipelineDirty = true;
 }
 
 void lovrGpuTick(const char* label) {
@@ -1612,6 +2184,55 @@ void lovrGpuTick(const char* label) {
 #endif
 }
 
+void lovrGpuPushProfile(const char* label) {
+  ProfileFrame* frame = &state.profileFrames[state.profileFrame];
+  uint32_t index = (uint32_t) frame->scopes.length;
+  arr_reserve(&frame->scopes, index + 1);
+  ProfileScope* scope = &frame->scopes.data[frame->scopes.length++];
+  memset(scope, 0, sizeof(*scope));
+  strncpy(scope->info.label, label, sizeof(scope->info.label) - 1);
+  scope->info.parent = state.profileScope;
+  scope->cpuStart = os_get_time();
+  scope->drawCalls = state.stats.drawCalls;
+  scope->shaderSwitches = state.stats.shaderSwitches;
+  state.profileScope = index;
+
+#ifdef LOVR_GL
+  if (state.features.timers) {
+    if (frame->queries.length < 2 * frame->scopes.length) {
+      size_t count = frame->queries.length;
+      arr_reserve(&frame->queries, 2 * frame->scopes.length);
+      glGenQueries((GLsizei) (frame->queries.capacity - count), frame->queries.data + count);
+      frame->queries.length = frame->queries.capacity;
+    }
+
+    glQueryCounter(frame->queries.data[2 * index + 0], GL_TIMESTAMP);
+  }
+#endif
+}
+
+void lovrGpuPopProfile() {
+  lovrAssert(state.profileScope != ~0u, "Attempt to pop a profile scope when none are active");
+  ProfileFrame* frame = &state.profileFrames[state.profileFrame];
+  uint32_t index = state.profileScope;
+  ProfileScope* scope = &frame->scopes.data[index];
+  scope->info.cpuTime = os_get_time() - scope->cpuStart;
+  scope->info.drawCalls = state.stats.drawCalls - scope->drawCalls;
+  scope->info.shaderSwitches = state.stats.shaderSwitches - scope->shaderSwitches;
+  state.profileScope = scope->info.parent;
+
+#ifdef LOVR_GL
+  if (state.features.timers) {
+    glQueryCounter(frame->queries.data[2 * index + 1], GL_TIMESTAMP);
+  }
+#endif
+}
+
+const GpuProfileScope* lovrGpuGetProfile(uint32_t* count) {
+  *count = (uint32_t) state.profile.length;
+  return state.profile.data;
+}
+
 double lovrGpuTock(const char* label) {
 #ifdef LOVR_GL
   QueryPool* pool = &state.queryPool;
@@ -1661,6 +2282,34 @@ double lovrGpuTock(const char* label) {
   return 0.;
 }
 
+// Occlusion queries are owned by whoever creates them (Models keep one per node), since their
+// results are read back a frame or more after the query is issued and are tied to what was drawn.
+uint32_t lovrGpuCreateOcclusionQuery() {
+  GLuint query;
+  glGenQueries(1, &query);
+  return query;
+}
+
+void lovrGpuDestroyOcclusionQuery(uint32_t query) {
+  GLuint id = query;
+  glDeleteQueries(1, &id);
+}
+
+// Never blocks.  Returns false if the result isn't available yet.  The query must have been used in
+// a draw that has already been submitted.
+bool lovrGpuGetOcclusionResult(uint32_t query, bool* visible) {
+  GLuint available, samples;
+  glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+  if (!available) {
+    return false;
+  }
+
+  glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+  *visible = samples > 0;
+  return true;
+}
+
 const GpuFeatures* lovrGpuGetFeatures() {
   return &state.features;
 }
@@ -1673,27 +2322,183 @@ const GpuStats* lovrGpuGetStats() {
   return &state.stats;
 }
 
-// Texture
+void lovrGpuCountFlush(FlushReason reason) {
+  state.stats.flushes[reason]++;
+}
 
-Texture* lovrTextureCreate(TextureType type, Image** slices, uint32_t sliceCount, bool srgb, bool mipmaps, uint32_t msaa) {
-  Texture* texture = calloc(1, sizeof(Texture));
-  lovrAssert(texture, "Out of memory");
-  texture->ref = 1;
-  texture->type = type;
-  texture->srgb = srgb;
-  texture->mipmaps = mipmaps;
-  texture->target = convertTextureTarget(type);
-  texture->compareMode = COMPARE_NONE;
-  state.stats.textureCount++;
+void lovrGpuCountStream(StreamType type, size_t bytes) {
+  state.stats.streamBytes[type] += bytes;
+}
 
-  WrapMode wrap = type == TEXTURE_CUBE ? WRAP_CLAMP : WRAP_REPEAT;
-  glGenTextures(1, &texture->id);
-  lovrGpuBindTexture(texture, 0);
-  lovrTextureSetWrap(texture, (TextureWrap) { .s = wrap, .t = wrap, .r = wrap });
+// Texture
 
-  if (msaa > 1) {
+// Copies pixels into the staging buffer and binds it, returning the offset to pass to GL in place
+// of the client pointer, or the client pointer itself if this frame's budget is used up
+static const void* lovrGpuStagePixels(const void* data, size_t size) {
+#ifdef LOVR_GL
+  StagingBuffer* staging = &state.staging;
+
+  if (!state.persistentBuffers || staging->cursor + size > STAGING_FRAME_SIZE) {
+    return data;
+  }
+
+  if (!staging->id) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &staging->id);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->id);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, STAGING_FRAME_SIZE * MAX_BUFFER_FRAMES, NULL, flags);
+    staging->data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, STAGING_FRAME_SIZE * MAX_BUFFER_FRAMES, flags);
+    lovrAssert(staging->data, "Could not map texture staging buffer");
+  }
+
+  size_t offset = staging->frame * STAGING_FRAME_SIZE + staging->cursor;
+  memcpy(staging->data + offset, data, size);
+  staging->cursor = ALIGN(staging->cursor + size, 16);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging->id);
+  return (const void*) offset;
+#else
+  return data;
+#endif
+}
+
+// Replaces the storage of a Texture with one that is missing its biggest `dropped` mipmaps.  If an
+// Image is given, it's uploaded and the rest of the mipmaps are regenerated, otherwise the levels
+// that are still there get copied over from the old storage.
+static void lovrTextureResize(Texture* texture, uint32_t dropped, Image* image) {
+  GLuint old = texture->id;
+  uint32_t shift = dropped - MIN(dropped, texture->dropped);
+  state.stats.textureMemory -= getTextureMemorySize(texture);
+  texture->dropped = dropped;
+  state.stats.textureMemory += getTextureMemorySize(texture);
+
+  // The new name has to replace the old one in every slot it's bound to
+  glGenTextures(1, &texture->id);
+  for (int i = 0; i < MAX_TEXTURES; i++) {
+    if (state.textures[i] == texture) {
+      glActiveTexture(GL_TEXTURE0 + i);
+      glBindTexture(texture->target, texture->id);
+      state.activeTexture = i;
+    }
+  }
+  lovrGpuBindTexture(texture, 0);
+
+  uint32_t width = MAX(texture->width >> dropped, 1);
+  uint32_t height = MAX(texture->height >> dropped, 1);
+  uint32_t levels = texture->mipmapCount - dropped;
+  glTexStorage2D(texture->target, levels, convertTextureFormatInternal(texture->format, texture->srgb), width, height);
+
+  if (image) {
+    GLenum glFormat = convertTextureFormat(image->format);
+    GLenum glType = convertTextureFormatType(image->format);
+    glTexSubImage2D(texture->target, 0, 0, 0, width, height, glFormat, glType, image->blob->data);
+    glGenerateMipmap(texture->target);
+    state.stats.textureUploadBytes += image->blob->size;
+    state.stats.textureRestores++;
+  } else {
+    GLuint framebuffers[2];
+    glGenFramebuffers(2, framebuffers);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+    for (uint32_t i = 0; i < levels; i++) {
+      GLint w = MAX(width >> i, 1);
+      GLint h = MAX(height >> i, 1);
+      glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, old, i + shift);
+      glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->id, i);
+      glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, state.framebuffer);
+    glDeleteFramebuffers(2, framebuffers);
+    state.stats.textureEvictions++;
+  }
+
+  glDeleteTextures(1, &old);
+}
+
+// Decodes the source of a Texture with dropped mipmaps and uploads all of it again
+static void lovrTextureRestore(Texture* texture) {
+  if (texture->dropped > 0) {
+    Image* image = lovrImageCreateFromBlob(texture->source, texture->flip);
+    lovrAssert(image->width == texture->width && image->height == texture->height && image->format == texture->format, "Texture source changed");
+    lovrTextureResize(texture, 0, image);
+    lovrRelease(image, lovrImageDestroy);
+  }
+}
+
+// Textures used in the last frame that are missing mipmaps get restored, one per frame, if there's
+// room for them in the budget.  Then, while memory is over budget, the least recently used Textures
+// lose their biggest mipmap, down to a minimum size.
+static void lovrGpuUpdateResidency() {
+  if (state.textureBudget == 0 || state.managedTextures.length == 0) {
+    return;
+  }
+
+  uint64_t needed = 0;
+  for (size_t i = 0; i < state.managedTextures.length; i++) {
+    Texture* texture = state.managedTextures.data[i];
+    if (texture->dropped > 0 && texture->lastUse == state.frame) {
+      uint32_t dropped = texture->dropped;
+      uint64_t size = getTextureMemorySize(texture);
+      texture->dropped = 0;
+      uint64_t growth = getTextureMemorySize(texture) - size;
+      texture->dropped = dropped;
+
+      if (state.stats.textureMemory + growth <= state.textureBudget) {
+        lovrTextureRestore(texture);
+      } else {
+        needed = growth;
+      }
+      break;
+    }
+  }
+
+  for (uint32_t n = 0; n < MAX_EVICTIONS && state.stats.textureMemory + needed > state.textureBudget; n++) {
+    Texture* victim = NULL;
+    for (size_t i = 0; i < state.managedTextures.length; i++) {
+      Texture* texture = state.managedTextures.data[i];
+      if (texture->lastUse < state.frame && texture->mipmapCount - texture->dropped > MIN_RESIDENT_MIPMAPS) {
+        if (!victim || texture->lastUse < victim->lastUse) {
+          victim = texture;
+        }
+      }
+    }
+
+    if (!victim) {
+      break;
+    }
+
+    lovrTextureResize(victim, victim->dropped + 1, NULL);
+  }
+}
+
+uint64_t lovrGpuGetTextureBudget() {
+  return state.textureBudget;
+}
+
+void lovrGpuSetTextureBudget(uint64_t budget) {
+  state.textureBudget = budget;
+}
+
+Texture* lovrTextureCreate(TextureType type, Image** slices, uint32_t sliceCount, bool srgb, bool mipmaps, uint32_t msaa) {
+  Texture* texture = calloc(1, sizeof(Texture));
+  lovrAssert(texture, "Out of memory");
+  texture->ref = LOVR_REF_LOCAL | 1;
+  texture->type = type;
+  texture->srgb = srgb;
+  texture->mipmaps = mipmaps;
+  texture->target = convertTextureTarget(type);
+  texture->compareMode = COMPARE_NONE;
+  state.stats.textureCount++;
+
+  WrapMode wrap = type == TEXTURE_CUBE ? WRAP_CLAMP : WRAP_REPEAT;
+  glGenTextures(1, &texture->id);
+  lovrGpuBindTexture(texture, 0);
+  lovrTextureSetWrap(texture, (TextureWrap) { .s = wrap, .t = wrap, .r = wrap });
+
+  if (msaa > 1) {
     texture->msaa = msaa;
-    glGenRenderbuffers(1, &texture->msaaId);
+    if (!state.tiledMSAA) {
+      glGenRenderbuffers(1, &texture->msaaId);
+    }
   }
 
   if (sliceCount > 0) {
@@ -1709,7 +2514,7 @@ Texture* lovrTextureCreate(TextureType type, Image** slices, uint32_t sliceCount
 Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t depth, uint32_t msaa) {
   Texture* texture = calloc(1, sizeof(Texture));
   lovrAssert(texture, "Out of memory");
-  texture->ref = 1;
+  texture->ref = LOVR_REF_LOCAL | 1;
   texture->type = type;
   texture->id = handle;
   texture->target = convertTextureTarget(type);
@@ -1728,6 +2533,9 @@ Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t
 
   if (msaa > 1) {
     texture->msaa = msaa;
+  }
+
+  if (msaa > 1 && !state.tiledMSAA) {
     GLint internalFormat;
     glGetTexLevelParameteriv(texture->target, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
     glGenRenderbuffers(1, &texture->msaaId);
@@ -1740,9 +2548,18 @@ Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t
 
 void lovrTextureDestroy(void* ref) {
   Texture* texture = ref;
+  if (state.trace.active) traceForget(texture);
+  if (texture->source) {
+    for (size_t i = 0; i < state.managedTextures.length; i++) {
+      if (state.managedTextures.data[i] == texture) {
+        arr_splice(&state.managedTextures, i, 1);
+        break;
+      }
+    }
+    lovrRelease(texture->source, lovrBlobDestroy);
+  }
   glDeleteTextures(1, &texture->id);
   glDeleteRenderbuffers(1, &texture->msaaId);
-  lovrGpuDestroySyncResource(texture, texture->incoherent);
   state.stats.textureMemory -= getTextureMemorySize(texture);
   state.stats.textureCount--;
   free(texture);
@@ -1822,9 +2639,10 @@ void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint
 void lovrTextureReplacePixels(Texture* texture, Image* image, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap) {
   lovrGraphicsFlush();
   lovrAssert(texture->allocated, "Texture is not allocated");
+  lovrTextureSetSource(texture, NULL, false);
 
 #ifndef LOVR_WEBGL
-  if ((texture->incoherent >> BARRIER_TEXTURE) & 1) {
+  if (lovrGpuIsIncoherent(texture->lastWrite, BARRIER_TEXTURE)) {
     lovrGpuSync(1 << BARRIER_TEXTURE);
   }
 #endif
@@ -1836,6 +2654,7 @@ void lovrTextureReplacePixels(Texture* texture, Image* image, uint32_t x, uint32
   bool overflow = (x + width > maxWidth) || (y + height > maxHeight);
   lovrAssert(!overflow, "Trying to replace pixels outside the texture's bounds");
   lovrAssert(mipmap < texture->mipmapCount, "Invalid mipmap level %d", mipmap);
+  if (state.trace.active && !isTextureFormatCompressed(image->format)) traceTextureData(texture, image, x, y, slice, mipmap);
   GLenum glFormat = convertTextureFormat(image->format);
   GLenum glInternalFormat = convertTextureFormatInternal(image->format, texture->srgb);
   GLenum binding = (texture->type == TEXTURE_CUBE) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + slice : texture->target;
@@ -1856,23 +2675,31 @@ void lovrTextureReplacePixels(Texture* texture, Image* image, uint32_t x, uint32
           glCompressedTexSubImage3D(binding, i, x, y, slice, m->width, m->height, 1, glInternalFormat, (GLsizei) m->size, m->data);
           break;
       }
+      state.stats.textureUploadBytes += m->size;
     }
   } else {
     lovrAssert(image->blob->data, "Trying to replace Texture pixels with empty pixel data");
     GLenum glType = convertTextureFormatType(image->format);
+    const void* pixels = lovrGpuStagePixels(image->blob->data, image->blob->size);
 
     switch (texture->type) {
       case TEXTURE_2D:
       case TEXTURE_CUBE:
-        glTexSubImage2D(binding, mipmap, x, y, width, height, glFormat, glType, image->blob->data);
+        glTexSubImage2D(binding, mipmap, x, y, width, height, glFormat, glType, pixels);
         break;
       case TEXTURE_ARRAY:
       case TEXTURE_VOLUME:
-        glTexSubImage3D(binding, mipmap, x, y, slice, width, height, 1, glFormat, glType, image->blob->data);
+        glTexSubImage3D(binding, mipmap, x, y, slice, width, height, 1, glFormat, glType, pixels);
         break;
     }
 
-    if (texture->mipmaps) {
+    state.stats.textureUploadBytes += image->blob->size;
+
+    if (pixels != image->blob->data) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (texture->mipmaps && mipmap == 0) {
 #if defined(__APPLE__) || defined(LOVR_WEBGL) // glGenerateMipmap doesn't work on big cubemap textures on macOS
       if (texture->type != TEXTURE_CUBE || width < 2048) {
         glGenerateMipmap(texture->target);
@@ -1886,6 +2713,44 @@ void lovrTextureReplacePixels(Texture* texture, Image* image, uint32_t x, uint32
   }
 }
 
+// Copies a region of one 2D texture into another on the GPU, returning false if it isn't possible
+bool lovrTextureCopy(Texture* texture, Texture* source, uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+  lovrGraphicsFlush();
+  lovrAssert(texture->allocated && source->allocated, "Texture is not allocated");
+  lovrAssert(texture->type == TEXTURE_2D && source->type == TEXTURE_2D, "Only 2D textures can be copied");
+  bool overflow = (width > source->width || height > source->height) || (x + width > texture->width || y + height > texture->height);
+  lovrAssert(!overflow, "Trying to copy pixels outside the texture's bounds");
+  lovrTextureSetSource(texture, NULL, false);
+  lovrTextureRestore(source);
+
+#ifndef LOVR_WEBGL
+  if (lovrGpuIsIncoherent(MAX(texture->lastWrite, source->lastWrite), BARRIER_TEXTURE)) {
+    lovrGpuSync(1 << BARRIER_TEXTURE);
+  }
+
+  if (glCopyImageSubData && texture->format == source->format) {
+    glCopyImageSubData(source->id, GL_TEXTURE_2D, 0, 0, 0, 0, texture->id, GL_TEXTURE_2D, 0, x, y, 0, width, height, 1);
+    return true;
+  }
+#endif
+
+  // Otherwise, attach the source to a temporary framebuffer and copy from it
+  uint32_t framebuffer;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source->id, 0);
+  bool complete = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+  if (complete) {
+    lovrGpuBindTexture(texture, 0);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, x, y, 0, 0, width, height);
+  }
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, state.framebuffer);
+  glDeleteFramebuffers(1, &framebuffer);
+  return complete;
+}
+
 uint64_t lovrTextureGetId(Texture* texture) {
   return texture->id;
 }
@@ -1906,6 +2771,15 @@ uint32_t lovrTextureGetMipmapCount(Texture* texture) {
   return texture->mipmapCount;
 }
 
+// Mipmaps below the base level are ignored when sampling, which lets partially uploaded mipmap
+// chains be used before the bigger levels are filled in
+void lovrTextureSetBaseMipmap(Texture* texture, uint32_t mipmap) {
+  lovrAssert(mipmap < texture->mipmapCount, "Invalid mipmap level %d", mipmap);
+  lovrGraphicsFlush();
+  lovrGpuBindTexture(texture, 0);
+  glTexParameteri(texture->target, GL_TEXTURE_BASE_LEVEL, mipmap);
+}
+
 uint32_t lovrTextureGetMSAA(Texture* texture) {
   return texture->msaa;
 }
@@ -1930,64 +2804,60 @@ TextureWrap lovrTextureGetWrap(Texture* texture) {
   return texture->wrap;
 }
 
+// Sampling state lives in shared sampler objects, so changing it is just a lookup and the texture
+// object itself is left alone.  Native textures use their own parameters until this is called.
 void lovrTextureSetCompareMode(Texture* texture, CompareMode compareMode) {
   if (texture->compareMode != compareMode) {
+    lovrAssert(compareMode == COMPARE_NONE || isTextureFormatDepth(texture->format), "Only depth textures can set a compare mode");
     lovrGraphicsFlush();
-    lovrGpuBindTexture(texture, 0);
     texture->compareMode = compareMode;
-    if (compareMode == COMPARE_NONE) {
-      glTexParameteri(texture->target, GL_TEXTURE_COMPARE_MODE, GL_NONE);
-    } else {
-      lovrAssert(isTextureFormatDepth(texture->format), "Only depth textures can set a compare mode");
-      glTexParameteri(texture->target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-      glTexParameteri(texture->target, GL_TEXTURE_COMPARE_FUNC, convertCompareMode(compareMode));
-    }
+    texture->sampler = lovrGpuGetSampler(texture->filter, texture->wrap, texture->compareMode, texture->mipmaps);
   }
 }
 
 void lovrTextureSetFilter(Texture* texture, TextureFilter filter) {
   lovrGraphicsFlush();
-  lovrGpuBindTexture(texture, 0);
   texture->filter = filter;
+  texture->sampler = lovrGpuGetSampler(texture->filter, texture->wrap, texture->compareMode, texture->mipmaps);
+}
 
-  switch (filter.mode) {
-    case FILTER_NEAREST:
-      glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-      glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-      break;
+void lovrTextureSetWrap(Texture* texture, TextureWrap wrap) {
+  lovrGraphicsFlush();
+  texture->wrap = wrap;
+  texture->sampler = lovrGpuGetSampler(texture->filter, texture->wrap, texture->compareMode, texture->mipmaps);
+}
 
-    case FILTER_BILINEAR:
-      if (texture->mipmaps) {
-        glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-        glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      } else {
-        glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      }
-      break;
+// The source is the encoded file a Texture was loaded from.  Textures with a source can have their
+// biggest mipmaps dropped when over the texture budget, since they can be decoded again later.
+// Writing to a Texture makes it lose its source, since it wouldn't match anymore.  Only mipmapped
+// 2D Textures with uncompressed 8 bit formats are managed, others ignore the source.
+void lovrTextureSetSource(Texture* texture, Blob* source, bool flip) {
+  if (texture->source == source) {
+    return;
+  }
 
-    case FILTER_TRILINEAR:
-      if (texture->mipmaps) {
-        glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      } else {
-        glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(texture->target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (texture->source) {
+    lovrTextureRestore(texture);
+    for (size_t i = 0; i < state.managedTextures.length; i++) {
+      if (state.managedTextures.data[i] == texture) {
+        arr_splice(&state.managedTextures, i, 1);
+        break;
       }
-      break;
+    }
+    lovrRelease(texture->source, lovrBlobDestroy);
+    texture->source = NULL;
   }
 
-  glTexParameteri(texture->target, GL_TEXTURE_MAX_ANISOTROPY_EXT, MAX(filter.anisotropy, 1.f));
-}
-
-void lovrTextureSetWrap(Texture* texture, TextureWrap wrap) {
-  lovrGraphicsFlush();
-  texture->wrap = wrap;
-  lovrGpuBindTexture(texture, 0);
-  glTexParameteri(texture->target, GL_TEXTURE_WRAP_S, convertWrapMode(wrap.s));
-  glTexParameteri(texture->target, GL_TEXTURE_WRAP_T, convertWrapMode(wrap.t));
-  if (texture->type == TEXTURE_CUBE || texture->type == TEXTURE_VOLUME) {
-    glTexParameteri(texture->target, GL_TEXTURE_WRAP_R, convertWrapMode(wrap.r));
+#ifdef LOVR_GL
+  if (!GLAD_GL_ARB_texture_storage) return;
+#endif
+  bool manageable = texture->type == TEXTURE_2D && texture->mipmaps && !texture->msaa && !texture->native;
+  manageable = manageable && (texture->format == FORMAT_RGB || texture->format == FORMAT_RGBA);
+  if (source && manageable) {
+    lovrRetain(source);
+    texture->source = source;
+    texture->flip = flip;
+    arr_push(&state.managedTextures, texture);
   }
 }
 
@@ -1996,7 +2866,7 @@ void lovrTextureSetWrap(Texture* texture, TextureWrap wrap) {
 Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
   Canvas* canvas = calloc(1, sizeof(Canvas));
   lovrAssert(canvas, "Out of memory");
-  canvas->ref = 1;
+  canvas->ref = LOVR_REF_LOCAL | 1;
 
   if (flags.stereo && state.singlepass != MULTIVIEW) {
     width *= 2;
@@ -2005,6 +2875,7 @@ Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
   canvas->width = width;
   canvas->height = height;
   canvas->flags = flags;
+  canvas->tiledMSAA = state.tiledMSAA && flags.msaa && (!flags.stereo || state.singlepass != MULTIVIEW);
 
   glGenFramebuffers(1, &canvas->framebuffer);
   lovrGpuBindFramebuffer(canvas->framebuffer);
@@ -2024,17 +2895,25 @@ Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
     } else if (flags.depth.readable) {
       canvas->depth.texture = lovrTextureCreate(TEXTURE_2D, NULL, 0, false, flags.mipmaps, flags.msaa);
       lovrTextureAllocate(canvas->depth.texture, width, height, 1, flags.depth.format);
-      glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, canvas->depth.texture->id, 0);
+      if (canvas->tiledMSAA) {
+        lovrFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, canvas->depth.texture->id, 0, flags.msaa);
+      } else {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, canvas->depth.texture->id, 0);
+      }
     } else {
       GLenum format = convertTextureFormatInternal(flags.depth.format, false);
       glGenRenderbuffers(1, &canvas->depthBuffer);
       glBindRenderbuffer(GL_RENDERBUFFER, canvas->depthBuffer);
-      glRenderbufferStorageMultisample(GL_RENDERBUFFER, canvas->flags.msaa, format, width, height);
+      if (canvas->tiledMSAA) {
+        lovrRenderbufferStorageMultisampleEXT(GL_RENDERBUFFER, flags.msaa, format, width, height);
+      } else {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, canvas->flags.msaa, format, width, height);
+      }
       glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, canvas->depthBuffer);
     }
   }
 
-  if (flags.msaa && (!flags.stereo || state.singlepass != MULTIVIEW)) {
+  if (flags.msaa && (!flags.stereo || state.singlepass != MULTIVIEW) && !canvas->tiledMSAA) {
     glGenFramebuffers(1, &canvas->resolveBuffer);
   }
 
@@ -2044,7 +2923,7 @@ Canvas* lovrCanvasCreate(uint32_t width, uint32_t height, CanvasFlags flags) {
 Canvas* lovrCanvasCreateFromHandle(uint32_t width, uint32_t height, CanvasFlags flags, uint32_t framebuffer, uint32_t depthBuffer, uint32_t resolveBuffer, uint32_t attachmentCount, bool immortal) {
   Canvas* canvas = calloc(1, sizeof(Canvas));
   lovrAssert(canvas, "Out of memory");
-  canvas->ref = 1;
+  canvas->ref = LOVR_REF_LOCAL | 1;
   canvas->framebuffer = framebuffer;
   canvas->depthBuffer = depthBuffer;
   canvas->resolveBuffer = resolveBuffer;
@@ -2059,6 +2938,7 @@ Canvas* lovrCanvasCreateFromHandle(uint32_t width, uint32_t height, CanvasFlags
 void lovrCanvasDestroy(void* ref) {
   Canvas* canvas = ref;
   lovrGraphicsFlushCanvas(canvas);
+  if (state.trace.active) traceForget(canvas);
   if (!canvas->immortal) {
     glDeleteFramebuffers(1, &canvas->framebuffer);
     glDeleteRenderbuffers(1, &canvas->depthBuffer);
@@ -2068,6 +2948,7 @@ void lovrCanvasDestroy(void* ref) {
     lovrRelease(canvas->attachments[i].texture, lovrTextureDestroy);
   }
   lovrRelease(canvas->depth.texture, lovrTextureDestroy);
+  lovrRelease(canvas->externalDepth, lovrTextureDestroy);
   free(canvas);
 }
 
@@ -2077,10 +2958,12 @@ void lovrCanvasResolve(Canvas* canvas) {
   }
 
   lovrGraphicsFlushCanvas(canvas);
+  if (state.trace.active) traceResolve(canvas);
 
   // We don't need to resolve a multiview Canvas because it uses the legacy multisampling method in
   // which the driver does an implicit multisample resolve whenever the canvas textures are read.
-  if (canvas->flags.msaa && (!canvas->flags.stereo || state.singlepass != MULTIVIEW)) {
+  // Canvases using EXT_multisampled_render_to_texture are resolved the same way.
+  if (canvas->flags.msaa && (!canvas->flags.stereo || state.singlepass != MULTIVIEW) && !canvas->tiledMSAA) {
     uint32_t w = canvas->width;
     uint32_t h = canvas->height;
     glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas->framebuffer);
@@ -2100,6 +2983,11 @@ void lovrCanvasResolve(Canvas* canvas) {
       glReadBuffer(0);
       glDrawBuffers(canvas->attachmentCount, buffers);
     }
+
+    if (canvas->externalDepth) {
+      GLbitfield mask = GL_DEPTH_BUFFER_BIT | (canvas->flags.depth.format == FORMAT_D24S8 ? GL_STENCIL_BUFFER_BIT : 0);
+      glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, mask, GL_NEAREST);
+    }
   }
 
   if (canvas->flags.mipmaps) {
@@ -2115,33 +3003,179 @@ void lovrCanvasResolve(Canvas* canvas) {
   canvas->needsResolve = false;
 }
 
-Image* lovrCanvasNewImage(Canvas* canvas, uint32_t index) {
+// Binds a Canvas attachment for glReadPixels
+static void lovrCanvasBeginRead(Canvas* canvas, uint32_t index) {
   lovrGraphicsFlushCanvas(canvas);
   lovrGpuBindCanvas(canvas, false);
 
-  if (canvas->flags.msaa) {
+  if (canvas->flags.msaa && !canvas->tiledMSAA) {
     glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas->resolveBuffer);
   }
 
 #ifndef LOVR_WEBGL
   Texture* texture = canvas->attachments[index].texture;
-  if ((texture->incoherent >> BARRIER_TEXTURE) & 1) {
+  if (lovrGpuIsIncoherent(texture->lastWrite, BARRIER_TEXTURE)) {
     lovrGpuSync(1 << BARRIER_TEXTURE);
   }
 #endif
 
   if (index != 0) {
-    glReadBuffer(index);
+    glReadBuffer(GL_COLOR_ATTACHMENT0 + index);
+  }
+}
+
+static void lovrCanvasEndRead(Canvas* canvas, uint32_t index) {
+  if (index != 0) {
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
   }
+}
 
+Image* lovrCanvasNewImage(Canvas* canvas, uint32_t index) {
+  lovrCanvasBeginRead(canvas, index);
   Image* image = lovrImageCreate(canvas->width, canvas->height, NULL, 0x0, FORMAT_RGBA);
   glReadPixels(0, 0, canvas->width, canvas->height, GL_RGBA, GL_UNSIGNED_BYTE, image->blob->data);
+  lovrCanvasEndRead(canvas, index);
+  return image;
+}
 
-  if (index != 0) {
-    glReadBuffer(0);
+// Readback
+
+// A Readback copies a Canvas attachment into a pixel pack buffer and fences it, so the pixels can
+// be picked up a frame or two later without stalling.  WebGL can't map buffers, so it reads the
+// pixels immediately instead.
+Readback* lovrReadbackCreate(Canvas* canvas, uint32_t index) {
+  Readback* readback = calloc(1, sizeof(Readback));
+  lovrAssert(readback, "Out of memory");
+  readback->ref = LOVR_REF_LOCAL | 1;
+  readback->width = canvas->width;
+  readback->height = canvas->height;
+
+#ifdef LOVR_WEBGL
+  readback->image = lovrCanvasNewImage(canvas, index);
+#else
+  lovrCanvasBeginRead(canvas, index);
+  glGenBuffers(1, &readback->buffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->buffer);
+  glBufferData(GL_PIXEL_PACK_BUFFER, readback->width * readback->height * 4, NULL, GL_STREAM_READ);
+  glReadPixels(0, 0, readback->width, readback->height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  lovrCanvasEndRead(canvas, index);
+  readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+  return readback;
+}
+
+// Buffer Readbacks copy a range of the Buffer into a staging buffer on the GPU, which is what the
+// fence waits for, so compute results can be picked up later without stalling on the dispatch.
+// WebGL Buffers have a copy of their contents on the CPU, which gets copied right away.
+Readback* lovrReadbackCreateBuffer(Buffer* buffer, size_t offset, size_t size) {
+  lovrAssert(size > 0, "Readback size must be positive");
+  lovrAssert(offset + size <= buffer->size, "Tried to read back past the end of the Buffer");
+  Readback* readback = calloc(1, sizeof(Readback));
+  lovrAssert(readback, "Out of memory");
+  readback->ref = LOVR_REF_LOCAL | 1;
+  readback->size = size;
+
+#ifdef LOVR_WEBGL
+  void* data = malloc(size);
+  lovrAssert(data, "Out of memory");
+  memcpy(data, (uint8_t*) buffer->data + offset, size);
+  readback->blob = lovrBlobCreate(data, size, "Readback");
+#else
+  lovrBufferUnmap(buffer);
+
+  if (lovrGpuIsIncoherent(buffer->lastWrite, BARRIER_BUFFER)) {
+    lovrGpuSync(1 << BARRIER_BUFFER);
   }
 
-  return image;
+  glGenBuffers(1, &readback->buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, readback->buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_READ);
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer->id);
+  glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+
+  return readback;
+}
+
+void lovrReadbackDestroy(void* ref) {
+  Readback* readback = ref;
+#ifndef LOVR_WEBGL
+  if (readback->fence) {
+    glDeleteSync(readback->fence);
+  }
+  glDeleteBuffers(1, &readback->buffer);
+#endif
+  lovrRelease(readback->image, lovrImageDestroy);
+  lovrRelease(readback->blob, lovrBlobDestroy);
+  free(readback);
+}
+
+#ifndef LOVR_WEBGL
+// Readbacks of Buffers have a size instead of dimensions
+static void lovrReadbackFinish(Readback* readback) {
+  void* contents;
+  size_t size;
+  if (readback->size > 0) {
+    size = readback->size;
+    contents = malloc(size);
+    lovrAssert(contents, "Out of memory");
+    readback->blob = lovrBlobCreate(contents, size, "Readback");
+  } else {
+    size = readback->width * readback->height * 4;
+    readback->image = lovrImageCreate(readback->width, readback->height, NULL, 0x0, FORMAT_RGBA);
+    contents = readback->image->blob->data;
+  }
+  GLenum target = readback->size > 0 ? GL_COPY_READ_BUFFER : GL_PIXEL_PACK_BUFFER;
+  glBindBuffer(target, readback->buffer);
+  void* data = glMapBufferRange(target, 0, size, GL_MAP_READ_BIT);
+  lovrAssert(data, "Could not map Readback buffer");
+  memcpy(contents, data, size);
+  glUnmapBuffer(target);
+  glBindBuffer(target, 0);
+  glDeleteBuffers(1, &readback->buffer);
+  glDeleteSync(readback->fence);
+  readback->buffer = 0;
+  readback->fence = NULL;
+}
+#endif
+
+bool lovrReadbackIsReady(Readback* readback) {
+#ifndef LOVR_WEBGL
+  if (readback->fence) {
+    GLenum status = glClientWaitSync(readback->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+      return false;
+    }
+    lovrReadbackFinish(readback);
+  }
+#endif
+  return true;
+}
+
+static void lovrReadbackWait(Readback* readback) {
+#ifndef LOVR_WEBGL
+  if (readback->fence) {
+    while (glClientWaitSync(readback->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+    lovrReadbackFinish(readback);
+  }
+#endif
+}
+
+// Waits for the pixels if they aren't ready yet, returning NULL for Buffer Readbacks
+Image* lovrReadbackGetImage(Readback* readback) {
+  lovrReadbackWait(readback);
+  return readback->image;
+}
+
+// Waits for the data if it isn't ready yet.  For Canvas Readbacks, this is the Image's pixels.
+Blob* lovrReadbackGetBlob(Readback* readback) {
+  lovrReadbackWait(readback);
+  return readback->image ? readback->image->blob : readback->blob;
 }
 
 const Attachment* lovrCanvasGetAttachments(Canvas* canvas, uint32_t* count) {
@@ -2175,6 +3209,7 @@ void lovrCanvasSetAttachments(Canvas* canvas, Attachment* attachments, uint32_t
 #ifndef __ANDROID__ // On multiview canvases, the multisample settings can be different
     lovrAssert(lovrTextureGetMSAA(texture) == canvas->flags.msaa, "Texture MSAA does not match Canvas MSAA");
 #endif
+    lovrTextureSetSource(texture, NULL, false);
     lovrRetain(texture);
   }
 
@@ -2216,7 +3251,24 @@ uint32_t lovrCanvasGetMSAA(Canvas* canvas) {
 }
 
 Texture* lovrCanvasGetDepthTexture(Canvas* canvas) {
-  return canvas->depth.texture;
+  return canvas->externalDepth ? canvas->externalDepth : canvas->depth.texture;
+}
+
+// Renders depth to a texture owned by someone else (a depth swapchain), or back to the Canvas's own
+// depth buffer when the texture is NULL.  Multiview Canvases need a 2 layer texture, the rest need a
+// 2D texture, which multisampled Canvases resolve their depth to.
+void lovrCanvasSetDepthTexture(Canvas* canvas, Texture* texture) {
+  if (canvas->externalDepth == texture) {
+    return;
+  }
+
+  lovrAssert(canvas->flags.depth.enabled, "Canvas has no depth buffer");
+  lovrGraphicsFlushCanvas(canvas);
+  lovrRetain(texture);
+  lovrRelease(canvas->externalDepth, lovrTextureDestroy);
+  canvas->externalDepth = texture;
+  canvas->needsAttach = true;
+  canvas->needsDepthAttach = true;
 }
 
 // Buffer
@@ -2224,7 +3276,7 @@ Texture* lovrCanvasGetDepthTexture(Canvas* canvas) {
 Buffer* lovrBufferCreate(size_t size, void* data, BufferType type, BufferUsage usage, bool readable) {
   Buffer* buffer = calloc(1, sizeof(Buffer));
   lovrAssert(buffer, "Out of memory");
-  buffer->ref = 1;
+  buffer->ref = LOVR_REF_LOCAL | 1;
 
   state.stats.bufferCount++;
   state.stats.bufferMemory += size;
@@ -2255,9 +3307,64 @@ Buffer* lovrBufferCreate(size_t size, void* data, BufferType type, BufferUsage u
   return buffer;
 }
 
+// Persistent Buffers are write-only streams that stay mapped for their whole lifetime.  Instead
+// of orphaning the storage, discarding one moves on to the next of a few copies, fenced so that
+// it waits for the GPU to finish with a copy before writing to it again.
+Buffer* lovrBufferCreatePersistent(size_t size, BufferType type) {
+#ifdef LOVR_GL
+  if (!state.persistentBuffers) {
+#endif
+    return lovrBufferCreate(size, NULL, type, USAGE_STREAM, false);
+#ifdef LOVR_GL
+  }
+
+  Buffer* buffer = calloc(1, sizeof(Buffer));
+  lovrAssert(buffer, "Out of memory");
+  buffer->ref = LOVR_REF_LOCAL | 1;
+
+  state.stats.bufferCount++;
+  state.stats.bufferMemory += size * MAX_BUFFER_FRAMES;
+  buffer->size = size;
+  buffer->type = type;
+  buffer->usage = USAGE_STREAM;
+  buffer->persistent = true;
+  glGenBuffers(MAX_BUFFER_FRAMES, buffer->frames);
+  GLenum glType = convertBufferType(type);
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  for (uint32_t i = 0; i < MAX_BUFFER_FRAMES; i++) {
+    lovrGpuBindBuffer(type, buffer->frames[i]);
+    glBufferStorage(glType, size, NULL, flags);
+    buffer->pointers[i] = glMapBufferRange(glType, 0, size, flags);
+    lovrAssert(buffer->pointers[i], "Could not map persistent Buffer");
+  }
+
+  buffer->id = buffer->frames[0];
+  buffer->data = buffer->pointers[0];
+  return buffer;
+#endif
+}
+
 void lovrBufferDestroy(void* ref) {
   Buffer* buffer = ref;
-  lovrGpuDestroySyncResource(buffer, buffer->incoherent);
+  lovrGraphicsFlushBuffer(buffer);
+  if (state.trace.active) traceForget(buffer);
+#ifdef LOVR_GL
+  if (buffer->persistent) {
+    for (uint32_t i = 0; i < MAX_BUFFER_FRAMES; i++) {
+      if (buffer->fences[i]) {
+        glDeleteSync(buffer->fences[i]);
+      }
+    }
+
+    // Deleting a Buffer also unmaps it
+    glDeleteBuffers(MAX_BUFFER_FRAMES, buffer->frames);
+    state.stats.bufferMemory -= buffer->size * MAX_BUFFER_FRAMES;
+    state.stats.bufferCount--;
+    free(buffer);
+    return;
+  }
+#endif
   glDeleteBuffers(1, &buffer->id);
 #ifndef LOVR_WEBGL
   if (state.amd)
@@ -2282,10 +3389,13 @@ BufferUsage lovrBufferGetUsage(Buffer* buffer) {
 
 void* lovrBufferMap(Buffer* buffer, size_t offset, bool unsynchronized) {
 #ifndef LOVR_WEBGL
-  if (!state.amd && !buffer->mapped) {
+  if (!state.amd && !buffer->persistent && !buffer->mapped) {
     buffer->mapped = true;
     lovrGpuBindBuffer(buffer->type, buffer->id);
     lovrAssert(!buffer->readable || !unsynchronized, "Readable Buffers must be mapped with synchronization");
+    if (buffer->readable && lovrGpuIsIncoherent(buffer->lastWrite, BARRIER_BUFFER)) {
+      lovrGpuSync(1 << BARRIER_BUFFER);
+    }
     GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
     flags |= buffer->readable ? GL_MAP_READ_BIT : 0;
     flags |= unsynchronized ? GL_MAP_UNSYNCHRONIZED_BIT : 0;
@@ -2298,13 +3408,18 @@ void* lovrBufferMap(Buffer* buffer, size_t offset, bool unsynchronized) {
 
 void lovrBufferFlush(Buffer* buffer, size_t offset, size_t size) {
 #ifndef LOVR_WEBGL
-  lovrAssert(state.amd || size == 0 || buffer->mapped, "Attempt to flush unmapped Buffer");
+  lovrAssert(state.amd || size == 0 || buffer->mapped || buffer->persistent, "Attempt to flush unmapped Buffer");
 #endif
   buffer->flushFrom = MIN(buffer->flushFrom, offset);
   buffer->flushTo = MAX(buffer->flushTo, offset + size);
 }
 
 void lovrBufferUnmap(Buffer* buffer) {
+  if (buffer->flushTo > buffer->flushFrom) {
+    state.stats.bufferUploadBytes += buffer->flushTo - buffer->flushFrom;
+    if (state.trace.active) traceBufferData(buffer);
+  }
+
 #ifndef LOVR_WEBGL
   if (state.amd) {
 #endif
@@ -2314,7 +3429,7 @@ void lovrBufferUnmap(Buffer* buffer) {
       glBufferSubData(convertBufferType(buffer->type), buffer->flushFrom, buffer->flushTo - buffer->flushFrom, data);
     }
 #ifndef LOVR_WEBGL
-  } else if (buffer->mapped) {
+  } else if (buffer->mapped && !buffer->persistent) {
     lovrGpuBindBuffer(buffer->type, buffer->id);
 
     if (buffer->flushTo > buffer->flushFrom) {
@@ -2332,6 +3447,25 @@ void lovrBufferUnmap(Buffer* buffer) {
 void lovrBufferDiscard(Buffer* buffer) {
   lovrAssert(!buffer->readable, "Readable Buffers can not be discarded");
   lovrAssert(!buffer->mapped, "Mapped Buffers can not be discarded");
+  if (state.trace.active) traceBufferDiscard(buffer);
+#ifdef LOVR_GL
+  if (buffer->persistent) {
+    buffer->fences[buffer->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer->frame = (buffer->frame + 1) % MAX_BUFFER_FRAMES;
+
+    GLsync fence = buffer->fences[buffer->frame];
+    if (fence) {
+      while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(fence);
+      buffer->fences[buffer->frame] = NULL;
+    }
+
+    buffer->id = buffer->frames[buffer->frame];
+    buffer->data = buffer->pointers[buffer->frame];
+    buffer->used = false;
+    return;
+  }
+#endif
   lovrGpuBindBuffer(buffer->type, buffer->id);
   GLenum glType = convertBufferType(buffer->type);
 #ifndef LOVR_WEBGL
@@ -2349,11 +3483,14 @@ void lovrBufferDiscard(Buffer* buffer) {
 
 // Shader
 
-static GLuint compileShader(GLenum type, const char** sources, int* lengths, int count) {
+static GLuint startShader(GLenum type, const char** sources, int* lengths, int count) {
   GLuint shader = glCreateShader(type);
   glShaderSource(shader, count, sources, lengths);
   glCompileShader(shader);
+  return shader;
+}
 
+static GLuint checkShader(GLuint shader) {
   int isShaderCompiled;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &isShaderCompiled);
   if (!isShaderCompiled) {
@@ -2362,6 +3499,8 @@ static GLuint compileShader(GLenum type, const char** sources, int* lengths, int
     char* log = malloc(logLength);
     lovrAssert(log, "Out of memory");
     glGetShaderInfoLog(shader, logLength, &logLength, log);
+    GLint type;
+    glGetShaderiv(shader, GL_SHADER_TYPE, &type);
     const char* name;
     switch (type) {
       case GL_VERTEX_SHADER: name = "vertex shader"; break;
@@ -2375,9 +3514,11 @@ static GLuint compileShader(GLenum type, const char** sources, int* lengths, int
   return shader;
 }
 
-static GLuint linkProgram(GLuint program) {
-  glLinkProgram(program);
+static GLuint compileShader(GLenum type, const char** sources, int* lengths, int count) {
+  return checkShader(startShader(type, sources, lengths, count));
+}
 
+static GLuint checkProgram(GLuint program) {
   int isLinked;
   glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
   if (!isLinked) {
@@ -2392,19 +3533,125 @@ static GLuint linkProgram(GLuint program) {
   return program;
 }
 
-static void lovrShaderSetupUniforms(Shader* shader) {
-  uint32_t program = shader->program;
-  lovrGpuUseProgram(program); // TODO necessary?
+static GLuint linkProgram(GLuint program) {
+  glLinkProgram(program);
+  return checkProgram(program);
+}
 
-  // Uniform blocks
-  int32_t blockCount;
-  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
-  lovrAssert((size_t) blockCount <= MAX_BLOCK_BUFFERS, "Shader has too many uniform blocks (%d) the max is %d", blockCount, MAX_BLOCK_BUFFERS);
-  map_init(&shader->blockMap, blockCount);
-  arr_block_t* uniformBlocks = &shader->blocks[BLOCK_UNIFORM];
-  arr_init(uniformBlocks, realloc);
-  arr_reserve(uniformBlocks, (size_t) blockCount);
-  for (int i = 0; i < blockCount; i++) {
+// Linked programs are cached in the save directory, keyed by a hash of their sources (which contain
+// the flags and singlepass defines) and the driver, since binaries are only valid for one driver.
+static uint64_t hashProgramSources(uint64_t hash, const char** sources, int* lengths, int count) {
+  for (int i = 0; i < count; i++) {
+    size_t length = lengths[i] < 0 ? strlen(sources[i]) : (size_t) lengths[i];
+    uint64_t pair[2] = { hash, hash64(sources[i], length) };
+    hash = hash64(pair, sizeof(pair));
+  }
+  return hash;
+}
+
+static bool lovrShaderLoadBinary(GLuint program, uint64_t key) {
+#if !defined(LOVR_WEBGL) && !defined(LOVR_DISABLE_FILESYSTEM)
+  if (!state.programBinaries) {
+    return false;
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "shadercache/%016llx.bin", (unsigned long long) key);
+
+  size_t size;
+  char* data = lovrFilesystemRead(path, -1, &size);
+  if (!data) {
+    return false;
+  }
+
+  // The driver is allowed to reject a binary, in which case the program gets compiled from source
+  GLint linked = 0;
+  if (size > sizeof(GLenum)) {
+    GLenum format;
+    memcpy(&format, data, sizeof(format));
+    glProgramBinary(program, format, data + sizeof(GLenum), (GLsizei) (size - sizeof(GLenum)));
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  }
+
+  free(data);
+  return linked;
+#else
+  return false;
+#endif
+}
+
+static void lovrShaderSaveBinary(GLuint program, uint64_t key) {
+#if !defined(LOVR_WEBGL) && !defined(LOVR_DISABLE_FILESYSTEM)
+  const char* saveDirectory = lovrFilesystemGetSaveDirectory();
+  if (!state.programBinaries || !saveDirectory || !*saveDirectory) {
+    return;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  // The file is the binary format followed by the binary
+  char* data = malloc(sizeof(GLenum) + length);
+  lovrAssert(data, "Out of memory");
+  GLenum format;
+  glGetProgramBinary(program, length, &length, &format, data + sizeof(GLenum));
+  memcpy(data, &format, sizeof(format));
+
+  char path[64];
+  snprintf(path, sizeof(path), "shadercache/%016llx.bin", (unsigned long long) key);
+  lovrFilesystemCreateDirectory("shadercache");
+  lovrFilesystemWrite(path, data, sizeof(GLenum) + length, false);
+  free(data);
+#endif
+}
+
+static const char* builtinUniforms[] = {
+  [BUILTIN_POSE_STRIDE] = "lovrPoseStride",
+  [BUILTIN_SDF_RANGE] = "lovrSdfRange",
+  [BUILTIN_POINT_SIZE] = "lovrPointSize",
+  [BUILTIN_LINE_WIDTH] = "lovrLineWidth",
+  [BUILTIN_VIEWPORT_SIZE] = "lovrViewportSize",
+  [BUILTIN_SKYBOX_TEXTURE] = "lovrSkyboxTexture",
+  [BUILTIN_MATERIAL_TRANSFORM] = "lovrMaterialTransform",
+  [BUILTIN_DIFFUSE_TEXTURE] = "lovrDiffuseTexture",
+  [BUILTIN_EMISSIVE_TEXTURE] = "lovrEmissiveTexture",
+  [BUILTIN_METALNESS_TEXTURE] = "lovrMetalnessTexture",
+  [BUILTIN_ROUGHNESS_TEXTURE] = "lovrRoughnessTexture",
+  [BUILTIN_OCCLUSION_TEXTURE] = "lovrOcclusionTexture",
+  [BUILTIN_NORMAL_TEXTURE] = "lovrNormalTexture"
+};
+
+static const char* builtinBlocks[] = {
+  [BUILTIN_MODEL_BLOCK] = "lovrModelBlock",
+  [BUILTIN_COLOR_BLOCK] = "lovrColorBlock",
+  [BUILTIN_FRAME_BLOCK] = "lovrFrameBlock",
+  [BUILTIN_POSE_BLOCK] = "lovrPoseBlock",
+  [BUILTIN_MATERIAL_BLOCK] = "lovrMaterialBlock",
+  [BUILTIN_LIGHT_BLOCK] = "lovrLightBlock"
+};
+
+static void lovrShaderSetupUniforms(Shader* shader) {
+  uint32_t program = shader->program;
+  lovrGpuUseProgram(program); // TODO necessary?
+
+  // Built in uniforms
+  shader->viewportCountLocation = glGetUniformLocation(program, "lovrViewportCount");
+  shader->viewIDLocation = glGetUniformLocation(program, "lovrViewID");
+  shader->viewportCount = -1;
+  shader->viewID = -1;
+
+  // Uniform blocks
+  int32_t blockCount;
+  glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+  lovrAssert((size_t) blockCount <= MAX_BLOCK_BUFFERS, "Shader has too many uniform blocks (%d) the max is %d", blockCount, MAX_BLOCK_BUFFERS);
+  map_init(&shader->blockMap, blockCount);
+  arr_block_t* uniformBlocks = &shader->blocks[BLOCK_UNIFORM];
+  arr_init(uniformBlocks, realloc);
+  arr_reserve(uniformBlocks, (size_t) blockCount);
+  for (int i = 0; i < blockCount; i++) {
     UniformBlock block = { .slot = i, .source = NULL };
     glUniformBlockBinding(program, i, block.slot);
 
@@ -2506,6 +3753,7 @@ static void lovrShaderSetupUniforms(Shader* shader) {
     uniform.textureType = getUniformTextureType(glType);
     uniform.baseSlot = uniform.type == UNIFORM_SAMPLER ? textureSlot : (uniform.type == UNIFORM_IMAGE ? imageSlot : -1);
     uniform.dirty = false;
+    uniform.contiguous = true;
 
     int blockIndex;
     glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
@@ -2574,6 +3822,7 @@ static void lovrShaderSetupUniforms(Shader* shader) {
         char name[76 /* LOVR_MAX_UNIFORM_LENGTH + 2 + 10 */];
         snprintf(name, sizeof(name), "%s[%d]", uniform.name, j);
         location = glGetUniformLocation(program, name);
+        uniform.contiguous &= location == uniform.location + j;
       }
 
       switch (uniform.type) {
@@ -2591,6 +3840,40 @@ static void lovrShaderSetupUniforms(Shader* shader) {
     textureSlot += uniform.type == UNIFORM_SAMPLER ? uniform.count : 0;
     imageSlot += uniform.type == UNIFORM_IMAGE ? uniform.count : 0;
   }
+
+  // Shaders sharing a program start with its initial uniform values, not whatever the last one set
+  size_t size = 0;
+  for (size_t i = 0; i < shader->uniforms.length; i++) {
+    Uniform* uniform = &shader->uniforms.data[i];
+    size += uniform->type == UNIFORM_SAMPLER || uniform->type == UNIFORM_IMAGE ? 0 : uniform->size;
+  }
+
+  if (!shader->shared->defaults && size > 0) {
+    shader->shared->defaults = malloc(size);
+    lovrAssert(shader->shared->defaults, "Out of memory");
+  }
+
+  char* defaults = shader->shared->defaults;
+  for (size_t i = 0; i < shader->uniforms.length; i++) {
+    Uniform* uniform = &shader->uniforms.data[i];
+    if (uniform->type != UNIFORM_SAMPLER && uniform->type != UNIFORM_IMAGE) {
+      if (shader->shared->linked) {
+        memcpy(uniform->value.data, defaults, uniform->size);
+      } else {
+        memcpy(defaults, uniform->value.data, uniform->size);
+      }
+      defaults += uniform->size;
+    }
+  }
+
+  for (int i = 0; i < MAX_BUILTIN_UNIFORMS; i++) {
+    uint64_t index = map_get(&shader->uniformMap, hash64(builtinUniforms[i], strlen(builtinUniforms[i])));
+    shader->builtins[i] = index == MAP_NIL ? -1 : (int) index;
+  }
+
+  for (int i = 0; i < MAX_BUILTIN_BLOCKS; i++) {
+    shader->builtinBlocks[i] = map_get(&shader->blockMap, hash64(builtinBlocks[i], strlen(builtinBlocks[i])));
+  }
 }
 
 static char* lovrShaderGetFlagCode(ShaderFlag* flags, uint32_t flagCount) {
@@ -2628,10 +3911,97 @@ static char* lovrShaderGetFlagCode(ShaderFlag* flags, uint32_t flagCount) {
   return code;
 }
 
-Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
+// Returns the linked program for a set of sources, or a new one to compile and link.  A program that
+// is still compiling asynchronously is finished first, and one that failed to link isn't reused.
+static Program* lovrShaderAcquireProgram(uint64_t key) {
+  uint64_t value = map_get(&state.programs, key);
+  Program* program = value == MAP_NIL ? NULL : (Program*) (uintptr_t) value;
+
+  if (program && !program->linked && program->owner && !program->owner->ready) {
+    lovrShaderFinish(program->owner);
+  }
+
+  if (program && program->linked) {
+    program->ref++;
+    return program;
+  }
+
+  program = calloc(1, sizeof(Program));
+  lovrAssert(program, "Out of memory");
+  program->ref = 1;
+  program->id = glCreateProgram();
+  program->key = key;
+  map_set(&state.programs, key, (uint64_t) (uintptr_t) program);
+  return program;
+}
+
+static void lovrShaderReleaseProgram(Shader* shader) {
+  Program* program = shader->shared;
+
+  if (program->owner == shader) {
+    program->owner = NULL;
+  }
+
+  if (--program->ref == 0) {
+    if (map_get(&state.programs, program->key) == (uint64_t) (uintptr_t) program) {
+      map_remove(&state.programs, program->key);
+    }
+    glDeleteProgram(program->id);
+    free(program->defaults);
+    free(program);
+  }
+}
+
+// Checks the results of compiling and linking a graphics shader, then does the setup that needs the
+// linked program.  With parallel compilation this waits for the driver if it isn't done yet.
+static void lovrShaderFinish(Shader* shader) {
+  GLuint program = shader->program;
+
+  if (shader->stages[0]) {
+    checkShader(shader->stages[0]);
+    checkShader(shader->stages[1]);
+    checkProgram(program);
+    for (uint32_t i = 0; i < 2; i++) {
+      glDetachShader(program, shader->stages[i]);
+      glDeleteShader(shader->stages[i]);
+      shader->stages[i] = 0;
+    }
+    lovrShaderSaveBinary(program, shader->key);
+  }
+
+  // Generic attributes
+  lovrGpuUseProgram(program);
+  glVertexAttrib4fv(LOVR_SHADER_VERTEX_COLOR, (float[4]) { 1., 1., 1., 1. });
+  glVertexAttribI4uiv(LOVR_SHADER_BONES, (uint32_t[4]) { 0., 0., 0., 0. });
+  glVertexAttrib4fv(LOVR_SHADER_BONE_WEIGHTS, (float[4]) { 1., 0., 0., 0. });
+  glVertexAttribI4ui(LOVR_SHADER_DRAW_ID, 0, 0, 0, 0);
+
+  lovrShaderSetupUniforms(shader);
+  shader->shared->linked = true;
+
+  // Attribute cache
+  int32_t attributeCount;
+  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
+  map_init(&shader->attributes, attributeCount);
+  for (int i = 0; i < attributeCount; i++) {
+    char name[LOVR_MAX_ATTRIBUTE_LENGTH];
+    GLint size;
+    GLenum type;
+    GLsizei length;
+    glGetActiveAttrib(program, i, LOVR_MAX_ATTRIBUTE_LENGTH, &length, &size, &type, name);
+    int location = glGetAttribLocation(program, name);
+    if (location >= 0) {
+      map_set(&shader->attributes, hash64(name, length), (location << 1) | isAttributeTypeInteger(type));
+    }
+  }
+
+  shader->ready = true;
+}
+
+static Shader* createGraphicsShader(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, const char* flagSource, bool multiview, bool async) {
   Shader* shader = calloc(1, sizeof(Shader));
   lovrAssert(shader, "Out of memory");
-  shader->ref = 1;
+  shader->ref = LOVR_REF_LOCAL | 1;
 
 #if defined(LOVR_WEBGL) || defined(LOVR_GLES)
   const char* version = "#version 300 es\n";
@@ -2652,6 +4022,77 @@ Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLengt
     singlepass[1] = "#extension GL_ARB_fragment_layer_viewport : require\n""#define INSTANCED_STEREO\n";
   }
 
+  const char* vertexSources[] = { version, computeExtensions, singlepass[0], flagSource ? flagSource : "", lovrShaderVertexPrefix, vertexSource, lovrShaderVertexSuffix };
+  int vertexSourceLengths[] = { -1, -1, -1, -1, -1, vertexSourceLength, -1 };
+  int vertexSourceCount = sizeof(vertexSources) / sizeof(vertexSources[0]);
+
+  const char* fragmentSources[] = { version, computeExtensions, singlepass[1], flagSource ? flagSource : "", lovrShaderFragmentPrefix, fragmentSource, lovrShaderFragmentSuffix };
+  int fragmentSourceLengths[] = { -1, -1, -1, -1, -1, fragmentSourceLength, -1 };
+  int fragmentSourceCount = sizeof(fragmentSources) / sizeof(fragmentSources[0]);
+
+  uint64_t key = hashProgramSources(state.driverHash, vertexSources, vertexSourceLengths, vertexSourceCount);
+  key = hashProgramSources(key, fragmentSources, fragmentSourceLengths, fragmentSourceCount);
+
+  shader->shared = lovrShaderAcquireProgram(key);
+  uint32_t program = shader->program = shader->shared->id;
+  shader->type = SHADER_GRAPHICS;
+  shader->multiview = multiview;
+  shader->key = key;
+
+  if (!shader->shared->linked) {
+    shader->shared->owner = shader;
+  }
+
+  if (!shader->shared->linked && !lovrShaderLoadBinary(program, key)) {
+    GLuint vertexShader = shader->stages[0] = startShader(GL_VERTEX_SHADER, vertexSources, vertexSourceLengths, vertexSourceCount);
+    GLuint fragmentShader = shader->stages[1] = startShader(GL_FRAGMENT_SHADER, fragmentSources, fragmentSourceLengths, fragmentSourceCount);
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glBindAttribLocation(program, LOVR_SHADER_POSITION, "lovrPosition");
+    glBindAttribLocation(program, LOVR_SHADER_NORMAL, "lovrNormal");
+    glBindAttribLocation(program, LOVR_SHADER_TEX_COORD, "lovrTexCoord");
+    glBindAttribLocation(program, LOVR_SHADER_VERTEX_COLOR, "lovrVertexColor");
+    glBindAttribLocation(program, LOVR_SHADER_TANGENT, "lovrTangent");
+    glBindAttribLocation(program, LOVR_SHADER_BONES, "lovrBones");
+    glBindAttribLocation(program, LOVR_SHADER_BONE_WEIGHTS, "lovrBoneWeights");
+    glBindAttribLocation(program, LOVR_SHADER_DRAW_ID, "lovrDrawID");
+#ifndef LOVR_WEBGL
+    if (state.programBinaries) {
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+#endif
+    glLinkProgram(program);
+  }
+
+  // Async shaders are finished when the driver reports completion or when they're first used
+  if (!async || !state.parallelShaderCompile) {
+    lovrShaderFinish(shader);
+  }
+
+  return shader;
+}
+
+static char* copySource(const char* source, int* length) {
+  size_t size = *length < 0 ? strlen(source) : (size_t) *length;
+  char* copy = malloc(size + 1);
+  lovrAssert(copy, "Out of memory");
+  memcpy(copy, source, size);
+  copy[size] = '\0';
+  *length = (int) size;
+  return copy;
+}
+
+// The sources are kept so the shader can be compiled for the other kind of Canvas (multiview), or
+// with a depth-only fragment shader for the depth prepass.  The Shader takes the flag source.
+static void keepShaderSources(Shader* shader, const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, char* flagSource) {
+  shader->sourceLengths[0] = vertexSourceLength;
+  shader->sourceLengths[1] = fragmentSourceLength;
+  shader->sources[0] = copySource(vertexSource, &shader->sourceLengths[0]);
+  shader->sources[1] = copySource(fragmentSource, &shader->sourceLengths[1]);
+  shader->sources[2] = flagSource;
+}
+
+Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview, bool async) {
   char* flagSource = lovrShaderGetFlagCode(flags, flagCount);
 
   if (!vertexSource) {
@@ -2664,78 +4105,121 @@ Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLengt
     fragmentSourceLength = -1;
   }
 
-  // Vertex
-  const char* vertexSources[] = { version, computeExtensions, singlepass[0], flagSource ? flagSource : "", lovrShaderVertexPrefix, vertexSource, lovrShaderVertexSuffix };
-  int vertexSourceLengths[] = { -1, -1, -1, -1, -1, vertexSourceLength, -1 };
-  int vertexSourceCount = sizeof(vertexSources) / sizeof(vertexSources[0]);
-  GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSources, vertexSourceLengths, vertexSourceCount);
+  Shader* shader = createGraphicsShader(vertexSource, vertexSourceLength, fragmentSource, fragmentSourceLength, flagSource, multiview, async);
 
-  // Fragment
-  const char* fragmentSources[] = { version, computeExtensions, singlepass[1], flagSource ? flagSource : "", lovrShaderFragmentPrefix, fragmentSource, lovrShaderFragmentSuffix };
-  int fragmentSourceLengths[] = { -1, -1, -1, -1, -1, fragmentSourceLength, -1 };
-  int fragmentSourceCount = sizeof(fragmentSources) / sizeof(fragmentSources[0]);
-  GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSources, fragmentSourceLengths, fragmentSourceCount);
+  keepShaderSources(shader, vertexSource, vertexSourceLength, fragmentSource, fragmentSourceLength, flagSource);
+  return shader;
+}
 
-  free(flagSource);
+// Returns the version of the shader to use for a Canvas.  The variant for the other multiview
+// setting is compiled the first time it's needed, and gets the uniform values and blocks of the
+// shader copied to it before each draw, so it behaves like the same Shader.
+static Shader* lovrShaderGetVariant(Shader* shader, bool multiview) {
+  if (shader->multiview == multiview || !shader->sources[0]) {
+    return shader;
+  }
 
-  // Link
-  uint32_t program = glCreateProgram();
-  glAttachShader(program, vertexShader);
-  glAttachShader(program, fragmentShader);
-  glBindAttribLocation(program, LOVR_SHADER_POSITION, "lovrPosition");
-  glBindAttribLocation(program, LOVR_SHADER_NORMAL, "lovrNormal");
-  glBindAttribLocation(program, LOVR_SHADER_TEX_COORD, "lovrTexCoord");
-  glBindAttribLocation(program, LOVR_SHADER_VERTEX_COLOR, "lovrVertexColor");
-  glBindAttribLocation(program, LOVR_SHADER_TANGENT, "lovrTangent");
-  glBindAttribLocation(program, LOVR_SHADER_BONES, "lovrBones");
-  glBindAttribLocation(program, LOVR_SHADER_BONE_WEIGHTS, "lovrBoneWeights");
-  glBindAttribLocation(program, LOVR_SHADER_DRAW_ID, "lovrDrawID");
-  linkProgram(program);
-  glDetachShader(program, vertexShader);
-  glDeleteShader(vertexShader);
-  glDetachShader(program, fragmentShader);
-  glDeleteShader(fragmentShader);
-  shader->program = program;
-  shader->type = SHADER_GRAPHICS;
+  if (!shader->ready) lovrShaderFinish(shader);
 
-  // Generic attributes
-  lovrGpuUseProgram(program);
-  glVertexAttrib4fv(LOVR_SHADER_VERTEX_COLOR, (float[4]) { 1., 1., 1., 1. });
-  glVertexAttribI4uiv(LOVR_SHADER_BONES, (uint32_t[4]) { 0., 0., 0., 0. });
-  glVertexAttrib4fv(LOVR_SHADER_BONE_WEIGHTS, (float[4]) { 1., 0., 0., 0. });
-  glVertexAttribI4ui(LOVR_SHADER_DRAW_ID, 0, 0, 0, 0);
+  if (!shader->variant) {
+    shader->variant = createGraphicsShader(shader->sources[0], shader->sourceLengths[0], shader->sources[1], shader->sourceLengths[1], shader->sources[2], multiview, false);
+  }
 
-  lovrShaderSetupUniforms(shader);
+  lovrShaderCopyState(shader, shader->variant);
+  return shader->variant;
+}
 
-  // Attribute cache
-  int32_t attributeCount;
-  glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attributeCount);
-  map_init(&shader->attributes, attributeCount);
-  for (int i = 0; i < attributeCount; i++) {
-    char name[LOVR_MAX_ATTRIBUTE_LENGTH];
-    GLint size;
-    GLenum type;
-    GLsizei length;
-    glGetActiveAttrib(program, i, LOVR_MAX_ATTRIBUTE_LENGTH, &length, &size, &type, name);
-    int location = glGetAttribLocation(program, name);
-    if (location >= 0) {
-      map_set(&shader->attributes, hash64(name, length), (location << 1) | isAttributeTypeInteger(type));
+// Returns a version of the shader that has the same vertex shader and flags but a fragment shader
+// that only does alpha cutoff, for depth-only draws.  Like multiview variants, it gets the uniform
+// values and blocks of the shader copied to it before each draw.
+static Shader* lovrShaderGetDepthVariant(Shader* shader) {
+  if (!shader->sources[0]) {
+    return shader;
+  }
+
+  if (!shader->ready) lovrShaderFinish(shader);
+
+  if (!shader->depthVariant) {
+    Shader* variant = createGraphicsShader(shader->sources[0], shader->sourceLengths[0], lovrDepthFragmentShader, -1, shader->sources[2], shader->multiview, false);
+    variant->sourceLengths[0] = shader->sourceLengths[0];
+    variant->sourceLengths[1] = -1;
+    variant->sources[0] = copySource(shader->sources[0], &variant->sourceLengths[0]);
+    variant->sources[1] = copySource(lovrDepthFragmentShader, &variant->sourceLengths[1]);
+    if (shader->sources[2]) {
+      int length = -1;
+      variant->sources[2] = copySource(shader->sources[2], &length);
     }
+    shader->depthVariant = variant;
   }
 
-  shader->multiview = multiview;
+  lovrShaderCopyState(shader, shader->depthVariant);
+  return shader->depthVariant;
+}
 
-  return shader;
+static void lovrShaderCopyState(Shader* shader, Shader* variant) {
+  for (size_t i = 0; i < shader->uniforms.length; i++) {
+    Uniform* uniform = &shader->uniforms.data[i];
+    int handle = lovrShaderGetUniformHandle(variant, uniform->name);
+    if (handle < 0) continue;
+    Uniform* other = &variant->uniforms.data[handle];
+    if (other->type == uniform->type && other->size == uniform->size && memcmp(other->value.bytes, uniform->value.bytes, uniform->size)) {
+      memcpy(other->value.bytes, uniform->value.bytes, uniform->size);
+      other->dirtyStart = 0;
+      other->dirtyEnd = other->count;
+      other->dirty = true;
+    }
+  }
+
+  for (uint32_t i = 0; i < shader->blockMap.size; i++) {
+    if (shader->blockMap.hashes[i] == MAP_NIL) continue;
+    uint64_t id = shader->blockMap.values[i];
+    uint64_t otherId = map_get(&variant->blockMap, shader->blockMap.hashes[i]);
+    if (otherId == MAP_NIL || (otherId & 1) != (id & 1)) continue;
+    UniformBlock* block = &shader->blocks[id & 1].data[id >> 1];
+    UniformBlock* other = &variant->blocks[otherId & 1].data[otherId >> 1];
+    if (other->source != block->source) {
+      lovrRetain(block->source);
+      lovrRelease(other->source, lovrBufferDestroy);
+      other->source = block->source;
+    }
+    other->access = block->access;
+    other->offset = block->offset;
+    other->size = block->size;
+  }
+}
+
+bool lovrShaderIsReady(Shader* shader) {
+  if (shader->ready) {
+    return true;
+  }
+
+#ifndef LOVR_WEBGL
+  if (shader->stages[0]) {
+    GLint complete = GL_FALSE;
+    glGetProgramiv(shader->program, GL_COMPLETION_STATUS_KHR, &complete);
+    if (!complete) {
+      return false;
+    }
+  }
+#endif
+
+  lovrShaderFinish(shader);
+  return true;
 }
 
 Shader* lovrShaderCreateDefault(DefaultShader type, ShaderFlag* flags, uint32_t flagCount, bool multiview) {
   switch (type) {
-    case SHADER_UNLIT: return lovrShaderCreateGraphics(NULL, -1, NULL, -1, flags, flagCount, multiview);
-    case SHADER_STANDARD: return lovrShaderCreateGraphics(lovrStandardVertexShader, -1, lovrStandardFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_CUBE: return lovrShaderCreateGraphics(lovrCubeVertexShader, -1, lovrCubeFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_PANO: return lovrShaderCreateGraphics(lovrCubeVertexShader, -1, lovrPanoFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_FONT: return lovrShaderCreateGraphics(NULL, -1, lovrFontFragmentShader, -1, flags, flagCount, multiview);
-    case SHADER_FILL: return lovrShaderCreateGraphics(lovrFillVertexShader, -1, NULL, -1, flags, flagCount, multiview);
+    case SHADER_UNLIT: return lovrShaderCreateGraphics(NULL, -1, NULL, -1, flags, flagCount, multiview, false);
+    case SHADER_STANDARD: return lovrShaderCreateGraphics(lovrStandardVertexShader, -1, lovrStandardFragmentShader, -1, flags, flagCount, multiview, false);
+    case SHADER_CUBE: return lovrShaderCreateGraphics(lovrCubeVertexShader, -1, lovrCubeFragmentShader, -1, flags, flagCount, multiview, false);
+    case SHADER_PANO: return lovrShaderCreateGraphics(lovrCubeVertexShader, -1, lovrPanoFragmentShader, -1, flags, flagCount, multiview, false);
+    case SHADER_FONT: return lovrShaderCreateGraphics(NULL, -1, lovrFontFragmentShader, -1, flags, flagCount, multiview, false);
+    case SHADER_FILL: return lovrShaderCreateGraphics(lovrFillVertexShader, -1, NULL, -1, flags, flagCount, multiview, false);
+    case SHADER_LINE: return lovrShaderCreateGraphics(lovrLineVertexShader, -1, NULL, -1, flags, flagCount, multiview, false);
+    case SHADER_MASK: return lovrShaderCreateGraphics(lovrMaskVertexShader, -1, NULL, -1, flags, flagCount, multiview, false);
+    case SHADER_PARTICLE: return lovrShaderCreateGraphics(lovrParticleVertexShader, -1, NULL, -1, flags, flagCount, multiview, false);
+    case SHADER_VIRTUAL: return lovrShaderCreateGraphics(NULL, -1, lovrVirtualFragmentShader, -1, flags, flagCount, multiview, false);
+    case SHADER_FEEDBACK: return lovrShaderCreateGraphics(NULL, -1, lovrFeedbackFragmentShader, -1, flags, flagCount, multiview, false);
     default: lovrThrow("Unknown default shader type"); return NULL;
   }
 }
@@ -2743,7 +4227,7 @@ Shader* lovrShaderCreateDefault(DefaultShader type, ShaderFlag* flags, uint32_t
 Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flags, uint32_t flagCount) {
   Shader* shader = calloc(1, sizeof(Shader));
   lovrAssert(shader, "Out of memory");
-  shader->ref = 1;
+  shader->ref = LOVR_REF_LOCAL | 1;
 #ifdef LOVR_WEBGL
   lovrThrow("Compute shaders are not supported on this system");
 #else
@@ -2752,16 +4236,26 @@ Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flag
   const char* sources[] = { lovrShaderComputePrefix, flagSource ? flagSource : "", source, lovrShaderComputeSuffix };
   int lengths[] = { -1, -1, length, -1 };
   int count = sizeof(sources) / sizeof(sources[0]);
-  GLuint computeShader = compileShader(GL_COMPUTE_SHADER, sources, lengths, count);
+  uint64_t key = hashProgramSources(state.driverHash, sources, lengths, count);
+  shader->shared = lovrShaderAcquireProgram(key);
+  GLuint program = shader->shared->id;
+  if (!shader->shared->linked && !lovrShaderLoadBinary(program, key)) {
+    GLuint computeShader = compileShader(GL_COMPUTE_SHADER, sources, lengths, count);
+    glAttachShader(program, computeShader);
+    if (state.programBinaries) {
+      glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    linkProgram(program);
+    glDetachShader(program, computeShader);
+    glDeleteShader(computeShader);
+    lovrShaderSaveBinary(program, key);
+  }
   free(flagSource);
-  GLuint program = glCreateProgram();
-  glAttachShader(program, computeShader);
-  linkProgram(program);
-  glDetachShader(program, computeShader);
-  glDeleteShader(computeShader);
   shader->program = program;
   shader->type = SHADER_COMPUTE;
   lovrShaderSetupUniforms(shader);
+  shader->shared->linked = true;
+  shader->ready = true;
 #endif
   return shader;
 }
@@ -2769,7 +4263,15 @@ Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flag
 void lovrShaderDestroy(void* ref) {
   Shader* shader = ref;
   lovrGraphicsFlushShader(shader);
-  glDeleteProgram(shader->program);
+  if (state.trace.active) traceForget(shader);
+  for (uint32_t i = 0; i < 2; i++) {
+    if (shader->stages[i]) {
+      glDeleteShader(shader->stages[i]);
+    }
+  }
+  if (shader->shared) {
+    lovrShaderReleaseProgram(shader);
+  }
   for (size_t i = 0; i < shader->uniforms.length; i++) {
     free(shader->uniforms.data[i].value.data);
   }
@@ -2785,6 +4287,11 @@ void lovrShaderDestroy(void* ref) {
   map_free(&shader->attributes);
   map_free(&shader->uniformMap);
   map_free(&shader->blockMap);
+  lovrRelease(shader->variant, lovrShaderDestroy);
+  lovrRelease(shader->depthVariant, lovrShaderDestroy);
+  for (uint32_t i = 0; i < 3; i++) {
+    free(shader->sources[i]);
+  }
   free(shader);
 }
 
@@ -2793,73 +4300,131 @@ ShaderType lovrShaderGetType(Shader* shader) {
 }
 
 int lovrShaderGetAttributeLocation(Shader* shader, const char* name, bool* integer) {
+  if (!shader->ready) lovrShaderFinish(shader);
   uint64_t info = map_get(&shader->attributes, hash64(name, strlen(name)));
   *integer = info & 1;
   return info == MAP_NIL ? -1 : (int) (info >> 1);
 }
 
 bool lovrShaderHasUniform(Shader* shader, const char* name) {
+  if (!shader->ready) lovrShaderFinish(shader);
   return map_get(&shader->uniformMap, hash64(name, strlen(name))) != MAP_NIL;
 }
 
 bool lovrShaderHasBlock(Shader* shader, const char* name) {
+  if (!shader->ready) lovrShaderFinish(shader);
   return map_get(&shader->blockMap, hash64(name, strlen(name))) != MAP_NIL;
 }
 
 const Uniform* lovrShaderGetUniform(Shader* shader, const char* name) {
+  if (!shader->ready) lovrShaderFinish(shader);
   uint64_t index = map_get(&shader->uniformMap, hash64(name, strlen(name)));
   return index == MAP_NIL ? NULL : &shader->uniforms.data[index];
 }
 
-static void lovrShaderSetUniform(Shader* shader, const char* name, UniformType type, void* data, int start, int count, int size, const char* debug) {
+int lovrShaderGetUniformHandle(Shader* shader, const char* name) {
+  if (!shader->ready) lovrShaderFinish(shader);
   uint64_t index = map_get(&shader->uniformMap, hash64(name, strlen(name)));
-  if (index == MAP_NIL) {
+  return index == MAP_NIL ? -1 : (int) index;
+}
+
+const Uniform* lovrShaderGetUniformByHandle(Shader* shader, int handle) {
+  if (!shader->ready) lovrShaderFinish(shader);
+  return handle >= 0 && (size_t) handle < shader->uniforms.length ? &shader->uniforms.data[handle] : NULL;
+}
+
+void lovrShaderUpdateUniform(Shader* shader, int handle, UniformType type, void* data, int start, int count) {
+  static const int sizes[] = {
+    [UNIFORM_FLOAT] = sizeof(float),
+    [UNIFORM_MATRIX] = sizeof(float),
+    [UNIFORM_INT] = sizeof(int),
+    [UNIFORM_SAMPLER] = sizeof(Texture*),
+    [UNIFORM_IMAGE] = sizeof(StorageImage)
+  };
+
+  static const char* debug[] = {
+    [UNIFORM_FLOAT] = "float",
+    [UNIFORM_MATRIX] = "float",
+    [UNIFORM_INT] = "int",
+    [UNIFORM_SAMPLER] = "texture",
+    [UNIFORM_IMAGE] = "image"
+  };
+
+  if (!shader->ready) lovrShaderFinish(shader);
+  lovrAssert(handle >= 0 && (size_t) handle < shader->uniforms.length, "Invalid uniform handle %d", handle);
+  Uniform* uniform = &shader->uniforms.data[handle];
+  int size = sizes[type];
+  lovrAssert(uniform->type == type, "Unable to send %ss to uniform %s", debug[type], uniform->name);
+  lovrAssert((start + count) * size <= uniform->size, "Too many %ss for uniform %s, maximum is %d", debug[type], uniform->name, uniform->size / size);
+
+  // Find the range of array elements that changed, so only those have to be uploaded
+  int stride = uniform->size / uniform->count;
+  int begin = start * size;
+  int end = begin + count * size;
+  int first = -1;
+  int last = -1;
+  for (int i = begin / stride; i * stride < end; i++) {
+    int a = MAX(i * stride, begin);
+    int b = MIN((i + 1) * stride, end);
+    if (memcmp(uniform->value.bytes + a, (char*) data + (a - begin), b - a)) {
+      first = first < 0 ? i : first;
+      last = i;
+    }
+  }
+
+  if (first < 0) {
     return;
   }
 
-  Uniform* uniform = &shader->uniforms.data[index];
-  lovrAssert(uniform->type == type, "Unable to send %ss to uniform %s", debug, name);
-  lovrAssert((start + count) * size <= uniform->size, "Too many %ss for uniform %s, maximum is %d", debug, name, uniform->size / size);
+  lovrGraphicsFlushShader(shader);
+  memcpy(uniform->value.bytes + begin, data, count * size);
+  uniform->dirtyStart = uniform->dirty ? MIN(uniform->dirtyStart, first) : first;
+  uniform->dirtyEnd = uniform->dirty ? MAX(uniform->dirtyEnd, last + 1) : last + 1;
+  uniform->dirty = true;
+}
 
-  void* dest = uniform->value.bytes + start * size;
-  if (memcmp(dest, data, count * size)) {
-    lovrGraphicsFlushShader(shader);
-    memcpy(dest, data, count * size);
-    uniform->dirty = true;
+void lovrShaderSetBuiltin(Shader* shader, BuiltinUniform builtin, UniformType type, void* data, int start, int count) {
+  if (!shader->ready) lovrShaderFinish(shader);
+  if (shader->builtins[builtin] >= 0) {
+    lovrShaderUpdateUniform(shader, shader->builtins[builtin], type, data, start, count);
+  }
+}
+
+static void lovrShaderSetUniform(Shader* shader, const char* name, UniformType type, void* data, int start, int count) {
+  int handle = lovrShaderGetUniformHandle(shader, name);
+  if (handle >= 0) {
+    lovrShaderUpdateUniform(shader, handle, type, data, start, count);
   }
 }
 
 void lovrShaderSetFloats(Shader* shader, const char* name, float* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_FLOAT, data, start, count, sizeof(float), "float");
+  lovrShaderSetUniform(shader, name, UNIFORM_FLOAT, data, start, count);
 }
 
 void lovrShaderSetInts(Shader* shader, const char* name, int* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_INT, data, start, count, sizeof(int), "int");
+  lovrShaderSetUniform(shader, name, UNIFORM_INT, data, start, count);
 }
 
 void lovrShaderSetMatrices(Shader* shader, const char* name, float* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_MATRIX, data, start, count, sizeof(float), "float");
+  lovrShaderSetUniform(shader, name, UNIFORM_MATRIX, data, start, count);
 }
 
 void lovrShaderSetTextures(Shader* shader, const char* name, Texture** data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_SAMPLER, data, start, count, sizeof(Texture*), "texture");
+  lovrShaderSetUniform(shader, name, UNIFORM_SAMPLER, data, start, count);
 }
 
 void lovrShaderSetImages(Shader* shader, const char* name, StorageImage* data, int start, int count) {
-  lovrShaderSetUniform(shader, name, UNIFORM_IMAGE, data, start, count, sizeof(StorageImage), "image");
+  lovrShaderSetUniform(shader, name, UNIFORM_IMAGE, data, start, count);
 }
 
 void lovrShaderSetColor(Shader* shader, const char* name, Color color) {
   color.r = lovrMathGammaToLinear(color.r);
   color.g = lovrMathGammaToLinear(color.g);
   color.b = lovrMathGammaToLinear(color.b);
-  lovrShaderSetUniform(shader, name, UNIFORM_FLOAT, (float*) &color, 0, 4, sizeof(float), "float");
+  lovrShaderSetUniform(shader, name, UNIFORM_FLOAT, (float*) &color, 0, 4);
 }
 
-void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
-  uint64_t id = map_get(&shader->blockMap, hash64(name, strlen(name)));
-  if (id == MAP_NIL) return;
-
+static void lovrShaderUpdateBlock(Shader* shader, uint64_t id, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
   int type = id & 1;
   int index = id >> 1;
   UniformBlock* block = &shader->blocks[type].data[index];
@@ -2875,6 +4440,19 @@ void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t
   }
 }
 
+void lovrShaderSetBlock(Shader* shader, const char* name, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
+  if (!shader->ready) lovrShaderFinish(shader);
+  uint64_t id = map_get(&shader->blockMap, hash64(name, strlen(name)));
+  if (id == MAP_NIL) return;
+  lovrShaderUpdateBlock(shader, id, buffer, offset, size, access);
+}
+
+void lovrShaderSetBuiltinBlock(Shader* shader, BuiltinBlock builtin, Buffer* buffer, size_t offset, size_t size, UniformAccess access) {
+  if (!shader->ready) lovrShaderFinish(shader);
+  if (shader->builtinBlocks[builtin] == MAP_NIL) return;
+  lovrShaderUpdateBlock(shader, shader->builtinBlocks[builtin], buffer, offset, size, access);
+}
+
 // ShaderBlock
 
 // Calculates uniform size and byte offsets using std140 rules, returning the total buffer size
@@ -2899,7 +4477,7 @@ size_t lovrShaderComputeUniformLayout(arr_uniform_t* uniforms) {
 ShaderBlock* lovrShaderBlockCreate(BlockType type, Buffer* buffer, arr_uniform_t* uniforms) {
   ShaderBlock* block = calloc(1, sizeof(ShaderBlock));
   lovrAssert(block, "Out of memory");
-  block->ref = 1;
+  block->ref = LOVR_REF_LOCAL | 1;
 
   arr_init(&block->uniforms, realloc);
   map_init(&block->uniformMap, (uint32_t) uniforms->length);
@@ -2914,12 +4492,23 @@ ShaderBlock* lovrShaderBlockCreate(BlockType type, Buffer* buffer, arr_uniform_t
   block->type = type;
   block->buffer = buffer;
   lovrRetain(buffer);
+
+  if (buffer->persistent) {
+    block->shadow = calloc(1, buffer->size);
+    lovrAssert(block->shadow, "Out of memory");
+    for (uint32_t i = 0; i < MAX_BUFFER_FRAMES; i++) {
+      block->staleFrom[i] = 0;
+      block->staleTo[i] = buffer->size;
+    }
+  }
+
   return block;
 }
 
 void lovrShaderBlockDestroy(void* ref) {
   ShaderBlock* block = ref;
   lovrRelease(block->buffer, lovrBufferDestroy);
+  free(block->shadow);
   arr_free(&block->uniforms);
   map_free(&block->uniformMap);
   free(block);
@@ -2989,12 +4578,47 @@ Buffer* lovrShaderBlockGetBuffer(ShaderBlock* block) {
   return block->buffer;
 }
 
+// Blocks with a persistent Buffer are written through a CPU copy.  A write moves the Buffer to its
+// next copy if the current one has been drawn with, so it never waits for the GPU unless it is more
+// than MAX_BUFFER_FRAMES copies ahead.  Each copy tracks the range that changed since it was last
+// current, and only that range is copied when it comes back around.
+void* lovrShaderBlockMap(ShaderBlock* block, size_t offset) {
+  return block->shadow ? block->shadow + offset : lovrBufferMap(block->buffer, offset, false);
+}
+
+void lovrShaderBlockFlush(ShaderBlock* block, size_t offset, size_t size) {
+  Buffer* buffer = block->buffer;
+
+  if (!block->shadow) {
+    lovrBufferFlush(buffer, offset, size);
+    return;
+  }
+
+  if (buffer->used) {
+    lovrBufferUnmap(buffer);
+    lovrBufferDiscard(buffer);
+  }
+
+  for (uint32_t i = 0; i < MAX_BUFFER_FRAMES; i++) {
+    block->staleFrom[i] = MIN(block->staleFrom[i], offset);
+    block->staleTo[i] = MAX(block->staleTo[i], offset + size);
+  }
+
+  uint32_t frame = buffer->frame;
+  size_t from = block->staleFrom[frame];
+  size_t to = block->staleTo[frame];
+  memcpy((uint8_t*) buffer->data + from, block->shadow + from, to - from);
+  lovrBufferFlush(buffer, from, to - from);
+  block->staleFrom[frame] = SIZE_MAX;
+  block->staleTo[frame] = 0;
+}
+
 // Mesh
 
 Mesh* lovrMeshCreate(DrawMode mode, Buffer* vertexBuffer, uint32_t vertexCount) {
   Mesh* mesh = calloc(1, sizeof(Mesh));
   lovrAssert(mesh, "Out of memory");
-  mesh->ref = 1;
+  mesh->ref = LOVR_REF_LOCAL | 1;
   mesh->mode = mode;
   mesh->vertexBuffer = vertexBuffer;
   mesh->vertexCount = vertexCount;
@@ -3008,6 +4632,7 @@ Mesh* lovrMeshCreate(DrawMode mode, Buffer* vertexBuffer, uint32_t vertexCount)
 void lovrMeshDestroy(void* ref) {
   Mesh* mesh = ref;
   lovrGraphicsFlushMesh(mesh);
+  if (state.trace.active) traceForget(mesh);
   glDeleteVertexArrays(1, &mesh->vao);
   for (uint32_t i = 0; i < mesh->attributeCount; i++) {
     lovrRelease(mesh->attributes[i].buffer, lovrBufferDestroy);
@@ -3121,6 +4746,22 @@ void lovrMeshSetAttributeEnabled(Mesh* mesh, const char* name, bool enable) {
   }
 }
 
+// Moves an attribute within its buffer.  The attribute's pointer is respecified on the next bind.
+void lovrMeshSetAttributeOffset(Mesh* mesh, const char* name, uint32_t offset) {
+  uint64_t hash = hash64(name, strlen(name));
+  uint64_t index = map_get(&mesh->attributeMap, hash);
+  lovrAssert(index != MAP_NIL, "Mesh does not have an attribute named '%s'", name);
+  if (mesh->attributes[index].offset != offset) {
+    lovrGraphicsFlushMesh(mesh);
+    mesh->attributes[index].offset = offset;
+    for (uint32_t i = 0; i < MAX_ATTRIBUTES; i++) {
+      if (mesh->locations[i] == index) {
+        mesh->locations[i] = 0xff;
+      }
+    }
+  }
+}
+
 DrawMode lovrMeshGetDrawMode(Mesh* mesh) {
   return mesh->mode;
 }
@@ -3150,3 +4791,875 @@ void lovrMeshSetMaterial(Mesh* mesh, Material* material) {
   lovrRelease(mesh->material, lovrMaterialDestroy);
   mesh->material = material;
 }
+
+// Trace
+
+// A trace records everything that reaches the GPU layer while it's active: objects as they're first
+// used, uploads to them, and the draws, clears, and frame boundaries, so the frames can be replayed
+// later without Lua.  Objects get ids in the order they show up.  Buffers that existed before the
+// trace are read back when they're first used (except streams, which are rewritten every frame),
+// but Textures only get the uploads that happen during the trace, since their contents don't change
+// the cost of sampling them.  Compressed Textures are replayed as RGBA ones of the same size.
+// Meshes, Canvases, and uniforms are recorded again whenever they're different from last time.
+// Compute shaders, occlusion queries, and GPU timers aren't recorded.
+
+typedef enum {
+  TRACE_BUFFER,
+  TRACE_BUFFER_DATA,
+  TRACE_BUFFER_DISCARD,
+  TRACE_TEXTURE,
+  TRACE_TEXTURE_DATA,
+  TRACE_SHADER,
+  TRACE_MESH,
+  TRACE_CANVAS,
+  TRACE_UNIFORMS,
+  TRACE_DRAW,
+  TRACE_CLEAR,
+  TRACE_DISCARD,
+  TRACE_RESOLVE,
+  TRACE_STENCIL,
+  TRACE_STENCIL_END,
+  TRACE_DESTROY,
+  TRACE_FRAME
+} TraceCommand;
+
+typedef enum {
+  TRACE_CANVAS_TEXTURES,
+  TRACE_CANVAS_WINDOW,
+  TRACE_CANVAS_EXTERNAL
+} TraceCanvasType;
+
+static void tracePut(arr_bytes_t* out, const void* data, size_t size) {
+  const uint8_t* bytes = data;
+  arr_append(out, bytes, size);
+}
+
+static void tracePut8(arr_bytes_t* out, uint8_t x) {
+  arr_push(out, x);
+}
+
+static void tracePut32(arr_bytes_t* out, uint32_t x) {
+  tracePut(out, &x, sizeof(x));
+}
+
+static void tracePut64(arr_bytes_t* out, uint64_t x) {
+  tracePut(out, &x, sizeof(x));
+}
+
+static void tracePutFloat(arr_bytes_t* out, float x) {
+  tracePut(out, &x, sizeof(x));
+}
+
+static void tracePutString(arr_bytes_t* out, const char* string, size_t length) {
+  tracePut32(out, (uint32_t) length);
+  tracePut(out, string, length);
+}
+
+static uint32_t traceFind(void* object) {
+  uint64_t id = map_get(&state.trace.ids, hash64(&object, sizeof(object)));
+  return id == MAP_NIL ? 0 : (uint32_t) id;
+}
+
+// Returns the id of an object, or 0 if it's new (in which case it gets the next id)
+static uint32_t traceAdd(void* object, uint32_t* id) {
+  uint32_t existing = traceFind(object);
+  if (existing) {
+    *id = existing;
+    return existing;
+  }
+
+  *id = ++state.trace.nextId;
+  map_set(&state.trace.ids, hash64(&object, sizeof(object)), *id);
+  return 0;
+}
+
+// Objects that can change are serialized to the scratch space, and only make it into the trace if
+// they're different from the last time they were recorded
+static void traceCommit(uint32_t id) {
+  arr_bytes_t* scratch = &state.trace.scratch;
+  uint64_t hash = hash64(scratch->data, scratch->length);
+  uint64_t key = hash64(&id, sizeof(id));
+  if (map_get(&state.trace.hashes, key) != hash) {
+    map_set(&state.trace.hashes, key, hash);
+    tracePut(&state.trace.data, scratch->data, scratch->length);
+  }
+  arr_clear(scratch);
+}
+
+static void readBuffer(Buffer* buffer, void* data) {
+#ifdef LOVR_WEBGL
+  memcpy(data, buffer->data, buffer->size);
+#else
+  if (state.amd) {
+    memcpy(data, buffer->data, buffer->size);
+    return;
+  }
+
+  GLenum glType = convertBufferType(buffer->type);
+  lovrGpuBindBuffer(buffer->type, buffer->id);
+#ifdef LOVR_GL
+  glGetBufferSubData(glType, 0, buffer->size, data);
+#else
+  void* contents = glMapBufferRange(glType, 0, buffer->size, GL_MAP_READ_BIT);
+  if (contents) {
+    memcpy(data, contents, buffer->size);
+    glUnmapBuffer(glType);
+  }
+#endif
+#endif
+}
+
+static uint32_t traceBuffer(Buffer* buffer) {
+  uint32_t id;
+  if (!buffer || traceAdd(buffer, &id)) {
+    return buffer ? id : 0;
+  }
+
+  bool snapshot = buffer->usage != USAGE_STREAM && !buffer->persistent && !buffer->mapped;
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_BUFFER);
+  tracePut32(out, id);
+  tracePut64(out, buffer->size);
+  tracePut8(out, buffer->type);
+  tracePut8(out, buffer->usage);
+  tracePut8(out, snapshot);
+  if (snapshot) {
+    arr_expand(out, buffer->size);
+    readBuffer(buffer, out->data + out->length);
+    out->length += buffer->size;
+  }
+  return id;
+}
+
+static uint32_t traceTexture(Texture* texture) {
+  uint32_t id;
+  if (!texture || traceAdd(texture, &id)) {
+    return texture ? id : 0;
+  }
+
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_TEXTURE);
+  tracePut32(out, id);
+  tracePut8(out, texture->type);
+  tracePut8(out, isTextureFormatCompressed(texture->format) ? FORMAT_RGBA : texture->format);
+  tracePut32(out, texture->allocated ? texture->width : 0);
+  tracePut32(out, texture->height);
+  tracePut32(out, texture->depth);
+  tracePut32(out, texture->msaa);
+  tracePut8(out, texture->srgb);
+  tracePut8(out, texture->mipmaps);
+  tracePut8(out, texture->filter.mode);
+  tracePutFloat(out, texture->filter.anisotropy);
+  tracePut8(out, texture->wrap.s);
+  tracePut8(out, texture->wrap.t);
+  tracePut8(out, texture->wrap.r);
+  tracePut8(out, texture->compareMode);
+  return id;
+}
+
+static uint32_t traceShader(Shader* shader) {
+  uint32_t id;
+  if (traceAdd(shader, &id)) {
+    return id;
+  }
+
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_SHADER);
+  tracePut32(out, id);
+  tracePut8(out, shader->multiview);
+  tracePutString(out, shader->sources[0], shader->sourceLengths[0]);
+  tracePutString(out, shader->sources[1], shader->sourceLengths[1]);
+  tracePutString(out, shader->sources[2], shader->sources[2] ? strlen(shader->sources[2]) : 0);
+  return id;
+}
+
+static uint32_t traceMesh(Mesh* mesh) {
+  uint32_t id;
+  traceAdd(mesh, &id);
+  uint32_t vertexBuffer = traceBuffer(mesh->vertexBuffer);
+  uint32_t indexBuffer = traceBuffer(mesh->indexBuffer);
+  arr_bytes_t* out = &state.trace.scratch;
+  tracePut8(out, TRACE_MESH);
+  tracePut32(out, id);
+  tracePut8(out, mesh->mode);
+  tracePut32(out, vertexBuffer);
+  tracePut32(out, mesh->vertexCount);
+  tracePut32(out, indexBuffer);
+  tracePut32(out, mesh->indexCount);
+  tracePut8(out, (uint8_t) mesh->indexSize);
+  tracePut64(out, mesh->indexOffset);
+  tracePut32(out, mesh->attributeCount);
+  for (uint32_t i = 0; i < mesh->attributeCount; i++) {
+    MeshAttribute* attribute = &mesh->attributes[i];
+    tracePutString(out, mesh->attributeNames[i], strlen(mesh->attributeNames[i]));
+    tracePut32(out, traceBuffer(attribute->buffer));
+    tracePut32(out, attribute->offset);
+    tracePut8(out, attribute->stride);
+    tracePut8(out, attribute->divisor);
+    tracePut8(out, attribute->type);
+    tracePut8(out, attribute->components);
+    tracePut8(out, attribute->normalized);
+    tracePut8(out, attribute->disabled);
+  }
+  traceCommit(id);
+  return id;
+}
+
+static uint32_t traceCanvas(Canvas* canvas) {
+  uint32_t id;
+  traceAdd(canvas, &id);
+  TraceCanvasType type;
+  if (canvas->attachmentCount > 0 && canvas->attachments[0].texture) {
+    type = TRACE_CANVAS_TEXTURES;
+  } else {
+    type = canvas->framebuffer == 0 ? TRACE_CANVAS_WINDOW : TRACE_CANVAS_EXTERNAL;
+  }
+
+  // Canvases are created with the width of one eye, except the window, which is replayed as is
+  bool wide = canvas->flags.stereo && state.singlepass != MULTIVIEW && type != TRACE_CANVAS_WINDOW;
+  uint32_t textures[MAX_CANVAS_ATTACHMENTS + 1] = { 0 };
+  for (uint32_t i = 0; type == TRACE_CANVAS_TEXTURES && i < canvas->attachmentCount; i++) {
+    textures[i] = traceTexture(canvas->attachments[i].texture);
+  }
+  textures[MAX_CANVAS_ATTACHMENTS] = traceTexture(canvas->externalDepth);
+
+  arr_bytes_t* out = &state.trace.scratch;
+  tracePut8(out, TRACE_CANVAS);
+  tracePut32(out, id);
+  tracePut8(out, type);
+  tracePut32(out, wide ? canvas->width / 2 : canvas->width);
+  tracePut32(out, canvas->height);
+  tracePut8(out, canvas->flags.depth.enabled);
+  tracePut8(out, canvas->flags.depth.readable);
+  tracePut8(out, canvas->flags.depth.format);
+  tracePut32(out, canvas->flags.msaa);
+  tracePut8(out, canvas->flags.stereo);
+  tracePut8(out, canvas->flags.mipmaps);
+  tracePut32(out, canvas->attachmentCount);
+  for (uint32_t i = 0; i < canvas->attachmentCount; i++) {
+    tracePut32(out, textures[i]);
+    tracePut32(out, type == TRACE_CANVAS_TEXTURES ? canvas->attachments[i].slice : 0);
+    tracePut32(out, type == TRACE_CANVAS_TEXTURES ? canvas->attachments[i].level : 0);
+  }
+  tracePut32(out, textures[MAX_CANVAS_ATTACHMENTS]);
+  traceCommit(id);
+  return id;
+}
+
+static void traceUniforms(Shader* shader, uint32_t id) {
+  arr_bytes_t* out = &state.trace.scratch;
+  tracePut8(out, TRACE_UNIFORMS);
+  tracePut32(out, id);
+  tracePut32(out, (uint32_t) shader->uniforms.length);
+  for (size_t i = 0; i < shader->uniforms.length; i++) {
+    Uniform* uniform = &shader->uniforms.data[i];
+    tracePutString(out, uniform->name, strlen(uniform->name));
+    tracePut8(out, uniform->type);
+    tracePut32(out, uniform->count);
+    switch (uniform->type) {
+      case UNIFORM_SAMPLER:
+        for (int j = 0; j < uniform->count; j++) {
+          tracePut32(out, traceTexture(uniform->value.textures[j]));
+        }
+        break;
+      case UNIFORM_IMAGE:
+        for (int j = 0; j < uniform->count; j++) {
+          StorageImage* image = &uniform->value.images[j];
+          tracePut32(out, traceTexture(image->texture));
+          tracePut32(out, image->slice);
+          tracePut32(out, image->mipmap);
+          tracePut8(out, image->access);
+        }
+        break;
+      default:
+        tracePutString(out, uniform->value.data, uniform->size);
+        break;
+    }
+  }
+
+  for (BlockType type = BLOCK_UNIFORM; type <= BLOCK_COMPUTE; type++) {
+    tracePut32(out, (uint32_t) shader->blocks[type].length);
+    for (size_t i = 0; i < shader->blocks[type].length; i++) {
+      UniformBlock* block = &shader->blocks[type].data[i];
+      tracePut32(out, traceBuffer(block->source));
+      tracePut64(out, block->offset);
+      tracePut64(out, block->size);
+      tracePut8(out, block->access);
+    }
+  }
+  traceCommit(id);
+}
+
+static void traceDraw(DrawCommand* draw) {
+  if (!draw->shader->ready) lovrShaderFinish(draw->shader);
+  uint32_t canvas = traceCanvas(draw->canvas);
+  uint32_t mesh = traceMesh(draw->mesh);
+  uint32_t shader = traceShader(draw->shader);
+  uint32_t indirect = traceBuffer(draw->indirectBuffer);
+  traceUniforms(draw->shader, shader);
+
+  Pipeline* pipeline = &draw->pipeline;
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_DRAW);
+  tracePut32(out, canvas);
+  tracePut32(out, shader);
+  tracePut32(out, mesh);
+  tracePutFloat(out, pipeline->lineWidth);
+  tracePut8(out, pipeline->alphaSampling);
+  tracePut8(out, pipeline->blendMode);
+  tracePut8(out, pipeline->blendAlphaMode);
+  tracePut8(out, pipeline->colorMask);
+  tracePut8(out, pipeline->culling);
+  tracePut8(out, pipeline->depthTest);
+  tracePut8(out, pipeline->depthWrite);
+  tracePut8(out, pipeline->stencilValue);
+  tracePut8(out, pipeline->stencilMode);
+  tracePut8(out, pipeline->winding);
+  tracePut8(out, pipeline->wireframe);
+  tracePut8(out, draw->topology);
+  tracePut32(out, draw->rangeStart);
+  tracePut32(out, draw->rangeCount);
+  tracePut32(out, draw->instances);
+  tracePut32(out, indirect);
+  tracePut64(out, draw->indirectOffset);
+  tracePut32(out, draw->indirectCount);
+  tracePut8(out, draw->depthOnly);
+}
+
+static void traceClear(Canvas* canvas, Color* color, float* depth, int* stencil) {
+  uint32_t id = traceCanvas(canvas);
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_CLEAR);
+  tracePut32(out, id);
+  tracePut8(out, (color ? 1 : 0) | (depth ? 2 : 0) | (stencil ? 4 : 0));
+  tracePut(out, color ? color : &(Color) { 0.f, 0.f, 0.f, 0.f }, sizeof(Color));
+  tracePutFloat(out, depth ? *depth : 0.f);
+  tracePut32(out, stencil ? *stencil : 0);
+}
+
+static void traceDiscard(Canvas* canvas, bool color, bool depth, bool stencil) {
+  uint32_t id = traceCanvas(canvas);
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_DISCARD);
+  tracePut32(out, id);
+  tracePut8(out, (color ? 1 : 0) | (depth ? 2 : 0) | (stencil ? 4 : 0));
+}
+
+static void traceResolve(Canvas* canvas) {
+  uint32_t id = traceCanvas(canvas);
+  tracePut8(&state.trace.data, TRACE_RESOLVE);
+  tracePut32(&state.trace.data, id);
+}
+
+static void traceStencil(StencilAction action, int replaceValue) {
+  tracePut8(&state.trace.data, TRACE_STENCIL);
+  tracePut8(&state.trace.data, action);
+  tracePut32(&state.trace.data, replaceValue);
+}
+
+static void traceStencilEnd(void) {
+  tracePut8(&state.trace.data, TRACE_STENCIL_END);
+}
+
+// Uploads to Buffers are recorded when they're unmapped, while the data is still visible
+static void traceBufferData(Buffer* buffer) {
+  uint32_t id = traceBuffer(buffer);
+  size_t size = buffer->flushTo - buffer->flushFrom;
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_BUFFER_DATA);
+  tracePut32(out, id);
+  tracePut64(out, buffer->flushFrom);
+  tracePut64(out, size);
+  tracePut(out, (uint8_t*) buffer->data + buffer->flushFrom, size);
+}
+
+static void traceBufferDiscard(Buffer* buffer) {
+  uint32_t id = traceFind(buffer);
+  if (id) {
+    tracePut8(&state.trace.data, TRACE_BUFFER_DISCARD);
+    tracePut32(&state.trace.data, id);
+  }
+}
+
+static void traceTextureData(Texture* texture, Image* image, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap) {
+  uint32_t id = traceTexture(texture);
+  arr_bytes_t* out = &state.trace.data;
+  tracePut8(out, TRACE_TEXTURE_DATA);
+  tracePut32(out, id);
+  tracePut32(out, x);
+  tracePut32(out, y);
+  tracePut32(out, slice);
+  tracePut32(out, mipmap);
+  tracePut32(out, image->width);
+  tracePut32(out, image->height);
+  tracePut8(out, image->format);
+  tracePut64(out, image->blob->size);
+  tracePut(out, image->blob->data, image->blob->size);
+}
+
+static void traceForget(void* object) {
+  uint32_t id = traceFind(object);
+  if (id) {
+    map_remove(&state.trace.ids, hash64(&object, sizeof(object)));
+    map_remove(&state.trace.hashes, hash64(&id, sizeof(id)));
+    tracePut8(&state.trace.data, TRACE_DESTROY);
+    tracePut32(&state.trace.data, id);
+  }
+}
+
+static void traceFrame(void) {
+  tracePut8(&state.trace.data, TRACE_FRAME);
+}
+
+void lovrGpuStartTrace(uint32_t width, uint32_t height) {
+  lovrAssert(!state.trace.active, "A trace is already being recorded");
+  state.trace.active = true;
+  state.trace.nextId = 0;
+  arr_init(&state.trace.data, realloc);
+  arr_init(&state.trace.scratch, realloc);
+  map_init(&state.trace.ids, 0);
+  map_init(&state.trace.hashes, 0);
+  TraceHeader header = { .magic = TRACE_MAGIC, .version = TRACE_VERSION, .width = width, .height = height };
+  tracePut(&state.trace.data, &header, sizeof(header));
+}
+
+Blob* lovrGpuStopTrace(void) {
+  lovrAssert(state.trace.active, "No trace is being recorded");
+  state.trace.active = false;
+  arr_free(&state.trace.scratch);
+  map_free(&state.trace.ids);
+  map_free(&state.trace.hashes);
+  return lovrBlobCreate(state.trace.data.data, state.trace.data.length, "Trace");
+}
+
+
+// Replay
+
+typedef struct {
+  void* object;
+  TraceCommand type;
+} ReplayObject;
+
+typedef struct {
+  const uint8_t* data;
+  size_t size;
+  size_t cursor;
+  arr_t(ReplayObject) objects;
+  void (*onFrame)(void* userdata);
+  void* userdata;
+  uint32_t frames;
+} Replay;
+
+static const void* replayGet(Replay* replay, size_t size) {
+  lovrAssert(size <= replay->size - replay->cursor, "Trace is truncated");
+  const void* p = replay->data + replay->cursor;
+  replay->cursor += size;
+  return p;
+}
+
+static uint8_t replayGet8(Replay* replay) {
+  return *(const uint8_t*) replayGet(replay, 1);
+}
+
+static uint32_t replayGet32(Replay* replay) {
+  uint32_t x;
+  memcpy(&x, replayGet(replay, sizeof(x)), sizeof(x));
+  return x;
+}
+
+static uint64_t replayGet64(Replay* replay) {
+  uint64_t x;
+  memcpy(&x, replayGet(replay, sizeof(x)), sizeof(x));
+  return x;
+}
+
+static float replayGetFloat(Replay* replay) {
+  float x;
+  memcpy(&x, replayGet(replay, sizeof(x)), sizeof(x));
+  return x;
+}
+
+// Strings aren't terminated in the trace, so they're copied to a buffer of the given size
+static void replayGetName(Replay* replay, char* name, size_t size) {
+  uint32_t length = replayGet32(replay);
+  const char* string = replayGet(replay, length);
+  lovrAssert(length < size, "Trace has a name that is too long");
+  memcpy(name, string, length);
+  name[length] = '\0';
+}
+
+static void* replayGetObject(Replay* replay, TraceCommand type) {
+  uint32_t id = replayGet32(replay);
+  if (id == 0) return NULL;
+  lovrAssert(id < replay->objects.length && replay->objects.data[id].type == type, "Trace uses object %d before recording it", id);
+  return replay->objects.data[id].object;
+}
+
+static void replayRelease(ReplayObject* object) {
+  switch (object->type) {
+    case TRACE_BUFFER: lovrRelease(object->object, lovrBufferDestroy); break;
+    case TRACE_TEXTURE: lovrRelease(object->object, lovrTextureDestroy); break;
+    case TRACE_SHADER: lovrRelease(object->object, lovrShaderDestroy); break;
+    case TRACE_MESH: lovrRelease(object->object, lovrMeshDestroy); break;
+    case TRACE_CANVAS: lovrRelease(object->object, lovrCanvasDestroy); break;
+    default: break;
+  }
+  object->object = NULL;
+}
+
+// Releases whatever the id used to refer to, unless it's the same object
+static void replaySetObject(Replay* replay, uint32_t id, TraceCommand type, void* object) {
+  while (replay->objects.length <= id) {
+    arr_push(&replay->objects, ((ReplayObject) { NULL, TRACE_DESTROY }));
+  }
+  ReplayObject* slot = &replay->objects.data[id];
+  if (slot->object != object) {
+    replayRelease(slot);
+  }
+  slot->object = object;
+  slot->type = type;
+}
+
+static void replayBuffer(Replay* replay) {
+  uint32_t id = replayGet32(replay);
+  size_t size = replayGet64(replay);
+  BufferType type = replayGet8(replay);
+  BufferUsage usage = replayGet8(replay);
+  bool snapshot = replayGet8(replay);
+  void* data = snapshot ? (void*) replayGet(replay, size) : NULL;
+  replaySetObject(replay, id, TRACE_BUFFER, lovrBufferCreate(size, data, type, usage, false));
+}
+
+static void replayBufferData(Replay* replay) {
+  Buffer* buffer = replayGetObject(replay, TRACE_BUFFER);
+  size_t offset = replayGet64(replay);
+  size_t size = replayGet64(replay);
+  const void* data = replayGet(replay, size);
+  memcpy(lovrBufferMap(buffer, offset, false), data, size);
+  lovrBufferFlush(buffer, offset, size);
+  lovrBufferUnmap(buffer);
+}
+
+static void replayTexture(Replay* replay) {
+  uint32_t id = replayGet32(replay);
+  TextureType type = replayGet8(replay);
+  TextureFormat format = replayGet8(replay);
+  uint32_t width = replayGet32(replay);
+  uint32_t height = replayGet32(replay);
+  uint32_t depth = replayGet32(replay);
+  uint32_t msaa = replayGet32(replay);
+  bool srgb = replayGet8(replay);
+  bool mipmaps = replayGet8(replay);
+  TextureFilter filter = { .mode = replayGet8(replay) };
+  filter.anisotropy = replayGetFloat(replay);
+  TextureWrap wrap = { .s = replayGet8(replay) };
+  wrap.t = replayGet8(replay);
+  wrap.r = replayGet8(replay);
+  CompareMode compareMode = replayGet8(replay);
+
+  Texture* texture = lovrTextureCreate(type, NULL, 0, srgb, mipmaps, msaa);
+  if (width > 0) {
+    lovrTextureAllocate(texture, width, height, depth, format);
+  }
+  lovrTextureSetFilter(texture, filter);
+  lovrTextureSetWrap(texture, wrap);
+  lovrTextureSetCompareMode(texture, compareMode);
+  replaySetObject(replay, id, TRACE_TEXTURE, texture);
+}
+
+static void replayTextureData(Replay* replay) {
+  Texture* texture = replayGetObject(replay, TRACE_TEXTURE);
+  uint32_t x = replayGet32(replay);
+  uint32_t y = replayGet32(replay);
+  uint32_t slice = replayGet32(replay);
+  uint32_t mipmap = replayGet32(replay);
+  uint32_t width = replayGet32(replay);
+  uint32_t height = replayGet32(replay);
+  TextureFormat format = replayGet8(replay);
+  size_t size = replayGet64(replay);
+  const void* data = replayGet(replay, size);
+  Image* image = lovrImageCreate(width, height, NULL, 0, format);
+  memcpy(image->blob->data, data, MIN(size, image->blob->size));
+  lovrTextureReplacePixels(texture, image, x, y, slice, mipmap);
+  lovrRelease(image, lovrImageDestroy);
+}
+
+static void replayShader(Replay* replay) {
+  uint32_t id = replayGet32(replay);
+  bool multiview = replayGet8(replay);
+  int vertexLength = replayGet32(replay);
+  const char* vertexSource = replayGet(replay, vertexLength);
+  int fragmentLength = replayGet32(replay);
+  const char* fragmentSource = replayGet(replay, fragmentLength);
+  int flagLength = replayGet32(replay);
+  const char* flags = replayGet(replay, flagLength);
+  char* flagSource = flagLength > 0 ? copySource(flags, &flagLength) : NULL;
+  Shader* shader = createGraphicsShader(vertexSource, vertexLength, fragmentSource, fragmentLength, flagSource, multiview, false);
+  keepShaderSources(shader, vertexSource, vertexLength, fragmentSource, fragmentLength, flagSource);
+  replaySetObject(replay, id, TRACE_SHADER, shader);
+}
+
+static void replayMesh(Replay* replay) {
+  uint32_t id = replayGet32(replay);
+  DrawMode mode = replayGet8(replay);
+  Buffer* vertexBuffer = replayGetObject(replay, TRACE_BUFFER);
+  uint32_t vertexCount = replayGet32(replay);
+  Buffer* indexBuffer = replayGetObject(replay, TRACE_BUFFER);
+  uint32_t indexCount = replayGet32(replay);
+  size_t indexSize = replayGet8(replay);
+  size_t indexOffset = replayGet64(replay);
+  Mesh* mesh = lovrMeshCreate(mode, vertexBuffer, vertexCount);
+  if (indexBuffer) {
+    lovrMeshSetIndexBuffer(mesh, indexBuffer, indexCount, indexSize, indexOffset);
+  }
+
+  uint32_t attributeCount = replayGet32(replay);
+  for (uint32_t i = 0; i < attributeCount; i++) {
+    char name[MAX_ATTRIBUTE_NAME_LENGTH];
+    replayGetName(replay, name, sizeof(name));
+    MeshAttribute attribute = { .buffer = replayGetObject(replay, TRACE_BUFFER) };
+    attribute.offset = replayGet32(replay);
+    attribute.stride = replayGet8(replay);
+    attribute.divisor = replayGet8(replay);
+    attribute.type = replayGet8(replay);
+    attribute.components = replayGet8(replay);
+    attribute.normalized = replayGet8(replay);
+    attribute.disabled = replayGet8(replay);
+    lovrMeshAttachAttribute(mesh, name, &attribute);
+  }
+
+  replaySetObject(replay, id, TRACE_MESH, mesh);
+}
+
+// Canvases are only recreated when their size or flags change, otherwise they get new attachments
+static void replayCanvas(Replay* replay) {
+  uint32_t id = replayGet32(replay);
+  TraceCanvasType type = replayGet8(replay);
+  uint32_t width = replayGet32(replay);
+  uint32_t height = replayGet32(replay);
+  CanvasFlags flags = { .depth.enabled = replayGet8(replay) };
+  flags.depth.readable = replayGet8(replay);
+  flags.depth.format = replayGet8(replay);
+  flags.msaa = replayGet32(replay);
+  flags.stereo = replayGet8(replay);
+  flags.mipmaps = replayGet8(replay);
+
+  Attachment attachments[MAX_CANVAS_ATTACHMENTS];
+  uint32_t attachmentCount = replayGet32(replay);
+  lovrAssert(attachmentCount <= MAX_CANVAS_ATTACHMENTS, "Trace has a Canvas with too many attachments");
+  for (uint32_t i = 0; i < attachmentCount; i++) {
+    attachments[i].texture = replayGetObject(replay, TRACE_TEXTURE);
+    attachments[i].slice = replayGet32(replay);
+    attachments[i].level = replayGet32(replay);
+  }
+  Texture* depthTexture = replayGetObject(replay, TRACE_TEXTURE);
+
+  Canvas* canvas = id < replay->objects.length ? replay->objects.data[id].object : NULL;
+  if (canvas) {
+    bool wide = flags.stereo && state.singlepass != MULTIVIEW && type != TRACE_CANVAS_WINDOW;
+    bool resized = canvas->width != (wide ? 2 * width : width) || canvas->height != height;
+    bool changed = canvas->flags.depth.enabled != flags.depth.enabled ||
+      canvas->flags.depth.readable != flags.depth.readable ||
+      canvas->flags.depth.format != flags.depth.format ||
+      canvas->flags.msaa != flags.msaa ||
+      canvas->flags.stereo != flags.stereo ||
+      canvas->flags.mipmaps != flags.mipmaps;
+    if (resized || changed) {
+      canvas = NULL;
+    }
+  }
+
+  if (!canvas && type == TRACE_CANVAS_WINDOW) {
+    canvas = lovrCanvasCreateFromHandle(width, height, flags, 0, 0, 0, 1, true);
+  } else if (!canvas) {
+    canvas = lovrCanvasCreate(width, height, flags);
+
+    // Headset Canvases render to textures owned by the runtime, which are replaced with regular ones
+    if (type == TRACE_CANVAS_EXTERNAL) {
+      bool multiview = flags.stereo && state.singlepass == MULTIVIEW;
+      Texture* texture = lovrTextureCreate(multiview ? TEXTURE_ARRAY : TEXTURE_2D, NULL, 0, true, false, flags.msaa);
+      lovrTextureAllocate(texture, canvas->width, height, multiview ? 2 : 1, FORMAT_RGBA);
+      lovrCanvasSetAttachments(canvas, &(Attachment) { texture, 0, 0 }, 1);
+      lovrRelease(texture, lovrTextureDestroy);
+    }
+  }
+
+  if (type == TRACE_CANVAS_TEXTURES) {
+    lovrCanvasSetAttachments(canvas, attachments, attachmentCount);
+  }
+
+  if (depthTexture || canvas->externalDepth) {
+    lovrCanvasSetDepthTexture(canvas, depthTexture);
+  }
+
+  replaySetObject(replay, id, TRACE_CANVAS, canvas);
+}
+
+// Uniforms are matched by name and blocks by index, skipping any that the Shader doesn't have
+static void replayUniforms(Replay* replay) {
+  Shader* shader = replayGetObject(replay, TRACE_SHADER);
+  uint32_t uniformCount = replayGet32(replay);
+  for (uint32_t i = 0; i < uniformCount; i++) {
+    char name[LOVR_MAX_UNIFORM_LENGTH];
+    replayGetName(replay, name, sizeof(name));
+    UniformType type = replayGet8(replay);
+    int count = replayGet32(replay);
+    int handle = lovrShaderGetUniformHandle(shader, name);
+    const Uniform* uniform = lovrShaderGetUniformByHandle(shader, handle);
+    bool valid = uniform && uniform->type == type && uniform->count == count;
+    switch (type) {
+      case UNIFORM_SAMPLER:
+        for (int j = 0; j < count; j++) {
+          Texture* texture = replayGetObject(replay, TRACE_TEXTURE);
+          if (valid) lovrShaderUpdateUniform(shader, handle, type, &texture, j, 1);
+        }
+        break;
+      case UNIFORM_IMAGE:
+        for (int j = 0; j < count; j++) {
+          StorageImage image = { .texture = replayGetObject(replay, TRACE_TEXTURE) };
+          image.slice = replayGet32(replay);
+          image.mipmap = replayGet32(replay);
+          image.access = replayGet8(replay);
+          if (valid) lovrShaderUpdateUniform(shader, handle, type, &image, j, 1);
+        }
+        break;
+      default: {
+        uint32_t size = replayGet32(replay);
+        const void* data = replayGet(replay, size);
+        if (valid && (int) size == uniform->size) {
+          lovrShaderUpdateUniform(shader, handle, type, (void*) data, 0, size / sizeof(float));
+        }
+        break;
+      }
+    }
+  }
+
+  for (BlockType type = BLOCK_UNIFORM; type <= BLOCK_COMPUTE; type++) {
+    uint32_t blockCount = replayGet32(replay);
+    for (uint32_t i = 0; i < blockCount; i++) {
+      Buffer* buffer = replayGetObject(replay, TRACE_BUFFER);
+      size_t offset = replayGet64(replay);
+      size_t size = replayGet64(replay);
+      UniformAccess access = replayGet8(replay);
+      if (buffer && i < shader->blocks[type].length) {
+        lovrShaderUpdateBlock(shader, ((uint64_t) i << 1) | type, buffer, offset, size, access);
+      }
+    }
+  }
+}
+
+static void replayDraw(Replay* replay) {
+  DrawCommand draw = { .canvas = replayGetObject(replay, TRACE_CANVAS) };
+  draw.shader = replayGetObject(replay, TRACE_SHADER);
+  draw.mesh = replayGetObject(replay, TRACE_MESH);
+  draw.pipeline.lineWidth = replayGetFloat(replay);
+  draw.pipeline.alphaSampling = replayGet8(replay);
+  draw.pipeline.blendMode = replayGet8(replay);
+  draw.pipeline.blendAlphaMode = replayGet8(replay);
+  draw.pipeline.colorMask = replayGet8(replay);
+  draw.pipeline.culling = replayGet8(replay);
+  draw.pipeline.depthTest = replayGet8(replay);
+  draw.pipeline.depthWrite = replayGet8(replay);
+  draw.pipeline.stencilValue = replayGet8(replay);
+  draw.pipeline.stencilMode = replayGet8(replay);
+  draw.pipeline.winding = replayGet8(replay);
+  draw.pipeline.wireframe = replayGet8(replay);
+  draw.topology = replayGet8(replay);
+  draw.rangeStart = replayGet32(replay);
+  draw.rangeCount = replayGet32(replay);
+  draw.instances = replayGet32(replay);
+  draw.indirectBuffer = replayGetObject(replay, TRACE_BUFFER);
+  draw.indirectOffset = replayGet64(replay);
+  draw.indirectCount = replayGet32(replay);
+  draw.depthOnly = replayGet8(replay);
+  lovrAssert(draw.canvas && draw.shader && draw.mesh, "Trace has an incomplete draw");
+  lovrGpuDraw(&draw);
+}
+
+static void replayClear(Replay* replay) {
+  Canvas* canvas = replayGetObject(replay, TRACE_CANVAS);
+  uint8_t mask = replayGet8(replay);
+  Color color;
+  memcpy(&color, replayGet(replay, sizeof(Color)), sizeof(Color));
+  float depth = replayGetFloat(replay);
+  int stencil = (int) replayGet32(replay);
+  lovrGpuClear(canvas, (mask & 1) ? &color : NULL, (mask & 2) ? &depth : NULL, (mask & 4) ? &stencil : NULL);
+}
+
+static void replayCommands(Replay* replay, bool stencil);
+
+static void replayStencil(void* userdata) {
+  replayCommands(userdata, true);
+}
+
+// Runs commands until the end of the trace, or the end of the stencil callback it's replaying
+static void replayCommands(Replay* replay, bool stencil) {
+  while (replay->cursor < replay->size) {
+    TraceCommand command = replayGet8(replay);
+    switch (command) {
+      case TRACE_BUFFER: replayBuffer(replay); break;
+      case TRACE_BUFFER_DATA: replayBufferData(replay); break;
+      case TRACE_BUFFER_DISCARD: lovrBufferDiscard(replayGetObject(replay, TRACE_BUFFER)); break;
+      case TRACE_TEXTURE: replayTexture(replay); break;
+      case TRACE_TEXTURE_DATA: replayTextureData(replay); break;
+      case TRACE_SHADER: replayShader(replay); break;
+      case TRACE_MESH: replayMesh(replay); break;
+      case TRACE_CANVAS: replayCanvas(replay); break;
+      case TRACE_UNIFORMS: replayUniforms(replay); break;
+      case TRACE_DRAW: replayDraw(replay); break;
+      case TRACE_CLEAR: replayClear(replay); break;
+      case TRACE_DISCARD: {
+        Canvas* canvas = replayGetObject(replay, TRACE_CANVAS);
+        uint8_t mask = replayGet8(replay);
+        lovrGpuDiscard(canvas, mask & 1, mask & 2, mask & 4);
+        break;
+      }
+      case TRACE_RESOLVE: lovrCanvasResolve(replayGetObject(replay, TRACE_CANVAS)); break;
+      case TRACE_STENCIL: {
+        StencilAction action = replayGet8(replay);
+        int value = (int) replayGet32(replay);
+        lovrGpuStencil(action, value, replayStencil, replay);
+        break;
+      }
+      case TRACE_STENCIL_END:
+        lovrAssert(stencil, "Trace ends a stencil that wasn't started");
+        return;
+      case TRACE_DESTROY: {
+        uint32_t id = replayGet32(replay);
+        if (id < replay->objects.length) replayRelease(&replay->objects.data[id]);
+        break;
+      }
+      case TRACE_FRAME:
+        replay->frames++;
+        if (replay->onFrame) replay->onFrame(replay->userdata);
+        break;
+      default: lovrThrow("Trace is corrupt (unknown command %d)", command);
+    }
+  }
+
+  lovrAssert(!stencil, "Trace ends in the middle of a stencil");
+}
+
+uint32_t lovrGpuReplay(const void* data, size_t size, void (*onFrame)(void* userdata), void* userdata) {
+  TraceHeader header;
+  lovrAssert(size >= sizeof(header), "Trace is truncated");
+  memcpy(&header, data, sizeof(header));
+  lovrAssert(!memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)), "File is not a trace");
+  lovrAssert(header.version == TRACE_VERSION, "Trace version %d is not supported (expected %d)", header.version, TRACE_VERSION);
+
+  Replay replay = {
+    .data = data,
+    .size = size,
+    .cursor = sizeof(header),
+    .onFrame = onFrame,
+    .userdata = userdata
+  };
+
+  arr_init(&replay.objects, realloc);
+  replayCommands(&replay, false);
+  for (size_t i = 0; i < replay.objects.length; i++) {
+    replayRelease(&replay.objects.data[i]);
+  }
+  arr_free(&replay.objects);
+  return replay.frames;
+}
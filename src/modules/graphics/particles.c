@@ -0,0 +1,219 @@
+#include "graphics/particles.h"
+#include "graphics/buffer.h"
+#include "graphics/graphics.h"
+#include "graphics/material.h"
+#include "graphics/mesh.h"
+#include "graphics/shader.h"
+#include "math/math.h"
+#include "core/maf.h"
+#include <stdlib.h>
+#include <math.h>
+
+// A ParticleSystem lives entirely on the GPU.  Each update is a compute pass that spawns, ages, and
+// moves the particles in a storage buffer and appends the live ones to an instance buffer, writing
+// the instance count into an indirect draw command.  Drawing is an indirect instanced draw of a
+// quad, so the CPU never reads the particles back.  New particles take the slots after the last
+// ones emitted, wrapping around, which replaces the oldest particles when the system is full.
+
+struct ParticleSystem {
+  uint32_t ref;
+  uint32_t capacity;
+  uint32_t head;
+  uint32_t pending;
+  uint32_t seed;
+  float accumulator;
+  ParticleSettings settings;
+  Material* material;
+  Mesh* mesh;
+  Buffer* particles;
+  Buffer* instances;
+  Buffer* unsorted;
+  Buffer* keys;
+  Buffer* command;
+  uint32_t keyCount;
+};
+
+#define PARTICLE_STRIDE (8 * sizeof(float))
+
+ParticleSystem* lovrParticleSystemCreate(uint32_t capacity) {
+  lovrAssert(lovrGraphicsGetFeatures()->compute, "ParticleSystems require compute shaders, which are not supported on this system");
+  lovrAssert(lovrGraphicsGetFeatures()->indirect, "ParticleSystems require indirect drawing, which is not supported on this system");
+  lovrAssert(capacity > 0 && capacity <= MAX_PARTICLES, "ParticleSystem capacity must be between 1 and %d", MAX_PARTICLES);
+  ParticleSystem* particles = calloc(1, sizeof(ParticleSystem));
+  lovrAssert(particles, "Out of memory");
+  particles->ref = LOVR_REF_LOCAL | 1;
+  particles->capacity = capacity;
+  particles->settings = (ParticleSettings) {
+    .direction = { 0.f, 1.f, 0.f },
+    .spread = (float) M_PI / 8.f,
+    .speed = { 1.f, 1.f },
+    .lifetime = { 1.f, 1.f },
+    .size = { .1f, .1f },
+    .colors = { { 1.f, 1.f, 1.f, 1.f }, { 1.f, 1.f, 1.f, 1.f } }
+  };
+
+  // Particles with a lifetime of zero are dead
+  void* zero = calloc(capacity, PARTICLE_STRIDE);
+  lovrAssert(zero, "Out of memory");
+  particles->particles = lovrBufferCreate(capacity * PARTICLE_STRIDE, zero, BUFFER_SHADER_STORAGE, USAGE_STATIC, false);
+  free(zero);
+
+  particles->instances = lovrBufferCreate(capacity * PARTICLE_STRIDE, NULL, BUFFER_SHADER_STORAGE, USAGE_STATIC, false);
+  particles->command = lovrBufferCreate(4 * sizeof(uint32_t), (uint32_t[4]) { 4, 0, 0, 0 }, BUFFER_INDIRECT, USAGE_STATIC, false);
+
+  float corners[8] = { 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 1.f, 0.f };
+  Buffer* quad = lovrBufferCreate(sizeof(corners), corners, BUFFER_VERTEX, USAGE_STATIC, false);
+  particles->mesh = lovrMeshCreate(DRAW_TRIANGLE_STRIP, quad, 4);
+  lovrMeshAttachAttribute(particles->mesh, "lovrTexCoord", &(MeshAttribute) { .buffer = quad, .stride = 8, .type = F32, .components = 2 });
+  lovrMeshAttachAttribute(particles->mesh, "lovrParticle", &(MeshAttribute) { .buffer = particles->instances, .offset = 0, .stride = PARTICLE_STRIDE, .type = F32, .components = 4, .divisor = 1 });
+  lovrMeshAttachAttribute(particles->mesh, "lovrVertexColor", &(MeshAttribute) { .buffer = particles->instances, .offset = 16, .stride = PARTICLE_STRIDE, .type = F32, .components = 4, .divisor = 1 });
+  lovrMeshAttachAttribute(particles->mesh, "lovrDrawID", &(MeshAttribute) { .buffer = lovrGraphicsGetIdentityBuffer(), .type = U8, .components = 1, .divisor = 1 });
+  lovrRelease(quad, lovrBufferDestroy);
+
+  return particles;
+}
+
+void lovrParticleSystemDestroy(void* ref) {
+  ParticleSystem* particles = ref;
+  lovrRelease(particles->material, lovrMaterialDestroy);
+  lovrRelease(particles->mesh, lovrMeshDestroy);
+  lovrRelease(particles->particles, lovrBufferDestroy);
+  lovrRelease(particles->instances, lovrBufferDestroy);
+  lovrRelease(particles->unsorted, lovrBufferDestroy);
+  lovrRelease(particles->keys, lovrBufferDestroy);
+  lovrRelease(particles->command, lovrBufferDestroy);
+  free(particles);
+}
+
+uint32_t lovrParticleSystemGetCapacity(ParticleSystem* particles) {
+  return particles->capacity;
+}
+
+ParticleSettings* lovrParticleSystemGetSettings(ParticleSystem* particles) {
+  return &particles->settings;
+}
+
+Material* lovrParticleSystemGetMaterial(ParticleSystem* particles) {
+  return particles->material;
+}
+
+void lovrParticleSystemSetMaterial(ParticleSystem* particles, Material* material) {
+  if (particles->material != material) {
+    lovrRetain(material);
+    lovrRelease(particles->material, lovrMaterialDestroy);
+    particles->material = material;
+  }
+}
+
+// Emitted particles are spawned during the next update
+void lovrParticleSystemEmit(ParticleSystem* particles, uint32_t count) {
+  particles->pending = MIN(particles->pending + MIN(count, particles->capacity), particles->capacity);
+}
+
+void lovrParticleSystemUpdate(ParticleSystem* particles, float dt) {
+  ParticleSettings* settings = &particles->settings;
+  Shader* shader = lovrGraphicsGetParticleShader(false);
+
+  particles->accumulator += settings->rate * dt;
+  uint32_t emitted = (uint32_t) MIN(particles->accumulator, (float) particles->capacity);
+  particles->accumulator -= emitted;
+  lovrParticleSystemEmit(particles, emitted);
+
+  // Sorted systems write to a scratch buffer that gets sorted into the instance buffer when drawn
+  if (settings->sorted && !particles->unsorted) {
+    particles->unsorted = lovrBufferCreate(particles->capacity * PARTICLE_STRIDE, NULL, BUFFER_SHADER_STORAGE, USAGE_STATIC, false);
+  }
+
+  Buffer* instances = settings->sorted ? particles->unsorted : particles->instances;
+
+  int emit[3] = { particles->head, particles->pending, particles->seed++ };
+  float emitter[4] = { settings->position[0], settings->position[1], settings->position[2], settings->radius };
+  float direction[4] = { settings->direction[0], settings->direction[1], settings->direction[2] };
+  vec3_normalize(direction);
+  direction[3] = settings->spread;
+  float ranges[4] = { settings->speed[0], settings->speed[1], settings->lifetime[0], settings->lifetime[1] };
+  float acceleration[4] = { settings->acceleration[0], settings->acceleration[1], settings->acceleration[2], settings->drag };
+  float colors[8];
+  for (uint32_t i = 0; i < 2; i++) {
+    colors[4 * i + 0] = lovrMathGammaToLinear(settings->colors[i].r);
+    colors[4 * i + 1] = lovrMathGammaToLinear(settings->colors[i].g);
+    colors[4 * i + 2] = lovrMathGammaToLinear(settings->colors[i].b);
+    colors[4 * i + 3] = settings->colors[i].a;
+  }
+
+  lovrShaderSetInts(shader, "lovrParticleEmit", emit, 0, 3);
+  lovrShaderSetFloats(shader, "lovrParticleDelta", &dt, 0, 1);
+  lovrShaderSetFloats(shader, "lovrParticleEmitter", emitter, 0, 4);
+  lovrShaderSetFloats(shader, "lovrParticleDirection", direction, 0, 4);
+  lovrShaderSetFloats(shader, "lovrParticleRanges", ranges, 0, 4);
+  lovrShaderSetFloats(shader, "lovrParticleAcceleration", acceleration, 0, 4);
+  lovrShaderSetFloats(shader, "lovrParticleSizes", settings->size, 0, 2);
+  lovrShaderSetFloats(shader, "lovrParticleColors", colors, 0, 8);
+  lovrShaderSetBlock(shader, "lovrParticles", particles->particles, 0, particles->capacity * PARTICLE_STRIDE, ACCESS_READ_WRITE);
+  lovrShaderSetBlock(shader, "lovrParticleInstances", instances, 0, particles->capacity * PARTICLE_STRIDE, ACCESS_WRITE);
+  lovrShaderSetBlock(shader, "lovrParticleCommand", particles->command, 0, 4 * sizeof(uint32_t), ACCESS_READ_WRITE);
+
+  int stage = 0;
+  lovrShaderSetInts(shader, "lovrParticleStage", &stage, 0, 1);
+  lovrGraphicsCompute(shader, 1, 1, 1);
+
+  stage = 1;
+  lovrShaderSetInts(shader, "lovrParticleStage", &stage, 0, 1);
+  lovrGraphicsCompute(shader, (particles->capacity + 63) / 64, 1, 1);
+
+  particles->head = (particles->head + particles->pending) % particles->capacity;
+  particles->pending = 0;
+}
+
+// Sorts the particles back to front from the first view's camera, with one dispatch per step of a
+// bitonic sort.  This is a lot of dispatches for big systems, so it's only done when requested.
+static void sortParticles(ParticleSystem* particles, float* transform) {
+  Shader* shader = lovrGraphicsGetParticleShader(true);
+
+  if (!particles->keys) {
+    uint32_t keyCount = 64;
+    while (keyCount < particles->capacity) keyCount <<= 1;
+    particles->keys = lovrBufferCreate(keyCount * 2 * sizeof(uint32_t), NULL, BUFFER_SHADER_STORAGE, USAGE_STATIC, false);
+    particles->keyCount = keyCount;
+  }
+
+  float camera[16];
+  float model[16];
+  lovrGraphicsGetViewMatrix(0, camera);
+  lovrGraphicsGetTransform(model);
+  if (transform) mat4_mul(model, transform);
+  mat4_invert(mat4_mul(camera, model));
+
+  uint32_t keyCount = particles->keyCount;
+  lovrShaderSetFloats(shader, "lovrParticleCamera", camera + 12, 0, 3);
+  lovrShaderSetBlock(shader, "lovrParticleCommand", particles->command, 0, 4 * sizeof(uint32_t), ACCESS_READ);
+  lovrShaderSetBlock(shader, "lovrParticleUnsorted", particles->unsorted, 0, particles->capacity * PARTICLE_STRIDE, ACCESS_READ);
+  lovrShaderSetBlock(shader, "lovrParticleInstances", particles->instances, 0, particles->capacity * PARTICLE_STRIDE, ACCESS_WRITE);
+  lovrShaderSetBlock(shader, "lovrParticleKeys", particles->keys, 0, keyCount * 2 * sizeof(uint32_t), ACCESS_READ_WRITE);
+
+  int stage = 0;
+  lovrShaderSetInts(shader, "lovrParticleStage", &stage, 0, 1);
+  lovrGraphicsCompute(shader, keyCount / 64, 1, 1);
+
+  stage = 1;
+  lovrShaderSetInts(shader, "lovrParticleStage", &stage, 0, 1);
+  for (uint32_t k = 2; k <= keyCount; k <<= 1) {
+    for (uint32_t j = k >> 1; j > 0; j >>= 1) {
+      int step[2] = { k, j };
+      lovrShaderSetInts(shader, "lovrParticleSortStep", step, 0, 2);
+      lovrGraphicsCompute(shader, keyCount / 64, 1, 1);
+    }
+  }
+
+  stage = 2;
+  lovrShaderSetInts(shader, "lovrParticleStage", &stage, 0, 1);
+  lovrGraphicsCompute(shader, keyCount / 64, 1, 1);
+}
+
+void lovrParticleSystemDraw(ParticleSystem* particles, float* transform) {
+  if (particles->settings.sorted && particles->unsorted) {
+    sortParticles(particles, transform);
+  }
+
+  lovrGraphicsDrawParticles(particles->mesh, particles->command, particles->material, transform);
+}
@@ -0,0 +1,35 @@
+#include "core/util.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+#define MAX_PARTICLES (1 << 21)
+
+struct Material;
+
+typedef struct {
+  float position[3];
+  float radius;
+  float direction[3];
+  float spread;
+  float speed[2];
+  float lifetime[2];
+  float size[2];
+  Color colors[2];
+  float acceleration[3];
+  float drag;
+  float rate;
+  bool sorted;
+} ParticleSettings;
+
+typedef struct ParticleSystem ParticleSystem;
+ParticleSystem* lovrParticleSystemCreate(uint32_t capacity);
+void lovrParticleSystemDestroy(void* ref);
+uint32_t lovrParticleSystemGetCapacity(ParticleSystem* particles);
+ParticleSettings* lovrParticleSystemGetSettings(ParticleSystem* particles);
+struct Material* lovrParticleSystemGetMaterial(ParticleSystem* particles);
+void lovrParticleSystemSetMaterial(ParticleSystem* particles, struct Material* material);
+void lovrParticleSystemEmit(ParticleSystem* particles, uint32_t count);
+void lovrParticleSystemUpdate(ParticleSystem* particles, float dt);
+void lovrParticleSystemDraw(ParticleSystem* particles, float* transform);
@@ -0,0 +1,215 @@
+#include "graphics/postProcess.h"
+#include "graphics/canvas.h"
+#include "graphics/graphics.h"
+#include "graphics/shader.h"
+#include "graphics/texture.h"
+#include "resources/shaders.h"
+#include "core/util.h"
+#include <stdlib.h>
+
+// A PostProcess applies screen space effects to a Canvas while copying it to another one.  All the
+// effects that only need the pixel they're drawing are fused into a single full screen pass, with a
+// shader variant for each set of enabled effects, so enabling more of them doesn't cost any more
+// bandwidth.  Bloom is the only effect that needs neighboring pixels, and it runs on a chain of
+// levels that start at half resolution, so its blurs only ever touch a fraction of the pixels.  The
+// levels are downsampled with a compute shader when compute is supported, which skips the render
+// passes, and upsampled with additive blending.
+
+struct PostProcess {
+  uint32_t ref;
+  uint32_t enabled;
+  PostSettings settings;
+  Shader* composites[1 << MAX_POST_EFFECTS];
+  Shader* downsample;
+  Shader* upsample;
+  Texture* levels[MAX_BLOOM_LEVELS];
+  Canvas* canvases[MAX_BLOOM_LEVELS];
+  uint32_t levelCount;
+  uint32_t width;
+  uint32_t height;
+  bool compute;
+};
+
+static const char* effectFlags[] = {
+  [POST_BLOOM] = "bloom",
+  [POST_TONEMAP] = "tonemap",
+  [POST_GRADE] = "grade",
+  [POST_VIGNETTE] = "vignette"
+};
+
+PostProcess* lovrPostProcessCreate(void) {
+  PostProcess* post = calloc(1, sizeof(PostProcess));
+  lovrAssert(post, "Out of memory");
+  post->ref = LOVR_REF_LOCAL | 1;
+  post->settings = (PostSettings) {
+    .bloom = { .threshold = 1.f, .knee = .5f, .intensity = .5f, .levels = 5 },
+    .tonemap = { .exposure = 1.f },
+    .grade = { .contrast = 1.f, .saturation = 1.f, .brightness = 0.f, .tint = { 1.f, 1.f, 1.f } },
+    .vignette = { .intensity = .5f, .radius = .5f, .softness = .5f }
+  };
+  post->compute = lovrGraphicsGetFeatures()->compute;
+  return post;
+}
+
+static void destroyLevels(PostProcess* post) {
+  for (uint32_t i = 0; i < post->levelCount; i++) {
+    lovrRelease(post->canvases[i], lovrCanvasDestroy);
+    lovrRelease(post->levels[i], lovrTextureDestroy);
+    post->canvases[i] = NULL;
+    post->levels[i] = NULL;
+  }
+  post->levelCount = 0;
+}
+
+void lovrPostProcessDestroy(void* ref) {
+  PostProcess* post = ref;
+  destroyLevels(post);
+  for (uint32_t i = 0; i < (1 << MAX_POST_EFFECTS); i++) {
+    lovrRelease(post->composites[i], lovrShaderDestroy);
+  }
+  lovrRelease(post->downsample, lovrShaderDestroy);
+  lovrRelease(post->upsample, lovrShaderDestroy);
+  free(post);
+}
+
+bool lovrPostProcessIsEffectEnabled(PostProcess* post, PostEffect effect) {
+  return post->enabled & (1u << effect);
+}
+
+void lovrPostProcessSetEffectEnabled(PostProcess* post, PostEffect effect, bool enabled) {
+  if (enabled) {
+    post->enabled |= (1u << effect);
+  } else {
+    post->enabled &= ~(1u << effect);
+  }
+}
+
+PostSettings* lovrPostProcessGetSettings(PostProcess* post) {
+  return &post->settings;
+}
+
+static Shader* getComposite(PostProcess* post) {
+  if (!post->composites[post->enabled]) {
+    ShaderFlag flags[MAX_POST_EFFECTS];
+    for (uint32_t i = 0; i < MAX_POST_EFFECTS; i++) {
+      flags[i] = (ShaderFlag) { 0, effectFlags[i], FLAG_BOOL, .value.b32 = post->enabled & (1u << i) };
+    }
+    post->composites[post->enabled] = lovrShaderCreateGraphics(lovrFillVertexShader, -1, lovrPostFragmentShader, -1, flags, MAX_POST_EFFECTS, false, false);
+  }
+  return post->composites[post->enabled];
+}
+
+// Levels are recreated when the size of the source or the number of levels changes.  Compute writes
+// to the levels as images, which needs a format that can be used for storage.
+static void updateLevels(PostProcess* post, uint32_t width, uint32_t height) {
+  uint32_t levelCount = CLAMP(post->settings.bloom.levels, 1, MAX_BLOOM_LEVELS);
+  if (post->width == width && post->height == height && post->levelCount == levelCount) {
+    return;
+  }
+
+  destroyLevels(post);
+  post->width = width;
+  post->height = height;
+  post->levelCount = levelCount;
+
+  for (uint32_t i = 0; i < levelCount; i++) {
+    uint32_t w = MAX(width >> (i + 1), 1);
+    uint32_t h = MAX(height >> (i + 1), 1);
+    post->levels[i] = lovrTextureCreate(TEXTURE_2D, NULL, 0, false, false, 0);
+    lovrTextureAllocate(post->levels[i], w, h, 1, post->compute ? FORMAT_RGBA16F : FORMAT_RG11B10F);
+    lovrTextureSetFilter(post->levels[i], (TextureFilter) { .mode = FILTER_BILINEAR });
+    lovrTextureSetWrap(post->levels[i], (TextureWrap) { .s = WRAP_CLAMP, .t = WRAP_CLAMP, .r = WRAP_CLAMP });
+    post->canvases[i] = lovrCanvasCreate(w, h, (CanvasFlags) { 0 });
+    lovrCanvasSetAttachments(post->canvases[i], &(Attachment) { post->levels[i], 0, 0 }, 1);
+  }
+}
+
+static void renderBloom(PostProcess* post, Texture* source) {
+  float threshold = post->settings.bloom.threshold;
+  float knee = MAX(post->settings.bloom.knee, 0.f);
+
+  if (!post->downsample) {
+    if (post->compute) {
+      post->downsample = lovrShaderCreateCompute(lovrBloomDownsampleComputeShader, -1, NULL, 0);
+    } else {
+      post->downsample = lovrShaderCreateGraphics(lovrFillVertexShader, -1, lovrBloomDownsampleFragmentShader, -1, NULL, 0, false, false);
+    }
+    post->upsample = lovrShaderCreateGraphics(lovrFillVertexShader, -1, lovrBloomUpsampleFragmentShader, -1, NULL, 0, false, false);
+  }
+
+  // Only the first level applies the threshold, the rest just keep halving what made it through
+  for (uint32_t i = 0; i < post->levelCount; i++) {
+    Texture* input = i == 0 ? source : post->levels[i - 1];
+    uint32_t w = lovrTextureGetWidth(post->levels[i], 0);
+    uint32_t h = lovrTextureGetHeight(post->levels[i], 0);
+    float params[4] = { i == 0 ? MAX(threshold, 0.f) : 0.f, knee, (float) w, (float) h };
+    lovrShaderSetFloats(post->downsample, "lovrBloomParams", params, 0, 4);
+
+    if (post->compute) {
+      lovrShaderSetTextures(post->downsample, "lovrBloomSource", &input, 0, 1);
+      lovrShaderSetImages(post->downsample, "lovrBloomTarget", &(StorageImage) { post->levels[i], 0, 0, ACCESS_WRITE }, 0, 1);
+      lovrGraphicsCompute(post->downsample, (w + 7) / 8, (h + 7) / 8, 1);
+    } else {
+      lovrGraphicsSetCanvas(post->canvases[i]);
+      lovrGraphicsSetShader(post->downsample);
+      lovrGraphicsSetBlendMode(BLEND_NONE, BLEND_ALPHA_MULTIPLY);
+      lovrGraphicsFill(input, 0.f, 0.f, 1.f, 1.f);
+    }
+  }
+
+  // Each level is blurred and added to the one above it, so the first level ends up with all of them
+  lovrGraphicsSetShader(post->upsample);
+  lovrGraphicsSetBlendMode(BLEND_ADD, BLEND_PREMULTIPLIED);
+  for (uint32_t i = post->levelCount - 1; i > 0; i--) {
+    lovrGraphicsSetCanvas(post->canvases[i - 1]);
+    lovrGraphicsFill(post->levels[i], 0.f, 0.f, 1.f, 1.f);
+  }
+}
+
+// The target can be NULL to draw to the current Canvas (or the window)
+void lovrPostProcessApply(PostProcess* post, Canvas* source, Canvas* target) {
+  uint32_t attachmentCount;
+  lovrCanvasResolve(source);
+  const Attachment* attachments = lovrCanvasGetAttachments(source, &attachmentCount);
+  lovrAssert(attachmentCount > 0, "PostProcess source Canvas needs a color attachment");
+  Texture* texture = attachments[0].texture;
+
+  Canvas* oldCanvas = lovrGraphicsGetCanvas();
+  target = target ? target : oldCanvas;
+  lovrAssert(target != source, "PostProcess can't draw to the Canvas it's reading from");
+
+  Shader* oldShader = lovrGraphicsGetShader();
+  BlendMode oldBlendMode;
+  BlendAlphaMode oldAlphaMode;
+  lovrRetain(oldCanvas);
+  lovrRetain(oldShader);
+  lovrGraphicsGetBlendMode(&oldBlendMode, &oldAlphaMode);
+
+  bool bloom = post->enabled & (1u << POST_BLOOM);
+  if (bloom) {
+    updateLevels(post, lovrCanvasGetWidth(source), lovrCanvasGetHeight(source));
+    renderBloom(post, texture);
+  }
+
+  Shader* shader = getComposite(post);
+  PostSettings* settings = &post->settings;
+  if (bloom) {
+    lovrShaderSetTextures(shader, "lovrBloomTexture", &post->levels[0], 0, 1);
+    lovrShaderSetFloats(shader, "lovrBloomIntensity", &settings->bloom.intensity, 0, 1);
+  }
+  lovrShaderSetFloats(shader, "lovrExposure", &settings->tonemap.exposure, 0, 1);
+  lovrShaderSetFloats(shader, "lovrGrade", (float[3]) { settings->grade.contrast, settings->grade.saturation, settings->grade.brightness }, 0, 3);
+  lovrShaderSetFloats(shader, "lovrTint", settings->grade.tint, 0, 3);
+  lovrShaderSetFloats(shader, "lovrVignette", (float[3]) { settings->vignette.intensity, settings->vignette.radius, settings->vignette.softness }, 0, 3);
+
+  lovrGraphicsSetCanvas(target);
+  lovrGraphicsSetShader(shader);
+  lovrGraphicsSetBlendMode(BLEND_NONE, BLEND_ALPHA_MULTIPLY);
+  lovrGraphicsFill(texture, 0.f, 0.f, 1.f, 1.f);
+
+  lovrGraphicsSetCanvas(oldCanvas);
+  lovrGraphicsSetShader(oldShader);
+  lovrGraphicsSetBlendMode(oldBlendMode, oldAlphaMode);
+  lovrRelease(oldCanvas, lovrCanvasDestroy);
+  lovrRelease(oldShader, lovrShaderDestroy);
+}
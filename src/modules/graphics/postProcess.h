@@ -0,0 +1,47 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+#define MAX_BLOOM_LEVELS 8
+
+struct Canvas;
+
+typedef enum {
+  POST_BLOOM,
+  POST_TONEMAP,
+  POST_GRADE,
+  POST_VIGNETTE,
+  MAX_POST_EFFECTS
+} PostEffect;
+
+typedef struct {
+  struct {
+    float threshold;
+    float knee;
+    float intensity;
+    uint32_t levels;
+  } bloom;
+  struct {
+    float exposure;
+  } tonemap;
+  struct {
+    float contrast;
+    float saturation;
+    float brightness;
+    float tint[3];
+  } grade;
+  struct {
+    float intensity;
+    float radius;
+    float softness;
+  } vignette;
+} PostSettings;
+
+typedef struct PostProcess PostProcess;
+PostProcess* lovrPostProcessCreate(void);
+void lovrPostProcessDestroy(void* ref);
+bool lovrPostProcessIsEffectEnabled(PostProcess* post, PostEffect effect);
+void lovrPostProcessSetEffectEnabled(PostProcess* post, PostEffect effect, bool enabled);
+PostSettings* lovrPostProcessGetSettings(PostProcess* post);
+void lovrPostProcessApply(PostProcess* post, struct Canvas* source, struct Canvas* target);
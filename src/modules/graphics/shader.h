@@ -56,9 +56,43 @@ typedef enum {
   SHADER_PANO,
   SHADER_FONT,
   SHADER_FILL,
+  SHADER_LINE,
+  SHADER_MASK,
+  SHADER_PARTICLE,
+  SHADER_VIRTUAL,
+  SHADER_FEEDBACK,
   MAX_DEFAULT_SHADERS
 } DefaultShader;
 
+// Uniforms and blocks that lovr sets itself on every draw.  Shaders look them up once when they're
+// created, so the draw path doesn't hash their names.
+typedef enum {
+  BUILTIN_POSE_STRIDE,
+  BUILTIN_SDF_RANGE,
+  BUILTIN_POINT_SIZE,
+  BUILTIN_LINE_WIDTH,
+  BUILTIN_VIEWPORT_SIZE,
+  BUILTIN_SKYBOX_TEXTURE,
+  BUILTIN_MATERIAL_TRANSFORM,
+  BUILTIN_DIFFUSE_TEXTURE,
+  BUILTIN_EMISSIVE_TEXTURE,
+  BUILTIN_METALNESS_TEXTURE,
+  BUILTIN_ROUGHNESS_TEXTURE,
+  BUILTIN_OCCLUSION_TEXTURE,
+  BUILTIN_NORMAL_TEXTURE,
+  MAX_BUILTIN_UNIFORMS
+} BuiltinUniform;
+
+typedef enum {
+  BUILTIN_MODEL_BLOCK,
+  BUILTIN_COLOR_BLOCK,
+  BUILTIN_FRAME_BLOCK,
+  BUILTIN_POSE_BLOCK,
+  BUILTIN_MATERIAL_BLOCK,
+  BUILTIN_LIGHT_BLOCK,
+  MAX_BUILTIN_BLOCKS
+} BuiltinBlock;
+
 typedef struct {
   struct Texture* texture;
   int slice;
@@ -87,6 +121,9 @@ typedef struct Uniform {
   bool shadow;
   bool image;
   bool dirty;
+  bool contiguous; // Whether array elements have sequential locations
+  int dirtyStart; // Range of dirty array elements
+  int dirtyEnd;
 } Uniform;
 
 typedef arr_t(Uniform) arr_uniform_t;
@@ -105,15 +142,20 @@ typedef arr_t(UniformBlock) arr_block_t;
 // Shader
 
 typedef struct Shader Shader;
-Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview);
+Shader* lovrShaderCreateGraphics(const char* vertexSource, int vertexSourceLength, const char* fragmentSource, int fragmentSourceLength, ShaderFlag* flags, uint32_t flagCount, bool multiview, bool async);
 Shader* lovrShaderCreateCompute(const char* source, int length, ShaderFlag* flags, uint32_t flagCount);
 Shader* lovrShaderCreateDefault(DefaultShader type, ShaderFlag* flags, uint32_t flagCount, bool multiview);
 void lovrShaderDestroy(void* ref);
 ShaderType lovrShaderGetType(Shader* shader);
+bool lovrShaderIsReady(Shader* shader);
 int lovrShaderGetAttributeLocation(Shader* shader, const char* name, bool* integer);
 bool lovrShaderHasUniform(Shader* shader, const char* name);
 bool lovrShaderHasBlock(Shader* shader, const char* name);
 const Uniform* lovrShaderGetUniform(Shader* shader, const char* name);
+int lovrShaderGetUniformHandle(Shader* shader, const char* name);
+const Uniform* lovrShaderGetUniformByHandle(Shader* shader, int handle);
+void lovrShaderUpdateUniform(Shader* shader, int handle, UniformType type, void* data, int start, int count);
+void lovrShaderSetBuiltin(Shader* shader, BuiltinUniform builtin, UniformType type, void* data, int start, int count);
 void lovrShaderSetFloats(Shader* shader, const char* name, float* data, int start, int count);
 void lovrShaderSetInts(Shader* shader, const char* name, int* data, int start, int count);
 void lovrShaderSetMatrices(Shader* shader, const char* name, float* data, int start, int count);
@@ -121,6 +163,7 @@ void lovrShaderSetTextures(Shader* shader, const char* name, struct Texture** da
 void lovrShaderSetImages(Shader* shader, const char* name, StorageImage* data, int start, int count);
 void lovrShaderSetColor(Shader* shader, const char* name, Color color);
 void lovrShaderSetBlock(Shader* shader, const char* name, struct Buffer* buffer, size_t offset, size_t size, UniformAccess access);
+void lovrShaderSetBuiltinBlock(Shader* shader, BuiltinBlock builtin, struct Buffer* buffer, size_t offset, size_t size, UniformAccess access);
 
 // ShaderBlock
 
@@ -133,3 +176,5 @@ BlockType lovrShaderBlockGetType(ShaderBlock* block);
 char* lovrShaderBlockGetShaderCode(ShaderBlock* block, const char* blockName, const char* namespace, size_t* length);
 const Uniform* lovrShaderBlockGetUniform(ShaderBlock* block, const char* name);
 struct Buffer* lovrShaderBlockGetBuffer(ShaderBlock* block);
+void* lovrShaderBlockMap(ShaderBlock* block, size_t offset);
+void lovrShaderBlockFlush(ShaderBlock* block, size_t offset, size_t size);
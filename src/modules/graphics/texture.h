@@ -5,6 +5,7 @@
 
 #pragma once
 
+struct Blob;
 struct Image;
 
 typedef enum {
@@ -20,11 +21,13 @@ Texture* lovrTextureCreateFromHandle(uint32_t handle, TextureType type, uint32_t
 void lovrTextureDestroy(void* ref);
 void lovrTextureAllocate(Texture* texture, uint32_t width, uint32_t height, uint32_t depth, TextureFormat format);
 void lovrTextureReplacePixels(Texture* texture, struct Image* data, uint32_t x, uint32_t y, uint32_t slice, uint32_t mipmap);
+bool lovrTextureCopy(Texture* texture, Texture* source, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 uint64_t lovrTextureGetId(Texture* texture);
 uint32_t lovrTextureGetWidth(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetHeight(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetDepth(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetMipmapCount(Texture* texture);
+void lovrTextureSetBaseMipmap(Texture* texture, uint32_t mipmap);
 uint32_t lovrTextureGetMSAA(Texture* texture);
 TextureType lovrTextureGetType(Texture* texture);
 TextureFormat lovrTextureGetFormat(Texture* texture);
@@ -34,3 +37,4 @@ TextureFilter lovrTextureGetFilter(Texture* texture);
 void lovrTextureSetFilter(Texture* texture, TextureFilter filter);
 TextureWrap lovrTextureGetWrap(Texture* texture);
 void lovrTextureSetWrap(Texture* texture, TextureWrap wrap);
+void lovrTextureSetSource(Texture* texture, struct Blob* source, bool flip);
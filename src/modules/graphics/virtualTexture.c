@@ -0,0 +1,565 @@
+#include "graphics/virtualTexture.h"
+#include "graphics/canvas.h"
+#include "graphics/graphics.h"
+#include "graphics/shader.h"
+#include "graphics/texture.h"
+#include "data/blob.h"
+#include "data/image.h"
+#include "filesystem/filesystem.h"
+#include "core/map.h"
+#include "core/util.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef LOVR_DISABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#endif
+
+// A VirtualTexture is a texture that's too big to fit in memory, split into square tiles that are
+// loaded as they're needed.  Each mipmap level of the virtual texture has its own set of tiles, and
+// the tiles are files named by a pattern with the level, x, and y (counting from the top left).
+// Resident tiles live in the pages of an atlas Texture, and a page table Texture with one texel per
+// tile (and a mipmap per level) points at the page to use for each tile.  Tiles that aren't loaded
+// point at the page of their closest loaded ancestor, and the single tile of the coarsest level is
+// always loaded, so there's always something to draw.
+//
+// Which tiles are needed is found with a feedback pass, which draws the scene at a lower resolution
+// with a shader that writes the tile each pixel wants.  It's read back asynchronously, and missing
+// tiles are loaded and decoded on a worker thread.  Tiles have a border of extra pixels around them
+// so filtering doesn't bleed into the neighboring pages.  This is done in software everywhere,
+// since sparse textures aren't available on mobile or WebGL.
+
+#define MAX_TILE_UPLOADS 8
+#define MAX_TILE_REQUESTS 32
+
+typedef struct {
+  uint32_t key;
+  uint64_t lastUse;
+} Page;
+
+typedef struct {
+  uint32_t key;
+  Image* image;
+} Tile;
+
+struct VirtualTexture {
+  uint32_t ref;
+  uint32_t width;
+  uint32_t height;
+  uint32_t tilesX;
+  uint32_t tilesY;
+  uint32_t levelCount;
+  VirtualTextureInfo info;
+  char pattern[LOVR_PATH_MAX];
+  Texture* atlas;
+  Texture* pageTable;
+  Image* tables[32];
+  uint32_t dirty;
+  Page* pages;
+  uint32_t pageCount;
+  map_t resident;
+  map_t requested;
+  Canvas* feedback;
+  Shader* feedbackShader;
+  Readback* readback;
+  Canvas* oldCanvas;
+  Shader* oldShader;
+  BlendMode oldBlendMode;
+  BlendAlphaMode oldAlphaMode;
+  uint64_t frame;
+  arr_t(uint32_t) queue;
+  arr_t(Tile) results;
+#ifndef LOVR_DISABLE_THREAD
+  thrd_t thread;
+  mtx_t lock;
+  cnd_t cond;
+  bool quit;
+#endif
+};
+
+// Keys pack the level and the tile coordinates, which are counted from the bottom left like UVs
+#define TILE_KEY(level, x, y) (((level) << 26) | ((y) << 13) | (x))
+#define TILE_LEVEL(key) ((key) >> 26)
+#define TILE_Y(key) (((key) >> 13) & 0x1fff)
+#define TILE_X(key) ((key) & 0x1fff)
+#define NO_TILE ~0u
+
+static uint64_t hashKey(uint32_t key) {
+  return hash64(&key, sizeof(key));
+}
+
+static uint32_t getTilesX(VirtualTexture* texture, uint32_t level) {
+  return MAX(texture->tilesX >> level, 1);
+}
+
+static uint32_t getTilesY(VirtualTexture* texture, uint32_t level) {
+  return MAX(texture->tilesY >> level, 1);
+}
+
+static void lock(VirtualTexture* texture) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&texture->lock);
+#endif
+}
+
+static void unlock(VirtualTexture* texture) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_unlock(&texture->lock);
+#endif
+}
+
+// Tile loading
+
+typedef struct {
+  jmp_buf catch;
+} TileJob;
+
+static void onTileError(void* userdata, const char* format, va_list args) {
+  longjmp(((TileJob*) userdata)->catch, 1);
+}
+
+// Reads and decodes a tile, returning NULL if it's missing or can't be decoded.  Errors are caught,
+// since this usually runs on the worker thread.
+static Image* loadTile(VirtualTexture* texture, uint32_t key) {
+  char path[LOVR_PATH_MAX];
+  uint32_t level = TILE_LEVEL(key);
+  uint32_t x = TILE_X(key);
+  uint32_t y = getTilesY(texture, level) - 1 - TILE_Y(key);
+  if (snprintf(path, sizeof(path), texture->pattern, level, x, y) >= (int) sizeof(path)) {
+    return NULL;
+  }
+
+  size_t size;
+  void* data = lovrFilesystemRead(path, -1, &size);
+  if (!data) {
+    return NULL;
+  }
+
+  TileJob job;
+  Image* image = NULL;
+  Blob* blob = lovrBlobCreate(data, size, path);
+  errorFn* callback = lovrErrorCallback;
+  void* userdata = lovrErrorUserdata;
+  lovrSetErrorCallback(onTileError, &job);
+  if (!setjmp(job.catch)) {
+    image = lovrImageCreateFromBlob(blob, true);
+  }
+  lovrSetErrorCallback(callback, userdata);
+  lovrRelease(blob, lovrBlobDestroy);
+  return image;
+}
+
+#ifndef LOVR_DISABLE_THREAD
+static int tileLoop(void* arg) {
+  VirtualTexture* texture = arg;
+  mtx_lock(&texture->lock);
+  for (;;) {
+    while (!texture->quit && texture->queue.length == 0) {
+      cnd_wait(&texture->cond, &texture->lock);
+    }
+
+    if (texture->quit) {
+      break;
+    }
+
+    uint32_t key = texture->queue.data[0];
+    arr_splice(&texture->queue, 0, 1);
+    mtx_unlock(&texture->lock);
+    Image* image = loadTile(texture, key);
+    mtx_lock(&texture->lock);
+    arr_push(&texture->results, ((Tile) { key, image }));
+  }
+  mtx_unlock(&texture->lock);
+  return 0;
+}
+#endif
+
+// Page table
+
+static uint8_t* getEntry(VirtualTexture* texture, uint32_t level, uint32_t x, uint32_t y) {
+  return (uint8_t*) texture->tables[level]->blob->data + 4 * (y * getTilesX(texture, level) + x);
+}
+
+// Points the entries covered by a tile at a page, for the tile's level and all the finer ones.  If
+// replace is set, only entries using the old tile in that page change, otherwise only entries that
+// are using a coarser tile change.
+static void setEntries(VirtualTexture* texture, uint32_t key, const uint8_t entry[4], bool replace, uint32_t page) {
+  uint32_t level = TILE_LEVEL(key);
+  uint8_t pageX = (uint8_t) (page % texture->info.pages);
+  uint8_t pageY = (uint8_t) (page / texture->info.pages);
+
+  for (uint32_t l = 0; l <= level; l++) {
+    uint32_t shift = level - l;
+    uint32_t x0 = TILE_X(key) << shift, x1 = MIN((TILE_X(key) + 1) << shift, getTilesX(texture, l));
+    uint32_t y0 = TILE_Y(key) << shift, y1 = MIN((TILE_Y(key) + 1) << shift, getTilesY(texture, l));
+    for (uint32_t y = y0; y < y1; y++) {
+      for (uint32_t x = x0; x < x1; x++) {
+        uint8_t* e = getEntry(texture, l, x, y);
+        bool match = replace ? (e[2] == level && e[0] == pageX && e[1] == pageY) : e[2] >= level;
+        if (match) {
+          memcpy(e, entry, 4);
+        }
+      }
+    }
+    texture->dirty |= 1u << l;
+  }
+}
+
+static void addTile(VirtualTexture* texture, uint32_t key, uint32_t page, Image* image) {
+  uint32_t size = texture->info.tileSize + 2 * texture->info.border;
+  uint32_t pageX = page % texture->info.pages;
+  uint32_t pageY = page / texture->info.pages;
+  lovrTextureReplacePixels(texture->atlas, image, pageX * size, pageY * size, 0, 0);
+  texture->pages[page].key = key;
+  texture->pages[page].lastUse = texture->frame;
+  map_set(&texture->resident, hashKey(key), page);
+  uint8_t entry[4] = { (uint8_t) pageX, (uint8_t) pageY, (uint8_t) TILE_LEVEL(key), 255 };
+  setEntries(texture, key, entry, false, page);
+}
+
+// Entries that used the tile fall back to whatever its parent's entry uses
+static void removeTile(VirtualTexture* texture, uint32_t page) {
+  uint32_t key = texture->pages[page].key;
+  uint32_t level = TILE_LEVEL(key);
+  uint8_t entry[4];
+  memcpy(entry, getEntry(texture, level + 1, TILE_X(key) >> 1, TILE_Y(key) >> 1), 4);
+  setEntries(texture, key, entry, true, page);
+  map_remove(&texture->resident, hashKey(key));
+  map_remove(&texture->requested, hashKey(key));
+  texture->pages[page].key = NO_TILE;
+}
+
+// Free pages first, then the least recently used one that wasn't needed by the latest feedback.
+// Page 0 has the coarsest tile and is never evicted.
+static uint32_t findPage(VirtualTexture* texture) {
+  uint32_t best = NO_TILE;
+  for (uint32_t i = 1; i < texture->pageCount; i++) {
+    Page* page = &texture->pages[i];
+    if (page->key == NO_TILE) {
+      return i;
+    } else if (page->lastUse < texture->frame && (best == NO_TILE || page->lastUse < texture->pages[best].lastUse)) {
+      best = i;
+    }
+  }
+
+  if (best != NO_TILE) {
+    removeTile(texture, best);
+  }
+
+  return best;
+}
+
+static void uploadPageTable(VirtualTexture* texture) {
+  if (!texture->dirty) {
+    return;
+  }
+
+  // Replacing the first mipmap regenerates the others, so they all have to be uploaded after it
+  if (texture->dirty & 1) {
+    texture->dirty = (1u << texture->levelCount) - 1;
+  }
+
+  for (uint32_t i = 0; i < texture->levelCount; i++) {
+    if (texture->dirty & (1u << i)) {
+      lovrTextureReplacePixels(texture->pageTable, texture->tables[i], 0, 0, 0, i);
+    }
+  }
+
+  texture->dirty = 0;
+}
+
+// Feedback
+
+static int compareLevels(const void* a, const void* b) {
+  return (int) TILE_LEVEL(*(const uint32_t*) b) - (int) TILE_LEVEL(*(const uint32_t*) a);
+}
+
+// Marks the resident tiles in the feedback as used and queues the missing ones, coarsest first.  The
+// queue is replaced, since tiles requested by older feedback might not be needed anymore.
+static void readFeedback(VirtualTexture* texture, Image* image) {
+  uint32_t requests[MAX_TILE_REQUESTS];
+  uint32_t requestCount = 0;
+  uint32_t lastKey = NO_TILE;
+
+  const uint8_t* pixels = image->blob->data;
+  for (uint32_t i = 0; i < image->width * image->height; i++) {
+    const uint8_t* p = pixels + 4 * i;
+    if (p[3] == 0 || p[3] > texture->levelCount) {
+      continue;
+    }
+
+    uint32_t level = p[3] - 1;
+    uint32_t x = p[0] | ((p[2] & 0xf) << 8);
+    uint32_t y = p[1] | ((p[2] >> 4) << 8);
+    uint32_t key = TILE_KEY(level, x, y);
+    if (key == lastKey || x >= getTilesX(texture, level) || y >= getTilesY(texture, level)) {
+      continue;
+    }
+
+    lastKey = key;
+    uint64_t page = map_get(&texture->resident, hashKey(key));
+    if (page != MAP_NIL) {
+      texture->pages[page].lastUse = texture->frame;
+    } else if (map_get(&texture->requested, hashKey(key)) == MAP_NIL && requestCount < MAX_TILE_REQUESTS) {
+      map_set(&texture->requested, hashKey(key), 0);
+      requests[requestCount++] = key;
+    }
+  }
+
+  qsort(requests, requestCount, sizeof(uint32_t), compareLevels);
+
+  lock(texture);
+  for (size_t i = 0; i < texture->queue.length; i++) {
+    map_remove(&texture->requested, hashKey(texture->queue.data[i]));
+  }
+  arr_clear(&texture->queue);
+  arr_append(&texture->queue, requests, requestCount);
+#ifndef LOVR_DISABLE_THREAD
+  cnd_signal(&texture->cond);
+#endif
+  unlock(texture);
+}
+
+// Base
+
+VirtualTexture* lovrVirtualTextureCreate(uint32_t width, uint32_t height, const char* pattern, VirtualTextureInfo* info) {
+  uint32_t tileSize = info->tileSize;
+  lovrAssert(tileSize > 0 && width % tileSize == 0 && height % tileSize == 0, "VirtualTexture size must be a multiple of its tile size");
+  uint32_t tilesX = width / tileSize;
+  uint32_t tilesY = height / tileSize;
+  lovrAssert(!(tilesX & (tilesX - 1)) && !(tilesY & (tilesY - 1)), "VirtualTexture tile counts must be powers of two");
+  lovrAssert(tilesX <= MAX_VIRTUAL_TILES && tilesY <= MAX_VIRTUAL_TILES, "VirtualTexture can have at most %d tiles in each direction", MAX_VIRTUAL_TILES);
+  lovrAssert(info->pages >= 2 && info->pages <= 255, "VirtualTexture page count must be between 2 and 255");
+  lovrAssert(info->feedbackScale > 0, "VirtualTexture feedback scale must be positive");
+
+  // The pattern is used as a format string, so it can only have the three integer conversions
+  uint32_t conversions = 0;
+  for (const char* c = pattern; *c; c++) {
+    if (c[0] == '%') {
+      lovrAssert(c[1] == 'd' || c[1] == '%', "VirtualTexture pattern can only contain %%d and %%%%");
+      conversions += c[1] == 'd';
+      c++;
+    }
+  }
+  lovrAssert(conversions == 3, "VirtualTexture pattern needs 3 %%d for the level, x, and y of a tile");
+  lovrAssert(strlen(pattern) < LOVR_PATH_MAX, "VirtualTexture pattern is too long");
+
+  VirtualTexture* texture = calloc(1, sizeof(VirtualTexture));
+  lovrAssert(texture, "Out of memory");
+  texture->ref = LOVR_REF_LOCAL | 1;
+  texture->width = width;
+  texture->height = height;
+  texture->tilesX = tilesX;
+  texture->tilesY = tilesY;
+  texture->levelCount = (uint32_t) log2(MAX(tilesX, tilesY)) + 1;
+  texture->info = *info;
+  strcpy(texture->pattern, pattern);
+  map_init(&texture->resident, 0);
+  map_init(&texture->requested, 0);
+  arr_init(&texture->queue, realloc);
+  arr_init(&texture->results, realloc);
+
+  uint32_t pageSize = tileSize + 2 * info->border;
+  texture->atlas = lovrTextureCreate(TEXTURE_2D, NULL, 0, true, false, 0);
+  lovrTextureAllocate(texture->atlas, info->pages * pageSize, info->pages * pageSize, 1, FORMAT_RGBA);
+  lovrTextureSetFilter(texture->atlas, (TextureFilter) { .mode = FILTER_BILINEAR });
+  lovrTextureSetWrap(texture->atlas, (TextureWrap) { .s = WRAP_CLAMP, .t = WRAP_CLAMP, .r = WRAP_CLAMP });
+
+  texture->pageTable = lovrTextureCreate(TEXTURE_2D, NULL, 0, false, true, 0);
+  lovrTextureAllocate(texture->pageTable, tilesX, tilesY, 1, FORMAT_RGBA);
+  lovrTextureSetFilter(texture->pageTable, (TextureFilter) { .mode = FILTER_NEAREST });
+
+  texture->pageCount = info->pages * info->pages;
+  texture->pages = malloc(texture->pageCount * sizeof(Page));
+  lovrAssert(texture->pages, "Out of memory");
+  for (uint32_t i = 0; i < texture->pageCount; i++) {
+    texture->pages[i] = (Page) { .key = NO_TILE };
+  }
+
+  // Everything starts out using the coarsest tile, which gets loaded right away
+  uint32_t root = TILE_KEY(texture->levelCount - 1, 0, 0);
+  for (uint32_t i = 0; i < texture->levelCount; i++) {
+    texture->tables[i] = lovrImageCreate(getTilesX(texture, i), getTilesY(texture, i), NULL, 0, FORMAT_RGBA);
+    uint8_t* entries = texture->tables[i]->blob->data;
+    for (uint32_t j = 0; j < getTilesX(texture, i) * getTilesY(texture, i); j++) {
+      memcpy(entries + 4 * j, (uint8_t[4]) { 0, 0, (uint8_t) TILE_LEVEL(root), 255 }, 4);
+    }
+  }
+
+  Image* image = loadTile(texture, root);
+  lovrAssert(image, "Could not load the coarsest tile of VirtualTexture '%s'", pattern);
+  lovrAssert(image->width == pageSize && image->height == pageSize && image->format == FORMAT_RGBA, "VirtualTexture tiles must be %dx%d RGBA images", pageSize, pageSize);
+  addTile(texture, root, 0, image);
+  lovrRelease(image, lovrImageDestroy);
+  texture->dirty = (1u << texture->levelCount) - 1;
+  uploadPageTable(texture);
+
+  uint32_t feedbackWidth = MAX((uint32_t) lovrGraphicsGetWidth() / info->feedbackScale, 1);
+  uint32_t feedbackHeight = MAX((uint32_t) lovrGraphicsGetHeight() / info->feedbackScale, 1);
+  Texture* target = lovrTextureCreate(TEXTURE_2D, NULL, 0, false, false, 0);
+  lovrTextureAllocate(target, feedbackWidth, feedbackHeight, 1, FORMAT_RGBA);
+  lovrTextureSetFilter(target, (TextureFilter) { .mode = FILTER_NEAREST });
+  CanvasFlags flags = { .depth.enabled = true, .depth.format = FORMAT_D16 };
+  texture->feedback = lovrCanvasCreate(feedbackWidth, feedbackHeight, flags);
+  lovrCanvasSetAttachments(texture->feedback, &(Attachment) { target, 0, 0 }, 1);
+  lovrRelease(target, lovrTextureDestroy);
+  texture->feedbackShader = lovrShaderCreateDefault(SHADER_FEEDBACK, NULL, 0, false);
+
+#ifndef LOVR_DISABLE_THREAD
+  lovrAssert(mtx_init(&texture->lock, mtx_plain) == thrd_success, "Failed to create VirtualTexture lock");
+  lovrAssert(cnd_init(&texture->cond) == thrd_success, "Failed to create VirtualTexture condition variable");
+  lovrAssert(thrd_create(&texture->thread, tileLoop, texture) == thrd_success, "Failed to create VirtualTexture thread");
+#endif
+
+  return texture;
+}
+
+void lovrVirtualTextureDestroy(void* ref) {
+  VirtualTexture* texture = ref;
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&texture->lock);
+  texture->quit = true;
+  cnd_signal(&texture->cond);
+  mtx_unlock(&texture->lock);
+  thrd_join(texture->thread, NULL);
+  cnd_destroy(&texture->cond);
+  mtx_destroy(&texture->lock);
+#endif
+  for (size_t i = 0; i < texture->results.length; i++) {
+    lovrRelease(texture->results.data[i].image, lovrImageDestroy);
+  }
+  arr_free(&texture->results);
+  arr_free(&texture->queue);
+  for (uint32_t i = 0; i < texture->levelCount; i++) {
+    lovrRelease(texture->tables[i], lovrImageDestroy);
+  }
+  lovrRelease(texture->atlas, lovrTextureDestroy);
+  lovrRelease(texture->pageTable, lovrTextureDestroy);
+  lovrRelease(texture->feedback, lovrCanvasDestroy);
+  lovrRelease(texture->feedbackShader, lovrShaderDestroy);
+  lovrRelease(texture->readback, lovrReadbackDestroy);
+  map_free(&texture->resident);
+  map_free(&texture->requested);
+  free(texture->pages);
+  free(texture);
+}
+
+uint32_t lovrVirtualTextureGetWidth(VirtualTexture* texture) {
+  return texture->width;
+}
+
+uint32_t lovrVirtualTextureGetHeight(VirtualTexture* texture) {
+  return texture->height;
+}
+
+const VirtualTextureInfo* lovrVirtualTextureGetInfo(VirtualTexture* texture) {
+  return &texture->info;
+}
+
+Texture* lovrVirtualTextureGetAtlas(VirtualTexture* texture) {
+  return texture->atlas;
+}
+
+Texture* lovrVirtualTextureGetPageTable(VirtualTexture* texture) {
+  return texture->pageTable;
+}
+
+Canvas* lovrVirtualTextureGetFeedbackCanvas(VirtualTexture* texture) {
+  return texture->feedback;
+}
+
+static void bindUniforms(VirtualTexture* texture, Shader* shader, float bias) {
+  float size[4] = { (float) texture->width, (float) texture->height, (float) texture->levelCount, bias };
+  float pages[4] = { (float) texture->info.tileSize, (float) texture->info.border, (float) texture->info.pages, 0.f };
+  lovrShaderSetTextures(shader, "lovrPageTable", &texture->pageTable, 0, 1);
+  lovrShaderSetTextures(shader, "lovrPageAtlas", &texture->atlas, 0, 1);
+  lovrShaderSetFloats(shader, "lovrVirtualSize", size, 0, 4);
+  lovrShaderSetFloats(shader, "lovrVirtualPages", pages, 0, 4);
+}
+
+// Draws between Begin and End go to the feedback Canvas with the feedback shader.  The feedback is
+// smaller than the screen, so its mipmap levels are biased to match what the screen will want.
+void lovrVirtualTextureBeginFeedback(VirtualTexture* texture) {
+  texture->oldCanvas = lovrGraphicsGetCanvas();
+  texture->oldShader = lovrGraphicsGetShader();
+  lovrRetain(texture->oldCanvas);
+  lovrRetain(texture->oldShader);
+  lovrGraphicsGetBlendMode(&texture->oldBlendMode, &texture->oldAlphaMode);
+
+  bindUniforms(texture, texture->feedbackShader, -log2f((float) texture->info.feedbackScale));
+  lovrGraphicsSetCanvas(texture->feedback);
+  lovrGraphicsSetShader(texture->feedbackShader);
+  lovrGraphicsSetBlendMode(BLEND_NONE, BLEND_ALPHA_MULTIPLY);
+  lovrGraphicsClear(&(Color) { 0.f, 0.f, 0.f, 0.f }, &(float) { 1.f }, NULL);
+}
+
+// Only one readback is in flight at a time, so feedback drawn while one is pending is skipped
+void lovrVirtualTextureEndFeedback(VirtualTexture* texture) {
+  lovrGraphicsSetCanvas(texture->oldCanvas);
+  lovrGraphicsSetShader(texture->oldShader);
+  lovrGraphicsSetBlendMode(texture->oldBlendMode, texture->oldAlphaMode);
+  lovrRelease(texture->oldCanvas, lovrCanvasDestroy);
+  lovrRelease(texture->oldShader, lovrShaderDestroy);
+  texture->oldCanvas = NULL;
+  texture->oldShader = NULL;
+
+  if (!texture->readback) {
+    texture->readback = lovrReadbackCreate(texture->feedback, 0);
+  }
+}
+
+// Reads finished feedback, then uploads some of the tiles that finished loading
+void lovrVirtualTextureUpdate(VirtualTexture* texture) {
+  texture->frame++;
+
+  if (texture->readback && lovrReadbackIsReady(texture->readback)) {
+    readFeedback(texture, lovrReadbackGetImage(texture->readback));
+    lovrRelease(texture->readback, lovrReadbackDestroy);
+    texture->readback = NULL;
+  }
+
+#ifdef LOVR_DISABLE_THREAD
+  for (uint32_t i = 0; i < 2 && texture->queue.length > 0; i++) {
+    uint32_t key = texture->queue.data[0];
+    arr_splice(&texture->queue, 0, 1);
+    arr_push(&texture->results, ((Tile) { key, loadTile(texture, key) }));
+  }
+#endif
+
+  Tile tiles[MAX_TILE_UPLOADS];
+  lock(texture);
+  uint32_t count = (uint32_t) MIN(texture->results.length, MAX_TILE_UPLOADS);
+  memcpy(tiles, texture->results.data, count * sizeof(Tile));
+  arr_splice(&texture->results, 0, count);
+  unlock(texture);
+
+  // Tiles that are missing or the wrong size stay requested, so they aren't tried again.  If every
+  // page is in use by the latest feedback, the tile is dropped and can be requested again later.
+  uint32_t pageSize = texture->info.tileSize + 2 * texture->info.border;
+  for (uint32_t i = 0; i < count; i++) {
+    Image* image = tiles[i].image;
+    if (image && image->width == pageSize && image->height == pageSize && image->format == FORMAT_RGBA) {
+      uint32_t page = findPage(texture);
+      map_remove(&texture->requested, hashKey(tiles[i].key));
+      if (page != NO_TILE) {
+        addTile(texture, tiles[i].key, page, image);
+      }
+    }
+    lovrRelease(image, lovrImageDestroy);
+  }
+
+  uploadPageTable(texture);
+}
+
+void lovrVirtualTextureBind(VirtualTexture* texture, Shader* shader) {
+  bindUniforms(texture, shader, 0.f);
+}
+
+void lovrVirtualTextureGetStats(VirtualTexture* texture, uint32_t* resident, uint32_t* pending) {
+  *resident = texture->resident.used;
+  lock(texture);
+  *pending = (uint32_t) (texture->queue.length + texture->results.length);
+  unlock(texture);
+}
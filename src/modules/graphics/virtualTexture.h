@@ -0,0 +1,32 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#pragma once
+
+#define MAX_VIRTUAL_TILES 4096
+
+struct Canvas;
+struct Shader;
+struct Texture;
+
+typedef struct {
+  uint32_t tileSize;
+  uint32_t border;
+  uint32_t pages;
+  uint32_t feedbackScale;
+} VirtualTextureInfo;
+
+typedef struct VirtualTexture VirtualTexture;
+VirtualTexture* lovrVirtualTextureCreate(uint32_t width, uint32_t height, const char* pattern, VirtualTextureInfo* info);
+void lovrVirtualTextureDestroy(void* ref);
+uint32_t lovrVirtualTextureGetWidth(VirtualTexture* texture);
+uint32_t lovrVirtualTextureGetHeight(VirtualTexture* texture);
+const VirtualTextureInfo* lovrVirtualTextureGetInfo(VirtualTexture* texture);
+struct Texture* lovrVirtualTextureGetAtlas(VirtualTexture* texture);
+struct Texture* lovrVirtualTextureGetPageTable(VirtualTexture* texture);
+struct Canvas* lovrVirtualTextureGetFeedbackCanvas(VirtualTexture* texture);
+void lovrVirtualTextureBeginFeedback(VirtualTexture* texture);
+void lovrVirtualTextureEndFeedback(VirtualTexture* texture);
+void lovrVirtualTextureUpdate(VirtualTexture* texture);
+void lovrVirtualTextureBind(VirtualTexture* texture, struct Shader* shader);
+void lovrVirtualTextureGetStats(VirtualTexture* texture, uint32_t* resident, uint32_t* pending);
@@ -1,11 +1,13 @@
 #include "headset/headset.h"
 #include "core/util.h"
+#include <stdlib.h>
+#include <string.h>
 
 HeadsetInterface* lovrHeadsetDisplayDriver = NULL;
 HeadsetInterface* lovrHeadsetTrackingDrivers = NULL;
 static bool initialized = false;
 
-bool lovrHeadsetInit(HeadsetDriver* drivers, size_t count, float supersample, float offset, uint32_t msaa, bool overlay) {
+bool lovrHeadsetInit(HeadsetDriver* drivers, size_t count, float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined) {
   if (initialized) return false;
   initialized = true;
 
@@ -42,7 +44,7 @@ bool lovrHeadsetInit(HeadsetDriver* drivers, size_t count, float supersample, fl
     bool hasDisplay = interface->renderTo != NULL;
     bool shouldInitialize = !hasDisplay || !lovrHeadsetDisplayDriver;
 
-    if (shouldInitialize && interface->init(supersample, offset, msaa, overlay)) {
+    if (shouldInitialize && interface->init(supersample, offset, msaa, overlay, pipelined)) {
       if (hasDisplay) {
         lovrHeadsetDisplayDriver = interface;
       }
@@ -75,3 +77,82 @@ void lovrHeadsetDestroy() {
     lovrHeadsetDisplayDriver = NULL;
   }
 }
+
+Layer* lovrLayerCreate(LayerType type, uint32_t width, uint32_t height) {
+  lovrAssert(lovrHeadsetDisplayDriver->newLayer, "Composition layers are not supported by the current headset driver");
+  lovrAssert(width > 0 && height > 0, "Layer dimensions must be positive");
+  Layer* layer = calloc(1, sizeof(Layer));
+  lovrAssert(layer, "Out of memory");
+  layer->ref = 1;
+  layer->type = type;
+  layer->width = width;
+  layer->height = height;
+  layer->orientation[3] = 1.f;
+  layer->size[0] = 1.f;
+  layer->size[1] = (float) height / width;
+  layer->radius = 1.f;
+  layer->visible = true;
+  if (!lovrHeadsetDisplayDriver->newLayer(layer)) {
+    free(layer);
+    lovrThrow("Could not create composition layer");
+  }
+  return layer;
+}
+
+// Layers can outlive the headset module, in which case the driver has already cleaned them up
+void lovrLayerDestroy(void* ref) {
+  Layer* layer = ref;
+  if (lovrHeadsetDisplayDriver && layer->data) {
+    lovrHeadsetDisplayDriver->destroyLayer(layer);
+  }
+  free(layer);
+}
+
+// The Canvas is only valid until the layer is released, since each image has its own
+struct Canvas* lovrLayerAcquire(Layer* layer) {
+  lovrAssert(layer->data, "Layer was destroyed along with the headset module");
+  return lovrHeadsetDisplayDriver->acquireLayer(layer);
+}
+
+void lovrLayerRelease(Layer* layer) {
+  lovrHeadsetDisplayDriver->releaseLayer(layer);
+  layer->rendered = true;
+}
+
+void lovrLayerGetPose(Layer* layer, float* position, float* orientation) {
+  memcpy(position, layer->position, 3 * sizeof(float));
+  memcpy(orientation, layer->orientation, 4 * sizeof(float));
+}
+
+void lovrLayerSetPose(Layer* layer, float* position, float* orientation) {
+  memcpy(layer->position, position, 3 * sizeof(float));
+  memcpy(layer->orientation, orientation, 4 * sizeof(float));
+}
+
+void lovrLayerGetSize(Layer* layer, float* width, float* height) {
+  *width = layer->size[0];
+  *height = layer->size[1];
+}
+
+void lovrLayerSetSize(Layer* layer, float width, float height) {
+  lovrAssert(width > 0.f && height > 0.f, "Layer size must be positive");
+  layer->size[0] = width;
+  layer->size[1] = height;
+}
+
+float lovrLayerGetRadius(Layer* layer) {
+  return layer->radius;
+}
+
+void lovrLayerSetRadius(Layer* layer, float radius) {
+  lovrAssert(radius > 0.f, "Layer radius must be positive");
+  layer->radius = radius;
+}
+
+bool lovrLayerIsVisible(Layer* layer) {
+  return layer->visible;
+}
+
+void lovrLayerSetVisible(Layer* layer, bool visible) {
+  layer->visible = visible;
+}
@@ -6,6 +6,7 @@
 
 #define HAND_JOINT_COUNT 26
 
+struct Canvas;
 struct Model;
 struct ModelData;
 struct Texture;
@@ -25,6 +26,47 @@ typedef enum {
   ORIGIN_FLOOR
 } HeadsetOrigin;
 
+typedef enum {
+  FOVEATION_NONE,
+  FOVEATION_LOW,
+  FOVEATION_MEDIUM,
+  FOVEATION_HIGH
+} FoveationLevel;
+
+typedef enum {
+  LAYER_QUAD,
+  LAYER_CYLINDER
+} LayerType;
+
+// Composition layers are drawn by the compositor on top of the eye buffers, sampling their image
+// once at its own resolution.  The image is kept until it's rendered again.  Quads are size[0] by
+// size[1] meters, cylinders are an arc of size[0] meters around the radius, size[1] meters tall.
+typedef struct Layer {
+  uint32_t ref;
+  LayerType type;
+  uint32_t width;
+  uint32_t height;
+  float position[4];
+  float orientation[4];
+  float size[2];
+  float radius;
+  bool visible;
+  bool rendered;
+  void* data;
+} Layer;
+
+// Timing of the most recently rendered frame, in seconds.  The waits are the time the main thread
+// spent blocked on the compositor.  Negative times are unknown, and missedFrames is a running total
+// of display refreshes that had to show an old frame.
+typedef struct {
+  double frameWait;
+  double swapchainWait;
+  double gpuTime;
+  double compositorCpuTime;
+  double compositorGpuTime;
+  uint32_t missedFrames;
+} FrameTiming;
+
 typedef enum {
   DEVICE_HEAD,
   DEVICE_HAND_LEFT,
@@ -108,11 +150,19 @@ typedef enum {
 // - For isDown, changed can be set to false if change information is unavailable or inconvenient.
 // - getAxis may write 4 floats to the output value.  The expected number is a constant (see axisCounts in l_headset).
 // - In general, most input results should be kept constant between calls to update.
+// - setFoveation is optional, and returns false if the runtime doesn't support foveated rendering.
+// - setDynamicResolution and getResolutionScale are optional, drivers without them render at 1x.
+// - setSpaceWarp is optional, and returns false if the runtime can't synthesize frames.
+// - setDepthSubmission and setLateLatching are optional, and return false if they aren't supported.
+// - getFrameTiming is optional, and returns false before the first frame is rendered.
+// - The layer functions are optional.  Drivers create the images of a layer in newLayer, and submit
+//   visible layers that have been rendered to on every frame.  acquireLayer returns the Canvas for
+//   the next image, releaseLayer is called after rendering to it.
 
 typedef struct HeadsetInterface {
   struct HeadsetInterface* next;
   HeadsetDriver driverType;
-  bool (*init)(float supersample, float offset, uint32_t msaa, bool overlay);
+  bool (*init)(float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined);
   void (*destroy)(void);
   bool (*getName)(char* name, size_t length);
   HeadsetOrigin (*getOriginType)(void);
@@ -125,6 +175,17 @@ typedef struct HeadsetInterface {
   bool (*getViewAngles)(uint32_t view, float* left, float* right, float* up, float* down);
   void (*getClipDistance)(float* clipNear, float* clipFar);
   void (*setClipDistance)(float clipNear, float clipFar);
+  bool (*setFoveation)(FoveationLevel level, bool dynamic);
+  bool (*setDynamicResolution)(bool enable, float min, float max);
+  float (*getResolutionScale)(void);
+  bool (*setSpaceWarp)(bool enable);
+  bool (*setDepthSubmission)(bool enable);
+  bool (*setLateLatching)(bool enable);
+  bool (*getFrameTiming)(FrameTiming* timing);
+  bool (*newLayer)(Layer* layer);
+  void (*destroyLayer)(Layer* layer);
+  struct Canvas* (*acquireLayer)(Layer* layer);
+  void (*releaseLayer)(Layer* layer);
   void (*getBoundsDimensions)(float* width, float* depth);
   const float* (*getBoundsGeometry)(uint32_t* count);
   bool (*getPose)(Device device, float* position, float* orientation);
@@ -157,5 +218,18 @@ extern HeadsetInterface* lovrHeadsetTrackingDrivers;
 #define FOREACH_TRACKING_DRIVER(i)\
   for (HeadsetInterface* i = lovrHeadsetTrackingDrivers; i != NULL; i = i->next)
 
-bool lovrHeadsetInit(HeadsetDriver* drivers, size_t count, float supersample, float offset, uint32_t msaa, bool overlay);
+bool lovrHeadsetInit(HeadsetDriver* drivers, size_t count, float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined);
 void lovrHeadsetDestroy(void);
+
+Layer* lovrLayerCreate(LayerType type, uint32_t width, uint32_t height);
+void lovrLayerDestroy(void* ref);
+struct Canvas* lovrLayerAcquire(Layer* layer);
+void lovrLayerRelease(Layer* layer);
+void lovrLayerGetPose(Layer* layer, float* position, float* orientation);
+void lovrLayerSetPose(Layer* layer, float* position, float* orientation);
+void lovrLayerGetSize(Layer* layer, float* width, float* height);
+void lovrLayerSetSize(Layer* layer, float width, float height);
+float lovrLayerGetRadius(Layer* layer);
+void lovrLayerSetRadius(Layer* layer, float radius);
+bool lovrLayerIsVisible(Layer* layer);
+void lovrLayerSetVisible(Layer* layer, bool visible);
@@ -31,7 +31,7 @@ static struct {
   float yaw;
 } state;
 
-static bool desktop_init(float supersample, float offset, uint32_t msaa, bool overlay) {
+static bool desktop_init(float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined) {
   state.offset = offset;
   state.clipNear = .1f;
   state.clipFar = 100.f;
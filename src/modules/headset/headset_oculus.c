@@ -84,7 +84,7 @@ static ovrInputState *refreshButtons(void) {
 }
 
 
-static bool oculus_init(float supersample, float offset, uint32_t msaa, bool overlay) {
+static bool oculus_init(float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined) {
   arr_init(&state.textures, realloc);
 
   ovrResult result = ovr_Initialize(NULL);
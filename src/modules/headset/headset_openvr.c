@@ -94,12 +94,18 @@ static struct {
   TrackedDevicePose_t renderPoses[64];
   Canvas* canvas;
   float* mask;
+  float* viewMask;
+  uint32_t viewMaskCount;
+  bool viewMaskLoaded;
   float boundsGeometry[16];
   float clipNear;
   float clipFar;
   float supersample;
   float offset;
   int msaa;
+  FrameTiming timing;
+  uint32_t timingFrame;
+  bool timingValid;
 } state;
 
 static TrackedDeviceIndex_t getDeviceIndex(Device device) {
@@ -112,7 +118,7 @@ static TrackedDeviceIndex_t getDeviceIndex(Device device) {
 }
 
 static bool openvr_getName(char* name, size_t length);
-static bool openvr_init(float supersample, float offset, uint32_t msaa, bool overlay) {
+static bool openvr_init(float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined) {
   if (!VR_IsHmdPresent() || !VR_IsRuntimeInstalled()) {
     return false;
   }
@@ -258,6 +264,7 @@ static void openvr_destroy(void) {
   lovrRelease(state.canvas, lovrCanvasDestroy);
   VR_ShutdownInternal();
   free(state.mask);
+  free(state.viewMask);
   memset(&state, 0, sizeof(state));
 }
 
@@ -303,6 +310,37 @@ static const float* openvr_getDisplayMask(uint32_t* count) {
   return state.mask;
 }
 
+// Converts the hidden area meshes of both eyes to the view mask format used by graphics, which is
+// (x, y, view) in normalized device coordinates.  OpenVR's meshes are in UV space with a top left
+// origin.
+static void loadViewMask(void) {
+  state.viewMaskLoaded = true;
+
+  struct HiddenAreaMesh_t meshes[2];
+  meshes[0] = state.system->GetHiddenAreaMesh(EVREye_Eye_Left, EHiddenAreaMeshType_k_eHiddenAreaMesh_Standard);
+  meshes[1] = state.system->GetHiddenAreaMesh(EVREye_Eye_Right, EHiddenAreaMeshType_k_eHiddenAreaMesh_Standard);
+
+  uint32_t count = 3 * (meshes[0].unTriangleCount + meshes[1].unTriangleCount);
+
+  if (count == 0) {
+    return;
+  }
+
+  state.viewMask = malloc(count * 3 * sizeof(float));
+  lovrAssert(state.viewMask, "Out of memory");
+
+  float* vertex = state.viewMask;
+  for (uint32_t i = 0; i < 2; i++) {
+    for (uint32_t j = 0; j < 3 * meshes[i].unTriangleCount; j++) {
+      *vertex++ = 2.f * meshes[i].pVertexData[j].v[0] - 1.f;
+      *vertex++ = 1.f - 2.f * meshes[i].pVertexData[j].v[1];
+      *vertex++ = (float) i;
+    }
+  }
+
+  state.viewMaskCount = count;
+}
+
 static double openvr_getDisplayTime(void) {
   float secondsSinceVsync;
   state.system->GetTimeSinceLastVsync(&secondsSinceVsync, NULL);
@@ -833,9 +871,15 @@ static void openvr_renderTo(void (*callback)(void*), void* userdata) {
     lovrGraphicsSetProjection(i, matrix);
   }
 
+  if (!state.viewMaskLoaded) {
+    loadViewMask();
+  }
+
+  lovrGraphicsSetViewMask(state.viewMask, state.viewMaskCount);
   lovrGraphicsSetBackbuffer(state.canvas, true, true);
   callback(userdata);
   lovrGraphicsSetBackbuffer(NULL, false, false);
+  lovrGraphicsSetViewMask(NULL, 0);
 
   // Submit
   const Attachment* attachments = lovrCanvasGetAttachments(state.canvas, NULL);
@@ -852,8 +896,41 @@ static Texture* openvr_getMirrorTexture(void) {
   return lovrCanvasGetAttachments(state.canvas, NULL)[0].texture;
 }
 
+static bool openvr_getFrameTiming(FrameTiming* timing) {
+  *timing = state.timing;
+  return state.timingValid;
+}
+
+// Timing is reported for the last frame the compositor presented, which can repeat across updates,
+// so dropped frames are only counted once per frame index
+static void updateFrameTiming(double frameWait) {
+  Compositor_FrameTiming timing = { .m_nSize = sizeof(timing) };
+  state.timing.frameWait = frameWait;
+  state.timing.swapchainWait = -1.;
+
+  if (!state.compositor->GetFrameTiming(&timing, 0)) {
+    state.timing.gpuTime = -1.;
+    state.timing.compositorCpuTime = -1.;
+    state.timing.compositorGpuTime = -1.;
+    return;
+  }
+
+  state.timing.gpuTime = timing.m_flPreSubmitGpuMs / 1000.;
+  state.timing.compositorCpuTime = timing.m_flCompositorRenderCpuMs / 1000.;
+  state.timing.compositorGpuTime = timing.m_flCompositorRenderGpuMs / 1000.;
+
+  if (timing.m_nFrameIndex != state.timingFrame) {
+    state.timing.missedFrames += timing.m_nNumDroppedFrames;
+    state.timingFrame = timing.m_nFrameIndex;
+  }
+
+  state.timingValid = true;
+}
+
 static void openvr_update(float dt) {
+  double start = os_get_time();
   state.compositor->WaitGetPoses(state.renderPoses, sizeof(state.renderPoses) / sizeof(state.renderPoses[0]), NULL, 0);
+  updateFrameTiming(os_get_time() - start);
   VRActiveActionSet_t activeActionSet = { .ulActionSet = state.actionSet };
   state.input->UpdateActionState(&activeActionSet, sizeof(activeActionSet), 1);
 
@@ -891,6 +968,7 @@ HeadsetInterface lovrHeadsetOpenVRDriver = {
   .getViewAngles = openvr_getViewAngles,
   .getClipDistance = openvr_getClipDistance,
   .setClipDistance = openvr_setClipDistance,
+  .getFrameTiming = openvr_getFrameTiming,
   .getBoundsDimensions = openvr_getBoundsDimensions,
   .getBoundsGeometry = openvr_getBoundsGeometry,
   .getPose = openvr_getPose,
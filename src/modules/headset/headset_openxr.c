@@ -4,8 +4,13 @@
 #include "graphics/graphics.h"
 #include "graphics/canvas.h"
 #include "graphics/texture.h"
+#include "core/os.h"
 #include "core/util.h"
+#ifndef LOVR_DISABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#endif
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #if defined(_WIN32)
   #define XR_USE_PLATFORM_WIN32
@@ -50,7 +55,10 @@
 #define XR_INIT(f) if (XR_FAILED(f)) return openxr_destroy(), false;
 #define SESSION_ACTIVE(s) (s >= XR_SESSION_STATE_READY && s <= XR_SESSION_STATE_FOCUSED)
 #define GL_SRGB8_ALPHA8 0x8C43
+#define GL_RGBA16F 0x881A
+#define GL_DEPTH24_STENCIL8 0x88F0
 #define MAX_IMAGES 4
+#define MAX_LAYERS 16
 
 #if defined(_WIN32)
 HANDLE os_get_win32_window(void);
@@ -111,7 +119,33 @@ EGLConfig os_get_egl_config(void);
   X(xrApplyHapticFeedback)\
   X(xrCreateHandTrackerEXT)\
   X(xrDestroyHandTrackerEXT)\
-  X(xrLocateHandJointsEXT)
+  X(xrLocateHandJointsEXT)\
+  X(xrGetVisibilityMaskKHR)\
+  XR_FOREACH_FOVEATION(X)
+
+// Fixed foveation needs a few FB extensions that only newer OpenXR headers have
+#if defined(XR_FB_foveation) && defined(XR_FB_foveation_configuration) && defined(XR_FB_swapchain_update_state)
+#define LOVR_XR_FOVEATION
+#define XR_FOREACH_FOVEATION(X)\
+  X(xrCreateFoveationProfileFB)\
+  X(xrDestroyFoveationProfileFB)\
+  X(xrUpdateSwapchainFB)
+#else
+#define XR_FOREACH_FOVEATION(X)
+#endif
+
+// SpaceWarp renders depth and motion vectors into multiview Canvases, which only GLES has
+#if defined(XR_FB_space_warp) && defined(XR_USE_GRAPHICS_API_OPENGL_ES)
+#define LOVR_XR_SPACE_WARP
+#endif
+
+// Swapchain and Canvases of a Layer, stored in its data pointer
+typedef struct {
+  XrSwapchain swapchain;
+  Canvas* canvases[MAX_IMAGES];
+  uint32_t imageCount;
+  uint32_t imageIndex;
+} LayerData;
 
 #define XR_DECLARE(fn) static PFN_##fn fn;
 #define XR_LOAD(fn) xrGetInstanceProcAddr(state.instance, #fn, (PFN_xrVoidFunction*) &fn);
@@ -132,6 +166,8 @@ static struct {
   XrCompositionLayerProjection layers[1];
   XrCompositionLayerProjectionView layerViews[2];
   XrFrameState frameState;
+  XrView views[2];
+  bool lateLatching;
   Canvas* canvases[MAX_IMAGES];
   uint32_t imageIndex;
   uint32_t imageCount;
@@ -140,14 +176,86 @@ static struct {
   uint32_t height;
   float clipNear;
   float clipFar;
+  struct {
+    bool dynamic;
+    float scale;
+    float min;
+    float max;
+    uint32_t frames;
+    uint32_t viewsPerRow;
+  } resolution;
   XrActionSet actionSet;
   XrAction actions[MAX_ACTIONS];
   XrPath actionFilters[2];
   XrHandTrackerEXT handTrackers[2];
+  struct {
+    XrTime time;
+    XrSpaceLocation location;
+    XrSpaceVelocity velocity;
+  } poses[MAX_DEVICES];
+  struct {
+    XrTime time;
+    bool active;
+    XrHandJointLocationEXT joints[HAND_JOINT_COUNT];
+  } skeletons[2];
+  Layer* compositionLayers[MAX_LAYERS];
+  uint32_t compositionLayerCount;
+  struct {
+    FrameTiming last;
+    double frameWait;
+    double swapchainWait;
+    XrTime displayTime;
+    bool valid;
+  } timing;
+  struct {
+    bool enabled;
+    XrSwapchain swapchain;
+    Texture* textures[MAX_IMAGES];
+    uint32_t count;
+    XrCompositionLayerDepthInfoKHR info[2];
+  } depth;
+  struct {
+    bool dirty;
+    XrVector2f* vertices[2];
+    uint32_t* indices[2];
+    uint32_t indexCount[2];
+    float* data;
+    uint32_t count;
+  } viewMask;
   struct {
     bool handTracking;
+    bool cylinder;
+    bool depth;
     bool overlay;
+    bool foveation;
+    bool spaceWarp;
+    bool visibilityMask;
   } features;
+#ifdef LOVR_XR_SPACE_WARP
+  struct {
+    bool enabled;
+    bool hasPrevious;
+    XrSwapchain motionSwapchain;
+    Texture* motion[MAX_IMAGES];
+    uint32_t motionCount;
+    float viewProjection[2][16];
+    XrCompositionLayerSpaceWarpInfoFB info[2];
+  } spaceWarp;
+#endif
+#ifndef LOVR_DISABLE_THREAD
+  struct {
+    bool enabled;
+    bool requested;
+    bool pending;
+    bool done;
+    bool quit;
+    thrd_t thread;
+    mtx_t lock;
+    cnd_t cond;
+    XrResult result;
+    XrFrameState frameState;
+  } pipeline;
+#endif
 } state;
 
 static XrResult handleResult(XrResult result, const char* file, int line) {
@@ -169,8 +277,71 @@ static bool hasExtension(XrExtensionProperties* extensions, uint32_t count, cons
 }
 
 static void openxr_destroy();
+static void destroyLayerData(LayerData* data);
+
+#ifndef LOVR_DISABLE_THREAD
+// Pipelining moves xrWaitFrame to its own thread, which OpenXR allows.  The wait for the next frame
+// is started right after a frame ends, so the simulation of the next frame runs while the runtime
+// throttles instead of after it.  xrBeginFrame, xrEndFrame, and all graphics work stay on the main
+// thread.  The main thread only joins the wait when it starts rendering, and in the meantime the
+// display time is predicted from the previous frame.
+static int frameThread(void* userdata) {
+  mtx_lock(&state.pipeline.lock);
+  for (;;) {
+    while (!state.pipeline.requested && !state.pipeline.quit) {
+      cnd_wait(&state.pipeline.cond, &state.pipeline.lock);
+    }
+
+    if (state.pipeline.quit) {
+      break;
+    }
+
+    state.pipeline.requested = false;
+    mtx_unlock(&state.pipeline.lock);
+    XrFrameState frameState = { .type = XR_TYPE_FRAME_STATE };
+    XrResult result = xrWaitFrame(state.session, NULL, &frameState);
+    mtx_lock(&state.pipeline.lock);
+    state.pipeline.result = result;
+    state.pipeline.frameState = frameState;
+    state.pipeline.done = true;
+    cnd_broadcast(&state.pipeline.cond);
+  }
+  mtx_unlock(&state.pipeline.lock);
+  return 0;
+}
 
-static bool openxr_init(float supersample, float offset, uint32_t msaa, bool overlay) {
+static void startFrameWait(void) {
+  mtx_lock(&state.pipeline.lock);
+  state.pipeline.requested = true;
+  state.pipeline.pending = true;
+  state.pipeline.done = false;
+  cnd_broadcast(&state.pipeline.cond);
+  mtx_unlock(&state.pipeline.lock);
+}
+
+// Waits for the frame thread, returning the result of its xrWaitFrame (or success if nothing was
+// pending, which means the current frame state is already up to date)
+static XrResult finishFrameWait(void) {
+  if (!state.pipeline.pending) {
+    return XR_SUCCESS;
+  }
+
+  mtx_lock(&state.pipeline.lock);
+  while (!state.pipeline.done) {
+    cnd_wait(&state.pipeline.cond, &state.pipeline.lock);
+  }
+  state.pipeline.pending = false;
+  state.pipeline.done = false;
+  XrResult result = state.pipeline.result;
+  if (XR_SUCCEEDED(result)) {
+    state.frameState = state.pipeline.frameState;
+  }
+  mtx_unlock(&state.pipeline.lock);
+  return result;
+}
+#endif
+
+static bool openxr_init(float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined) {
   state.msaa = msaa;
 
 #ifdef __ANDROID__
@@ -200,7 +371,7 @@ static bool openxr_init(float supersample, float offset, uint32_t msaa, bool ove
     for (uint32_t i = 0; i < extensionCount; i++) extensions[i].type = XR_TYPE_EXTENSION_PROPERTIES;
     xrEnumerateInstanceExtensionProperties(NULL, 32, &extensionCount, extensions);
 
-    const char* enabledExtensionNames[5];
+    const char* enabledExtensionNames[16];
     uint32_t enabledExtensionCount = 0;
 
 #ifdef __ANDROID__
@@ -214,6 +385,43 @@ static bool openxr_init(float supersample, float offset, uint32_t msaa, bool ove
       state.features.handTracking = true;
     }
 
+    if (hasExtension(extensions, extensionCount, XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME)) {
+      enabledExtensionNames[enabledExtensionCount++] = XR_KHR_COMPOSITION_LAYER_DEPTH_EXTENSION_NAME;
+      state.features.depth = true;
+    }
+
+    if (hasExtension(extensions, extensionCount, XR_KHR_VISIBILITY_MASK_EXTENSION_NAME)) {
+      enabledExtensionNames[enabledExtensionCount++] = XR_KHR_VISIBILITY_MASK_EXTENSION_NAME;
+      state.features.visibilityMask = true;
+    }
+
+#ifdef XR_KHR_composition_layer_cylinder
+    if (hasExtension(extensions, extensionCount, XR_KHR_COMPOSITION_LAYER_CYLINDER_EXTENSION_NAME)) {
+      enabledExtensionNames[enabledExtensionCount++] = XR_KHR_COMPOSITION_LAYER_CYLINDER_EXTENSION_NAME;
+      state.features.cylinder = true;
+    }
+#endif
+
+#ifdef LOVR_XR_FOVEATION
+    if (
+      hasExtension(extensions, extensionCount, XR_FB_FOVEATION_EXTENSION_NAME) &&
+      hasExtension(extensions, extensionCount, XR_FB_FOVEATION_CONFIGURATION_EXTENSION_NAME) &&
+      hasExtension(extensions, extensionCount, XR_FB_SWAPCHAIN_UPDATE_STATE_EXTENSION_NAME)
+    ) {
+      enabledExtensionNames[enabledExtensionCount++] = XR_FB_FOVEATION_EXTENSION_NAME;
+      enabledExtensionNames[enabledExtensionCount++] = XR_FB_FOVEATION_CONFIGURATION_EXTENSION_NAME;
+      enabledExtensionNames[enabledExtensionCount++] = XR_FB_SWAPCHAIN_UPDATE_STATE_EXTENSION_NAME;
+      state.features.foveation = true;
+    }
+#endif
+
+#ifdef LOVR_XR_SPACE_WARP
+    if (hasExtension(extensions, extensionCount, XR_FB_SPACE_WARP_EXTENSION_NAME)) {
+      enabledExtensionNames[enabledExtensionCount++] = XR_FB_SPACE_WARP_EXTENSION_NAME;
+      state.features.spaceWarp = true;
+    }
+#endif
+
 #ifdef XR_EXTX_overlay
     // Provisional extension.
     if (overlay && hasExtension(extensions, extensionCount, XR_EXTX_OVERLAY_EXTENSION_NAME)) {
@@ -505,6 +713,9 @@ static bool openxr_init(float supersample, float offset, uint32_t msaa, bool ove
       lovrRelease(texture, lovrTextureDestroy);
     }
 
+    // Multiview Canvases have one view per layer, the rest put both views side by side
+    state.resolution.viewsPerRow = state.imageCount > 0 ? lovrCanvasGetWidth(state.canvases[0]) / state.width : 1;
+
     XrCompositionLayerFlags layerFlags = 0;
 
     if (state.features.overlay) {
@@ -538,18 +749,76 @@ static bool openxr_init(float supersample, float offset, uint32_t msaa, bool ove
 
   state.clipNear = .1f;
   state.clipFar = 100.f;
+  state.resolution.scale = 1.f;
+  state.depth.enabled = state.features.depth;
+  state.viewMask.dirty = state.features.visibilityMask;
 
   state.frameState.type = XR_TYPE_FRAME_STATE;
   os_window_set_vsync(0);
 
+#ifndef LOVR_DISABLE_THREAD
+  if (pipelined && mtx_init(&state.pipeline.lock, mtx_plain) == thrd_success) {
+    if (cnd_init(&state.pipeline.cond) == thrd_success) {
+      if (thrd_create(&state.pipeline.thread, frameThread, NULL) == thrd_success) {
+        state.pipeline.enabled = true;
+      } else {
+        cnd_destroy(&state.pipeline.cond);
+        mtx_destroy(&state.pipeline.lock);
+      }
+    } else {
+      mtx_destroy(&state.pipeline.lock);
+    }
+  }
+#endif
+
   return true;
 }
 
 static void openxr_destroy(void) {
+#ifndef LOVR_DISABLE_THREAD
+  if (state.pipeline.enabled) {
+    finishFrameWait();
+    mtx_lock(&state.pipeline.lock);
+    state.pipeline.quit = true;
+    cnd_broadcast(&state.pipeline.cond);
+    mtx_unlock(&state.pipeline.lock);
+    thrd_join(state.pipeline.thread, NULL);
+    cnd_destroy(&state.pipeline.cond);
+    mtx_destroy(&state.pipeline.lock);
+  }
+#endif
+
   for (uint32_t i = 0; i < state.imageCount; i++) {
     lovrRelease(state.canvases[i], lovrCanvasDestroy);
   }
 
+  // Layers can still be referenced from Lua, so only their resources are destroyed
+  for (uint32_t i = 0; i < state.compositionLayerCount; i++) {
+    destroyLayerData(state.compositionLayers[i]->data);
+    state.compositionLayers[i]->data = NULL;
+  }
+
+#ifdef LOVR_XR_SPACE_WARP
+  for (uint32_t i = 0; i < state.spaceWarp.motionCount; i++) {
+    lovrRelease(state.spaceWarp.motion[i], lovrTextureDestroy);
+  }
+
+  if (state.spaceWarp.motionSwapchain) xrDestroySwapchain(state.spaceWarp.motionSwapchain);
+#endif
+
+  for (uint32_t i = 0; i < state.depth.count; i++) {
+    lovrRelease(state.depth.textures[i], lovrTextureDestroy);
+  }
+
+  if (state.depth.swapchain) xrDestroySwapchain(state.depth.swapchain);
+
+  for (uint32_t i = 0; i < 2; i++) {
+    free(state.viewMask.vertices[i]);
+    free(state.viewMask.indices[i]);
+  }
+
+  free(state.viewMask.data);
+
   for (size_t i = 0; i < MAX_ACTIONS; i++) {
     if (state.actions[i]) {
       xrDestroyAction(state.actions[i]);
@@ -617,6 +886,56 @@ static void getViews(XrView views[2], uint32_t* count) {
   XR(xrLocateViews(state.session, &viewLocateInfo, &viewState, 2, count, views));
 }
 
+// The hidden area of each view is a triangle mesh in view space, on the z = -1 plane, so it gets
+// projected using the fov of the views every frame.  It's only queried again when it changes.
+static void updateViewMask(void) {
+  if (state.viewMask.dirty) {
+    state.viewMask.dirty = false;
+    state.viewMask.count = 0;
+
+    for (uint32_t i = 0; i < 2; i++) {
+      XrVisibilityMaskKHR mask = { .type = XR_TYPE_VISIBILITY_MASK_KHR };
+      XrViewConfigurationType type = XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO;
+      XrVisibilityMaskTypeKHR maskType = XR_VISIBILITY_MASK_TYPE_HIDDEN_TRIANGLE_MESH_KHR;
+      XR(xrGetVisibilityMaskKHR(state.session, type, i, maskType, &mask));
+
+      state.viewMask.vertices[i] = realloc(state.viewMask.vertices[i], MAX(mask.vertexCountOutput, 1) * sizeof(XrVector2f));
+      state.viewMask.indices[i] = realloc(state.viewMask.indices[i], MAX(mask.indexCountOutput, 1) * sizeof(uint32_t));
+      lovrAssert(state.viewMask.vertices[i] && state.viewMask.indices[i], "Out of memory");
+
+      mask.vertexCapacityInput = mask.vertexCountOutput;
+      mask.vertices = state.viewMask.vertices[i];
+      mask.indexCapacityInput = mask.indexCountOutput;
+      mask.indices = state.viewMask.indices[i];
+      XR(xrGetVisibilityMaskKHR(state.session, type, i, maskType, &mask));
+
+      state.viewMask.indexCount[i] = mask.indexCountOutput;
+      state.viewMask.count += mask.indexCountOutput;
+    }
+
+    state.viewMask.data = realloc(state.viewMask.data, MAX(state.viewMask.count, 1) * 3 * sizeof(float));
+    lovrAssert(state.viewMask.data, "Out of memory");
+  }
+
+  float* vertex = state.viewMask.data;
+  for (uint32_t i = 0; i < 2; i++) {
+    XrFovf* fov = &state.views[i].fov;
+    float left = tanf(fov->angleLeft);
+    float right = tanf(fov->angleRight);
+    float up = tanf(fov->angleUp);
+    float down = tanf(fov->angleDown);
+
+    for (uint32_t j = 0; j < state.viewMask.indexCount[i]; j++) {
+      XrVector2f* v = &state.viewMask.vertices[i][state.viewMask.indices[i][j]];
+      *vertex++ = (2.f * v->x - (right + left)) / (right - left);
+      *vertex++ = (2.f * v->y - (up + down)) / (up - down);
+      *vertex++ = (float) i;
+    }
+  }
+
+  lovrGraphicsSetViewMask(state.viewMask.data, state.viewMask.count);
+}
+
 static uint32_t openxr_getViewCount(void) {
   uint32_t count;
   XrView views[2];
@@ -662,6 +981,316 @@ static void openxr_setClipDistance(float clipNear, float clipFar) {
   state.clipFar = clipFar;
 }
 
+// The "dynamic" flag uses the runtime's dynamic level, which lowers foveation when the GPU has time
+// to spare.  The profile can be destroyed right after the swapchain is updated to use it.
+static bool openxr_setFoveation(FoveationLevel level, bool dynamic) {
+#ifdef LOVR_XR_FOVEATION
+  if (!state.features.foveation || !state.swapchain) {
+    return false;
+  }
+
+  XrFoveationLevelFB levels[] = {
+    [FOVEATION_NONE] = XR_FOVEATION_LEVEL_NONE_FB,
+    [FOVEATION_LOW] = XR_FOVEATION_LEVEL_LOW_FB,
+    [FOVEATION_MEDIUM] = XR_FOVEATION_LEVEL_MEDIUM_FB,
+    [FOVEATION_HIGH] = XR_FOVEATION_LEVEL_HIGH_FB
+  };
+
+  XrFoveationLevelProfileCreateInfoFB levelInfo = {
+    .type = XR_TYPE_FOVEATION_LEVEL_PROFILE_CREATE_INFO_FB,
+    .level = levels[level],
+    .verticalOffset = 0.f,
+    .dynamic = dynamic ? XR_FOVEATION_DYNAMIC_LEVEL_ENABLED_FB : XR_FOVEATION_DYNAMIC_DISABLED_FB
+  };
+
+  XrFoveationProfileCreateInfoFB info = {
+    .type = XR_TYPE_FOVEATION_PROFILE_CREATE_INFO_FB,
+    .next = &levelInfo
+  };
+
+  XrFoveationProfileFB profile;
+  XR(xrCreateFoveationProfileFB(state.session, &info, &profile));
+
+  XrSwapchainStateFoveationFB foveation = {
+    .type = XR_TYPE_SWAPCHAIN_STATE_FOVEATION_FB,
+    .profile = profile
+  };
+
+  XR(xrUpdateSwapchainFB(state.swapchain, (XrSwapchainStateBaseHeaderFB*) &foveation));
+  XR(xrDestroyFoveationProfileFB(profile));
+  return true;
+#else
+  return false;
+#endif
+}
+
+// The depth swapchain has the same size and layout as the color swapchain, so the headset Canvas
+// can render depth straight into it (multisampled Canvases resolve their depth to it instead).  On
+// GLES its images are 2 layer textures, which only multiview Canvases can render to.
+static bool createDepthSwapchain(void) {
+#if defined(XR_USE_GRAPHICS_API_OPENGL)
+  TextureType textureType = TEXTURE_2D;
+  uint32_t width = state.width * 2;
+  uint32_t arraySize = 1;
+  XrSwapchainImageOpenGLKHR images[MAX_IMAGES];
+  for (uint32_t i = 0; i < MAX_IMAGES; i++) {
+    images[i].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR;
+    images[i].next = NULL;
+  }
+#elif defined(XR_USE_GRAPHICS_API_OPENGL_ES)
+  TextureType textureType = TEXTURE_ARRAY;
+  uint32_t width = state.width;
+  uint32_t arraySize = 2;
+  XrSwapchainImageOpenGLESKHR images[MAX_IMAGES];
+  for (uint32_t i = 0; i < MAX_IMAGES; i++) {
+    images[i].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR;
+    images[i].next = NULL;
+  }
+
+  if (!lovrGraphicsGetFeatures()->multiview) {
+    return false;
+  }
+#endif
+
+  XrSwapchainCreateInfo info = {
+    .type = XR_TYPE_SWAPCHAIN_CREATE_INFO,
+    .usageFlags = XR_SWAPCHAIN_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+    .format = GL_DEPTH24_STENCIL8,
+    .width = width,
+    .height = state.height,
+    .sampleCount = 1,
+    .faceCount = 1,
+    .arraySize = arraySize,
+    .mipCount = 1
+  };
+
+  if (XR_FAILED(xrCreateSwapchain(state.session, &info, &state.depth.swapchain))) {
+    state.depth.swapchain = XR_NULL_HANDLE;
+    return false;
+  }
+
+  XR(xrEnumerateSwapchainImages(state.depth.swapchain, MAX_IMAGES, &state.depth.count, (XrSwapchainImageBaseHeader*) images));
+  for (uint32_t i = 0; i < state.depth.count; i++) {
+    state.depth.textures[i] = lovrTextureCreateFromHandle(images[i].image, textureType, arraySize, 0);
+  }
+
+  return true;
+}
+
+// Submitted depth lets the runtime reproject with positional timewarp.  It's on by default when the
+// runtime supports it, but costs some bandwidth to store (and resolve, with MSAA) every frame.
+static bool openxr_setDepthSubmission(bool enable) {
+  if (!state.features.depth || !state.swapchain) {
+    return false;
+  }
+
+  if (enable && !state.depth.swapchain && !createDepthSwapchain()) {
+    return false;
+  }
+
+  state.depth.enabled = enable;
+  return true;
+}
+
+// Late latching locates the views again whenever draws to the headset are flushed, instead of once
+// before rendering starts.  The views of the last flush are the ones submitted.  Anything computed
+// from the view pose while rendering will be slightly behind, so this is opt-in.
+static bool openxr_setLateLatching(bool enable) {
+  state.lateLatching = enable;
+  return true;
+}
+
+static void getViewMatrix(float* viewMatrix, XrView* view) {
+  mat4_fromQuat(viewMatrix, &view->pose.orientation.x);
+  memcpy(viewMatrix + 12, &view->pose.position.x, 3 * sizeof(float));
+  mat4_invert(viewMatrix);
+}
+
+static void latchViews(float viewMatrix[2][16]) {
+  uint32_t count;
+  getViews(state.views, &count);
+  getViewMatrix(viewMatrix[0], &state.views[0]);
+  getViewMatrix(viewMatrix[1], &state.views[1]);
+}
+
+#ifdef LOVR_XR_SPACE_WARP
+// The motion vector swapchain has the same size and layout as the color swapchain, so the headset
+// Canvas can render both in one pass (motion vectors go to its second attachment).
+static bool createMotionSwapchain(void) {
+  XrSwapchainImageOpenGLESKHR images[MAX_IMAGES];
+  for (uint32_t i = 0; i < MAX_IMAGES; i++) {
+    images[i].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR;
+    images[i].next = NULL;
+  }
+
+  XrSwapchainCreateInfo info = {
+    .type = XR_TYPE_SWAPCHAIN_CREATE_INFO,
+    .usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT,
+    .format = GL_RGBA16F,
+    .width = state.width,
+    .height = state.height,
+    .sampleCount = 1,
+    .faceCount = 1,
+    .arraySize = 2,
+    .mipCount = 1
+  };
+
+  if (XR_FAILED(xrCreateSwapchain(state.session, &info, &state.spaceWarp.motionSwapchain))) {
+    state.spaceWarp.motionSwapchain = XR_NULL_HANDLE;
+    return false;
+  }
+
+  XR(xrEnumerateSwapchainImages(state.spaceWarp.motionSwapchain, MAX_IMAGES, &state.spaceWarp.motionCount, (XrSwapchainImageBaseHeader*) images));
+  for (uint32_t i = 0; i < state.spaceWarp.motionCount; i++) {
+    state.spaceWarp.motion[i] = lovrTextureCreateFromHandle(images[i].image, TEXTURE_ARRAY, 2, 0);
+  }
+
+  return true;
+}
+
+// Acquires the motion vector image and attaches it to the Canvas.  Motion vectors are cleared to
+// zero on their own first, since the background color is only meant for the color.
+static void beginSpaceWarp(Canvas* canvas) {
+  uint32_t motionIndex;
+  XrSwapchainImageWaitInfo waitInfo = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO, .timeout = 1e9 };
+  XR(xrAcquireSwapchainImage(state.spaceWarp.motionSwapchain, NULL, &motionIndex));
+  XR(xrWaitSwapchainImage(state.spaceWarp.motionSwapchain, &waitInfo));
+
+  // The Canvas holds the only reference to the color texture, which has to survive being detached
+  Attachment color = lovrCanvasGetAttachments(canvas, NULL)[0];
+  Attachment motion = { state.spaceWarp.motion[motionIndex], 0, 0 };
+  lovrRetain(color.texture);
+  lovrCanvasSetAttachments(canvas, &motion, 1);
+  lovrGpuClear(canvas, &(Color) { 0.f, 0.f, 0.f, 0.f }, NULL, NULL);
+  lovrCanvasSetAttachments(canvas, &color, 1);
+  lovrGraphicsSetBackbuffer(canvas, true, true);
+  lovrCanvasSetAttachments(canvas, (Attachment[2]) { color, motion }, 2);
+  lovrRelease(color.texture, lovrTextureDestroy);
+
+  for (uint32_t i = 0; i < 2; i++) {
+    lovrGraphicsSetPreviousViewProjection(i, state.spaceWarp.hasPrevious ? state.spaceWarp.viewProjection[i] : NULL);
+  }
+}
+#endif
+
+// Once SpaceWarp is enabled, the runtime may lower the frame rate and synthesize the missing frames
+// from the motion vectors and depth.  Motion vectors only account for the movement of the headset,
+// since lovr doesn't track the transforms of individual objects across frames.
+static bool openxr_setSpaceWarp(bool enable) {
+#ifdef LOVR_XR_SPACE_WARP
+  if (!state.features.spaceWarp || !state.swapchain || !lovrGraphicsGetFeatures()->multiview) {
+    return false;
+  }
+
+  if (enable && !state.spaceWarp.motionSwapchain && !createMotionSwapchain()) {
+    return false;
+  }
+
+  if (enable && !state.depth.swapchain && !createDepthSwapchain()) {
+    return false;
+  }
+
+  state.spaceWarp.enabled = enable;
+  state.spaceWarp.hasPrevious = false;
+  return true;
+#else
+  return false;
+#endif
+}
+
+static void destroyLayerData(LayerData* data) {
+  for (uint32_t i = 0; i < data->imageCount; i++) {
+    lovrRelease(data->canvases[i], lovrCanvasDestroy);
+  }
+  if (data->swapchain) xrDestroySwapchain(data->swapchain);
+  free(data);
+}
+
+static bool openxr_newLayer(Layer* layer) {
+  if (!state.session || state.compositionLayerCount >= MAX_LAYERS) {
+    return false;
+  }
+
+  if (layer->type == LAYER_CYLINDER && !state.features.cylinder) {
+    return false;
+  }
+
+  LayerData* data = calloc(1, sizeof(LayerData));
+  lovrAssert(data, "Out of memory");
+
+#if defined(XR_USE_GRAPHICS_API_OPENGL)
+  XrSwapchainImageOpenGLKHR images[MAX_IMAGES];
+  for (uint32_t i = 0; i < MAX_IMAGES; i++) {
+    images[i].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_KHR;
+    images[i].next = NULL;
+  }
+#elif defined(XR_USE_GRAPHICS_API_OPENGL_ES)
+  XrSwapchainImageOpenGLESKHR images[MAX_IMAGES];
+  for (uint32_t i = 0; i < MAX_IMAGES; i++) {
+    images[i].type = XR_TYPE_SWAPCHAIN_IMAGE_OPENGL_ES_KHR;
+    images[i].next = NULL;
+  }
+#endif
+
+  XrSwapchainCreateInfo info = {
+    .type = XR_TYPE_SWAPCHAIN_CREATE_INFO,
+    .usageFlags = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT | XR_SWAPCHAIN_USAGE_SAMPLED_BIT,
+    .format = GL_SRGB8_ALPHA8,
+    .width = layer->width,
+    .height = layer->height,
+    .sampleCount = 1,
+    .faceCount = 1,
+    .arraySize = 1,
+    .mipCount = 1
+  };
+
+  if (XR_FAILED(xrCreateSwapchain(state.session, &info, &data->swapchain))) {
+    free(data);
+    return false;
+  }
+
+  XR(xrEnumerateSwapchainImages(data->swapchain, MAX_IMAGES, &data->imageCount, (XrSwapchainImageBaseHeader*) images));
+
+  CanvasFlags flags = { .depth = { true, false, FORMAT_D24S8 }, .stereo = false, .mipmaps = false, .msaa = state.msaa };
+  for (uint32_t i = 0; i < data->imageCount; i++) {
+    Texture* texture = lovrTextureCreateFromHandle(images[i].image, TEXTURE_2D, 1, state.msaa);
+    data->canvases[i] = lovrCanvasCreate(layer->width, layer->height, flags);
+    lovrCanvasSetAttachments(data->canvases[i], &(Attachment) { texture, 0, 0 }, 1);
+    lovrRelease(texture, lovrTextureDestroy);
+  }
+
+  layer->data = data;
+  state.compositionLayers[state.compositionLayerCount++] = layer;
+  return true;
+}
+
+static void openxr_destroyLayer(Layer* layer) {
+  for (uint32_t i = 0; i < state.compositionLayerCount; i++) {
+    if (state.compositionLayers[i] == layer) {
+      memmove(state.compositionLayers + i, state.compositionLayers + i + 1, (state.compositionLayerCount - i - 1) * sizeof(Layer*));
+      state.compositionLayerCount--;
+      break;
+    }
+  }
+
+  destroyLayerData(layer->data);
+  layer->data = NULL;
+}
+
+static Canvas* openxr_acquireLayer(Layer* layer) {
+  LayerData* data = layer->data;
+  XrSwapchainImageWaitInfo waitInfo = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO, .timeout = XR_INFINITE_DURATION };
+  XR(xrAcquireSwapchainImage(data->swapchain, NULL, &data->imageIndex));
+  XR(xrWaitSwapchainImage(data->swapchain, &waitInfo));
+  return data->canvases[data->imageIndex];
+}
+
+static void openxr_releaseLayer(Layer* layer) {
+  LayerData* data = layer->data;
+  lovrGpuDirtyTexture();
+  XR(xrReleaseSwapchainImage(data->swapchain, NULL));
+}
+
 static void openxr_getBoundsDimensions(float* width, float* depth) {
   XrExtent2Df bounds;
   if (XR_SUCCEEDED(xrGetReferenceSpaceBoundsRect(state.session, state.referenceSpaceType, &bounds))) {
@@ -678,16 +1307,37 @@ static const float* openxr_getBoundsGeometry(uint32_t* count) {
   return NULL;
 }
 
+// Locations are cached for the display time they were predicted for, so each device is located at
+// most once per frame no matter how many times its pose or velocity is queried.
+static XrSpaceLocation* locateDevice(Device device) {
+  if (state.poses[device].time != state.frameState.predictedDisplayTime) {
+    state.poses[device].velocity = (XrSpaceVelocity) { .type = XR_TYPE_SPACE_VELOCITY };
+    state.poses[device].location = (XrSpaceLocation) { .type = XR_TYPE_SPACE_LOCATION, .next = &state.poses[device].velocity };
+    xrLocateSpace(state.spaces[device], state.referenceSpace, state.frameState.predictedDisplayTime, &state.poses[device].location);
+    state.poses[device].time = state.frameState.predictedDisplayTime;
+  }
+  return &state.poses[device].location;
+}
+
+// Predictions get more accurate closer to the display time, so rendering locates everything again
+// instead of using poses from the start of the frame (late latching).
+static void invalidatePoses(void) {
+  for (uint32_t i = 0; i < MAX_DEVICES; i++) {
+    state.poses[i].time = 0;
+  }
+  state.skeletons[0].time = 0;
+  state.skeletons[1].time = 0;
+}
+
 static bool openxr_getPose(Device device, vec3 position, quat orientation) {
   if (!state.spaces[device]) {
     return false;
   }
 
-  XrSpaceLocation location = { .type = XR_TYPE_SPACE_LOCATION, .next = NULL };
-  xrLocateSpace(state.spaces[device], state.referenceSpace, state.frameState.predictedDisplayTime, &location);
-  memcpy(orientation, &location.pose.orientation, 4 * sizeof(float));
-  memcpy(position, &location.pose.position, 3 * sizeof(float));
-  return location.locationFlags & (XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT);
+  XrSpaceLocation* location = locateDevice(device);
+  memcpy(orientation, &location->pose.orientation, 4 * sizeof(float));
+  memcpy(position, &location->pose.position, 3 * sizeof(float));
+  return location->locationFlags & (XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT);
 }
 
 static bool openxr_getVelocity(Device device, vec3 linearVelocity, vec3 angularVelocity) {
@@ -695,12 +1345,11 @@ static bool openxr_getVelocity(Device device, vec3 linearVelocity, vec3 angularV
     return false;
   }
 
-  XrSpaceVelocity velocity = { .type = XR_TYPE_SPACE_VELOCITY };
-  XrSpaceLocation location = { .type = XR_TYPE_SPACE_LOCATION, .next = &velocity };
-  xrLocateSpace(state.spaces[device], state.referenceSpace, state.frameState.predictedDisplayTime, &location);
-  memcpy(linearVelocity, &velocity.linearVelocity, 3 * sizeof(float));
-  memcpy(angularVelocity, &velocity.angularVelocity, 3 * sizeof(float));
-  return velocity.velocityFlags & (XR_SPACE_VELOCITY_LINEAR_VALID_BIT | XR_SPACE_VELOCITY_ANGULAR_VALID_BIT);
+  locateDevice(device);
+  XrSpaceVelocity* velocity = &state.poses[device].velocity;
+  memcpy(linearVelocity, &velocity->linearVelocity, 3 * sizeof(float));
+  memcpy(angularVelocity, &velocity->angularVelocity, 3 * sizeof(float));
+  return velocity->velocityFlags & (XR_SPACE_VELOCITY_LINEAR_VALID_BIT | XR_SPACE_VELOCITY_ANGULAR_VALID_BIT);
 }
 
 static XrPath getActionFilter(Device device) {
@@ -783,7 +1432,8 @@ static bool openxr_getSkeleton(Device device, float* poses) {
     return false;
   }
 
-  XrHandTrackerEXT* handTracker = &state.handTrackers[device - DEVICE_HAND_LEFT];
+  uint32_t index = device - DEVICE_HAND_LEFT;
+  XrHandTrackerEXT* handTracker = &state.handTrackers[index];
 
   // Hand trackers are created lazily because on some implementations xrCreateHandTrackerEXT will
   // return XR_ERROR_FEATURE_UNSUPPORTED if called too early.
@@ -799,25 +1449,31 @@ static bool openxr_getSkeleton(Device device, float* poses) {
     }
   }
 
-  XrHandJointsLocateInfoEXT info = {
-    .type = XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT,
-    .baseSpace = state.referenceSpace,
-    .time = state.frameState.predictedDisplayTime
-  };
+  // Joints are cached like device locations, including the result of an inactive hand
+  if (state.skeletons[index].time != state.frameState.predictedDisplayTime) {
+    XrHandJointsLocateInfoEXT info = {
+      .type = XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT,
+      .baseSpace = state.referenceSpace,
+      .time = state.frameState.predictedDisplayTime
+    };
 
-  XrHandJointLocationEXT joints[26];
-  XrHandJointLocationsEXT hand = {
-    .type = XR_TYPE_HAND_JOINT_LOCATIONS_EXT,
-    .jointCount = sizeof(joints) / sizeof(joints[0]),
-    .jointLocations = joints
-  };
+    XrHandJointLocationsEXT hand = {
+      .type = XR_TYPE_HAND_JOINT_LOCATIONS_EXT,
+      .jointCount = HAND_JOINT_COUNT,
+      .jointLocations = state.skeletons[index].joints
+    };
 
-  if (XR_FAILED(xrLocateHandJointsEXT(*handTracker, &info, &hand)) || !hand.isActive) {
+    state.skeletons[index].active = XR_SUCCEEDED(xrLocateHandJointsEXT(*handTracker, &info, &hand)) && hand.isActive;
+    state.skeletons[index].time = state.frameState.predictedDisplayTime;
+  }
+
+  if (!state.skeletons[index].active) {
     return false;
   }
 
+  XrHandJointLocationEXT* joints = state.skeletons[index].joints;
   float* pose = poses;
-  for (uint32_t i = 0; i < sizeof(joints) / sizeof(joints[0]); i++) {
+  for (uint32_t i = 0; i < HAND_JOINT_COUNT; i++) {
     memcpy(pose, &joints[i].pose.position.x, 3 * sizeof(float));
     pose[3] = joints[i].radius;
     memcpy(pose + 4, &joints[i].pose.orientation.x, 4 * sizeof(float));
@@ -857,61 +1513,340 @@ static bool openxr_animate(Device device, struct Model* model) {
   return false;
 }
 
+static bool openxr_setDynamicResolution(bool enable, float min, float max) {
+  state.resolution.dynamic = enable;
+  state.resolution.min = CLAMP(min, .1f, 1.f);
+  state.resolution.max = CLAMP(max, state.resolution.min, 1.f);
+  state.resolution.scale = enable ? state.resolution.max : 1.f;
+  state.resolution.frames = 0;
+  return true;
+}
+
+static float openxr_getResolutionScale(void) {
+  return state.resolution.scale;
+}
+
+// Rendering to the headset is wrapped in a profile scope, for dynamic resolution and frame timing.
+// Profile results are a few frames old, and the GPU time is 0 without GPU timers (GLES).
+#define PROFILE_LABEL "lovr.headset"
+
+static double getRenderGpuTime(void) {
+  uint32_t count;
+  double gpuTime = 0.;
+  const GpuProfileScope* scopes = lovrGraphicsGetProfile(&count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (scopes[i].parent == ~0u && !strcmp(scopes[i].label, PROFILE_LABEL)) {
+      gpuTime = scopes[i].gpuTime;
+    }
+  }
+  return gpuTime > 0. ? gpuTime : -1.;
+}
+
+// A display time more than a period after the previous frame's means the runtime skipped refreshes,
+// which showed the previous frame again.
+static void updateMissedFrames(void) {
+  XrTime time = state.frameState.predictedDisplayTime;
+  XrDuration period = state.frameState.predictedDisplayPeriod;
+  if (state.timing.displayTime && period > 0 && time - state.timing.displayTime > period + period / 2) {
+    state.timing.last.missedFrames += (uint32_t) ((time - state.timing.displayTime + period / 2) / period) - 1;
+  }
+  state.timing.displayTime = time;
+}
+
+static bool openxr_getFrameTiming(FrameTiming* timing) {
+  *timing = state.timing.last;
+  return state.timing.valid;
+}
+
+// Dynamic resolution scales the part of the swapchain that gets rendered to, based on the GPU time
+// of the headset's profile scope.  Since profile results are old, the scale is only changed every
+// MAX_RESOLUTION_FRAMES frames, and only when the GPU time is far enough from the target.  GPU time
+// is roughly proportional to the number of pixels, which goes with the square of the scale.
+// Without GPU timers the scale stays where it is.
+#define MAX_RESOLUTION_FRAMES 4
+
+static void updateResolution(void) {
+  if (++state.resolution.frames < MAX_RESOLUTION_FRAMES) {
+    return;
+  }
+
+  double gpuTime = getRenderGpuTime();
+  double period = state.frameState.predictedDisplayPeriod / 1e9;
+  if (gpuTime <= 0. || period <= 0.) {
+    return;
+  }
+
+  state.resolution.frames = 0;
+
+  // Some headroom is left for the compositor and timing noise
+  float ratio = (float) (period * .85 / gpuTime);
+  if (ratio > .95f && ratio < 1.05f) {
+    return;
+  }
+
+  float scale = state.resolution.scale;
+  float target = scale + (scale * sqrtf(ratio) - scale) * .5f;
+  float max = state.resolution.max;
+  float min = state.resolution.min;
+  state.resolution.scale = CLAMP(target, min, max);
+}
+
 static void openxr_renderTo(void (*callback)(void*), void* userdata) {
   if (!SESSION_ACTIVE(state.sessionState)) { return; }
 
+#ifndef LOVR_DISABLE_THREAD
+  if (state.pipeline.enabled) {
+    double start = os_get_time();
+    XR(finishFrameWait());
+    state.timing.frameWait += os_get_time() - start;
+  }
+#endif
+
+  updateMissedFrames();
+
   XrFrameBeginInfo beginInfo = {
     .type = XR_TYPE_FRAME_BEGIN_INFO
   };
 
+  const XrCompositionLayerBaseHeader* layers[1 + MAX_LAYERS];
+  union {
+    XrCompositionLayerQuad quad;
+#ifdef XR_KHR_composition_layer_cylinder
+    XrCompositionLayerCylinderKHR cylinder;
+#endif
+  } compositionLayers[MAX_LAYERS];
+
   XrFrameEndInfo endInfo = {
     .type = XR_TYPE_FRAME_END_INFO,
     .displayTime = state.frameState.predictedDisplayTime,
     .environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE,
-    .layers = (const XrCompositionLayerBaseHeader*[1]) { (XrCompositionLayerBaseHeader*) &state.layers[0] }
+    .layers = layers
   };
 
   XR(xrBeginFrame(state.session, &beginInfo));
+  invalidatePoses();
 
   if (state.frameState.shouldRender) {
     XR(xrAcquireSwapchainImage(state.swapchain, NULL, &state.imageIndex));
     XrSwapchainImageWaitInfo waitInfo = { XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO, .timeout = 1e9 };
 
-    if (XR(xrWaitSwapchainImage(state.swapchain, &waitInfo)) != XR_TIMEOUT_EXPIRED) {
+    double start = os_get_time();
+    XrResult result = XR(xrWaitSwapchainImage(state.swapchain, &waitInfo));
+    state.timing.swapchainWait += os_get_time() - start;
+
+    if (result != XR_TIMEOUT_EXPIRED) {
       uint32_t count;
-      XrView views[2];
-      getViews(views, &count);
+      getViews(state.views, &count);
 
+      float projection[2][16];
       for (int eye = 0; eye < 2; eye++) {
         float viewMatrix[16];
-        XrView* view = &views[eye];
-        mat4_fromQuat(viewMatrix, &view->pose.orientation.x);
-        memcpy(viewMatrix + 12, &view->pose.position.x, 3 * sizeof(float));
-        mat4_invert(viewMatrix);
+        getViewMatrix(viewMatrix, &state.views[eye]);
         lovrGraphicsSetViewMatrix(eye, viewMatrix);
 
-        float projection[16];
-        XrFovf* fov = &view->fov;
-        mat4_fov(projection, -fov->angleLeft, fov->angleRight, fov->angleUp, -fov->angleDown, state.clipNear, state.clipFar);
-        lovrGraphicsSetProjection(eye, projection);
+        XrFovf* fov = &state.views[eye].fov;
+        mat4_fov(projection[eye], -fov->angleLeft, fov->angleRight, fov->angleUp, -fov->angleDown, state.clipNear, state.clipFar);
+        lovrGraphicsSetProjection(eye, projection[eye]);
+      }
+
+      if (state.resolution.dynamic) {
+        updateResolution();
+      }
+
+      if (state.features.visibilityMask) {
+        updateViewMask();
+      }
+
+      Canvas* canvas = state.canvases[state.imageIndex];
+      uint32_t width = MAX(1, (uint32_t) (state.width * state.resolution.scale));
+      uint32_t height = MAX(1, (uint32_t) (state.height * state.resolution.scale));
+
+      // Attachments are checked against the full size of the Canvas, so it's scaled down after
+      lovrCanvasSetWidth(canvas, state.width * state.resolution.viewsPerRow);
+      lovrCanvasSetHeight(canvas, state.height);
+
+      if (state.depth.enabled && !state.depth.swapchain && !createDepthSwapchain()) {
+        state.depth.enabled = false;
       }
 
-      lovrGraphicsSetBackbuffer(state.canvases[state.imageIndex], true, true);
+#ifdef LOVR_XR_SPACE_WARP
+      bool depth = state.depth.enabled || state.spaceWarp.enabled;
+#else
+      bool depth = state.depth.enabled;
+#endif
+
+      if (depth) {
+        uint32_t depthIndex;
+        XR(xrAcquireSwapchainImage(state.depth.swapchain, NULL, &depthIndex));
+        start = os_get_time();
+        XR(xrWaitSwapchainImage(state.depth.swapchain, &waitInfo));
+        state.timing.swapchainWait += os_get_time() - start;
+        lovrCanvasSetDepthTexture(canvas, state.depth.textures[depthIndex]);
+      } else {
+        lovrCanvasSetDepthTexture(canvas, NULL);
+      }
+
+#ifdef LOVR_XR_SPACE_WARP
+      if (state.spaceWarp.enabled) {
+        beginSpaceWarp(canvas);
+      } else {
+        Attachment color = lovrCanvasGetAttachments(canvas, NULL)[0];
+        lovrCanvasSetAttachments(canvas, &color, 1);
+        lovrGraphicsSetBackbuffer(canvas, true, true);
+      }
+#else
+      lovrGraphicsSetBackbuffer(canvas, true, true);
+#endif
+
+      lovrCanvasSetWidth(canvas, width * state.resolution.viewsPerRow);
+      lovrCanvasSetHeight(canvas, height);
+
+      if (state.lateLatching) lovrGraphicsSetViewLatch(latchViews);
+      lovrGraphicsPushProfile(PROFILE_LABEL);
       callback(userdata);
+      lovrGraphicsPopProfile();
+      if (state.lateLatching) lovrGraphicsSetViewLatch(NULL);
       lovrGraphicsSetBackbuffer(NULL, false, false);
+      lovrGraphicsSetViewMask(NULL, 0);
+
+      if (depth) {
+        XR(xrReleaseSwapchainImage(state.depth.swapchain, NULL));
+      }
+
+      for (uint32_t i = 0; i < 2; i++) {
+        state.layerViews[i].subImage.imageRect.extent.width = width;
+        state.layerViews[i].subImage.imageRect.extent.height = height;
+      }
+#if defined(XR_USE_GRAPHICS_API_OPENGL)
+      state.layerViews[1].subImage.imageRect.offset.x = width;
+#endif
+
+      // Depth info and SpaceWarp info are both chained to the views when they're used together
+      for (uint32_t i = 0; i < 2; i++) {
+        const void* next = NULL;
+
+#ifdef LOVR_XR_SPACE_WARP
+        if (state.spaceWarp.enabled) {
+          lovrGraphicsSetPreviousViewProjection(i, NULL);
+          state.spaceWarp.info[i] = (XrCompositionLayerSpaceWarpInfoFB) {
+            .type = XR_TYPE_COMPOSITION_LAYER_SPACE_WARP_INFO_FB,
+            .motionVectorSubImage = { state.spaceWarp.motionSwapchain, { { 0, 0 }, { width, height } }, i },
+            .appSpaceDeltaPose = { { 0.f, 0.f, 0.f, 1.f }, { 0.f, 0.f, 0.f } },
+            .depthSubImage = { state.depth.swapchain, { { 0, 0 }, { width, height } }, i },
+            .minDepth = 0.f,
+            .maxDepth = 1.f,
+            .nearZ = state.clipNear,
+            .farZ = state.clipFar
+          };
+
+          // The views of the last latch are the ones that were rendered
+          float viewMatrix[16];
+          getViewMatrix(viewMatrix, &state.views[i]);
+          mat4_init(state.spaceWarp.viewProjection[i], projection[i]);
+          mat4_mul(state.spaceWarp.viewProjection[i], viewMatrix);
+          next = &state.spaceWarp.info[i];
+        }
+#endif
 
-      endInfo.layerCount = 1;
-      state.layerViews[0].pose = views[0].pose;
-      state.layerViews[0].fov = views[0].fov;
-      state.layerViews[1].pose = views[1].pose;
-      state.layerViews[1].fov = views[1].fov;
+        if (state.depth.enabled) {
+          XrSwapchainSubImage subImage = state.layerViews[i].subImage;
+          subImage.swapchain = state.depth.swapchain;
+          state.depth.info[i] = (XrCompositionLayerDepthInfoKHR) {
+            .type = XR_TYPE_COMPOSITION_LAYER_DEPTH_INFO_KHR,
+            .next = next,
+            .subImage = subImage,
+            .minDepth = 0.f,
+            .maxDepth = 1.f,
+            .nearZ = state.clipNear,
+            .farZ = state.clipFar
+          };
+          next = &state.depth.info[i];
+        }
+
+        state.layerViews[i].next = next;
+        state.layerViews[i].pose = state.views[i].pose;
+        state.layerViews[i].fov = state.views[i].fov;
+      }
+
+#ifdef LOVR_XR_SPACE_WARP
+      if (state.spaceWarp.enabled) {
+        state.spaceWarp.hasPrevious = true;
+        XR(xrReleaseSwapchainImage(state.spaceWarp.motionSwapchain, NULL));
+      }
+#endif
+
+      layers[endInfo.layerCount++] = (XrCompositionLayerBaseHeader*) &state.layers[0];
     }
 
     XR(xrReleaseSwapchainImage(state.swapchain, NULL));
   }
 
+  // Layers are composited on top of the eye buffers, in the order they were created
+  for (uint32_t i = 0; i < state.compositionLayerCount; i++) {
+    Layer* layer = state.compositionLayers[i];
+    LayerData* data = layer->data;
+
+    if (!layer->visible || !layer->rendered) {
+      continue;
+    }
+
+    XrCompositionLayerFlags flags = XR_COMPOSITION_LAYER_BLEND_TEXTURE_SOURCE_ALPHA_BIT | XR_COMPOSITION_LAYER_UNPREMULTIPLIED_ALPHA_BIT;
+    XrSwapchainSubImage subImage = { data->swapchain, { { 0, 0 }, { layer->width, layer->height } }, 0 };
+    XrPosef pose = {
+      .orientation = { layer->orientation[0], layer->orientation[1], layer->orientation[2], layer->orientation[3] },
+      .position = { layer->position[0], layer->position[1], layer->position[2] }
+    };
+
+    switch (layer->type) {
+      case LAYER_QUAD:
+        compositionLayers[i].quad = (XrCompositionLayerQuad) {
+          .type = XR_TYPE_COMPOSITION_LAYER_QUAD,
+          .layerFlags = flags,
+          .space = state.referenceSpace,
+          .eyeVisibility = XR_EYE_VISIBILITY_BOTH,
+          .subImage = subImage,
+          .pose = pose,
+          .size = { layer->size[0], layer->size[1] }
+        };
+        break;
+#ifdef XR_KHR_composition_layer_cylinder
+      case LAYER_CYLINDER:
+        compositionLayers[i].cylinder = (XrCompositionLayerCylinderKHR) {
+          .type = XR_TYPE_COMPOSITION_LAYER_CYLINDER_KHR,
+          .layerFlags = flags,
+          .space = state.referenceSpace,
+          .eyeVisibility = XR_EYE_VISIBILITY_BOTH,
+          .subImage = subImage,
+          .pose = pose,
+          .radius = layer->radius,
+          .centralAngle = layer->size[0] / layer->radius,
+          .aspectRatio = layer->size[0] / layer->size[1]
+        };
+        break;
+#endif
+      default: continue;
+    }
+
+    layers[endInfo.layerCount++] = (XrCompositionLayerBaseHeader*) &compositionLayers[i];
+  }
+
   XR(xrEndFrame(state.session, &endInfo));
   lovrGpuDirtyTexture();
+
+  state.timing.last.frameWait = state.timing.frameWait;
+  state.timing.last.swapchainWait = state.timing.swapchainWait;
+  state.timing.last.gpuTime = getRenderGpuTime();
+  state.timing.last.compositorCpuTime = -1.;
+  state.timing.last.compositorGpuTime = -1.;
+  state.timing.frameWait = 0.;
+  state.timing.swapchainWait = 0.;
+  state.timing.valid = true;
+
+#ifndef LOVR_DISABLE_THREAD
+  if (state.pipeline.enabled) {
+    startFrameWait();
+  }
+#endif
 }
 
 static Texture* openxr_getMirrorTexture(void) {
@@ -938,6 +1873,11 @@ static void openxr_update(float dt) {
             break;
 
           case XR_SESSION_STATE_STOPPING:
+#ifndef LOVR_DISABLE_THREAD
+            if (state.pipeline.enabled) {
+              finishFrameWait();
+            }
+#endif
             XR(xrEndSession(state.session));
             break;
 
@@ -959,12 +1899,29 @@ static void openxr_update(float dt) {
         break;
       }
 
+      case XR_TYPE_EVENT_DATA_VISIBILITY_MASK_CHANGED_KHR:
+        state.viewMask.dirty = state.features.visibilityMask;
+        break;
+
       default: break;
     }
   }
 
   if (SESSION_ACTIVE(state.sessionState)) {
+    double start = os_get_time();
+#ifndef LOVR_DISABLE_THREAD
+    if (state.pipeline.enabled && state.pipeline.pending) {
+      state.frameState.predictedDisplayTime += state.frameState.predictedDisplayPeriod;
+    } else if (state.pipeline.enabled) {
+      startFrameWait();
+      XR(finishFrameWait());
+    } else {
+      XR(xrWaitFrame(state.session, NULL, &state.frameState));
+    }
+#else
     XR(xrWaitFrame(state.session, NULL, &state.frameState));
+#endif
+    state.timing.frameWait += os_get_time() - start;
 
     XrActionsSyncInfo syncInfo = {
       .type = XR_TYPE_ACTIONS_SYNC_INFO,
@@ -993,6 +1950,17 @@ HeadsetInterface lovrHeadsetOpenXRDriver = {
   .getViewAngles = openxr_getViewAngles,
   .getClipDistance = openxr_getClipDistance,
   .setClipDistance = openxr_setClipDistance,
+  .setFoveation = openxr_setFoveation,
+  .setDynamicResolution = openxr_setDynamicResolution,
+  .getResolutionScale = openxr_getResolutionScale,
+  .setSpaceWarp = openxr_setSpaceWarp,
+  .setDepthSubmission = openxr_setDepthSubmission,
+  .setLateLatching = openxr_setLateLatching,
+  .getFrameTiming = openxr_getFrameTiming,
+  .newLayer = openxr_newLayer,
+  .destroyLayer = openxr_destroyLayer,
+  .acquireLayer = openxr_acquireLayer,
+  .releaseLayer = openxr_releaseLayer,
   .getBoundsDimensions = openxr_getBoundsDimensions,
   .getBoundsGeometry = openxr_getBoundsGeometry,
   .getPose = openxr_getPose,
@@ -50,9 +50,13 @@ static struct {
   uint32_t changedButtons[2];
   float hapticStrength[2];
   float hapticDuration[2];
+  FoveationLevel foveation;
+  bool dynamicFoveation;
+  FrameTiming timing;
+  bool timingValid;
 } state;
 
-static bool vrapi_init(float supersample, float offset, uint32_t msaa, bool overlay) {
+static bool vrapi_init(float supersample, float offset, uint32_t msaa, bool overlay, bool pipelined) {
   ANativeActivity* activity = os_get_activity();
   JNIEnv* jni = os_get_jni();
   state.java.Vm = activity->vm;
@@ -149,6 +153,21 @@ static void vrapi_setClipDistance(float clipNear, float clipFar) {
   // Unsupported
 }
 
+// Foveation is a property of the VR mode, so it's applied again whenever VR mode is entered
+static void applyFoveation(void) {
+  vrapi_SetPropertyInt(&state.java, VRAPI_FOVEATION_LEVEL, (int) state.foveation);
+  vrapi_SetPropertyInt(&state.java, VRAPI_DYNAMIC_FOVEATION_ENABLED, state.dynamicFoveation);
+}
+
+static bool vrapi_setFoveation(FoveationLevel level, bool dynamic) {
+  state.foveation = level;
+  state.dynamicFoveation = dynamic;
+  if (state.session) {
+    applyFoveation();
+  }
+  return true;
+}
+
 static void vrapi_getBoundsDimensions(float* width, float* depth) {
   ovrPosef pose;
   ovrVector3f scale;
@@ -686,10 +705,23 @@ static void vrapi_renderTo(void (*callback)(void*), void* userdata) {
     .Layers = (const ovrLayerHeader2*[]) { &layer.Header }
   };
 
+  // VrApi paces frames by blocking in vrapi_SubmitFrame2, it doesn't report compositor times
+  double start = os_get_time();
   vrapi_SubmitFrame2(state.session, &frame);
+  state.timing.frameWait = os_get_time() - start;
+  state.timing.swapchainWait = -1.;
+  state.timing.gpuTime = -1.;
+  state.timing.compositorCpuTime = -1.;
+  state.timing.compositorGpuTime = -1.;
+  state.timingValid = true;
   state.swapchainIndex = (state.swapchainIndex + 1) % state.swapchainLength;
 }
 
+static bool vrapi_getFrameTiming(FrameTiming* timing) {
+  *timing = state.timing;
+  return state.timingValid;
+}
+
 static void vrapi_update(float dt) {
   int appState = os_get_activity_state();
   ANativeWindow* window = os_get_native_window();
@@ -707,6 +739,7 @@ static void vrapi_update(float dt) {
     state.frameIndex = 0;
     vrapi_SetTrackingSpace(state.session, VRAPI_TRACKING_SPACE_LOCAL_FLOOR);
     state.offset = 0.f;
+    applyFoveation();
   } else if (state.session && (appState != APP_CMD_RESUME || !window)) {
     vrapi_LeaveVrMode(state.session);
     state.session = NULL;
@@ -731,8 +764,15 @@ static void vrapi_update(float dt) {
   }
 
   // Tracking
+  double previousDisplayTime = state.displayTime;
   state.frameIndex++;
   state.displayTime = vrapi_GetPredictedDisplayTime(state.session, state.frameIndex);
+
+  // A display time more than a refresh after the previous one means the previous frame was shown again
+  double period = 1. / vrapi_getDisplayFrequency();
+  if (state.frameIndex > 1 && state.displayTime - previousDisplayTime > period * 1.5) {
+    state.timing.missedFrames += (uint32_t) ((state.displayTime - previousDisplayTime) / period + .5) - 1;
+  }
   state.tracking[DEVICE_HEAD] = vrapi_GetPredictedTracking(state.session, state.displayTime);
 
   // Sort out the controller devices
@@ -805,6 +845,8 @@ HeadsetInterface lovrHeadsetVrApiDriver = {
   .getViewAngles = vrapi_getViewAngles,
   .getClipDistance = vrapi_getClipDistance,
   .setClipDistance = vrapi_setClipDistance,
+  .setFoveation = vrapi_setFoveation,
+  .getFrameTiming = vrapi_getFrameTiming,
   .getBoundsDimensions = vrapi_getBoundsDimensions,
   .getBoundsGeometry = vrapi_getBoundsGeometry,
   .getPose = vrapi_getPose,
@@ -4,13 +4,18 @@
 #include <stdlib.h>
 #include <math.h>
 
+#define ARC_LENGTH_SAMPLES 256
+
 struct Curve {
   uint32_t ref;
   arr_t(float) points;
+  arr_t(float) weights;
+  arr_t(float) lengths;
 };
 
-// Explicit curve evaluation, unroll simple cases to avoid pow overhead
-static void evaluate(float* LOVR_RESTRICT P, size_t n, float t, vec3 p) {
+// Explicit curve evaluation, unroll simple cases to avoid pow overhead.  Higher degrees use Horner's
+// method on the Bernstein form, with binomial weights that are computed here if they aren't cached.
+static void evaluate(float* LOVR_RESTRICT P, size_t n, float t, vec3 p, const float* weights) {
   if (n == 2) {
     p[0] = P[0] + (P[4] - P[0]) * t;
     p[1] = P[1] + (P[5] - P[1]) * t;
@@ -36,24 +41,90 @@ static void evaluate(float* LOVR_RESTRICT P, size_t n, float t, vec3 p) {
     p[2] = a * P[2] + b * P[6] + c * P[10] + d * P[14];
     p[3] = a * P[3] + b * P[7] + c * P[11] + d * P[15];
   } else {
+    // Sum of b[i] * t^i * (1-t)^(d-i) * P[i], factored so there's only one power.  The sum runs
+    // from whichever end keeps the ratio u below 1.
+    size_t d = n - 1;
+    bool reverse = t > .5f;
+    float a = reverse ? t : 1.f - t;
+    float u = reverse ? (1.f - t) / t : t / (1.f - t);
+    float scale = 1.f;
+    for (size_t i = 0; i < d; i++) {
+      scale *= a;
+    }
+
     float b = 1.f;
-    p[0] = p[1] = p[2] = p[3] = 0.f;
-    for (size_t i = 0; i < n; i++, b *= (float) (n - i) / i) {
-      float c1 = powf(1 - t, n - (i + 1));
-      float c2 = powf(t, i);
-      p[0] += b * c1 * c2 * P[i * 4 + 0];
-      p[1] += b * c1 * c2 * P[i * 4 + 1];
-      p[2] += b * c1 * c2 * P[i * 4 + 2];
-      p[3] += b * c1 * c2 * P[i * 4 + 3];
+    float acc[4] = { 0.f };
+    for (size_t k = 0; k < n; k++) {
+      size_t i = reverse ? k : d - k;
+      float w = weights ? weights[i] : b;
+      acc[0] = acc[0] * u + w * P[i * 4 + 0];
+      acc[1] = acc[1] * u + w * P[i * 4 + 1];
+      acc[2] = acc[2] * u + w * P[i * 4 + 2];
+      acc[3] = acc[3] * u + w * P[i * 4 + 3];
+      b *= (float) (d - k) / (k + 1); // Binomial weights are symmetric, so either direction works
     }
+
+    p[0] = acc[0] * scale;
+    p[1] = acc[1] * scale;
+    p[2] = acc[2] * scale;
+    p[3] = acc[3] * scale;
   }
 }
 
+// Binomial weights for the current point count, and a table of arc lengths at evenly spaced
+// parameters.  Both are rebuilt lazily, after the points change.
+static const float* getWeights(Curve* curve) {
+  size_t n = curve->points.length / 4;
+  if (n <= 4) return NULL;
+  if (curve->weights.length != n) {
+    arr_reserve(&curve->weights, n);
+    curve->weights.length = n;
+    float b = 1.f;
+    for (size_t i = 0; i < n; i++) {
+      curve->weights.data[i] = b;
+      b *= (float) (n - 1 - i) / (i + 1);
+    }
+  }
+  return curve->weights.data;
+}
+
+static float* getLengths(Curve* curve) {
+  if (curve->lengths.length == 0) {
+    size_t n = curve->points.length / 4;
+    const float* weights = getWeights(curve);
+    arr_reserve(&curve->lengths, ARC_LENGTH_SAMPLES + 1);
+    curve->lengths.length = ARC_LENGTH_SAMPLES + 1;
+    float previous[4];
+    evaluate(curve->points.data, n, 0.f, previous, weights);
+    curve->lengths.data[0] = 0.f;
+    for (size_t i = 1; i <= ARC_LENGTH_SAMPLES; i++) {
+      float point[4];
+      evaluate(curve->points.data, n, (float) i / ARC_LENGTH_SAMPLES, point, weights);
+      curve->lengths.data[i] = curve->lengths.data[i - 1] + vec3_distance(point, previous);
+      vec3_init(previous, point);
+    }
+  }
+  return curve->lengths.data;
+}
+
+// Arc length from the start of the curve to t, interpolated from the table
+static float getDistance(const float* lengths, float t) {
+  float x = t * ARC_LENGTH_SAMPLES;
+  size_t i = MIN((size_t) x, ARC_LENGTH_SAMPLES - 1);
+  return lengths[i] + (lengths[i + 1] - lengths[i]) * (x - i);
+}
+
+static void invalidate(Curve* curve) {
+  curve->lengths.length = 0;
+}
+
 Curve* lovrCurveCreate(void) {
   Curve* curve = calloc(1, sizeof(Curve));
   lovrAssert(curve, "Out of memory");
-  curve->ref = 1;
+  curve->ref = LOVR_REF_LOCAL | 1;
   arr_init(&curve->points, realloc);
+  arr_init(&curve->weights, realloc);
+  arr_init(&curve->lengths, realloc);
   arr_reserve(&curve->points, 16);
   return curve;
 }
@@ -61,20 +132,61 @@ Curve* lovrCurveCreate(void) {
 void lovrCurveDestroy(void* ref) {
   Curve* curve = ref;
   arr_free(&curve->points);
+  arr_free(&curve->weights);
+  arr_free(&curve->lengths);
   free(curve);
 }
 
 void lovrCurveEvaluate(Curve* curve, float t, vec3 p) {
   lovrAssert(curve->points.length >= 8, "Need at least 2 points to evaluate a Curve");
   lovrAssert(t >= 0.f && t <= 1.f, "Curve evaluation interval must be within [0, 1]");
-  evaluate(curve->points.data, curve->points.length / 4, t, p);
+  evaluate(curve->points.data, curve->points.length / 4, t, p, getWeights(curve));
+}
+
+// Samples are evenly spaced in t, or in distance along the curve when even is set.  Even samples
+// walk the arc length table and interpolate the parameter within each of its segments.
+void lovrCurveRender(Curve* curve, float t1, float t2, float* points, uint32_t count, bool even) {
+  lovrAssert(curve->points.length >= 8, "Need at least 2 points to evaluate a Curve");
+  lovrAssert(t1 >= 0.f && t2 <= 1.f, "Curve evaluation interval must be within [0, 1]");
+  size_t n = curve->points.length / 4;
+  const float* weights = getWeights(curve);
+  float step = count > 1 ? 1.f / (count - 1) : 0.f;
+
+  if (!even) {
+    for (uint32_t i = 0; i < count; i++) {
+      evaluate(curve->points.data, n, t1 + (t2 - t1) * i * step, points + 4 * i, weights);
+    }
+    return;
+  }
+
+  float* lengths = getLengths(curve);
+  float d1 = getDistance(lengths, t1);
+  float d2 = getDistance(lengths, t2);
+  size_t segment = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    float distance = d1 + (d2 - d1) * i * step;
+    while (segment < ARC_LENGTH_SAMPLES - 1 && lengths[segment + 1] < distance) {
+      segment++;
+    }
+    float span = lengths[segment + 1] - lengths[segment];
+    float f = span > 0.f ? CLAMP((distance - lengths[segment]) / span, 0.f, 1.f) : 0.f;
+    float t = (segment + f) / ARC_LENGTH_SAMPLES;
+    evaluate(curve->points.data, n, t, points + 4 * i, weights);
+  }
+}
+
+float lovrCurveGetLength(Curve* curve, float t1, float t2) {
+  lovrAssert(curve->points.length >= 8, "Need at least 2 points to measure a Curve");
+  lovrAssert(t1 >= 0.f && t2 <= 1.f, "Curve interval must be within [0, 1]");
+  float* lengths = getLengths(curve);
+  return getDistance(lengths, t2) - getDistance(lengths, t1);
 }
 
 void lovrCurveGetTangent(Curve* curve, float t, vec3 p) {
   float q[4];
   size_t n = curve->points.length / 4;
-  evaluate(curve->points.data, n - 1, t, q);
-  evaluate(curve->points.data + 4, n - 1, t, p);
+  evaluate(curve->points.data, n - 1, t, q, NULL);
+  evaluate(curve->points.data + 4, n - 1, t, p, NULL);
   vec3_add(p, vec3_scale(q, -1.f));
   vec3_normalize(p);
 }
@@ -91,7 +203,7 @@ Curve* lovrCurveSlice(Curve* curve, float t1, float t2) {
 
   // Right half of split at t1
   for (size_t i = 0; i < n - 1; i++) {
-    evaluate(curve->points.data + 4 * i, n - i, t1, new->points.data + 4 * i);
+    evaluate(curve->points.data + 4 * i, n - i, t1, new->points.data + 4 * i, NULL);
   }
 
   vec3_init(new->points.data + 4 * (n - 1), curve->points.data + 4 * (n - 1));
@@ -99,7 +211,7 @@ Curve* lovrCurveSlice(Curve* curve, float t1, float t2) {
   // Split segment at t2, taking left half
   float t = (t2 - t1) / (1.f - t1);
   for (size_t i = n - 1; i >= 1; i--) {
-    evaluate(new->points.data, i + 1, t, new->points.data + 4 * i);
+    evaluate(new->points.data, i + 1, t, new->points.data + 4 * i, NULL);
   }
 
   return new;
@@ -115,6 +227,7 @@ void lovrCurveGetPoint(Curve* curve, size_t index, vec3 point) {
 
 void lovrCurveSetPoint(Curve* curve, size_t index, vec3 point) {
   vec3_init(curve->points.data + 4 * index, point);
+  invalidate(curve);
 }
 
 void lovrCurveAddPoint(Curve* curve, vec3 point, size_t index) {
@@ -131,8 +244,10 @@ void lovrCurveAddPoint(Curve* curve, vec3 point, size_t index) {
   // Fill the empty space with the new point
   curve->points.length += 4;
   memcpy(dest, point, 4 * sizeof(float));
+  invalidate(curve);
 }
 
 void lovrCurveRemovePoint(Curve* curve, size_t index) {
   arr_splice(&curve->points, index * 4, 4);
+  invalidate(curve);
 }
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -6,6 +7,8 @@ Curve* lovrCurveCreate(void);
 void lovrCurveDestroy(void* ref);
 void lovrCurveEvaluate(Curve* curve, float t, float point[4]);
 void lovrCurveGetTangent(Curve* curve, float t, float point[4]);
+void lovrCurveRender(Curve* curve, float t1, float t2, float* points, uint32_t count, bool even);
+float lovrCurveGetLength(Curve* curve, float t1, float t2);
 Curve* lovrCurveSlice(Curve* curve, float t1, float t2);
 size_t lovrCurveGetPointCount(Curve* curve);
 void lovrCurveGetPoint(Curve* curve, size_t index, float point[4]);
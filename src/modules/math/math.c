@@ -8,6 +8,10 @@
 #include <stdlib.h>
 #include <time.h>
 
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
+
 static struct {
   bool initialized;
   RandomGenerator* generator;
@@ -62,3 +66,118 @@ float lovrMathNoise3(float x, float y, float z) {
 float lovrMathNoise4(float x, float y, float z, float w) {
   return noise4(x, y, z, w) * .5f + .5f;
 }
+
+typedef struct {
+  float* data;
+  uint32_t width;
+  NoiseInfo* info;
+} NoiseGrid;
+
+// Octaves are summed one row at a time, so the inner loops stay simple enough to vectorize
+static void fillNoiseRows(void* context, uint32_t start, uint32_t end) {
+  NoiseGrid* grid = context;
+  NoiseInfo* info = grid->info;
+  for (uint32_t row = start; row < end; row++) {
+    float* values = grid->data + (size_t) row * grid->width;
+    memset(values, 0, grid->width * sizeof(float));
+    float frequency = info->scale;
+    float amplitude = 1.f;
+    float total = 0.f;
+    for (uint32_t octave = 0; octave < info->octaves; octave++) {
+      float y = (info->y + row) * frequency;
+      float z = info->z * frequency;
+      for (uint32_t i = 0; i < grid->width; i++) {
+        float x = (info->x + i) * frequency;
+        values[i] += amplitude * (info->volume ? noise3(x, y, z) : noise2(x, y));
+      }
+      total += amplitude;
+      frequency *= info->lacunarity;
+      amplitude *= info->gain;
+    }
+    float scale = total > 0.f ? .5f / total : 0.f;
+    for (uint32_t i = 0; i < grid->width; i++) {
+      values[i] = values[i] * scale + .5f;
+    }
+  }
+}
+
+// Fills a grid with fractal noise in the same [0, 1] range as lovrMathNoise, rows are split across
+// the job pool
+void lovrMathNoiseFill(float* data, uint32_t width, uint32_t height, NoiseInfo* info) {
+  NoiseGrid grid = { data, width, info };
+#ifndef LOVR_DISABLE_THREAD
+  uint32_t grain = MAX(4096 / MAX(width, 1), 1);
+  lovrThreadPoolParallelFor(fillNoiseRows, &grid, height, grain);
+#else
+  fillNoiseRows(&grid, 0, height);
+#endif
+}
+
+// Batch kernels work in place on arrays of floats, stride is the number of bytes between elements
+
+void lovrMathTransformPoints(float* transform, float* points, uint32_t count, size_t stride) {
+  char* p = (char*) points;
+  for (uint32_t i = 0; i < count; i++, p += stride) {
+    float* v = (float*) p;
+#ifdef MAF_SIMD
+    float r[4];
+    maf_store(r, maf_add(maf_transform3(transform, v), maf_load(transform + 12)));
+    float w = 1.f / r[3];
+    v[0] = r[0] * w;
+    v[1] = r[1] * w;
+    v[2] = r[2] * w;
+#else
+    float x = v[0] * transform[0] + v[1] * transform[4] + v[2] * transform[8] + transform[12];
+    float y = v[0] * transform[1] + v[1] * transform[5] + v[2] * transform[9] + transform[13];
+    float z = v[0] * transform[2] + v[1] * transform[6] + v[2] * transform[10] + transform[14];
+    float w = 1.f / (v[0] * transform[3] + v[1] * transform[7] + v[2] * transform[11] + transform[15]);
+    v[0] = x * w;
+    v[1] = y * w;
+    v[2] = z * w;
+#endif
+  }
+}
+
+void lovrMathNormalizeVectors(float* vectors, uint32_t count, size_t stride) {
+  char* p = (char*) vectors;
+  for (uint32_t i = 0; i < count; i++, p += stride) {
+    float* v = (float*) p;
+    float length2 = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+    if (length2 != 0.f) {
+      float scale = 1.f / sqrtf(length2);
+      v[0] *= scale;
+      v[1] *= scale;
+      v[2] *= scale;
+    }
+  }
+}
+
+// Targets with a stride of zero slerp every quaternion towards the same target
+void lovrMathSlerpQuaternions(float* quaternions, float* targets, float t, uint32_t count, size_t stride, size_t targetStride) {
+  char* p = (char*) quaternions;
+  char* q = (char*) targets;
+  for (uint32_t i = 0; i < count; i++, p += stride, q += targetStride) {
+    quat_slerp((float*) p, (float*) q, t);
+  }
+}
+
+void lovrMathGetBounds(float* points, uint32_t count, size_t stride, float bounds[6]) {
+  float min[3] = { HUGE_VALF, HUGE_VALF, HUGE_VALF };
+  float max[3] = { -HUGE_VALF, -HUGE_VALF, -HUGE_VALF };
+  const char* p = (const char*) points;
+  for (uint32_t i = 0; i < count; i++, p += stride) {
+    const float* v = (const float*) p;
+    min[0] = MIN(min[0], v[0]);
+    max[0] = MAX(max[0], v[0]);
+    min[1] = MIN(min[1], v[1]);
+    max[1] = MAX(max[1], v[1]);
+    min[2] = MIN(min[2], v[2]);
+    max[2] = MAX(max[2], v[2]);
+  }
+  bounds[0] = min[0];
+  bounds[1] = max[0];
+  bounds[2] = min[1];
+  bounds[3] = max[1];
+  bounds[4] = min[2];
+  bounds[5] = max[2];
+}
@@ -1,9 +1,22 @@
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #pragma once
 
 struct RandomGenerator;
 
+typedef struct {
+  float x;
+  float y;
+  float z;
+  float scale;
+  float lacunarity;
+  float gain;
+  uint32_t octaves;
+  bool volume;
+} NoiseInfo;
+
 bool lovrMathInit(void);
 void lovrMathDestroy(void);
 struct RandomGenerator* lovrMathGetRandomGenerator(void);
@@ -13,3 +26,8 @@ float lovrMathNoise1(float x);
 float lovrMathNoise2(float x, float y);
 float lovrMathNoise3(float x, float y, float z);
 float lovrMathNoise4(float x, float y, float z, float w);
+void lovrMathNoiseFill(float* data, uint32_t width, uint32_t height, NoiseInfo* info);
+void lovrMathTransformPoints(float* transform, float* points, uint32_t count, size_t stride);
+void lovrMathNormalizeVectors(float* vectors, uint32_t count, size_t stride);
+void lovrMathSlerpQuaternions(float* quaternions, float* targets, float t, uint32_t count, size_t stride, size_t targetStride);
+void lovrMathGetBounds(float* points, uint32_t count, size_t stride, float bounds[6]);
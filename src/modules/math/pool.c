@@ -33,7 +33,7 @@ void lovrPoolDestroy(void* ref) {
 }
 
 void lovrPoolGrow(Pool* pool, size_t count) {
-  lovrAssert(count <= (1 << 16), "Temporary vector space exhausted.  Try using lovr.math.drain to drain the vector pool periodically.");
+  lovrAssert(count <= MAX_POOL_SIZE, "Temporary vector space exhausted.  Try using lovr.math.drain to drain the vector pool periodically.");
   pool->count = count;
   pool->data = realloc(pool->data, pool->count * sizeof(float));
   lovrAssert(pool->data, "Out of memory");
@@ -43,16 +43,11 @@ Vector lovrPoolAllocate(Pool* pool, VectorType type, float** data) {
   size_t count = vectorComponents[type];
 
   if (pool->cursor + count > pool->count) {
-    lovrPoolGrow(pool, pool->count * 2);
+    lovrPoolGrow(pool, MIN(pool->count * 2, MAX_POOL_SIZE));
+    lovrAssert(pool->cursor + count <= pool->count, "Temporary vector space exhausted.  Try using lovr.math.drain to drain the vector pool periodically.");
   }
 
-  Vector v = {
-    .handle = {
-      .type = type,
-      .generation = (uint8_t) pool->generation,
-      .index = (uint16_t) pool->cursor
-    }
-  };
+  Vector v = { .bits = (uintptr_t) type | ((uintptr_t) pool->generation << 4) | ((uintptr_t) pool->cursor << 12) };
 
   *data = pool->data + pool->cursor;
   pool->cursor += count;
@@ -60,8 +55,8 @@ Vector lovrPoolAllocate(Pool* pool, VectorType type, float** data) {
 }
 
 float* lovrPoolResolve(Pool* pool, Vector vector) {
-  lovrAssert(vector.handle.generation == pool->generation, "Attempt to use a vector in a different generation than the one it was created in (vectors can not be saved into variables)");
-  return pool->data + vector.handle.index;
+  lovrAssert(VECTOR_GENERATION(vector) == pool->generation, "Attempt to use a vector in a different generation than the one it was created in (vectors can not be saved into variables)");
+  return pool->data + VECTOR_INDEX(vector);
 }
 
 void lovrPoolDrain(Pool* pool) {
@@ -13,16 +13,25 @@ typedef enum {
   MAX_VECTOR_TYPES
 } VectorType;
 
+// Temporary vectors are light userdata with the type, generation, and index packed into the
+// pointer.  Everything stays in the low 39 bits since LuaJIT can't store wider light userdata.
+#if UINTPTR_MAX > 0xffffffffu
+#define VECTOR_INDEX_BITS 27
+#else
+#define VECTOR_INDEX_BITS 20
+#endif
+
+#define MAX_POOL_SIZE ((size_t) 1 << VECTOR_INDEX_BITS)
+
 typedef union {
   void* pointer;
-  struct {
-    uint8_t type;
-    uint8_t generation;
-    uint16_t index;
-    uint32_t padding;
-  } handle;
+  uintptr_t bits;
 } Vector;
 
+#define VECTOR_TYPE(v) ((VectorType) ((v).bits & 0xf))
+#define VECTOR_GENERATION(v) ((uint8_t) ((v).bits >> 4))
+#define VECTOR_INDEX(v) ((size_t) ((v).bits >> 12))
+
 typedef struct Pool Pool;
 Pool* lovrPoolCreate(void);
 void lovrPoolDestroy(void* ref);
@@ -3,8 +3,13 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#endif
+
 struct RandomGenerator {
   uint32_t ref;
   Seed seed;
@@ -73,16 +78,25 @@ int lovrRandomGeneratorSetState(RandomGenerator* generator, const char* state) {
   }
 }
 
-double lovrRandomGeneratorRandom(RandomGenerator* generator) {
-  generator->state.b64 ^= (generator->state.b64 >> 12);
-  generator->state.b64 ^= (generator->state.b64 << 25);
-  generator->state.b64 ^= (generator->state.b64 >> 27);
-  uint64_t r = generator->state.b64 * 2685821657736338717ULL;
+static uint64_t xorshift(uint64_t x) {
+  x ^= (x >> 12);
+  x ^= (x << 25);
+  x ^= (x >> 27);
+  return x;
+}
+
+static double toDouble(uint64_t state) {
+  uint64_t r = state * 2685821657736338717ULL;
   union { uint64_t i; double d; } u;
   u.i = ((0x3FFULL) << 52) | (r >> 12);
   return u.d - 1.;
 }
 
+double lovrRandomGeneratorRandom(RandomGenerator* generator) {
+  generator->state.b64 = xorshift(generator->state.b64);
+  return toDouble(generator->state.b64);
+}
+
 double lovrRandomGeneratorRandomNormal(RandomGenerator* generator) {
   if (generator->lastRandomNormal != HUGE_VAL) {
     double r = generator->lastRandomNormal;
@@ -97,3 +111,120 @@ double lovrRandomGeneratorRandomNormal(RandomGenerator* generator) {
   generator->lastRandomNormal = r * cos(phi);
   return r * sin(phi);
 }
+
+// The xorshift step is linear over GF(2), so skipping ahead is a 64x64 bit matrix multiplication.
+// Matrices are stored as columns, and a step count is applied by repeated squaring.
+typedef uint64_t Matrix[64];
+
+static uint64_t transform(const Matrix m, uint64_t x) {
+  uint64_t result = 0;
+  for (uint32_t i = 0; x; i++, x >>= 1) {
+    if (x & 1) result ^= m[i];
+  }
+  return result;
+}
+
+static void getJumpMatrix(uint64_t steps, Matrix jump) {
+  Matrix power, tmp;
+  for (uint32_t i = 0; i < 64; i++) {
+    power[i] = xorshift(1ull << i);
+    jump[i] = 1ull << i;
+  }
+
+  while (steps) {
+    if (steps & 1) {
+      for (uint32_t i = 0; i < 64; i++) tmp[i] = transform(power, jump[i]);
+      memcpy(jump, tmp, sizeof(Matrix));
+    }
+
+    steps >>= 1;
+
+    if (steps) {
+      for (uint32_t i = 0; i < 64; i++) tmp[i] = transform(power, power[i]);
+      memcpy(power, tmp, sizeof(Matrix));
+    }
+  }
+}
+
+// Advances the generator as if it generated this many numbers, so generators with the same seed can
+// be jumped by different amounts to get independent streams
+void lovrRandomGeneratorJump(RandomGenerator* generator, uint64_t steps) {
+  Matrix jump;
+  getJumpMatrix(steps, jump);
+  generator->state.b64 = transform(jump, generator->state.b64);
+  generator->lastRandomNormal = HUGE_VAL;
+}
+
+// Fills are split into fixed size blocks, each starting from the state the stream would be in at
+// that point, so the results are the same no matter how many threads are used.  Uniform fills
+// match calling lovrRandomGeneratorRandom repeatedly.
+
+#define FILL_BLOCK_SIZE 4096
+
+typedef struct {
+  float* data;
+  uint64_t* states;
+  uint32_t count;
+  RandomDistribution distribution;
+  float a;
+  float b;
+} FillContext;
+
+static void fillBlocks(void* arg, uint32_t start, uint32_t end) {
+  FillContext* context = arg;
+  for (uint32_t block = start; block < end; block++) {
+    uint64_t state = context->states[block];
+    uint32_t offset = block * FILL_BLOCK_SIZE;
+    float* data = context->data + offset;
+    uint32_t count = MIN(context->count - offset, FILL_BLOCK_SIZE);
+
+    if (context->distribution == DISTRIBUTION_UNIFORM) {
+      float range = context->b - context->a;
+      for (uint32_t i = 0; i < count; i++) {
+        state = xorshift(state);
+        data[i] = context->a + (float) toDouble(state) * range;
+      }
+    } else {
+      for (uint32_t i = 0; i < count; i += 2) {
+        state = xorshift(state);
+        double u = toDouble(state);
+        state = xorshift(state);
+        double v = toDouble(state);
+        double r = sqrt(-2. * log(1. - u));
+        double phi = 2. * M_PI * (1. - v);
+        data[i] = context->b + (float) (r * sin(phi)) * context->a;
+        if (i + 1 < count) data[i + 1] = context->b + (float) (r * cos(phi)) * context->a;
+      }
+    }
+
+    if (offset + count == context->count) {
+      context->states[block + 1] = state;
+    }
+  }
+}
+
+// Uniform samples are in [a, b), normal samples have a standard deviation of a and a mean of b
+void lovrRandomGeneratorFill(RandomGenerator* generator, float* data, uint32_t count, RandomDistribution distribution, float a, float b) {
+  if (count == 0) return;
+  uint32_t blockCount = (count + FILL_BLOCK_SIZE - 1) / FILL_BLOCK_SIZE;
+  uint64_t* states = malloc((blockCount + 1) * sizeof(uint64_t));
+  lovrAssert(states, "Out of memory");
+
+  Matrix jump;
+  getJumpMatrix(FILL_BLOCK_SIZE, jump);
+  states[0] = generator->state.b64;
+  for (uint32_t i = 1; i < blockCount; i++) {
+    states[i] = transform(jump, states[i - 1]);
+  }
+
+  FillContext context = { data, states, count, distribution, a, b };
+#ifndef LOVR_DISABLE_THREAD
+  lovrThreadPoolParallelFor(fillBlocks, &context, blockCount, 4);
+#else
+  fillBlocks(&context, 0, blockCount);
+#endif
+
+  // The last block stores the state it ended with
+  generator->state.b64 = states[blockCount];
+  free(states);
+}
@@ -13,6 +13,11 @@ typedef union {
   } b32;
 } Seed;
 
+typedef enum {
+  DISTRIBUTION_UNIFORM,
+  DISTRIBUTION_NORMAL
+} RandomDistribution;
+
 typedef struct RandomGenerator RandomGenerator;
 RandomGenerator* lovrRandomGeneratorCreate(void);
 void lovrRandomGeneratorDestroy(void* ref);
@@ -22,3 +27,5 @@ void lovrRandomGeneratorGetState(RandomGenerator* generator, char* state, size_t
 int lovrRandomGeneratorSetState(RandomGenerator* generator, const char* state);
 double lovrRandomGeneratorRandom(RandomGenerator* generator);
 double lovrRandomGeneratorRandomNormal(RandomGenerator* generator);
+void lovrRandomGeneratorJump(RandomGenerator* generator, uint64_t steps);
+void lovrRandomGeneratorFill(RandomGenerator* generator, float* data, uint32_t count, RandomDistribution distribution, float a, float b);
@@ -0,0 +1,406 @@
+#include "physics/hull.h"
+#include "core/util.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+// Quickhull.  It starts with a tetrahedron, then keeps adding the point farthest outside one of the
+// faces, replacing all the faces that point can see with a cone of faces from their horizon to the
+// point.  Every point outside the hull is only kept in the list of one face it's in front of, so
+// adding a point only has to look at the points that were outside of the faces it removed.
+
+#define NONE (~0u)
+
+typedef struct {
+  uint32_t v[3];
+  uint32_t neighbors[3]; // The face across the edge from v[i] to v[i + 1]
+  double normal[3];
+  double d;
+  uint32_t outside; // Head of a list of points in front of the face (linked through next)
+  bool visible;
+} Face;
+
+typedef struct {
+  uint32_t face;
+  uint32_t edge;
+} HorizonEdge;
+
+typedef arr_t(Face) arr_face_t;
+typedef arr_t(HorizonEdge) arr_horizon_t;
+typedef arr_t(uint32_t) arr_index_t;
+
+typedef struct {
+  const float* points;
+  uint32_t* next;
+  arr_face_t faces;
+  arr_horizon_t horizon;
+  arr_index_t visible;
+  double epsilon;
+} HullState;
+
+static void getPoint(HullState* s, uint32_t i, double p[3]) {
+  p[0] = s->points[3 * i + 0];
+  p[1] = s->points[3 * i + 1];
+  p[2] = s->points[3 * i + 2];
+}
+
+static double getDistance(HullState* s, Face* face, uint32_t i) {
+  double p[3];
+  getPoint(s, i, p);
+  return face->normal[0] * p[0] + face->normal[1] * p[1] + face->normal[2] * p[2] - face->d;
+}
+
+static void computePlane(HullState* s, Face* face) {
+  double a[3], b[3], c[3];
+  getPoint(s, face->v[0], a);
+  getPoint(s, face->v[1], b);
+  getPoint(s, face->v[2], c);
+  double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  double w[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  double n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+  double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  if (length > 0.) {
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+  }
+  memcpy(face->normal, n, sizeof(n));
+  face->d = n[0] * a[0] + n[1] * a[1] + n[2] * a[2];
+}
+
+// Faces are pushed to an array that moves, so they're referred to by index
+static uint32_t addFace(HullState* s, uint32_t a, uint32_t b, uint32_t c) {
+  Face face = { .v = { a, b, c }, .neighbors = { NONE, NONE, NONE }, .outside = NONE };
+  computePlane(s, &face);
+  arr_push(&s->faces, face);
+  return (uint32_t) s->faces.length - 1;
+}
+
+static uint32_t findEdge(Face* face, uint32_t neighbor) {
+  for (uint32_t i = 0; i < 3; i++) {
+    if (face->neighbors[i] == neighbor) {
+      return i;
+    }
+  }
+  return NONE;
+}
+
+// Points in front of none of the faces are inside the hull and are dropped
+static void assignPoint(HullState* s, uint32_t point, uint32_t firstFace) {
+  for (uint32_t i = firstFace; i < s->faces.length; i++) {
+    Face* face = &s->faces.data[i];
+    if (!face->visible && getDistance(s, face, point) > s->epsilon) {
+      s->next[point] = face->outside;
+      face->outside = point;
+      return;
+    }
+  }
+}
+
+// Walks the faces the eye can see.  The horizon edges come out in order around the eye, because
+// each face continues from the edge after the one it was entered through.
+static void findHorizon(HullState* s, uint32_t eye, uint32_t index, uint32_t entry) {
+  s->faces.data[index].visible = true;
+  arr_push(&s->visible, index);
+
+  uint32_t edgeCount = entry == NONE ? 3 : 2;
+  for (uint32_t i = 0; i < edgeCount; i++) {
+    uint32_t edge = entry == NONE ? i : (entry + 1 + i) % 3;
+    uint32_t neighbor = s->faces.data[index].neighbors[edge];
+    Face* other = &s->faces.data[neighbor];
+
+    if (other->visible) {
+      continue;
+    }
+
+    // Faces the eye is barely in front of still count as visible, or the new faces fold over them
+    if (getDistance(s, other, eye) > 0.) {
+      findHorizon(s, eye, neighbor, findEdge(other, index));
+    } else {
+      arr_push(&s->horizon, ((HorizonEdge) { index, edge }));
+    }
+  }
+}
+
+static void addPoint(HullState* s, uint32_t index) {
+  Face* face = &s->faces.data[index];
+
+  uint32_t eye = face->outside;
+  double farthest = getDistance(s, face, eye);
+  for (uint32_t p = s->next[eye]; p != NONE; p = s->next[p]) {
+    double distance = getDistance(s, face, p);
+    if (distance > farthest) {
+      farthest = distance;
+      eye = p;
+    }
+  }
+
+  arr_clear(&s->horizon);
+  arr_clear(&s->visible);
+  findHorizon(s, eye, index, NONE);
+
+  // A cone of new faces from the horizon to the eye replaces the visible ones
+  uint32_t first = (uint32_t) s->faces.length;
+  uint32_t count = (uint32_t) s->horizon.length;
+  for (uint32_t i = 0; i < count; i++) {
+    HorizonEdge edge = s->horizon.data[i];
+    Face* visible = &s->faces.data[edge.face];
+    uint32_t a = visible->v[edge.edge];
+    uint32_t b = visible->v[(edge.edge + 1) % 3];
+    uint32_t neighbor = visible->neighbors[edge.edge];
+    uint32_t added = addFace(s, a, b, eye);
+    Face* other = &s->faces.data[neighbor];
+    other->neighbors[findEdge(other, edge.face)] = added;
+    s->faces.data[added].neighbors[0] = neighbor;
+    s->faces.data[added].neighbors[1] = first + (i + 1) % count;
+    s->faces.data[added].neighbors[2] = first + (i + count - 1) % count;
+  }
+
+  for (size_t i = 0; i < s->visible.length; i++) {
+    uint32_t p = s->faces.data[s->visible.data[i]].outside;
+    while (p != NONE) {
+      uint32_t next = s->next[p];
+      if (p != eye) {
+        assignPoint(s, p, first);
+      }
+      p = next;
+    }
+    s->faces.data[s->visible.data[i]].outside = NONE;
+  }
+}
+
+static bool buildSimplex(HullState* s, uint32_t count, uint32_t simplex[4]) {
+  uint32_t extremes[6] = { 0 };
+  for (uint32_t i = 1; i < count; i++) {
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      if (s->points[3 * i + axis] < s->points[3 * extremes[2 * axis] + axis]) extremes[2 * axis] = i;
+      if (s->points[3 * i + axis] > s->points[3 * extremes[2 * axis + 1] + axis]) extremes[2 * axis + 1] = i;
+    }
+  }
+
+  double best = -1.;
+  for (uint32_t i = 0; i < 6; i++) {
+    for (uint32_t j = i + 1; j < 6; j++) {
+      double a[3], b[3];
+      getPoint(s, extremes[i], a);
+      getPoint(s, extremes[j], b);
+      double d = (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+      if (d > best) {
+        best = d;
+        simplex[0] = extremes[i];
+        simplex[1] = extremes[j];
+      }
+    }
+  }
+
+  double a[3], b[3], p[3];
+  getPoint(s, simplex[0], a);
+  getPoint(s, simplex[1], b);
+  double direction[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  best = 0.;
+  for (uint32_t i = 0; i < count; i++) {
+    getPoint(s, i, p);
+    double u[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+    double c[3] = {
+      u[1] * direction[2] - u[2] * direction[1],
+      u[2] * direction[0] - u[0] * direction[2],
+      u[0] * direction[1] - u[1] * direction[0]
+    };
+    double d = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+    if (d > best) {
+      best = d;
+      simplex[2] = i;
+    }
+  }
+
+  if (best <= 0.) {
+    return false;
+  }
+
+  Face base = { .v = { simplex[0], simplex[1], simplex[2] } };
+  computePlane(s, &base);
+  best = 0.;
+  for (uint32_t i = 0; i < count; i++) {
+    double d = fabs(getDistance(s, &base, i));
+    if (d > best) {
+      best = d;
+      simplex[3] = i;
+    }
+  }
+
+  return best > s->epsilon;
+}
+
+// Returns false when the points are all on a plane (or a line, or a point)
+bool lovrHullCompute(Hull* hull, const float* points, uint32_t count) {
+  memset(hull, 0, sizeof(*hull));
+  if (count < 4) {
+    return false;
+  }
+
+  HullState s = { .points = points };
+  double extent[3] = { 0. };
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t axis = 0; axis < 3; axis++) {
+      extent[axis] = MAX(extent[axis], fabs(points[3 * i + axis]));
+    }
+  }
+  s.epsilon = 3. * FLT_EPSILON * (extent[0] + extent[1] + extent[2]);
+
+  uint32_t simplex[4];
+  if (!buildSimplex(&s, count, simplex)) {
+    return false;
+  }
+
+  s.next = malloc(count * sizeof(uint32_t));
+  lovrAssert(s.next, "Out of memory");
+  arr_init(&s.faces, realloc);
+  arr_init(&s.horizon, realloc);
+  arr_init(&s.visible, realloc);
+
+  // Each face of the tetrahedron is flipped if needed to face away from the others' centroid
+  static const uint32_t tetrahedron[4][3] = { { 0, 1, 2 }, { 0, 1, 3 }, { 0, 2, 3 }, { 1, 2, 3 } };
+  double centroid[3] = { 0. };
+  for (uint32_t i = 0; i < 4; i++) {
+    double p[3];
+    getPoint(&s, simplex[i], p);
+    centroid[0] += p[0] / 4.;
+    centroid[1] += p[1] / 4.;
+    centroid[2] += p[2] / 4.;
+  }
+
+  for (uint32_t i = 0; i < 4; i++) {
+    uint32_t index = addFace(&s, simplex[tetrahedron[i][0]], simplex[tetrahedron[i][1]], simplex[tetrahedron[i][2]]);
+    Face* face = &s.faces.data[index];
+    double d = face->normal[0] * centroid[0] + face->normal[1] * centroid[1] + face->normal[2] * centroid[2] - face->d;
+    if (d > 0.) {
+      uint32_t v = face->v[1];
+      face->v[1] = face->v[2];
+      face->v[2] = v;
+      computePlane(&s, face);
+    }
+  }
+
+  for (uint32_t i = 0; i < 4; i++) {
+    Face* face = &s.faces.data[i];
+    for (uint32_t e = 0; e < 3; e++) {
+      uint32_t a = face->v[e];
+      uint32_t b = face->v[(e + 1) % 3];
+      for (uint32_t j = 0; j < 4; j++) {
+        Face* other = &s.faces.data[j];
+        for (uint32_t k = 0; k < 3 && j != i; k++) {
+          if (other->v[k] == b && other->v[(k + 1) % 3] == a) {
+            face->neighbors[e] = j;
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (i != simplex[0] && i != simplex[1] && i != simplex[2] && i != simplex[3]) {
+      assignPoint(&s, i, 0);
+    }
+  }
+
+  // New faces are appended, so one pass reaches all of them.  Every face left behind is either
+  // empty or was visible from its own eye point and removed.
+  for (uint32_t i = 0; i < s.faces.length; i++) {
+    if (!s.faces.data[i].visible && s.faces.data[i].outside != NONE) {
+      addPoint(&s, i);
+    }
+  }
+
+  uint32_t* map = s.next;
+  memset(map, 0xff, count * sizeof(uint32_t));
+  for (size_t i = 0; i < s.faces.length; i++) {
+    hull->triangleCount += !s.faces.data[i].visible;
+  }
+
+  hull->vertices = malloc(3 * count * sizeof(float));
+  hull->indices = malloc(3 * hull->triangleCount * sizeof(uint32_t));
+  hull->planes = malloc(4 * hull->triangleCount * sizeof(float));
+  lovrAssert(hull->vertices && hull->indices && hull->planes, "Out of memory");
+
+  uint32_t triangle = 0;
+  for (size_t i = 0; i < s.faces.length; i++) {
+    Face* face = &s.faces.data[i];
+    if (face->visible) continue;
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t v = face->v[k];
+      if (map[v] == NONE) {
+        map[v] = hull->vertexCount++;
+        memcpy(hull->vertices + 3 * map[v], points + 3 * v, 3 * sizeof(float));
+      }
+      hull->indices[3 * triangle + k] = map[v];
+    }
+    hull->planes[4 * triangle + 0] = (float) face->normal[0];
+    hull->planes[4 * triangle + 1] = (float) face->normal[1];
+    hull->planes[4 * triangle + 2] = (float) face->normal[2];
+    hull->planes[4 * triangle + 3] = (float) face->d;
+    triangle++;
+  }
+
+  hull->vertices = realloc(hull->vertices, 3 * hull->vertexCount * sizeof(float));
+  free(s.next);
+  arr_free(&s.faces);
+  arr_free(&s.horizon);
+  arr_free(&s.visible);
+  return true;
+}
+
+void lovrHullFree(Hull* hull) {
+  free(hull->vertices);
+  free(hull->indices);
+  free(hull->planes);
+  memset(hull, 0, sizeof(*hull));
+}
+
+static uint32_t findRoot(uint32_t* parents, uint32_t i) {
+  while (parents[i] != i) {
+    parents[i] = parents[parents[i]];
+    i = parents[i];
+  }
+  return i;
+}
+
+// Labels each vertex with the connected piece of the mesh it belongs to, which is a cheap way to
+// break a model up into parts that can each get their own hull.  Vertices that aren't part of any
+// triangle get NONE.  Returns the number of pieces.
+uint32_t lovrHullSplitComponents(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t* components) {
+  uint32_t* parents = malloc(vertexCount * sizeof(uint32_t));
+  lovrAssert(parents, "Out of memory");
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    parents[i] = i;
+    components[i] = NONE;
+  }
+
+  for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+    uint32_t a = findRoot(parents, indices[i + 0]);
+    uint32_t b = findRoot(parents, indices[i + 1]);
+    uint32_t c = findRoot(parents, indices[i + 2]);
+    parents[b] = a;
+    parents[c] = a;
+    components[indices[i + 0]] = 0;
+    components[indices[i + 1]] = 0;
+    components[indices[i + 2]] = 0;
+  }
+
+  // Roots get labels first, so every other vertex can copy its root's label
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    if (components[i] != NONE && findRoot(parents, i) == i) {
+      components[i] = count++;
+    }
+  }
+
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    if (components[i] != NONE) {
+      components[i] = components[findRoot(parents, i)];
+    }
+  }
+
+  free(parents);
+  return count;
+}
@@ -0,0 +1,19 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#pragma once
+
+// Hulls are lists of triangles wound counterclockwise when seen from outside, along with the plane
+// of each triangle (normal and distance from the origin, so points on it satisfy n . p = d).
+
+typedef struct {
+  float* vertices;
+  uint32_t vertexCount;
+  uint32_t* indices;
+  float* planes;
+  uint32_t triangleCount;
+} Hull;
+
+bool lovrHullCompute(Hull* hull, const float* points, uint32_t count);
+void lovrHullFree(Hull* hull);
+uint32_t lovrHullSplitComponents(const uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t* components);
@@ -1,7 +1,23 @@
 #include "physics.h"
+#include "physics/hull.h"
+#include "core/os.h"
+#include "core/profile.h"
 #include "core/util.h"
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+
+#ifndef LOVR_DISABLE_THREAD
+#include "thread/pool.h"
+#include "lib/tinycthread/tinycthread.h"
+
+// ODE keeps trimesh collision caches in globals unless it's built with thread local storage, and
+// heightfields keep scratch buffers in the geom
+static mtx_t meshLock;
+#endif
+
+#define CASTS_PER_JOB 64
 
 static void defaultNearCallback(void* data, dGeomID a, dGeomID b) {
   lovrWorldCollide((World*) data, dGeomGetData(a), dGeomGetData(b), -1, -1);
@@ -29,6 +45,92 @@ static void raycastCallback(void* data, dGeomID a, dGeomID b) {
   }
 }
 
+// Static geometry never has to be tested against itself, only against everything that moves
+static void collide(World* world, dNearCallback* callback) {
+  dSpaceCollide(world->space, world, callback);
+  dSpaceCollide2((dGeomID) world->statics, (dGeomID) world->space, world, callback);
+}
+
+static void clearEvents(World* world) {
+  for (size_t i = 0; i < world->contacts.length; i++) {
+    lovrRelease(world->contacts.data[i].a, lovrShapeDestroy);
+    lovrRelease(world->contacts.data[i].b, lovrShapeDestroy);
+  }
+
+  for (size_t i = 0; i < world->triggers.length; i++) {
+    lovrRelease(world->triggers.data[i], lovrShapeDestroy);
+  }
+
+  arr_clear(&world->contacts);
+  arr_clear(&world->triggers);
+  arr_clear(&world->contactJoints);
+}
+
+static uint64_t pairKey(Shape* a, Shape* b) {
+  uintptr_t pair[2] = { MIN((uintptr_t) a, (uintptr_t) b), MAX((uintptr_t) a, (uintptr_t) b) };
+  return hash64(pair, sizeof(pair));
+}
+
+// After a step, adds up the impulses of each pair's contact joints
+static void readImpulses(World* world, size_t firstContact, float dt) {
+  for (size_t i = firstContact; i < world->contacts.length; i++) {
+    Contact* contact = &world->contacts.data[i];
+    float force = 0.f;
+    for (uint32_t j = contact->firstJoint; j < contact->firstJoint + contact->jointCount; j++) {
+      dJointFeedback* feedback = &world->feedback.data[j];
+      force += sqrtf(feedback->f1[0] * feedback->f1[0] + feedback->f1[1] * feedback->f1[1] + feedback->f1[2] * feedback->f1[2]);
+    }
+    contact->impulse = force * dt;
+  }
+}
+
+// Pairs that didn't touch during this update end, unless they're asleep, since ODE doesn't collide
+// two disabled bodies and they're still touching
+static void endPairs(World* world) {
+  for (size_t i = 0; i < world->pairs.length;) {
+    ContactPair* pair = &world->pairs.data[i];
+    Collider* a = pair->last.a->collider;
+    Collider* b = pair->last.b->collider;
+    if (pair->frame == world->frame || (a && b && !dBodyIsEnabled(a->body) && !dBodyIsEnabled(b->body))) {
+      pair->frame = world->frame;
+      i++;
+      continue;
+    }
+
+    // The pair's references to its Shapes move to the event
+    Contact contact = pair->last;
+    contact.state = CONTACT_END;
+    contact.impulse = 0.f;
+    contact.jointCount = 0;
+    arr_push(&world->contacts, contact);
+
+    map_remove(&world->pairLookup, pair->key);
+    world->pairs.data[i] = world->pairs.data[--world->pairs.length];
+    if (i < world->pairs.length) {
+      map_set(&world->pairLookup, world->pairs.data[i].key, i);
+    }
+  }
+}
+
+// ODE moves geoms to the front of their space when they move, which changes the order pairs get
+// collided in, and so the order the solver sees contacts in.  Re-adding every geom in Collider
+// order leaves the spaces in the same state after saving a snapshot as after loading it.
+static void sortSpaces(World* world) {
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    for (size_t i = 0; i < collider->shapes.length; i++) {
+      dGeomID id = collider->shapes.data[i]->id;
+      dSpaceID space = dGeomGetSpace(id);
+      dSpaceRemove(space, id);
+      dSpaceAdd(space, id);
+    }
+  }
+}
+
+static dSpaceID getSpace(Collider* collider) {
+  return dBodyIsKinematic(collider->body) ? collider->world->statics : collider->world->space;
+}
+
 // XXX slow, but probably fine (tag names are not on any critical path), could switch to hashing if needed
 static uint32_t findTag(World* world, const char* name) {
   for (uint32_t i = 0; i < MAX_TAGS && world->tags[i]; i++) {
@@ -59,9 +161,19 @@ static void onInfoMessage(int num, const char* format, va_list args) {
 
 static bool initialized = false;
 
+// Worlds can be updated on any thread
+static struct {
+  atomic_uint updates;
+  atomic_uint steps;
+  atomic_uint updateTime;
+} stats;
+
 bool lovrPhysicsInit() {
   if (initialized) return false;
   dInitODE();
+#ifndef LOVR_DISABLE_THREAD
+  mtx_init(&meshLock, mtx_plain);
+#endif
   dSetErrorHandler(onErrorMessage);
   dSetDebugHandler(onDebugMessage);
   dSetMessageHandler(onInfoMessage);
@@ -71,18 +183,72 @@ bool lovrPhysicsInit() {
 void lovrPhysicsDestroy() {
   if (!initialized) return;
   dCloseODE();
+#ifndef LOVR_DISABLE_THREAD
+  mtx_destroy(&meshLock);
+#endif
   initialized = false;
 }
 
-World* lovrWorldCreate(float xg, float yg, float zg, bool allowSleep, const char** tags, uint32_t tagCount) {
+void lovrPhysicsGetStats(PhysicsStats* out) {
+  out->updates = atomic_load_explicit(&stats.updates, memory_order_relaxed);
+  out->steps = atomic_load_explicit(&stats.steps, memory_order_relaxed);
+  out->updateTime = atomic_load_explicit(&stats.updateTime, memory_order_relaxed);
+}
+
+static void recordStats(double start, uint32_t steps) {
+  uint32_t time = (uint32_t) ((os_get_time() - start) * 1e6);
+  atomic_fetch_add_explicit(&stats.updates, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.steps, steps, memory_order_relaxed);
+  atomic_fetch_add_explicit(&stats.updateTime, time, memory_order_relaxed);
+}
+
+World* lovrWorldCreate(float xg, float yg, float zg, bool allowSleep, const char** tags, uint32_t tagCount, BroadphaseInfo* broadphase, uint32_t threads) {
   World* world = calloc(1, sizeof(World));
   lovrAssert(world, "Out of memory");
-  world->ref = 1;
+  world->ref = LOVR_REF_LOCAL | 1;
   world->id = dWorldCreate();
-  world->space = dHashSpaceCreate(0);
-  dHashSpaceSetLevels(world->space, -4, 8);
+  switch (broadphase ? broadphase->type : BROADPHASE_HASH) {
+    case BROADPHASE_HASH:
+      world->space = dHashSpaceCreate(0);
+      dHashSpaceSetLevels(world->space, -4, 8);
+      break;
+    case BROADPHASE_SAP:
+      world->space = dSweepAndPruneSpaceCreate(0, dSAP_AXES_XZY); // Y is up, so it's the worst axis to sort on
+      break;
+    case BROADPHASE_QUADTREE: {
+      dVector3 center = { broadphase->center[0], broadphase->center[1], broadphase->center[2] };
+      dVector3 extent = { broadphase->extent[0], broadphase->extent[1], broadphase->extent[2] };
+      world->space = dQuadTreeSpaceCreate(0, center, extent, (int) broadphase->depth);
+      break;
+    }
+  }
+  world->statics = dHashSpaceCreate(0);
+  dHashSpaceSetLevels(world->statics, -4, 8);
+
+  // Stepping solves islands (and the constraints of big islands) on a pool of threads.  Collision
+  // detection stays on the calling thread, since contacts are created in the near callback.
+  if (threads > 0) {
+    world->threading = dThreadingAllocateMultiThreadedImplementation();
+    if (world->threading) {
+      world->threadPool = dThreadingAllocateThreadPool(threads, 0, dAllocateFlagBasicData, NULL);
+      lovrAssert(world->threadPool, "Could not create physics threads");
+      dThreadingThreadPoolServeMultiThreadedImplementation(world->threadPool, world->threading);
+      dWorldSetStepThreadingImplementation(world->id, dThreadingImplementationGetFunctions(world->threading), world->threading);
+      dWorldSetStepIslandsProcessingMaxThreadCount(world->id, threads);
+    }
+  }
   world->contactGroup = dJointGroupCreate(0);
   arr_init(&world->overlaps, realloc);
+  arr_init(&world->contacts, realloc);
+  arr_init(&world->triggers, realloc);
+  arr_init(&world->pairs, realloc);
+  arr_init(&world->contactJoints, realloc);
+  arr_init(&world->feedback, realloc);
+  arr_init(&world->colliders, realloc);
+  arr_init(&world->lastPositions, realloc);
+  arr_init(&world->lastOrientations, realloc);
+  map_init(&world->pairLookup, 64);
+  world->maxSteps = 8;
   lovrWorldSetGravity(world, xg, yg, zg);
   lovrWorldSetSleepingAllowed(world, allowSleep);
   for (uint32_t i = 0; i < tagCount; i++) {
@@ -91,6 +257,11 @@ World* lovrWorldCreate(float xg, float yg, float zg, bool allowSleep, const char
     memcpy(world->tags[i], tags[i], size);
   }
   memset(world->masks, 0xff, sizeof(world->masks));
+  for (uint32_t i = 0; i < MAX_TAGS; i++) {
+    for (uint32_t j = 0; j < MAX_TAGS; j++) {
+      world->friction[i][j] = world->restitution[i][j] = -1.f;
+    }
+  }
   return world;
 }
 
@@ -98,6 +269,15 @@ void lovrWorldDestroy(void* ref) {
   World* world = ref;
   lovrWorldDestroyData(world);
   arr_free(&world->overlaps);
+  arr_free(&world->contacts);
+  arr_free(&world->triggers);
+  arr_free(&world->pairs);
+  arr_free(&world->contactJoints);
+  arr_free(&world->feedback);
+  arr_free(&world->colliders);
+  arr_free(&world->lastPositions);
+  arr_free(&world->lastOrientations);
+  map_free(&world->pairLookup);
   for (uint32_t i = 0; i < MAX_TAGS && world->tags[i]; i++) {
     free(world->tags[i]);
   }
@@ -105,10 +285,15 @@ void lovrWorldDestroy(void* ref) {
 }
 
 void lovrWorldDestroyData(World* world) {
-  while (world->head) {
-    Collider* next = world->head->next;
-    lovrColliderDestroyData(world->head);
-    world->head = next;
+  clearEvents(world);
+  for (size_t i = 0; i < world->pairs.length; i++) {
+    lovrRelease(world->pairs.data[i].last.a, lovrShapeDestroy);
+    lovrRelease(world->pairs.data[i].last.b, lovrShapeDestroy);
+  }
+  arr_clear(&world->pairs);
+
+  while (world->colliders.length > 0) {
+    lovrColliderDestroyData(world->colliders.data[world->colliders.length - 1]);
   }
 
   if (world->contactGroup) {
@@ -121,29 +306,169 @@ void lovrWorldDestroyData(World* world) {
     world->space = NULL;
   }
 
+  if (world->statics) {
+    dSpaceDestroy(world->statics);
+    world->statics = NULL;
+  }
+
+  if (world->threading) {
+    dThreadingImplementationShutdownProcessing(world->threading);
+    dThreadingFreeThreadPool(world->threadPool);
+    dWorldSetStepThreadingImplementation(world->id, NULL, NULL);
+    dThreadingFreeImplementation(world->threading);
+    world->threading = NULL;
+    world->threadPool = NULL;
+  }
+
   if (world->id) {
     dWorldDestroy(world->id);
     world->id = NULL;
   }
 }
 
-void lovrWorldUpdate(World* world, float dt, CollisionResolver resolver, void* userdata) {
+static void savePoses(World* world) {
+  float* position = world->lastPositions.data;
+  float* orientation = world->lastOrientations.data;
+  for (size_t c = 0; c < world->colliders.length; c++, position += 3, orientation += 4) {
+    dBodyID body = world->colliders.data[c]->body;
+    const dReal* p = dBodyGetPosition(body);
+    const dReal* q = dBodyGetQuaternion(body);
+    vec3_set(position, p[0], p[1], p[2]);
+    quat_set(orientation, q[1], q[2], q[3], q[0]);
+  }
+}
+
+// Kinematic Colliders with a target get the velocity that carries them the rest of the way there
+// over the remaining steps of the update, so whatever they push reacts to how fast they moved.
+static void steer(World* world, float dt) {
+  for (size_t c = 0; c < world->colliders.length && world->targetCount > 0; c++) {
+    Collider* collider = world->colliders.data[c];
+    if (!collider->targeted) continue;
+    const dReal* p = dBodyGetPosition(collider->body);
+    float* target = collider->target;
+    dBodySetLinearVel(collider->body, (target[0] - p[0]) / dt, (target[1] - p[1]) / dt, (target[2] - p[2]) / dt);
+
+    float delta[4], orientation[4];
+    float angle, ax, ay, az;
+    lovrColliderGetOrientation(collider, orientation);
+    quat_mul(delta, target + 3, quat_conjugate(orientation));
+    if (delta[3] < 0.f) quat_set(delta, -delta[0], -delta[1], -delta[2], -delta[3]);
+    quat_getAngleAxis(delta, &angle, &ax, &ay, &az);
+    dBodySetAngularVel(collider->body, ax * angle / dt, ay * angle / dt, az * angle / dt);
+  }
+}
+
+// Lands targeted Colliders exactly on their targets once the update is done and stops them, so a
+// target that isn't renewed doesn't keep the Collider drifting
+static void land(World* world) {
+  for (size_t c = 0; c < world->colliders.length && world->targetCount > 0; c++) {
+    Collider* collider = world->colliders.data[c];
+    if (!collider->targeted) continue;
+    float* target = collider->target;
+    dReal q[4] = { target[6], target[3], target[4], target[5] };
+    dBodySetPosition(collider->body, target[0], target[1], target[2]);
+    dBodySetQuaternion(collider->body, q);
+    dBodySetLinearVel(collider->body, 0., 0., 0.);
+    dBodySetAngularVel(collider->body, 0., 0., 0.);
+    collider->targeted = false;
+    world->targetCount--;
+  }
+}
+
+// Contact events from every step of an update are kept, so a pair can begin and end in one update
+static void step(World* world, float dt, CollisionResolver resolver, void* userdata) {
+  size_t firstContact = world->contacts.length;
+  world->frame++;
+
   if (resolver) {
     resolver(world, userdata);
   } else {
-    dSpaceCollide(world->space, world, defaultNearCallback);
+    collide(world, defaultNearCallback);
+  }
+
+  // The feedback array can't move once joints point into it
+  arr_clear(&world->feedback);
+  arr_reserve(&world->feedback, world->contactJoints.length);
+  world->feedback.length = world->contactJoints.length;
+  for (size_t i = 0; i < world->contactJoints.length; i++) {
+    dJointSetFeedback(world->contactJoints.data[i], &world->feedback.data[i]);
   }
 
   if (dt > 0) {
     dWorldQuickStep(world->id, dt);
+    readImpulses(world, firstContact, dt);
   }
 
+  endPairs(world);
+
   dJointGroupEmpty(world->contactGroup);
+  arr_clear(&world->contactJoints);
+}
+
+// With a step size, time accumulates and the World takes fixed steps to catch up, up to maxSteps
+// per update.  Time beyond that is dropped, so the simulation slows down instead of spiraling.
+void lovrWorldUpdate(World* world, float dt, CollisionResolver resolver, void* userdata) {
+  lovrProfileBegin("lovrWorldUpdate");
+  double start = os_get_time();
+  clearEvents(world);
+
+  if (world->stepSize <= 0.f) {
+    savePoses(world);
+    if (world->targetCount > 0 && dt > 0.f) {
+      steer(world, dt);
+      step(world, dt, resolver, userdata);
+      land(world);
+    } else {
+      step(world, dt, resolver, userdata);
+    }
+    recordStats(start, 1);
+    lovrProfileEnd();
+    return;
+  }
+
+  // Targets are spread over the steps this update will take, and kept for later if there are none
+  uint32_t steps = 0;
+  world->accumulator += dt;
+  uint32_t total = MIN((uint32_t) (world->accumulator / world->stepSize), world->maxSteps);
+  while (world->accumulator >= world->stepSize && steps < world->maxSteps) {
+    savePoses(world);
+    if (world->targetCount > 0) steer(world, world->stepSize * (total > steps ? total - steps : 1));
+    step(world, world->stepSize, resolver, userdata);
+    world->accumulator -= world->stepSize;
+    steps++;
+  }
+
+  if (steps > 0 && world->targetCount > 0) {
+    land(world);
+  }
+
+  if (world->accumulator >= world->stepSize) {
+    world->accumulator = fmodf(world->accumulator, world->stepSize);
+  }
+
+  recordStats(start, steps);
+  lovrProfileEnd();
+}
+
+void lovrWorldGetStepSize(World* world, float* stepSize, uint32_t* maxSteps) {
+  *stepSize = world->stepSize;
+  *maxSteps = world->maxSteps;
+}
+
+void lovrWorldSetStepSize(World* world, float stepSize, uint32_t maxSteps) {
+  world->stepSize = MAX(stepSize, 0.f);
+  world->maxSteps = MAX(maxSteps, 1);
+  world->accumulator = 0.f;
+}
+
+// How far the World is between its last two steps, for rendering Colliders between them
+float lovrWorldGetInterpolation(World* world) {
+  return world->stepSize > 0.f ? world->accumulator / world->stepSize : 1.f;
 }
 
 void lovrWorldComputeOverlaps(World* world) {
   arr_clear(&world->overlaps);
-  dSpaceCollide(world->space, world, customNearCallback);
+  collide(world, customNearCallback);
 }
 
 int lovrWorldGetNextOverlap(World* world, Shape** a, Shape** b) {
@@ -171,6 +496,11 @@ int lovrWorldCollide(World* world, Shape* a, Shape* b, float friction, float res
     return false;
   }
 
+  if (i != NO_TAG && j != NO_TAG) {
+    if (friction < 0.f) friction = world->friction[i][j];
+    if (restitution < 0.f) restitution = world->restitution[i][j];
+  }
+
   if (friction < 0.f) {
     friction = sqrtf(colliderA->friction * colliderB->friction);
   }
@@ -192,18 +522,630 @@ int lovrWorldCollide(World* world, Shape* a, Shape* b, float friction, float res
 
   int contactCount = dCollide(a->id, b->id, MAX_CONTACTS, &contacts[0].geom, sizeof(dContact));
 
-  if (!a->sensor && !b->sensor) {
-    for (int c = 0; c < contactCount; c++) {
-      dJointID joint = dJointCreateContact(world->id, world->contactGroup, &contacts[c]);
-      dJointAttach(joint, colliderA->body, colliderB->body);
-    }
+  if (contactCount == 0) {
+    return 0;
   }
 
+  if (a->sensor || b->sensor) {
+    arr_push(&world->triggers, a->sensor ? a : b);
+    arr_push(&world->triggers, a->sensor ? b : a);
+    lovrRetain(a);
+    lovrRetain(b);
+    return contactCount;
+  }
+
+  int deepest = 0;
+  uint32_t firstJoint = (uint32_t) world->contactJoints.length;
+  for (int c = 0; c < contactCount; c++) {
+    dJointID joint = dJointCreateContact(world->id, world->contactGroup, &contacts[c]);
+    dJointAttach(joint, colliderA->body, colliderB->body);
+    arr_push(&world->contactJoints, joint);
+    if (contacts[c].geom.depth > contacts[deepest].geom.depth) deepest = c;
+  }
+
+  dContactGeom* g = &contacts[deepest].geom;
+  Contact contact = {
+    .a = a,
+    .b = b,
+    .state = CONTACT_BEGIN,
+    .position = { g->pos[0], g->pos[1], g->pos[2] },
+    .normal = { g->normal[0], g->normal[1], g->normal[2] },
+    .depth = g->depth,
+    .firstJoint = firstJoint,
+    .jointCount = (uint32_t) contactCount
+  };
+
+  uint64_t key = pairKey(a, b);
+  uint64_t index = map_get(&world->pairLookup, key);
+  if (index == MAP_NIL) {
+    index = world->pairs.length;
+    map_set(&world->pairLookup, key, index);
+    arr_push(&world->pairs, ((ContactPair) { .key = key }));
+    lovrRetain(a);
+    lovrRetain(b);
+  } else {
+    contact.state = CONTACT_PERSIST;
+  }
+
+  world->pairs.data[index].frame = world->frame;
+  world->pairs.data[index].last = contact;
+  arr_push(&world->contacts, contact);
+  lovrRetain(a);
+  lovrRetain(b);
   return contactCount;
 }
 
-Collider* lovrWorldGetFirstCollider(World* world) {
-  return world->head;
+// Friction and restitution for contacts between two tags, used unless a resolver passes its own.
+// Negative values fall back to combining the values of the two Colliders.
+bool lovrWorldGetContactProperties(World* world, const char* tag1, const char* tag2, float* friction, float* restitution) {
+  uint32_t i = findTag(world, tag1);
+  uint32_t j = findTag(world, tag2);
+  if (i == NO_TAG || j == NO_TAG) {
+    return false;
+  }
+
+  *friction = world->friction[i][j];
+  *restitution = world->restitution[i][j];
+  return true;
+}
+
+bool lovrWorldSetContactProperties(World* world, const char* tag1, const char* tag2, float friction, float restitution) {
+  uint32_t i = findTag(world, tag1);
+  uint32_t j = findTag(world, tag2);
+  if (i == NO_TAG || j == NO_TAG) {
+    return false;
+  }
+
+  world->friction[i][j] = world->friction[j][i] = friction;
+  world->restitution[i][j] = world->restitution[j][i] = restitution;
+  return true;
+}
+
+// Pairs of Shapes from the last lovrWorldComputeOverlaps, without consuming them
+Shape** lovrWorldGetOverlaps(World* world, size_t* count) {
+  *count = world->overlaps.length / 2;
+  return world->overlaps.data;
+}
+
+Contact* lovrWorldGetContacts(World* world, size_t* count) {
+  *count = world->contacts.length;
+  return world->contacts.data;
+}
+
+Shape** lovrWorldGetTriggers(World* world, size_t* count) {
+  *count = world->triggers.length / 2;
+  return world->triggers.data;
+}
+
+// Writes the interpolated pose of Colliders in World order until it runs out of room, returning how
+// many Colliders there are
+uint32_t lovrWorldGetPoses(World* world, PoseFormat format, float* data, uint32_t capacity) {
+  uint32_t count = 0;
+  for (size_t c = 0; c < world->colliders.length; c++, count++) {
+    Collider* collider = world->colliders.data[c];
+    if (count >= capacity) continue;
+    float position[3], orientation[4];
+    lovrColliderGetInterpolatedPose(collider, position, orientation);
+    if (format == POSE_MATRIX) {
+      float* m = data + 16 * count;
+      mat4_fromQuat(m, orientation);
+      m[12] = position[0];
+      m[13] = position[1];
+      m[14] = position[2];
+    } else {
+      float* v = data + 8 * count;
+      v[0] = position[0];
+      v[1] = position[1];
+      v[2] = position[2];
+      v[3] = 1.f;
+      quat_init(v + 4, orientation);
+    }
+  }
+  return count;
+}
+
+// Sets kinematic targets from poses laid out like lovrWorldGetPoses writes them.  Colliders can be
+// NULL to skip a pose.
+void lovrWorldSetPoses(World* world, Collider** colliders, uint32_t count, PoseFormat format, float* data) {
+  for (uint32_t i = 0; i < count; i++) {
+    Collider* collider = colliders[i];
+    if (!collider) continue;
+    lovrAssert(collider->world == world, "Collider belongs to a different World");
+    float position[3], orientation[4];
+    if (format == POSE_MATRIX) {
+      float* m = data + 16 * i;
+      mat4_getPosition(m, position);
+      mat4_getOrientation(m, orientation);
+    } else {
+      float* v = data + 8 * i;
+      vec3_init(position, v);
+      quat_init(orientation, v + 4);
+    }
+    lovrColliderSetTarget(collider, position, orientation);
+  }
+}
+
+// Debug geometry
+
+typedef struct {
+  float* data;
+  uint32_t capacity;
+  uint32_t count;
+  const dReal* position; // Transform of the current Shape
+  const dReal* rotation;
+} DebugLines;
+
+#define DEBUG_SEGMENTS 16
+#define DEBUG_TERRAIN_LINES 64
+
+static const float debugColors[][4] = {
+  { .2f, .9f, .3f, 1.f }, // Awake
+  { .5f, .5f, .5f, 1.f }, // Asleep
+  { .3f, .5f, 1.f, 1.f }, // Kinematic
+  { 1.f, .9f, .2f, 1.f }, // Sensor
+  { 1.f, .2f, .2f, 1.f }, // Contact
+  { 1.f, .6f, .1f, 1.f } // Joint
+};
+
+static void debugVertex(DebugLines* lines, const float point[3], const float color[4]) {
+  if (lines->count < lines->capacity) {
+    float* v = lines->data + 7 * lines->count;
+    memcpy(v, point, 3 * sizeof(float));
+    memcpy(v + 3, color, 4 * sizeof(float));
+  }
+  lines->count++;
+}
+
+static void debugLine(DebugLines* lines, const float a[3], const float b[3], const float color[4]) {
+  debugVertex(lines, a, color);
+  debugVertex(lines, b, color);
+}
+
+// Same as debugLine, but the points are in the current Shape's space
+static void debugLocalLine(DebugLines* lines, const float a[3], const float b[3], const float color[4]) {
+  const dReal* p = lines->position;
+  const dReal* r = lines->rotation;
+  float wa[3], wb[3];
+  for (int i = 0; i < 3; i++) {
+    wa[i] = p[i] + r[4 * i + 0] * a[0] + r[4 * i + 1] * a[1] + r[4 * i + 2] * a[2];
+    wb[i] = p[i] + r[4 * i + 0] * b[0] + r[4 * i + 1] * b[1] + r[4 * i + 2] * b[2];
+  }
+  debugLine(lines, wa, wb, color);
+}
+
+// Circle around one of the local axes, centered at z along it
+static void debugCircle(DebugLines* lines, uint32_t axis, float radius, float z, const float color[4]) {
+  uint32_t u = (axis + 1) % 3;
+  uint32_t v = (axis + 2) % 3;
+  float last[3] = { 0.f };
+  last[axis] = z;
+  last[u] = radius;
+  for (uint32_t i = 1; i <= DEBUG_SEGMENTS; i++) {
+    float theta = 2.f * (float) M_PI * i / DEBUG_SEGMENTS;
+    float next[3] = { 0.f };
+    next[axis] = z;
+    next[u] = cosf(theta) * radius;
+    next[v] = sinf(theta) * radius;
+    debugLocalLine(lines, last, next, color);
+    memcpy(last, next, sizeof(last));
+  }
+}
+
+static void debugShape(DebugLines* lines, Shape* shape, const float color[4]) {
+  lines->position = dGeomGetPosition(shape->id);
+  lines->rotation = dGeomGetRotation(shape->id);
+
+  switch (shape->type) {
+    case SHAPE_SPHERE: {
+      float radius = dGeomSphereGetRadius(shape->id);
+      for (uint32_t axis = 0; axis < 3; axis++) {
+        debugCircle(lines, axis, radius, 0.f, color);
+      }
+      break;
+    }
+
+    case SHAPE_BOX: {
+      dReal lengths[4];
+      dGeomBoxGetLengths(shape->id, lengths);
+      float h[3] = { lengths[0] / 2.f, lengths[1] / 2.f, lengths[2] / 2.f };
+      for (uint32_t axis = 0; axis < 3; axis++) {
+        uint32_t u = (axis + 1) % 3;
+        uint32_t v = (axis + 2) % 3;
+        for (uint32_t corner = 0; corner < 4; corner++) {
+          float a[3], b[3];
+          a[axis] = -h[axis];
+          b[axis] = h[axis];
+          a[u] = b[u] = (corner & 1) ? h[u] : -h[u];
+          a[v] = b[v] = (corner & 2) ? h[v] : -h[v];
+          debugLocalLine(lines, a, b, color);
+        }
+      }
+      break;
+    }
+
+    case SHAPE_CAPSULE:
+    case SHAPE_CYLINDER: {
+      dReal radius, length;
+      if (shape->type == SHAPE_CAPSULE) {
+        dGeomCapsuleGetParams(shape->id, &radius, &length);
+      } else {
+        dGeomCylinderGetParams(shape->id, &radius, &length);
+      }
+      float h = length / 2.f;
+      float r = radius;
+      debugCircle(lines, 2, r, -h, color);
+      debugCircle(lines, 2, r, h, color);
+      float sides[4][2] = { { r, 0.f }, { -r, 0.f }, { 0.f, r }, { 0.f, -r } };
+      for (uint32_t i = 0; i < 4; i++) {
+        debugLocalLine(lines, (float[3]) { sides[i][0], sides[i][1], -h }, (float[3]) { sides[i][0], sides[i][1], h }, color);
+      }
+      // Capsule caps are a pair of arcs over each end
+      if (shape->type == SHAPE_CAPSULE) {
+        for (int end = -1; end <= 1; end += 2) {
+          for (uint32_t plane = 0; plane < 2; plane++) {
+            float last[3] = { plane == 0 ? r : 0.f, plane == 1 ? r : 0.f, end * h };
+            for (uint32_t i = 1; i <= DEBUG_SEGMENTS / 2; i++) {
+              float theta = (float) M_PI * i / (DEBUG_SEGMENTS / 2);
+              float next[3] = { 0.f, 0.f, end * (h + sinf(theta) * r) };
+              next[plane] = cosf(theta) * r;
+              debugLocalLine(lines, last, next, color);
+              memcpy(last, next, sizeof(last));
+            }
+          }
+        }
+      }
+      break;
+    }
+
+    case SHAPE_MESH: {
+      CollisionMesh* mesh = shape->mesh;
+      for (uint32_t i = 0; i + 2 < mesh->indexCount; i += 3) {
+        for (uint32_t j = 0; j < 3; j++) {
+          float* a = mesh->vertices + 3 * mesh->indices[i + j];
+          float* b = mesh->vertices + 3 * mesh->indices[i + (j + 1) % 3];
+          debugLocalLine(lines, a, b, color);
+        }
+      }
+      break;
+    }
+
+    case SHAPE_CONVEX: {
+      dReal* points = (dReal*) shape->vertices + 4 * shape->faceCount;
+      unsigned int* polygons = shape->indices;
+      for (uint32_t i = 0; i < shape->faceCount; i++) {
+        for (uint32_t j = 0; j < 3; j++) {
+          dReal* a = points + 3 * polygons[4 * i + 1 + j];
+          dReal* b = points + 3 * polygons[4 * i + 1 + (j + 1) % 3];
+          debugLocalLine(lines, (float[3]) { a[0], a[1], a[2] }, (float[3]) { b[0], b[1], b[2] }, color);
+        }
+      }
+      break;
+    }
+
+    // Big terrains skip samples, so they're drawn with at most DEBUG_TERRAIN_LINES lines each way
+    case SHAPE_TERRAIN: {
+      TerrainInfo* info = shape->terrain;
+      uint32_t sx = MAX(info->samplesX / DEBUG_TERRAIN_LINES, 1);
+      uint32_t sz = MAX(info->samplesZ / DEBUG_TERRAIN_LINES, 1);
+      float dx = info->width / (info->samplesX - 1);
+      float dz = info->depth / (info->samplesZ - 1);
+      float x0 = -info->width / 2.f;
+      float z0 = -info->depth / 2.f;
+      for (uint32_t z = 0; z < info->samplesZ; z += sz) {
+        for (uint32_t x = 0; x < info->samplesX; x += sx) {
+          float a[3] = { x0 + x * dx, lovrTerrainShapeGetHeight(shape, x, z), z0 + z * dz };
+          uint32_t nx = MIN(x + sx, info->samplesX - 1);
+          uint32_t nz = MIN(z + sz, info->samplesZ - 1);
+          if (nx != x) debugLocalLine(lines, a, (float[3]) { x0 + nx * dx, lovrTerrainShapeGetHeight(shape, nx, z), a[2] }, color);
+          if (nz != z) debugLocalLine(lines, a, (float[3]) { a[0], lovrTerrainShapeGetHeight(shape, x, nz), z0 + nz * dz }, color);
+        }
+      }
+      break;
+    }
+
+    default: break;
+  }
+}
+
+static void debugJoint(DebugLines* lines, Joint* joint) {
+  const float* color = debugColors[5];
+  float a[3], b[3], axis[3];
+  switch (joint->type) {
+    case JOINT_BALL:
+      lovrBallJointGetAnchors(joint, &a[0], &a[1], &a[2], &b[0], &b[1], &b[2]);
+      debugLine(lines, a, b, color);
+      break;
+    case JOINT_DISTANCE:
+      lovrDistanceJointGetAnchors(joint, &a[0], &a[1], &a[2], &b[0], &b[1], &b[2]);
+      debugLine(lines, a, b, color);
+      break;
+    case JOINT_HINGE:
+      lovrHingeJointGetAnchors(joint, &a[0], &a[1], &a[2], &b[0], &b[1], &b[2]);
+      lovrHingeJointGetAxis(joint, &axis[0], &axis[1], &axis[2]);
+      debugLine(lines, a, b, color);
+      debugLine(lines, (float[3]) { a[0] - axis[0] * .1f, a[1] - axis[1] * .1f, a[2] - axis[2] * .1f }, (float[3]) { a[0] + axis[0] * .1f, a[1] + axis[1] * .1f, a[2] + axis[2] * .1f }, color);
+      break;
+    case JOINT_SLIDER: {
+      Collider *ca, *cb;
+      lovrJointGetColliders(joint, &ca, &cb);
+      lovrColliderGetPosition(ca, &a[0], &a[1], &a[2]);
+      lovrColliderGetPosition(cb, &b[0], &b[1], &b[2]);
+      debugLine(lines, a, b, color);
+      break;
+    }
+    default: break;
+  }
+}
+
+// Writes line list vertices (a position and an RGBA color, 7 floats) for every Shape, Joint, and
+// contact in the World until it runs out of room, returning how many vertices there are.  Shapes
+// are colored by whether their Collider is awake, asleep, kinematic, or a sensor.
+uint32_t lovrWorldGetDebugGeometry(World* world, float* data, uint32_t capacity) {
+  DebugLines lines = { .data = data, .capacity = capacity };
+
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    const float* color = debugColors[dBodyIsKinematic(collider->body) ? 2 : (dBodyIsEnabled(collider->body) ? 0 : 1)];
+
+    for (size_t i = 0; i < collider->shapes.length; i++) {
+      Shape* shape = collider->shapes.data[i];
+      debugShape(&lines, shape, shape->sensor ? debugColors[3] : color);
+    }
+
+    // Joints are in both of their Colliders' lists, they're drawn with the first one
+    for (size_t i = 0; i < collider->joints.length; i++) {
+      Joint* joint = collider->joints.data[i];
+      Collider *a, *b;
+      lovrJointGetColliders(joint, &a, &b);
+      if (a == collider && lovrJointIsEnabled(joint)) {
+        debugJoint(&lines, joint);
+      }
+    }
+  }
+
+  // Contacts are a short line along their normal
+  for (size_t i = 0; i < world->contacts.length; i++) {
+    Contact* contact = &world->contacts.data[i];
+    if (contact->state == CONTACT_END) continue;
+    float* p = contact->position;
+    float* n = contact->normal;
+    float tip[3] = { p[0] + n[0] * .1f, p[1] + n[1] * .1f, p[2] + n[2] * .1f };
+    debugLine(&lines, p, tip, debugColors[4]);
+  }
+
+  return lines.count;
+}
+
+// Snapshots are a header, the body of each Collider in list order, whether each of their Joints is
+// enabled, and the contact pairs, with Shapes stored by their index in the World.  Body state is
+// kept as dReal so it's copied straight out of ODE.
+typedef struct {
+  uint32_t colliderCount;
+  uint32_t shapeCount;
+  uint32_t jointCount;
+  uint32_t pairCount;
+  uint32_t frame;
+  uint32_t seed; // ODE's random number generator, quickstep uses it to reorder constraints
+  float accumulator;
+} SnapshotHeader;
+
+typedef struct {
+  dReal position[3];
+  dReal orientation[4];
+  dReal linearVelocity[3];
+  dReal angularVelocity[3];
+  dReal force[3];
+  dReal torque[3];
+  float lastPosition[3];
+  float lastOrientation[4];
+  uint32_t awake;
+} BodySnapshot;
+
+typedef struct {
+  uint32_t a;
+  uint32_t b;
+  uint32_t frame;
+  float position[3];
+  float normal[3];
+  float depth;
+} PairSnapshot;
+
+static size_t getSnapshotSize(World* world, SnapshotHeader* header) {
+  memset(header, 0, sizeof(*header));
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    header->colliderCount++;
+    header->shapeCount += collider->shapes.length;
+    header->jointCount += collider->joints.length;
+  }
+  header->pairCount = world->pairs.length;
+  return sizeof(SnapshotHeader) +
+    header->colliderCount * sizeof(BodySnapshot) +
+    header->jointCount * sizeof(uint32_t) +
+    header->pairCount * sizeof(PairSnapshot);
+}
+
+// Returns the size of the snapshot, and only writes it if it fits.  Stepping after loading a
+// snapshot repeats what happened after saving it, as long as the World has no threads (they share
+// ODE's random number generator) and sleeping is disabled (ODE's sleep timers aren't saved).
+size_t lovrWorldSaveSnapshot(World* world, void* data, size_t capacity) {
+  SnapshotHeader header;
+  size_t size = getSnapshotSize(world, &header);
+  if (size > capacity) {
+    return size;
+  }
+
+  header.frame = world->frame;
+  header.seed = (uint32_t) dRandGetSeed();
+  header.accumulator = world->accumulator;
+  sortSpaces(world);
+
+  char* cursor = data;
+  memcpy(cursor, &header, sizeof(header));
+  cursor += sizeof(header);
+
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    BodySnapshot body;
+    dBodyID id = collider->body;
+    memcpy(body.position, dBodyGetPosition(id), 3 * sizeof(dReal));
+    memcpy(body.orientation, dBodyGetQuaternion(id), 4 * sizeof(dReal));
+    memcpy(body.linearVelocity, dBodyGetLinearVel(id), 3 * sizeof(dReal));
+    memcpy(body.angularVelocity, dBodyGetAngularVel(id), 3 * sizeof(dReal));
+    memcpy(body.force, dBodyGetForce(id), 3 * sizeof(dReal));
+    memcpy(body.torque, dBodyGetTorque(id), 3 * sizeof(dReal));
+    memcpy(body.lastPosition, world->lastPositions.data + 3 * c, sizeof(body.lastPosition));
+    memcpy(body.lastOrientation, world->lastOrientations.data + 4 * c, sizeof(body.lastOrientation));
+    body.awake = dBodyIsEnabled(id);
+    memcpy(cursor, &body, sizeof(body));
+    cursor += sizeof(body);
+  }
+
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    for (size_t i = 0; i < collider->joints.length; i++) {
+      uint32_t enabled = dJointIsEnabled(collider->joints.data[i]->id);
+      memcpy(cursor, &enabled, sizeof(enabled));
+      cursor += sizeof(enabled);
+    }
+  }
+
+  if (header.pairCount > 0) {
+    map_t indices;
+    map_init(&indices, header.shapeCount);
+    uint32_t index = 0;
+    for (size_t c = 0; c < world->colliders.length; c++) {
+      Collider* collider = world->colliders.data[c];
+      for (size_t i = 0; i < collider->shapes.length; i++) {
+        map_set(&indices, hash64(&collider->shapes.data[i], sizeof(Shape*)), index++);
+      }
+    }
+
+    for (size_t i = 0; i < world->pairs.length; i++) {
+      Contact* contact = &world->pairs.data[i].last;
+      PairSnapshot pair = {
+        .a = (uint32_t) map_get(&indices, hash64(&contact->a, sizeof(Shape*))),
+        .b = (uint32_t) map_get(&indices, hash64(&contact->b, sizeof(Shape*))),
+        .frame = world->pairs.data[i].frame,
+        .position = { contact->position[0], contact->position[1], contact->position[2] },
+        .normal = { contact->normal[0], contact->normal[1], contact->normal[2] },
+        .depth = contact->depth
+      };
+      memcpy(cursor, &pair, sizeof(pair));
+      cursor += sizeof(pair);
+    }
+
+    map_free(&indices);
+  }
+
+  return size;
+}
+
+// The World needs to have the same Colliders, Shapes, and Joints as when the snapshot was saved
+void lovrWorldLoadSnapshot(World* world, const void* data, size_t size) {
+  SnapshotHeader header, current;
+  lovrAssert(size >= sizeof(header), "Snapshot is too small");
+  memcpy(&header, data, sizeof(header));
+  getSnapshotSize(world, &current);
+  lovrAssert(header.colliderCount == current.colliderCount && header.shapeCount == current.shapeCount && header.jointCount == current.jointCount,
+    "Snapshot has %d Colliders, %d Shapes, and %d Joints, but the World has %d, %d, and %d",
+    header.colliderCount, header.shapeCount, header.jointCount, current.colliderCount, current.shapeCount, current.jointCount);
+  size_t expected = sizeof(SnapshotHeader) +
+    header.colliderCount * sizeof(BodySnapshot) +
+    header.jointCount * sizeof(uint32_t) +
+    header.pairCount * sizeof(PairSnapshot);
+  lovrAssert(size >= expected, "Snapshot is too small (expected %d bytes, got %d)", (int) expected, (int) size);
+
+  clearEvents(world);
+  arr_clear(&world->overlaps);
+
+  const char* cursor = (const char*) data + sizeof(header);
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    BodySnapshot body;
+    memcpy(&body, cursor, sizeof(body));
+    cursor += sizeof(body);
+    dBodyID id = collider->body;
+    dBodySetPosition(id, body.position[0], body.position[1], body.position[2]);
+    dBodySetQuaternion(id, body.orientation);
+    dBodySetLinearVel(id, body.linearVelocity[0], body.linearVelocity[1], body.linearVelocity[2]);
+    dBodySetAngularVel(id, body.angularVelocity[0], body.angularVelocity[1], body.angularVelocity[2]);
+    dBodySetForce(id, body.force[0], body.force[1], body.force[2]);
+    dBodySetTorque(id, body.torque[0], body.torque[1], body.torque[2]);
+    memcpy(world->lastPositions.data + 3 * c, body.lastPosition, sizeof(body.lastPosition));
+    memcpy(world->lastOrientations.data + 4 * c, body.lastOrientation, sizeof(body.lastOrientation));
+    if (body.awake != (uint32_t) dBodyIsEnabled(id)) {
+      lovrColliderSetAwake(collider, body.awake);
+    }
+  }
+
+  for (size_t c = 0; c < world->colliders.length; c++) {
+    Collider* collider = world->colliders.data[c];
+    for (size_t i = 0; i < collider->joints.length; i++) {
+      uint32_t enabled;
+      memcpy(&enabled, cursor, sizeof(enabled));
+      cursor += sizeof(enabled);
+      lovrJointSetEnabled(collider->joints.data[i], enabled);
+    }
+  }
+
+  for (size_t i = 0; i < world->pairs.length; i++) {
+    map_remove(&world->pairLookup, world->pairs.data[i].key);
+    lovrRelease(world->pairs.data[i].last.a, lovrShapeDestroy);
+    lovrRelease(world->pairs.data[i].last.b, lovrShapeDestroy);
+  }
+  arr_clear(&world->pairs);
+
+  if (header.pairCount > 0) {
+    Shape** shapes = malloc(header.shapeCount * sizeof(Shape*));
+    lovrAssert(shapes, "Out of memory");
+    uint32_t index = 0;
+    for (size_t c = 0; c < world->colliders.length; c++) {
+      Collider* collider = world->colliders.data[c];
+      for (size_t i = 0; i < collider->shapes.length; i++) {
+        shapes[index++] = collider->shapes.data[i];
+      }
+    }
+
+    for (uint32_t i = 0; i < header.pairCount; i++) {
+      PairSnapshot snapshot;
+      memcpy(&snapshot, cursor, sizeof(snapshot));
+      cursor += sizeof(snapshot);
+      if (snapshot.a >= header.shapeCount || snapshot.b >= header.shapeCount) {
+        continue;
+      }
+
+      ContactPair pair = {
+        .key = pairKey(shapes[snapshot.a], shapes[snapshot.b]),
+        .frame = snapshot.frame,
+        .last = {
+          .a = shapes[snapshot.a],
+          .b = shapes[snapshot.b],
+          .state = CONTACT_PERSIST,
+          .position = { snapshot.position[0], snapshot.position[1], snapshot.position[2] },
+          .normal = { snapshot.normal[0], snapshot.normal[1], snapshot.normal[2] },
+          .depth = snapshot.depth
+        }
+      };
+
+      lovrRetain(pair.last.a);
+      lovrRetain(pair.last.b);
+      map_set(&world->pairLookup, pair.key, world->pairs.length);
+      arr_push(&world->pairs, pair);
+    }
+
+    free(shapes);
+  }
+
+  world->frame = header.frame;
+  world->accumulator = header.accumulator;
+  dRandSetSeed(header.seed);
+  sortSpaces(world);
+}
+
+Collider** lovrWorldGetColliders(World* world, size_t* count) {
+  *count = world->colliders.length;
+  return world->colliders.data;
 }
 
 void lovrWorldGetGravity(World* world, float* x, float* y, float* z) {
@@ -268,12 +1210,290 @@ void lovrWorldRaycast(World* world, float x1, float y1, float z1, float x2, floa
   float dy = y2 - y1;
   float dz = z2 - z1;
   float length = sqrtf(dx * dx + dy * dy + dz * dz);
-  dGeomID ray = dCreateRay(world->space, length);
+  dGeomID ray = dCreateRay(0, length);
   dGeomRaySet(ray, x1, y1, z1, dx, dy, dz);
   dSpaceCollide2(ray, (dGeomID) world->space, &data, raycastCallback);
+  dSpaceCollide2(ray, (dGeomID) world->statics, &data, raycastCallback);
   dGeomDestroy(ray);
 }
 
+// Casts are tested against a snapshot of the bounding boxes of every Shape, sorted by minimum x.
+// Nothing in the snapshot changes during a cast, so batches can be split across the thread pool
+// without querying the spaces, which aren't safe to use from multiple threads.
+typedef struct {
+  dGeomID geom;
+  Shape* shape;
+  dReal aabb[6];
+} CastTarget;
+
+typedef arr_t(uint32_t) arr_candidate_t;
+
+typedef struct {
+  CastInfo* info;
+  CastTarget* targets;
+  uint32_t targetCount;
+  float* casts;
+  CastHit* hits;
+  uint32_t count;
+  uint32_t hitCount;
+} CastJob;
+
+static int compareTargets(const void* a, const void* b) {
+  dReal x = ((const CastTarget*) a)->aabb[0];
+  dReal y = ((const CastTarget*) b)->aabb[0];
+  return (x > y) - (x < y);
+}
+
+static bool touches(dGeomID geom, CastTarget* target, dContactGeom* contact) {
+#ifndef LOVR_DISABLE_THREAD
+  bool mesh = target->shape->type == SHAPE_MESH || target->shape->type == SHAPE_TERRAIN;
+  if (mesh) mtx_lock(&meshLock);
+  int count = dCollide(geom, target->geom, 1, contact, sizeof(dContactGeom));
+  if (mesh) mtx_unlock(&meshLock);
+  return count > 0;
+#else
+  return dCollide(geom, target->geom, 1, contact, sizeof(dContactGeom)) > 0;
+#endif
+}
+
+// Returns the first candidate touching the geom where it is
+static CastTarget* findTouch(CastJob* job, dGeomID geom, uint32_t* candidates, uint32_t count, dContactGeom* contact) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (touches(geom, &job->targets[candidates[i]], contact)) {
+      return &job->targets[candidates[i]];
+    }
+  }
+  return NULL;
+}
+
+static void cast(CastJob* job, dGeomID geom, float* start, float* end, CastHit* hit, arr_candidate_t* candidates) {
+  CastInfo* info = job->info;
+  float extent[3] = { 0.f };
+  if (info->type == CAST_SPHERE) {
+    extent[0] = extent[1] = extent[2] = info->size[0];
+  } else if (info->type == CAST_BOX) {
+    extent[0] = info->size[0] / 2.f;
+    extent[1] = info->size[1] / 2.f;
+    extent[2] = info->size[2] / 2.f;
+  }
+
+  float lo[3], hi[3], direction[3];
+  for (int i = 0; i < 3; i++) {
+    lo[i] = MIN(start[i], end[i]) - extent[i];
+    hi[i] = MAX(start[i], end[i]) + extent[i];
+    direction[i] = end[i] - start[i];
+  }
+
+  float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+  hit->shape = NULL;
+  hit->distance = length;
+
+  // Binary search for the last target that could be in range on the x axis, then check the others
+  uint32_t lower = 0;
+  uint32_t upper = job->targetCount;
+  while (lower < upper) {
+    uint32_t middle = (lower + upper) / 2;
+    if (job->targets[middle].aabb[0] <= hi[0]) {
+      lower = middle + 1;
+    } else {
+      upper = middle;
+    }
+  }
+
+  arr_clear(candidates);
+  for (uint32_t i = 0; i < lower; i++) {
+    dReal* aabb = job->targets[i].aabb;
+    if (aabb[1] >= lo[0] && aabb[2] <= hi[1] && aabb[3] >= lo[1] && aabb[4] <= hi[2] && aabb[5] >= lo[2]) {
+      arr_push(candidates, i);
+    }
+  }
+
+  if (candidates->length == 0) {
+    return;
+  }
+
+  dContactGeom contact;
+  CastTarget* target = NULL;
+
+  if (info->type == CAST_RAY) {
+    if (length == 0.f) {
+      return;
+    }
+
+    dGeomRaySet(geom, start[0], start[1], start[2], direction[0], direction[1], direction[2]);
+    dGeomRaySetLength(geom, length);
+    for (size_t i = 0; i < candidates->length; i++) {
+      CastTarget* candidate = &job->targets[candidates->data[i]];
+      dContactGeom c;
+      if (touches(geom, candidate, &c) && (!target || c.depth < contact.depth)) {
+        target = candidate;
+        contact = c;
+        if (info->any) break;
+      }
+    }
+
+    if (target) {
+      hit->distance = contact.depth;
+    }
+  } else {
+    // ODE can't sweep shapes, so the shape steps along the path in increments of its smallest
+    // extent until it touches something, then bisects back to the first point of contact.  A thin
+    // Shape grazing the corners of a box between steps can be missed.
+    float step = MIN(MIN(extent[0], extent[1]), extent[2]);
+    uint32_t steps = (uint32_t) ceilf(length / step);
+    float t = 0.f;
+    for (uint32_t s = 0; s <= steps; s++) {
+      t = MIN(s * step, length);
+      float u = length > 0.f ? t / length : 0.f;
+      dGeomSetPosition(geom, start[0] + direction[0] * u, start[1] + direction[1] * u, start[2] + direction[2] * u);
+      if ((target = findTouch(job, geom, candidates->data, (uint32_t) candidates->length, &contact)) != NULL) {
+        break;
+      }
+    }
+
+    if (!target) {
+      return;
+    }
+
+    if (t > 0.f && !info->any) {
+      float a = MAX(t - step, 0.f);
+      float b = t;
+      for (int i = 0; i < 10; i++) {
+        float middle = (a + b) / 2.f;
+        float u = middle / length;
+        dGeomSetPosition(geom, start[0] + direction[0] * u, start[1] + direction[1] * u, start[2] + direction[2] * u);
+        if (findTouch(job, geom, candidates->data, (uint32_t) candidates->length, &contact)) {
+          b = middle;
+        } else {
+          a = middle;
+        }
+      }
+
+      float u = b / length;
+      dGeomSetPosition(geom, start[0] + direction[0] * u, start[1] + direction[1] * u, start[2] + direction[2] * u);
+      target = findTouch(job, geom, candidates->data, (uint32_t) candidates->length, &contact);
+      t = b;
+    }
+
+    hit->distance = t;
+  }
+
+  if (target) {
+    hit->shape = target->shape;
+    hit->position[0] = contact.pos[0];
+    hit->position[1] = contact.pos[1];
+    hit->position[2] = contact.pos[2];
+    hit->normal[0] = contact.normal[0];
+    hit->normal[1] = contact.normal[1];
+    hit->normal[2] = contact.normal[2];
+    job->hitCount++;
+  }
+}
+
+static void runCastJob(void* arg) {
+  CastJob* job = arg;
+  CastInfo* info = job->info;
+  dAllocateODEDataForThread(dAllocateFlagCollisionData);
+
+  dGeomID geom;
+  switch (info->type) {
+    case CAST_RAY:
+      geom = dCreateRay(0, 1.);
+      dGeomRaySetClosestHit(geom, !info->any);
+      break;
+    case CAST_SPHERE: geom = dCreateSphere(0, info->size[0]); break;
+    case CAST_BOX: geom = dCreateBox(0, info->size[0], info->size[1], info->size[2]); break;
+    default: return;
+  }
+
+  arr_candidate_t candidates;
+  arr_init(&candidates, realloc);
+  for (uint32_t i = 0; i < job->count; i++) {
+    float* start = job->casts + 6 * i;
+    cast(job, geom, start, start + 3, &job->hits[i], &candidates);
+  }
+  arr_free(&candidates);
+  dGeomDestroy(geom);
+}
+
+uint32_t lovrWorldCast(World* world, CastInfo* info, float* casts, uint32_t count, CastHit* hits) {
+  lovrAssert(info->type == CAST_RAY || (info->size[0] > 0.f && (info->type == CAST_SPHERE || (info->size[1] > 0.f && info->size[2] > 0.f))), "Cast size must be positive");
+
+  if (count == 0) {
+    return 0;
+  }
+
+  uint32_t mask = ~0u;
+  if (info->tagCount > 0) {
+    mask = 0;
+    for (uint32_t i = 0; i < info->tagCount; i++) {
+      uint32_t tag = findTag(world, info->tags[i]);
+      lovrAssert(tag != NO_TAG, "Unknown tag '%s'", info->tags[i]);
+      mask |= 1u << tag;
+    }
+  }
+
+  // Sensors don't block casts, and untagged Colliders are only hit when there isn't a tag filter
+  arr_t(CastTarget) targets;
+  arr_init(&targets, realloc);
+  dSpaceID spaces[] = { world->space, world->statics };
+  for (uint32_t i = 0; i < sizeof(spaces) / sizeof(spaces[0]); i++) {
+    int geomCount = dSpaceGetNumGeoms(spaces[i]);
+    for (int j = 0; j < geomCount; j++) {
+      dGeomID geom = dSpaceGetGeom(spaces[i], j);
+      Shape* shape = dGeomGetData(geom);
+      if (!shape || shape->sensor || !shape->collider) continue;
+      uint32_t tag = shape->collider->tag;
+      if (mask != ~0u && (tag == NO_TAG || !(mask & (1u << tag)))) continue;
+      CastTarget target = { .geom = geom, .shape = shape };
+      dGeomGetAABB(geom, target.aabb);
+      arr_push(&targets, target);
+    }
+  }
+
+  qsort(targets.data, targets.length, sizeof(CastTarget), compareTargets);
+
+  uint32_t jobCount = (count + CASTS_PER_JOB - 1) / CASTS_PER_JOB;
+#ifndef LOVR_DISABLE_THREAD
+  jobCount = MIN(jobCount, lovrThreadPoolGetWorkerCount() + 1);
+#else
+  jobCount = MIN(jobCount, 1);
+#endif
+  jobCount = MAX(jobCount, 1);
+
+  CastJob* jobs = malloc(jobCount * (sizeof(CastJob) + sizeof(void*)));
+  lovrAssert(jobs, "Out of memory");
+  void** args = (void**) (jobs + jobCount);
+  uint32_t perJob = (count + jobCount - 1) / jobCount;
+  for (uint32_t i = 0; i < jobCount; i++) {
+    uint32_t first = MIN(i * perJob, count);
+    jobs[i] = (CastJob) {
+      .info = info,
+      .targets = targets.data,
+      .targetCount = (uint32_t) targets.length,
+      .casts = casts + 6 * first,
+      .hits = hits + first,
+      .count = MIN(perJob, count - first)
+    };
+    args[i] = &jobs[i];
+  }
+
+#ifndef LOVR_DISABLE_THREAD
+  lovrThreadPoolRun(runCastJob, args, jobCount);
+#else
+  runCastJob(args[0]);
+#endif
+
+  uint32_t hitCount = 0;
+  for (uint32_t i = 0; i < jobCount; i++) {
+    hitCount += jobs[i].hitCount;
+  }
+
+  free(jobs);
+  arr_free(&targets);
+  return hitCount;
+}
+
 const char* lovrWorldGetTagName(World* world, uint32_t tag) {
   return (tag == NO_TAG) ? NULL : world->tags[tag];
 }
@@ -315,7 +1535,7 @@ int lovrWorldIsCollisionEnabledBetween(World* world, const char* tag1, const cha
 Collider* lovrColliderCreate(World* world, float x, float y, float z) {
   Collider* collider = calloc(1, sizeof(Collider));
   lovrAssert(collider, "Out of memory");
-  collider->ref = 1;
+  collider->ref = LOVR_REF_LOCAL | 1;
   collider->body = dBodyCreate(world->id);
   collider->world = world;
   collider->friction = 0;
@@ -325,16 +1545,18 @@ Collider* lovrColliderCreate(World* world, float x, float y, float z) {
   arr_init(&collider->shapes, realloc);
   arr_init(&collider->joints, realloc);
 
-  lovrColliderSetPosition(collider, x, y, z);
+  // Add the Collider to the World's arrays, its last pose starts out the same as its pose
+  collider->index = (uint32_t) world->colliders.length;
+  arr_push(&world->colliders, collider);
+  arr_expand(&world->lastPositions, 3);
+  arr_expand(&world->lastOrientations, 4);
+  world->lastPositions.length += 3;
+  world->lastOrientations.length += 4;
 
-  // Adjust the world's collider list
-  if (!collider->world->head) {
-    collider->world->head = collider;
-  } else {
-    collider->next = collider->world->head;
-    collider->next->prev = collider;
-    collider->world->head = collider;
-  }
+  float orientation[4];
+  lovrColliderSetPosition(collider, x, y, z);
+  lovrColliderGetOrientation(collider, orientation);
+  quat_init(world->lastOrientations.data + 4 * collider->index, orientation);
 
   // The world owns a reference to the collider
   lovrRetain(collider);
@@ -369,10 +1591,25 @@ void lovrColliderDestroyData(Collider* collider) {
   dBodyDestroy(collider->body);
   collider->body = NULL;
 
-  if (collider->next) collider->next->prev = collider->prev;
-  if (collider->prev) collider->prev->next = collider->next;
-  if (collider->world->head == collider) collider->world->head = collider->next;
-  collider->next = collider->prev = NULL;
+  if (collider->targeted) {
+    collider->targeted = false;
+    collider->world->targetCount--;
+  }
+
+  // The last Collider moves into the hole, so the World's arrays stay dense
+  World* world = collider->world;
+  uint32_t index = collider->index;
+  uint32_t last = (uint32_t) world->colliders.length - 1;
+  if (index != last) {
+    Collider* moved = world->colliders.data[last];
+    world->colliders.data[index] = moved;
+    memcpy(world->lastPositions.data + 3 * index, world->lastPositions.data + 3 * last, 3 * sizeof(float));
+    memcpy(world->lastOrientations.data + 4 * index, world->lastOrientations.data + 4 * last, 4 * sizeof(float));
+    moved->index = index;
+  }
+  world->colliders.length--;
+  world->lastPositions.length -= 3;
+  world->lastOrientations.length -= 4;
 
   // If the Collider is destroyed, the world lets go of its reference to this Collider
   lovrRelease(collider, lovrColliderDestroy);
@@ -399,13 +1636,12 @@ void lovrColliderAddShape(Collider* collider, Shape* shape) {
 
   shape->collider = collider;
   dGeomSetBody(shape->id, collider->body);
-  dSpaceID newSpace = collider->world->space;
-  dSpaceAdd(newSpace, shape->id);
+  dSpaceAdd(getSpace(collider), shape->id);
 }
 
 void lovrColliderRemoveShape(Collider* collider, Shape* shape) {
   if (shape->collider == collider) {
-    dSpaceRemove(collider->world->space, shape->id);
+    dSpaceRemove(dGeomGetSpace(shape->id), shape->id);
     dGeomSetBody(shape->id, 0);
     shape->collider = NULL;
     lovrRelease(shape, lovrShapeDestroy);
@@ -480,10 +1716,24 @@ bool lovrColliderIsKinematic(Collider* collider) {
 }
 
 void lovrColliderSetKinematic(Collider* collider, bool kinematic) {
+  dSpaceID oldSpace = getSpace(collider);
+
   if (kinematic) {
     dBodySetKinematic(collider->body);
   } else {
     dBodySetDynamic(collider->body);
+    if (collider->targeted) {
+      collider->targeted = false;
+      collider->world->targetCount--;
+    }
+  }
+
+  dSpaceID newSpace = getSpace(collider);
+  if (newSpace != oldSpace) {
+    for (dGeomID geom = dBodyGetFirstGeom(collider->body); geom; geom = dBodyGetNextGeom(geom)) {
+      dSpaceRemove(oldSpace, geom);
+      dSpaceAdd(newSpace, geom);
+    }
   }
 }
 
@@ -563,6 +1813,7 @@ void lovrColliderGetPosition(Collider* collider, float* x, float* y, float* z) {
 
 void lovrColliderSetPosition(Collider* collider, float x, float y, float z) {
   dBodySetPosition(collider->body, x, y, z);
+  vec3_set(collider->world->lastPositions.data + 3 * collider->index, x, y, z);
 }
 
 void lovrColliderGetOrientation(Collider* collider, quat orientation) {
@@ -573,6 +1824,40 @@ void lovrColliderGetOrientation(Collider* collider, quat orientation) {
 void lovrColliderSetOrientation(Collider* collider, quat orientation) {
   dReal q[4] = { orientation[3], orientation[0], orientation[1], orientation[2] };
   dBodySetQuaternion(collider->body, q);
+  quat_init(collider->world->lastOrientations.data + 4 * collider->index, orientation);
+}
+
+// Kinematic Colliders move to the target over the next update, with the velocity it takes to get
+// there.  Other Colliders aren't driven by velocity, so they jump to it.
+void lovrColliderSetTarget(Collider* collider, float position[3], quat orientation) {
+  if (!dBodyIsKinematic(collider->body)) {
+    lovrColliderSetPosition(collider, position[0], position[1], position[2]);
+    lovrColliderSetOrientation(collider, orientation);
+    return;
+  }
+
+  vec3_init(collider->target, position);
+  quat_normalize(quat_init(collider->target + 3, orientation));
+  if (!collider->targeted) {
+    collider->targeted = true;
+    collider->world->targetCount++;
+  }
+}
+
+// Moving a Collider directly isn't interpolated, it snaps to the new pose
+void lovrColliderGetInterpolatedPose(Collider* collider, float position[3], quat orientation) {
+  float t = lovrWorldGetInterpolation(collider->world);
+  float* lastPosition = collider->world->lastPositions.data + 3 * collider->index;
+  float current[3];
+  lovrColliderGetPosition(collider, &current[0], &current[1], &current[2]);
+  lovrColliderGetOrientation(collider, orientation);
+  for (int i = 0; i < 3; i++) {
+    position[i] = lastPosition[i] + (current[i] - lastPosition[i]) * t;
+  }
+  float last[4];
+  quat_init(last, collider->world->lastOrientations.data + 4 * collider->index);
+  quat_slerp(last, orientation, t);
+  quat_init(orientation, last);
 }
 
 void lovrColliderGetLinearVelocity(Collider* collider, float* x, float* y, float* z) {
@@ -715,14 +2000,22 @@ void lovrShapeDestroy(void* ref) {
 
 void lovrShapeDestroyData(Shape* shape) {
   if (shape->id) {
-    if (shape->type == SHAPE_MESH) {
-      dTriMeshDataID dataID = dGeomTriMeshGetData(shape->id);
-      dGeomTriMeshDataDestroy(dataID);
+    if (shape->type == SHAPE_CONVEX) {
       free(shape->vertices);
       free(shape->indices);
+    } else if (shape->type == SHAPE_TERRAIN) {
+      dGeomHeightfieldDataDestroy(dGeomHeightfieldGetHeightfieldData(shape->id));
+      lovrRelease(shape->terrain->source, shape->terrain->destructor);
+      free(shape->terrain);
     }
     dGeomDestroy(shape->id);
     shape->id = NULL;
+
+    // The triangle data can be shared with other MeshShapes, so it outlives the geom
+    if (shape->type == SHAPE_MESH) {
+      lovrRelease(shape->mesh, lovrCollisionMeshDestroy);
+      shape->mesh = NULL;
+    }
   }
 }
 
@@ -820,6 +2113,43 @@ void lovrShapeGetMass(Shape* shape, float density, float* cx, float* cy, float*
       dMassTranslate(&m, -m.c[0], -m.c[1], -m.c[2]);
       break;
     }
+
+    case SHAPE_TERRAIN: break; // Terrain is static, it doesn't have mass
+
+    case SHAPE_CONVEX: {
+      // Sums the tetrahedra from the origin to each face, using the covariance of a canonical
+      // tetrahedron to get the second moments
+      dReal* points = (dReal*) shape->vertices + 4 * shape->faceCount;
+      unsigned int* polygons = shape->indices;
+      double volume = 0., center[3] = { 0. }, covariance[3][3] = { { 0. } };
+      for (uint32_t i = 0; i < shape->faceCount; i++) {
+        dReal* a = points + 3 * polygons[4 * i + 1];
+        dReal* b = points + 3 * polygons[4 * i + 2];
+        dReal* c = points + 3 * polygons[4 * i + 3];
+        double det = a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0]);
+        volume += det / 6.;
+        for (int j = 0; j < 3; j++) {
+          center[j] += det / 24. * (a[j] + b[j] + c[j]);
+          for (int k = 0; k < 3; k++) {
+            double s = a[j] + b[j] + c[j];
+            double t = a[k] + b[k] + c[k];
+            covariance[j][k] += det / 120. * (a[j] * a[k] + b[j] * b[k] + c[j] * c[k] + s * t);
+          }
+        }
+      }
+
+      if (volume > 0.) {
+        double trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+        dMassSetParameters(&m, density * volume, center[0] / volume, center[1] / volume, center[2] / volume,
+          density * (trace - covariance[0][0]),
+          density * (trace - covariance[1][1]),
+          density * (trace - covariance[2][2]),
+          density * -covariance[0][1],
+          density * -covariance[0][2],
+          density * -covariance[1][2]);
+      }
+      break;
+    }
   }
 
   const dReal* position = dGeomGetOffsetPosition(shape->id);
@@ -850,7 +2180,7 @@ void lovrShapeGetAABB(Shape* shape, float aabb[6]) {
 SphereShape* lovrSphereShapeCreate(float radius) {
   SphereShape* sphere = calloc(1, sizeof(SphereShape));
   lovrAssert(sphere, "Out of memory");
-  sphere->ref = 1;
+  sphere->ref = LOVR_REF_LOCAL | 1;
   sphere->type = SHAPE_SPHERE;
   sphere->id = dCreateSphere(0, radius);
   dGeomSetData(sphere->id, sphere);
@@ -868,7 +2198,7 @@ void lovrSphereShapeSetRadius(SphereShape* sphere, float radius) {
 BoxShape* lovrBoxShapeCreate(float x, float y, float z) {
   BoxShape* box = calloc(1, sizeof(BoxShape));
   lovrAssert(box, "Out of memory");
-  box->ref = 1;
+  box->ref = LOVR_REF_LOCAL | 1;
   box->type = SHAPE_BOX;
   box->id = dCreateBox(0, x, y, z);
   dGeomSetData(box->id, box);
@@ -890,7 +2220,7 @@ void lovrBoxShapeSetDimensions(BoxShape* box, float x, float y, float z) {
 CapsuleShape* lovrCapsuleShapeCreate(float radius, float length) {
   CapsuleShape* capsule = calloc(1, sizeof(CapsuleShape));
   lovrAssert(capsule, "Out of memory");
-  capsule->ref = 1;
+  capsule->ref = LOVR_REF_LOCAL | 1;
   capsule->type = SHAPE_CAPSULE;
   capsule->id = dCreateCapsule(0, radius, length);
   dGeomSetData(capsule->id, capsule);
@@ -920,7 +2250,7 @@ void lovrCapsuleShapeSetLength(CapsuleShape* capsule, float length) {
 CylinderShape* lovrCylinderShapeCreate(float radius, float length) {
   CylinderShape* cylinder = calloc(1, sizeof(CylinderShape));
   lovrAssert(cylinder, "Out of memory");
-  cylinder->ref = 1;
+  cylinder->ref = LOVR_REF_LOCAL | 1;
   cylinder->type = SHAPE_CYLINDER;
   cylinder->id = dCreateCylinder(0, radius, length);
   dGeomSetData(cylinder->id, cylinder);
@@ -947,21 +2277,257 @@ void lovrCylinderShapeSetLength(CylinderShape* cylinder, float length) {
   dGeomCylinderSetParams(cylinder->id, lovrCylinderShapeGetRadius(cylinder), length);
 }
 
-MeshShape* lovrMeshShapeCreate(int vertexCount, float* vertices, int indexCount, dTriIndex* indices) {
+// Without copy, the CollisionMesh takes ownership of the (malloc'd) vertices and indices
+CollisionMesh* lovrCollisionMeshCreate(float* vertices, uint32_t vertexCount, dTriIndex* indices, uint32_t indexCount, bool copy) {
+  lovrAssert(indexCount % 3 == 0, "CollisionMesh index count must be a multiple of 3");
+  CollisionMesh* mesh = calloc(1, sizeof(CollisionMesh));
+  lovrAssert(mesh, "Out of memory");
+  mesh->ref = LOVR_REF_LOCAL | 1;
+  mesh->vertexCount = vertexCount;
+  mesh->indexCount = indexCount;
+
+  if (copy) {
+    mesh->vertices = malloc(3 * vertexCount * sizeof(float));
+    mesh->indices = malloc(indexCount * sizeof(dTriIndex));
+    lovrAssert(mesh->vertices && mesh->indices, "Out of memory");
+    memcpy(mesh->vertices, vertices, 3 * vertexCount * sizeof(float));
+    memcpy(mesh->indices, indices, indexCount * sizeof(dTriIndex));
+  } else {
+    mesh->vertices = vertices;
+    mesh->indices = indices;
+  }
+
+  for (uint32_t i = 0; i < indexCount; i++) {
+    lovrAssert(mesh->indices[i] < vertexCount, "Invalid vertex index %d (expected [%d, %d])", mesh->indices[i] + 1, 1, vertexCount);
+  }
+
+  mesh->id = dGeomTriMeshDataCreate();
+  dGeomTriMeshDataBuildSingle(mesh->id, mesh->vertices, 3 * sizeof(float), vertexCount, mesh->indices, indexCount, 3 * sizeof(dTriIndex));
+  dGeomTriMeshDataPreprocess2(mesh->id, (1U << dTRIDATAPREPROCESS_BUILD_FACE_ANGLES), NULL);
+  return mesh;
+}
+
+// Encoded CollisionMeshes are a small header (magic, vertex count, index count) followed by the
+// vertices and indices.  ODE's collision tree can't be saved, so it's rebuilt when loading, but
+// that skips loading and flattening the source geometry.
+#define COLLISION_MESH_MAGIC 0x4d43564cu // "LVCM"
+
+CollisionMesh* lovrCollisionMeshCreateFromData(const void* data, size_t size) {
+  uint32_t header[3];
+  lovrAssert(size >= sizeof(header), "Invalid CollisionMesh data");
+  memcpy(header, data, sizeof(header));
+  lovrAssert(header[0] == COLLISION_MESH_MAGIC, "Invalid CollisionMesh data");
+  size_t vertexSize = 3 * (size_t) header[1] * sizeof(float);
+  size_t indexSize = (size_t) header[2] * sizeof(uint32_t);
+  lovrAssert(size >= sizeof(header) + vertexSize + indexSize, "CollisionMesh data is truncated");
+
+  float* vertices = malloc(vertexSize);
+  dTriIndex* indices = malloc(header[2] * sizeof(dTriIndex));
+  lovrAssert(vertices && indices, "Out of memory");
+  const char* p = (const char*) data + sizeof(header);
+  memcpy(vertices, p, vertexSize);
+  p += vertexSize;
+  for (uint32_t i = 0; i < header[2]; i++, p += sizeof(uint32_t)) {
+    uint32_t index;
+    memcpy(&index, p, sizeof(index));
+    indices[i] = (dTriIndex) index;
+  }
+
+  return lovrCollisionMeshCreate(vertices, header[1], indices, header[2], false);
+}
+
+void lovrCollisionMeshDestroy(void* ref) {
+  CollisionMesh* mesh = ref;
+  dGeomTriMeshDataDestroy(mesh->id);
+  free(mesh->vertices);
+  free(mesh->indices);
+  free(mesh);
+}
+
+void* lovrCollisionMeshEncode(CollisionMesh* mesh, size_t* size) {
+  uint32_t header[3] = { COLLISION_MESH_MAGIC, mesh->vertexCount, mesh->indexCount };
+  size_t vertexSize = 3 * (size_t) mesh->vertexCount * sizeof(float);
+  *size = sizeof(header) + vertexSize + mesh->indexCount * sizeof(uint32_t);
+  char* data = malloc(*size);
+  lovrAssert(data, "Out of memory");
+  char* p = data;
+  memcpy(p, header, sizeof(header));
+  p += sizeof(header);
+  memcpy(p, mesh->vertices, vertexSize);
+  p += vertexSize;
+  for (uint32_t i = 0; i < mesh->indexCount; i++, p += sizeof(uint32_t)) {
+    uint32_t index = (uint32_t) mesh->indices[i];
+    memcpy(p, &index, sizeof(index));
+  }
+  return data;
+}
+
+MeshShape* lovrMeshShapeCreate(CollisionMesh* collisionMesh) {
   MeshShape* mesh = calloc(1, sizeof(MeshShape));
   lovrAssert(mesh, "Out of memory");
-  mesh->ref = 1;
-  dTriMeshDataID dataID = dGeomTriMeshDataCreate();
-  dGeomTriMeshDataBuildSingle(dataID, vertices, 3 * sizeof(float), vertexCount, indices, indexCount, 3 * sizeof(dTriIndex));
-  dGeomTriMeshDataPreprocess2(dataID, (1U << dTRIDATAPREPROCESS_BUILD_FACE_ANGLES), NULL);
-  mesh->id = dCreateTriMesh(0, dataID, 0, 0, 0);
+  mesh->ref = LOVR_REF_LOCAL | 1;
+  mesh->id = dCreateTriMesh(0, collisionMesh->id, 0, 0, 0);
   mesh->type = SHAPE_MESH;
-  mesh->vertices = vertices;
-  mesh->indices = indices;
+  mesh->mesh = collisionMesh;
+  lovrRetain(collisionMesh);
   dGeomSetData(mesh->id, mesh);
   return mesh;
 }
 
+CollisionMesh* lovrMeshShapeGetCollisionMesh(MeshShape* shape) {
+  return shape->mesh;
+}
+
+static float readSample(TerrainInfo* terrain, uint32_t x, uint32_t z) {
+  uint8_t* p = (uint8_t*) terrain->data + ((size_t) z * terrain->samplesX + x) * terrain->stride;
+  switch (terrain->format) {
+    case HEIGHT_U8: return *p / 255.f;
+    case HEIGHT_U16: { uint16_t u16; memcpy(&u16, p, sizeof(u16)); return u16 / 65535.f; }
+    case HEIGHT_F32: { float f32; memcpy(&f32, p, sizeof(f32)); return f32; }
+    default: return 0.f;
+  }
+}
+
+static dReal getTerrainHeight(void* userdata, int x, int z) {
+  return readSample(userdata, x, z);
+}
+
+static void setTerrainBounds(TerrainShape* terrain) {
+  TerrainInfo* info = terrain->terrain;
+  dGeomHeightfieldDataSetBounds(dGeomHeightfieldGetHeightfieldData(terrain->id), info->minHeight, info->maxHeight);
+
+  // Nudges the geom so its bounding box is recomputed with the new bounds
+  if (dGeomGetBody(terrain->id)) {
+    const dReal* position = dGeomGetOffsetPosition(terrain->id);
+    dGeomSetOffsetPosition(terrain->id, position[0], position[1], position[2]);
+  }
+}
+
+TerrainShape* lovrTerrainShapeCreate(TerrainInfo* info) {
+  lovrAssert(info->samplesX >= 2 && info->samplesZ >= 2, "Terrain needs at least 2 samples on each axis");
+  TerrainShape* terrain = calloc(1, sizeof(TerrainShape));
+  lovrAssert(terrain, "Out of memory");
+  terrain->terrain = malloc(sizeof(TerrainInfo));
+  lovrAssert(terrain->terrain, "Out of memory");
+  *terrain->terrain = *info;
+  lovrRetain(info->source);
+  terrain->ref = LOVR_REF_LOCAL | 1;
+  terrain->type = SHAPE_TERRAIN;
+
+  // Packed floats can be used directly, other formats go through a callback, neither copies
+  dHeightfieldDataID data = dGeomHeightfieldDataCreate();
+  if (info->format == HEIGHT_F32 && info->stride == sizeof(float)) {
+    dGeomHeightfieldDataBuildSingle(data, info->data, 0, info->width, info->depth, info->samplesX, info->samplesZ, info->scale, info->offset, 1., 0);
+  } else {
+    dGeomHeightfieldDataBuildCallback(data, terrain->terrain, getTerrainHeight, info->width, info->depth, info->samplesX, info->samplesZ, info->scale, info->offset, 1., 0);
+  }
+
+  terrain->id = dCreateHeightfield(0, data, 1);
+  dGeomSetData(terrain->id, terrain);
+  lovrTerrainShapeUpdate(terrain);
+  return terrain;
+}
+
+void lovrTerrainShapeGetSampleCount(TerrainShape* terrain, uint32_t* x, uint32_t* z) {
+  *x = terrain->terrain->samplesX;
+  *z = terrain->terrain->samplesZ;
+}
+
+void lovrTerrainShapeGetSize(TerrainShape* terrain, float* width, float* depth) {
+  *width = terrain->terrain->width;
+  *depth = terrain->terrain->depth;
+}
+
+float lovrTerrainShapeGetHeight(TerrainShape* terrain, uint32_t x, uint32_t z) {
+  TerrainInfo* info = terrain->terrain;
+  lovrAssert(x < info->samplesX && z < info->samplesZ, "Terrain sample %d, %d is out of range", x, z);
+  return readSample(info, x, z) * info->scale + info->offset;
+}
+
+// Integer samples are rounded and clamped to what the format can store
+void lovrTerrainShapeSetHeight(TerrainShape* terrain, uint32_t x, uint32_t z, float height) {
+  TerrainInfo* info = terrain->terrain;
+  lovrAssert(x < info->samplesX && z < info->samplesZ, "Terrain sample %d, %d is out of range", x, z);
+  float sample = info->scale != 0.f ? (height - info->offset) / info->scale : 0.f;
+  uint8_t* p = (uint8_t*) info->data + ((size_t) z * info->samplesX + x) * info->stride;
+  switch (info->format) {
+    case HEIGHT_U8: *p = (uint8_t) (CLAMP(sample, 0.f, 1.f) * 255.f + .5f); break;
+    case HEIGHT_U16: { uint16_t u16 = (uint16_t) (CLAMP(sample, 0.f, 1.f) * 65535.f + .5f); memcpy(p, &u16, sizeof(u16)); break; }
+    case HEIGHT_F32: memcpy(p, &sample, sizeof(sample)); break;
+  }
+
+  height = readSample(info, x, z) * info->scale + info->offset;
+  if (height < info->minHeight || height > info->maxHeight) {
+    info->minHeight = MIN(info->minHeight, height);
+    info->maxHeight = MAX(info->maxHeight, height);
+    setTerrainBounds(terrain);
+  }
+}
+
+// Rescans the heights, after the source was changed some other way
+void lovrTerrainShapeUpdate(TerrainShape* terrain) {
+  TerrainInfo* info = terrain->terrain;
+  float lo = HUGE_VALF;
+  float hi = -HUGE_VALF;
+  for (uint32_t z = 0; z < info->samplesZ; z++) {
+    for (uint32_t x = 0; x < info->samplesX; x++) {
+      float sample = readSample(info, x, z);
+      lo = MIN(lo, sample);
+      hi = MAX(hi, sample);
+    }
+  }
+
+  float a = lo * info->scale + info->offset;
+  float b = hi * info->scale + info->offset;
+  info->minHeight = MIN(a, b);
+  info->maxHeight = MAX(a, b);
+  setTerrainBounds(terrain);
+}
+
+// ODE doesn't copy a convex geom's planes, points, or polygons, so the Shape owns them
+ConvexShape* lovrConvexShapeCreate(float* points, uint32_t count) {
+  Hull hull;
+  if (!lovrHullCompute(&hull, points, count)) {
+    return NULL;
+  }
+
+  ConvexShape* convex = calloc(1, sizeof(ConvexShape));
+  dReal* vertices = malloc((4 * hull.triangleCount + 3 * hull.vertexCount) * sizeof(dReal));
+  unsigned int* polygons = malloc(4 * hull.triangleCount * sizeof(unsigned int));
+  lovrAssert(convex && vertices && polygons, "Out of memory");
+
+  dReal* planes = vertices;
+  dReal* hullPoints = vertices + 4 * hull.triangleCount;
+  for (uint32_t i = 0; i < 4 * hull.triangleCount; i++) {
+    planes[i] = hull.planes[i];
+  }
+
+  for (uint32_t i = 0; i < 3 * hull.vertexCount; i++) {
+    hullPoints[i] = hull.vertices[i];
+  }
+
+  for (uint32_t i = 0; i < hull.triangleCount; i++) {
+    polygons[4 * i + 0] = 3;
+    polygons[4 * i + 1] = hull.indices[3 * i + 0];
+    polygons[4 * i + 2] = hull.indices[3 * i + 1];
+    polygons[4 * i + 3] = hull.indices[3 * i + 2];
+  }
+
+  convex->ref = LOVR_REF_LOCAL | 1;
+  convex->type = SHAPE_CONVEX;
+  convex->vertices = vertices;
+  convex->indices = polygons;
+  convex->faceCount = hull.triangleCount;
+  convex->id = dCreateConvex(0, planes, hull.triangleCount, hullPoints, hull.vertexCount, polygons);
+  dGeomSetData(convex->id, convex);
+  lovrHullFree(&hull);
+  return convex;
+}
+
+uint32_t lovrConvexShapeGetFaceCount(ConvexShape* convex) {
+  return convex->faceCount;
+}
+
 void lovrJointDestroy(void* ref) {
   Joint* joint = ref;
   lovrJointDestroyData(joint);
@@ -1016,7 +2582,7 @@ BallJoint* lovrBallJointCreate(Collider* a, Collider* b, float x, float y, float
   lovrAssert(a->world == b->world, "Joint bodies must exist in same World");
   BallJoint* joint = calloc(1, sizeof(BallJoint));
   lovrAssert(joint, "Out of memory");
-  joint->ref = 1;
+  joint->ref = LOVR_REF_LOCAL | 1;
   joint->type = JOINT_BALL;
   joint->id = dJointCreateBall(a->world->id, 0);
   dJointSetData(joint->id, joint);
@@ -1062,7 +2628,7 @@ DistanceJoint* lovrDistanceJointCreate(Collider* a, Collider* b, float x1, float
   lovrAssert(a->world == b->world, "Joint bodies must exist in same World");
   DistanceJoint* joint = calloc(1, sizeof(DistanceJoint));
   lovrAssert(joint, "Out of memory");
-  joint->ref = 1;
+  joint->ref = LOVR_REF_LOCAL | 1;
   joint->type = JOINT_DISTANCE;
   joint->id = dJointCreateDBall(a->world->id, 0);
   dJointSetData(joint->id, joint);
@@ -1117,7 +2683,7 @@ HingeJoint* lovrHingeJointCreate(Collider* a, Collider* b, float x, float y, flo
   lovrAssert(a->world == b->world, "Joint bodies must exist in same World");
   HingeJoint* joint = calloc(1, sizeof(HingeJoint));
   lovrAssert(joint, "Out of memory");
-  joint->ref = 1;
+  joint->ref = LOVR_REF_LOCAL | 1;
   joint->type = JOINT_HINGE;
   joint->id = dJointCreateHinge(a->world->id, 0);
   dJointSetData(joint->id, joint);
@@ -1180,7 +2746,7 @@ SliderJoint* lovrSliderJointCreate(Collider* a, Collider* b, float ax, float ay,
   lovrAssert(a->world == b->world, "Joint bodies must exist in the same world");
   SliderJoint* joint = calloc(1, sizeof(SliderJoint));
   lovrAssert(joint, "Out of memory");
-  joint->ref = 1;
+  joint->ref = LOVR_REF_LOCAL | 1;
   joint->type = JOINT_SLIDER;
   joint->id = dJointCreateSlider(a->world->id, 0);
   dJointSetData(joint->id, joint);
@@ -1,5 +1,6 @@
 #include "core/maf.h"
 #include "core/util.h"
+#include "core/map.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <ode/ode.h>
@@ -16,8 +17,24 @@ typedef enum {
   SHAPE_CAPSULE,
   SHAPE_CYLINDER,
   SHAPE_MESH,
+  SHAPE_TERRAIN,
+  SHAPE_CONVEX
 } ShapeType;
 
+typedef enum {
+  BROADPHASE_HASH,
+  BROADPHASE_SAP,
+  BROADPHASE_QUADTREE
+} Broadphase;
+
+// Quadtrees cover a fixed region, split depth times.  Geometry outside of it still collides, slowly.
+typedef struct {
+  Broadphase type;
+  float center[3];
+  float extent[3];
+  uint32_t depth;
+} BroadphaseInfo;
+
 typedef enum {
   JOINT_BALL,
   JOINT_DISTANCE,
@@ -25,33 +42,116 @@ typedef enum {
   JOINT_SLIDER
 } JointType;
 
+typedef enum {
+  HEIGHT_U8,
+  HEIGHT_U16,
+  HEIGHT_F32
+} HeightFormat;
+
+// Terrain heights are read in place (rows along z), from a source object the Shape retains.
+// Integer samples are normalized to 0-1, then scaled and offset.  Terrains are centered on the
+// origin, with y up.
+typedef struct {
+  void* data;
+  HeightFormat format;
+  uint32_t stride; // Bytes between samples
+  uint32_t samplesX;
+  uint32_t samplesZ;
+  float width;
+  float depth;
+  float scale;
+  float offset;
+  void* source;
+  void (*destructor)(void*);
+  float minHeight; // Kept up to date by the Shape
+  float maxHeight;
+} TerrainInfo;
+
+// Triangles shared by MeshShapes.  ODE builds its collision tree once, when the CollisionMesh is
+// created, and every MeshShape using it references the same data.
+typedef struct CollisionMesh {
+  uint32_t ref;
+  dTriMeshDataID id;
+  float* vertices;
+  dTriIndex* indices;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+} CollisionMesh;
+
 typedef struct Collider Collider;
 typedef struct Shape Shape;
 typedef struct Joint Joint;
 
+typedef enum {
+  CONTACT_BEGIN,
+  CONTACT_PERSIST,
+  CONTACT_END
+} ContactState;
+
+// A pair of Shapes that touched during an update (or stopped touching, for CONTACT_END), with their
+// deepest contact point and the impulse the solver applied to them.  The Shapes are retained until
+// the next update.
+typedef struct {
+  Shape* a;
+  Shape* b;
+  ContactState state;
+  float position[3];
+  float normal[3];
+  float depth;
+  float impulse;
+  uint32_t firstJoint; // Contact joints of this pair, for reading back the impulse
+  uint32_t jointCount;
+} Contact;
+
+// Pairs that were touching during the last update, so the next one can tell what began and ended
+typedef struct {
+  uint64_t key;
+  uint32_t frame;
+  Contact last;
+} ContactPair;
+
 typedef struct {
   uint32_t ref;
   dWorldID id;
   dSpaceID space;
+  dSpaceID statics; // Kinematic Colliders, which are only tested against the other space
+  dThreadingImplementationID threading;
+  dThreadingThreadPoolID threadPool;
   dJointGroupID contactGroup;
   arr_t(Shape*) overlaps;
+  arr_t(Contact) contacts;
+  arr_t(ContactPair) pairs;
+  map_t pairLookup;
+  arr_t(dJointID) contactJoints;
+  arr_t(dJointFeedback) feedback;
+  uint32_t frame;
+  arr_t(Shape*) triggers; // Pairs, sensor first
   char* tags[MAX_TAGS];
   uint16_t masks[MAX_TAGS];
-  Collider* head;
+  float friction[MAX_TAGS][MAX_TAGS]; // Negative when the Colliders' own values are used
+  float restitution[MAX_TAGS][MAX_TAGS];
+  float stepSize; // Zero when updates step by their own dt
+  uint32_t maxSteps;
+  float accumulator;
+  arr_t(Collider*) colliders; // Hot per-Collider data lives in dense arrays in the same order
+  arr_t(float) lastPositions; // Pose before the most recent step, for interpolation (3 per Collider)
+  arr_t(float) lastOrientations; // 4 per Collider
+  uint32_t targetCount; // Colliders with a kinematic target
 } World;
 
 struct Collider {
   uint32_t ref;
   dBodyID body;
   World* world;
-  Collider* prev;
-  Collider* next;
+  uint32_t index; // Position in the World's arrays
   void* userdata;
   uint32_t tag;
   arr_t(Shape*) shapes;
   arr_t(Joint*) joints;
   float friction;
   float restitution;
+  float target[7]; // Kinematic target, position and quaternion
+  bool targeted;
 };
 
 struct Shape {
@@ -61,6 +161,9 @@ struct Shape {
   Collider* collider;
   void* vertices;
   void* indices;
+  TerrainInfo* terrain;
+  CollisionMesh* mesh;
+  uint32_t faceCount; // Convex hulls
   void* userdata;
   bool sensor;
 };
@@ -70,6 +173,8 @@ typedef Shape BoxShape;
 typedef Shape CapsuleShape;
 typedef Shape CylinderShape;
 typedef Shape MeshShape;
+typedef Shape TerrainShape;
+typedef Shape ConvexShape;
 
 struct Joint {
   uint32_t ref;
@@ -91,17 +196,62 @@ typedef struct {
   void* userdata;
 } RaycastData;
 
+// Poses are written as column major 4x4 matrices, or as a vec4 position (w = 1) and a quaternion
+typedef enum {
+  POSE_MATRIX,
+  POSE_VECTORS
+} PoseFormat;
+
+typedef enum {
+  CAST_RAY,
+  CAST_SPHERE,
+  CAST_BOX
+} CastType;
+
+// Options shared by a batch of casts.  Boxes are axis-aligned.
+typedef struct {
+  CastType type;
+  float size[3]; // Radius for spheres, dimensions for boxes
+  const char** tags; // Only Colliders with one of these tags are hit, unless there aren't any
+  uint32_t tagCount;
+  bool any; // Stop at the first hit found instead of the closest one
+} CastInfo;
+
+typedef struct {
+  Shape* shape; // NULL for casts that didn't hit anything
+  float position[3];
+  float normal[3];
+  float distance;
+} CastHit;
+
+// Running totals for every World.  They wrap around, so rates come from the difference between two
+// reads rather than from a reset, which lets more than one reader use them.
+typedef struct {
+  uint32_t updates;
+  uint32_t steps;
+  uint32_t updateTime; // Microseconds
+} PhysicsStats;
+
 bool lovrPhysicsInit(void);
 void lovrPhysicsDestroy(void);
+void lovrPhysicsGetStats(PhysicsStats* stats);
 
-World* lovrWorldCreate(float xg, float yg, float zg, bool allowSleep, const char** tags, uint32_t tagCount);
+World* lovrWorldCreate(float xg, float yg, float zg, bool allowSleep, const char** tags, uint32_t tagCount, BroadphaseInfo* broadphase, uint32_t threads);
 void lovrWorldDestroy(void* ref);
 void lovrWorldDestroyData(World* world);
 void lovrWorldUpdate(World* world, float dt, CollisionResolver resolver, void* userdata);
+void lovrWorldGetStepSize(World* world, float* stepSize, uint32_t* maxSteps);
+void lovrWorldSetStepSize(World* world, float stepSize, uint32_t maxSteps);
+float lovrWorldGetInterpolation(World* world);
+uint32_t lovrWorldGetPoses(World* world, PoseFormat format, float* data, uint32_t capacity);
+void lovrWorldSetPoses(World* world, Collider** colliders, uint32_t count, PoseFormat format, float* data);
+uint32_t lovrWorldGetDebugGeometry(World* world, float* data, uint32_t capacity);
+size_t lovrWorldSaveSnapshot(World* world, void* data, size_t capacity);
+void lovrWorldLoadSnapshot(World* world, const void* data, size_t size);
 void lovrWorldComputeOverlaps(World* world);
 int lovrWorldGetNextOverlap(World* world, Shape** a, Shape** b);
 int lovrWorldCollide(World* world, Shape* a, Shape* b, float friction, float restitution);
-Collider* lovrWorldGetFirstCollider(World* world);
+Collider** lovrWorldGetColliders(World* world, size_t* count);
 void lovrWorldGetGravity(World* world, float* x, float* y, float* z);
 void lovrWorldSetGravity(World* world, float x, float y, float z);
 float lovrWorldGetResponseTime(World* world);
@@ -115,10 +265,16 @@ void lovrWorldSetAngularDamping(World* world, float damping, float threshold);
 bool lovrWorldIsSleepingAllowed(World* world);
 void lovrWorldSetSleepingAllowed(World* world, bool allowed);
 void lovrWorldRaycast(World* world, float x1, float y1, float z1, float x2, float y2, float z2, RaycastCallback callback, void* userdata);
+uint32_t lovrWorldCast(World* world, CastInfo* info, float* casts, uint32_t count, CastHit* hits);
 const char* lovrWorldGetTagName(World* world, uint32_t tag);
 int lovrWorldDisableCollisionBetween(World* world, const char* tag1, const char* tag2);
 int lovrWorldEnableCollisionBetween(World* world, const char* tag1, const char* tag2);
 int lovrWorldIsCollisionEnabledBetween(World* world, const char* tag1, const char* tag);
+bool lovrWorldGetContactProperties(World* world, const char* tag1, const char* tag2, float* friction, float* restitution);
+bool lovrWorldSetContactProperties(World* world, const char* tag1, const char* tag2, float friction, float restitution);
+Shape** lovrWorldGetOverlaps(World* world, size_t* count);
+Contact* lovrWorldGetContacts(World* world, size_t* count);
+Shape** lovrWorldGetTriggers(World* world, size_t* count);
 
 Collider* lovrColliderCreate(World* world, float x, float y, float z);
 void lovrColliderDestroy(void* ref);
@@ -153,6 +309,8 @@ void lovrColliderGetPosition(Collider* collider, float* x, float* y, float* z);
 void lovrColliderSetPosition(Collider* collider, float x, float y, float z);
 void lovrColliderGetOrientation(Collider* collider, quat orientation);
 void lovrColliderSetOrientation(Collider* collider, quat orientation);
+void lovrColliderSetTarget(Collider* collider, float position[3], quat orientation);
+void lovrColliderGetInterpolatedPose(Collider* collider, float position[3], quat orientation);
 void lovrColliderGetLinearVelocity(Collider* collider, float* x, float* y, float* z);
 void lovrColliderSetLinearVelocity(Collider* collider, float x, float y, float z);
 void lovrColliderGetAngularVelocity(Collider* collider, float* x, float* y, float* z);
@@ -214,8 +372,26 @@ void lovrCylinderShapeSetRadius(CylinderShape* cylinder, float radius);
 float lovrCylinderShapeGetLength(CylinderShape* cylinder);
 void lovrCylinderShapeSetLength(CylinderShape* cylinder, float length);
 
-MeshShape* lovrMeshShapeCreate(int vertexCount, float vertices[], int indexCount, dTriIndex indices[]);
+CollisionMesh* lovrCollisionMeshCreate(float* vertices, uint32_t vertexCount, dTriIndex* indices, uint32_t indexCount, bool copy);
+CollisionMesh* lovrCollisionMeshCreateFromData(const void* data, size_t size);
+void lovrCollisionMeshDestroy(void* ref);
+void* lovrCollisionMeshEncode(CollisionMesh* mesh, size_t* size);
+
+MeshShape* lovrMeshShapeCreate(CollisionMesh* mesh);
 #define lovrMeshShapeDestroy lovrShapeDestroy
+CollisionMesh* lovrMeshShapeGetCollisionMesh(MeshShape* shape);
+
+TerrainShape* lovrTerrainShapeCreate(TerrainInfo* info);
+#define lovrTerrainShapeDestroy lovrShapeDestroy
+void lovrTerrainShapeGetSampleCount(TerrainShape* terrain, uint32_t* x, uint32_t* z);
+void lovrTerrainShapeGetSize(TerrainShape* terrain, float* width, float* depth);
+float lovrTerrainShapeGetHeight(TerrainShape* terrain, uint32_t x, uint32_t z);
+void lovrTerrainShapeSetHeight(TerrainShape* terrain, uint32_t x, uint32_t z, float height);
+void lovrTerrainShapeUpdate(TerrainShape* terrain);
+
+ConvexShape* lovrConvexShapeCreate(float* points, uint32_t count);
+#define lovrConvexShapeDestroy lovrShapeDestroy
+uint32_t lovrConvexShapeGetFaceCount(ConvexShape* convex);
 
 void lovrJointDestroy(void* ref);
 void lovrJointDestroyData(Joint* joint);
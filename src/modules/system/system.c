@@ -1,7 +1,9 @@
 #include "system/system.h"
 #include "event/event.h"
+#include "core/fs.h"
 #include "core/os.h"
 #include "core/util.h"
+#include <stddef.h>
 #include <string.h>
 
 static void onKeyboardEvent(os_button_action action, os_key key, uint32_t scancode, bool repeat) {
@@ -32,6 +34,18 @@ static void onPermissionEvent(os_permission permission, bool granted) {
 
 static struct {
   bool initialized;
+  struct {
+    bool active;
+    fs_handle file;
+    TelemetryHeader header;
+    double start;
+    double interval;
+    double next;
+    double lastFrame;
+    double frameTime;
+    double frameTimeMax;
+    uint32_t frames;
+  } telemetry;
 } state;
 
 bool lovrSystemInit() {
@@ -48,6 +62,7 @@ void lovrSystemDestroy() {
   os_on_key(NULL);
   os_on_text(NULL);
   os_on_permission(NULL);
+  lovrSystemStopTelemetry();
   memset(&state, 0, sizeof(state));
 }
 
@@ -62,3 +77,106 @@ uint32_t lovrSystemGetCoreCount() {
 void lovrSystemRequestPermission(Permission permission) {
   os_request_permission((os_permission) permission);
 }
+
+// Telemetry
+
+bool lovrSystemStartTelemetry(const char* path, float rate, uint32_t capacity) {
+  lovrAssert(rate > 0.f, "Telemetry rate must be positive");
+  lovrAssert(capacity > 0, "Telemetry capacity must be positive");
+  lovrSystemStopTelemetry();
+
+  fs_handle file;
+  if (!fs_open(path, OPEN_WRITE, &file)) {
+    return false;
+  }
+
+  TelemetryHeader* header = &state.telemetry.header;
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, TELEMETRY_MAGIC, sizeof(header->magic));
+  header->version = TELEMETRY_VERSION;
+  header->recordSize = sizeof(TelemetryRecord);
+  header->capacity = capacity;
+  header->interval = (uint32_t) (1e6 / rate);
+
+  size_t size = sizeof(*header);
+  if (!fs_write(file, header, &size) || size != sizeof(*header)) {
+    fs_close(file);
+    return false;
+  }
+
+  double now = os_get_time();
+  state.telemetry.active = true;
+  state.telemetry.file = file;
+  state.telemetry.start = now;
+  state.telemetry.interval = 1. / rate;
+  state.telemetry.next = now + state.telemetry.interval;
+  state.telemetry.lastFrame = now;
+  state.telemetry.frameTime = 0.;
+  state.telemetry.frameTimeMax = 0.;
+  state.telemetry.frames = 0;
+  return true;
+}
+
+void lovrSystemStopTelemetry() {
+  if (!state.telemetry.active) return;
+  fs_close(state.telemetry.file);
+  state.telemetry.active = false;
+}
+
+bool lovrSystemIsTelemetryActive() {
+  return state.telemetry.active;
+}
+
+// Called once a frame, this only reads the clock, and returns whether a record is due
+bool lovrSystemUpdateTelemetry() {
+  if (!state.telemetry.active) return false;
+  double now = os_get_time();
+  double dt = now - state.telemetry.lastFrame;
+  state.telemetry.lastFrame = now;
+  state.telemetry.frameTime += dt;
+  state.telemetry.frameTimeMax = MAX(state.telemetry.frameTimeMax, dt);
+  state.telemetry.frames++;
+  return now >= state.telemetry.next;
+}
+
+// Fills in the timing fields and writes the record over the oldest one.  The count in the header is
+// updated after the record, so a reader never sees a count that includes a record still being
+// written.  If the file stops taking writes (e.g. the disk is full), telemetry stops.
+void lovrSystemWriteTelemetry(TelemetryRecord* record) {
+  if (!state.telemetry.active) return;
+  TelemetryHeader* header = &state.telemetry.header;
+  double now = os_get_time();
+  uint32_t frames = state.telemetry.frames;
+
+  record->sequence = header->count;
+  record->time = now - state.telemetry.start;
+  record->frames = frames;
+  record->frameTime = frames > 0 ? (float) (state.telemetry.frameTime / frames) : 0.f;
+  record->frameTimeMax = (float) state.telemetry.frameTimeMax;
+  record->padding = 0;
+
+  fs_handle file = state.telemetry.file;
+  uint64_t offset = sizeof(*header) + (header->count % header->capacity) * header->recordSize;
+  size_t size = sizeof(*record);
+  bool success = fs_seek(file, offset) && fs_write(file, record, &size) && size == sizeof(*record);
+
+  header->count++;
+  size = sizeof(header->count);
+  success = success && fs_seek(file, offsetof(TelemetryHeader, count)) && fs_write(file, &header->count, &size);
+
+  if (!success) {
+    lovrLog(LOG_WARN, "SYS", "Telemetry stopped because its file could not be written");
+    lovrSystemStopTelemetry();
+    return;
+  }
+
+  state.telemetry.frameTime = 0.;
+  state.telemetry.frameTimeMax = 0.;
+  state.telemetry.frames = 0;
+
+  // After a hitch, the schedule restarts instead of writing a burst of records to catch up
+  state.telemetry.next += state.telemetry.interval;
+  if (state.telemetry.next <= now) {
+    state.telemetry.next = now + state.telemetry.interval;
+  }
+}
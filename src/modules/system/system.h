@@ -7,8 +7,67 @@ typedef enum {
   PERMISSION_AUDIO_CAPTURE
 } Permission;
 
+// Telemetry files start with this header, followed by a ring of capacity records.  Record i is at
+// sizeof(TelemetryHeader) + (i % capacity) * recordSize, and count is rewritten after each record,
+// so a reader can tail the file while it's being written.  Everything is in native byte order.
+#define TELEMETRY_MAGIC "LOVRTELE"
+#define TELEMETRY_VERSION 1
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t capacity;
+  uint32_t interval; // Microseconds between records
+  uint64_t count; // Records written so far
+} TelemetryHeader;
+
+typedef enum {
+  TELEMETRY_GRAPHICS = (1 << 0),
+  TELEMETRY_AUDIO = (1 << 1),
+  TELEMETRY_PHYSICS = (1 << 2)
+} TelemetrySource;
+
+// Frame times cover the time since the previous record, graphics counters are from the last frame,
+// audio is whatever lovr.audio.getStats would return, and physics has the running totals from
+// PhysicsStats.  Times are in seconds unless noted, the record's time is since telemetry started.
+typedef struct {
+  uint64_t sequence;
+  double time;
+  uint64_t luaMemory; // Bytes
+  uint64_t bufferMemory;
+  uint64_t textureMemory;
+  uint64_t triangles;
+  uint64_t uploadBytes; // Textures, buffers, and uniforms
+  uint32_t sources; // TelemetrySource bits for the modules that filled in their fields
+  uint32_t frames;
+  float frameTime; // Average
+  float frameTimeMax;
+  uint32_t drawCalls;
+  uint32_t shaderSwitches;
+  uint32_t renderPasses;
+  uint32_t flushes;
+  uint32_t bufferCount;
+  uint32_t textureCount;
+  uint32_t audioCallbacks;
+  uint32_t audioUnderruns;
+  uint32_t audioVoices;
+  uint32_t audioVirtualVoices;
+  float mixTimeAverage;
+  float mixTimeMax;
+  uint32_t physicsUpdates;
+  uint32_t physicsSteps;
+  uint32_t physicsTime; // Microseconds
+  uint32_t padding;
+} TelemetryRecord;
+
 bool lovrSystemInit(void);
 void lovrSystemDestroy(void);
 const char* lovrSystemGetOS(void);
 uint32_t lovrSystemGetCoreCount(void);
 void lovrSystemRequestPermission(Permission permission);
+bool lovrSystemStartTelemetry(const char* path, float rate, uint32_t capacity);
+void lovrSystemStopTelemetry(void);
+bool lovrSystemIsTelemetryActive(void);
+bool lovrSystemUpdateTelemetry(void);
+void lovrSystemWriteTelemetry(TelemetryRecord* record);
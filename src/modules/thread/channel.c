@@ -2,26 +2,220 @@
 #include "event/event.h"
 #include "core/util.h"
 #include "lib/tinycthread/tinycthread.h"
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
 #include <math.h>
 
+// Messages go in a fixed size lock-free ring (a Vyukov MPMC queue, where each cell has a sequence
+// number saying whether it's ready to be written or read).  When the ring is full, messages spill
+// into a locked overflow list, and keep going there until it drains so they stay in order.  The
+// lock and condition variable are otherwise only used by blocking calls, and wakeups only happen
+// when something is waiting.  Counters are 32 bits since that's what all platforms have atomics for.
+#define RING_SIZE 128
+#define RING_MASK (RING_SIZE - 1)
+
+typedef struct {
+  atomic_uint sequence;
+  Variant value;
+} Cell;
+
+// A Selector is a wait object shared by all the Channels passed to lovrChannelSelect
+typedef struct {
+  mtx_t lock;
+  cnd_t cond;
+  bool signaled;
+} Selector;
+
 struct Channel {
   uint32_t ref;
+  uint64_t hash;
+  Cell ring[RING_SIZE];
+  atomic_uint pushIndex;
+  atomic_uint popIndex;
+  atomic_uint length; // Includes messages that are still being pushed, for the capacity
+  atomic_uint capacity;
+  atomic_uint sent;
+  atomic_uint received;
+  atomic_uint overflowing;
+  atomic_uint waiters;
+  atomic_uint selecting;
   mtx_t lock;
   cnd_t cond;
-  arr_t(Variant) messages;
-  size_t head;
-  uint64_t sent;
-  uint64_t received;
-  uint64_t hash;
+  arr_t(Variant) overflow;
+  size_t overflowHead;
+  arr_t(Selector*) selectors;
 };
 
+static bool ringPush(Channel* channel, Variant* variant) {
+  uint32_t index = atomic_load_explicit(&channel->pushIndex, memory_order_relaxed);
+  for (;;) {
+    Cell* cell = &channel->ring[index & RING_MASK];
+    int32_t difference = (int32_t) (atomic_load_explicit(&cell->sequence, memory_order_acquire) - index);
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(&channel->pushIndex, &index, index + 1, memory_order_relaxed, memory_order_relaxed)) {
+        cell->value = *variant;
+        atomic_store(&cell->sequence, index + 1);
+        return true;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      index = atomic_load_explicit(&channel->pushIndex, memory_order_relaxed);
+    }
+  }
+}
+
+static bool ringPop(Channel* channel, Variant* variant) {
+  uint32_t index = atomic_load_explicit(&channel->popIndex, memory_order_relaxed);
+  for (;;) {
+    Cell* cell = &channel->ring[index & RING_MASK];
+    int32_t difference = (int32_t) (atomic_load_explicit(&cell->sequence, memory_order_acquire) - (index + 1));
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(&channel->popIndex, &index, index + 1, memory_order_relaxed, memory_order_relaxed)) {
+        *variant = cell->value;
+        atomic_store(&cell->sequence, index + RING_SIZE);
+        return true;
+      }
+    } else if (difference < 0) {
+      return false;
+    } else {
+      index = atomic_load_explicit(&channel->popIndex, memory_order_relaxed);
+    }
+  }
+}
+
+static void push(Channel* channel, Variant* variant) {
+  if (!atomic_load(&channel->overflowing) && ringPush(channel, variant)) {
+    return;
+  }
+
+  mtx_lock(&channel->lock);
+  atomic_store(&channel->overflowing, 1);
+  arr_push(&channel->overflow, *variant);
+  mtx_unlock(&channel->lock);
+}
+
+// The overflow can only be used once the ring is really empty (not just waiting on a push that's
+// writing the first cell), or it would skip ahead.  Checking that under the lock means any ring
+// push from before an overflow push is seen.
+static bool pop(Channel* channel, Variant* variant) {
+  for (;;) {
+    if (ringPop(channel, variant)) {
+      return true;
+    } else if (!atomic_load(&channel->overflowing)) {
+      return false;
+    }
+
+    mtx_lock(&channel->lock);
+    if (atomic_load(&channel->pushIndex) == atomic_load(&channel->popIndex)) {
+      bool popped = channel->overflowHead < channel->overflow.length;
+      if (popped) {
+        *variant = channel->overflow.data[channel->overflowHead++];
+      }
+      if (channel->overflowHead == channel->overflow.length) {
+        channel->overflowHead = channel->overflow.length = 0;
+        atomic_store(&channel->overflowing, 0);
+      }
+      mtx_unlock(&channel->lock);
+      return popped;
+    }
+    mtx_unlock(&channel->lock);
+    thrd_yield();
+  }
+}
+
+// Reserves room for a message, returning the previous length
+static bool reserve(Channel* channel, uint32_t* length) {
+  *length = atomic_load(&channel->length);
+  do {
+    if (*length >= atomic_load(&channel->capacity)) {
+      return false;
+    }
+  } while (!atomic_compare_exchange_weak(&channel->length, length, *length + 1));
+  return true;
+}
+
+static bool hasRoom(Channel* channel, uint32_t id) {
+  return atomic_load(&channel->length) < atomic_load(&channel->capacity);
+}
+
+static bool hasMessages(Channel* channel, uint32_t id) {
+  uint32_t index = atomic_load(&channel->popIndex);
+  uint32_t sequence = atomic_load(&channel->ring[index & RING_MASK].sequence);
+  return sequence == index + 1 || atomic_load(&channel->overflowing);
+}
+
+// Ids wrap around, so they're compared by their distance
+static bool hasRead(Channel* channel, uint32_t id) {
+  return (int32_t) (atomic_load(&channel->received) - id) >= 0;
+}
+
+static void wake(Selector* selector) {
+  mtx_lock(&selector->lock);
+  selector->signaled = true;
+  cnd_signal(&selector->cond);
+  mtx_unlock(&selector->lock);
+}
+
+static void notify(Channel* channel) {
+  if (atomic_load(&channel->waiters) > 0 || atomic_load(&channel->selecting) > 0) {
+    mtx_lock(&channel->lock);
+    cnd_broadcast(&channel->cond);
+    for (size_t i = 0; i < channel->selectors.length; i++) {
+      wake(channel->selectors.data[i]);
+    }
+    mtx_unlock(&channel->lock);
+  }
+}
+
+static void getDeadline(struct timespec* until, const struct timespec* start, double timeout) {
+  double whole, fraction;
+  fraction = modf(timeout, &whole);
+  until->tv_sec = start->tv_sec + whole;
+  until->tv_nsec = start->tv_nsec + fraction * 1e9;
+  if (until->tv_nsec >= 1000000000) {
+    until->tv_sec++;
+    until->tv_nsec -= 1000000000;
+  }
+}
+
+// Waiters register themselves before checking the condition, and everything that changes it
+// checks for waiters afterwards, so a wakeup can't get lost between the two
+static void waitFor(Channel* channel, bool (*ready)(Channel* channel, uint32_t id), uint32_t id, double* timeout) {
+  mtx_lock(&channel->lock);
+  atomic_fetch_add(&channel->waiters, 1);
+
+  if (!ready(channel, id)) {
+    if (isinf(*timeout)) {
+      cnd_wait(&channel->cond, &channel->lock);
+    } else {
+      struct timespec start;
+      struct timespec until;
+      struct timespec stop;
+      timespec_get(&start, TIME_UTC);
+      getDeadline(&until, &start, *timeout);
+      cnd_timedwait(&channel->cond, &channel->lock, &until);
+      timespec_get(&stop, TIME_UTC);
+      *timeout -= (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    }
+  }
+
+  atomic_fetch_sub(&channel->waiters, 1);
+  mtx_unlock(&channel->lock);
+}
+
 Channel* lovrChannelCreate(uint64_t hash) {
   Channel* channel = calloc(1, sizeof(Channel));
   lovrAssert(channel, "Out of memory");
   channel->ref = 1;
-  arr_init(&channel->messages, realloc);
+  for (uint32_t i = 0; i < RING_SIZE; i++) {
+    atomic_init(&channel->ring[i].sequence, i);
+  }
+  atomic_init(&channel->capacity, UINT32_MAX);
+  arr_init(&channel->overflow, realloc);
+  arr_init(&channel->selectors, realloc);
   mtx_init(&channel->lock, mtx_plain | mtx_timed);
   cnd_init(&channel->cond);
   channel->hash = hash;
@@ -31,121 +225,200 @@ Channel* lovrChannelCreate(uint64_t hash) {
 void lovrChannelDestroy(void* ref) {
   Channel* channel = ref;
   lovrChannelClear(channel);
-  arr_free(&channel->messages);
+  arr_free(&channel->overflow);
+  arr_free(&channel->selectors);
   mtx_destroy(&channel->lock);
   cnd_destroy(&channel->cond);
   free(channel);
 }
 
+// When the Channel is at its capacity, this waits for room (using up the timeout), or fails without
+// pushing the message if there's no timeout.  The id is zero when the message wasn't pushed.
 bool lovrChannelPush(Channel* channel, Variant* variant, double timeout, uint64_t* id) {
-  mtx_lock(&channel->lock);
-  if (channel->messages.length == 0) {
+  bool blocking = !isnan(timeout) && timeout >= 0;
+
+  uint32_t length;
+  while (!reserve(channel, &length)) {
+    if (!blocking || timeout < 0) {
+      *id = 0;
+      return false;
+    }
+    waitFor(channel, hasRoom, 0, &timeout);
+  }
+
+  // Channels keep themselves alive while they have messages
+  if (length == 0) {
     lovrRetain(channel);
   }
-  arr_push(&channel->messages, *variant);
-  *id = ++channel->sent;
-  cnd_broadcast(&channel->cond);
 
-  if (isnan(timeout) || timeout < 0) {
-    mtx_unlock(&channel->lock);
+  // Zero means the message wasn't pushed, so when the ids wrap around that one gets the next bit
+  uint32_t sent = atomic_fetch_add(&channel->sent, 1) + 1;
+  *id = sent == 0 ? (1ull << 32) : sent;
+  push(channel, variant);
+  notify(channel);
+
+  if (!blocking) {
     return false;
   }
 
-  while (channel->received < *id && timeout >= 0) {
-    if (isinf(timeout)) {
-      cnd_wait(&channel->cond, &channel->lock);
-    } else {
-      struct timespec start;
-      struct timespec until;
-      struct timespec stop;
-      timespec_get(&start, TIME_UTC);
-      double whole, fraction;
-      fraction = modf(timeout, &whole);
-      until.tv_sec = start.tv_sec + whole;
-      until.tv_nsec = start.tv_nsec + fraction * 1e9;
-      cnd_timedwait(&channel->cond, &channel->lock, &until);
-      timespec_get(&stop, TIME_UTC);
-      timeout -= (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
-    }
+  while (!hasRead(channel, sent) && timeout >= 0) {
+    waitFor(channel, hasRead, sent, &timeout);
   }
 
-  bool read = channel->received >= *id;
-  mtx_unlock(&channel->lock);
-  return read;
+  return hasRead(channel, sent);
 }
 
 bool lovrChannelPop(Channel* channel, Variant* variant, double timeout) {
-  mtx_lock(&channel->lock);
-
-  do {
-    if (channel->head < channel->messages.length) {
-      *variant = channel->messages.data[channel->head++];
-      if (channel->head == channel->messages.length) {
-        channel->head = channel->messages.length = 0;
+  for (;;) {
+    if (pop(channel, variant)) {
+      atomic_fetch_add(&channel->received, 1);
+      bool empty = atomic_fetch_sub(&channel->length, 1) == 1;
+      notify(channel);
+      if (empty) {
         lovrRelease(channel, lovrChannelDestroy);
       }
-      channel->received++;
-      cnd_broadcast(&channel->cond);
-      mtx_unlock(&channel->lock);
       return true;
     } else if (isnan(timeout) || timeout < 0) {
-      mtx_unlock(&channel->lock);
       return false;
     }
 
-    if (isinf(timeout)) {
-      cnd_wait(&channel->cond, &channel->lock);
-    } else {
-      struct timespec start;
-      struct timespec until;
-      struct timespec stop;
-      timespec_get(&start, TIME_UTC);
-      double whole, fraction;
-      fraction = modf(timeout, &whole);
-      until.tv_sec = start.tv_sec + whole;
-      until.tv_nsec = start.tv_nsec + fraction * 1e9;
-      cnd_timedwait(&channel->cond, &channel->lock, &until);
-      timespec_get(&stop, TIME_UTC);
-      timeout -= (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / (double) 1e9;
+    waitFor(channel, hasMessages, 0, &timeout);
+  }
+}
+
+// Selectors are attached to every Channel before they're checked for messages, and pushes notify
+// attached Selectors afterwards, so a message pushed in between always wakes the select up.  The
+// Channel to check first rotates between calls, so a busy Channel can't starve the others.
+bool lovrChannelSelect(Channel** channels, uint32_t count, Variant* variant, double timeout, uint32_t* index) {
+  static LOVR_THREAD_LOCAL uint32_t rotation;
+  uint32_t first = count > 0 ? rotation++ % count : 0;
+  bool blocking = !isnan(timeout) && timeout >= 0;
+  struct timespec start, until;
+  if (blocking && !isinf(timeout)) {
+    timespec_get(&start, TIME_UTC);
+    getDeadline(&until, &start, timeout);
+  }
+
+  Selector selector;
+  mtx_init(&selector.lock, mtx_plain | mtx_timed);
+  cnd_init(&selector.cond);
+
+  bool found = false;
+  for (;;) {
+    for (uint32_t i = 0; i < count && !found; i++) {
+      uint32_t j = (first + i) % count;
+      if (lovrChannelPop(channels[j], variant, NAN)) {
+        *index = j;
+        found = true;
+      }
+    }
+
+    if (found || !blocking) {
+      break;
     }
-  } while (1);
+
+    selector.signaled = false;
+    for (uint32_t i = 0; i < count; i++) {
+      mtx_lock(&channels[i]->lock);
+      atomic_fetch_add(&channels[i]->selecting, 1);
+      arr_push(&channels[i]->selectors, &selector);
+      mtx_unlock(&channels[i]->lock);
+    }
+
+    bool ready = false;
+    for (uint32_t i = 0; i < count && !ready; i++) {
+      ready = hasMessages(channels[i], 0);
+    }
+
+    bool expired = false;
+    if (!ready) {
+      mtx_lock(&selector.lock);
+      while (!selector.signaled && !expired) {
+        if (isinf(timeout)) {
+          cnd_wait(&selector.cond, &selector.lock);
+        } else {
+          expired = cnd_timedwait(&selector.cond, &selector.lock, &until) == thrd_timedout;
+        }
+      }
+      mtx_unlock(&selector.lock);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+      mtx_lock(&channels[i]->lock);
+      for (size_t k = 0; k < channels[i]->selectors.length; k++) {
+        if (channels[i]->selectors.data[k] == &selector) {
+          arr_splice(&channels[i]->selectors, k, 1);
+          break;
+        }
+      }
+      atomic_fetch_sub(&channels[i]->selecting, 1);
+      mtx_unlock(&channels[i]->lock);
+    }
+
+    // One last look, in case a message came in right as the wait timed out
+    if (expired) {
+      blocking = false;
+    }
+  }
+
+  mtx_destroy(&selector.lock);
+  cnd_destroy(&selector.cond);
+  return found;
 }
 
+// The value is copied and then checked again, in case it was popped (and the cell reused) meanwhile
 bool lovrChannelPeek(Channel* channel, Variant* variant) {
-  mtx_lock(&channel->lock);
-
-  if (channel->head < channel->messages.length) {
-    *variant = channel->messages.data[channel->head];
-    mtx_unlock(&channel->lock);
-    return true;
+  for (;;) {
+    uint32_t index = atomic_load(&channel->popIndex);
+    Cell* cell = &channel->ring[index & RING_MASK];
+    int32_t difference = (int32_t) (atomic_load(&cell->sequence) - (index + 1));
+    if (difference == 0) {
+      *variant = cell->value;
+      if (atomic_load(&cell->sequence) == index + 1 && atomic_load(&channel->popIndex) == index) {
+        return true;
+      }
+    } else if (difference < 0) {
+      break;
+    }
   }
 
+  mtx_lock(&channel->lock);
+  bool found = channel->overflowHead < channel->overflow.length;
+  if (found) {
+    *variant = channel->overflow.data[channel->overflowHead];
+  }
   mtx_unlock(&channel->lock);
-  return false;
+  return found;
 }
 
 void lovrChannelClear(Channel* channel) {
-  mtx_lock(&channel->lock);
-  for (size_t i = channel->head; i < channel->messages.length; i++) {
-    lovrVariantDestroy(&channel->messages.data[i]);
+  Variant variant;
+  while (lovrChannelPop(channel, &variant, NAN)) {
+    lovrVariantDestroy(&variant);
   }
-  channel->received = channel->sent;
-  arr_clear(&channel->messages);
-  channel->head = 0;
-  cnd_broadcast(&channel->cond);
-  mtx_unlock(&channel->lock);
+
+  // Messages that were being pushed while clearing count as read too
+  uint32_t received = atomic_load(&channel->received);
+  uint32_t sent = atomic_load(&channel->sent);
+  while ((int32_t) (sent - received) > 0 && !atomic_compare_exchange_weak(&channel->received, &received, sent));
+  notify(channel);
 }
 
 uint64_t lovrChannelGetCount(Channel* channel) {
-  mtx_lock(&channel->lock);
-  uint64_t length = channel->messages.length - channel->head;
-  mtx_unlock(&channel->lock);
-  return length;
+  return atomic_load(&channel->length);
 }
 
 bool lovrChannelHasRead(Channel* channel, uint64_t id) {
-  mtx_lock(&channel->lock);
-  bool received = channel->received >= id;
-  mtx_unlock(&channel->lock);
-  return received;
+  return hasRead(channel, (uint32_t) id);
+}
+
+// Zero means unbounded
+uint32_t lovrChannelGetCapacity(Channel* channel) {
+  uint32_t capacity = atomic_load(&channel->capacity);
+  return capacity == UINT32_MAX ? 0 : capacity;
+}
+
+void lovrChannelSetCapacity(Channel* channel, uint32_t capacity) {
+  atomic_store(&channel->capacity, capacity == 0 ? UINT32_MAX : capacity);
+  notify(channel);
 }
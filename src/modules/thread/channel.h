@@ -10,7 +10,10 @@ Channel* lovrChannelCreate(uint64_t hash);
 void lovrChannelDestroy(void* ref);
 bool lovrChannelPush(Channel* channel, struct Variant* variant, double timeout, uint64_t* id);
 bool lovrChannelPop(Channel* channel, struct Variant* variant, double timeout);
+bool lovrChannelSelect(Channel** channels, uint32_t count, struct Variant* variant, double timeout, uint32_t* index);
 bool lovrChannelPeek(Channel* channel, struct Variant* variant);
 void lovrChannelClear(Channel* channel);
 uint64_t lovrChannelGetCount(Channel* channel);
 bool lovrChannelHasRead(Channel* channel, uint64_t id);
+uint32_t lovrChannelGetCapacity(Channel* channel);
+void lovrChannelSetCapacity(Channel* channel, uint32_t capacity);
@@ -0,0 +1,310 @@
+#include "thread/pool.h"
+#include "core/util.h"
+#include "lib/tinycthread/tinycthread.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEQUE_SIZE 256
+#define DEQUE_MASK (DEQUE_SIZE - 1)
+#define MAX_RANGES (4 * (MAX_POOL_WORKERS + 1))
+
+typedef struct {
+  JobFn* fn;
+  void* arg;
+  JobCounter* counter;
+} Job;
+
+// A Chase-Lev deque.  Its worker pushes and pops at the bottom, everyone else steals from the top.
+// Indices wrap around and are compared by their distance.  A full deque sends jobs to the queue.
+typedef struct {
+  atomic_uint top;
+  atomic_uint bottom;
+  Job jobs[DEQUE_SIZE];
+} Deque;
+
+typedef struct {
+  RangeFn* fn;
+  void* context;
+  uint32_t start;
+  uint32_t end;
+} Range;
+
+static struct {
+  bool initialized;
+  atomic_uint quit;
+  mtx_t lock;
+  cnd_t cond; // Idle workers wait here
+  cnd_t done; // Threads waiting on counters wait here
+  atomic_uint queued; // Jobs in the queue and the deques
+  atomic_uint sleeping;
+  atomic_uint waiting;
+  arr_t(Job) jobs;
+  size_t head;
+  Deque deques[MAX_POOL_WORKERS];
+  thrd_t workers[MAX_POOL_WORKERS];
+  uint32_t workerCount;
+  uint64_t affinity;
+  os_thread_priority priority;
+} state;
+
+// One more than the index of the worker running on this thread, zero for other threads
+static LOVR_THREAD_LOCAL uint32_t currentWorker;
+
+static bool dequePush(Deque* deque, Job job) {
+  uint32_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+  uint32_t top = atomic_load(&deque->top);
+  if (bottom - top >= DEQUE_SIZE) {
+    return false;
+  }
+  deque->jobs[bottom & DEQUE_MASK] = job;
+  atomic_store(&deque->bottom, bottom + 1);
+  return true;
+}
+
+static bool dequePop(Deque* deque, Job* job) {
+  uint32_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store(&deque->bottom, bottom);
+  uint32_t top = atomic_load(&deque->top);
+  int32_t size = (int32_t) (bottom - top);
+
+  if (size < 0) {
+    atomic_store(&deque->bottom, top);
+    return false;
+  }
+
+  *job = deque->jobs[bottom & DEQUE_MASK];
+  if (size > 0) {
+    return true;
+  }
+
+  // This was the last job, so a thief might be taking it too
+  uint32_t expected = top;
+  bool won = atomic_compare_exchange_strong(&deque->top, &expected, top + 1);
+  atomic_store(&deque->bottom, top + 1);
+  return won;
+}
+
+static bool dequeSteal(Deque* deque, Job* job) {
+  uint32_t top = atomic_load(&deque->top);
+  uint32_t bottom = atomic_load(&deque->bottom);
+  if ((int32_t) (bottom - top) <= 0) {
+    return false;
+  }
+  *job = deque->jobs[top & DEQUE_MASK];
+  return atomic_compare_exchange_strong(&deque->top, &top, top + 1);
+}
+
+static void push(Job job) {
+  atomic_fetch_add(&state.queued, 1);
+
+  if (!currentWorker || !dequePush(&state.deques[currentWorker - 1], job)) {
+    mtx_lock(&state.lock);
+    arr_push(&state.jobs, job);
+    mtx_unlock(&state.lock);
+  }
+
+  if (atomic_load(&state.sleeping) > 0) {
+    mtx_lock(&state.lock);
+    cnd_signal(&state.cond);
+    mtx_unlock(&state.lock);
+  }
+}
+
+// Checks this thread's deque, then the queue, then steals from the other workers
+static bool findJob(Job* job) {
+  if (atomic_load(&state.queued) == 0) {
+    return false;
+  }
+
+  uint32_t self = currentWorker;
+  bool found = self && dequePop(&state.deques[self - 1], job);
+
+  if (!found) {
+    mtx_lock(&state.lock);
+    if (state.head < state.jobs.length) {
+      *job = state.jobs.data[state.head++];
+      if (state.head == state.jobs.length) {
+        state.head = state.jobs.length = 0;
+      }
+      found = true;
+    }
+    mtx_unlock(&state.lock);
+  }
+
+  for (uint32_t i = 0; i < state.workerCount && !found; i++) {
+    uint32_t victim = (self + i) % state.workerCount;
+    if (victim + 1 != self) {
+      found = dequeSteal(&state.deques[victim], job);
+    }
+  }
+
+  if (found) {
+    atomic_fetch_sub(&state.queued, 1);
+  }
+
+  return found;
+}
+
+// The counter can be freed as soon as it reaches zero, so it isn't touched after that
+// Jobs can use temporary memory, which is released as soon as they return
+static void runJob(Job* job) {
+  temp_mark_t mark = temp_mark();
+  job->fn(job->arg);
+  temp_rewind(mark);
+  if (job->counter && atomic_fetch_sub((atomic_uint*) &job->counter->remaining, 1) == 1) {
+    if (atomic_load(&state.waiting) > 0) {
+      mtx_lock(&state.lock);
+      cnd_broadcast(&state.done);
+      mtx_unlock(&state.lock);
+    }
+  }
+}
+
+// Sleepers register before checking for work, and everything that adds work checks for sleepers
+// afterwards, so wakeups don't get lost
+static int worker(void* arg) {
+  currentWorker = (uint32_t) (uintptr_t) arg;
+  if (state.affinity != 0) os_thread_set_affinity(state.affinity);
+  if (state.priority != OS_THREAD_PRIORITY_NORMAL) os_thread_set_priority(state.priority);
+  Job job;
+
+  while (!atomic_load(&state.quit)) {
+    if (findJob(&job)) {
+      runJob(&job);
+      continue;
+    }
+
+    mtx_lock(&state.lock);
+    atomic_fetch_add(&state.sleeping, 1);
+    if (atomic_load(&state.queued) == 0 && !atomic_load(&state.quit)) {
+      cnd_wait(&state.cond, &state.lock);
+    }
+    atomic_fetch_sub(&state.sleeping, 1);
+    mtx_unlock(&state.lock);
+  }
+
+  temp_free();
+  return 0;
+}
+
+bool lovrThreadPoolInit(uint32_t workerCount, uint64_t affinity, os_thread_priority priority) {
+  if (state.initialized) return false;
+  state.affinity = affinity;
+  state.priority = priority;
+  mtx_init(&state.lock, mtx_plain);
+  cnd_init(&state.cond);
+  cnd_init(&state.done);
+  arr_init(&state.jobs, realloc);
+  state.workerCount = CLAMP(workerCount, 1, MAX_POOL_WORKERS);
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    lovrAssert(thrd_create(&state.workers[i], worker, (void*) (uintptr_t) (i + 1)) == thrd_success, "Could not create worker thread");
+  }
+  return state.initialized = true;
+}
+
+// Jobs that haven't started yet are dropped, jobs that are running are waited on
+void lovrThreadPoolDestroy() {
+  if (!state.initialized) return;
+  mtx_lock(&state.lock);
+  atomic_store(&state.quit, 1);
+  cnd_broadcast(&state.cond);
+  mtx_unlock(&state.lock);
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    thrd_join(state.workers[i], NULL);
+  }
+  arr_free(&state.jobs);
+  cnd_destroy(&state.done);
+  cnd_destroy(&state.cond);
+  mtx_destroy(&state.lock);
+  memset(&state, 0, sizeof(state));
+}
+
+uint32_t lovrThreadPoolGetWorkerCount() {
+  return state.workerCount;
+}
+
+void lovrThreadPoolSubmit(JobFn* fn, void* arg) {
+  lovrAssert(state.initialized, "The thread pool is not initialized");
+  push((Job) { fn, arg, NULL });
+}
+
+// Runs the job inline when the pool hasn't been started
+void lovrThreadPoolSubmitCounted(JobFn* fn, void* arg, JobCounter* counter) {
+  if (!state.initialized) {
+    fn(arg);
+    return;
+  }
+
+  atomic_fetch_add((atomic_uint*) &counter->remaining, 1);
+  push((Job) { fn, arg, counter });
+}
+
+void lovrThreadPoolWait(JobCounter* counter) {
+  atomic_uint* remaining = (atomic_uint*) &counter->remaining;
+  Job job;
+
+  while (atomic_load(remaining) > 0) {
+    if (findJob(&job)) {
+      runJob(&job);
+      continue;
+    }
+
+    mtx_lock(&state.lock);
+    atomic_fetch_add(&state.waiting, 1);
+    if (atomic_load(remaining) > 0 && atomic_load(&state.queued) == 0) {
+      cnd_wait(&state.done, &state.lock);
+    }
+    atomic_fetch_sub(&state.waiting, 1);
+    mtx_unlock(&state.lock);
+  }
+}
+
+// Runs a job for each argument and waits for all of them to finish
+void lovrThreadPoolRun(JobFn* fn, void** args, uint32_t count) {
+  if (!state.initialized || count <= 1) {
+    for (uint32_t i = 0; i < count; i++) {
+      fn(args[i]);
+    }
+    return;
+  }
+
+  JobCounter counter = { 0 };
+  for (uint32_t i = 1; i < count; i++) {
+    lovrThreadPoolSubmitCounted(fn, args[i], &counter);
+  }
+  fn(args[0]);
+  lovrThreadPoolWait(&counter);
+}
+
+static void runRange(void* arg) {
+  Range* range = arg;
+  range->fn(range->context, range->start, range->end);
+}
+
+// Splits [0, count) into ranges of at least grain items, a few per worker so stealing can even out
+// uneven work, and waits for all of them.  The calling thread takes the first range.
+void lovrThreadPoolParallelFor(RangeFn* fn, void* context, uint32_t count, uint32_t grain) {
+  grain = MAX(grain, 1);
+  uint32_t rangeCount = MIN((count + grain - 1) / grain, MIN(4 * (state.workerCount + 1), MAX_RANGES));
+
+  if (!state.initialized || rangeCount <= 1) {
+    if (count > 0) fn(context, 0, count);
+    return;
+  }
+
+  Range ranges[MAX_RANGES];
+  JobCounter counter = { 0 };
+  uint32_t size = count / rangeCount;
+  uint32_t extra = count % rangeCount;
+  uint32_t start = 0;
+  for (uint32_t i = 0; i < rangeCount; i++) {
+    uint32_t end = start + size + (i < extra);
+    ranges[i] = (Range) { fn, context, start, end };
+    if (i > 0) lovrThreadPoolSubmitCounted(runRange, &ranges[i], &counter);
+    start = end;
+  }
+
+  runRange(&ranges[0]);
+  lovrThreadPoolWait(&counter);
+}
@@ -0,0 +1,31 @@
+#include "core/os.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// The pool runs small native jobs (decoding, transcoding, etc.) on a fixed set of worker threads.
+// Each worker has its own deque: jobs submitted by a job go on the front of its worker's deque, and
+// idle workers steal from the back of the others.  Jobs submitted from other threads go on a shared
+// queue.  Jobs may run and finish in any order, and must not call into Lua.
+//
+// Counters track a set of jobs.  Waiting on a counter runs other jobs until the counter reaches
+// zero, so jobs can wait on the jobs they submit without tying up a worker.
+
+#pragma once
+
+#define MAX_POOL_WORKERS 16
+
+typedef void JobFn(void* arg);
+typedef void RangeFn(void* context, uint32_t start, uint32_t end);
+
+typedef struct {
+  uint32_t remaining;
+} JobCounter;
+
+bool lovrThreadPoolInit(uint32_t workerCount, uint64_t affinity, os_thread_priority priority);
+void lovrThreadPoolDestroy(void);
+uint32_t lovrThreadPoolGetWorkerCount(void);
+void lovrThreadPoolSubmit(JobFn* fn, void* arg);
+void lovrThreadPoolSubmitCounted(JobFn* fn, void* arg, JobCounter* counter);
+void lovrThreadPoolWait(JobCounter* counter);
+void lovrThreadPoolRun(JobFn* fn, void** args, uint32_t count);
+void lovrThreadPoolParallelFor(RangeFn* fn, void* context, uint32_t count, uint32_t grain);
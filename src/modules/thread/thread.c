@@ -4,6 +4,7 @@
 #include "core/util.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 typedef union {
   uint64_t u64;
@@ -14,17 +15,98 @@ static struct {
   bool initialized;
   mtx_t channelLock;
   map_t channels;
+  TaskRunner runner;
+  thrd_t workers[MAX_TASK_WORKERS];
+  uint32_t workerCount;
+  mtx_t taskLock;
+  cnd_t taskReady;
+  cnd_t taskDone;
+  Task* head;
+  Task* tail;
+  bool quit;
+  uint64_t affinity;
+  os_thread_priority priority;
 } state;
 
+// Scheduling changes are best effort, a thread that can't get them just keeps the defaults
+static void applyScheduling(uint64_t affinity, os_thread_priority priority) {
+  if (affinity != 0) os_thread_set_affinity(affinity);
+  if (priority != OS_THREAD_PRIORITY_NORMAL) os_thread_set_priority(priority);
+}
+
+static int threadMain(void* arg) {
+  Thread* thread = arg;
+  applyScheduling(thread->affinity, thread->priority);
+  int status = thread->runner(thread);
+  temp_free();
+  return status;
+}
+
+// Workers set up their context once and keep it for every Task they run
+static int taskWorker(void* arg) {
+  applyScheduling(state.affinity, state.priority);
+  void* context = state.runner.init();
+
+  for (;;) {
+    mtx_lock(&state.taskLock);
+    while (!state.head && !state.quit) {
+      cnd_wait(&state.taskReady, &state.taskLock);
+    }
+
+    if (state.quit) {
+      mtx_unlock(&state.taskLock);
+      break;
+    }
+
+    Task* task = state.head;
+    state.head = task->next;
+    if (!state.head) state.tail = NULL;
+    mtx_unlock(&state.taskLock);
+
+    state.runner.run(context, task);
+    temp_reset();
+
+    mtx_lock(&state.taskLock);
+    task->done = true;
+    cnd_broadcast(&state.taskDone);
+    mtx_unlock(&state.taskLock);
+    lovrRelease(task, lovrTaskDestroy);
+  }
+
+  state.runner.destroy(context);
+  temp_free();
+  return 0;
+}
+
 bool lovrThreadModuleInit() {
   if (state.initialized) return false;
   mtx_init(&state.channelLock, mtx_plain);
+  mtx_init(&state.taskLock, mtx_plain | mtx_timed);
+  cnd_init(&state.taskReady);
+  cnd_init(&state.taskDone);
   map_init(&state.channels, 0);
   return state.initialized = true;
 }
 
 void lovrThreadModuleDestroy() {
   if (!state.initialized) return;
+
+  mtx_lock(&state.taskLock);
+  state.quit = true;
+  cnd_broadcast(&state.taskReady);
+  mtx_unlock(&state.taskLock);
+  for (uint32_t i = 0; i < state.workerCount; i++) {
+    thrd_join(state.workers[i], NULL);
+  }
+
+  // Tasks that never got to run are marked as done, in case something is still holding on to them
+  for (Task* task = state.head; task;) {
+    Task* next = task->next;
+    task->done = true;
+    lovrRelease(task, lovrTaskDestroy);
+    task = next;
+  }
+
   for (size_t i = 0; i < state.channels.size; i++) {
     if (state.channels.values[i] != MAP_NIL) {
       ChannelEntry entry = { state.channels.values[i] };
@@ -32,8 +114,11 @@ void lovrThreadModuleDestroy() {
     }
   }
   mtx_destroy(&state.channelLock);
+  mtx_destroy(&state.taskLock);
+  cnd_destroy(&state.taskReady);
+  cnd_destroy(&state.taskDone);
   map_free(&state.channels);
-  state.initialized = false;
+  memset(&state, 0, sizeof(state));
 }
 
 Channel* lovrThreadGetChannel(const char* name) {
@@ -57,6 +142,7 @@ Thread* lovrThreadCreate(int (*runner)(void*), Blob* body) {
   thread->ref = 1;
   thread->runner = runner;
   thread->body = body;
+  thread->priority = OS_THREAD_PRIORITY_NORMAL;
   mtx_init(&thread->lock, mtx_plain);
   lovrRetain(body);
   return thread;
@@ -83,7 +169,7 @@ void lovrThreadStart(Thread* thread, Variant* arguments, uint32_t argumentCount)
   lovrAssert(argumentCount <= MAX_THREAD_ARGUMENTS, "Too many Thread arguments (max is %d)", MAX_THREAD_ARGUMENTS);
   thread->argumentCount = argumentCount;
   memcpy(thread->arguments, arguments, argumentCount * sizeof(Variant));
-  if (thrd_create(&thread->handle, thread->runner, thread) != thrd_success) {
+  if (thrd_create(&thread->handle, threadMain, thread) != thrd_success) {
     lovrThrow("Could not create thread...sorry");
   }
 }
@@ -102,3 +188,121 @@ bool lovrThreadIsRunning(Thread* thread) {
 const char* lovrThreadGetError(Thread* thread) {
   return thread->error;
 }
+
+uint64_t lovrThreadGetAffinity(Thread* thread) {
+  return thread->affinity;
+}
+
+void lovrThreadSetAffinity(Thread* thread, uint64_t mask) {
+  thread->affinity = mask;
+}
+
+os_thread_priority lovrThreadGetPriority(Thread* thread) {
+  return thread->priority;
+}
+
+void lovrThreadSetPriority(Thread* thread, os_thread_priority priority) {
+  thread->priority = priority;
+}
+
+// Returns false if the workers were already started
+bool lovrThreadStartWorkers(TaskRunner* runner, uint32_t count, uint64_t affinity, os_thread_priority priority) {
+  if (state.workerCount > 0) return false;
+  lovrAssert(state.initialized, "The thread module needs to be initialized before starting workers");
+  state.runner = *runner;
+  state.affinity = affinity;
+  state.priority = priority;
+  count = CLAMP(count, 1, MAX_TASK_WORKERS);
+  for (uint32_t i = 0; i < count; i++) {
+    if (thrd_create(&state.workers[i], taskWorker, NULL) != thrd_success) {
+      lovrAssert(i > 0, "Could not create thread...sorry");
+      break;
+    }
+    state.workerCount++;
+  }
+  return true;
+}
+
+uint32_t lovrThreadGetTaskWorkerCount() {
+  return state.workerCount;
+}
+
+Task* lovrTaskCreate(Blob* body, Variant* arguments, uint32_t argumentCount) {
+  lovrAssert(argumentCount <= MAX_THREAD_ARGUMENTS, "Too many Task arguments (max is %d)", MAX_THREAD_ARGUMENTS);
+  Task* task = calloc(1, sizeof(Task));
+  lovrAssert(task, "Out of memory");
+  task->ref = 1;
+  task->body = body;
+  task->hash = hash64(body->data, body->size);
+  task->argumentCount = argumentCount;
+  memcpy(task->arguments, arguments, argumentCount * sizeof(Variant));
+  lovrRetain(body);
+  return task;
+}
+
+void lovrTaskDestroy(void* ref) {
+  Task* task = ref;
+  for (uint32_t i = 0; i < task->argumentCount; i++) {
+    lovrVariantDestroy(&task->arguments[i]);
+  }
+  for (uint32_t i = 0; i < task->resultCount; i++) {
+    lovrVariantDestroy(&task->results[i]);
+  }
+  lovrRelease(task->body, lovrBlobDestroy);
+  free(task->error);
+  free(task);
+}
+
+// The queue keeps a reference to the Task until a worker is done with it
+void lovrTaskSubmit(Task* task) {
+  lovrAssert(state.workerCount > 0, "Task workers have not been started");
+  lovrRetain(task);
+  mtx_lock(&state.taskLock);
+  lovrAssert(!state.quit, "The thread module is shutting down");
+  if (state.tail) {
+    state.tail->next = task;
+  } else {
+    state.head = task;
+  }
+  state.tail = task;
+  cnd_signal(&state.taskReady);
+  mtx_unlock(&state.taskLock);
+}
+
+// A NaN timeout doesn't wait at all, and an infinite one waits until the Task finishes
+bool lovrTaskWait(Task* task, double timeout) {
+  mtx_lock(&state.taskLock);
+  if (!task->done && !isnan(timeout) && timeout > 0) {
+    if (isinf(timeout)) {
+      while (!task->done) {
+        cnd_wait(&state.taskDone, &state.taskLock);
+      }
+    } else {
+      struct timespec until;
+      timespec_get(&until, TIME_UTC);
+      double whole, fraction;
+      fraction = modf(timeout, &whole);
+      until.tv_sec += whole;
+      until.tv_nsec += fraction * 1e9;
+      if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+      }
+      while (!task->done && cnd_timedwait(&state.taskDone, &state.taskLock, &until) == thrd_success);
+    }
+  }
+  bool done = task->done;
+  mtx_unlock(&state.taskLock);
+  return done;
+}
+
+bool lovrTaskIsDone(Task* task) {
+  mtx_lock(&state.taskLock);
+  bool done = task->done;
+  mtx_unlock(&state.taskLock);
+  return done;
+}
+
+const char* lovrTaskGetError(Task* task) {
+  return lovrTaskIsDone(task) ? task->error : NULL;
+}
@@ -1,5 +1,6 @@
 #include "data/blob.h"
 #include "event/event.h"
+#include "core/os.h"
 #include "lib/tinycthread/tinycthread.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -12,6 +13,10 @@
 #define MAX_THREAD_ARGUMENTS 4
 
 struct Channel;
+struct Task;
+
+// A Thread's affinity and priority are applied when it starts, so changing them while it's running
+// only takes effect the next time it's started.
 
 typedef struct Thread {
   uint32_t ref;
@@ -23,8 +28,35 @@ typedef struct Thread {
   int (*runner)(void*);
   char* error;
   bool running;
+  uint64_t affinity;
+  os_thread_priority priority;
 } Thread;
 
+// Tasks run on a set of long-lived workers that are started the first time a Task is submitted.
+// The init callback runs once on each worker and returns its context (a Lua state, in practice),
+// which gets passed to every Task that worker runs, and to the destroy callback when it shuts down.
+
+#define MAX_TASK_WORKERS 16
+
+typedef struct {
+  void* (*init)(void);
+  void (*run)(void* context, struct Task* task);
+  void (*destroy)(void* context);
+} TaskRunner;
+
+typedef struct Task {
+  uint32_t ref;
+  Blob* body;
+  uint64_t hash;
+  Variant arguments[MAX_THREAD_ARGUMENTS];
+  uint32_t argumentCount;
+  Variant results[MAX_THREAD_ARGUMENTS];
+  uint32_t resultCount;
+  char* error;
+  bool done;
+  struct Task* next;
+} Task;
+
 bool lovrThreadModuleInit(void);
 void lovrThreadModuleDestroy(void);
 struct Channel* lovrThreadGetChannel(const char* name);
@@ -36,3 +68,16 @@ void lovrThreadStart(Thread* thread, Variant* arguments, uint32_t argumentCount)
 void lovrThreadWait(Thread* thread);
 const char* lovrThreadGetError(Thread* thread);
 bool lovrThreadIsRunning(Thread* thread);
+uint64_t lovrThreadGetAffinity(Thread* thread);
+void lovrThreadSetAffinity(Thread* thread, uint64_t mask);
+os_thread_priority lovrThreadGetPriority(Thread* thread);
+void lovrThreadSetPriority(Thread* thread, os_thread_priority priority);
+
+bool lovrThreadStartWorkers(TaskRunner* runner, uint32_t count, uint64_t affinity, os_thread_priority priority);
+uint32_t lovrThreadGetTaskWorkerCount(void);
+Task* lovrTaskCreate(Blob* body, Variant* arguments, uint32_t argumentCount);
+void lovrTaskDestroy(void* ref);
+void lovrTaskSubmit(Task* task);
+bool lovrTaskWait(Task* task, double timeout);
+bool lovrTaskIsDone(Task* task);
+const char* lovrTaskGetError(Task* task);
@@ -1,5 +1,7 @@
 #include "timer/timer.h"
 #include "core/os.h"
+#include "core/profile.h"
+#include "core/util.h"
 #include <string.h>
 
 static struct {
@@ -33,7 +35,11 @@ double lovrTimerGetTime() {
   return os_get_time() - state.epoch;
 }
 
+// Stepping the timer starts a new frame, so it's also when the calling thread's temporary memory is
+// released and when the profiler marks a frame boundary
 double lovrTimerStep() {
+  lovrProfileMark("frame");
+  temp_reset();
   state.lastTime = state.time;
   state.time = os_get_time();
   state.dt = state.time - state.lastTime;
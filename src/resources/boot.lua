@@ -1,5 +1,7 @@
 lovr = require 'lovr'
 
+local mirror = { frame = 0, focused = true, options = { rate = 1, scale = 1, unfocused = true } }
+
 local function nogame()
   function lovr.conf(t)
     t.headset.supersample = true
@@ -101,6 +103,9 @@ function lovr.boot()
     version = '0.15.0',
     identity = 'default',
     saveprecedence = true,
+    bytecodecache = false,
+    gcbudget = 0,
+    ffi = false,
     modules = {
       audio = true,
       data = true,
@@ -115,30 +120,53 @@ function lovr.boot()
     },
     audio = {
       start = true,
-      spatializer = nil
+      spatializer = nil,
+      voices = 64,
+      threads = 0,
+      affinity = 0,
+      priority = 'normal'
     },
     graphics = {
-      debug = false
+      debug = false,
+      batches = 64
     },
     headset = {
       drivers = { 'openxr', 'oculus', 'vrapi', 'pico', 'openvr', 'webxr', 'desktop' },
       supersample = false,
       offset = 1.7,
       msaa = 4,
-      overlay = false
+      overlay = false,
+      pipelined = false
     },
     math = {
       globals = true
     },
+    thread = {
+      affinity = 0,
+      priority = 'normal'
+    },
+    telemetry = {
+      path = nil,
+      rate = 10,
+      capacity = 600
+    },
     window = {
       width = 1080,
       height = 600,
       fullscreen = false,
       resizable = false,
       msaa = 0,
+      headless = false,
       title = 'LÖVR',
       icon = nil,
-      vsync = 1
+      vsync = 1,
+      pacing = false,
+      mirror = {
+        rate = 1,
+        eye = nil,
+        scale = 1,
+        unfocused = true
+      }
     }
   }
 
@@ -151,16 +179,50 @@ function lovr.boot()
   if confOk and lovr.conf then confOk, confError = pcall(lovr.conf, conf) end
 
   lovr._setConf(conf)
+  mirror.options = conf.window.mirror or mirror.options
   lovr.filesystem.setIdentity(conf.identity, conf.saveprecedence)
 
+  lovr.filesystem.setBytecodeCacheEnabled(conf.bytecodecache)
+  lovr.setGarbageBudget(conf.gcbudget)
+
+  -- Modules that the run loop doesn't need are loaded the first time they're accessed
+  local lazy = { audio = true, data = true, physics = true, system = true, thread = true }
+  local pending = {}
+
   for module in pairs(conf.modules) do
     if conf.modules[module] then
+      if lazy[module] then
+        pending[module] = true
+      else
+        local ok, result = pcall(require, 'lovr.' .. module)
+        if not ok then
+          print(string.format('Warning: Could not load module %q: %s', module, result))
+        else
+          lovr[module] = result
+        end
+      end
+    end
+  end
+
+  setmetatable(lovr, {
+    __index = function(t, module)
+      if not pending[module] then return nil end
+      pending[module] = nil
       local ok, result = pcall(require, 'lovr.' .. module)
       if not ok then
         print(string.format('Warning: Could not load module %q: %s', module, result))
-      else
-        lovr[module] = result
+        return nil
       end
+      rawset(t, module, result)
+      return result
+    end
+  })
+
+  if conf.telemetry and conf.telemetry.path and lovr.system then
+    local options = conf.telemetry
+    local ok, result = pcall(lovr.system.startTelemetry, options.path, options.rate, options.capacity)
+    if not ok then
+      print(string.format('Warning: Could not start telemetry: %s', result))
     end
   end
 
@@ -172,12 +234,69 @@ function lovr.boot()
     end
   end
 
+  if conf.ffi and lovr._installFFI then
+    lovr._installFFI()
+  end
+
   lovr.handlers = setmetatable({}, { __index = lovr })
   if not confOk then error(confError) end
   if hasMain then require 'main' end
   return lovr.run()
 end
 
+-- Async jobs report their result on a Channel, and GPU readbacks are Readbacks.  Coroutines started
+-- with lovr.async can lovr.await either one, which parks the coroutine until the main loop sees that
+-- it's done.  Channels resume with the value that was pushed (a failed job pushes an error string),
+-- Readbacks resume with the Readback.  Awaiting nothing resumes on the next frame.
+local tasks = setmetatable({}, { __mode = 'k' })
+local waiting = {}
+
+local function resume(co, ...)
+  local ok, result = coroutine.resume(co, ...)
+  if not ok then
+    error(debug.traceback(co, result), 0)
+  elseif coroutine.status(co) == 'suspended' then
+    waiting[#waiting + 1] = { co = co, object = result }
+  end
+end
+
+local function updateTasks()
+  local pending = waiting
+  waiting = {}
+  for i = 1, #pending do
+    local task = pending[i]
+    local object = task.object
+    if object == nil then
+      resume(task.co)
+    elseif object.isReady then
+      if object:isReady() then resume(task.co, object) else waiting[#waiting + 1] = task end
+    elseif object:getCount() > 0 then
+      resume(task.co, object:pop())
+    else
+      waiting[#waiting + 1] = task
+    end
+  end
+end
+
+function lovr.async(fn, ...)
+  local co = coroutine.create(fn)
+  tasks[co] = true
+  resume(co, ...)
+  return co
+end
+
+-- Outside of lovr.async, Channels block and Readbacks can't be awaited
+function lovr.await(object)
+  local co = coroutine.running()
+  if co and tasks[co] then
+    return coroutine.yield(object)
+  elseif object and object.pop and not object.isReady then
+    return object:pop(true)
+  else
+    error('Only Channels can be awaited outside of lovr.async', 2)
+  end
+end
+
 function lovr.run()
   local dt = 0
   if lovr.timer then lovr.timer.step() end
@@ -186,6 +305,7 @@ function lovr.run()
     if lovr.event then
       lovr.event.pump()
       for name, a, b, c, d in lovr.event.poll() do
+        if name == 'focus' then mirror.focused = a end
         if name == 'restart' then
           local cookie = lovr.restart and lovr.restart()
           return 'restart', cookie
@@ -196,6 +316,7 @@ function lovr.run()
       end
     end
     if lovr.timer then dt = lovr.timer.step() end
+    if #waiting > 0 then updateTasks() end
     if lovr.headset then lovr.headset.update(dt) end
     if lovr.update then lovr.update(dt) end
     if lovr.graphics then
@@ -203,27 +324,61 @@ function lovr.run()
       if lovr.headset then
         lovr.headset.renderTo(lovr.draw)
       end
+      local swap = true
       if lovr.graphics.hasWindow() then
-        lovr.mirror()
+        swap = lovr.mirror() ~= false
       end
-      lovr.graphics.present()
+      -- Sampled before present, which resets the graphics counters for the next frame
+      if rawget(lovr, 'system') then lovr.system.updateTelemetry() end
+      lovr.graphics.present(swap)
+    elseif rawget(lovr, 'system') then
+      lovr.system.updateTelemetry()
     end
     if lovr.math then lovr.math.drain() end
+    lovr.collectGarbage()
   end
 end
 
+-- Returns false when the window was left alone this frame, so it isn't swapped
 function lovr.mirror()
   if lovr.headset then -- On some systems, headset module will be disabled
+    local texture = lovr.headset.getMirrorTexture()
+    if not texture then -- On some drivers, texture is printed directly to the window
+      return
+    end
+
+    local options = mirror.options
+    local width, height = lovr.graphics.getDimensions()
+    mirror.frame = mirror.frame + 1
+    if width == 0 or height == 0 or (not mirror.focused and options.unfocused == false) then
+      return false
+    elseif options.rate and options.rate > 1 and (mirror.frame - 1) % options.rate ~= 0 then
+      return false
+    end
+
+    local u, v, w, h = 0, 0, 1, 1
+    if options.eye == 'left' then
+      w = .5
+    elseif options.eye == 'right' then
+      u, w = .5, .5
+    end
+    if lovr.headset.getDriver() == 'oculus' then
+      v, h = 1, -1
+    end
+
     local blend, alpha = lovr.graphics.getBlendMode()
     lovr.graphics.setBlendMode()
-    local texture = lovr.headset.getMirrorTexture()
-    if texture then    -- On some drivers, texture is printed directly to the window
-      if lovr.headset.getDriver() == 'oculus' then
-        lovr.graphics.fill(texture, 0, 1, 1, -1)
-      else
-        lovr.graphics.fill(texture)
+    if options.scale and options.scale < 1 then
+      width = math.max(math.floor(width * options.scale), 1)
+      height = math.max(math.floor(height * options.scale), 1)
+      if not mirror.canvas or mirror.canvas:getWidth() ~= width or mirror.canvas:getHeight() ~= height then
+        mirror.canvas = lovr.graphics.newCanvas(width, height, { depth = false, stereo = false, mipmaps = false })
+        mirror.canvas:getTexture():setFilter('bilinear')
       end
+      mirror.canvas:renderTo(lovr.graphics.fill, texture, u, v, w, h)
+      texture, u, v, w, h = mirror.canvas:getTexture(), 0, 0, 1, 1
     end
+    lovr.graphics.fill(texture, u, v, w, h)
     lovr.graphics.setBlendMode(blend, alpha)
   else
     lovr.graphics.clear()
@@ -0,0 +1,142 @@
+-- FFI versions of hot functions, installed when t.ffi is set in lovr.conf and LuaJIT is used.
+-- LuaJIT can compile these into traces, unlike regular calls into C.  Each one handles the plain
+-- number case and falls back to the regular function for everything else (vectors, Materials...).
+local lovr = ...
+local ffi = require 'ffi'
+local C = ffi.C
+
+ffi.cdef [[
+  typedef struct { uint64_t hash; void* object; } lovr_proxy;
+
+  void lovr_ffi_graphics_push(void);
+  void lovr_ffi_graphics_pop(void);
+  void lovr_ffi_graphics_origin(void);
+  void lovr_ffi_graphics_translate(float x, float y, float z);
+  void lovr_ffi_graphics_rotate(float angle, float ax, float ay, float az);
+  void lovr_ffi_graphics_scale(float x, float y, float z);
+  void lovr_ffi_graphics_box(int style, float x, float y, float z, float sx, float sy, float sz, float angle, float ax, float ay, float az);
+  void lovr_ffi_graphics_sphere(float x, float y, float z, float radius, float angle, float ax, float ay, float az, int segments);
+
+  void lovr_ffi_collider_get_pose(void* collider, float* pose);
+  void lovr_ffi_collider_set_position(void* collider, float x, float y, float z);
+  void lovr_ffi_collider_set_orientation(void* collider, float angle, float ax, float ay, float az);
+  void lovr_ffi_collider_get_linear_velocity(void* collider, float* velocity);
+  void lovr_ffi_collider_set_linear_velocity(void* collider, float x, float y, float z);
+]]
+
+local number = 'number'
+local styles = { fill = 0, line = 1 }
+local out = ffi.new('float[7]')
+
+if lovr.graphics then
+  local g = lovr.graphics
+  local translate, rotate, scale = g.translate, g.rotate, g.scale
+  local cube, box, sphere = g.cube, g.box, g.sphere
+
+  g.push = function() C.lovr_ffi_graphics_push() end
+  g.pop = function() C.lovr_ffi_graphics_pop() end
+  g.origin = function() C.lovr_ffi_graphics_origin() end
+
+  g.translate = function(x, y, z)
+    if type(x) ~= number then return translate(x, y, z) end
+    C.lovr_ffi_graphics_translate(x, y or 0, z or 0)
+  end
+
+  g.rotate = function(angle, ax, ay, az)
+    if type(angle) ~= number then return rotate(angle, ax, ay, az) end
+    C.lovr_ffi_graphics_rotate(angle, ax or 0, ay or 1, az or 0)
+  end
+
+  g.scale = function(x, y, z)
+    if type(x) ~= number then return scale(x, y, z) end
+    C.lovr_ffi_graphics_scale(x, y or x, z or x)
+  end
+
+  g.cube = function(style, x, y, z, size, angle, ax, ay, az, ...)
+    local s = styles[style]
+    if not s or type(x) ~= number or select('#', ...) > 0 then return cube(style, x, y, z, size, angle, ax, ay, az, ...) end
+    size = size or 1
+    C.lovr_ffi_graphics_box(s, x, y or 0, z or 0, size, size, size, angle or 0, ax or 0, ay or 1, az or 0)
+  end
+
+  g.box = function(style, x, y, z, sx, sy, sz, angle, ax, ay, az, ...)
+    local s = styles[style]
+    if not s or type(x) ~= number or select('#', ...) > 0 then return box(style, x, y, z, sx, sy, sz, angle, ax, ay, az, ...) end
+    sx = sx or 1
+    C.lovr_ffi_graphics_box(s, x, y or 0, z or 0, sx, sy or sx, sz or sx, angle or 0, ax or 0, ay or 1, az or 0)
+  end
+
+  g.sphere = function(x, y, z, radius, angle, ax, ay, az, segments, ...)
+    if type(x) ~= number or select('#', ...) > 0 then return sphere(x, y, z, radius, angle, ax, ay, az, segments, ...) end
+    C.lovr_ffi_graphics_sphere(x, y or 0, z or 0, radius or 1, angle or 0, ax or 0, ay or 1, az or 0, segments or 30)
+  end
+end
+
+if lovr.physics then
+  local Collider = debug.getregistry().Collider
+  local getPosition, setPosition = Collider.getPosition, Collider.setPosition
+  local getOrientation, setOrientation = Collider.getOrientation, Collider.setOrientation
+  local getPose, setPose = Collider.getPose, Collider.setPose
+  local getLinearVelocity, setLinearVelocity = Collider.getLinearVelocity, Collider.setLinearVelocity
+
+  -- Returns the Collider pointer, or nil if the fast path can't be used
+  local function unwrap(self)
+    if getmetatable(self) ~= Collider then return nil end
+    local object = ffi.cast('lovr_proxy*', self).object
+    if object == nil then return nil end
+    return object
+  end
+
+  Collider.getPosition = function(self)
+    local c = unwrap(self)
+    if not c then return getPosition(self) end
+    C.lovr_ffi_collider_get_pose(c, out)
+    return out[0], out[1], out[2]
+  end
+
+  Collider.getOrientation = function(self)
+    local c = unwrap(self)
+    if not c then return getOrientation(self) end
+    C.lovr_ffi_collider_get_pose(c, out)
+    return out[3], out[4], out[5], out[6]
+  end
+
+  Collider.getPose = function(self)
+    local c = unwrap(self)
+    if not c then return getPose(self) end
+    C.lovr_ffi_collider_get_pose(c, out)
+    return out[0], out[1], out[2], out[3], out[4], out[5], out[6]
+  end
+
+  Collider.setPosition = function(self, x, y, z)
+    local c = unwrap(self)
+    if not c or type(x) ~= number then return setPosition(self, x, y, z) end
+    C.lovr_ffi_collider_set_position(c, x, y or 0, z or 0)
+  end
+
+  Collider.setOrientation = function(self, angle, ax, ay, az)
+    local c = unwrap(self)
+    if not c or type(angle) ~= number then return setOrientation(self, angle, ax, ay, az) end
+    C.lovr_ffi_collider_set_orientation(c, angle, ax or 0, ay or 1, az or 0)
+  end
+
+  Collider.setPose = function(self, x, y, z, angle, ax, ay, az)
+    local c = unwrap(self)
+    if not c or type(x) ~= number or type(angle) ~= number then return setPose(self, x, y, z, angle, ax, ay, az) end
+    C.lovr_ffi_collider_set_position(c, x, y or 0, z or 0)
+    C.lovr_ffi_collider_set_orientation(c, angle, ax or 0, ay or 1, az or 0)
+  end
+
+  Collider.getLinearVelocity = function(self)
+    local c = unwrap(self)
+    if not c then return getLinearVelocity(self) end
+    C.lovr_ffi_collider_get_linear_velocity(c, out)
+    return out[0], out[1], out[2]
+  end
+
+  Collider.setLinearVelocity = function(self, x, y, z)
+    local c = unwrap(self)
+    if not c or type(x) ~= number then return setLinearVelocity(self, x, y, z) end
+    C.lovr_ffi_collider_set_linear_velocity(c, x, y or 0, z or 0)
+  end
+end
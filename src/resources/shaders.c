@@ -2,7 +2,7 @@
 
 const char* lovrShaderVertexPrefix = ""
 "#define VERTEX VERTEX \n"
-"#define MAX_BONES 48 \n"
+"#define MAX_BONES 256 \n"
 "#define MAX_DRAWS 256 \n"
 "#define lovrView lovrViews[lovrViewID] \n"
 "#define lovrProjection lovrProjections[lovrViewID] \n"
@@ -13,11 +13,12 @@ const char* lovrShaderVertexPrefix = ""
 "#else \n"
 "#define lovrNormalMatrix mat3(transpose(inverse(lovrModel))) \n"
 "#endif \n"
+"#define lovrPoseOffset (int(lovrDrawID) * lovrPoseStride) \n"
 "#define lovrPoseMatrix ("
-  "lovrPose[lovrBones[0]] * lovrBoneWeights[0] +"
-  "lovrPose[lovrBones[1]] * lovrBoneWeights[1] +"
-  "lovrPose[lovrBones[2]] * lovrBoneWeights[2] +"
-  "lovrPose[lovrBones[3]] * lovrBoneWeights[3]"
+  "lovrPoses[lovrPoseOffset + int(lovrBones[0])] * lovrBoneWeights[0] +"
+  "lovrPoses[lovrPoseOffset + int(lovrBones[1])] * lovrBoneWeights[1] +"
+  "lovrPoses[lovrPoseOffset + int(lovrBones[2])] * lovrBoneWeights[2] +"
+  "lovrPoses[lovrPoseOffset + int(lovrBones[3])] * lovrBoneWeights[3]"
   ") \n"
 "#ifdef FLAG_animated \n"
 "#define lovrVertex (lovrPoseMatrix * vec4(lovrPosition, 1.)) \n"
@@ -37,12 +38,14 @@ const char* lovrShaderVertexPrefix = ""
 "out vec2 texCoord; \n"
 "out vec4 vertexColor; \n"
 "out vec4 lovrGraphicsColor; \n"
+"flat out uint lovrMaterialIndex; \n"
 "layout(std140) uniform lovrModelBlock { mat4 lovrModels[MAX_DRAWS]; }; \n"
 "layout(std140) uniform lovrColorBlock { vec4 lovrColors[MAX_DRAWS]; }; \n"
-"layout(std140) uniform lovrFrameBlock { mat4 lovrViews[2]; mat4 lovrProjections[2]; }; \n"
+"layout(std140) uniform lovrFrameBlock { mat4 lovrViews[2]; mat4 lovrProjections[2]; mat4 lovrMotionTransforms[2]; }; \n"
+"layout(std140) uniform lovrPoseBlock { mat4 lovrPoses[MAX_BONES]; }; \n"
 "uniform mat3 lovrMaterialTransform; \n"
 "uniform float lovrPointSize; \n"
-"uniform mat4 lovrPose[MAX_BONES]; \n"
+"uniform int lovrPoseStride; \n"
 "uniform lowp int lovrViewportCount; \n"
 "#if defined MULTIVIEW \n"
 "layout(num_views = 2) in; \n"
@@ -58,19 +61,30 @@ const char* lovrShaderVertexPrefix = ""
 "#line 0 \n";
 
 const char* lovrShaderVertexSuffix = ""
+"#ifdef MULTIVIEW \n"
+"out vec4 motionCurrent; \n"
+"out vec4 motionPrevious; \n"
+"#endif \n"
+"invariant gl_Position; \n" // The depth prepass needs depth-only variants to match exactly
 "void main() { \n"
 "  texCoord = (lovrMaterialTransform * vec3(lovrTexCoord, 1.)).xy; \n"
 "  vertexColor = lovrVertexColor; \n"
 "  lovrGraphicsColor = lovrColors[lovrDrawID]; \n"
+"  lovrMaterialIndex = lovrDrawID; \n"
 "#if defined INSTANCED_STEREO \n"
 "  gl_ViewportIndex = gl_InstanceID % lovrViewportCount; \n"
 "#endif \n"
 "  gl_PointSize = lovrPointSize; \n"
 "  gl_Position = position(lovrProjection, lovrTransform, lovrVertex); \n"
+"#ifdef MULTIVIEW \n"
+"  motionCurrent = gl_Position; \n"
+"  motionPrevious = lovrMotionTransforms[lovrViewID] * gl_Position; \n"
+"#endif \n"
 "}";
 
 const char* lovrShaderFragmentPrefix = ""
 "#define PIXEL PIXEL \n"
+"#define MAX_DRAWS 256 \n"
 "#define FRAGMENT FRAGMENT \n"
 "#define lovrTexCoord texCoord \n"
 "#define lovrVertexColor vertexColor \n"
@@ -84,12 +98,14 @@ const char* lovrShaderFragmentPrefix = ""
 "in vec2 texCoord; \n"
 "in vec4 vertexColor; \n"
 "in vec4 lovrGraphicsColor; \n"
+"flat in uint lovrMaterialIndex; \n"
 "out vec4 lovrCanvas[gl_MaxDrawBuffers]; \n"
-"uniform float lovrMetalness; \n"
-"uniform float lovrRoughness; \n"
-"uniform float lovrAlphaCutoff; \n"
-"uniform vec4 lovrDiffuseColor; \n"
-"uniform vec4 lovrEmissiveColor; \n"
+"layout(std140) uniform lovrMaterialBlock { vec4 lovrMaterials[MAX_DRAWS * 3]; }; \n"
+"#define lovrDiffuseColor lovrMaterials[3 * int(lovrMaterialIndex) + 0] \n"
+"#define lovrEmissiveColor lovrMaterials[3 * int(lovrMaterialIndex) + 1] \n"
+"#define lovrMetalness lovrMaterials[3 * int(lovrMaterialIndex) + 2].x \n"
+"#define lovrRoughness lovrMaterials[3 * int(lovrMaterialIndex) + 2].y \n"
+"#define lovrAlphaCutoff lovrMaterials[3 * int(lovrMaterialIndex) + 2].z \n"
 "uniform sampler2D lovrDiffuseTexture; \n"
 "uniform sampler2D lovrEmissiveTexture; \n"
 "uniform sampler2D lovrMetalnessTexture; \n"
@@ -119,6 +135,10 @@ const char* lovrShaderFragmentPrefix = ""
 "#line 0 \n";
 
 const char* lovrShaderFragmentSuffix = ""
+"#ifdef MULTIVIEW \n"
+"in vec4 motionCurrent; \n"
+"in vec4 motionPrevious; \n"
+"#endif \n"
 "void main() { \n"
 "#if defined(MULTICANVAS) || defined(FLAG_multicanvas) \n"
 "  colors(lovrGraphicsColor, lovrDiffuseTexture, texCoord); \n"
@@ -132,6 +152,9 @@ const char* lovrShaderFragmentSuffix = ""
 #if defined(LOVR_WEBGL) || defined(LOVR_USE_PICO)
 "  lovrCanvas[0].rgb = pow(lovrCanvas[0].rgb, vec3(.4545)); \n"
 #endif
+"#ifdef MULTIVIEW \n"
+"  lovrCanvas[1] = vec4(motionCurrent.xyz / motionCurrent.w - motionPrevious.xyz / motionPrevious.w, 0.); \n"
+"#endif \n"
 "#endif \n"
 "}";
 
@@ -163,6 +186,20 @@ const char* lovrUnlitFragmentShader = ""
 "  return lovrGraphicsColor * lovrVertexColor * lovrDiffuseColor * texture(lovrDiffuseTexture, lovrTexCoord); \n"
 "}";
 
+// Used for depth-only variants of shaders.  Only alpha cutoff needs the color.
+const char* lovrDepthFragmentShader = ""
+"#if defined(FLAG_multicanvas) \n"
+"void colors(vec4 graphicsColor, sampler2D image, vec2 uv) {} \n"
+"#else \n"
+"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"#ifdef FLAG_alphaCutoff \n"
+"  return lovrGraphicsColor * lovrVertexColor * lovrDiffuseColor * texture(lovrDiffuseTexture, lovrTexCoord); \n"
+"#else \n"
+"  return vec4(1.); \n"
+"#endif \n"
+"} \n"
+"#endif \n";
+
 const char* lovrStandardVertexShader = ""
 "out vec3 vVertexPositionWorld; \n"
 "out vec3 vCameraPositionWorld; \n"
@@ -208,6 +245,24 @@ const char* lovrStandardFragmentShader = ""
 "uniform vec3 lovrSphericalHarmonics[9]; \n"
 "uniform float lovrExposure; \n"
 
+"#ifdef FLAG_pointLights \n"
+"#define MAX_LIGHTS 128 \n"
+"#define LIGHT_GRID_X 8 \n"
+"#define LIGHT_GRID_Y 8 \n"
+"#define LIGHT_GRID_Z 16 \n"
+"#define LIGHT_CLUSTERS (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z) \n"
+"#define MAX_LIGHT_INDICES 4096 \n"
+"layout(std140) uniform lovrLightBlock { \n"
+"  highp mat4 lovrLightView; \n"
+"  highp vec4 lovrLightGrid; \n"
+"  highp vec4 lovrLightDepth; \n"
+"  highp vec4 lovrLights[2 * MAX_LIGHTS]; \n"
+"  highp uvec4 lovrLightClusters[LIGHT_CLUSTERS / 4]; \n"
+"  highp uvec4 lovrLightIndices[MAX_LIGHT_INDICES / 16]; \n"
+"}; \n"
+"vec3 pointLights(vec3 P, vec3 N, vec3 V, float NoV, vec3 baseColor, vec3 F0, float metalness, float roughness); \n"
+"#endif \n"
+
 "float D_GGX(float NoH, float roughness); \n"
 "float G_SmithGGXCorrelated(float NoV, float NoL, float roughness); \n"
 "vec3 F_Schlick(vec3 F0, float VoH); \n"
@@ -244,6 +299,9 @@ const char* lovrStandardFragmentShader = ""
 "  vec3 specularDirect = vec3(D * G * F); \n"
 "  vec3 diffuseDirect = (vec3(1.) - F) * (1. - metalness) * baseColor; \n"
 "  result += (diffuseDirect / PI + specularDirect) * NoL * lovrLightColor.rgb * lovrLightColor.a; \n"
+"#ifdef FLAG_pointLights \n"
+"  result += pointLights(vVertexPositionWorld, N, V, NoV, baseColor, F0, metalness, roughness); \n"
+"#endif \n"
 
 // Indirect lighting
 "#ifdef FLAG_indirectLighting \n"
@@ -271,6 +329,40 @@ const char* lovrStandardFragmentShader = ""
 "}"
 
 // Helpers
+"#ifdef FLAG_pointLights \n" // Only shades the lights in the pixel's cluster, see lovrGraphicsUpdateLights
+"vec3 pointLights(vec3 P, vec3 N, vec3 V, float NoV, vec3 baseColor, vec3 F0, float metalness, float roughness) { \n"
+"  vec3 result = vec3(0.); \n"
+"  highp vec3 p = (lovrLightView * vec4(P, 1.)).xyz; \n"
+"  highp float depth = max(-p.z, lovrLightDepth.x); \n"
+"  highp vec2 tangent = (p.xy / depth - lovrLightGrid.xy) * lovrLightGrid.zw; \n"
+"  ivec3 cell = ivec3(floor(vec3(tangent, log(depth / lovrLightDepth.x) * lovrLightDepth.y))); \n"
+"  cell = clamp(cell, ivec3(0), ivec3(LIGHT_GRID_X - 1, LIGHT_GRID_Y - 1, LIGHT_GRID_Z - 1)); \n"
+"  int cluster = (cell.z * LIGHT_GRID_Y + cell.y) * LIGHT_GRID_X + cell.x; \n"
+"  highp uint entry = lovrLightClusters[cluster / 4][cluster % 4]; \n"
+"  int offset = int(entry >> 16u); \n"
+"  int count = int(entry & 0xffffu); \n"
+"  for (int i = offset; i < offset + count; i++) { \n"
+"    int index = int((lovrLightIndices[i / 16][(i / 4) % 4] >> uint(8 * (i % 4))) & 0xffu); \n"
+"    vec4 light = lovrLights[2 * index]; \n"
+"    vec3 color = lovrLights[2 * index + 1].rgb; \n"
+"    vec3 toLight = light.xyz - P; \n"
+"    float distance = length(toLight); \n"
+"    float window = clamp(1. - pow(distance / light.w, 4.), 0., 1.); \n"
+"    float attenuation = window * window / (distance * distance + 1.); \n"
+"    vec3 L = toLight / max(distance, EPS); \n"
+"    vec3 H = normalize(V + L); \n"
+"    float NoL = clamp(dot(N, L), 0., 1.); \n"
+"    float NoH = clamp(dot(N, H), 0., 1.); \n"
+"    float VoH = clamp(dot(V, H), 0., 1.); \n"
+"    vec3 F = F_Schlick(F0, VoH); \n"
+"    vec3 specular = D_GGX(NoH, roughness) * G_SmithGGXCorrelated(NoV, NoL, roughness) * F; \n"
+"    vec3 diffuse = (vec3(1.) - F) * (1. - metalness) * baseColor; \n"
+"    result += (diffuse / PI + specular) * NoL * color * attenuation; \n"
+"  } \n"
+"  return result; \n"
+"} \n"
+"#endif \n"
+
 "float D_GGX(float NoH, float roughness) { \n"
 "  float alpha = roughness * roughness; \n"
 "  float alpha2 = alpha * alpha; \n"
@@ -366,11 +458,326 @@ const char* lovrFontFragmentShader = ""
 "  return vec4(lovrGraphicsColor.rgb, lovrGraphicsColor.a * alpha); \n"
 "}";
 
+// Virtual textures look up the page for a tile in the mipmap of the page table for the mipmap level
+// they want.  Entries are the page's position in the atlas and the level of the tile that's in it,
+// which is coarser than the requested level when the tile isn't resident yet.
+#define VIRTUAL_TEXTURE_HEADER \
+"uniform sampler2D lovrPageTable; \n" \
+"uniform sampler2D lovrPageAtlas; \n" \
+"uniform vec4 lovrVirtualSize; \n" \
+"uniform vec4 lovrVirtualPages; \n" \
+"float lovrVirtualLevel(vec2 uv) { \n" \
+"  vec2 texel = uv * lovrVirtualSize.xy; \n" \
+"  vec2 dx = dFdx(texel), dy = dFdy(texel); \n" \
+"  float lod = .5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + lovrVirtualSize.w; \n" \
+"  return clamp(floor(lod), 0., lovrVirtualSize.z - 1.); \n" \
+"} \n"
+
+const char* lovrVirtualFragmentShader = ""
+VIRTUAL_TEXTURE_HEADER
+"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"  int level = int(lovrVirtualLevel(uv)); \n"
+"  vec2 wrapped = fract(uv); \n"
+"  ivec2 tableSize = textureSize(lovrPageTable, level); \n"
+"  vec4 entry = texelFetch(lovrPageTable, ivec2(wrapped * vec2(tableSize)), level) * 255.; \n"
+"  vec2 tiles = lovrVirtualSize.xy / (lovrVirtualPages.x * exp2(entry.b)); \n"
+"  vec2 inTile = fract(wrapped * tiles); \n"
+"  float pageSize = lovrVirtualPages.x + 2. * lovrVirtualPages.y; \n"
+"  vec2 atlasUv = (floor(entry.rg + .5) * pageSize + lovrVirtualPages.y + inTile * lovrVirtualPages.x) / (lovrVirtualPages.z * pageSize); \n"
+"  return graphicsColor * textureLod(lovrPageAtlas, atlasUv, 0.); \n"
+"}";
+
+// Writes the tile each pixel wants: x and y in the red and green channels, with their high bits in
+// blue, and the level plus one in alpha (zero means no tile)
+const char* lovrFeedbackFragmentShader = ""
+VIRTUAL_TEXTURE_HEADER
+"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"  float level = lovrVirtualLevel(uv); \n"
+"  vec2 tiles = max(floor(lovrVirtualSize.xy / (lovrVirtualPages.x * exp2(level))), 1.); \n"
+"  vec2 tile = min(floor(fract(uv) * tiles), tiles - 1.); \n"
+"  vec2 high = floor(tile / 256.); \n"
+"  return vec4(tile - high * 256., high.x + 16. * high.y, level + 1.) / 255.; \n"
+"}";
+
+// Post effects that only look at one pixel are all in one shader, and the ones that aren't enabled
+// are left out with flags.  Bloom is added before tonemapping, grading works on the tonemapped color.
+const char* lovrPostFragmentShader = ""
+"#ifdef FLAG_bloom \n"
+"uniform sampler2D lovrBloomTexture; \n"
+"uniform float lovrBloomIntensity; \n"
+"#endif \n"
+"#ifdef FLAG_tonemap \n"
+"uniform float lovrExposure; \n"
+"#endif \n"
+"#ifdef FLAG_grade \n"
+"uniform vec3 lovrGrade; \n"
+"uniform vec3 lovrTint; \n"
+"#endif \n"
+"#ifdef FLAG_vignette \n"
+"uniform vec3 lovrVignette; \n"
+"#endif \n"
+"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"  vec4 pixel = texture(image, uv); \n"
+"  vec3 c = pixel.rgb; \n"
+"#ifdef FLAG_bloom \n"
+"  c += texture(lovrBloomTexture, uv).rgb * lovrBloomIntensity; \n"
+"#endif \n"
+"#ifdef FLAG_tonemap \n"
+"  c *= lovrExposure; \n"
+"  c = clamp((c * (2.51 * c + .03)) / (c * (2.43 * c + .59) + .14), 0., 1.); \n"
+"#endif \n"
+"#ifdef FLAG_grade \n"
+"  c = (c - .5) * lovrGrade.x + .5 + lovrGrade.z; \n"
+"  c = max(mix(vec3(dot(c, vec3(.2126, .7152, .0722))), c, lovrGrade.y) * lovrTint, 0.); \n"
+"#endif \n"
+"#ifdef FLAG_vignette \n"
+"  float d = length(uv - .5) * 1.41421356; \n"
+"  c *= 1. - lovrVignette.x * smoothstep(lovrVignette.y, lovrVignette.y + lovrVignette.z, d); \n"
+"#endif \n"
+"  return vec4(c, pixel.a); \n"
+"}";
+
+// Each bloom level is half the size of the one above it.  Downsampling averages the 2x2 texel block
+// under the pixel and the 4 blocks around it with bilinear taps, which keeps small highlights from
+// flickering.  The first level also keeps only the light above the threshold, with a soft knee.
+#define BLOOM_DOWNSAMPLE \
+"vec3 lovrBloomDownsample(sampler2D source, vec2 uv, vec2 threshold) { \n" \
+"  vec2 t = 1. / vec2(textureSize(source, 0)); \n" \
+"  vec3 c = textureLod(source, uv, 0.).rgb * 4.; \n" \
+"  c += textureLod(source, uv - t, 0.).rgb; \n" \
+"  c += textureLod(source, uv + t, 0.).rgb; \n" \
+"  c += textureLod(source, uv + vec2(t.x, -t.y), 0.).rgb; \n" \
+"  c += textureLod(source, uv - vec2(t.x, -t.y), 0.).rgb; \n" \
+"  c /= 8.; \n" \
+"  if (threshold.x > 0.) { \n" \
+"    float brightness = max(c.r, max(c.g, c.b)); \n" \
+"    float soft = clamp(brightness - threshold.x + threshold.y, 0., 2. * threshold.y); \n" \
+"    soft = soft * soft / (4. * threshold.y + .00001); \n" \
+"    c *= max(soft, brightness - threshold.x) / max(brightness, .00001); \n" \
+"  } \n" \
+"  return c; \n" \
+"} \n"
+
+const char* lovrBloomDownsampleFragmentShader = ""
+"uniform vec4 lovrBloomParams; \n"
+BLOOM_DOWNSAMPLE
+"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"  return vec4(lovrBloomDownsample(image, uv, lovrBloomParams.xy), 1.); \n"
+"}";
+
+// Upsampling blurs the smaller level with a 3x3 tent filter, and is added to the next larger level
+const char* lovrBloomUpsampleFragmentShader = ""
+"vec4 color(vec4 graphicsColor, sampler2D image, vec2 uv) { \n"
+"  vec2 t = 1. / vec2(textureSize(image, 0)); \n"
+"  vec3 c = texture(image, uv).rgb * 4.; \n"
+"  c += texture(image, uv + vec2(t.x, 0.)).rgb * 2.; \n"
+"  c += texture(image, uv - vec2(t.x, 0.)).rgb * 2.; \n"
+"  c += texture(image, uv + vec2(0., t.y)).rgb * 2.; \n"
+"  c += texture(image, uv - vec2(0., t.y)).rgb * 2.; \n"
+"  c += texture(image, uv + t).rgb; \n"
+"  c += texture(image, uv - t).rgb; \n"
+"  c += texture(image, uv + vec2(t.x, -t.y)).rgb; \n"
+"  c += texture(image, uv - vec2(t.x, -t.y)).rgb; \n"
+"  return vec4(c / 16., 1.); \n"
+"}";
+
 const char* lovrFillVertexShader = ""
 "vec4 position(mat4 projection, mat4 transform, vec4 vertex) { \n"
 "  return lovrVertex; \n"
 "}";
 
+// Vertices have the index of their view in z, and the ones for the other view are clipped
+const char* lovrMaskVertexShader = ""
+"vec4 position(mat4 projection, mat4 transform, vec4 vertex) { \n"
+"  if (int(vertex.z) != int(lovrViewID)) return vec4(0., 0., 2., 1.); \n"
+"  return vec4(vertex.xy, -1., 1.); \n"
+"}";
+
+// Each instance is a segment (or a point, when both ends are the same vertex) that gets expanded
+// into a screen space quad with square caps.  Segments that would join two different draws are
+// collapsed, since their endpoints are just neighbors in the vertex stream.
+const char* lovrLineVertexShader = ""
+"in vec3 lovrLineEnd; \n"
+"in vec2 lovrLineCorner; \n"
+"in uint lovrLineEndID; \n"
+"uniform float lovrLineWidth; \n"
+"uniform vec2 lovrViewportSize; \n"
+"vec4 position(mat4 projection, mat4 transform, vec4 vertex) { \n"
+"  if (lovrLineEndID != lovrDrawID) return vec4(0., 0., 2., 1.); \n"
+"  vec4 a = projection * transform * vertex; \n"
+"  vec4 b = projection * transform * vec4(lovrLineEnd, 1.); \n"
+"  vec2 halfSize = .5 * lovrViewportSize; \n"
+"  vec2 direction = (b.xy / b.w - a.xy / a.w) * halfSize; \n"
+"  float len = length(direction); \n"
+"  direction = len > 1e-5 ? direction / len : vec2(1., 0.); \n"
+"  vec2 normal = vec2(-direction.y, direction.x); \n"
+"  vec4 p = lovrLineCorner.x > .5 ? b : a; \n"
+"  vec2 offset = (direction * (2. * lovrLineCorner.x - 1.) + normal * lovrLineCorner.y) * .5 * lovrLineWidth; \n"
+"  p.xy += offset / halfSize * p.w; \n"
+"  return p; \n"
+"}";
+
+// Each instance is a particle, expanded into a quad facing the camera.  The quad's corners come
+// from the texture coordinates, so the size is in view space units.
+const char* lovrParticleVertexShader = ""
+"in vec4 lovrParticle; \n"
+"vec4 position(mat4 projection, mat4 transform, vec4 vertex) { \n"
+"  vec4 center = transform * vec4(lovrParticle.xyz, 1.); \n"
+"  center.xy += (lovrTexCoord - .5) * lovrParticle.w; \n"
+"  return projection * center; \n"
+"}";
+
+const char* lovrSkinningComputeShader = ""
+"layout(local_size_x = 64) in; \n"
+"struct SkinVertex { vec4 position; vec4 normal; uvec4 joints; vec4 weights; }; \n"
+"struct SkinnedVertex { vec4 position; vec4 normal; }; \n"
+"layout(std430) readonly buffer lovrSkinVertices { SkinVertex vertices[]; }; \n"
+"layout(std430) readonly buffer lovrSkinPose { mat4 joints[]; }; \n"
+"layout(std430) writeonly buffer lovrSkinnedVertices { SkinnedVertex skinned[]; }; \n"
+"void compute() { \n"
+"  uint i = gl_GlobalInvocationID.x; \n"
+"  if (i >= uint(vertices.length())) return; \n"
+"  SkinVertex v = vertices[i]; \n"
+"  mat4 m = ("
+    "joints[v.joints[0]] * v.weights[0] +"
+    "joints[v.joints[1]] * v.weights[1] +"
+    "joints[v.joints[2]] * v.weights[2] +"
+    "joints[v.joints[3]] * v.weights[3]"
+    "); \n"
+"  skinned[i].position = m * vec4(v.position.xyz, 1.); \n"
+"  skinned[i].normal = vec4(mat3(m) * v.normal.xyz, 0.); \n"
+"}";
+
+// Stage 0 resets the draw command.  Stage 1 spawns particles in the slots the CPU handed out this
+// update, integrates the rest, and appends every live particle to the instance buffer, counting the
+// instances in the draw command.  Particles are dead once their age reaches their lifetime.
+const char* lovrParticleComputeShader = ""
+"layout(local_size_x = 64) in; \n"
+"struct Particle { vec4 position; vec4 velocity; }; \n"
+"struct Instance { vec4 position; vec4 color; }; \n"
+"layout(std430) buffer lovrParticles { Particle particles[]; }; \n"
+"layout(std430) writeonly buffer lovrParticleInstances { Instance instances[]; }; \n"
+"layout(std430) buffer lovrParticleCommand { uint vertexCount; uint instanceCount; uint firstVertex; uint baseInstance; }; \n"
+"uniform int lovrParticleStage; \n"
+"uniform ivec3 lovrParticleEmit; \n"
+"uniform float lovrParticleDelta; \n"
+"uniform vec4 lovrParticleEmitter; \n"
+"uniform vec4 lovrParticleDirection; \n"
+"uniform vec4 lovrParticleRanges; \n"
+"uniform vec4 lovrParticleAcceleration; \n"
+"uniform vec2 lovrParticleSizes; \n"
+"uniform vec4 lovrParticleColors[2]; \n"
+"uint hash(uint x) { \n"
+"  uint state = x * 747796405u + 2891336453u; \n"
+"  uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u; \n"
+"  return (word >> 22u) ^ word; \n"
+"} \n"
+"float random(inout uint seed) { \n"
+"  seed = hash(seed); \n"
+"  return float(seed) / 4294967295.; \n"
+"} \n"
+"vec3 randomDirection(inout uint seed) { \n"
+"  float z = 2. * random(seed) - 1.; \n"
+"  float phi = 6.2831853 * random(seed); \n"
+"  float r = sqrt(max(1. - z * z, 0.)); \n"
+"  return vec3(r * cos(phi), r * sin(phi), z); \n"
+"} \n"
+"void spawn(uint i, uint offset, uint count) { \n"
+"  uint seed = hash(i ^ uint(lovrParticleEmit.z)); \n"
+"  vec3 position = lovrParticleEmitter.xyz + randomDirection(seed) * lovrParticleEmitter.w * pow(random(seed), 1. / 3.); \n"
+"  vec3 axis = lovrParticleDirection.xyz; \n"
+"  vec3 tangent = normalize(cross(axis, abs(axis.y) < .99 ? vec3(0., 1., 0.) : vec3(1., 0., 0.))); \n"
+"  vec3 bitangent = cross(axis, tangent); \n"
+"  float cosTheta = mix(1., cos(lovrParticleDirection.w), random(seed)); \n"
+"  float sinTheta = sqrt(max(1. - cosTheta * cosTheta, 0.)); \n"
+"  float phi = 6.2831853 * random(seed); \n"
+"  vec3 direction = (tangent * cos(phi) + bitangent * sin(phi)) * sinTheta + axis * cosTheta; \n"
+"  vec3 velocity = direction * mix(lovrParticleRanges.x, lovrParticleRanges.y, random(seed)); \n"
+"  float lifetime = mix(lovrParticleRanges.z, lovrParticleRanges.w, random(seed)); \n"
+"  float age = lovrParticleDelta * (float(count - offset) - .5) / float(count); \n"
+"  particles[i] = Particle(vec4(position + velocity * age, age), vec4(velocity, lifetime)); \n"
+"} \n"
+"void compute() { \n"
+"  uint i = gl_GlobalInvocationID.x; \n"
+"  if (lovrParticleStage == 0) { \n"
+"    if (i == 0u) { \n"
+"      vertexCount = 4u; \n"
+"      instanceCount = 0u; \n"
+"      firstVertex = 0u; \n"
+"      baseInstance = 0u; \n"
+"    } \n"
+"    return; \n"
+"  } \n"
+"  uint capacity = uint(particles.length()); \n"
+"  if (i >= capacity) return; \n"
+"  uint offset = (i + capacity - uint(lovrParticleEmit.x)) % capacity; \n"
+"  if (offset < uint(lovrParticleEmit.y)) { \n"
+"    spawn(i, offset, uint(lovrParticleEmit.y)); \n"
+"  } else if (particles[i].position.w < particles[i].velocity.w) { \n"
+"    float dt = lovrParticleDelta; \n"
+"    vec3 velocity = particles[i].velocity.xyz + lovrParticleAcceleration.xyz * dt; \n"
+"    velocity *= max(1. - lovrParticleAcceleration.w * dt, 0.); \n"
+"    particles[i].position += vec4(velocity * dt, dt); \n"
+"    particles[i].velocity.xyz = velocity; \n"
+"  } \n"
+"  Particle p = particles[i]; \n"
+"  if (p.position.w >= p.velocity.w) return; \n"
+"  float t = p.position.w / p.velocity.w; \n"
+"  uint index = atomicAdd(instanceCount, 1u); \n"
+"  instances[index] = Instance(vec4(p.position.xyz, mix(lovrParticleSizes.x, lovrParticleSizes.y, t)), mix(lovrParticleColors[0], lovrParticleColors[1], t)); \n"
+"}";
+
+// Sorts instances back to front with a bitonic sort over a power of two list of keys.  Stage 0
+// builds the keys (padding sorts last), stage 1 is one compare and swap step of the sort, and
+// stage 2 gathers the instances into sorted order.
+const char* lovrParticleSortComputeShader = ""
+"layout(local_size_x = 64) in; \n"
+"struct Instance { vec4 position; vec4 color; }; \n"
+"struct Key { float distance; uint index; }; \n"
+"layout(std430) readonly buffer lovrParticleCommand { uint vertexCount; uint instanceCount; uint firstVertex; uint baseInstance; }; \n"
+"layout(std430) readonly buffer lovrParticleUnsorted { Instance unsorted[]; }; \n"
+"layout(std430) writeonly buffer lovrParticleInstances { Instance instances[]; }; \n"
+"layout(std430) buffer lovrParticleKeys { Key keys[]; }; \n"
+"uniform int lovrParticleStage; \n"
+"uniform ivec2 lovrParticleSortStep; \n"
+"uniform vec3 lovrParticleCamera; \n"
+"void compute() { \n"
+"  uint i = gl_GlobalInvocationID.x; \n"
+"  if (i >= uint(keys.length())) return; \n"
+"  if (lovrParticleStage == 0) { \n"
+"    vec3 d = i < instanceCount ? unsorted[i].position.xyz - lovrParticleCamera : vec3(0.); \n"
+"    keys[i] = Key(i < instanceCount ? -dot(d, d) : 3.402823e38, i); \n"
+"  } else if (lovrParticleStage == 1) { \n"
+"    uint k = uint(lovrParticleSortStep.x); \n"
+"    uint l = i ^ uint(lovrParticleSortStep.y); \n"
+"    if (l <= i) return; \n"
+"    Key a = keys[i]; \n"
+"    Key b = keys[l]; \n"
+"    if ((a.distance > b.distance) == ((i & k) == 0u)) { \n"
+"      keys[i] = b; \n"
+"      keys[l] = a; \n"
+"    } \n"
+"  } else if (i < instanceCount) { \n"
+"    instances[i] = unsorted[keys[i].index]; \n"
+"  } \n"
+"}";
+
+// Same as the fragment version, writing straight to the level without a render pass.  Params has
+// the threshold and knee, then the size of the level.
+const char* lovrBloomDownsampleComputeShader = ""
+"layout(local_size_x = 8, local_size_y = 8) in; \n"
+"precision highp sampler2D; \n"
+"uniform sampler2D lovrBloomSource; \n"
+"uniform vec4 lovrBloomParams; \n"
+"layout(rgba16f) uniform writeonly highp image2D lovrBloomTarget; \n"
+BLOOM_DOWNSAMPLE
+"void compute() { \n"
+"  ivec2 p = ivec2(gl_GlobalInvocationID.xy); \n"
+"  if (p.x >= int(lovrBloomParams.z) || p.y >= int(lovrBloomParams.w)) return; \n"
+"  vec2 uv = (vec2(p) + .5) / lovrBloomParams.zw; \n"
+"  imageStore(lovrBloomTarget, p, vec4(lovrBloomDownsample(lovrBloomSource, uv, lovrBloomParams.xy), 1.)); \n"
+"}";
+
 const char* lovrShaderScalarUniforms[] = {
   "lovrMetalness",
   "lovrRoughness",
@@ -8,13 +8,26 @@ extern const char* lovrShaderComputePrefix;
 extern const char* lovrShaderComputeSuffix;
 extern const char* lovrUnlitVertexShader;
 extern const char* lovrUnlitFragmentShader;
+extern const char* lovrDepthFragmentShader;
 extern const char* lovrStandardVertexShader;
 extern const char* lovrStandardFragmentShader;
 extern const char* lovrCubeVertexShader;
 extern const char* lovrCubeFragmentShader;
 extern const char* lovrPanoFragmentShader;
 extern const char* lovrFontFragmentShader;
+extern const char* lovrVirtualFragmentShader;
+extern const char* lovrFeedbackFragmentShader;
+extern const char* lovrPostFragmentShader;
+extern const char* lovrBloomDownsampleFragmentShader;
+extern const char* lovrBloomUpsampleFragmentShader;
 extern const char* lovrFillVertexShader;
+extern const char* lovrMaskVertexShader;
+extern const char* lovrLineVertexShader;
+extern const char* lovrParticleVertexShader;
+extern const char* lovrSkinningComputeShader;
+extern const char* lovrParticleComputeShader;
+extern const char* lovrParticleSortComputeShader;
+extern const char* lovrBloomDownsampleComputeShader;
 
 extern const char* lovrShaderScalarUniforms[];
 extern const char* lovrShaderColorUniforms[];
@@ -0,0 +1,289 @@
+#include "core/map.h"
+#include "core/util.h"
+#include "core/zip.h"
+#include "event/event.h"
+#include "thread/channel.h"
+#include "lib/tinycthread/tinycthread.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// lovr-bench: headless benchmarks for engine code that runs without a window, GPU, audio device, or
+// physics world.  Every benchmark uses a fixed seed, so runs are comparable across builds.  Results
+// are printed as JSON, one entry per benchmark with the total time and the time per operation.
+// Pass a name (or part of one) to only run matching benchmarks.
+
+#define ZIP_FILE_COUNT 256
+#define ZIP_FILE_SIZE (64 * 1024)
+#define MAP_KEY_COUNT (1 << 20)
+#define CHANNEL_MESSAGE_COUNT (1 << 20)
+
+typedef struct {
+  const char* name;
+  uint64_t (*run)(void);
+} Benchmark;
+
+static struct {
+  uint64_t seed;
+  double start;
+} state;
+
+static double now(void) {
+  struct timespec t;
+  timespec_get(&t, TIME_UTC);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static uint64_t random64(void) {
+  state.seed ^= state.seed << 13;
+  state.seed ^= state.seed >> 7;
+  state.seed ^= state.seed << 17;
+  return state.seed;
+}
+
+// Channels only destroy the Variants they're holding when they're cleared, and the benchmarks only
+// send numbers, so the rest of the event module isn't linked in
+void lovrVariantDestroy(Variant* variant) {
+  //
+}
+
+// map
+
+static uint64_t benchMapSet(void) {
+  map_t map;
+  map_init(&map, 0);
+  for (uint32_t i = 0; i < MAP_KEY_COUNT; i++) {
+    map_set(&map, random64() >> 1, i);
+  }
+  map_free(&map);
+  return MAP_KEY_COUNT;
+}
+
+static uint64_t benchMapGet(void) {
+  map_t map;
+  uint64_t* keys = malloc(MAP_KEY_COUNT * sizeof(uint64_t));
+  lovrAssert(keys, "Out of memory");
+  map_init(&map, MAP_KEY_COUNT);
+  for (uint32_t i = 0; i < MAP_KEY_COUNT; i++) {
+    map_set(&map, keys[i] = random64() >> 1, i);
+  }
+
+  // Half of the lookups miss
+  state.start = now();
+  uint64_t found = 0;
+  for (uint32_t i = 0; i < MAP_KEY_COUNT; i++) {
+    found += map_get(&map, (i & 1) ? keys[i] : random64() >> 1) != MAP_NIL;
+  }
+
+  lovrAssert(found >= MAP_KEY_COUNT / 2, "Map lost keys");
+  map_free(&map);
+  free(keys);
+  return MAP_KEY_COUNT;
+}
+
+static uint64_t benchMapRemove(void) {
+  map_t map;
+  uint64_t* keys = malloc(MAP_KEY_COUNT * sizeof(uint64_t));
+  lovrAssert(keys, "Out of memory");
+  map_init(&map, MAP_KEY_COUNT);
+  for (uint32_t i = 0; i < MAP_KEY_COUNT; i++) {
+    map_set(&map, keys[i] = random64() >> 1, i);
+  }
+  state.start = now();
+  for (uint32_t i = 0; i < MAP_KEY_COUNT; i++) {
+    map_remove(&map, keys[i]);
+  }
+  lovrAssert(map.used == 0, "Map kept keys");
+  map_free(&map);
+  free(keys);
+  return MAP_KEY_COUNT;
+}
+
+// zip
+
+static void write16(uint8_t* p, uint16_t x) { memcpy(p, &x, sizeof(x)); }
+static void write32(uint8_t* p, uint32_t x) { memcpy(p, &x, sizeof(x)); }
+
+// Files are runs of a few random words, which compress about as well as typical project assets
+static void fillFile(uint8_t* data, size_t size) {
+  uint64_t words[16];
+  for (uint32_t i = 0; i < 16; i++) {
+    words[i] = random64();
+  }
+
+  for (size_t i = 0; i < size; i += 8) {
+    uint64_t word = words[random64() & 15];
+    memcpy(data + i, &word, MIN(8, size - i));
+  }
+}
+
+// Builds an LZ4 archive in memory, laid out the way lovr-pack writes it
+static uint8_t* buildArchive(size_t* size) {
+  uint8_t* file = malloc(ZIP_FILE_SIZE);
+  size_t bound = zip_lz4_bound(ZIP_FILE_SIZE);
+  size_t capacity = ZIP_FILE_COUNT * (30 + 16 + bound + 46 + 16) + 22;
+  uint8_t* archive = malloc(capacity);
+  uint32_t* offsets = malloc(ZIP_FILE_COUNT * sizeof(uint32_t));
+  uint32_t* csizes = malloc(ZIP_FILE_COUNT * sizeof(uint32_t));
+  lovrAssert(file && archive && offsets && csizes, "Out of memory");
+
+  size_t cursor = 0;
+  char name[16];
+  for (uint32_t i = 0; i < ZIP_FILE_COUNT; i++) {
+    uint16_t length = (uint16_t) snprintf(name, sizeof(name), "file%03u.bin", i);
+    fillFile(file, ZIP_FILE_SIZE);
+    uint8_t* p = archive + cursor;
+    memset(p, 0, 30);
+    write32(p + 0, 0x04034b50);
+    write16(p + 8, ZIP_LZ4);
+    write16(p + 26, length);
+    memcpy(p + 30, name, length);
+    csizes[i] = (uint32_t) zip_lz4_encode(p + 30 + length, file, ZIP_FILE_SIZE);
+    lovrAssert(csizes[i] > 0, "Out of memory");
+    offsets[i] = (uint32_t) cursor;
+    cursor += 30 + length + csizes[i];
+  }
+
+  size_t directory = cursor;
+  for (uint32_t i = 0; i < ZIP_FILE_COUNT; i++) {
+    uint16_t length = (uint16_t) snprintf(name, sizeof(name), "file%03u.bin", i);
+    uint8_t* p = archive + cursor;
+    memset(p, 0, 46);
+    write32(p + 0, 0x02014b50);
+    write16(p + 10, ZIP_LZ4);
+    write32(p + 20, csizes[i]);
+    write32(p + 24, ZIP_FILE_SIZE);
+    write16(p + 28, length);
+    write32(p + 42, offsets[i]);
+    memcpy(p + 46, name, length);
+    cursor += 46 + length;
+  }
+
+  uint8_t* p = archive + cursor;
+  memset(p, 0, 22);
+  write32(p + 0, 0x06054b50);
+  write16(p + 8, ZIP_FILE_COUNT);
+  write16(p + 10, ZIP_FILE_COUNT);
+  write32(p + 12, (uint32_t) (cursor - directory));
+  write32(p + 16, (uint32_t) directory);
+  cursor += 22;
+
+  free(file);
+  free(offsets);
+  free(csizes);
+  *size = cursor;
+  return archive;
+}
+
+static uint64_t benchZipRead(void) {
+  size_t size;
+  uint8_t* archive = buildArchive(&size);
+  uint8_t* file = malloc(ZIP_FILE_SIZE);
+  lovrAssert(file, "Out of memory");
+
+  state.start = now();
+  zip_state zip = { .data = archive, .size = size };
+  lovrAssert(zip_open(&zip), "Bad archive");
+
+  zip_file info;
+  uint16_t method;
+  uint64_t count = 0;
+  for (uint64_t i = 0; i < zip.count; i++) {
+    zip_next(&zip, &info);
+    void* data = zip_load(&zip, info.offset, &method);
+    lovrAssert(data && zip_decompress(method, file, info.size, data, info.csize), "Bad archive");
+    count++;
+  }
+
+  free(archive);
+  free(file);
+  return count;
+}
+
+// channel
+
+static uint64_t benchChannelPushPop(void) {
+  Channel* channel = lovrChannelCreate(0);
+  Variant variant = { .type = TYPE_NUMBER };
+  uint64_t id;
+  for (uint32_t i = 0; i < CHANNEL_MESSAGE_COUNT; i++) {
+    variant.value.number = i;
+    lovrChannelPush(channel, &variant, NAN, &id);
+    if (i & 1) {
+      lovrChannelPop(channel, &variant, NAN);
+      lovrChannelPop(channel, &variant, NAN);
+    }
+  }
+  lovrRelease(channel, lovrChannelDestroy);
+  return CHANNEL_MESSAGE_COUNT;
+}
+
+static int producer(void* arg) {
+  Variant variant = { .type = TYPE_NUMBER };
+  uint64_t id;
+  for (uint32_t i = 0; i < CHANNEL_MESSAGE_COUNT; i++) {
+    variant.value.number = i;
+    lovrChannelPush(arg, &variant, NAN, &id);
+  }
+  return 0;
+}
+
+static uint64_t benchChannelThreaded(void) {
+  thrd_t thread;
+  Variant variant;
+  Channel* channel = lovrChannelCreate(0);
+  thrd_create(&thread, producer, channel);
+  for (uint32_t i = 0; i < CHANNEL_MESSAGE_COUNT; i++) {
+    lovrChannelPop(channel, &variant, INFINITY);
+  }
+  thrd_join(thread, NULL);
+  lovrRelease(channel, lovrChannelDestroy);
+  return CHANNEL_MESSAGE_COUNT;
+}
+
+static const Benchmark benchmarks[] = {
+  { "mapSet", benchMapSet },
+  { "mapGet", benchMapGet },
+  { "mapRemove", benchMapRemove },
+  { "zipRead", benchZipRead },
+  { "channelPushPop", benchChannelPushPop },
+  { "channelThreaded", benchChannelThreaded }
+};
+
+static void onError(void* userdata, const char* format, va_list args) {
+  fprintf(stderr, "lovr-bench: ");
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+  const char* filter = argc > 1 ? argv[1] : NULL;
+  lovrSetErrorCallback(onError, NULL);
+
+  printf("{\n  \"version\": \"%d.%d.%d\",\n  \"benchmarks\": [", LOVR_VERSION_MAJOR, LOVR_VERSION_MINOR, LOVR_VERSION_PATCH);
+  bool first = true;
+
+  for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+    const Benchmark* benchmark = &benchmarks[i];
+
+    if (filter && !strstr(benchmark->name, filter)) {
+      continue;
+    }
+
+    // Benchmarks with setup that shouldn't be timed restart the clock when they're done with it
+    state.seed = 0x9e3779b97f4a7c15ull;
+    state.start = now();
+    uint64_t count = benchmark->run();
+    double seconds = now() - state.start;
+
+    printf("%s\n    { \"name\": \"%s\", \"count\": %llu, \"seconds\": %.6f, \"nsPerOp\": %.2f }",
+      first ? "" : ",", benchmark->name, (unsigned long long) count, seconds, seconds * 1e9 / count);
+    first = false;
+  }
+
+  printf("\n  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,286 @@
+#include "core/fs.h"
+#include "core/zip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef LOVR_USE_ZSTD
+#include <zstd.h>
+#endif
+
+// lovr-pack: packs a project folder into a zip archive that lovr can mount or fuse.  Files are
+// compressed with LZ4 (or zstd, when available), which decompress much faster than deflate.  Files
+// that don't get smaller are stored.  Note that other zip tools can't extract LZ4 entries.
+
+#define PATH_MAX_LENGTH 1024
+
+typedef struct {
+  char* name;
+  uint16_t method;
+  uint16_t time;
+  uint16_t date;
+  uint32_t crc;
+  uint32_t csize;
+  uint32_t size;
+  uint32_t offset;
+} Entry;
+
+static struct {
+  FILE* output;
+  uint32_t offset;
+  uint16_t method;
+  int level;
+  Entry* entries;
+  size_t count;
+  size_t capacity;
+  const char* outputPath;
+  uint32_t crcTable[256];
+} state;
+
+static void fail(const char* message, const char* detail) {
+  fprintf(stderr, "lovr-pack: %s%s%s\n", message, detail ? ": " : "", detail ? detail : "");
+  exit(EXIT_FAILURE);
+}
+
+static void emit(const void* data, size_t size) {
+  if (size > 0 && fwrite(data, 1, size, state.output) != size) {
+    fail("Could not write archive", state.outputPath);
+  }
+  state.offset += (uint32_t) size;
+}
+
+static void emit16(uint16_t x) {
+  uint8_t bytes[2] = { x & 0xff, x >> 8 };
+  emit(bytes, sizeof(bytes));
+}
+
+static void emit32(uint32_t x) {
+  uint8_t bytes[4] = { x & 0xff, (x >> 8) & 0xff, (x >> 16) & 0xff, x >> 24 };
+  emit(bytes, sizeof(bytes));
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+  uint32_t crc = ~0u;
+  for (size_t i = 0; i < size; i++) {
+    crc = state.crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+// Returns the compressed size, or 0 if compression didn't help
+static size_t compress(uint16_t method, void** dst, const void* src, size_t size) {
+  size_t bound;
+  size_t csize;
+
+  switch (method) {
+#ifdef LOVR_USE_ZSTD
+    case ZIP_ZSTD:
+      bound = ZSTD_compressBound(size);
+      if ((*dst = malloc(bound)) == NULL) fail("Out of memory", NULL);
+      csize = ZSTD_compress(*dst, bound, src, size, state.level);
+      if (ZSTD_isError(csize)) fail("Could not compress file", ZSTD_getErrorName(csize));
+      break;
+#endif
+    default:
+      bound = zip_lz4_bound(size);
+      if ((*dst = malloc(bound)) == NULL) fail("Out of memory", NULL);
+      if ((csize = zip_lz4_encode(*dst, src, size)) == 0) fail("Out of memory", NULL);
+      break;
+  }
+
+  return csize < size ? csize : 0;
+}
+
+static void add(const char* path, const char* name, FileInfo* info) {
+  if (info->size > UINT32_MAX || state.offset > UINT32_MAX - info->size) {
+    fail("Archive is too big (zip64 isn't supported)", path);
+  }
+
+  size_t size = (size_t) info->size;
+  void* data = NULL;
+  if (size > 0 && (data = fs_map(path, &size)) == NULL) {
+    fail("Could not read file", path);
+  }
+
+  void* compressed = NULL;
+  size_t csize = size > 0 ? compress(state.method, &compressed, data, size) : 0;
+  uint16_t method = csize > 0 ? state.method : ZIP_STORE;
+
+  time_t lastModified = (time_t) info->lastModified;
+  struct tm* t = localtime(&lastModified);
+
+  if (state.count == state.capacity) {
+    state.capacity = state.capacity ? state.capacity * 2 : 64;
+    state.entries = realloc(state.entries, state.capacity * sizeof(Entry));
+    if (!state.entries) fail("Out of memory", NULL);
+  }
+
+  Entry* entry = &state.entries[state.count++];
+  entry->name = malloc(strlen(name) + 1);
+  if (!entry->name) fail("Out of memory", NULL);
+  strcpy(entry->name, name);
+  entry->method = method;
+  entry->time = t ? (t->tm_hour << 11) | (t->tm_min << 5) | (t->tm_sec >> 1) : 0;
+  entry->date = t && t->tm_year >= 80 ? ((t->tm_year - 80) << 9) | ((t->tm_mon + 1) << 5) | t->tm_mday : (1 << 5) | 1;
+  entry->crc = crc32(data, size);
+  entry->csize = (uint32_t) (method == ZIP_STORE ? size : csize);
+  entry->size = (uint32_t) size;
+  entry->offset = state.offset;
+
+  uint16_t nameLength = (uint16_t) strlen(name);
+  emit32(0x04034b50);
+  emit16(method == ZIP_STORE ? 10 : 63);
+  emit16(0);
+  emit16(method);
+  emit16(entry->time);
+  emit16(entry->date);
+  emit32(entry->crc);
+  emit32(entry->csize);
+  emit32(entry->size);
+  emit16(nameLength);
+  emit16(0);
+  emit(name, nameLength);
+  emit(method == ZIP_STORE ? data : compressed, entry->csize);
+
+  free(compressed);
+  if (data) fs_unmap(data, size);
+}
+
+typedef struct {
+  char path[PATH_MAX_LENGTH];
+  size_t pathLength;
+  size_t rootLength;
+} Walker;
+
+static void walk(void* context, const char* filename) {
+  Walker* walker = context;
+
+  if (!strcmp(filename, ".") || !strcmp(filename, "..")) {
+    return;
+  }
+
+  size_t length = strlen(filename);
+  size_t pathLength = walker->pathLength;
+  if (pathLength + 1 + length >= sizeof(walker->path)) {
+    fail("Path is too long", filename);
+  }
+
+  walker->path[pathLength] = '/';
+  memcpy(walker->path + pathLength + 1, filename, length + 1);
+  walker->pathLength = pathLength + 1 + length;
+
+  // Don't pack the output into itself
+  FileInfo info;
+  if (strcmp(walker->path, state.outputPath) && fs_stat(walker->path, &info)) {
+    if (info.type == FILE_DIRECTORY) {
+      fs_list(walker->path, walk, walker);
+    } else {
+      add(walker->path, walker->path + walker->rootLength + 1, &info);
+    }
+  }
+
+  walker->pathLength = pathLength;
+  walker->path[pathLength] = '\0';
+}
+
+int main(int argc, char** argv) {
+  const char* input = NULL;
+  state.method = ZIP_LZ4;
+  state.level = 19;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--lz4")) {
+      state.method = ZIP_LZ4;
+    } else if (!strcmp(argv[i], "--zstd")) {
+#ifdef LOVR_USE_ZSTD
+      state.method = ZIP_ZSTD;
+#else
+      fail("zstd support was not enabled in this build (LOVR_USE_ZSTD)", NULL);
+#endif
+    } else if (!input) {
+      input = argv[i];
+    } else if (!state.outputPath) {
+      state.outputPath = argv[i];
+    } else {
+      input = NULL;
+      break;
+    }
+  }
+
+  if (!input || !state.outputPath) {
+    fprintf(stderr, "usage: lovr-pack [--lz4|--zstd] <folder> <output.zip>\n");
+    return EXIT_FAILURE;
+  }
+
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+    state.crcTable[i] = c;
+  }
+
+  Walker walker;
+  walker.rootLength = strlen(input);
+  while (walker.rootLength > 1 && input[walker.rootLength - 1] == '/') walker.rootLength--;
+  if (walker.rootLength >= sizeof(walker.path)) fail("Path is too long", input);
+  memcpy(walker.path, input, walker.rootLength);
+  walker.path[walker.rootLength] = '\0';
+  walker.pathLength = walker.rootLength;
+
+  FileInfo info;
+  if (!fs_stat(walker.path, &info) || info.type != FILE_DIRECTORY) {
+    fail("Not a directory", input);
+  }
+
+  if ((state.output = fopen(state.outputPath, "wb")) == NULL) {
+    fail("Could not open archive for writing", state.outputPath);
+  }
+
+  fs_list(walker.path, walk, &walker);
+
+  if (state.count > UINT16_MAX) {
+    fail("Too many files (zip64 isn't supported)", NULL);
+  }
+
+  uint32_t directoryOffset = state.offset;
+  for (size_t i = 0; i < state.count; i++) {
+    Entry* entry = &state.entries[i];
+    uint16_t nameLength = (uint16_t) strlen(entry->name);
+    emit32(0x02014b50);
+    emit16(63);
+    emit16(entry->method == ZIP_STORE ? 10 : 63);
+    emit16(0);
+    emit16(entry->method);
+    emit16(entry->time);
+    emit16(entry->date);
+    emit32(entry->crc);
+    emit32(entry->csize);
+    emit32(entry->size);
+    emit16(nameLength);
+    emit16(0);
+    emit16(0);
+    emit16(0);
+    emit16(0);
+    emit32(0);
+    emit32(entry->offset);
+    emit(entry->name, nameLength);
+    free(entry->name);
+  }
+
+  uint32_t directorySize = state.offset - directoryOffset;
+  emit32(0x06054b50);
+  emit16(0);
+  emit16(0);
+  emit16((uint16_t) state.count);
+  emit16((uint16_t) state.count);
+  emit32(directorySize);
+  emit32(directoryOffset);
+  emit16(0);
+
+  free(state.entries);
+  if (fclose(state.output)) {
+    fail("Could not write archive", state.outputPath);
+  }
+
+  return EXIT_SUCCESS;
+}